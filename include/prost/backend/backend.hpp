@@ -22,8 +22,14 @@
 #define PROST_BACKEND_HPP_
 
 #include <cmath>
+#include <limits>
+#include <cuda_runtime.h>
+#include <thrust/device_vector.h>
+
 #include "prost/common.hpp"
 #include "prost/solver.hpp"
+#include "prost/backend/convergence_history.hpp"
+#include "prost/backend/residual_schedule.hpp"
 
 namespace prost {
 
@@ -36,16 +42,65 @@ template<typename T> class Problem;
 template<typename T>
 class Backend {
 public:
-  Backend() {}
+  /// \brief Parts of the iterate contained in a snapshot, can be or'ed.
+  enum SnapshotPart
+  {
+    kSnapshotX = 1,
+    kSnapshotZ = 2,
+    kSnapshotY = 4,
+    kSnapshotW = 8,
+    kSnapshotAll = 15,
+  };
+
+  Backend() 
+    : primal_dual_gap_(std::numeric_limits<T>::infinity()), 
+      snapshot_parts_(0), snapshot_tag_(-1) {}
   virtual ~Backend() {}
 
   void SetProblem(shared_ptr<Problem<T> > problem) { problem_ = problem; }
   void SetOptions(const typename Solver<T>::Options& opts) { solver_opts_ = opts; }
 
+  /// \brief Returns true if the backend runs on the host. The problem is
+  ///        then initialized with Problem::InitializeHost() and the solver
+  ///        does not touch the GPU.
+  virtual bool host() const { return false; }
+
+  /// \brief Called by the solver before the problem is initialized, so that
+  ///        the backend can adjust how the problem is assembled.
+  virtual void PrepareProblem(Problem<T>& problem) { }
+
   virtual void Initialize() = 0;
-  virtual void PerformIteration() = 0;
+  virtual void PerformIteration(cudaStream_t stream = 0) = 0;
   virtual void Release() = 0;
 
+  /// \brief Returns the number of iterations starting at the current one that
+  ///        can be replayed from a captured CUDA graph, 0 if not possible.
+  virtual int graph_iterations() const { return 0; }
+
+  /// \brief Performs graph_iterations() iterations by replaying a captured
+  ///        CUDA graph on the given stream. Returns false if the iterations
+  ///        could not be captured, in which case nothing has been done.
+  virtual bool PerformGraphIterations(cudaStream_t stream) { return false; }
+
+  /// \brief Returns true if the backend runs the iterations inside a single
+  ///        persistent kernel, see PerformPersistentIterations().
+  virtual bool persistent() const { return false; }
+
+  /// \brief Performs up to count iterations in a single launch on the 
+  ///        given stream, stopping early if the residuals meet the 
+  ///        tolerances. The residuals of the last iteration are available
+  ///        afterwards. Returns the number of iterations performed.
+  virtual int PerformPersistentIterations(int count, cudaStream_t stream) { return 0; }
+
+  /// \brief Called by Solver::Resolve after the problem data was updated
+  ///        in place. The iterates are kept as warm start, cached data
+  ///        derived from the old problem has to be refreshed.
+  virtual void ProblemChanged(cudaStream_t stream) { }
+
+  /// \brief Requests the residuals to be evaluated in the next iteration,
+  ///        called by the solver before callbacks and the last iteration.
+  virtual void RequestResiduals() { residual_schedule_.Request(); }
+
   /// \brief Copies current primal dual solution pair (x,y) to the host.
   virtual void current_solution(vector<T>& primal_sol, vector<T>& dual_sol) = 0;
 
@@ -55,6 +110,74 @@ public:
                                 vector<T>& dual_y,
                                 vector<T>& dual_w) = 0;
 
+  /// \brief Returns true if the backend can exchange its iterate with 
+  ///        device memory, see SetIterateDevice() and 
+  ///        current_solution_device().
+  virtual bool device_solution() const { return false; }
+
+  /// \brief Overwrites the current iterate with the n primal entries x and 
+  ///        the m dual entries y in device memory, either may be null. 
+  ///        Called by the solver after Initialize().
+  virtual void SetIterateDevice(const T *x, const T *y, cudaStream_t stream) { }
+
+  /// \brief Copies the current (x, z, y, w) into device memory on the 
+  ///        given stream, pointers may be null. Only supported if 
+  ///        device_solution() returns true.
+  virtual void current_solution_device(T *x, T *z, T *y, T *w, cudaStream_t stream) { }
+
+  /// \brief Starts copying the given parts of the current iterate to the
+  ///        host without waiting for the copy to finish. The snapshot is
+  ///        identified by tag. The default implementation defers to a
+  ///        synchronous current_solution in FinishSnapshot.
+  virtual void BeginSnapshot(int parts, int tag, cudaStream_t stream)
+  {
+    snapshot_parts_ = parts;
+    snapshot_tag_ = tag;
+  }
+
+  /// \brief Writes the requested parts of the most recently completed
+  ///        snapshot into the given vectors and returns its tag or -1 if
+  ///        no snapshot completed since the last call. If block is set,
+  ///        waits for the last issued snapshot.
+  virtual int FinishSnapshot(vector<T>& primal_x,
+                             vector<T>& primal_z,
+                             vector<T>& dual_y,
+                             vector<T>& dual_w,
+                             bool block)
+  {
+    if(snapshot_tag_ < 0)
+      return -1;
+
+    if(snapshot_parts_ & (kSnapshotZ | kSnapshotW))
+      current_solution(primal_x, primal_z, dual_y, dual_w);
+    else
+      current_solution(primal_x, dual_y);
+
+    const int tag = snapshot_tag_;
+    snapshot_tag_ = -1;
+    return tag;
+  }
+
+  /// \brief Returns true if the backend can save its complete state to a
+  ///        checkpoint and resume from it, see StateVectors().
+  virtual bool checkpoints() const { return false; }
+
+  /// \brief Lists the device vectors of the iteration state in a fixed
+  ///        order. Together with the scalars of GetStateScalars() they 
+  ///        determine all following iterations.
+  virtual void StateVectors(vector<thrust::device_vector<T>*>& vectors) { }
+
+  /// \brief Appends the host scalars of the iteration state (step sizes,
+  ///        counters, residuals) as doubles, which hold all of them 
+  ///        exactly. Host work still in flight, e.g. an asynchronous 
+  ///        residual check, is completed first.
+  virtual void GetStateScalars(vector<double>& scalars) { }
+
+  /// \brief Restores the scalars of GetStateScalars() after the vectors
+  ///        of StateVectors() were overwritten on stream, and drops what
+  ///        was derived from the previous state.
+  virtual void SetStateScalars(const vector<double>& scalars, cudaStream_t stream) { }
+
   /// \brief Returns norm of the primal residual |Ax - z|.
   virtual T primal_residual() const { return primal_residual_; }
 
@@ -67,6 +190,12 @@ public:
   /// \brief Returns norm of the dual variable "w", used for stopping criterion.
   virtual T dual_var_norm() const { return dual_var_norm_; }
 
+  /// \brief Returns the primal-dual gap of the last residual evaluation,
+  ///        infinity if the backend does not evaluate it. Never negative,
+  ///        a negative sum of the Fenchel-Young terms is not a valid bound
+  ///        and is reported as infinity.
+  virtual T primal_dual_gap() const { return primal_dual_gap_; }
+
   /// \brief Returns primal stopping epsilon.
   virtual T eps_primal() const { return std::sqrt(problem_->nrows()) * solver_opts_.tol_abs_primal + solver_opts_.tol_rel_primal * primal_var_norm(); } 
   
@@ -76,6 +205,9 @@ public:
   // returns amount of gpu memory required in bytes
   virtual size_t gpu_mem_amount() const = 0;
 
+  /// \brief Per-iteration telemetry, see Solver::Options::history_size.
+  ConvergenceHistory<T>& history() { return history_; }
+
 protected:
   shared_ptr<Problem<T> > problem_;
 
@@ -92,6 +224,108 @@ protected:
 
   /// \brief Size of dual residual |K^T y + w|
   T dual_residual_;
+
+  /// \brief Primal-dual gap, see Solver::Options::tol_gap.
+  T primal_dual_gap_;
+
+  /// \brief Starts the residual schedule from the options of the solver 
+  ///        and the fixed interval of the backend.
+  void ResetResidualSchedule(int residual_iter)
+  {
+    residual_schedule_.Reset(residual_iter, 
+                             solver_opts_.adaptive_residuals,
+                             solver_opts_.max_residual_iter);
+  }
+
+  /// \brief Forgets the residuals and the gap of the previous problem and
+  ///        checks the next iteration, so that a resolve does not stop on
+  ///        the converged residuals of the last solve.
+  void RestartResiduals()
+  {
+    residual_schedule_.Restart();
+    primal_residual_ = std::numeric_limits<T>::infinity();
+    dual_residual_ = std::numeric_limits<T>::infinity();
+    primal_dual_gap_ = std::numeric_limits<T>::infinity();
+  }
+
+  /// \brief Feeds the current residuals, evaluated in the given iteration,
+  ///        to the residual schedule.
+  void UpdateResidualSchedule(size_t iteration)
+  {
+    residual_schedule_.Update(iteration, 
+                              primal_residual_ / eps_primal(), 
+                              dual_residual_ / eps_dual());
+  }
+
+  /// \brief Iterations in which the residuals are evaluated.
+  ResidualSchedule residual_schedule_;
+
+  /// \brief Appends the residuals, norms and the residual schedule to the
+  ///        state scalars, shared by all backends supporting checkpoints.
+  void GetBaseStateScalars(vector<double>& scalars) const
+  {
+    scalars.push_back(primal_residual_);
+    scalars.push_back(dual_residual_);
+    scalars.push_back(primal_var_norm_);
+    scalars.push_back(dual_var_norm_);
+    residual_schedule_.GetState(scalars);
+  }
+
+  /// \brief Restores the scalars of GetBaseStateScalars() from 
+  ///        scalars[pos], advancing pos past them.
+  void SetBaseStateScalars(const vector<double>& scalars, size_t& pos)
+  {
+    primal_residual_ = static_cast<T>(scalars[pos++]);
+    dual_residual_ = static_cast<T>(scalars[pos++]);
+    primal_var_norm_ = static_cast<T>(scalars[pos++]);
+    dual_var_norm_ = static_cast<T>(scalars[pos++]);
+    residual_schedule_.SetState(scalars, pos);
+  }
+
+  /// \brief Sizes the history from the solver options, with the same eps 
+  ///        as eps_primal() and eps_dual().
+  void InitializeHistory()
+  {
+    history_.Initialize(solver_opts_.history_size,
+                        std::sqrt(problem_->nrows()) * solver_opts_.tol_abs_primal,
+                        solver_opts_.tol_rel_primal,
+                        std::sqrt(problem_->ncols()) * solver_opts_.tol_abs_dual,
+                        solver_opts_.tol_rel_dual);
+  }
+
+  /// \brief Entry of the given iteration with the current residuals if
+  ///        they were evaluated in it, NaN otherwise.
+  HistoryEntry<T> MakeHistoryEntry(int iteration, bool has_residuals, T tau, T sigma, T theta, T rho, int cg_iters) const
+  {
+    const T nan = ConvergenceHistory<T>::nan();
+    HistoryEntry<T> entry;
+    entry.iteration = iteration;
+    entry.primal_residual = has_residuals ? primal_residual_ : nan;
+    entry.dual_residual = has_residuals ? dual_residual_ : nan;
+    entry.eps_primal = has_residuals ? eps_primal() : nan;
+    entry.eps_dual = has_residuals ? eps_dual() : nan;
+    entry.tau = tau;
+    entry.sigma = sigma;
+    entry.theta = theta;
+    entry.rho = rho;
+    entry.cg_iters = cg_iters;
+
+    return entry;
+  }
+
+  /// \brief Appends an entry to the history of a backend without device
+  ///        ring, if the history is enabled.
+  void RecordHistoryHost(const HistoryEntry<T>& entry)
+  {
+    if(solver_opts_.history_size > 0)
+      history_.RecordHost(entry);
+  }
+
+  ConvergenceHistory<T> history_;
+
+  /// \brief Parts and tag of the pending snapshot of the default implementation.
+  int snapshot_parts_;
+  int snapshot_tag_;
 };
 
 } // namespace prost
@@ -25,7 +25,10 @@
 #include <cublas_v2.h>
 
 #include "prost/backend/backend.hpp"
+#include "prost/backend/residual_sums.hpp"
+#include "prost/cgls_fused.hpp"
 #include "prost/common.hpp"
+#include "prost/sparse_cholesky.hpp"
 
 namespace prost {
 
@@ -35,6 +38,22 @@ template<typename T>
 class BackendADMM : public Backend<T>
 {
 public:
+  /// \brief How the projection onto the graph of the linear operator
+  ///        is computed.
+  enum ProjectionMode
+  {
+    /// \brief Inexact, warm-started CGLS.
+    kProjectionCGLS,
+
+    /// \brief Exact solve with a sparse Cholesky factorization of
+    ///        I + A A^T (or I + A^T A) computed once in Initialize.
+    kProjectionCholesky,
+
+    /// \brief Cholesky if the operator can be assembled and the system
+    ///        has at most direct_max_nnz nonzeros, otherwise CGLS.
+    kProjectionAuto,
+  };
+
   struct Options
   {
     /// \brief initial step size
@@ -55,19 +74,37 @@ public:
     /// \brief maximum number of cg iterations
     int cg_max_iter;
 
+    /// \brief Use the fused CGLS kernels with the scalars on the device.
+    bool cg_fused;
+
+    /// \brief Jacobi preconditioner for the fused CGLS.
+    bool cg_jacobi;
+
+    /// \brief Every how many iterations the fused CGLS checks convergence
+    ///        on the host. The operator is still applied in the iterations
+    ///        between convergence and the next check.
+    int cg_check_iter;
+
     /// \brief Every how many iterations to compute the residuals?
     int residual_iter;
 
     /// \brief Parameters for residual converging step size scheme.
     T arb_delta, arb_tau, arb_gamma;
+
+    /// \brief Projection method.
+    ProjectionMode projection;
+
+    /// \brief Maximal number of nonzeros of the factorized system.
+    int direct_max_nnz;
   };
 
   BackendADMM(const typename BackendADMM<T>::Options& opts);
   virtual ~BackendADMM();
 
   virtual void Initialize();
-  virtual void PerformIteration();
+  virtual void PerformIteration(cudaStream_t stream = 0);
   virtual void Release();
+  virtual void ProblemChanged(cudaStream_t stream);
 
   virtual void current_solution(vector<T>& primal, vector<T>& dual);
 
@@ -76,14 +113,38 @@ public:
                                 vector<T>& dual_y,
                                 vector<T>& dual_w);
 
+  virtual bool checkpoints() const { return true; }
+  virtual void StateVectors(vector<thrust::device_vector<T>*>& vectors);
+  virtual void GetStateScalars(vector<double>& scalars);
+  virtual void SetStateScalars(const vector<double>& scalars, cudaStream_t stream);
+
   /// \brief Returns amount of gpu memory required in bytes.
   virtual size_t gpu_mem_amount() const;
 
 private:
+  /// \brief Assembles M = I + B B^T on the host for B = Sigma^{1/2} K Tau^{1/2}
+  ///        if nrows <= ncols and its transpose otherwise. Returns false if
+  ///        K does not store its entries or M exceeds direct_max_nnz.
+  bool AssembleProjectionSystem(
+    vector<int32_t>& ptr,
+    vector<int32_t>& ind,
+    vector<T>& val);
+
+  /// \brief Assembles and factorizes the projection system, returns false
+  ///        if it could not be assembled.
+  bool FactorProjectionSystem();
+
+  /// \brief Sets the Jacobi preconditioner of the fused CGLS to an
+  ///        approximation of diag(A^T A) + 1 from the column sums of K.
+  void ComputeJacobiPreconditioner(cudaStream_t stream);
+
   thrust::device_vector<T> x_half_, z_half_;
   thrust::device_vector<T> x_proj_, z_proj_;
   thrust::device_vector<T> x_dual_, z_dual_;
   thrust::device_vector<T> temp1_, temp2_, temp3_;
+
+  /// \brief Sums |Kx - z|^2, |z|^2, |K^T y + w|^2 and |w|^2 on the device.
+  ResidualSums<T> residual_sums_;
   
   /// \brief ADMM-specific options.
   typename BackendADMM<T>::Options opts_;
@@ -103,8 +164,17 @@ private:
   /// \brief Internal prox_f
   vector< shared_ptr<Prox<T> > > prox_f_;
 
-  /// \brief cuBLAS handle
+  /// \brief cuBLAS handle of the execution context
   cublasHandle_t hdl_;
+
+  /// \brief Whether the projection is computed by the factorization.
+  bool direct_;
+
+  /// \brief Factorization of I + A A^T (nrows <= ncols) or I + A^T A.
+  SparseCholesky<T> cholesky_;
+
+  /// \brief Scratch memory and device scalars of the fused CGLS.
+  FusedCGLS<T> fused_cgls_;
 };
 
 } // namespace prost
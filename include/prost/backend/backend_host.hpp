@@ -0,0 +1,123 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BACKEND_HOST_HPP_
+#define PROST_BACKEND_HOST_HPP_
+
+#include "prost/backend/backend.hpp"
+#include "prost/common.hpp"
+
+namespace prost {
+
+template<typename T> class Prox;
+
+///
+/// \brief Primal-dual hybrid-gradient method with constant steps running
+///        on the host, multithreaded with OpenMP. Meant for small problems,
+///        where the kernel launches dominate, and for nodes without a GPU.
+///        The linear operator is expanded into CSR matrices of K and K^T,
+///        so all blocks have to store their entries, and all proxs have to
+///        support host evaluation, see Prox::supports_host_eval().
+/// 
+template<typename T> 
+class BackendHost : public Backend<T> 
+{
+public:
+  struct Options 
+  {
+    /// \brief Initial primal step size.
+    double tau0;
+  
+    /// \brief Initial dual step size.
+    double sigma0; 
+
+    /// \brief Every how many iterations to compute the residuals?
+    int residual_iter;
+
+    /// \brief Scale step sizes to ensure tau*sigma*||K||^2 = 1. 
+    bool scale_steps_operator;
+
+    /// \brief Relative tolerance for the estimate of ||K|| used by 
+    ///        scale_steps_operator.
+    T normest_tol;
+  };
+
+  BackendHost(const typename BackendHost<T>::Options& opts);
+  virtual ~BackendHost();
+
+  virtual bool host() const { return true; }
+
+  virtual void Initialize();
+  virtual void PerformIteration(cudaStream_t stream = 0);
+  virtual void Release();
+
+  virtual void ProblemChanged(cudaStream_t stream);
+
+  virtual void current_solution(vector<T>& primal, vector<T>& dual);
+
+  virtual void current_solution(vector<T>& primal_x,
+                                vector<T>& primal_z,
+                                vector<T>& dual_y,
+                                vector<T>& dual_w);
+
+  /// \brief Nothing is stored on the GPU.
+  virtual size_t gpu_mem_amount() const { return 0; }
+
+protected:
+  /// \brief Builds the CSR matrices of K and K^T from the problem.
+  void BuildOperator();
+
+  /// \brief Computes result = K rhs if adjoint is false, K^T rhs otherwise.
+  void Multiply(vector<T>& result, const vector<T>& rhs, bool adjoint) const;
+
+  /// \brief Estimates ||K|| with the power method on K^T K.
+  T NormEstimate(T tol, int max_iters = 250) const;
+
+  /// \brief Sets tau and sigma to their initial values, divided by the
+  ///        operator norm if scale_steps_operator is set.
+  void ResetStepsizes();
+
+  /// \brief Computes the residuals and the norms of z and w.
+  void ComputeResiduals();
+
+private:
+  vector<T> x_, x_prev_, kty_, kty_prev_;
+  vector<T> y_, y_prev_, kx_, kx_prev_;
+
+  /// \brief Prox arguments of the primal and the dual step.
+  vector<T> arg_primal_, arg_dual_;
+
+  /// \brief K in CSR format and K^T in CSR format, i.e. K in CSC format.
+  vector<T> val_, val_t_;
+  vector<int32_t> ptr_, ind_, ptr_t_, ind_t_;
+
+  T tau_, sigma_, theta_;
+
+  size_t iteration_;
+
+  vector<shared_ptr<Prox<T> > > prox_g_;
+  vector<shared_ptr<Prox<T> > > prox_fstar_;
+
+  typename BackendHost<T>::Options opts_;
+};
+
+} // namespace prost
+
+#endif // PROST_BACKEND_HOST_HPP_
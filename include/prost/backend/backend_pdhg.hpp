@@ -22,13 +22,16 @@
 #define PROST_BACKEND_PDHG_HPP_
 
 #include <thrust/device_vector.h>
+#include <thrust/tuple.h>
 
 #include "prost/backend/backend.hpp"
+#include "prost/backend/residual_sums.hpp"
 #include "prost/common.hpp"
 
 namespace prost {
 
 template<typename T> class Prox;
+template<typename T> class PersistentPDHG;
 
 ///
 /// \brief Implementation of the primal-dual hybrid-gradient method.
@@ -51,6 +54,10 @@ public:
 
     /// \brief Residual converging scheme from "Fougner, Boyd" paper
     kPDHGStepsResidualBoyd,
+
+    /// \brief Constant steps with adaptive restarts to the average iterate
+    ///        and primal weight updates, as in PDLP ("Applegate et al.").
+    kPDHGStepsRestarted,
   };
 
   /// \brief Detailed options for the primal-dual algorithm.
@@ -68,6 +75,10 @@ public:
     /// \brief Scale step sizes to ensure tau*sigma*||K||^2 = 1. 
     bool scale_steps_operator;
 
+    /// \brief Relative tolerance for the estimate of ||K|| used by 
+    ///        scale_steps_operator.
+    T normest_tol;
+
     /// \brief Strong convexity parameter for algorithm 2 step size scheme.
     T alg2_gamma;
 
@@ -77,17 +88,56 @@ public:
     /// \brief Parameters for residual converging step size scheme.
     T arb_delta, arb_tau;
 
+    /// \brief Every how many iterations to check for a restart.
+    int restart_iter;
+
+    /// \brief Sufficient, necessary and artificial restart criteria of the
+    ///        restarted scheme.
+    T restart_beta_sufficient, restart_beta_necessary, restart_beta_artificial;
+
+    /// \brief Smoothing of the primal weight update at restarts.
+    T primal_weight_smoothing;
+
     /// \brief Type of step-size scheme.
     typename BackendPDHG<T>::StepsizeVariant stepsize_variant;
+
+    /// \brief Compute the prox arguments on the fly inside the proxs, if
+    ///        all of them support fused evaluation.
+    bool fuse_prox_arg;
+
+    /// \brief Compute the prox arguments inside the linear operator kernels
+    ///        as an epilogue of K x and K^T y, if the proxs are not fused.
+    bool fuse_epilogue;
+
+    /// \brief Keep only x, y, K x, K^T y and one temporary on the device.
+    ///        The previous iterates are recovered from the prox arguments
+    ///        and the residuals cost one more K x on residual iterations.
+    bool low_memory;
+
+    /// \brief Run the iterations between two callbacks in a single 
+    ///        cooperative kernel, for small problems whose iterations are
+    ///        bound by the launch latency. Only used with the constant and
+    ///        strongly convex step sizes and a fixed residual schedule, 
+    ///        falls back to the regular iterations if some prox or block
+    ///        is not supported, see PersistentPDHG.
+    bool persistent_kernel;
   };
 
   BackendPDHG(const typename BackendPDHG<T>::Options& opts);
   virtual ~BackendPDHG();
 
   virtual void Initialize();
-  virtual void PerformIteration();
+  virtual void PerformIteration(cudaStream_t stream = 0);
   virtual void Release();
 
+  virtual void ProblemChanged(cudaStream_t stream);
+
+  virtual int graph_iterations() const;
+  virtual bool PerformGraphIterations(cudaStream_t stream);
+
+  virtual bool persistent() const { return static_cast<bool>(persistent_); }
+  virtual int PerformPersistentIterations(int count, cudaStream_t stream);
+
   virtual void current_solution(vector<T>& primal, vector<T>& dual);
 
   virtual void current_solution(vector<T>& primal_x,
@@ -95,11 +145,137 @@ public:
                                 vector<T>& dual_y,
                                 vector<T>& dual_w);
 
+  virtual bool device_solution() const { return true; }
+  virtual void SetIterateDevice(const T *x, const T *y, cudaStream_t stream);
+  virtual void current_solution_device(T *x, T *z, T *y, T *w, cudaStream_t stream);
+
+  virtual void BeginSnapshot(int parts, int tag, cudaStream_t stream);
+
+  virtual int FinishSnapshot(vector<T>& primal_x,
+                             vector<T>& primal_z,
+                             vector<T>& dual_y,
+                             vector<T>& dual_w,
+                             bool block);
+
+  virtual bool checkpoints() const { return true; }
+  virtual void StateVectors(vector<thrust::device_vector<T>*>& vectors);
+  virtual void GetStateScalars(vector<double>& scalars);
+  virtual void SetStateScalars(const vector<double>& scalars, cudaStream_t stream);
+
   /// \brief Returns amount of gpu memory required in bytes.
   virtual size_t gpu_mem_amount() const;
 
+protected:
+  /// \brief Computes x^{k+1} = prox_g(x^k - tau T K^T y^k).
+  void PrimalStep(cudaStream_t stream);
+
+  /// \brief Computes K x^{k+1} and y^{k+1} = prox_fstar(y^k + sigma S K (x^{k+1} + theta (x^{k+1} - x^k))).
+  void DualStep(cudaStream_t stream);
+
+  /// \brief Computes K^T y^{k+1}.
+  void AdjointStep(cudaStream_t stream);
+
+  /// \brief Returns true if the residuals are evaluated in the current iteration.
+  bool is_residual_iteration() const { return this->residual_schedule_.is_due(iteration_); }
+
+  /// \brief Computes |Kx - z|^2, |z|^2, |K^T y + w|^2 and |w|^2 over the
+  ///        first num_rows dual and num_cols primal entries.
+  void ComputeResidualSums(cudaStream_t stream, size_t num_rows, size_t num_cols, T sums[4]);
+
+  /// \brief Queues the reduction of the residual sums into device memory
+  ///        and their copy to pinned host memory on the given stream.
+  void IssueResidualSums(cudaStream_t stream);
+
+  /// \brief Launches the single-pass reduction of all four residual sums
+  ///        into residual_sums_ and, if to_host is set, their transfer to
+  ///        the host.
+  void LaunchResidualSums(cudaStream_t stream, size_t num_rows, size_t num_cols, bool to_host = true);
+
+  /// \brief Reads the residuals of the last issued check, waiting for them
+  ///        if block is set. Returns false if they are not available yet.
+  bool ConsumeResidualSums(bool block);
+
+  /// \brief Evaluates the primal-dual gap of (x^k, y^k) into 
+  ///        primal_dual_gap_ by a single reduction over the terms of all
+  ///        proxs, which synchronizes the stream.
+  void ComputeGap(cudaStream_t stream);
+
+  /// \brief Adapts the step sizes for the residual based schemes.
+  void AdaptStepsizes(T eps_primal, T eps_dual);
+
+  /// \brief Step size update of the strongly convex scheme.
+  void UpdateStepsizesAlg2();
+
+  /// \brief Returns true if the restarted scheme checks for a restart in
+  ///        the current iteration.
+  bool is_restart_iteration() const;
+
+  /// \brief Adds the current iterate to the running sums of the restarted
+  ///        scheme.
+  void AccumulateAverage(cudaStream_t stream);
+
+  /// \brief Restarts to the average or current iterate if the fixed point
+  ///        residual decayed enough and re-balances tau and sigma.
+  void CheckRestart(cudaStream_t stream);
+
+  /// \brief Discards the running sums and makes the current iterate the 
+  ///        restart point.
+  void ResetRestart(cudaStream_t stream);
+
+  /// \brief Returns the PDHG fixed point residual |z1 - z0|_P with 
+  ///        P = [(tau T)^{-1}, -K^T; -K, (sigma S)^{-1}], where z0 = (x0, y0)
+  ///        and K x0 are given up to the factor scale0.
+  T FixedPointResidual(
+    const thrust::device_vector<T>& x0,
+    const thrust::device_vector<T>& x1,
+    const thrust::device_vector<T>& y0,
+    const thrust::device_vector<T>& y1,
+    const thrust::device_vector<T>& kx0,
+    const thrust::device_vector<T>& kx1,
+    T scale0,
+    cudaStream_t stream);
+
 private:
-  void UpdateResidualsAndStepsizes();
+  /// \brief One of the two buffers of the asynchronous snapshots. The
+  ///        iterate is staged into device memory (x, z, y, w) on the
+  ///        iteration stream and copied to pinned memory on a side stream.
+  struct Snapshot
+  {
+    thrust::device_vector<T> staging;
+    T *host;
+    cudaEvent_t staged;
+    cudaEvent_t copied;
+    int parts;
+    int tag;
+    bool pending;
+    size_t order;
+  };
+
+  void UpdateResidualsAndStepsizes(cudaStream_t stream);
+
+  /// \brief Computes w^k (-K^T y^k in the low_memory mode) into temp_ and
+  ///        returns the vector holding it in its first n entries.
+  const thrust::device_vector<T>& ComputeW(cudaStream_t stream);
+
+  /// \brief Computes z^k (K x^k in the low_memory mode) and returns the
+  ///        vector holding it in its first m entries.
+  const thrust::device_vector<T>& ComputeZ(cudaStream_t stream);
+
+  /// \brief One iteration of the low_memory mode, in which kx_ holds
+  ///        K (x^{k+1} + theta (x^{k+1} - x^k)) and the _prev vectors are
+  ///        not allocated.
+  void PerformLowMemoryIteration(cudaStream_t stream);
+
+  void DestroyGraph();
+  void ReleaseSnapshots();
+
+  /// \brief Prepares the persistent kernel if it is enabled and supports
+  ///        the problem.
+  void InitializePersistent();
+
+  /// \brief Sets tau and sigma to their initial values, divided by the
+  ///        operator norm if scale_steps_operator is set.
+  void ResetStepsizes();
   
 private:
   // \brief Primal variable x^k.
@@ -150,6 +326,72 @@ private:
   /// \brief For adaptive step size rule from Goldstein's paper
   T arg_alpha_;
 
+  /// \brief Running sums of x, y and K x since the last restart, T(z) of 
+  ///        their average and the last restart point.
+  thrust::device_vector<T> x_sum_, y_sum_, kx_sum_;
+  thrust::device_vector<T> x_plus_, y_plus_, kx_plus_;
+  thrust::device_vector<T> x_restart_, y_restart_;
+
+  /// \brief First iteration contained in the running sums.
+  size_t restart_iteration_;
+
+  /// \brief Fixed point residual at the last restart and at the last check,
+  ///        negative before the first check.
+  T restart_residual_, restart_residual_prev_;
+
+  /// \brief Use fused prox evaluation for prox_g / prox_fstar?
+  bool fused_primal_, fused_dual_;
+
+  /// \brief Set if AdjointStep already wrote the next primal prox argument
+  ///        into temp_ as an epilogue of K^T y.
+  bool primal_arg_ready_;
+
+  /// \brief Check the residuals asynchronously?
+  bool async_residuals_;
+
+  /// \brief Set while an asynchronous residual check is in flight.
+  bool residual_pending_;
+
+  /// \brief Iteration of the residual check in flight.
+  size_t residual_iteration_;
+
+  /// \brief Set while iterations are captured into a graph.
+  bool capturing_;
+
+  /// \brief Evaluate the primal-dual gap at the residual checks? Set if
+  ///        tol_gap is positive and all proxs support_energy().
+  bool gap_enabled_;
+
+  /// \brief Gap terms of prox_g in the first n and of prox_fstar in the
+  ///        last m entries, only allocated if gap_enabled_.
+  thrust::device_vector<T> gap_terms_;
+
+  /// \brief Sums |Kx - z|^2, |z|^2, |K^T y + w|^2 and |w|^2 on the device
+  ///        and their pinned host mirror.
+  ResidualSums<T> residual_sums_;
+
+  /// \brief Double-buffered solution snapshots and the stream copying them.
+  Snapshot snapshots_[2];
+  cudaStream_t snapshot_stream_;
+  size_t snapshot_count_;
+
+  /// \brief Number of iterations contained in one captured graph, 0 if the
+  ///        iteration cannot be captured.
+  int graph_length_;
+
+#if CUDART_VERSION >= 10010
+  /// \brief Instantiated graph of graph_length_ iterations.
+  cudaGraphExec_t graph_exec_;
+#endif
+
+  /// \brief Iteration parity and step sizes the graph was captured with.
+  size_t graph_parity_;
+  T graph_tau_, graph_sigma_, graph_theta_;
+
+  /// \brief Persistent kernel, empty if the iterations are launched 
+  ///        one by one.
+  shared_ptr<PersistentPDHG<T> > persistent_;
+
   /// \brief Internal prox_g
   vector< shared_ptr<Prox<T> > > prox_g_;
 
@@ -0,0 +1,176 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de>
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BACKEND_SPDHG_HPP_
+#define PROST_BACKEND_SPDHG_HPP_
+
+#include <random>
+
+#include <thrust/device_vector.h>
+
+#include "prost/backend/backend.hpp"
+#include "prost/common.hpp"
+
+namespace prost {
+
+template<typename T> class Prox;
+
+///
+/// \brief Stochastic primal-dual hybrid-gradient method ("Chambolle,
+///        Ehrhardt, Richtarik, Schoenlieb"). The dual variable is split
+///        into blocks, each a union of prox_fstar ranges and of parts of
+///        LinearOperator::RowPartition(). Every iteration updates a random
+///        subset of the blocks and only evaluates their rows of K, K^T y
+///        is kept up to date by the changes of the sampled blocks.
+///
+template<typename T>
+class BackendSPDHG : public Backend<T>
+{
+public:
+  struct Options
+  {
+    /// \brief Initial primal step size, multiplied by the probability of
+    ///        a block to be sampled.
+    double tau0;
+
+    /// \brief Initial dual step size.
+    double sigma0;
+
+    /// \brief Every how many iterations to compute the residuals? This
+    ///        costs a full evaluation of K, K^T and prox_fstar.
+    int residual_iter;
+
+    /// \brief Scale step sizes to ensure tau*sigma*||K||^2 = p.
+    bool scale_steps_operator;
+
+    /// \brief Relative tolerance for the estimate of ||K||.
+    T normest_tol;
+
+    /// \brief Fraction of the dual blocks updated per iteration.
+    T block_fraction;
+
+    /// \brief Seed of the block sampling.
+    unsigned int seed;
+  };
+
+  BackendSPDHG(const typename BackendSPDHG<T>::Options& opts);
+  virtual ~BackendSPDHG();
+
+  /// \brief Keeps the operator blocks and proxs apart, so that the dual
+  ///        blocks are not coarsened by merging.
+  virtual void PrepareProblem(Problem<T>& problem);
+
+  virtual void Initialize();
+  virtual void PerformIteration(cudaStream_t stream = 0);
+  virtual void Release();
+
+  virtual void ProblemChanged(cudaStream_t stream);
+
+  virtual void current_solution(vector<T>& primal, vector<T>& dual);
+
+  virtual void current_solution(vector<T>& primal_x,
+                                vector<T>& primal_z,
+                                vector<T>& dual_y,
+                                vector<T>& dual_w);
+
+  virtual bool device_solution() const { return true; }
+  virtual void SetIterateDevice(const T *x, const T *y, cudaStream_t stream);
+  virtual void current_solution_device(T *x, T *z, T *y, T *w, cudaStream_t stream);
+
+  /// \brief Returns amount of gpu memory required in bytes.
+  virtual size_t gpu_mem_amount() const;
+
+  /// \brief Number of dual blocks the rows are split into.
+  size_t num_dual_blocks() const { return dual_blocks_.size(); }
+
+protected:
+  /// \brief Computes x^{k+1} = prox_g(x^k - tau T zbar^k), the argument is
+  ///        kept in x_arg_.
+  void PrimalStep(cudaStream_t stream);
+
+  /// \brief Updates the sampled dual blocks and accumulates
+  ///        K^T (y^{k+1} - y^k) into dz_.
+  void DualStep(cudaStream_t stream);
+
+  /// \brief Computes the residuals of x^{k+1} and of a full dual step from
+  ///        y^{k+1}, which is not taken.
+  void ComputeResiduals(cudaStream_t stream);
+
+private:
+  /// \brief Rows [begin, end) of a dual block and its prox_fstar.
+  struct DualBlock
+  {
+    size_t begin;
+    size_t end;
+    vector< shared_ptr<Prox<T> > > proxs;
+  };
+
+  /// \brief Splits the rows into the dual blocks.
+  void BuildDualBlocks();
+
+  /// \brief Sets tau and sigma to their initial values, divided by the
+  ///        operator norm if scale_steps_operator is set.
+  void ResetStepsizes();
+
+  /// \brief Primal and dual variables.
+  thrust::device_vector<T> x_;
+  thrust::device_vector<T> y_;
+
+  /// \brief Argument of the last primal prox.
+  thrust::device_vector<T> x_arg_;
+
+  /// \brief z = K^T y, its extrapolation zbar = z + dz / p and the change
+  ///        dz = K^T (y^{k+1} - y^k) of the current iteration.
+  thrust::device_vector<T> z_;
+  thrust::device_vector<T> z_bar_;
+  thrust::device_vector<T> dz_;
+
+  /// \brief K x on the sampled rows, the dual prox argument and
+  ///        y^{k+1} - y^k. Full length, only the sampled rows are used.
+  thrust::device_vector<T> kx_;
+  thrust::device_vector<T> y_arg_;
+  thrust::device_vector<T> dy_;
+
+  vector<DualBlock> dual_blocks_;
+
+  /// \brief Permutation of the dual blocks, its first batch_ entries are
+  ///        the blocks sampled in the current iteration.
+  vector<size_t> order_;
+  size_t batch_;
+
+  /// \brief Probability of a block to be sampled.
+  T prob_;
+
+  std::mt19937 rng_;
+
+  T tau_;
+  T sigma_;
+
+  typename BackendSPDHG<T>::Options opts_;
+
+  size_t iteration_;
+
+  /// \brief prox_g or its Moreau version.
+  vector< shared_ptr<Prox<T> > > prox_g_;
+};
+
+} // namespace prost
+
+#endif // PROST_BACKEND_SPDHG_HPP_
@@ -0,0 +1,109 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_CHECKPOINT_HPP_
+#define PROST_CHECKPOINT_HPP_
+
+#include <atomic>
+#include <thread>
+
+#include <thrust/device_vector.h>
+#include <cuda_runtime.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+template<typename T> class Backend;
+
+///
+/// \brief Writes the complete state of a backend (see 
+///        Backend::StateVectors() and Backend::GetStateScalars()) to a
+///        file without stalling the iterations. The state vectors are 
+///        staged in device memory on the iteration stream, copied to 
+///        pinned memory on a side stream and written by a host thread, 
+///        first to path.tmp which then replaces path. Restore() resumes 
+///        a backend from the file exactly where the checkpoint was taken.
+///
+///        File layout: "PROSTCKP", uint32 version, uint32 sizeof(T), 
+///        uint64 iteration, uint64 number of scalars, the scalars as 
+///        doubles, uint64 number of vectors, uint64 size of each vector 
+///        and the vectors one after another.
+///
+template<typename T>
+class Checkpoint {
+public:
+  Checkpoint(const string& path);
+  ~Checkpoint();
+
+  /// \brief Starts writing the state of the backend after the given
+  ///        number of solver iterations, queued on the iteration stream.
+  ///        Returns false without doing anything if the previous 
+  ///        checkpoint is still being written. Throws an Exception if 
+  ///        writing the previous one failed.
+  bool Begin(Backend<T>& backend, int iteration, cudaStream_t stream);
+
+  /// \brief Waits until the last checkpoint is written. Throws an
+  ///        Exception if writing it failed.
+  void Finish();
+
+  /// \brief Restores the state of the initialized backend from the file
+  ///        and returns the iteration it was taken at, or -1 if the file
+  ///        does not exist. Throws an Exception if the file belongs to a
+  ///        different problem, backend or precision.
+  int Restore(Backend<T>& backend, cudaStream_t stream);
+
+  const string& path() const { return path_; }
+
+private:
+  /// \brief Runs on writer_, waits for the copy and writes the file.
+  void Write();
+
+  /// \brief Joins a finished writer and rethrows its error.
+  void Join();
+
+  string path_;
+
+  /// \brief Device the staging buffers live on, made current in writer_.
+  int device_;
+
+  /// \brief State vectors staged one after another in device memory and 
+  ///        their copy in pinned memory of capacity_ entries.
+  thrust::device_vector<T> staging_;
+  T *host_;
+  size_t capacity_;
+
+  cudaStream_t stream_;
+  cudaEvent_t staged_;
+  cudaEvent_t copied_;
+
+  /// \brief Contents of the checkpoint being written.
+  int iteration_;
+  vector<double> scalars_;
+  vector<size_t> sizes_;
+
+  std::thread writer_;
+  std::atomic<bool> written_;
+  string error_;
+};
+
+} // namespace prost
+
+#endif // PROST_CHECKPOINT_HPP_
@@ -0,0 +1,138 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PROST_CONVERGENCE_HISTORY_HPP_
+#define PROST_CONVERGENCE_HISTORY_HPP_
+
+#include <thrust/device_vector.h>
+#include <cuda_runtime.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+///
+/// \brief Telemetry of one iteration. Quantities a backend does not have
+///        (rho for PDHG, tau/sigma/theta for ADMM, residuals in iterations
+///        without evaluation) are NaN, cg_iters is -1 then.
+///
+template<typename T>
+struct HistoryEntry
+{
+  int iteration;
+  T primal_residual;
+  T dual_residual;
+  T eps_primal;
+  T eps_dual;
+  T tau;
+  T sigma;
+  T theta;
+  T rho;
+  int cg_iters;
+};
+
+///
+/// \brief Ring buffer in device memory the backends write one HistoryEntry
+///        per iteration into, without synchronizing with the host. The
+///        residuals and eps values are taken from the residual sums in
+///        device memory. The ring is copied to pinned memory on the
+///        iteration stream by Flush() and appended to entries() by the 
+///        following Flush() or Collect(). Entries overwritten before they 
+///        were flushed are counted in dropped().
+///
+///        Backends running on the host append to entries() directly with
+///        RecordHost().
+///
+template<typename T>
+class ConvergenceHistory {
+public:
+  ConvergenceHistory();
+  ~ConvergenceHistory();
+
+  /// \brief Allocates a ring of capacity entries, 0 disables the history.
+  ///        The eps values are eps_abs + tol_rel * norm as in 
+  ///        Backend::eps_primal/eps_dual.
+  void Initialize(size_t capacity, 
+                  T eps_abs_primal, 
+                  T tol_rel_primal,
+                  T eps_abs_dual,
+                  T tol_rel_dual);
+
+  /// \brief Frees the device and pinned memory, entries() are kept.
+  void Release();
+
+  bool enabled() const { return capacity_ > 0; }
+
+  /// \brief Discards the collected entries, called at the start of a solve.
+  void Clear();
+
+  /// \brief Queues entry into the ring on the stream. If d_sums is not
+  ///        nullptr, the residuals and eps values are computed from the 
+  ///        squared sums (|Kx - z|^2, |z|^2, |K^T y + w|^2, |w|^2) there,
+  ///        if d_cg_iters is not nullptr, the CG iterations are read from
+  ///        it when the kernel runs.
+  void Record(const HistoryEntry<T>& entry,
+              const T *d_sums,
+              const int *d_cg_iters,
+              cudaStream_t stream);
+
+  /// \brief Appends an entry computed on the host.
+  void RecordHost(const HistoryEntry<T>& entry);
+
+  /// \brief Collects the previous flush and starts copying the ring to
+  ///        pinned memory on the stream, without waiting for it.
+  void Flush(cudaStream_t stream);
+
+  /// \brief Waits for the last flush and appends its new entries.
+  void Collect();
+
+  const vector<HistoryEntry<T> >& entries() const { return entries_; }
+
+  /// \brief Number of entries lost since Clear(), because more than the
+  ///        capacity were recorded between two flushes.
+  size_t dropped() const { return dropped_; }
+
+  /// \brief NaN of T, used for the quantities a backend does not have.
+  static T nan();
+
+private:
+  size_t capacity_;
+  T eps_abs_primal_, tol_rel_primal_;
+  T eps_abs_dual_, tol_rel_dual_;
+
+  thrust::device_vector<HistoryEntry<T> > ring_;
+  HistoryEntry<T> *host_;
+  cudaEvent_t event_;
+
+  /// \brief Entries recorded into the ring, contained in the pending 
+  ///        flush and appended to entries_.
+  size_t recorded_;
+  size_t flushed_;
+  size_t collected_;
+  bool pending_;
+
+  vector<HistoryEntry<T> > entries_;
+  size_t dropped_;
+};
+
+} // namespace prost
+
+#endif // PROST_CONVERGENCE_HISTORY_HPP_
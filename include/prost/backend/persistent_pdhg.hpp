@@ -0,0 +1,182 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PERSISTENT_PDHG_HPP_
+#define PROST_PERSISTENT_PDHG_HPP_
+
+#include <thrust/device_vector.h>
+#include <cuda_runtime.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+template<typename T> class Problem;
+template<typename T> class Prox;
+template<typename T> class ResidualSums;
+
+///
+/// \brief Contiguous range of variables with the same elementwise prox in
+///        the persistent kernel: an ElemOperation1D, or the identity
+///        (ProxZero) if fun is negative.
+///
+template<typename T>
+struct PersistentProxSegment
+{
+  static const int kCoeffs = 7;
+
+  /// \brief First variable of the range.
+  size_t index;
+
+  /// \brief Function1D of the operation, see persistent_pdhg.cu.
+  int fun;
+
+  /// \brief Evaluate the conjugate prox via Moreau's identity?
+  bool moreau;
+
+  /// \brief Coefficients, per element if dev_p[i] is not null.
+  T *dev_p[kCoeffs];
+  T val[kCoeffs];
+};
+
+///
+/// \brief BlockGradient2D (dims = 2) or BlockGradient3D (dims = 3) 
+///        evaluated by the persistent kernel.
+///
+struct PersistentStencil
+{
+  size_t row;
+  size_t col;
+  size_t nx;
+  size_t ny;
+  size_t L;
+  int dims;
+  bool label_first;
+};
+
+///
+/// \brief Iterates and step sizes of BackendPDHG handed to and returned by
+///        PersistentPDHG::Run().
+///
+template<typename T>
+struct PersistentPDHGState
+{
+  T *x, *x_prev;
+  T *y, *y_prev;
+  T *kx, *kx_prev;
+  T *kty, *kty_prev;
+  const T *scaling_left;
+  const T *scaling_right;
+
+  T tau, sigma, theta;
+  size_t iteration;
+};
+
+///
+/// \brief Runs the iterations of BackendPDHG for small problems in a
+///        single cooperative kernel launch, whose blocks stay resident and
+///        synchronize through a grid-wide barrier between the primal step,
+///        the dual step with K x, K^T y and the residual reductions. This
+///        removes the launch latency which dominates the iterations of
+///        problems with few variables.
+///
+///        Only supports elementwise ElemOperation1D proxs (also batched
+///        or wrapped in ProxMoreau), ProxZero, blocks which store their
+///        entries and the matrix-free gradients. The stored blocks are 
+///        assembled into a CSR matrix and its transpose.
+///
+template<typename T>
+class PersistentPDHG
+{
+public:
+  struct Settings
+  {
+    /// \brief Every how many iterations the residuals are checked.
+    int residual_iter;
+
+    /// \brief Use the step sizes of the strongly convex scheme?
+    bool alg2;
+    T alg2_gamma;
+
+    /// \brief Stopping tolerances, eps = abs + rel * |z| (|w| resp.).
+    T eps_abs_primal, eps_rel_primal;
+    T eps_abs_dual, eps_rel_dual;
+  };
+
+  PersistentPDHG();
+  ~PersistentPDHG();
+
+  /// \brief Prepares the problem for the kernel, returns false if some
+  ///        prox or block is not supported or the device can not launch
+  ///        cooperative kernels.
+  bool Initialize(
+    Problem<T>& problem,
+    const vector<shared_ptr<Prox<T>>>& prox_g,
+    const vector<shared_ptr<Prox<T>>>& prox_fstar,
+    const Settings& settings);
+
+  void Release();
+
+  /// \brief Performs up to count iterations on the given state and stops
+  ///        early if the residuals, checked every residual_iter and in the
+  ///        last iteration, meet the tolerances. The residual sums of the
+  ///        last iteration are copied to the host mirror of sums. Returns the number of 
+  ///        iterations performed and updates the step sizes and the
+  ///        iteration of state. Each iteration swaps the pointers of the
+  ///        current and previous iterates, the caller has to swap its
+  ///        buffers if an odd number of iterations was performed.
+  int Run(PersistentPDHGState<T>& state, int count, ResidualSums<T>& sums, cudaStream_t stream);
+
+  size_t gpu_mem_amount() const;
+
+private:
+  Settings settings_;
+
+  size_t nrows_;
+  size_t ncols_;
+
+  /// \brief Stored blocks as CSR matrix and its transpose.
+  thrust::device_vector<int32_t> row_ptr_, row_ind_;
+  thrust::device_vector<T> row_val_;
+  thrust::device_vector<int32_t> col_ptr_, col_ind_;
+  thrust::device_vector<T> col_val_;
+
+  thrust::device_vector<PersistentStencil> stencils_;
+
+  /// \brief Prox segments and the segment of each primal and dual 
+  ///        variable, -1 for variables without prox.
+  thrust::device_vector<PersistentProxSegment<T> > segments_;
+  thrust::device_vector<int32_t> segment_g_, segment_f_;
+
+  /// \brief Counter and generation of the grid barrier.
+  thrust::device_vector<unsigned int> barrier_;
+
+  /// \brief Step sizes and number of iterations at the end of a launch
+  ///        and their pinned host mirror.
+  thrust::device_vector<double> status_;
+  double *host_status_;
+
+  /// \brief Number of thread blocks of the cooperative launch.
+  int grid_size_;
+};
+
+} // namespace prost
+
+#endif // PROST_PERSISTENT_PDHG_HPP_
@@ -0,0 +1,101 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_RESIDUAL_SCHEDULE_HPP_
+#define PROST_RESIDUAL_SCHEDULE_HPP_
+
+#include <cstddef>
+#include <vector>
+
+namespace prost {
+
+///
+/// \brief Decides in which iterations a backend evaluates the residuals.
+///        In the fixed mode every interval-th iteration is checked. The
+///        adaptive mode extrapolates the decay of the residuals relative 
+///        to the stopping tolerances and places the next check halfway to
+///        the predicted convergence point. This spaces the checks far
+///        apart early on and densely close to convergence.
+///
+class ResidualSchedule {
+public:
+  ResidualSchedule();
+
+  /// \brief Starts a new schedule. In the adaptive mode interval is the
+  ///        smallest spacing of two checks and max_interval the largest.
+  ///        A non-positive interval in the fixed mode only checks the 
+  ///        first iteration.
+  void Reset(int interval, bool adaptive, int max_interval);
+
+  /// \brief Forgets the measured decay, e.g. after the problem changed, 
+  ///        and requests a check of the next iteration.
+  void Restart();
+
+  /// \brief Requests a check in the next iteration, used for callbacks
+  ///        and after the problem changed.
+  void Request() { requested_ = true; }
+
+  /// \brief True if a check was requested and not issued yet.
+  bool requested() const { return requested_; }
+
+  /// \brief Returns true if the residuals are evaluated in the iteration.
+  bool is_due(size_t iteration) const;
+
+  /// \brief First iteration after the given one which is due, assuming 
+  ///        no further requests.
+  size_t next_due(size_t iteration) const;
+
+  /// \brief Called when the check of the given iteration has been issued.
+  void Issued(size_t iteration);
+
+  /// \brief Called with the residuals relative to their stopping epsilons
+  ///        once the check of the given iteration completed.
+  void Update(size_t iteration, double primal_ratio, double dual_ratio);
+
+  bool adaptive() const { return adaptive_; }
+
+  /// \brief Appends the state of the schedule to state, for checkpoints.
+  void GetState(std::vector<double>& state) const;
+
+  /// \brief Restores the state written by GetState() from state[pos], 
+  ///        advancing pos past it.
+  void SetState(const std::vector<double>& state, size_t& pos);
+
+private:
+  bool adaptive_;
+  int interval_;
+  int max_interval_;
+
+  /// \brief Current spacing and next iteration checked in the adaptive mode.
+  size_t gap_;
+  size_t next_;
+  bool requested_;
+
+  /// \brief Last completed check and the smoothed decay of log(ratio) per
+  ///        iteration.
+  bool has_prev_;
+  size_t prev_iteration_;
+  double prev_log_ratio_;
+  double rate_;
+};
+
+} // namespace prost
+
+#endif // PROST_RESIDUAL_SCHEDULE_HPP_
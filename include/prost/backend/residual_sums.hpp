@@ -0,0 +1,196 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_RESIDUAL_SUMS_HPP_
+#define PROST_RESIDUAL_SUMS_HPP_
+
+#include <thrust/device_vector.h>
+#include <thrust/functional.h>
+#include <thrust/tuple.h>
+#include <cuda_runtime.h>
+
+#include "prost/common.hpp"
+#include "prost/config.hpp"
+
+namespace prost {
+
+///
+/// \brief Device buffers of the fused residual reductions of the backends.
+///        The kernels accumulate the primal residual, primal variable norm,
+///        dual residual and dual variable norm (squared) with
+///        ResidualSumsReduce(), which are then read back to the host in a
+///        single transfer through pinned memory.
+///
+template<typename T>
+class ResidualSums {
+public:
+  static const int kNumSums = 4;
+
+  ResidualSums();
+  ~ResidualSums();
+
+  void Initialize();
+  void Release();
+
+  /// \brief Number of thread blocks of a reduction over count elements.
+  static size_t grid_size(size_t count);
+
+  T *d_sums() { return thrust::raw_pointer_cast(sums_.data()); }
+  T *d_partials() { return thrust::raw_pointer_cast(partials_.data()); }
+  unsigned int *d_count() { return thrust::raw_pointer_cast(count_.data()); }
+
+  /// \brief Starts the transfer of the sums to the host on the stream.
+  void CopyToHost(cudaStream_t stream);
+
+  /// \brief Returns true if the last transfer finished, waits for it if 
+  ///        block is set.
+  bool Ready(bool block);
+
+  /// \brief Sums of the last finished transfer.
+  const T *host() const { return host_; }
+
+private:
+  /// \brief Sums of the four quantities.
+  thrust::device_vector<T> sums_;
+
+  /// \brief Per-block partial sums, up to kResidualSumsMaxBlocks * kNumSums.
+  thrust::device_vector<T> partials_;
+
+  /// \brief Number of blocks which wrote their partial sums, reset to zero
+  ///        by the last one.
+  thrust::device_vector<unsigned int> count_;
+
+  T *host_;
+  cudaEvent_t event_;
+};
+
+#if defined(__CUDACC__)
+
+/// \brief Computes the (scaled) dual residual 
+template<typename T>
+struct dual_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T,T,T>, thrust::tuple<T,T> >
+{
+  typedef typename thrust::tuple<T,T,T,T,T> InputTuple;
+  typedef typename thrust::tuple<T,T> OutputTuple;
+
+  __host__ __device__ dual_residual_transform(T tau)
+  : tau_(tau) { }
+
+  __host__ __device__
+  OutputTuple operator()(const InputTuple& t)
+  {
+    const T tau_diag = thrust::get<2>(t);
+    const T w_hat = (thrust::get<0>(t) - thrust::get<1>(t)) / (tau_ * sqrt(tau_diag)) - 
+                    sqrt(tau_diag) * thrust::get<3>(t);
+    const T diff = w_hat + sqrt(tau_diag) * thrust::get<4>(t); // w_hat^{k+1} + T K^T y^{k+1}
+
+    return OutputTuple(diff * diff, w_hat * w_hat);
+  }  
+
+  T tau_;
+};
+
+/// \brief Computes the (scaled) primal residual
+template<typename T>
+struct primal_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T,T,T>, thrust::tuple<T, T> >
+{
+  typedef typename thrust::tuple<T,T,T,T,T> InputTuple;
+  typedef typename thrust::tuple<T,T> OutputTuple;
+
+  __host__ __device__ primal_residual_transform(T sigma, T theta)
+      : sigma_(sigma), theta_(theta) { }
+
+  __host__ __device__
+  OutputTuple operator()(const InputTuple& t)
+  {
+    const T sigma_diag = thrust::get<2>(t);
+    const T z_hat = (thrust::get<0>(t) - thrust::get<1>(t)) / (sigma_ * sqrt(sigma_diag)) +
+                    sqrt(sigma_diag) * ((1 + theta_) * thrust::get<4>(t) - theta_ * thrust::get<3>(t));
+      
+    const T diff = z_hat - sqrt(sigma_diag) * thrust::get<4>(t);
+
+    return OutputTuple(diff * diff, z_hat * z_hat);
+  }  
+
+  T sigma_;
+  T theta_;
+};
+
+///
+/// \brief Adds up acc over all threads of the grid and stores the result in
+///        d_sums[0..N). Each block writes its partial sums, the last block
+///        to finish reduces them in a fixed order, so the result does not
+///        depend on the scheduling. Requires blockDim.x == kBlockSizeCUDA 
+///        and has to be reached by all threads of the block.
+///
+template<typename T, int N>
+__device__ void ResidualSumsReduce(
+  T (&acc)[N],
+  T *d_partials,
+  T *d_sums,
+  unsigned int *d_count)
+{
+  __shared__ T sh[N][kBlockSizeCUDA];
+  __shared__ bool is_last;
+
+  const unsigned int tid = threadIdx.x;
+
+  for(int k = 0; k < N; k++)
+    sh[k][tid] = acc[k];
+  __syncthreads();
+
+  for(unsigned int s = blockDim.x / 2; s > 0; s >>= 1)
+  {
+    if(tid < s)
+      for(int k = 0; k < N; k++)
+        sh[k][tid] += sh[k][tid + s];
+
+    __syncthreads();
+  }
+
+  if(tid == 0)
+  {
+    for(int k = 0; k < N; k++)
+      d_partials[blockIdx.x * N + k] = sh[k][0];
+
+    __threadfence();
+
+    // wraps around to zero for the last block
+    is_last = (atomicInc(d_count, gridDim.x - 1) == gridDim.x - 1);
+  }
+  __syncthreads();
+
+  if(is_last && tid < N)
+  {
+    const volatile T *partials = d_partials;
+
+    T sum = 0;
+    for(unsigned int b = 0; b < gridDim.x; b++)
+      sum += partials[b * N + tid];
+
+    d_sums[tid] = sum;
+  }
+}
+
+#endif
+
+} // namespace prost
+
+#endif // PROST_RESIDUAL_SUMS_HPP_
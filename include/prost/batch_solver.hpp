@@ -0,0 +1,173 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BATCH_SOLVER_HPP_
+#define PROST_BATCH_SOLVER_HPP_
+
+#include <thrust/device_vector.h>
+
+#include "prost/common.hpp"
+#include "prost/solver.hpp"
+
+namespace prost {
+
+template<typename T> class Problem;
+template<typename T> class Backend;
+template<typename T> class Prox;
+
+/// 
+/// \brief Solves many graph-form problems of identical structure at once.
+///        All instances share one backend, one set of library handles and
+///        one launch sequence per iteration.
+///
+///        The variables are laid out by structure: the copies of a prox in
+///        all instances are placed next to each other and evaluated by one
+///        batched prox (Prox::CreateBatch), and the entries of the blocks
+///        of all instances are assembled into a single sparse block. If 
+///        the instances differ in the layout of their proxs, a block does
+///        not provide its entries or a custom scaling is set, the instances
+///        are stacked one after another into a block-diagonal problem
+///        instead, see strided().
+///
+///        Primal and dual residuals |K x - z| and |K^T y + w| are tracked
+///        per instance at the callback iterations (num_cback_calls) and
+///        after the solve. An instance below its tolerances is marked as
+///        converged and its solution is frozen, the solve stops once all
+///        instances converged. The iterations still run over the whole
+///        batch, a converged instance costs as much as an active one.
+///
+/// @tparam typename T. Floating point-type.
+/// 
+template<typename T>
+class BatchSolver {
+public:
+  /// \brief Adds the blocks and proxs of one instance to the problem. 
+  ///        Arguments: (instance, row offset, column offset, problem). All
+  ///        indices of the instance have to be shifted by the offsets. The
+  ///        builder is called with zero offsets and a problem of its own
+  ///        for each instance, and again with the offsets into problem()
+  ///        if the instances have to be stacked.
+  typedef function<void(size_t, size_t, size_t, Problem<T>&)> InstanceBuilder;
+
+  /// \brief Creates a batch of num_instances problems with nrows x ncols 
+  ///        linear operators each.
+  BatchSolver(
+    size_t num_instances, 
+    size_t nrows, 
+    size_t ncols, 
+    shared_ptr<Backend<T>> backend);
+  virtual ~BatchSolver() {}
+
+  /// \brief Builds the batched problem and initializes the solver. Scaling 
+  ///        has to be set on problem() beforehand. The initial solutions in
+  ///        the options are given instance after instance. Presolve and 
+  ///        solving the dual problem are not supported.
+  void Initialize(const InstanceBuilder& builder);
+  typename Solver<T>::ConvergenceResult Solve();
+  void Release();
+
+  void SetOptions(const typename Solver<T>::Options &opts);
+  void SetStoppingCallback(const typename Solver<T>::StoppingCallback& cb);
+  void SetIntermCallback(const typename Solver<T>::IntermCallback& cb);
+
+  /// \brief Batched problem, e.g. to set the scaling before Initialize().
+  shared_ptr<Problem<T>> problem() const { return problem_; }
+
+  size_t num_instances() const { return num_instances_; }
+
+  /// \brief True if the variables are laid out by structure, false if the
+  ///        instances are stacked one after another.
+  bool strided() const { return strided_; }
+
+  /// \brief Index of column col (row row) of an instance in problem().
+  size_t primal_index(size_t instance, size_t col) const { return col_index_[instance * ncols_ + col]; }
+  size_t dual_index(size_t instance, size_t row) const { return row_index_[instance * nrows_ + row]; }
+
+  /// \brief Copies the solution of one instance, frozen at the check it
+  ///        converged in, or the final iterate if it did not converge.
+  void instance_primal_sol(size_t instance, vector<T>& x) const;
+  void instance_dual_sol(size_t instance, vector<T>& y) const;
+
+  /// \brief Convergence of the instances at the last check.
+  bool instance_converged(size_t instance) const { return converged_[instance]; }
+  size_t num_converged() const;
+  T instance_primal_residual(size_t instance) const { return primal_residual_[instance]; }
+  T instance_dual_residual(size_t instance) const { return dual_residual_[instance]; }
+
+protected:
+  typedef vector<shared_ptr<Prox<T>>> ProxList;
+
+  /// \brief Builds the instances into problems of their own and moves 
+  ///        their proxs and entries into problem(). Returns false if the
+  ///        instances have to be stacked.
+  bool BuildStrided(const InstanceBuilder& builder);
+
+  /// \brief Builds the block-diagonal problem, instance after instance.
+  void BuildStacked(const InstanceBuilder& builder);
+
+  /// \brief Computes the residuals of the instances from sol, marks the
+  ///        ones below their tolerances and freezes their solution. Writes
+  ///        the primal residuals, dual residuals and the masks (0: active,
+  ///        1: converged before, 2: converged now) to d_values, 3 
+  ///        num_instances values.
+  void CheckInstances(const typename Solver<T>::DeviceSolution& sol, T *d_values);
+
+  /// \brief Reads the values of CheckInstances() on the host, returns true
+  ///        if all instances converged.
+  bool ReadInstances(const vector<T>& values);
+
+  size_t num_instances_;
+  size_t nrows_;
+  size_t ncols_;
+  bool strided_;
+
+  shared_ptr<Problem<T>> problem_;
+  shared_ptr<Backend<T>> backend_;
+  shared_ptr<Solver<T>> solver_;
+
+  typename Solver<T>::Options opts_;
+  typename Solver<T>::IntermCallback interm_cb_;
+  typename Solver<T>::StoppingCallback stopping_cb_;
+
+  /// \brief Index in problem() of each column (row) of each instance, 
+  ///        instance after instance.
+  vector<size_t> col_index_;
+  vector<size_t> row_index_;
+  thrust::device_vector<size_t> d_col_index_;
+  thrust::device_vector<size_t> d_row_index_;
+
+  /// \brief Per-instance state of CheckInstances().
+  thrust::device_vector<int> d_mask_;
+  thrust::device_vector<T> d_residuals_;
+  thrust::device_vector<T> d_frozen_x_;
+  thrust::device_vector<T> d_frozen_y_;
+
+  /// \brief Solution and K x, K^T y for CheckInstances().
+  thrust::device_vector<T> d_x_, d_z_, d_y_, d_w_;
+  thrust::device_vector<T> d_kx_, d_kty_;
+
+  vector<bool> converged_;
+  vector<T> primal_residual_;
+  vector<T> dual_residual_;
+};
+
+} // namespace prost
+
+#endif // PROST_BATCH_SOLVER_HPP_
@@ -0,0 +1,518 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_CGLS_FUSED_HPP_
+#define PROST_CGLS_FUSED_HPP_
+
+// CGLS with fused vector updates and reductions whose scalars stay on the
+// device, only include from .cu files.
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+#include <cuda_runtime.h>
+#include <thrust/device_vector.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+using thrust::device_vector;
+
+/// \brief Number of thread blocks of the reduction kernels, whose partial
+///        sums are combined by a single block in the finalize kernel.
+static const int kFusedCGLSPartials = 256;
+
+// the reduction kernels run with kBlockSizeCUDA threads, halving the
+// shared array in each step
+static_assert(kBlockSizeCUDA > 0 && (kBlockSizeCUDA & (kBlockSizeCUDA - 1)) == 0,
+              "FusedCGLS: kBlockSizeCUDA has to be a power of two.");
+
+/// \brief State of the iteration, resident on the device.
+struct FusedCGLSScalars
+{
+  double gamma, gamma0, alpha, beta, normx2, xmax2;
+  int converged, indefinite, iterations;
+};
+
+enum FusedCGLSFinalize
+{
+  kFusedCGLSFinalizeInit,
+  kFusedCGLSFinalizeDelta,
+  kFusedCGLSFinalizeGamma,
+};
+
+/// 
+/// \brief d_partials[block] = (\sum_{i<n} a_i^2, \sum_{i<m} c_i^2).
+/// 
+template<typename T>
+__global__
+void FusedCGLSNormsKernel(
+  double2 *d_partials,
+  const T *d_a,
+  size_t n,
+  const T *d_c,
+  size_t m,
+  const FusedCGLSScalars *d_scalars)
+{
+  __shared__ double2 sh[kBlockSizeCUDA];
+
+  double2 sum = make_double2(0, 0);
+
+  if(!d_scalars->converged)
+  {
+    const size_t count = max(n, m);
+
+    for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < count; i += blockDim.x * gridDim.x)
+    {
+      if(i < n)
+        sum.x += static_cast<double>(d_a[i]) * d_a[i];
+
+      if(i < m)
+        sum.y += static_cast<double>(d_c[i]) * d_c[i];
+    }
+  }
+
+  sh[threadIdx.x] = sum;
+  __syncthreads();
+
+  for(int s = blockDim.x / 2; s > 0; s >>= 1)
+  {
+    if(threadIdx.x < s)
+    {
+      sh[threadIdx.x].x += sh[threadIdx.x + s].x;
+      sh[threadIdx.x].y += sh[threadIdx.x + s].y;
+    }
+
+    __syncthreads();
+  }
+
+  if(threadIdx.x == 0)
+    d_partials[blockIdx.x] = sh[0];
+}
+
+/// 
+/// \brief z = s / diag (or z = s if d_diag is null) and
+///        d_partials[block] = (\sum_i s_i z_i, \sum_i x_i^2).
+/// 
+template<typename T>
+__global__
+void FusedCGLSPrecondKernel(
+  double2 *d_partials,
+  T *d_z,
+  const T *d_s,
+  const T *d_diag,
+  const T *d_x,
+  size_t n,
+  const FusedCGLSScalars *d_scalars)
+{
+  __shared__ double2 sh[kBlockSizeCUDA];
+
+  double2 sum = make_double2(0, 0);
+
+  if(!d_scalars->converged)
+  {
+    for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < n; i += blockDim.x * gridDim.x)
+    {
+      const T s = d_s[i];
+      const T z = (d_diag == nullptr) ? s : s / d_diag[i];
+      const T x = d_x[i];
+
+      d_z[i] = z;
+      sum.x += static_cast<double>(s) * z;
+      sum.y += static_cast<double>(x) * x;
+    }
+  }
+
+  sh[threadIdx.x] = sum;
+  __syncthreads();
+
+  for(int s = blockDim.x / 2; s > 0; s >>= 1)
+  {
+    if(threadIdx.x < s)
+    {
+      sh[threadIdx.x].x += sh[threadIdx.x + s].x;
+      sh[threadIdx.x].y += sh[threadIdx.x + s].y;
+    }
+
+    __syncthreads();
+  }
+
+  if(threadIdx.x == 0)
+    d_partials[blockIdx.x] = sh[0];
+}
+
+/// 
+/// \brief Sums up the partials in a single block and updates the scalars:
+///        init:  gamma = gamma0 = s^T z, |x|^2
+///        delta: alpha = gamma / (|q|^2 + shift |p|^2)
+///        gamma: beta = s^T z / gamma, convergence test.
+/// 
+static __global__
+void FusedCGLSFinalizeKernel(
+  FusedCGLSScalars *d_scalars,
+  const double2 *d_partials,
+  int num_partials,
+  int mode,
+  double shift,
+  double tol,
+  double eps)
+{
+  __shared__ double2 sh[kBlockSizeCUDA];
+
+  double2 sum = make_double2(0, 0);
+  for(int i = threadIdx.x; i < num_partials; i += blockDim.x)
+  {
+    sum.x += d_partials[i].x;
+    sum.y += d_partials[i].y;
+  }
+
+  sh[threadIdx.x] = sum;
+  __syncthreads();
+
+  for(int s = blockDim.x / 2; s > 0; s >>= 1)
+  {
+    if(threadIdx.x < s)
+    {
+      sh[threadIdx.x].x += sh[threadIdx.x + s].x;
+      sh[threadIdx.x].y += sh[threadIdx.x + s].y;
+    }
+
+    __syncthreads();
+  }
+
+  if(threadIdx.x != 0)
+    return;
+
+  FusedCGLSScalars& sc = *d_scalars;
+
+  if(mode == kFusedCGLSFinalizeInit)
+  {
+    sc.gamma = sc.gamma0 = sh[0].x;
+    sc.normx2 = sc.xmax2 = sh[0].y;
+    sc.alpha = sc.beta = 0;
+    sc.indefinite = 0;
+    sc.iterations = 0;
+    sc.converged = (sqrt(sc.gamma0) < eps) ? 1 : 0;
+    return;
+  }
+
+  if(sc.converged)
+    return;
+
+  if(mode == kFusedCGLSFinalizeDelta)
+  {
+    // sh[0].x = |p|^2, sh[0].y = |q|^2
+    double delta = sh[0].y + shift * sh[0].x;
+
+    if(delta <= 0)
+      sc.indefinite = 1;
+
+    if(delta == 0)
+      delta = eps;
+
+    sc.alpha = sc.gamma / delta;
+  }
+  else
+  {
+    const double gamma1 = sc.gamma;
+
+    sc.gamma = sh[0].x;
+    sc.beta = sc.gamma / gamma1;
+    sc.normx2 = sh[0].y;
+    sc.xmax2 = max(sc.xmax2, sc.normx2);
+    sc.iterations++;
+    sc.converged = (sc.gamma <= sc.gamma0 * tol * tol) || (sc.normx2 * tol * tol >= 1);
+  }
+}
+
+/// 
+/// \brief x += alpha p, r -= alpha q and s = x to prepare s = A^T r - shift x.
+/// 
+template<typename T>
+__global__
+void FusedCGLSUpdateKernel(
+  T *d_x,
+  T *d_s,
+  const T *d_p,
+  size_t n,
+  T *d_r,
+  const T *d_q,
+  size_t m,
+  const FusedCGLSScalars *d_scalars)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+  const bool converged = d_scalars->converged;
+  const T alpha = static_cast<T>(d_scalars->alpha);
+
+  if(tx < n)
+  {
+    T x = d_x[tx];
+
+    if(!converged)
+    {
+      x += alpha * d_p[tx];
+      d_x[tx] = x;
+    }
+
+    d_s[tx] = x;
+  }
+
+  if(tx < m && !converged)
+    d_r[tx] -= alpha * d_q[tx];
+}
+
+/// 
+/// \brief p = z + beta p.
+/// 
+template<typename T>
+__global__
+void FusedCGLSDirectionKernel(
+  T *d_p,
+  const T *d_z,
+  size_t n,
+  const FusedCGLSScalars *d_scalars)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx >= n || d_scalars->converged)
+    return;
+
+  d_p[tx] = d_z[tx] + static_cast<T>(d_scalars->beta) * d_p[tx];
+}
+
+///
+/// \brief Jacobi preconditioned CGLS for min |A x - b|^2 + shift |x|^2, in
+///        which all vector updates and reductions are fused into a few
+///        kernels and the scalars of the iteration stay on the device.
+///
+/// The iteration does not synchronize with the host except for reading
+/// the convergence flag every check_iter iterations. Once converged, the
+/// fused kernels until the next check return without touching x, r and p,
+/// but the operator applications A p and A^T r are launched by the host
+/// and still run in full. Up to check_iter - 1 iterations of operator
+/// cost are spent after convergence, a smaller check_iter trades them for
+/// more synchronizations. The preconditioner approximates
+/// diag(A^T A) + shift, if it is empty plain CGLS is run.
+///
+template<typename T>
+class FusedCGLS {
+public:
+  FusedCGLS() : host_scalars_(nullptr) { }
+  ~FusedCGLS() { Release(); }
+
+  /// \brief Allocates the scratch memory for n unknowns.
+  void Initialize(size_t n)
+  {
+    Release();
+
+    try
+    {
+      z_.resize(n);
+      partials_.resize(kFusedCGLSPartials);
+      scalars_.resize(1);
+    }
+    catch(std::bad_alloc& e)
+    {
+      std::stringstream ss;
+      ss << "Out of memory: " << e.what();
+      throw Exception(ss.str());
+    }
+
+    if(cudaMallocHost(&host_scalars_, sizeof(FusedCGLSScalars)) != cudaSuccess)
+      throw Exception("FusedCGLS: failed to allocate pinned memory.");
+  }
+
+  void Release()
+  {
+    if(host_scalars_ != nullptr)
+    {
+      cudaFreeHost(host_scalars_);
+      host_scalars_ = nullptr;
+    }
+
+    z_.clear();
+    partials_.clear();
+    scalars_.clear();
+  }
+
+  /// \brief Preconditioner diag, the Solve uses z = s / diag.
+  device_vector<T>& diag() { return diag_; }
+
+  /// \brief Iterations the last Solve actually ran, in device memory.
+  const int *d_iterations() const
+  {
+    return &thrust::raw_pointer_cast(scalars_.data())->iterations;
+  }
+
+  /// \brief Runs at most maxit iterations of CGLS, with vectors as in
+  ///        cgls::Solve and the operator A a GemvPrecondK-like functor.
+  ///        Returns the number of iterations after which the convergence
+  ///        was detected on the host.
+  template<typename F>
+  int Solve(
+    const F& A,
+    size_t m,
+    size_t n,
+    const device_vector<T>& b,
+    device_vector<T>& x,
+    double shift,
+    double tol,
+    int maxit,
+    int check_iter,
+    device_vector<T>& p, // size=n
+    device_vector<T>& q, // size=m
+    device_vector<T>& r, // size=m
+    device_vector<T>& s, // size=n
+    cudaStream_t stream)
+  {
+    const double eps = std::numeric_limits<T>::epsilon();
+    const T *d_diag = diag_.empty() ? nullptr : thrust::raw_pointer_cast(diag_.data());
+    FusedCGLSScalars *d_scalars = thrust::raw_pointer_cast(scalars_.data());
+    double2 *d_partials = thrust::raw_pointer_cast(partials_.data());
+
+    dim3 block(kBlockSizeCUDA, 1, 1);
+    dim3 grid_n((n + block.x - 1) / block.x, 1, 1);
+    dim3 grid_l((std::max(n, m) + block.x - 1) / block.x, 1, 1);
+    dim3 grid_red(std::min<size_t>(kFusedCGLSPartials, std::max<size_t>(grid_l.x, 1)), 1, 1);
+
+    // r = b - A x, s = A^T r - shift x
+    thrust::copy(thrust::cuda::par.on(stream), b.begin(), b.end(), r.begin());
+    thrust::copy(thrust::cuda::par.on(stream), x.begin(), x.end(), s.begin());
+    A('n', -1, x, 1, r);
+    A('t', 1, r, static_cast<T>(-shift), s);
+
+    // z = D^{-1} s, gamma = s^T z, p = z
+    FusedCGLSPrecondKernel<T>
+      <<<grid_red, block, 0, stream>>>(
+        d_partials,
+        thrust::raw_pointer_cast(z_.data()),
+        thrust::raw_pointer_cast(s.data()),
+        d_diag,
+        thrust::raw_pointer_cast(x.data()),
+        n,
+        d_scalars);
+
+    FusedCGLSFinalizeKernel
+      <<<1, block, 0, stream>>>(d_scalars, d_partials, grid_red.x,
+                                kFusedCGLSFinalizeInit, shift, tol, eps);
+
+    thrust::copy(thrust::cuda::par.on(stream), z_.begin(), z_.end(), p.begin());
+
+    int k;
+    for(k = 0; k < maxit; k++)
+    {
+      // q = A p, alpha = gamma / (|q|^2 + shift |p|^2)
+      A('n', 1, p, 0, q);
+
+      FusedCGLSNormsKernel<T>
+        <<<grid_red, block, 0, stream>>>(
+          d_partials,
+          thrust::raw_pointer_cast(p.data()), n,
+          thrust::raw_pointer_cast(q.data()), m,
+          d_scalars);
+
+      FusedCGLSFinalizeKernel
+        <<<1, block, 0, stream>>>(d_scalars, d_partials, grid_red.x,
+                                  kFusedCGLSFinalizeDelta, shift, tol, eps);
+
+      // x += alpha p, r -= alpha q
+      FusedCGLSUpdateKernel<T>
+        <<<grid_l, block, 0, stream>>>(
+          thrust::raw_pointer_cast(x.data()),
+          thrust::raw_pointer_cast(s.data()),
+          thrust::raw_pointer_cast(p.data()),
+          n,
+          thrust::raw_pointer_cast(r.data()),
+          thrust::raw_pointer_cast(q.data()),
+          m,
+          d_scalars);
+
+      // s = A^T r - shift x
+      A('t', 1, r, static_cast<T>(-shift), s);
+
+      // z = D^{-1} s, beta = s^T z / gamma
+      FusedCGLSPrecondKernel<T>
+        <<<grid_red, block, 0, stream>>>(
+          d_partials,
+          thrust::raw_pointer_cast(z_.data()),
+          thrust::raw_pointer_cast(s.data()),
+          d_diag,
+          thrust::raw_pointer_cast(x.data()),
+          n,
+          d_scalars);
+
+      FusedCGLSFinalizeKernel
+        <<<1, block, 0, stream>>>(d_scalars, d_partials, grid_red.x,
+                                  kFusedCGLSFinalizeGamma, shift, tol, eps);
+
+      // p = z + beta p
+      FusedCGLSDirectionKernel<T>
+        <<<grid_n, block, 0, stream>>>(
+          thrust::raw_pointer_cast(p.data()),
+          thrust::raw_pointer_cast(z_.data()),
+          n,
+          d_scalars);
+
+      if(check_iter > 0 && ((k + 1) % check_iter) == 0 && k + 1 < maxit)
+      {
+        cudaMemcpyAsync(host_scalars_, d_scalars, sizeof(FusedCGLSScalars),
+                        cudaMemcpyDeviceToHost, stream);
+        cudaStreamSynchronize(stream);
+
+        if(host_scalars_->converged)
+        {
+          k++;
+          break;
+        }
+      }
+    }
+
+    cudaError_t err = cudaGetLastError();
+    if(err != cudaSuccess)
+    {
+      std::stringstream ss;
+      ss << "FusedCGLS: CUDA error: " << cudaGetErrorString(err) << std::endl;
+      throw Exception(ss.str());
+    }
+
+    return k;
+  }
+
+  size_t gpu_mem_amount() const
+  {
+    return (z_.size() + diag_.size()) * sizeof(T) + 
+      partials_.size() * sizeof(double2) + sizeof(FusedCGLSScalars);
+  }
+
+private:
+  device_vector<T> z_;
+  device_vector<T> diag_;
+  device_vector<double2> partials_;
+  device_vector<FusedCGLSScalars> scalars_;
+  FusedCGLSScalars *host_scalars_;
+};
+
+} // namespace prost
+
+#endif // PROST_CGLS_FUSED_HPP_
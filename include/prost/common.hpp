@@ -21,6 +21,7 @@
 #ifndef PROST_COMMON_HPP_
 #define PROST_COMMON_HPP_
 
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <list>
@@ -30,6 +31,8 @@
 #include <string>
 #include <sstream>
 
+#include <cuda_runtime.h>
+
 namespace prost {
 
 // common functions from standard library
@@ -47,14 +50,26 @@ string get_version();
 template<typename T> list<double> linspace(T start_in, T end_in, int num_in);
 int _ConvertSMVer2Cores(int major, int minor);
 
+/// \brief Returns a number which is unique within the process, used to
+///        identify the current state of objects changed in place.
+uint64_t new_version_id();
+
 /// \brief Helper function that converts CSR format to CSC format, 
 ///        not in-place, if a == NULL, only pattern is reorganized
-///        the size of matrix is n x m.
+///        the size of matrix is n x m. Runs on several threads with
+///        OpenMP for large matrices, the row indices of each column are
+///        sorted in any case.
 template<typename T>
 void csr2csc(int n, int m, int nz, 
              T *a, int *col_idx, int *row_start,
              T *csc_a, int *row_idx, int *col_start); 
 
+/// \brief Converts count entries of a device array to another floating 
+///        point type on the GPU, asynchronously on the given stream. Used
+///        by the MATLAB interface for gpuArrays of the other precision.
+template<typename S, typename T>
+void ConvertDevice(const S *src, T *dst, size_t count, cudaStream_t stream = 0);
+
 #if defined(_MSC_VER)
 #include <BaseTsd.h>
 typedef SSIZE_T ssize_t;
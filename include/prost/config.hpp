@@ -24,6 +24,51 @@
 namespace prost {
 
 static const size_t kBlockSizeCUDA = 256;
+
+static const size_t kWarpSizeCUDA = 32;
+
+/// \brief Elementwise operations supporting it are evaluated by a whole 
+///        warp per element, if the dimension is at least this large.
+static const size_t kElemOperationWarpMinDim = 32;
+
+/// \brief Group-structured proxs (ProxIndSum, ProxIndSOC, ...) use a warp
+///        per group from this dimension on, and a thread block per group
+///        from kGroupBlockMinDim on. Groups of at least kGroupBlockFewMinDim
+///        are also handled by a block if there are fewer than
+///        kGroupBlockFewMaxCount of them, as warps would leave most of the
+///        GPU idle.
+static const size_t kGroupWarpMinDim = 32;
+static const size_t kGroupBlockMinDim = 2048;
+static const size_t kGroupBlockFewMinDim = 256;
+static const size_t kGroupBlockFewMaxCount = 1024;
+
+/// \brief Shared memory available for staging interleaved elementwise
+///        proxs, the default per-block limit without opt-in.
+static const size_t kMaxStagedSharedMem = 48 * 1024;
+
+/// \brief Elementwise proxs with at most this many variables are merged
+///        with their neighbours into a single kernel launch.
+static const size_t kProxBatchMaxSize = 65536;
+
+/// \brief Maximum number of streams a linear operator uses to evaluate 
+///        independent blocks concurrently.
+static const size_t kMaxBlockStreams = 8;
+
+/// \brief Cost of a kernel launch in bytes of memory traffic, used by the
+///        cost model deciding which blocks of a linear operator are merged
+///        into a single sparse matrix.
+static const size_t kBlockLaunchCostBytes = 1 << 20;
+
+/// \brief Maximum number of thread blocks of the fused residual reductions,
+///        each one loops over the vectors.
+static const size_t kResidualSumsMaxBlocks = 256;
+
+/// \brief Number of timed launches per block size candidate when tuning
+///        the launch configurations.
+static const size_t kLaunchTuneTrials = 3;
+
+/// \brief Launches over fewer threads are not tuned.
+static const size_t kLaunchTuneMinCount = 16384;
 	
 #if defined(_MSC_VER)
 #pragma warning(disable: 4244 4267) // disable type-conversion loss of data warnings on windows
@@ -40,6 +40,14 @@ protected:
   std::string msg_;
 };
 
+/// \brief Thrown if device memory runs out, lets the solver retry with the
+///        operator in managed memory, see OperatorMemory::kAuto.
+class OutOfMemoryException : public Exception {
+public:
+  explicit OutOfMemoryException(const char *message) : Exception(message) {}
+  explicit OutOfMemoryException(const std::string& message) : Exception(message) {}
+};
+
 } // namespace prost
 
 #endif // PROST_EXCEPTION_HPP_
@@ -0,0 +1,103 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_EXECUTION_CONTEXT_HPP_
+#define PROST_EXECUTION_CONTEXT_HPP_
+
+#include <cuda_runtime.h>
+#include <cublas_v2.h>
+#include <cusparse.h>
+#include <cusolverDn.h>
+#include <cusolverSp.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+///
+/// \brief Math mode of the dense matrix products. The tensor core modes
+///        only apply to float problems, double always computes in double.
+///        kTF32 rounds the inputs to TF32, kFP16 to half precision, both
+///        accumulate in single precision.
+///
+enum class DenseMath
+{
+  kDefault = 0,
+  kTF32,
+  kFP16
+};
+
+///
+/// \brief Device, stream and library handles used by one solver. Each Solver
+///        owns a context and hands it to the blocks and proxes of its 
+///        problem, so that solvers running from different host threads do
+///        not share any cuBLAS, cuSPARSE or cuSOLVER handle. The handles are
+///        created lazily on the device of the context and bound to the 
+///        stream of each call. A context must only be used by one host 
+///        thread at a time.
+///
+class ExecutionContext {
+public:
+  /// \brief Context on the given device, -1 is the current device.
+  explicit ExecutionContext(int device = -1);
+  ~ExecutionContext();
+
+  ExecutionContext(const ExecutionContext&) = delete;
+  ExecutionContext& operator=(const ExecutionContext&) = delete;
+
+  /// \brief Context used by blocks and proxes which were not given one,
+  ///        e.g. when they are evaluated outside of a solver.
+  static shared_ptr<ExecutionContext> Default();
+
+  int device() const { return device_; }
+
+  /// \brief Default stream of the solver owning the context.
+  cudaStream_t stream() const { return stream_; }
+  void set_stream(cudaStream_t stream) { stream_ = stream; }
+
+  DenseMath dense_math() const { return dense_math_; }
+  void set_dense_math(DenseMath math) { dense_math_ = math; }
+
+  /// \brief Set if the operator data is in managed memory, the linear
+  ///        operator then prefetches its blocks ahead of their evaluation.
+  bool out_of_core() const { return out_of_core_; }
+  void set_out_of_core(bool out_of_core) { out_of_core_ = out_of_core; }
+
+  /// \brief Library handles bound to the given stream.
+  cublasHandle_t cublas(cudaStream_t stream);
+  cusparseHandle_t cusparse(cudaStream_t stream);
+  cusolverDnHandle_t cusolver_dn(cudaStream_t stream);
+  cusolverSpHandle_t cusolver_sp(cudaStream_t stream);
+
+private:
+  int device_;
+  cudaStream_t stream_;
+  DenseMath dense_math_;
+  bool out_of_core_;
+
+  cublasHandle_t cublas_;
+  cusparseHandle_t cusparse_;
+  cusolverDnHandle_t cusolver_dn_;
+  cusolverSpHandle_t cusolver_sp_;
+};
+
+} // namespace prost
+
+#endif // PROST_EXECUTION_CONTEXT_HPP_
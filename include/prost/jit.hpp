@@ -0,0 +1,62 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_JIT_HPP_
+#define PROST_JIT_HPP_
+
+#include <string>
+#include <cuda.h>
+#include <cuda_runtime.h>
+
+namespace prost {
+
+///
+/// \brief Compiles CUDA kernels at runtime with NVRTC. Kernels are cached
+///        per device and source code, so proxs with the same configuration
+///        share one module. Requires building with PROST_WITH_NVRTC, 
+///        otherwise all functions throw an Exception.
+///
+///        The prost headers are looked up in the directory given by the
+///        environment variable PROST_INCLUDE_DIR and otherwise in the 
+///        include directory of the source tree prost was built from.
+///
+class JITKernelCache {
+public:
+  /// \brief Returns true if prost was built with NVRTC support.
+  static bool available();
+
+  /// \brief Returns the extern "C" kernel with the given name from source,
+  ///        compiled for the current device. The kernels of one source
+  ///        share a single compiled module.
+  static CUfunction Get(const std::string& source, const std::string& name);
+
+  /// \brief Launches a kernel obtained by Get() on the given stream.
+  static void Launch(
+    CUfunction kernel,
+    dim3 grid,
+    dim3 block,
+    size_t shared_mem_bytes,
+    cudaStream_t stream,
+    void **params);
+};
+
+} // namespace prost
+
+#endif // PROST_JIT_HPP_
@@ -0,0 +1,101 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_LAUNCH_CONFIG_HPP_
+#define PROST_LAUNCH_CONFIG_HPP_
+
+#include <cstddef>
+#include <typeinfo>
+#include <cuda_runtime.h>
+
+namespace prost {
+
+///
+/// \brief Chooses the block size of a kernel launch. By default this is
+///        kBlockSizeCUDA, reduced to the largest multiple of the warp size
+///        for which the dynamic shared memory still fits. With autotuning
+///        enabled, the candidates around the block size suggested by the
+///        occupancy calculator are timed in the first launches and the
+///        fastest one is kept. It is stored in a per-device tuning file, so
+///        later runs start tuned.
+///
+///        The configuration is looked up on construction. A launch timed
+///        as a trial is finished by the destructor, so the object has to
+///        stay alive until the kernel was launched:
+///
+///          LaunchConfig cfg("Name", typeid(Op), (const void *)Kernel<...>,
+///                           count, smem_per_thread, 0, stream);
+///          Kernel<...><<<cfg.grid(), cfg.block(), cfg.shared_mem(), stream>>>(...);
+///
+class LaunchConfig {
+public:
+  /// \brief Looks up the block size of kernel over count threads, which
+  ///        needs smem_per_thread bytes of dynamic shared memory per 
+  ///        thread and smem_fixed bytes per block. name and type identify
+  ///        the kernel in the tuning file. If max_shared_mem is not zero, 
+  ///        it limits the dynamic shared memory below the device limit.
+  LaunchConfig(const char *name,
+               const std::type_info& type,
+               const void *kernel,
+               size_t count,
+               size_t smem_per_thread,
+               size_t smem_fixed,
+               cudaStream_t stream,
+               size_t max_shared_mem = 0);
+
+  ~LaunchConfig();
+
+  LaunchConfig(const LaunchConfig&) = delete;
+  LaunchConfig& operator=(const LaunchConfig&) = delete;
+
+  /// \brief False if the shared memory does not fit even a single warp.
+  bool fits() const { return block_size_ > 0; }
+
+  size_t block_size() const { return block_size_; }
+
+  dim3 block() const { return dim3(block_size_, 1, 1); }
+
+  dim3 grid() const { return dim3((count_ + block_size_ - 1) / block_size_, 1, 1); }
+
+  size_t shared_mem() const { return smem_fixed_ + block_size_ * smem_per_thread_; }
+
+  /// \brief Enables the timed trials and the tuning file, see 
+  ///        Solver::Options::autotune_launches.
+  static void SetAutotune(bool autotune);
+  static bool autotune();
+
+private:
+  size_t block_size_;
+  size_t count_;
+  size_t smem_per_thread_;
+  size_t smem_fixed_;
+
+  /// \brief Tuning entry, timed candidate and events if this launch is a
+  ///        timed trial.
+  void *trial_;
+  size_t candidate_;
+  cudaEvent_t start_;
+  cudaEvent_t stop_;
+  cudaStream_t stream_;
+};
+
+} // namespace prost
+
+#endif // PROST_LAUNCH_CONFIG_HPP_
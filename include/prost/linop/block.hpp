@@ -22,60 +22,168 @@
 #define PROST_BLOCK_HPP_
 
 #include <thrust/device_vector.h>
+#include <cuda_runtime.h>
 #include <thrust/device_ptr.h>
 
 #include "prost/common.hpp"
+#include "prost/execution_context.hpp"
+#include "prost/managed_memory.hpp"
+#include "prost/linop/epilogue.hpp"
 
 namespace prost {
 
 using thrust::device_vector;
 
+template<typename T> class BlockProduct;
+template<typename T> class BlockSum;
+
 /// 
 /// \brief Abstract base class for linear operator blocks.
 /// 
 template<typename T>
 class Block {
+  // composite blocks evaluate their parts on local ranges
+  friend class BlockProduct<T>;
+  friend class BlockSum<T>;
+
 public:
   Block(size_t row, size_t col, size_t nrows, size_t ncols);
   virtual ~Block();
 
   virtual void Initialize();
   virtual void Release();
+
+  /// \brief Has to be called after the data of the block (or of one of its
+  ///        parts) was replaced in place, drops what was derived from it.
+  virtual void Update() {}
   
+  /// \brief Computes result += K * rhs for this block, launched on the given stream.
   void EvalAdd(
     device_vector<T>& result, 
-    const device_vector<T>& rhs);
+    const device_vector<T>& rhs,
+    cudaStream_t stream = 0);
 
+  /// \brief Computes result += K^T * rhs for this block, launched on the given stream.
   void EvalAdjointAdd(
     device_vector<T>& result, 
-    const device_vector<T>& rhs);
+    const device_vector<T>& rhs,
+    cudaStream_t stream = 0);
   
+  /// \brief Computes result += K * rhs for this block and applies the
+  ///        epilogue to each element of result it writes. Only valid if
+  ///        supports_epilogue() is true.
+  void EvalAdd(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  /// \brief Computes result += K^T * rhs for this block and applies the
+  ///        epilogue to each element of result it writes.
+  void EvalAdjointAdd(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  /// \brief Returns true if the block kernels can apply an epilogue.
+  virtual bool supports_epilogue() const { return false; }
+
   /// \brief Required for preconditioners, row and col are "local" 
   ///        for the operator, which means they start at 0.
   virtual T row_sum(size_t row, T alpha) const = 0;
   virtual T col_sum(size_t col, T alpha) const = 0;
 
+  /// \brief Appends the nonzero entries of the block with global row and
+  ///        column indices, used to assemble the operator explicitly.
+  ///        Returns false if the block does not store its entries.
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
+  /// \brief Adds \sum_{col} |K_{row,col}|^{\alpha} of each row of this
+  ///        block to sums_begin[row() + row] on the GPU, where sums_begin
+  ///        corresponds to the first row of the linear operator.
+  void RowSumsAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
+  /// \brief Adds \sum_{row} |K_{row,col}|^{\alpha} of each column of this
+  ///        block to sums_begin[col() + col] on the GPU.
+  void ColSumsAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
   size_t row() const { return row_; }
   size_t col() const { return col_; }
   size_t nrows() const { return nrows_; }
   size_t ncols() const { return ncols_; }
 
+  /// \brief Sets the context providing the library handles, call before
+  ///        Initialize(). Without one the default context is used.
+  void set_context(shared_ptr<ExecutionContext> context) { context_ = context; }
+  ExecutionContext& context();
+
   virtual size_t gpu_mem_amount() const = 0;
+
+  /// \brief Prefetches the data read by EvalAdd (EvalAdjointAdd if 
+  ///        transpose is set) to the device on the given stream. Only has
+  ///        an effect for blocks whose data is in managed memory.
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream) {}
   
 protected:
   virtual void EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end) = 0;
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream) = 0;
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end) = 0;
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream) = 0;
+
+  /// \brief Versions of EvalLocalAdd/EvalAdjointLocalAdd with an epilogue,
+  ///        which is already shifted to the local result range.
+  virtual void EvalLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  /// \brief Local versions of RowSumsAdd/ColSumsAdd, sums_begin is already
+  ///        shifted to the first row (column) of the block. The default
+  ///        evaluates row_sum/col_sum on the host and adds the uploaded
+  ///        result, subclasses override it with a single kernel launch.
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
 
 private:  
+  shared_ptr<ExecutionContext> context_;
+
   size_t row_;
   size_t col_;
   size_t nrows_;
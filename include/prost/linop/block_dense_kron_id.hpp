@@ -52,20 +52,38 @@ public:
   virtual T row_sum(size_t row, T alpha) const;
   virtual T col_sum(size_t col, T alpha) const;
 
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
   virtual size_t gpu_mem_amount() const;
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
 
 protected:
   virtual void EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
 
 private:
   /// \brief Size of diagonal identity matrix Id for kron(M, Id).
@@ -78,7 +96,7 @@ private:
   size_t mat_ncols_;
 
   /// \brief GPU/CPU data for dense matrix M
-  device_vector<T> data_;
+  operator_vector<T> data_;
   vector<T> host_data_;
 };
 
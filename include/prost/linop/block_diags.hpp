@@ -45,33 +45,90 @@ public:
 	     const std::vector<ssize_t>& offsets,
 	     const std::vector<T>& factors);
   
-  virtual ~BlockDiags() {}
+  virtual ~BlockDiags();
 
   virtual void Initialize();
 
+  /// \brief Gives the slots in constant memory back.
+  virtual void Release();
+
+  /// \brief Replaces the diagonal factors after Initialize(), in place in
+  ///        constant memory. A block merged into the sparse matrix of the
+  ///        linear operator owns no slots, LinearOperator::Update() then
+  ///        rebuilds the merged matrix from the new factors.
+  void SetFactors(const std::vector<T>& factors, cudaStream_t stream = 0);
+
   virtual size_t gpu_mem_amount() const { return 0; }
   virtual T row_sum(size_t row, T alpha) const;
   virtual T col_sum(size_t col, T alpha) const;
 
-  /// \brief Important: has to be called once during initializaiton.
-  static void ResetConstMem() { cmem_counter_ = 0; }
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
+  virtual bool supports_epilogue() const { return true; }
+
+  /// \brief Marks all slots in constant memory as free, has to be called
+  ///        after a device reset.
+  static void ResetConstMem();
 
 protected:
   virtual void EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void EvalLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  /// \brief Launches the forward or adjoint kernel with the given epilogue.
+  template<class EPILOGUE>
+  void Launch(T *d_res,
+	      const T *d_rhs,
+	      bool adjoint,
+	      const EPILOGUE& epilogue,
+	      cudaStream_t stream);
 
   /// \brief Start index in constant memory.
   size_t cmem_offset_;
 
+  /// \brief Device the slots [cmem_offset_, cmem_offset_ + ndiags_) are
+  ///        allocated on, -1 if none are allocated.
+  int cmem_device_;
+
   /// \brief Number of diagonals.
   size_t ndiags_;
 
@@ -81,12 +138,9 @@ protected:
   /// \brief Diagonal factors.
   std::vector<float> factors_;
 
-  /// \brief Allows to handle several BlockDiags.
-  static size_t cmem_counter_;
+  /// \brief Index of each sorted diagonal in the factors passed by the user.
+  std::vector<size_t> factor_order_;
 };
-
-  template<> size_t BlockDiags<float>::cmem_counter_;
-  template<> size_t BlockDiags<double>::cmem_counter_;
   
 }
 
@@ -51,18 +51,53 @@ public:
   virtual T row_sum(size_t row, T alpha) const;
   virtual T col_sum(size_t col, T alpha) const;
 
+  virtual bool supports_epilogue() const { return true; }
+
+  size_t nx() const { return nx_; }
+  size_t ny() const { return ny_; }
+  size_t L() const { return L_; }
+  bool label_first() const { return label_first_; }
+
 protected:
   virtual void EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void EvalLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
 
 private:
   size_t nx_;
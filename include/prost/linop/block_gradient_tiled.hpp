@@ -0,0 +1,283 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BLOCK_GRADIENT_TILED_HPP_
+#define PROST_BLOCK_GRADIENT_TILED_HPP_
+
+// Device code shared by BlockGradient2D and BlockGradient3D, only include
+// from .cu files.
+
+#include <cuda_runtime.h>
+
+namespace prost {
+
+/// \brief Tile size along the fastest (a) and second fastest (b) dimension.
+static const int kGradientTileA = 32;
+static const int kGradientTileB = 8;
+
+///
+/// \brief Forward differences on a volume stored as a + b * na + c * na * nb.
+///
+/// For LABEL_FIRST == false the dimensions are (a, b, c) = (y, x, l), for
+/// LABEL_FIRST == true they are (l, y, x). A (TileA+1) x (TileB+1) tile of
+/// each c-plane is staged in shared memory, the neighbour along c is read
+/// directly, which is coalesced. The label dimension is only differentiated
+/// if GRAD_L is set and uses Dirichlet boundary conditions, x and y use
+/// Neumann conditions. Output is ordered dx, dy (, dl). The epilogue is
+/// applied to each written element.
+///
+template<typename T, bool LABEL_FIRST, bool GRAD_L, class EPILOGUE>
+__global__ void
+BlockGradientTiledKernel(T *d_res,
+			 const T *d_rhs,
+			 size_t na,
+			 size_t nb,
+			 size_t nc,
+			 EPILOGUE epilogue)
+{
+  // gradient component, whether a dimension is differentiated and
+  // whether it uses Dirichlet conditions, resolved at compile time
+  const int comp_a = LABEL_FIRST ? 2 : 1;
+  const int comp_b = LABEL_FIRST ? 1 : 0;
+  const int comp_c = LABEL_FIRST ? 0 : 2;
+  const bool grad_a = LABEL_FIRST ? GRAD_L : true;
+  const bool grad_c = LABEL_FIRST ? true : GRAD_L;
+  const bool dirichlet_a = LABEL_FIRST;
+  const bool dirichlet_c = !LABEL_FIRST;
+
+  __shared__ T tile[kGradientTileB + 1][kGradientTileA + 1];
+
+  const size_t plane = na * nb;
+  const size_t N = plane * nc;
+  const size_t a0 = blockIdx.x * kGradientTileA;
+  const size_t b0 = blockIdx.y * kGradientTileB;
+  const size_t c = blockIdx.z;
+  const T *src = d_rhs + c * plane;
+
+  for(int j = threadIdx.y; j <= kGradientTileB; j += blockDim.y)
+    for(int i = threadIdx.x; i <= kGradientTileA; i += blockDim.x)
+    {
+      const size_t a = a0 + i;
+      const size_t b = b0 + j;
+      tile[j][i] = (a < na && b < nb) ? src[a + b * na] : 0;
+    }
+
+  __syncthreads();
+
+  const size_t a = a0 + threadIdx.x;
+  const size_t b = b0 + threadIdx.y;
+
+  if(a >= na || b >= nb)
+    return;
+
+  const size_t idx = a + b * na + c * plane;
+  const T val_pt = tile[threadIdx.y][threadIdx.x];
+
+  if(grad_a)
+  {
+    T g = 0;
+    if(a < na - 1)
+      g = tile[threadIdx.y][threadIdx.x + 1] - val_pt;
+    else if(dirichlet_a)
+      g = -val_pt;
+
+    const size_t r = idx + comp_a * N;
+    const T v = d_res[r] + g;
+    d_res[r] = v;
+    epilogue(r, v);
+  }
+
+  {
+    T g = 0;
+    if(b < nb - 1)
+      g = tile[threadIdx.y + 1][threadIdx.x] - val_pt;
+
+    const size_t r = idx + comp_b * N;
+    const T v = d_res[r] + g;
+    d_res[r] = v;
+    epilogue(r, v);
+  }
+
+  if(grad_c)
+  {
+    T g = 0;
+    if(c < nc - 1)
+      g = d_rhs[idx + plane] - val_pt;
+    else if(dirichlet_c)
+      g = -val_pt;
+
+    const size_t r = idx + comp_c * N;
+    const T v = d_res[r] + g;
+    d_res[r] = v;
+    epilogue(r, v);
+  }
+}
+
+///
+/// \brief Adjoint of BlockGradientTiledKernel (minus the divergence). The
+///        previous neighbours along a and b are staged in shared memory.
+///
+template<typename T, bool LABEL_FIRST, bool GRAD_L, class EPILOGUE>
+__global__ void
+BlockGradientTiledKernelAdjoint(T *d_res,
+				const T *d_rhs,
+				size_t na,
+				size_t nb,
+				size_t nc,
+				EPILOGUE epilogue)
+{
+  const int comp_a = LABEL_FIRST ? 2 : 1;
+  const int comp_b = LABEL_FIRST ? 1 : 0;
+  const int comp_c = LABEL_FIRST ? 0 : 2;
+  const bool grad_a = LABEL_FIRST ? GRAD_L : true;
+  const bool grad_c = LABEL_FIRST ? true : GRAD_L;
+  const bool dirichlet_a = LABEL_FIRST;
+  const bool dirichlet_c = !LABEL_FIRST;
+
+  // tile_a[j][i] holds component a at (a0 + i - 1, b0 + j),
+  // tile_b[j][i] holds component b at (a0 + i, b0 + j - 1)
+  __shared__ T tile_a[kGradientTileB][kGradientTileA + 1];
+  __shared__ T tile_b[kGradientTileB + 1][kGradientTileA];
+
+  const size_t plane = na * nb;
+  const size_t N = plane * nc;
+  const size_t a0 = blockIdx.x * kGradientTileA;
+  const size_t b0 = blockIdx.y * kGradientTileB;
+  const size_t c = blockIdx.z;
+
+  if(grad_a)
+  {
+    const T *src = d_rhs + comp_a * N + c * plane;
+    for(int j = threadIdx.y; j < kGradientTileB; j += blockDim.y)
+      for(int i = threadIdx.x; i <= kGradientTileA; i += blockDim.x)
+      {
+	const size_t a = a0 + i; // shifted by one
+	const size_t b = b0 + j;
+	tile_a[j][i] = (a >= 1 && a <= na && b < nb) ? src[(a - 1) + b * na] : 0;
+      }
+  }
+
+  {
+    const T *src = d_rhs + comp_b * N + c * plane;
+    for(int j = threadIdx.y; j <= kGradientTileB; j += blockDim.y)
+      for(int i = threadIdx.x; i < kGradientTileA; i += blockDim.x)
+      {
+	const size_t a = a0 + i;
+	const size_t b = b0 + j; // shifted by one
+	tile_b[j][i] = (a < na && b >= 1 && b <= nb) ? src[a + (b - 1) * na] : 0;
+      }
+  }
+
+  __syncthreads();
+
+  const size_t a = a0 + threadIdx.x;
+  const size_t b = b0 + threadIdx.y;
+
+  if(a >= na || b >= nb)
+    return;
+
+  const size_t idx = a + b * na + c * plane;
+  T div = 0;
+
+  if(grad_a)
+  {
+    if(a < na - 1 || dirichlet_a)
+      div += tile_a[threadIdx.y][threadIdx.x + 1];
+
+    if(a > 0)
+      div -= tile_a[threadIdx.y][threadIdx.x];
+  }
+
+  if(b < nb - 1)
+    div += tile_b[threadIdx.y + 1][threadIdx.x];
+
+  if(b > 0)
+    div -= tile_b[threadIdx.y][threadIdx.x];
+
+  if(grad_c)
+  {
+    const T *src = d_rhs + comp_c * N;
+
+    if(c < nc - 1 || dirichlet_c)
+      div += src[idx];
+
+    if(c > 0)
+      div -= src[idx - plane];
+  }
+
+  // adjoint is minus the divergence
+  const T v = d_res[idx] - div;
+  d_res[idx] = v;
+  epilogue(idx, v);
+}
+
+///
+/// \brief Launches the tiled gradient (or its adjoint) on a nx x ny x L
+///        volume. Returns false if the volume does not fit the grid
+///        limits, the caller then uses the untiled kernels.
+///
+template<typename T, bool GRAD_L, class EPILOGUE>
+bool LaunchBlockGradientTiled(T *d_res,
+			      const T *d_rhs,
+			      size_t nx,
+			      size_t ny,
+			      size_t L,
+			      bool label_first,
+			      bool adjoint,
+			      const EPILOGUE& epilogue,
+			      cudaStream_t stream)
+{
+  const size_t na = label_first ? L : ny;
+  const size_t nb = label_first ? ny : nx;
+  const size_t nc = label_first ? nx : L;
+
+  dim3 block(kGradientTileA, kGradientTileB, 1);
+  dim3 grid((na + block.x - 1) / block.x,
+	    (nb + block.y - 1) / block.y,
+	    nc);
+
+  if(grid.y > 65535 || grid.z > 65535)
+    return false;
+
+  if(label_first)
+  {
+    if(adjoint)
+      BlockGradientTiledKernelAdjoint<T, true, GRAD_L, EPILOGUE>
+	<<<grid, block, 0, stream>>>(d_res, d_rhs, na, nb, nc, epilogue);
+    else
+      BlockGradientTiledKernel<T, true, GRAD_L, EPILOGUE>
+	<<<grid, block, 0, stream>>>(d_res, d_rhs, na, nb, nc, epilogue);
+  }
+  else
+  {
+    if(adjoint)
+      BlockGradientTiledKernelAdjoint<T, false, GRAD_L, EPILOGUE>
+	<<<grid, block, 0, stream>>>(d_res, d_rhs, na, nb, nc, epilogue);
+    else
+      BlockGradientTiledKernel<T, false, GRAD_L, EPILOGUE>
+	<<<grid, block, 0, stream>>>(d_res, d_rhs, na, nb, nc, epilogue);
+  }
+
+  return true;
+}
+
+} // namespace prost
+
+#endif // PROST_BLOCK_GRADIENT_TILED_HPP_
@@ -0,0 +1,123 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BLOCK_PRODUCT_HPP_
+#define PROST_BLOCK_PRODUCT_HPP_
+
+#include "prost/linop/block.hpp"
+
+namespace prost {
+
+///
+/// \brief Product K = A_1 * A_2 * ... * A_n of blocks, evaluated lazily by
+///        applying the factors one after another through scratch buffers
+///        instead of assembling the product. The position of the factors 
+///        is ignored, only their sizes have to match.
+///
+///        row_sum/col_sum return upper bounds of the sums of the product,
+///        which keep the preconditioners valid (see FactorSum()).
+///
+template<typename T>
+class BlockProduct : public Block<T>
+{
+public:
+  BlockProduct(size_t row,
+               size_t col,
+               const vector<shared_ptr<Block<T>>>& factors);
+
+  virtual ~BlockProduct() {}
+
+  virtual void Initialize();
+  virtual void Release();
+  virtual void Update();
+
+  virtual T row_sum(size_t row, T alpha) const;
+  virtual T col_sum(size_t col, T alpha) const;
+
+  virtual size_t gpu_mem_amount() const;
+
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
+
+  const vector<shared_ptr<Block<T>>>& factors() const { return factors_; }
+
+protected:
+  virtual void EvalLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+private:
+  /// \brief Row (column if by_cols is set) sum of a single factor as it
+  ///        enters the bounds. The row sums of K = A * B are bounded by
+  ///        (\sum_j |A_{ij}|^alpha) max_j \sum_k |B_{jk}|^alpha for 
+  ///        alpha <= 1, and by (\sum_j |A_{ij}|)^alpha max_j \sum_k |B_{jk}|^alpha
+  ///        for alpha > 1 (Jensen's inequality).
+  T FactorSum(size_t factor, size_t idx, T alpha, bool by_cols) const;
+
+  /// \brief FactorSum of all rows (columns) of a factor on the GPU.
+  void FactorSums(size_t factor, device_vector<T>& sums, T alpha, bool by_cols, cudaStream_t stream);
+
+  /// \brief Product of the maximal FactorSum over all factors but the 
+  ///        first (last if by_cols is set), cached for the last alpha
+  ///        until Update(). The stream is set if the sums are computed on
+  ///        the GPU.
+  T TailBound(T alpha, bool by_cols) const;
+  T TailBound(T alpha, bool by_cols, cudaStream_t stream);
+
+  /// \brief Adds the bounds of all rows (columns) to sums_begin.
+  void SumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    bool by_cols,
+    cudaStream_t stream);
+
+  vector<shared_ptr<Block<T>>> factors_;
+
+  /// \brief scratch_[i] holds the result between factor i and i+1.
+  vector<device_vector<T>> scratch_;
+
+  /// \brief Cached results of TailBound(), the preconditioners query 
+  ///        every row and column with the same alpha.
+  mutable T row_bound_alpha_, row_bound_;
+  mutable T col_bound_alpha_, col_bound_;
+};
+
+} // namespace prost
+
+#endif // PROST_BLOCK_PRODUCT_HPP_
@@ -28,6 +28,7 @@
 #include <cusparse.h>
 
 #include "prost/linop/block.hpp"
+#include "prost/sparse_matrix.hpp"
 
 namespace prost {
 
@@ -40,6 +41,10 @@ class BlockSparse : public Block<T> {
 
 public: 
   // TODO: add check somewhere if int32_t index is big enough
+  /// \brief If transpose_spmv is set, only a single copy of the matrix is
+  ///        kept: the adjoint is evaluated by a transposed SpMV, no CSC copy
+  ///        is stored on host or GPU, and the host CSR arrays are freed once
+  ///        they are uploaded in Initialize(). Release() moves them back.
   static BlockSparse<T> *CreateFromCSC(
     size_t row,
     size_t col,
@@ -48,18 +53,65 @@ public:
     int nnz,
     const vector<T>& val,
     const vector<int32_t>& ptr,
-    const vector<int32_t>& ind);
+    const vector<int32_t>& ind,
+    bool transpose_spmv = false);
+
+  /// \brief Creates the block from triplets with local (0-based) row and
+  ///        column indices. Each entry must appear at most once.
+  static BlockSparse<T> *CreateFromTriplets(
+    size_t row,
+    size_t col,
+    int m,
+    int n,
+    const vector<int32_t>& rows,
+    const vector<int32_t>& cols,
+    const vector<T>& vals,
+    bool transpose_spmv = false);
+
+  /// \brief Creates the block from the CSR arrays of the matrix and of its
+  ///        transpose in host memory owned by owner, e.g. the mapping of a
+  ///        ProblemFile. No host copy is made: Initialize() uploads straight
+  ///        from the arrays, which are kept alive with owner.
+  static BlockSparse<T> *CreateFromHostCSR(
+    size_t row,
+    size_t col,
+    int m,
+    int n,
+    int nnz,
+    const T *val,
+    const int32_t *ptr,
+    const int32_t *ind,
+    const T *val_t,
+    const int32_t *ptr_t,
+    const int32_t *ind_t,
+    shared_ptr<const void> owner,
+    bool transpose_spmv = false);
 
   virtual ~BlockSparse();
 
+  /// \brief Replaces the entries after Initialize(), in place on the GPU.
+  ///        The sparsity pattern must not change.
+  void SetTriplets(
+    const vector<int32_t>& rows,
+    const vector<int32_t>& cols,
+    const vector<T>& vals,
+    cudaStream_t stream = 0);
+
   virtual void Initialize();
+  virtual void Release();
 
   /// \brief Required for preconditioners, row and col are "local" 
   ///        for the operator, which means they start at 0.
   virtual T row_sum(size_t row, T alpha) const;
   virtual T col_sum(size_t col, T alpha) const;
 
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
   virtual size_t gpu_mem_amount() const;
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
   
 protected:
   // TODO: implement sparse matrix multiplication on CPU
@@ -67,27 +119,69 @@ protected:
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  /// \brief Fills the host CSR and CSC arrays from local triplets.
+  void SetHostTriplets(
+    const vector<int32_t>& rows,
+    const vector<int32_t>& cols,
+    const vector<T>& vals);
+
+  /// \brief Frees the host arrays which are not needed with transpose_spmv,
+  ///        which is all of them if the matrix is on the GPU.
+  void ReleaseHost();
+
+  /// \brief Host CSR arrays, downloaded from the GPU if they were freed.
+  void HostCSR(
+    vector<T>& val,
+    vector<int32_t>& ptr,
+    vector<int32_t>& ind) const;
+
+  /// \brief Row (column) sums of |K|^alpha for row_sum() (col_sum()) with
+  ///        transpose_spmv, computed in a single pass over the CSR arrays
+  ///        and kept until alpha changes or SetTriplets() is called.
+  const vector<T>& CachedSums(T alpha, bool by_cols) const;
 
   /// \brief Number of non-zero elements.
   size_t nnz_;
 
-  static cusparseHandle_t cusp_handle_;
-  cusparseMatDescr_t descr_;
+  /// \brief Evaluate the adjoint by a transposed SpMV on the CSR arrays.
+  bool transpose_spmv_;
 
-  device_vector<int32_t> ind_, ind_t_;
-  device_vector<int32_t> ptr_, ptr_t_;
-  device_vector<T> val_, val_t_;
+  SparseMatrix<T> mat_;
 
   vector<int32_t> host_ind_, host_ind_t_;
   vector<int32_t> host_ptr_, host_ptr_t_;
   vector<T> host_val_, host_val_t_;
+
+  /// \brief Cache of CachedSums(), empty if invalid.
+  mutable vector<T> cached_row_sums_, cached_col_sums_;
+  mutable T cached_row_alpha_, cached_col_alpha_;
+
+  /// \brief Arrays of CreateFromHostCSR(), used instead of the host arrays
+  ///        above as long as external_owner_ is set.
+  const T *external_val_, *external_val_t_;
+  const int32_t *external_ptr_, *external_ptr_t_;
+  const int32_t *external_ind_, *external_ind_t_;
+  shared_ptr<const void> external_owner_;
 };
 
 } // namespace prost
@@ -0,0 +1,111 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BLOCK_SPARSE_HALF_HPP_
+#define PROST_BLOCK_SPARSE_HALF_HPP_
+
+#include <cuda_fp16.h>
+
+#include "prost/linop/block.hpp"
+
+namespace prost {
+
+///
+/// \brief Linear operator based on a sparse matrix whose values are stored
+///        in half precision on the GPU. Products are accumulated in T.
+///        Halves the memory and bandwidth of the values compared to
+///        BlockSparse<float>, at the cost of ~3 significant digits. 
+///        CreateFromCSC throws if a nonzero value is not within the normal
+///        half precision range [6.1e-5, 65504] in absolute value.
+///
+template<typename T>
+class BlockSparseHalf : public Block<T>
+{
+  BlockSparseHalf(size_t row, size_t col, size_t nrows, size_t ncols);
+
+ public:
+  static BlockSparseHalf<T> *CreateFromCSC(
+    size_t row,
+    size_t col,
+    int m,
+    int n,
+    int nnz,
+    const vector<T>& val,
+    const vector<int32_t>& ptr,
+    const vector<int32_t>& ind);
+
+  virtual ~BlockSparseHalf() {}
+
+  virtual void Initialize();
+
+  virtual T row_sum(size_t row, T alpha) const;
+  virtual T col_sum(size_t col, T alpha) const;
+
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
+  virtual size_t gpu_mem_amount() const;
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
+
+ protected:
+  virtual void EvalLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+ private:
+  /// \brief Number of non-zero elements.
+  size_t nnz_;
+
+  /// \brief GPU data, CSR format for K and K^T.
+  operator_vector<int32_t> ind_, ind_t_;
+  operator_vector<int32_t> ptr_, ptr_t_;
+  operator_vector<__half> val_, val_t_;
+
+  /// \brief Host data in full precision, used for the preconditioners.
+  vector<int32_t> host_ind_, host_ind_t_;
+  vector<int32_t> host_ptr_, host_ptr_t_;
+  vector<T> host_val_, host_val_t_;
+};
+
+} // namespace prost
+
+#endif // PROST_BLOCK_SPARSE_HALF_HPP_
@@ -21,7 +21,10 @@
 #ifndef PROST_BLOCK_SPARSE_KRON_ID_HPP_
 #define PROST_BLOCK_SPARSE_KRON_ID_HPP_
 
+#include <cusparse.h>
+
 #include "prost/linop/block.hpp"
+#include "prost/sparse_matrix.hpp"
 
 namespace prost {
 
@@ -50,26 +53,67 @@ class BlockSparseKronId : public Block<T>
   virtual ~BlockSparseKronId() {}
 
   virtual void Initialize();
+  virtual void Release();
 
   virtual T row_sum(size_t row, T alpha) const;
   virtual T col_sum(size_t col, T alpha) const;
 
+  virtual bool AppendTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
   virtual size_t gpu_mem_amount() const;
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
+
+  virtual bool supports_epilogue() const { return true; }
 
  protected:
   virtual void EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
 
   virtual void EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end);
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void EvalLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream);
 
  private:
+  /// \brief Launches the forward or adjoint kernel with the given epilogue.
+  template<class EPILOGUE>
+  void Launch(T *d_res, const T *d_rhs, bool adjoint, const EPILOGUE& epilogue, cudaStream_t stream);
+
   /// \brief Size of diagonal identity matrix Id for kron(M, Id).
   size_t diaglength_;
 
@@ -82,15 +126,15 @@ class BlockSparseKronId : public Block<T>
   /// \brief Number of non-zero elements in small sparse matrix M.
   size_t mat_nnz_;
   
-  /// \brief GPU data for small sparse matrix M (used if not stored in const-mem).
-  device_vector<int32_t> ind_, ind_t_;
-  device_vector<int32_t> ptr_, ptr_t_;
-  device_vector<float> val_, val_t_;
-  
+  /// \brief GPU data for small sparse matrix M and its transpose. The
+  ///        plain products are evaluated by SpMM on it, since the entries
+  ///        of M are reused for all diaglength columns.
+  SparseMatrix<T> mat_;
+
   /// \brief Host data for small sparse matrix M.
   vector<int32_t> host_ind_, host_ind_t_;
   vector<int32_t> host_ptr_, host_ptr_t_;
-  vector<float> host_val_, host_val_t_;
+  vector<T> host_val_, host_val_t_;
 };
 
 } // namespace prost
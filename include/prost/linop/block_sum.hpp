@@ -0,0 +1,118 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BLOCK_SUM_HPP_
+#define PROST_BLOCK_SUM_HPP_
+
+#include "prost/linop/block.hpp"
+
+namespace prost {
+
+///
+/// \brief Weighted sum K = c_1 A_1 + ... + c_n A_n of blocks of the same
+///        size, evaluated lazily term by term. A single term scales a 
+///        block. Terms with c_i = 1 are added to the result directly, the
+///        others go through a scratch buffer. The position of the terms is
+///        ignored.
+///
+///        row_sum/col_sum return the upper bounds
+///        n^max(alpha - 1, 0) \sum_i |c_i|^alpha row_sum_i(alpha).
+///
+template<typename T>
+class BlockSum : public Block<T>
+{
+public:
+  BlockSum(size_t row,
+           size_t col,
+           const vector<shared_ptr<Block<T>>>& terms,
+           const vector<T>& coeffs);
+
+  virtual ~BlockSum() {}
+
+  virtual void Initialize();
+  virtual void Release();
+  virtual void Update();
+
+  virtual T row_sum(size_t row, T alpha) const;
+  virtual T col_sum(size_t col, T alpha) const;
+
+  virtual size_t gpu_mem_amount() const;
+
+  virtual void Prefetch(int device, bool transpose, cudaStream_t stream);
+
+  const vector<shared_ptr<Block<T>>>& terms() const { return terms_; }
+  const vector<T>& coeffs() const { return coeffs_; }
+
+protected:
+  virtual void EvalLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void EvalAdjointLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream);
+
+  virtual void RowSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+  virtual void ColSumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream);
+
+private:
+  /// \brief Evaluates the terms into the result, K^T if transpose is set.
+  void EvalTerms(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    bool transpose,
+    cudaStream_t stream);
+
+  /// \brief Bound of the row (column if by_cols is set) sums.
+  T Bound(size_t idx, T alpha, bool by_cols) const;
+
+  /// \brief Adds the bounds of all rows (columns) to sums_begin, from the
+  ///        sums of the terms on the GPU.
+  void SumsLocalAdd(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    bool by_cols,
+    cudaStream_t stream);
+
+  vector<shared_ptr<Block<T>>> terms_;
+  vector<T> coeffs_;
+
+  /// \brief Result of a scaled term, empty if all coefficients are one.
+  device_vector<T> scratch_;
+};
+
+} // namespace prost
+
+#endif // PROST_BLOCK_SUM_HPP_
@@ -0,0 +1,299 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_BLOCK_SUMS_HPP_
+#define PROST_BLOCK_SUMS_HPP_
+
+// Device code shared by the Block subclasses to compute the row and column
+// sums for the preconditioners on the GPU, only include from .cu files.
+
+#include <sstream>
+
+#include <cuda_fp16.h>
+#include <cuda_runtime.h>
+#include <thrust/device_vector.h>
+
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+using thrust::device_vector;
+
+template<typename V>
+__device__ inline V BlockSumsValue(const V& val) { return val; }
+
+__device__ inline float BlockSumsValue(const __half& val) { return __half2float(val); }
+
+/// 
+/// \brief d_sums[i] += \sum_k |val[k]|^alpha over the entries of row 
+///        (i / div) % mod of a CSR matrix, one thread per row of the block.
+///        The column sums are obtained from the CSR arrays of the transpose.
+/// 
+template<typename T, typename V>
+__global__
+void BlockSumsCSRKernel(
+  T *d_sums,
+  const int32_t *d_ptr,
+  const V *d_val,
+  size_t count,
+  size_t div,
+  size_t mod,
+  T alpha)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx >= count)
+    return;
+
+  const size_t r = (tx / div) % mod;
+
+  T sum = 0;
+  for(int32_t i = d_ptr[r]; i < d_ptr[r + 1]; i++)
+    sum += pow(fabs(static_cast<T>(BlockSumsValue(d_val[i]))), alpha);
+
+  d_sums[tx] += sum;
+}
+
+/// \brief atomicAdd for double is only native from sm_60 on.
+__device__ inline float BlockSumsAtomicAdd(float *address, float val)
+{
+  return atomicAdd(address, val);
+}
+
+__device__ inline double BlockSumsAtomicAdd(double *address, double val)
+{
+#if !defined(__CUDA_ARCH__) || __CUDA_ARCH__ >= 600
+  return atomicAdd(address, val);
+#else
+  unsigned long long int *address_ull = (unsigned long long int *)address;
+  unsigned long long int old = *address_ull, assumed;
+
+  do
+  {
+    assumed = old;
+    old = atomicCAS(address_ull, assumed,
+      __double_as_longlong(val + __longlong_as_double(assumed)));
+  } while(assumed != old);
+
+  return __longlong_as_double(old);
+#endif
+}
+
+/// 
+/// \brief d_sums[ind[k]] += |val[k]|^alpha over all entries of a CSR matrix,
+///        which are the column sums when no CSR copy of the transpose is
+///        available. One thread per row, columns are accumulated atomically.
+/// 
+template<typename T, typename V>
+__global__
+void BlockSumsCSRTransposeKernel(
+  T *d_sums,
+  const int32_t *d_ptr,
+  const int32_t *d_ind,
+  const V *d_val,
+  size_t nrows,
+  T alpha)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx >= nrows)
+    return;
+
+  for(int32_t i = d_ptr[tx]; i < d_ptr[tx + 1]; i++)
+    BlockSumsAtomicAdd(&d_sums[d_ind[i]], 
+      pow(fabs(static_cast<T>(BlockSumsValue(d_val[i]))), alpha));
+}
+
+/// 
+/// \brief d_sums[i] += \sum_{k < len} |data[r * stride + k * step]|^alpha 
+///        for r = (i / div) % mod, one thread per row (or column) of the block.
+/// 
+template<typename T>
+__global__
+void BlockSumsDenseKernel(
+  T *d_sums,
+  const T *d_data,
+  size_t count,
+  size_t div,
+  size_t mod,
+  size_t stride,
+  size_t step,
+  size_t len,
+  T alpha)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx >= count)
+    return;
+
+  const T *d_row = d_data + ((tx / div) % mod) * stride;
+
+  T sum = 0;
+  for(size_t k = 0; k < len; k++)
+    sum += pow(fabs(d_row[k * step]), alpha);
+
+  d_sums[tx] += sum;
+}
+
+/// \brief d_sums[i] += value.
+template<typename T>
+__global__
+void BlockSumsConstantKernel(
+  T *d_sums,
+  size_t count,
+  T value)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx < count)
+    d_sums[tx] += value;
+}
+
+inline void BlockSumsCheckError(const char *name)
+{
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << name << ": CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+/// \brief The vectors can be device_vectors or operator_vectors, their 
+///        element types have to be int32_t and V.
+template<typename T, typename V, class PtrVector, class ValVector>
+void BlockSumsCSR(
+  const typename device_vector<T>::iterator& sums_begin,
+  const PtrVector& ptr,
+  const ValVector& val,
+  size_t count,
+  size_t div,
+  size_t mod,
+  T alpha,
+  cudaStream_t stream)
+{
+  if(count == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  BlockSumsCSRKernel<T, V>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      thrust::raw_pointer_cast(ptr.data()),
+      thrust::raw_pointer_cast(val.data()),
+      count,
+      div,
+      mod,
+      alpha);
+
+  BlockSumsCheckError("BlockSumsCSR");
+}
+
+template<typename T, typename V, class PtrVector, class ValVector>
+void BlockSumsCSRTranspose(
+  const typename device_vector<T>::iterator& sums_begin,
+  const PtrVector& ptr,
+  const PtrVector& ind,
+  const ValVector& val,
+  size_t nrows,
+  T alpha,
+  cudaStream_t stream)
+{
+  if(nrows == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((nrows + block.x - 1) / block.x, 1, 1);
+
+  BlockSumsCSRTransposeKernel<T, V>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      thrust::raw_pointer_cast(ptr.data()),
+      thrust::raw_pointer_cast(ind.data()),
+      thrust::raw_pointer_cast(val.data()),
+      nrows,
+      alpha);
+
+  BlockSumsCheckError("BlockSumsCSRTranspose");
+}
+
+template<typename T, class DataVector>
+void BlockSumsDense(
+  const typename device_vector<T>::iterator& sums_begin,
+  const DataVector& data,
+  size_t count,
+  size_t div,
+  size_t mod,
+  size_t stride,
+  size_t step,
+  size_t len,
+  T alpha,
+  cudaStream_t stream)
+{
+  if(count == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  BlockSumsDenseKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      thrust::raw_pointer_cast(data.data()),
+      count,
+      div,
+      mod,
+      stride,
+      step,
+      len,
+      alpha);
+
+  BlockSumsCheckError("BlockSumsDense");
+}
+
+template<typename T>
+void BlockSumsConstant(
+  const typename device_vector<T>::iterator& sums_begin,
+  size_t count,
+  T value,
+  cudaStream_t stream)
+{
+  if(count == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  BlockSumsConstantKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      count,
+      value);
+
+  BlockSumsCheckError("BlockSumsConstant");
+}
+
+} // namespace prost
+
+#endif // PROST_BLOCK_SUMS_HPP_
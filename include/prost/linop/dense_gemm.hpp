@@ -0,0 +1,60 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_DENSE_GEMM_HPP_
+#define PROST_DENSE_GEMM_HPP_
+
+#include <cuda_runtime.h>
+#include <cublas_v2.h>
+
+#include "prost/execution_context.hpp"
+
+namespace prost {
+
+///
+/// \brief Dense matrix products of the dense blocks by cuBLAS, using the
+///        handle and math mode of the execution context.
+///
+class DenseGemm {
+public:
+  /// \brief Computes C = alpha * op(A) * op(B) + beta * C on the given
+  ///        stream, where C is m x n and all matrices are column-major.
+  template<typename T>
+  static void Multiply(
+    ExecutionContext& context,
+    bool trans_a,
+    bool trans_b,
+    int m,
+    int n,
+    int k,
+    T alpha,
+    const T *a,
+    int lda,
+    const T *b,
+    int ldb,
+    T beta,
+    T *c,
+    int ldc,
+    cudaStream_t stream = 0);
+};
+
+} // namespace prost
+
+#endif // PROST_DENSE_GEMM_HPP_
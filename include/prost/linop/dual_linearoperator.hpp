@@ -21,6 +21,8 @@
 #ifndef PROST_DUAL_LINEAROPERATOR_HPP_
 #define PROST_DUAL_LINEAROPERATOR_HPP_
 
+#include <utility>
+
 #include "prost/linop/linearoperator.hpp"
 
 namespace prost {
@@ -34,22 +36,68 @@ class DualLinearOperator : public LinearOperator<T> {
   DualLinearOperator(shared_ptr<LinearOperator<T>> child);
   virtual ~DualLinearOperator();
 
+  /// \brief Forwards to the child operator, which holds the merged blocks.
+  virtual void Update() { child_->Update(); }
+
+  /// \brief Same values as the child operator.
+  virtual uint64_t version() const { return child_->version(); }
+
+  // the epilogue versions are applied in a separate pass after negation
+  using LinearOperator<T>::Eval;
+  using LinearOperator<T>::EvalAdjoint;
+  using LinearOperator<T>::RowSums;
+  using LinearOperator<T>::ColSums;
+
   virtual void Eval(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta = 0);
+    T beta = 0,
+    cudaStream_t stream = 0);
 
   virtual void EvalAdjoint(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta = 0);
+    T beta = 0,
+    cudaStream_t stream = 0);
   
+  /// \brief Rows of the dual operator are columns of the child.
+  virtual void RowPartition(vector<size_t>& bounds) const;
+
+  virtual void EvalRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream = 0);
+
+  virtual void EvalAdjointRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream = 0);
+
     /// \brief Returns \sum_{col=1}^{ncols} |K_{row,col}|^{\alpha}.
   virtual T row_sum(size_t row, T alpha) const;
 
   /// \brief Returns \sum_{row=1}^{nrows} |K_{row,col}|^{\alpha}.
   virtual T col_sum(size_t col, T alpha) const;
 
+  virtual void RowSums(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
+  virtual void ColSums(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
+  virtual bool GetTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
   virtual size_t nrows() const;
   virtual size_t ncols() const;
 
@@ -57,6 +105,9 @@ class DualLinearOperator : public LinearOperator<T> {
 
  protected:
   shared_ptr<LinearOperator<T>> child_;
+
+  /// \brief Row ranges negated around EvalAdjointRowsAdd.
+  vector<std::pair<size_t, size_t>> negate_ranges_;
 };
 
 }
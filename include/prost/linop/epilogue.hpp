@@ -0,0 +1,89 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_EPILOGUE_HPP_
+#define PROST_EPILOGUE_HPP_
+
+#include <cuda_runtime.h>
+
+#include "prost/prox/prox_argument.hpp"
+
+namespace prost {
+
+///
+/// \brief Epilogue which is applied by the block kernels to each element of
+///        the result of a linear operator, right after computing it:
+///
+///        out[i] = arg.x[i] + arg.step * arg.d[i] * ((1 + arg.theta) * v - arg.theta * arg.b[i]),
+///
+///        where v is the freshly computed value K*x (or K^T*y) at index i.
+///        This computes the prox argument of the primal-dual algorithm
+///        without an extra pass over the result. arg.a is not used.
+///
+template<typename T>
+struct Epilogue
+{
+  T *out;
+  ProxArgument<T> arg;
+
+  /// \brief Returns the epilogue shifted by the given offset.
+  inline __host__ __device__
+  Epilogue<T> Offset(size_t ofs) const
+  {
+    Epilogue<T> epi = *this;
+
+    epi.out += ofs;
+    epi.arg.x += ofs;
+    epi.arg.d += ofs;
+    if(epi.arg.b != nullptr)
+      epi.arg.b += ofs;
+
+    return epi;
+  }
+
+  inline __host__ __device__
+  void operator()(size_t i, T v) const
+  {
+    out[i] = arg.Evaluate(i, v);
+  }
+};
+
+///
+/// \brief Empty epilogue, the block kernels are templated on the epilogue
+///        so this one compiles away.
+///
+template<typename T>
+struct NoEpilogue
+{
+  inline __host__ __device__
+  void operator()(size_t i, T v) const { }
+};
+
+/// \brief Applies the epilogue to values[0..count) in a separate pass.
+template<typename T>
+void ApplyEpilogue(
+  const T *values,
+  size_t count,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream);
+
+} // namespace prost
+
+#endif // PROST_EPILOGUE_HPP_
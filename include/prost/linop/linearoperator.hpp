@@ -28,6 +28,7 @@
 namespace prost {
 
 template<typename T> class DualLinearOperator;
+template<typename T> class BlockSparse;
 
 ///
 /// \brief Linear operator built out of blocks.
@@ -45,15 +46,73 @@ public:
   void Initialize();
   void Release();
 
+  /// \brief Has to be called after block data was replaced in place (e.g.
+  ///        BlockDiags::SetFactors), updates the blocks and the merged 
+  ///        sparse matrix in place.
+  virtual void Update();
+
+  /// \brief Merge the blocks which store their entries into a single
+  ///        sparse matrix in Initialize(), if the cost model predicts it to
+  ///        be faster than evaluating them one by one. Enabled by default.
+  void set_merge_blocks(bool merge_blocks) { merge_blocks_ = merge_blocks; }
+
+  /// \brief Sets the context of all blocks, call before Initialize().
+  void set_context(shared_ptr<ExecutionContext> context) { context_ = context; }
+
   virtual void Eval(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta = 0);
+    T beta = 0,
+    cudaStream_t stream = 0);
 
   virtual void EvalAdjoint(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta = 0);
+    T beta = 0,
+    cudaStream_t stream = 0);
+
+  /// \brief Computes result = K * rhs and applies the epilogue to each
+  ///        element of result. The epilogue is fused into the block kernels
+  ///        if each row is written by exactly one block supporting it,
+  ///        otherwise it is applied in a separate pass.
+  void Eval(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream = 0);
+
+  /// \brief Computes result = K^T * rhs and applies the epilogue to each
+  ///        element of result.
+  void EvalAdjoint(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream = 0);
+
+  /// \brief Returns the bounds 0 = b_0 < b_1 < ... < b_k = nrows() of the
+  ///        finest partition of the rows such that each evaluated block
+  ///        lies inside one part [b_i, b_{i+1}).
+  virtual void RowPartition(vector<size_t>& bounds) const;
+
+  /// \brief Adds K_R * rhs to result, where K_R are the rows
+  ///        R = [row_begin, row_end). Only the blocks inside R are
+  ///        evaluated, so R has to be a union of parts of RowPartition().
+  ///        Entries of result outside R are not touched.
+  virtual void EvalRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream = 0);
+
+  /// \brief Adds K_R^T * rhs to result, only the entries of rhs in R are
+  ///        read. R has to be a union of parts of RowPartition().
+  virtual void EvalAdjointRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream = 0);
 
   /// \brief For debugging/testing purposes. Not overwritten in DualLinearOperator.
   double Eval(
@@ -71,22 +130,178 @@ public:
   /// \brief Returns \sum_{row=1}^{nrows} |K_{row,col}|^{\alpha}.
   virtual T col_sum(size_t col, T alpha) const;
 
+  /// \brief Sets sums_begin[row] = \sum_{col=1}^{ncols} |K_{row,col}|^{\alpha}
+  ///        for all rows, computed on the GPU by one launch per block.
+  virtual void RowSums(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
+  /// \brief Sets sums_begin[col] = \sum_{row=1}^{nrows} |K_{row,col}|^{\alpha}
+  ///        for all columns on the GPU.
+  virtual void ColSums(
+    const typename device_vector<T>::iterator& sums_begin,
+    T alpha,
+    cudaStream_t stream = 0);
+
+  /// \brief For debugging/testing purposes, returns the sums computed on
+  ///        the GPU by RowSums/ColSums.
+  void RowSums(vector<T>& sums, T alpha);
+  void ColSums(vector<T>& sums, T alpha);
+
+  /// \brief Writes the nonzero entries of the operator as host triplets.
+  ///        Returns false if some block does not store its entries.
+  virtual bool GetTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals) const;
+
+  /// \brief Blocks in the order they were added.
+  const vector<shared_ptr<Block<T>>>& blocks() const { return blocks_; }
+
   virtual size_t nrows() const { return nrows_; }
   virtual size_t ncols() const { return ncols_; }
 
+  /// \brief Identifies the current values of the operator, a new one is
+  ///        drawn by Initialize() and Update().
+  virtual uint64_t version() const { return version_; }
+
   virtual size_t gpu_mem_amount() const;
   
 protected:
+  /// \brief Adds K * rhs (or K^T * rhs if transpose is set) to result, 
+  ///        evaluating the blocks of each wave concurrently.
+  ///        If epilogue is given, it is applied inside the block kernels.
+  void EvalBlocksAdd(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    bool transpose,
+    cudaStream_t stream,
+    const Epilogue<T> *epilogue = nullptr);
+
+  /// \brief Computes the bounds of RowPartition(), or of the analogous
+  ///        partition of the columns if by_cols is set.
+  void Partition(bool by_cols, vector<size_t>& bounds) const;
+
+  /// \brief Collects the evaluated blocks whose rows (columns if by_cols
+  ///        is set) start in [begin, end) into range_blocks_.
+  void CollectRangeBlocks(bool by_cols, size_t begin, size_t end);
+
+  /// \brief Adds K * rhs (or K^T * rhs if transpose is set) restricted to
+  ///        range_blocks_ to result, one block after another.
+  void EvalRangeBlocksAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    bool transpose,
+    cudaStream_t stream);
+
   vector<shared_ptr<Block<T>>> blocks_;
   size_t nrows_;
   size_t ncols_;
+  uint64_t version_;
+
+  /// \brief Blocks which are evaluated on the GPU: the merged matrix and
+  ///        all blocks which were not merged into it.
+  vector<shared_ptr<Block<T>>> eval_blocks_;
+
+  /// \brief Blocks assembled into merged_block_. They keep their host
+  ///        data but are released on the GPU.
+  vector<shared_ptr<Block<T>>> merged_;
+  shared_ptr<BlockSparse<T>> merged_block_;
+  bool merge_blocks_;
+
+  /// \brief Context handed to the blocks, the default one if empty.
+  shared_ptr<ExecutionContext> context_;
+
+  /// \brief Groups of blocks with pairwise disjoint row ranges, which can be
+  ///        evaluated concurrently in Eval.
+  vector<vector<shared_ptr<Block<T>>>> row_waves_;
+
+  /// \brief Groups of blocks with pairwise disjoint column ranges, which can
+  ///        be evaluated concurrently in EvalAdjoint.
+  vector<vector<shared_ptr<Block<T>>>> col_waves_;
+
+  /// \brief eval_blocks_ sorted by their first row and by their first
+  ///        column, for the row range evaluations.
+  vector<shared_ptr<Block<T>>> row_sorted_;
+  vector<shared_ptr<Block<T>>> col_sorted_;
+
+  /// \brief Blocks selected by the last CollectRangeBlocks().
+  vector<shared_ptr<Block<T>>> range_blocks_;
+
+  /// \brief True if each row (column) is written by exactly one block and
+  ///        all blocks support epilogue fusion.
+  bool epilogue_rows_;
+  bool epilogue_cols_;
+
+  /// \brief Streams the blocks of a wave are distributed on.
+  vector<cudaStream_t> streams_;
+
+  /// \brief Events to fork the waves off / join them to the caller's stream.
+  cudaEvent_t fork_event_;
+  vector<cudaEvent_t> join_events_;
+
+  /// \brief Out-of-core mode: stream on which the next block is prefetched
+  ///        while the current one is evaluated, and the events ordering the
+  ///        prefetches with the evaluations. Null if the operator is in
+  ///        device memory.
+  cudaStream_t prefetch_stream_;
+  cudaEvent_t prefetched_event_;
+  cudaEvent_t evaluated_event_;
 
 private:
-  bool RectangleOverlap(
-    size_t x1, size_t y1,
-    size_t x2, size_t y2,
-    size_t a1, size_t b1,
-    size_t a2, size_t b2);
+  /// \brief Out-of-core version of EvalBlocksAdd, evaluates eval_blocks_
+  ///        one after another on stream and prefetches block i+1 while
+  ///        block i is evaluated. At most two blocks are resident at a time.
+  void EvalBlocksStreamed(
+    device_vector<T>& result, 
+    const device_vector<T>& rhs,
+    bool transpose,
+    cudaStream_t stream,
+    const Epilogue<T> *epilogue);
+
+  /// \brief Chooses the blocks to merge by a simple cost model: a block
+  ///        is merged if its entries in CSR cost less memory traffic than
+  ///        its own evaluation plus a kernel launch. Blocks without stored
+  ///        entries (e.g. gradients) are always evaluated separately.
+  void MergeBlocks();
+
+  /// \brief Collects the entries of merged_, relative to the upper left
+  ///        corner of their bounding box [row_beg, row_end) x [col_beg, col_end).
+  void MergedTriplets(
+    vector<int32_t>& rows,
+    vector<int32_t>& cols,
+    vector<T>& vals,
+    size_t& row_beg, size_t& row_end,
+    size_t& col_beg, size_t& col_end) const;
+
+  /// \brief Builds the waves and streams for eval_blocks_.
+  void BuildSchedule();
+
+  /// \brief Checks whether the waves allow fusing an epilogue, i.e. there
+  ///        is a single wave covering all size entries.
+  bool EpilogueFusable(
+    const vector<vector<shared_ptr<Block<T>>>>& waves,
+    bool by_cols,
+    size_t size) const;
+
+  /// \brief Partitions the blocks into the least number of waves with
+  ///        disjoint row (column if by_cols is set) ranges, by visiting
+  ///        them in order of their first row and reusing the wave which 
+  ///        became free first.
+  void BuildWaves(
+    vector<vector<shared_ptr<Block<T>>>>& waves,
+    bool by_cols);
+
+  /// \brief Throws if two blocks overlap. Sweeps over the rows and keeps
+  ///        the column ranges of the blocks intersecting the current row 
+  ///        in an ordered map, O(B log B) for B blocks.
+  void CheckOverlap() const;
+
+  /// \brief Position and size of the blocks at the last successful 
+  ///        CheckOverlap(), a repeated Initialize() skips the check if 
+  ///        no block moved.
+  vector<size_t> checked_layout_;
 };
 
 } // namespace prost
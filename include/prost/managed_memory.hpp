@@ -0,0 +1,127 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_MANAGED_MEMORY_HPP_
+#define PROST_MANAGED_MEMORY_HPP_
+
+#include <cstddef>
+#include <cuda_runtime.h>
+#include <thrust/device_malloc_allocator.h>
+#include <thrust/device_ptr.h>
+#include <thrust/device_vector.h>
+
+namespace prost {
+
+///
+/// \brief Where the data of the linear operator is stored. In device memory
+///        the operator has to fit next to the iterates. In managed memory
+///        it may exceed the device memory, the blocks are then prefetched
+///        to the GPU one after another while the operator is evaluated.
+///        kAuto uses device memory and falls back to managed memory if the
+///        problem or the backend run out of device memory.
+///
+enum class OperatorMemory
+{
+  kDevice = 0,
+  kManaged,
+  kAuto
+};
+
+/// \brief Allocates bytes in managed memory if a ManagedMemoryScope is 
+///        active on the calling thread, otherwise in device memory. 
+///        Throws std::bad_alloc on failure.
+void *AllocateOperatorMemory(size_t bytes);
+
+/// \brief Frees memory returned by AllocateOperatorMemory.
+void FreeOperatorMemory(void *ptr);
+
+/// \brief Prefetches bytes at ptr to the given device (-1 is the current 
+///        one) on stream. Does nothing if ptr is not in managed memory or 
+///        the stream is being captured into a graph.
+void PrefetchOperatorMemory(
+  const void *ptr,
+  size_t bytes,
+  int device,
+  cudaStream_t stream);
+
+///
+/// \brief While alive, operator_vectors allocated on the calling thread are
+///        put in managed memory. Scopes may be nested.
+///
+class ManagedMemoryScope {
+public:
+  explicit ManagedMemoryScope(bool enable = true);
+  ~ManagedMemoryScope();
+
+  ManagedMemoryScope(const ManagedMemoryScope&) = delete;
+  ManagedMemoryScope& operator=(const ManagedMemoryScope&) = delete;
+
+private:
+  bool prev_;
+};
+
+///
+/// \brief Thrust allocator of the operator data, see AllocateOperatorMemory.
+///        The pointers stay device_ptrs, so the vectors are passed to the
+///        kernels exactly like device_vectors.
+///
+template<typename T>
+class OperatorAllocator : public thrust::device_malloc_allocator<T> {
+public:
+  typedef thrust::device_malloc_allocator<T> super_t;
+  typedef typename super_t::pointer pointer;
+  typedef typename super_t::size_type size_type;
+
+  template<typename U>
+  struct rebind { typedef OperatorAllocator<U> other; };
+
+  OperatorAllocator() {}
+  OperatorAllocator(const OperatorAllocator&) {}
+
+  template<typename U>
+  OperatorAllocator(const OperatorAllocator<U>&) {}
+
+  pointer allocate(size_type n)
+  {
+    return pointer(static_cast<T *>(AllocateOperatorMemory(n * sizeof(T))));
+  }
+
+  void deallocate(pointer p, size_type)
+  {
+    FreeOperatorMemory(thrust::raw_pointer_cast(p));
+  }
+};
+
+template<typename T>
+using operator_vector = thrust::device_vector<T, OperatorAllocator<T>>;
+
+/// \brief Prefetches the elements of v, see PrefetchOperatorMemory.
+template<typename T>
+void PrefetchOperatorVector(
+  const operator_vector<T>& v,
+  int device,
+  cudaStream_t stream)
+{
+  PrefetchOperatorMemory(thrust::raw_pointer_cast(v.data()), v.size() * sizeof(T), device, stream);
+}
+
+} // namespace prost
+
+#endif // PROST_MANAGED_MEMORY_HPP_
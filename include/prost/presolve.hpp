@@ -0,0 +1,127 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PRESOLVE_HPP_
+#define PROST_PRESOLVE_HPP_
+
+#include <utility>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+template<typename T> class Problem;
+template<typename T> class Prox;
+
+/// 
+/// \brief Reduces a problem before it is initialized. Columns fixed by the
+///        indicator of a point (1D ind_eq0 with a, c != 0) are substituted,
+///        their contribution K x shifts the functions of the rows. Functions
+///        of columns or rows without entries in K are minimized on the host,
+///        see Prox::EvalHost, and removed. The remaining operator is stored
+///        as a single sparse block. Expand() maps solutions of the reduced
+///        problem back to the original one.
+///
+///        Variables are only eliminated together with their whole prox,
+///        the proxs that are kept are shared with the reduced problem and
+///        moved to their new indices until Restore() is called.
+/// 
+template<typename T>
+class Presolve {
+public:
+  Presolve(shared_ptr<Problem<T>> problem);
+  virtual ~Presolve() {}
+
+  /// \brief Builds the reduced problem. The initial solution x0, y0 (may be
+  ///        empty) is the starting point for minimizing the functions of
+  ///        the eliminated variables. Returns false if nothing could be
+  ///        eliminated or the blocks do not provide their entries.
+  bool Reduce(const vector<T>& x0, const vector<T>& y0);
+
+  /// \brief Moves the shared proxs back to their original indices.
+  void Restore();
+
+  shared_ptr<Problem<T>> reduced() const { return reduced_; }
+  size_t eliminated_cols() const { return problem_->ncols() - reduced_->ncols(); }
+  size_t eliminated_rows() const { return problem_->nrows() - reduced_->nrows(); }
+
+  /// \brief Restricts a primal (dual) vector of the original problem to the
+  ///        variables of the reduced problem.
+  vector<T> RestrictPrimal(const vector<T>& x) const { return Restrict(x, col_map_); }
+  vector<T> RestrictDual(const vector<T>& y) const { return Restrict(y, row_map_); }
+
+  /// \brief Maps a solution (x, z, y, w) of the reduced problem to the
+  ///        original problem.
+  void Expand(
+    const vector<T>& x,
+    const vector<T>& z,
+    const vector<T>& y,
+    const vector<T>& w,
+    vector<T>& full_x,
+    vector<T>& full_z,
+    vector<T>& full_y,
+    vector<T>& full_w) const;
+
+protected:
+  typedef vector<shared_ptr<Prox<T>>> ProxList;
+
+  /// \brief Sorted copy of proxs with the gaps filled by ProxZeros, split
+  ///        where the emptiness of the variables changes.
+  static ProxList Cover(const ProxList& proxs, const vector<bool>& empty);
+
+  /// \brief Minimizes the function of prox over its variables by proximal 
+  ///        point iterations, starting from the values in x. Returns false
+  ///        and leaves x unchanged unless a fixed point is reached or the
+  ///        iterations contract fast enough to bound the distance to the
+  ///        minimizer by the tolerance.
+  bool Minimize(Prox<T>& prox, vector<T>& x);
+
+  static vector<T> Restrict(const vector<T>& v, const vector<int32_t>& map);
+
+  shared_ptr<Problem<T>> problem_;
+  shared_ptr<Problem<T>> reduced_;
+
+  /// \brief Index of each column (row) in the reduced problem, -1 if the
+  ///        variable was eliminated.
+  vector<int32_t> col_map_;
+  vector<int32_t> row_map_;
+
+  /// \brief Values of the eliminated primal (dual) variables.
+  vector<T> col_value_;
+  vector<T> row_value_;
+
+  /// \brief K x of the fixed columns.
+  vector<T> shift_;
+
+  /// \brief Entries of K in the fixed columns, to compute their w = -K^T y.
+  vector<int32_t> elim_rows_;
+  vector<int32_t> elim_cols_;
+  vector<T> elim_vals_;
+
+  /// \brief Shared proxs and their original index.
+  vector<std::pair<shared_ptr<Prox<T>>, size_t>> moved_;
+
+  /// \brief Unit step sizes for Minimize().
+  vector<T> ones_;
+};
+
+} // namespace prost
+
+#endif // PROST_PRESOLVE_HPP_
@@ -25,6 +25,7 @@
 #include <thrust/device_vector.h>
 
 #include "prost/common.hpp"
+#include "prost/execution_context.hpp"
 
 namespace prost {
 
@@ -32,9 +33,11 @@ using thrust::device_vector;
 using thrust::device_ptr;
 
 template<typename T> class Prox;
+template<typename T> class ProxWorkspace;
 template<typename T> class Block;
 template<typename T> class LinearOperator;
 template<typename T> class DualLinearOperator;
+template<typename T> class Presolve;
 
 /// @brief Contains all information describing the graph form problem
 /// 
@@ -47,6 +50,8 @@ template<typename T> class DualLinearOperator;
 /// 
 template<typename T>
 class Problem {
+  friend class Presolve<T>;
+
 public:
   enum Scaling {
     /// \brief No preconditioning.
@@ -75,6 +80,19 @@ public:
   void Initialize();
   void Release();
 
+  /// \brief Prepares the problem for a backend running on the host, see
+  ///        BackendHost. Nothing is uploaded to the GPU: the blocks have to
+  ///        store their entries (see Block::AppendTriplets) and the proxs
+  ///        have to support host evaluation. The preconditioners are 
+  ///        computed on the host, see host_scaling_left().
+  void InitializeHost();
+
+  /// \brief Has to be called after block or prox data was replaced in
+  ///        place (e.g. BlockDiags::SetFactors, ProxTransform::SetCoefficients).
+  ///        Recomputes the preconditioners if they depend on the operator,
+  ///        everything else stays on the device.
+  void Update();
+
   /// \brief Sets a predefined problem scaling.
   /// \param[in] left Left scaling/preconditioner diagonal matrix Sigma^{1/2}.
   /// \param[in] right Right scaling/preconditioner diagonal matrix Tau^{1/2}.
@@ -92,9 +110,39 @@ public:
   /// \brief
   void SetDimensions(size_t nrows, size_t ncols) { nrows_ = nrows; ncols_ = ncols; }
 
+  /// \brief Merge small neighbouring elementwise proxs of the same type
+  ///        into a single kernel launch in Initialize()? Enabled by default.
+  void set_batch_proxes(bool batch_proxes) { batch_proxes_ = batch_proxes; }
+
+  /// \brief Replaces contiguous runs of small batchable proxs of the same
+  ///        type by a single prox which evaluates them in one kernel launch.
+  ///        Small zero proxs in between are absorbed into the runs. Requires
+  ///        the proxs to cover the domain without overlap, sorted by 
+  ///        CoverDomainProx().
+  static void BatchProxes(ProxList& proxs);
+
+  /// \brief Merge small blocks of the linear operator into a single sparse
+  ///        matrix in Initialize()? Enabled by default, see
+  ///        LinearOperator::set_merge_blocks.
+  void set_merge_blocks(bool merge_blocks) { merge_blocks_ = merge_blocks; }
+
+  /// \brief Sets the context handed to the blocks and proxs in Initialize(),
+  ///        done by the Solver. Without one the default context is used.
+  void set_context(shared_ptr<ExecutionContext> context) { context_ = context; }
+  ExecutionContext& context()
+  {
+    if(!context_)
+      context_ = ExecutionContext::Default();
+
+    return *context_;
+  }
+
   shared_ptr<LinearOperator<T>> linop() const { return linop_; }
+  shared_ptr<ProxWorkspace<T>> prox_workspace() const { return prox_workspace_; }
   device_vector<T>& scaling_left() { return scaling_left_; }
   device_vector<T>& scaling_right() { return scaling_right_; }
+  const vector<T>& host_scaling_left() const { return host_scaling_left_; }
+  const vector<T>& host_scaling_right() const { return host_scaling_right_; }
   const ProxList& prox_f() const { return prox_f_; }
   const ProxList& prox_g() const { return prox_g_; }
   const ProxList& prox_fstar() const { return prox_fstar_; }
@@ -102,16 +150,28 @@ public:
 
   size_t nrows() const { return nrows_; }
   size_t ncols() const { return ncols_; }
+  typename Problem<T>::Scaling scaling_type() const { return scaling_type_; }
 
   size_t gpu_mem_amount() const;
 
-  /// \brief Estimates the norm of the scaled linear operator via power iteration.
+  /// \brief Estimates the norm of the scaled linear operator by the Lanczos
+  ///        method on A^T A with A = Sigma^{1/2} K Tau^{1/2}. The estimate
+  ///        is cached under the versions of K and of the preconditioners,
+  ///        so that it is only computed again after Update() or a new
+  ///        Initialize().
   T normest(T tol = 1e-6, int max_iters = 100);
 
+  /// \brief Drops all cached operator norms.
+  static void ClearNormestCache();
+
   /// \brief Dualizes the problem by doing the following swappings:
   ///        Swap g <-> f*, f <-> g*, K <-> -K^T
-  ///        Should be called after Initialize(). 
+  ///        Should be called after Initialize(). Only pointers are swapped,
+  ///        calling it again restores the primal problem.
   void Dualize();
+
+  /// \brief True if the problem currently is in its dual formulation.
+  bool dualized() const { return dualized_; }
   
 protected:
   size_t nrows_, ncols_; // problem size
@@ -136,6 +196,14 @@ protected:
   /// \brief User-defined (squared) right-preconditioner Tau
   vector<T> scaling_right_host_;
 
+  /// \brief Sigma and Tau computed by InitializeHost().
+  vector<T> host_scaling_left_;
+  vector<T> host_scaling_right_;
+
+  /// \brief Identifies scaling_left_ and scaling_right_, a new one is
+  ///        drawn by InitializeScaling().
+  uint64_t scaling_version_;
+
   /// \brief alpha for Pock-preconditioning
   T scaling_alpha_;
 
@@ -145,9 +213,50 @@ protected:
   ProxList prox_fstar_;
   ProxList prox_gstar_;
 
+  /// \brief Scratch memory shared by all proximal operators.
+  shared_ptr<ProxWorkspace<T>> prox_workspace_;
+
+  /// \brief Batch small proxs in Initialize()?
+  bool batch_proxes_;
+
+  /// \brief Merge small operator blocks in Initialize()?
+  bool merge_blocks_;
+
+  bool dualized_;
+
+  /// \brief Was the problem last set up by InitializeHost()?
+  bool initialized_host_;
+
+  shared_ptr<ExecutionContext> context_;
+
 private:
+  /// \brief result = A * rhs (or A^T * rhs) with A = Sigma^{1/2} K Tau^{1/2}.
+  void ApplyScaledOperator(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    device_vector<T>& temp_rhs,
+    device_vector<T>& temp_result,
+    bool adjoint);
+
+  /// \brief Checks the prox operators and fills the gaps of the domains
+  ///        with ProxZero.
+  void CheckProxes();
+
+  /// \brief Computes the preconditioners on the GPU, for kScalingAlpha from
+  ///        the row and column sums of the blocks.
+  void InitializeScaling();
+
+  /// \brief Computes host_scaling_left_ and host_scaling_right_ like 
+  ///        InitializeScaling() from the entries of the operator.
+  void InitializeScalingHost();
+
   /// \brief Averages the values for the preconditioner at the entries where
-  ///        prox does not allow diagonal step sizes.
+  ///        prox does not allow diagonal step sizes, on the GPU.
+  void AveragePreconditioners(
+    device_vector<T>& precond,
+    const ProxList& prox);
+
+  /// \brief Host version of AveragePreconditioners.
   void AveragePreconditioners(
     vector<T>& precond,
     const ProxList& prox);
@@ -0,0 +1,181 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PROBLEM_FILE_HPP_
+#define PROST_PROBLEM_FILE_HPP_
+
+#include "prost/common.hpp"
+#include "prost/solver.hpp"
+
+namespace prost {
+
+template<typename T> class Problem;
+template<typename T> class Backend;
+
+///
+/// \brief Read-only memory mapping of a whole file.
+///
+class MappedFile {
+public:
+  MappedFile(const string& path);
+  ~MappedFile();
+
+  /// \brief Page-locks the mapping, so that copies from it to the device
+  ///        are direct DMA transfers. Returns false if the driver does
+  ///        not support this for file mappings.
+  bool RegisterHost();
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+
+private:
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  const char *data_;
+  size_t size_;
+  bool registered_;
+
+#ifdef _WIN32
+  void *file_;
+  void *mapping_;
+#else
+  int fd_;
+#endif
+};
+
+///
+/// \brief Value stored in a problem file. The values mirror the MATLAB
+///        data of a problem: numeric arrays, sparse matrices, strings,
+///        cell arrays and structs. Arrays point into the mapped file.
+///
+struct ProblemFileNode {
+  enum Type {
+    kEmpty = 0,
+    kDouble = 1,
+    kSingle = 2,
+    kSparseDouble = 3,
+    kSparseSingle = 4,
+    kString = 5,
+    kCell = 6,
+    kStruct = 7,
+  };
+
+  Type type;
+
+  /// \brief Dimensions of arrays, sparse matrices and cell arrays.
+  size_t rows;
+  size_t cols;
+
+  /// \brief Elements of a numeric array in column-first order.
+  const void *data;
+
+  /// \brief Sparse matrix in CSR, its transpose in CSR (i.e. the matrix
+  ///        in CSC) in the arrays with suffix _t.
+  size_t nnz;
+  const int32_t *ptr, *ind, *ptr_t, *ind_t;
+  const void *val, *val_t;
+
+  string str;
+
+  /// \brief Elements of a cell array in column-first order or the values
+  ///        of the fields of a struct.
+  vector<ProblemFileNode> children;
+  vector<string> fields;
+
+  size_t numel() const { return rows * cols; }
+
+  /// \brief Cell array element, throws if out of bounds.
+  const ProblemFileNode& operator[](size_t i) const;
+
+  /// \brief Struct field, throws if it does not exist.
+  const ProblemFileNode& field(const string& name) const;
+  bool has_field(const string& name) const;
+
+  /// \brief First element of a numeric array.
+  double scalar() const;
+
+  /// \brief Copies a numeric array, converting it to T.
+  template<typename T> vector<T> values() const;
+};
+
+/// 
+/// \brief Problem stored in a binary file: the problem data, the backend
+///        and the solver options, as written by prost.write_problem. The
+///        file is mapped into memory and sparse blocks are uploaded to the
+///        device straight from the mapping; the mapping stays alive as
+///        long as a block created from it.
+///
+/// File layout, all integers little-endian: the magic "PROSTPRB", uint32
+/// version and uint32 reserved, followed by the root node. A node starts
+/// with uint32 type, uint32 reserved, uint64 a and uint64 b:
+///
+/// - kEmpty: no payload (values without a representation, e.g. function
+///   handles).
+/// - kDouble, kSingle: a x b array, its elements start at the next
+///   multiple of 64 bytes.
+/// - kSparseDouble, kSparseSingle: a x b matrix, followed by uint64 nnz
+///   and the arrays ptr, ind, val, ptr_t, ind_t, val_t (indices int32),
+///   each starting at the next multiple of 64 bytes. The indices of each
+///   row (column) are strictly increasing, and the CSR and CSC have to 
+///   hold the same entries; the loader checks both.
+/// - kString: a characters.
+/// - kCell: a x b cell array, followed by its elements.
+/// - kStruct: a fields, each a kString node with the name followed by
+///   the value.
+///
+/// Every node starts at a multiple of 8 bytes. The root is a struct with
+/// the fields prob (the data of prost.problem), nrows, ncols, backend 
+/// and opts.
+///
+/// @tparam typename T. Floating point-type.
+///
+template<typename T>
+class ProblemFile {
+public:
+  /// \brief Maps and parses the file. If register_host is set, the mapping
+  ///        is page-locked where the driver supports it.
+  ProblemFile(const string& path, bool register_host = true);
+  virtual ~ProblemFile() {}
+
+  /// \brief Creates the problem. Sparse blocks stored in precision T 
+  ///        reference the mapping, all other data is copied.
+  shared_ptr<Problem<T>> CreateProblem() const;
+
+  shared_ptr<Backend<T>> CreateBackend() const;
+
+  /// \brief Solver options of the file, the solution is fetched to the
+  ///        host and intermediate callbacks are not set.
+  typename Solver<T>::Options CreateSolverOptions() const;
+
+  const ProblemFileNode& root() const { return root_; }
+
+  /// \brief True if the mapping is page-locked.
+  bool host_registered() const { return host_registered_; }
+
+private:
+  shared_ptr<MappedFile> file_;
+  ProblemFileNode root_;
+  bool host_registered_;
+};
+
+} // namespace prost
+
+#endif // PROST_PROBLEM_FILE_HPP_
@@ -0,0 +1,118 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef PROST_PROFILER_HPP_
+#define PROST_PROFILER_HPP_
+
+#include <atomic>
+#include <typeinfo>
+
+#include <cuda_runtime.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+///
+/// \brief Aggregates the GPU time of the solver components (blocks, proxes,
+///        backend phases) across iterations. Each range is marked with NVTX
+///        and timed with a pair of CUDA events. Profiling is process-wide 
+///        and disabled by default, in which case a range costs one branch.
+///        Ranges nest per host thread, so the time of a backend phase 
+///        includes the blocks and proxes evaluated in it. All functions
+///        may be called concurrently from several host threads.
+///
+class Profiler {
+public:
+  struct Entry {
+    string name;
+    size_t calls;
+    double time_ms;
+    double bytes;
+
+    /// \brief Achieved bandwidth in GB/s, 0 if the bytes are unknown.
+    double bandwidth() const { return time_ms > 0 ? bytes / (time_ms * 1e6) : 0; }
+  };
+
+  /// \brief Enables the profiling for one more solver, or disables it for
+  ///        one if enable is false. Ranges are recorded as long as at least
+  ///        one solver profiles.
+  static void Enable(bool enable);
+  static bool enabled() { return enabled_.load(std::memory_order_relaxed) > 0; }
+
+  /// \brief Returns the id of the component with the given name.
+  static int Register(const string& name);
+
+  /// \brief Returns the id of the component with the given type, suffix is
+  ///        appended to the demangled type name.
+  static int Register(const std::type_info& type, const char *suffix);
+
+  static void Begin(int id, cudaStream_t stream);
+  static void End(double bytes, cudaStream_t stream);
+  
+  /// \brief Waits for all finished ranges and returns the breakdown sorted
+  ///        by descending time.
+  static vector<Entry> Report();
+
+  /// \brief Clears the breakdown and frees the recorded events. Does
+  ///        nothing while a solver profiles, whose ranges would be lost.
+  static void Reset();
+
+private:
+  /// \brief Has to be called with the lock held.
+  static void Collect();
+
+  /// \brief Number of solvers profiling.
+  static std::atomic<int> enabled_;
+};
+
+///
+/// \brief Profiles the enclosing scope.
+///
+class ProfileRange {
+public:
+  ProfileRange(const char *name, double bytes, cudaStream_t stream) 
+      : active_(Profiler::enabled()), bytes_(bytes), stream_(stream)
+  {
+    if(active_) 
+      Profiler::Begin(Profiler::Register(name), stream);
+  }
+
+  ProfileRange(const std::type_info& type, const char *suffix, double bytes, cudaStream_t stream) 
+      : active_(Profiler::enabled()), bytes_(bytes), stream_(stream)
+  {
+    if(active_) 
+      Profiler::Begin(Profiler::Register(type, suffix), stream);
+  }
+
+  ~ProfileRange()
+  {
+    if(active_) 
+      Profiler::End(bytes_, stream_);
+  }
+
+private:
+  bool active_;
+  double bytes_;
+  cudaStream_t stream_;
+};
+
+} // namespace prost
+
+#endif // PROST_PROFILER_HPP_
@@ -23,6 +23,8 @@
 
 #include "prost/prox/shared_mem.hpp"
 #include "prost/prox/vector.hpp"
+#include "prost/prox/group_kernel.hpp"
+#include "prost/config.hpp"
 
 namespace prost {
 
@@ -37,6 +39,15 @@ public:
     inline __host__ __device__ size_t operator()(size_t dim) { return 0; }
   };
   typedef SHARED_MEM_TYPE SharedMemType;
+
+  /// \brief If true, the operation provides a static function
+  ///        EvalWarp(res, arg, dim, lane) which is called by all threads 
+  ///        of a warp to cooperatively process one element.
+  static const bool kWarpCooperative = false;
+
+  /// \brief If true, the constructor and operator() are __host__ __device__
+  ///        and the operation can be evaluated by BackendHost.
+  static const bool kHostEval = true;
 };
 
 } // namespace prost
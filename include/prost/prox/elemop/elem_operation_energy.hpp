@@ -0,0 +1,107 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_ELEM_OPERATION_ENERGY_HPP_
+#define PROST_ELEM_OPERATION_ENERGY_HPP_
+
+#include <type_traits>
+
+#include "prost/prox/vector.hpp"
+#include "prost/prox/elemop/elem_operation_1d.hpp"
+#include "prost/prox/elemop/elem_operation_norm2.hpp"
+#include "prost/prox/elemop/function_1d_energy.hpp"
+
+namespace prost {
+
+///
+/// \brief Evaluates the Fenchel-Young gap h(sx x) + h^*(sy y) - sx sy <x, y>
+///        of the function h of an elementwise operation on one element,
+///        where the coefficients are the ones passed to the operation. 
+///        The gap is nonnegative, infinite if x or y is infeasible, and 
+///        zero iff sy y is a subgradient of h at sx x. Operations without 
+///        a closed form conjugate keep kSupported false.
+///
+template<typename T, class ELEM_OPERATION, class ENABLE = void>
+struct ElemOperationEnergy
+{
+  static const bool kSupported = false;
+};
+
+template<typename T, class FUN_1D>
+struct ElemOperationEnergy<T, ElemOperation1D<T, FUN_1D>, 
+  typename std::enable_if<Function1DEnergy<T, FUN_1D>::kSupported>::type>
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__
+  static T FenchelYoung(
+    const T *coeffs,
+    const Vector<const T>& x,
+    const Vector<const T>& y,
+    size_t dim,
+    T x_scale,
+    T y_scale)
+  {
+    const T x0 = x_scale * x[0];
+    const T y0 = y_scale * y[0];
+
+    return Function1DScaledValue<T, FUN_1D>(x0, coeffs) + 
+      Function1DScaledConjugate<T, FUN_1D>(y0, coeffs) - x0 * y0;
+  }
+};
+
+/// \brief For h(x) = phi(|x|), h^*(y) = phi^*(|y|) holds if the supremum 
+///        defining phi^*(s) is attained at a nonnegative t for s >= 0, 
+///        which is the case for the usual choices of phi.
+template<typename T, class FUN_1D>
+struct ElemOperationEnergy<T, ElemOperationNorm2<T, FUN_1D>, 
+  typename std::enable_if<Function1DEnergy<T, FUN_1D>::kSupported>::type>
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__
+  static T FenchelYoung(
+    const T *coeffs,
+    const Vector<const T>& x,
+    const Vector<const T>& y,
+    size_t dim,
+    T x_scale,
+    T y_scale)
+  {
+    T norm_x = 0, norm_y = 0, dot = 0;
+
+    for(size_t i = 0; i < dim; i++)
+    {
+      const T xi = x_scale * x[i];
+      const T yi = y_scale * y[i];
+
+      norm_x += xi * xi;
+      norm_y += yi * yi;
+      dot += xi * yi;
+    }
+
+    return Function1DScaledValue<T, FUN_1D>(sqrt(norm_x), coeffs) + 
+      Function1DScaledConjugate<T, FUN_1D>(sqrt(norm_y), coeffs) - dot;
+  }
+};
+
+} // namespace prost
+
+#endif // PROST_ELEM_OPERATION_ENERGY_HPP_
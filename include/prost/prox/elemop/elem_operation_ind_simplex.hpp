@@ -25,8 +25,6 @@
 
 namespace prost {
 
-#define MAX_DIM 1024
-
 /// 
 /// \brief Computes prox for sum of simplex indicator functions.
 ///
@@ -36,10 +34,19 @@ namespace prost {
 ///        See http://arxiv.org/pdf/1101.6081v2.pdf.
 ///
 ///        Replaced shared memory by local memory. (cached on newer architectures)
+///        Dimensions up to kElemOperationWarpMinDim are sorted in local 
+///        memory, larger ones are projected with Michelot's algorithm.
+///
+///        For large dim, EvalWarp avoids the sort and computes the threshold
+///        with Michelot's algorithm, see Condat, "Fast projection onto the 
+///        simplex and the l1 ball", Math. Program. 2016.
 ///
 template<typename T>
 struct ElemOperationIndSimplex : public ElemOperation<0, 0, T>
 {
+  static const bool kWarpCooperative = true;
+  static const bool kHostEval = false;
+
   __device__
   ElemOperationIndSimplex(size_t dim, SharedMem<typename ElemOperationIndSimplex::SharedMemType, typename ElemOperationIndSimplex::GetSharedMemCount>& shared_mem)
       : dim_(dim) { } 
@@ -53,7 +60,15 @@ struct ElemOperationIndSimplex : public ElemOperation<0, 0, T>
     T tau_scal,
     bool invert_tau) 
   {
-    T local_mem[MAX_DIM]; 
+    // larger dimensions are usually evaluated by EvalWarp, otherwise they
+    // don't fit into local memory and are projected without sorting
+    if(dim_ > kElemOperationWarpMinDim)
+    {
+      EvalMichelot(res, arg);
+      return;
+    }
+
+    T local_mem[kElemOperationWarpMinDim]; 
 
     // 1) read dim-dimensional vector into local memory
     for(size_t i = 0; i < dim_; i++)
@@ -91,6 +106,100 @@ struct ElemOperationIndSimplex : public ElemOperation<0, 0, T>
     }  
   }
   
+  ///
+  /// \brief Warp-cooperative projection, each of the 32 threads handles a
+  ///        strided part of the vector. The threshold
+  ///
+  ///          tmax = (sum_{x_i > tmax_prev} x_i - 1) / #{x_i > tmax_prev}
+  ///
+  ///        increases monotonically, the active set shrinks until it stays
+  ///        the same, which happens after a few iterations in practice and
+  ///        after at most dim iterations.
+  ///
+  static inline __device__
+  void
+  EvalWarp(
+    Vector<T>& res,
+    const Vector<const T>& arg,
+    size_t dim,
+    unsigned int lane)
+  {
+    T sum = 0;
+    for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+      sum += arg[i];
+
+    size_t active = dim;
+    T tmax = (WarpReduceSum(sum) - 1.) / static_cast<T>(dim);
+
+    while(true)
+    {
+      T sum_active = 0;
+      unsigned int count_active = 0;
+      for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+      {
+        const T val = arg[i];
+
+        if(val > tmax)
+        {
+          sum_active += val;
+          count_active++;
+        }
+      }
+
+      sum_active = WarpReduceSum(sum_active);
+      const size_t count = WarpReduceSum(count_active);
+
+      if(count == active || count == 0)
+        break;
+
+      active = count;
+      tmax = (sum_active - 1.) / static_cast<T>(count);
+    }
+
+    for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+      res[i] = max(arg[i] - tmax, static_cast<T>(0));
+  }
+
+  /// \brief Single-threaded version of EvalWarp, needs no local memory.
+  __device__
+  void
+  EvalMichelot(
+    Vector<T>& res,
+    const Vector<const T>& arg)
+  {
+    T sum = 0;
+    for(size_t i = 0; i < dim_; i++)
+      sum += arg[i];
+
+    size_t active = dim_;
+    T tmax = (sum - 1.) / static_cast<T>(dim_);
+
+    while(true)
+    {
+      T sum_active = 0;
+      size_t count = 0;
+      for(size_t i = 0; i < dim_; i++)
+      {
+        const T val = arg[i];
+
+        if(val > tmax)
+        {
+          sum_active += val;
+          count++;
+        }
+      }
+
+      if(count == active || count == 0)
+        break;
+
+      active = count;
+      tmax = (sum_active - 1.) / static_cast<T>(count);
+    }
+
+    for(size_t i = 0; i < dim_; i++)
+      res[i] = max(arg[i] - tmax, static_cast<T>(0));
+  }
+
   __device__
   void
   ShellSort(T *array)
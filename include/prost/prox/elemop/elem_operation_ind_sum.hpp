@@ -31,6 +31,9 @@ namespace prost {
 template<typename T>
 struct ElemOperationIndSum : public ElemOperation<0, 0, T>
 {
+  static const bool kWarpCooperative = true;
+  static const bool kHostEval = false;
+
   __device__
   ElemOperationIndSum(size_t dim, SharedMem<typename ElemOperationIndSum::SharedMemType, typename ElemOperationIndSum::GetSharedMemCount>& shared_mem)
       : dim_(dim) { } 
@@ -56,6 +59,26 @@ struct ElemOperationIndSum : public ElemOperation<0, 0, T>
       res[i] = arg[i] - tl; 
     }
   }
+
+  /// \brief Same as operator(), with the sum computed by the whole warp.
+  static inline __device__
+  void
+  EvalWarp(
+    Vector<T>& res,
+    const Vector<const T>& arg,
+    size_t dim,
+    unsigned int lane)
+  {
+    T tl = 0;
+
+    for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+      tl += arg[i];
+
+    tl = (WarpReduceSum(tl) - 1.) / static_cast<T>(dim);
+
+    for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+      res[i] = arg[i] - tl;
+  }
     
  private:
   size_t dim_;
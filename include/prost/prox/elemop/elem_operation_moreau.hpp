@@ -0,0 +1,88 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_ELEM_OPERATION_MOREAU_HPP_
+#define PROST_ELEM_OPERATION_MOREAU_HPP_
+
+#include "prost/prox/elemop/elem_operation.hpp"
+
+namespace prost {
+
+///
+/// \brief Evaluates the prox of the conjugate of ELEM_OPERATION by Moreau's
+///        identity, analogous to Function2DMoreau. Used by ProxMoreau to
+///        evaluate elementwise conjugates in a single pass. The element is
+///        kept in registers, so the dimension has to be fixed at compile
+///        time.
+///
+template<typename T, class ELEM_OPERATION>
+struct ElemOperationMoreau : public ElemOperation<ELEM_OPERATION::kDim, ELEM_OPERATION::kCoeffsCount, typename ELEM_OPERATION::SharedMemType>
+{
+  static_assert(ELEM_OPERATION::kDim > 0, 
+    "ElemOperationMoreau requires an operation with fixed dimension.");
+
+  typedef typename ELEM_OPERATION::GetSharedMemCount GetSharedMemCount;
+  typedef typename ELEM_OPERATION::SharedMemType SharedMemType;
+  static const bool kHostEval = ELEM_OPERATION::kHostEval;
+
+  inline __host__ __device__
+  ElemOperationMoreau(size_t dim, SharedMem<SharedMemType, GetSharedMemCount>& shared_mem) 
+    : op_(dim, shared_mem) { }
+
+  inline __host__ __device__
+  ElemOperationMoreau(T* coeffs, size_t dim, SharedMem<SharedMemType, GetSharedMemCount>& shared_mem) 
+    : op_(coeffs, dim, shared_mem) { }
+
+  inline __host__ __device__
+  void operator()(Vector<T>& res, const Vector<const T>& arg, const Vector<const T>& tau_diag, T tau_scal, bool invert_tau)
+  {
+    // res may alias arg, so the argument is saved before the inner
+    // operation overwrites it
+    T y[ELEM_OPERATION::kDim];
+    T scaled[ELEM_OPERATION::kDim];
+    for(size_t i = 0; i < ELEM_OPERATION::kDim; i++)
+    {
+      const T tau = tau_scal * tau_diag[i];
+
+      y[i] = arg[i];
+      scaled[i] = invert_tau ? y[i] * tau : y[i] / tau;
+    }
+
+    const Vector<const T> scaled_vec(1, ELEM_OPERATION::kDim, true, 0, scaled);
+    op_(res, scaled_vec, tau_diag, tau_scal, !invert_tau);
+
+    for(size_t i = 0; i < ELEM_OPERATION::kDim; i++)
+    {
+      const T tau = tau_scal * tau_diag[i];
+
+      if(invert_tau)
+        res[i] = y[i] - res[i] / tau;
+      else
+        res[i] = y[i] - tau * res[i];
+    }
+  }
+
+private:
+  ELEM_OPERATION op_;
+};
+
+} // namespace prost
+
+#endif // PROST_ELEM_OPERATION_MOREAU_HPP_
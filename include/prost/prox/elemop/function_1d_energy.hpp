@@ -0,0 +1,211 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_FUNCTION_1D_ENERGY_HPP_
+#define PROST_FUNCTION_1D_ENERGY_HPP_
+
+#include <cmath>
+
+#include "prost/prox/elemop/function_1d.hpp"
+
+namespace prost {
+
+/// \brief Value of an infinite energy, e.g. of a violated indicator.
+template<typename T>
+inline __host__ __device__ T EnergyInfinity();
+
+template<>
+inline __host__ __device__ float EnergyInfinity<float>() { return HUGE_VALF; }
+
+template<>
+inline __host__ __device__ double EnergyInfinity<double>() { return HUGE_VAL; }
+
+/// \brief Violation up to which a constraint counts as satisfied, about 
+///        the square root of the machine precision. The iterates are
+///        outputs of projections, which are only feasible up to rounding.
+template<typename T>
+inline __host__ __device__ T EnergyFeasTol();
+
+template<>
+inline __host__ __device__ float EnergyFeasTol<float>() { return 3e-4f; }
+
+template<>
+inline __host__ __device__ double EnergyFeasTol<double>() { return 1.5e-8; }
+
+/// \brief Value of an indicator function whose constraint is violated by
+///        the given amount.
+template<typename T>
+inline __host__ __device__ T EnergyIndicator(T violation)
+{
+  return (violation <= EnergyFeasTol<T>()) ? 0 : EnergyInfinity<T>();
+}
+
+///
+/// \brief Closed forms of the value and the convex conjugate of the 1D
+///        functions, which are used to evaluate the primal-dual gap. Only
+///        the convex functions provide them, the others keep kSupported 
+///        false. Kept apart from function_1d.hpp, which is also compiled 
+///        at runtime without the standard library.
+///
+template<typename T, class FUN_1D>
+struct Function1DEnergy
+{
+  static const bool kSupported = false;
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DZero<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return 0; }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return EnergyIndicator<T>(abs(y)); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DAbs<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return abs(x); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return EnergyIndicator<T>(abs(y) - 1); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DSquare<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return x * x / 2; }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return y * y / 2; }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DIndLeq0<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return EnergyIndicator<T>(x); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return EnergyIndicator<T>(-y); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DIndGeq0<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return EnergyIndicator<T>(-x); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return EnergyIndicator<T>(y); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DIndEq0<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return EnergyIndicator<T>(abs(x)); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return 0; }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DIndBox01<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return EnergyIndicator<T>(max(-x, x - 1)); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return max(y, static_cast<T>(0)); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DMaxPos0<T> >
+{
+  static const bool kSupported = true;
+
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) { return max(x, static_cast<T>(0)); }
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) { return EnergyIndicator<T>(max(-y, y - 1)); }
+};
+
+template<typename T>
+struct Function1DEnergy<T, Function1DHuber<T> >
+{
+  static const bool kSupported = true;
+
+  // x^2 / (2 alpha) for |x| < alpha, |x| - alpha / 2 otherwise
+  inline __host__ __device__ static T Value(T x, T alpha, T beta) 
+  { 
+    if(abs(x) < alpha)
+      return x * x / (2 * alpha);
+
+    return abs(x) - alpha / 2;
+  }
+
+  inline __host__ __device__ static T Conjugate(T y, T alpha, T beta) 
+  { 
+    return alpha * y * y / 2 + EnergyIndicator<T>(abs(y) - 1); 
+  }
+};
+
+/// 
+/// \brief Value of h(x) = c f(ax - b) + dx + (e/2) x^2 for the coefficients
+///        (a, b, c, d, e, alpha, beta) of ElemOperation1D.
+///
+template<typename T, class FUN_1D>
+inline __host__ __device__ T Function1DScaledValue(T x, const T *coeffs)
+{
+  T value = coeffs[3] * x + coeffs[4] * x * x / 2;
+
+  if(coeffs[0] != 0 && coeffs[2] != 0)
+    value += coeffs[2] * Function1DEnergy<T, FUN_1D>::Value(coeffs[0] * x - coeffs[1], coeffs[5], coeffs[6]);
+
+  return value;
+}
+
+/// 
+/// \brief Value of the conjugate h^*(y) of Function1DScaledValue. Without
+///        the quadratic term it is c f^*((y - d) / (ac)) + b (y - d) / a,
+///        with it the supremum is attained at the prox
+///        x = prox_{h_0 / e}(y / e) of the remaining part h_0 and 
+///        h^*(y) = xy - h(x).
+///
+template<typename T, class FUN_1D>
+inline __host__ __device__ T Function1DScaledConjugate(T y, const T *coeffs)
+{
+  const T a = coeffs[0], b = coeffs[1], c = coeffs[2], d = coeffs[3], e = coeffs[4];
+
+  if(a == 0 || c == 0)
+  {
+    if(e == 0)
+      return EnergyIndicator<T>(abs(y - d));
+
+    return (y - d) * (y - d) / (2 * e);
+  }
+
+  if(e == 0)
+    return c * Function1DEnergy<T, FUN_1D>::Conjugate((y - d) / (a * c), coeffs[5], coeffs[6]) + b * (y - d) / a;
+
+  FUN_1D fun;
+  const T x = (fun(a * (y - d) / e - b, c * a * a / e, coeffs[5], coeffs[6]) + b) / a;
+
+  return x * y - Function1DScaledValue<T, FUN_1D>(x, coeffs);
+}
+
+} // namespace prost
+
+#endif // PROST_FUNCTION_1D_ENERGY_HPP_
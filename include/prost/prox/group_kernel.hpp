@@ -0,0 +1,150 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef PROST_GROUP_KERNEL_HPP_
+#define PROST_GROUP_KERNEL_HPP_
+
+#include "prost/config.hpp"
+
+namespace prost {
+
+/// \brief Sum of val over all threads of a warp, returned to every thread.
+template<typename T>
+inline __device__ T WarpReduceSum(T val)
+{
+  for(int ofs = kWarpSizeCUDA / 2; ofs > 0; ofs /= 2)
+    val += __shfl_xor_sync(0xffffffff, val, ofs);
+
+  return val;
+}
+
+/// \brief Sum of val over all threads of a thread block, returned to every
+///        thread. Has to be reached by the whole block, blockDim.x must be
+///        a multiple of the warp size.
+template<typename T>
+inline __device__ T BlockReduceSum(T val)
+{
+  __shared__ double partial_mem[kWarpSizeCUDA];
+  T *partial = reinterpret_cast<T *>(partial_mem);
+
+  const unsigned int lane = threadIdx.x % kWarpSizeCUDA;
+  const unsigned int warp = threadIdx.x / kWarpSizeCUDA;
+
+  val = WarpReduceSum(val);
+
+  // previous reduction may still read the partial sums
+  __syncthreads();
+  if(lane == 0)
+    partial[warp] = val;
+  __syncthreads();
+
+  val = (lane < blockDim.x / kWarpSizeCUDA) ? partial[lane] : static_cast<T>(0);
+  return WarpReduceSum(val);
+}
+
+///
+/// \brief Mapping of the threads of a kernel onto the groups of a
+///        group-structured prox. group() is the group of the calling
+///        thread, the threads of a group visit the entries 
+///        lane(), lane() + stride(), ... and Reduce() sums a value over
+///        them. For GroupWarp and GroupBlock all threads of a warp or
+///        block belong to the same group, so returning early for
+///        group() >= count is uniform and allowed before Reduce().
+///
+struct GroupThread 
+{
+  static inline __device__ size_t group() { return threadIdx.x + blockDim.x * blockIdx.x; }
+  static inline __device__ size_t lane() { return 0; }
+  static inline __device__ size_t stride() { return 1; }
+
+  template<typename T>
+  static inline __device__ T Reduce(T val) { return val; }
+};
+
+struct GroupWarp 
+{
+  static inline __device__ size_t group() { return (threadIdx.x + blockDim.x * blockIdx.x) / kWarpSizeCUDA; }
+  static inline __device__ size_t lane() { return threadIdx.x % kWarpSizeCUDA; }
+  static inline __device__ size_t stride() { return kWarpSizeCUDA; }
+
+  template<typename T>
+  static inline __device__ T Reduce(T val) { return WarpReduceSum(val); }
+};
+
+struct GroupBlock 
+{
+  static inline __device__ size_t group() { return blockIdx.x; }
+  static inline __device__ size_t lane() { return threadIdx.x; }
+  static inline __device__ size_t stride() { return blockDim.x; }
+
+  template<typename T>
+  static inline __device__ T Reduce(T val) { return BlockReduceSum(val); }
+};
+
+// the JIT compiled elementwise proxs only need the reductions
+#ifndef __CUDACC_RTC__
+
+enum GroupKernel
+{
+  kGroupKernelThread,
+  kGroupKernelWarp,
+  kGroupKernelBlock,
+};
+
+/// \brief Chooses how count groups of dimension dim are mapped onto threads.
+inline GroupKernel ChooseGroupKernel(size_t count, size_t dim)
+{
+  if(dim < kGroupWarpMinDim)
+    return kGroupKernelThread;
+
+  if(dim >= kGroupBlockMinDim || 
+     (dim >= kGroupBlockFewMinDim && count < kGroupBlockFewMaxCount))
+    return kGroupKernelBlock;
+
+  return kGroupKernelWarp;
+}
+
+/// \brief Launch configuration for count groups with the given mapping.
+inline void GroupKernelLaunch(GroupKernel kernel, size_t count, dim3& grid, dim3& block)
+{
+  block = dim3(kBlockSizeCUDA, 1, 1);
+
+  switch(kernel)
+  {
+  case kGroupKernelThread:
+    grid = dim3((count + block.x - 1) / block.x, 1, 1);
+    break;
+
+  case kGroupKernelWarp:
+    grid = dim3((count * kWarpSizeCUDA + block.x - 1) / block.x, 1, 1);
+    break;
+
+  case kGroupKernelBlock:
+    grid = dim3(count, 1, 1);
+    break;
+  }
+}
+
+#endif // __CUDACC_RTC__
+
+} // namespace prost
+
+#endif // PROST_GROUP_KERNEL_HPP_
@@ -38,27 +38,20 @@ inline __host__ __device__ void swap(T& a, T& b)
 
 ///
 /// \brief Computes the orthogonal projection of (x0, y0) onto the epigraph of
-///        the parabola y >= \alpha ||x||^2 with \alpha > 0.
+///        the parabola y >= \alpha ||x||^2 with \alpha > 0 from 
+///        ||x0||^2 only. The projection is x = scale * x0.
 ///
-/// 
 template<typename T>
-inline __host__ __device__ void  ProjectEpiQuadNd(
-     const Vector<T>& x0, const T y0, const T alpha, Vector<T>& x, T& y, size_t dim)
+inline __host__ __device__ void ProjectEpiQuadNdScale(
+  const T sq_norm_x0, const T y0, const T alpha, T& scale, T& y)
 {
-  T sq_norm_x0 = static_cast<T>(0);
-  for(size_t i = 0; i < dim; i++) {
-    sq_norm_x0 += x0[i] * x0[i];
-  }
-  const T norm_x0 = sqrt(sq_norm_x0);
-  
   // nothing to do?
   if(y0 >= alpha * sq_norm_x0) {
-    for(size_t i = 0; i < dim; i++) 
-      x[i] = x0[i];
-
+    scale = 1;
     y = y0;
   }
   else {
+    const T norm_x0 = sqrt(sq_norm_x0);
     const T a = 2. * alpha * norm_x0;
     const T b = 2. * (1. - 2. * alpha * y0) / 3.;
     T d, v;
@@ -83,25 +76,34 @@ inline __host__ __device__ void  ProjectEpiQuadNd(
       v = 2 * sqrt(-b) * cos(acos(a / pow(-b, static_cast<T>(3. / 2.))) / static_cast<T>(3.));
     }
 
-    if(norm_x0 > 0) { 
-      for(size_t i = 0; i < dim; i++) {
-        x[i] = (v / (2. * alpha)) * (x0[i] / norm_x0);
-      }
-    }
-    else {
-      for(size_t i = 0; i < dim; i++) {
-        x[i] = 0;
-      }
-    }
+    if(norm_x0 > 0)
+      scale = v / (2. * alpha * norm_x0);
+    else
+      scale = 0;
 
-    T sq_norm_x = static_cast<T>(0);
-    for(size_t i = 0; i < dim; i++) {
-      sq_norm_x += x[i] * x[i];
-    }
+    y = alpha * scale * scale * sq_norm_x0;
+  }
+}
 
-    y = alpha * sq_norm_x;
-   
+///
+/// \brief Computes the orthogonal projection of (x0, y0) onto the epigraph of
+///        the parabola y >= \alpha ||x||^2 with \alpha > 0.
+///
+/// 
+template<typename T>
+inline __host__ __device__ void  ProjectEpiQuadNd(
+     const Vector<T>& x0, const T y0, const T alpha, Vector<T>& x, T& y, size_t dim)
+{
+  T sq_norm_x0 = static_cast<T>(0);
+  for(size_t i = 0; i < dim; i++) {
+    sq_norm_x0 += x0[i] * x0[i];
   }
+
+  T scale;
+  ProjectEpiQuadNdScale<T>(sq_norm_x0, y0, alpha, scale, y);
+
+  for(size_t i = 0; i < dim; i++) 
+    x[i] = scale * x0[i];
 }
 
 
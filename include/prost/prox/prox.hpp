@@ -22,7 +22,10 @@
 #define PROST_PROX_HPP_
 
 #include <thrust/device_vector.h>
+#include <cuda_runtime.h>
 #include "prost/common.hpp"
+#include "prost/execution_context.hpp"
+#include "prost/prox/prox_workspace.hpp"
 
 namespace prost {
 
@@ -31,6 +34,8 @@ using thrust::device_vector;
 template<typename T> class ProxMoreau;
 template<typename T> class ProxPermute;
 template<typename T> class ProxTransform;
+template<typename T> class Presolve;
+template<typename T> struct ProxArgument;
 
 ///
 /// \brief Virtual base class for all proximal operators. 
@@ -40,6 +45,7 @@ class Prox {
   friend class ProxMoreau<T>;
   friend class ProxPermute<T>;
   friend class ProxTransform<T>;
+  friend class Presolve<T>;
   
 public:
   Prox(size_t index, size_t size, bool diagsteps) :
@@ -50,7 +56,9 @@ public:
   Prox(const Prox<T>& other) :
     index_(other.index_),
     size_(other.size_),
-    diagsteps_(other.diagsteps_) { }
+    diagsteps_(other.diagsteps_),
+    workspace_(other.workspace_),
+    context_(other.context_) { }
   
   virtual ~Prox() { }
 
@@ -60,6 +68,10 @@ public:
   /// \brief Cleans up any data.
   virtual void Release() { }
 
+  /// \brief Called by Problem::Update() after the data of the prox has
+  ///        been changed in place, e.g. by SetCoefficients().
+  virtual void Update() { }
+
   /// 
   /// \brief Evaluates the prox operator on the GPU.
   /// 
@@ -67,13 +79,16 @@ public:
   /// \param Proximal operator argument.
   /// \param Diagonal step sizes.
   /// \param Scalar step size.
+  /// \param Perform the prox with inverted step sizes?
+  /// \param CUDA stream the work is launched on.
   ///
   void Eval(
     thrust::device_vector<T>& result, 
     const thrust::device_vector<T>& arg, 
     const thrust::device_vector<T>& tau_diag, 
     T tau,
-    bool invert_tau = false);
+    bool invert_tau = false,
+    cudaStream_t stream = 0);
 
   /// 
   /// \brief Evaluates the prox operator on the GPU, using CPU data. Mainly 
@@ -91,11 +106,110 @@ public:
     const std::vector<T>& tau_diag, 
     T tau); 
 
+  /// 
+  /// \brief Evaluates the prox operator on the GPU, computing the prox
+  ///        argument on the fly instead of reading it from memory. Only 
+  ///        valid if supports_fused_eval() returns true.
+  /// 
+  /// \param Result of prox.
+  /// \param Description of the proximal operator argument.
+  /// \param Diagonal step sizes.
+  /// \param Scalar step size.
+  /// \param Perform the prox with inverted step sizes?
+  /// \param CUDA stream the work is launched on.
+  ///
+  void EvalFused(
+    thrust::device_vector<T>& result, 
+    const ProxArgument<T>& arg, 
+    const thrust::device_vector<T>& tau_diag, 
+    T tau,
+    bool invert_tau = false,
+    cudaStream_t stream = 0);
+
+  /// \brief Returns true if the prox implements EvalFusedLocal.
+  virtual bool supports_fused_eval() const { return false; }
+
+  /// 
+  /// \brief Writes the Fenchel-Young gap h(sx x) + h^*(sy y) - sx sy <x, y>
+  ///        of the function h of the prox into [gap_beg + index, 
+  ///        gap_beg + index + size), split into terms adding up to it. 
+  ///        Summed over prox_g at (x, -K^T y) and prox_fstar at (y, K x) 
+  ///        this is the primal-dual gap. Only valid if supports_energy() 
+  ///        returns true.
+  /// 
+  void EvalGap(
+    const typename thrust::device_vector<T>::iterator& gap_beg,
+    const thrust::device_vector<T>& x,
+    const thrust::device_vector<T>& y,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream = 0);
+
+  /// \brief Returns true if the prox implements EvalGapLocal, i.e. the
+  ///        function and its conjugate have closed forms.
+  virtual bool supports_energy() const { return false; }
+
+  /// \brief Returns true if the prox implements EvalMoreauLocal and
+  ///        EvalMoreauFusedLocal, which ProxMoreau then uses instead of
+  ///        its separate scaling passes.
+  virtual bool supports_moreau_eval() const { return false; }
+
+  /// 
+  /// \brief Evaluates the prox operator on host data with OpenMP, used by
+  ///        BackendHost. Only valid if supports_host_eval() returns true.
+  ///        Nothing needs to be initialized on the GPU.
+  /// 
+  void EvalHost(
+    vector<T>& result, 
+    const vector<T>& arg, 
+    const vector<T>& tau_diag, 
+    T tau,
+    bool invert_tau = false);
+
+  /// \brief Returns true if the prox implements EvalHostLocal.
+  virtual bool supports_host_eval() const { return false; }
+
   virtual size_t gpu_mem_amount() const = 0;
+
+  /// \brief Number of elements of device scratch memory the prox needs
+  ///        during evaluation, including the ones of nested proxs.
+  virtual size_t scratch_size() const { return 0; }
+
+  /// \brief Sets the scratch memory which is shared with other proxs. Has
+  ///        to be called before Initialize().
+  virtual void set_workspace(shared_ptr<ProxWorkspace<T>> workspace) { workspace_ = workspace; }
+  shared_ptr<ProxWorkspace<T>> workspace() const { return workspace_; }
+
+  /// \brief Sets the context providing the library handles, has to be
+  ///        called before Initialize(). Without one the default context
+  ///        is used.
+  virtual void set_context(shared_ptr<ExecutionContext> context) { context_ = context; }
+  ExecutionContext& context()
+  {
+    if(!context_)
+      context_ = ExecutionContext::Default();
+
+    return *context_;
+  }
+
+  /// \brief Returns true if the prox can be merged with neighbouring proxs
+  ///        of the same type into a single kernel launch.
+  virtual bool batchable() const { return false; }
+
+  /// \brief Creates one prox evaluating a contiguous run of batchable
+  ///        proxs of the same type as this prox, sorted by index. ProxZero
+  ///        fillers may be part of the run. Returns nullptr if batching
+  ///        is not supported.
+  virtual Prox<T>* CreateBatch(const vector<shared_ptr<Prox<T>>>& run) const { return nullptr; }
+
   size_t index() const { return index_; }
   size_t size() const { return size_; }
   size_t end() const { return index_ + size_ - 1; }
   bool diagsteps() const { return diagsteps_; }
+
+  /// \brief Moves the prox to another index, used by Presolve to compact
+  ///        the problem. Nested proxs are moved along.
+  virtual void set_index(size_t index) { index_ = index; }
   
   /// \brief Returns the separability information of the prox operator. 
   ///        Needed for averaging the preconditioners
@@ -113,6 +227,7 @@ protected:
   /// \param Diagonal step sizes.
   /// \param Scalar step size.
   /// \param Perform the prox with inverted step sizes?
+  /// \param CUDA stream the work is launched on.
   /// 
   virtual void EvalLocal(
     const typename thrust::device_vector<T>::iterator& result_beg,
@@ -122,8 +237,81 @@ protected:
     const typename thrust::device_vector<T>::const_iterator& tau_beg,
     const typename thrust::device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau) = 0;
+    bool invert_tau,
+    cudaStream_t stream) = 0;
+
+  /// 
+  /// \brief Same as EvalLocal, but with the argument computed on the fly.
+  ///        The argument is already shifted to the place where the prox
+  ///        begins.
+  /// 
+  virtual void EvalFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  /// 
+  /// \brief Evaluates the prox of the conjugate function by Moreau's 
+  ///        identity in a single pass, with the same result as 
+  ///        ProxMoreau::EvalLocal. 
+  /// 
+  virtual void EvalMoreauLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  /// \brief Same as EvalMoreauLocal, but with the argument computed on the
+  ///        fly.
+  virtual void EvalMoreauFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
   
+  /// 
+  /// \brief Evaluates EvalGap, the iterators point to the place in memory
+  ///        where the prox begins.
+  /// 
+  virtual void EvalGapLocal(
+    const typename thrust::device_vector<T>::iterator& gap_beg,
+    const typename thrust::device_vector<T>::iterator& gap_end,
+    const typename thrust::device_vector<T>::const_iterator& x_beg,
+    const typename thrust::device_vector<T>::const_iterator& y_beg,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream);
+
+  /// 
+  /// \brief Host version of EvalLocal, the pointers point to the place in
+  ///        memory where the prox begins.
+  /// 
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
+    bool invert_tau);
+
+  /// \brief Creates a workspace if none was set and makes sure it is large
+  ///        enough for scratch_size(). To be called in Initialize() by proxs
+  ///        which need scratch memory.
+  void InitializeWorkspace();
+
   /// \brief Index where prox-Operator starts.
   size_t index_; 
 
@@ -132,6 +320,12 @@ protected:
 
   /// \brief Able to handle diagonal matrices as step size?
   bool diagsteps_; 
+
+  /// \brief Scratch memory, possibly shared with other proxs.
+  shared_ptr<ProxWorkspace<T>> workspace_;
+
+  /// \brief Device and library handles of the owning solver.
+  shared_ptr<ExecutionContext> context_;
 };
 
 } // namespace prost
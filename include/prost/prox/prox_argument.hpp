@@ -0,0 +1,81 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PROX_ARGUMENT_HPP_
+#define PROST_PROX_ARGUMENT_HPP_
+
+namespace prost {
+
+///
+/// \brief Describes a prox argument which is evaluated on the fly, 
+///        
+///        arg = x + step * d .* ((1 + theta) * a - theta * b).
+///
+///        This covers both prox arguments of the primal-dual algorithm,
+///        x^k - tau T K^T y^k and y^k + sigma S K (2 x^{k+1} - x^k), and 
+///        allows fused proximal operators to compute them in registers
+///        instead of reading a materialized argument from global memory.
+///        If b is a nullptr, the term (1 + theta) * a - theta * b is
+///        replaced by a.
+///
+template<typename T>
+struct ProxArgument
+{
+  const T *x;
+  const T *d;
+  const T *a;
+  const T *b;
+  T step;
+  T theta;
+
+  /// \brief Returns the argument shifted by the given offset.
+  inline __host__ __device__
+  ProxArgument<T> Offset(size_t ofs) const
+  {
+    ProxArgument<T> arg = *this;
+
+    arg.x += ofs;
+    arg.d += ofs;
+    arg.a += ofs;
+    if(arg.b != nullptr)
+      arg.b += ofs;
+
+    return arg;
+  }
+
+  /// \brief Evaluates the argument at index i for a given value a_i of a,
+  ///        e.g. one which was just computed and is not stored yet.
+  inline __host__ __device__
+  T Evaluate(size_t i, T a_i) const
+  {
+    const T dir = (b == nullptr) ? a_i : ((1 + theta) * a_i - theta * b[i]);
+    return x[i] + step * d[i] * dir;
+  }
+
+  inline __host__ __device__
+  T operator[](size_t i) const
+  {
+    return Evaluate(i, a[i]);
+  }
+};
+
+} // namespace prost
+
+#endif // PROST_PROX_ARGUMENT_HPP_
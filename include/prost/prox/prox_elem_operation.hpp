@@ -25,10 +25,21 @@
 #include <thrust/device_vector.h>
 
 #include "prost/prox/prox_separable_sum.hpp"
+#include "prost/config.hpp"
 #include "prost/common.hpp"
 
 namespace prost {
 
+template<typename T, class ELEM_OPERATION>
+struct ElemOpCoefficients 
+{
+  T* dev_p[ELEM_OPERATION::kCoeffsCount];
+  T val[ELEM_OPERATION::kCoeffsCount];
+};
+
+template<typename T, class ELEM_OPERATION> class ProxElemOperationBatch;
+template<typename T, class ELEM_OPERATION> struct ElemOperationMoreau;
+
 template<typename T, class ELEM_OPERATION, class ENABLE = void>
 class ProxElemOperation { };
 
@@ -45,6 +56,17 @@ public:
       : ProxSeparableSum<T>(index, count, (ELEM_OPERATION::kDim <= 0) ? dim : ELEM_OPERATION::kDim, interleaved, diagsteps) { }
   
   virtual size_t gpu_mem_amount() const { return 0; }
+  virtual bool supports_fused_eval() const { return true; }
+  virtual bool supports_moreau_eval() const { return ELEM_OPERATION::kDim > 0; }
+  virtual bool supports_host_eval() const { return ELEM_OPERATION::kHostEval; }
+
+  virtual bool batchable() const
+  {
+    return this->size_ <= kProxBatchMaxSize &&
+      !(ELEM_OPERATION::kWarpCooperative && this->dim_ >= kElemOperationWarpMinDim);
+  }
+
+  virtual Prox<T>* CreateBatch(const vector<shared_ptr<Prox<T>>>& run) const;
 
 protected:
   virtual void EvalLocal(
@@ -55,7 +77,77 @@ protected:
     const typename thrust::device_vector<T>::const_iterator& tau_beg,
     const typename thrust::device_vector<T>::const_iterator& tau_end,
     T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalMoreauLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalMoreauFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
     bool invert_tau);
+
+private:
+  /// \brief Operation evaluating the conjugate by Moreau's identity, only
+  ///        valid if supports_moreau_eval().
+  typedef typename std::conditional<(ELEM_OPERATION::kDim > 0), 
+    ElemOperationMoreau<T, ELEM_OPERATION>, ELEM_OPERATION>::type MoreauOperation;
+
+  /// \brief Launches the kernels of OP, which is ELEM_OPERATION or
+  ///        MoreauOperation.
+  template<class OP>
+  void EvalLocalOp(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  template<class OP>
+  void EvalFusedLocalOp(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
 };
 
 template<typename T, class ELEM_OPERATION>
@@ -72,6 +164,12 @@ public:
       : ProxSeparableSum<T>(index, count, ELEM_OPERATION::kDim <= 0 ? dim : ELEM_OPERATION::kDim, interleaved, diagsteps), coeffs_(coeffs) { }
 
   virtual void Initialize();
+
+  /// \brief Replaces the coefficients after Initialize(). Coefficients
+  ///        which keep their size are copied in place on the device.
+  void SetCoefficients(
+      const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs,
+      cudaStream_t stream = 0);
   
   virtual size_t gpu_mem_amount() const
   {
@@ -84,6 +182,26 @@ public:
     
     return mem;
   }
+
+  virtual bool supports_fused_eval() const { return true; }
+  virtual bool supports_moreau_eval() const { return ELEM_OPERATION::kDim > 0; }
+  virtual bool supports_host_eval() const { return ELEM_OPERATION::kHostEval; }
+  virtual bool supports_energy() const;
+
+  virtual bool batchable() const
+  {
+    return this->size_ <= kProxBatchMaxSize &&
+      !(ELEM_OPERATION::kWarpCooperative && this->dim_ >= kElemOperationWarpMinDim);
+  }
+
+  virtual Prox<T>* CreateBatch(const vector<shared_ptr<Prox<T>>>& run) const;
+
+  /// \brief Coefficients as passed to the kernels, pointing to the device
+  ///        for per-element coefficients.
+  ElemOpCoefficients<T, ELEM_OPERATION> coefficients() const;
+
+  /// \brief Coefficients as passed to the constructor.
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& host_coefficients() const { return coeffs_; }
    
 protected:
 
@@ -95,18 +213,200 @@ protected:
     const typename thrust::device_vector<T>::const_iterator& tau_beg,
     const typename thrust::device_vector<T>::const_iterator& tau_end,
     T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalMoreauLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalMoreauFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalGapLocal(
+    const typename thrust::device_vector<T>::iterator& gap_beg,
+    const typename thrust::device_vector<T>::iterator& gap_end,
+    const typename thrust::device_vector<T>::const_iterator& x_beg,
+    const typename thrust::device_vector<T>::const_iterator& y_beg,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream);
+
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
     bool invert_tau);
   
 private:
   std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount> coeffs_;
   std::array<thrust::device_vector<T>, ELEM_OPERATION::kCoeffsCount> d_coeffs_;  
+
+  /// \brief Operation evaluating the conjugate by Moreau's identity, only
+  ///        valid if supports_moreau_eval().
+  typedef typename std::conditional<(ELEM_OPERATION::kDim > 0), 
+    ElemOperationMoreau<T, ELEM_OPERATION>, ELEM_OPERATION>::type MoreauOperation;
+
+  /// \brief Launches the kernels of OP, which is ELEM_OPERATION or
+  ///        MoreauOperation.
+  template<class OP>
+  void EvalLocalOp(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  template<class OP>
+  void EvalFusedLocalOp(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
 };
 
+/// 
+/// \brief One entry of the descriptor table of ProxElemOperationBatch,
+///        describing a single member prox.
+/// 
 template<typename T, class ELEM_OPERATION>
-struct ElemOpCoefficients 
+struct ProxElemOperationBatchEntry
 {
-  T* dev_p[ELEM_OPERATION::kCoeffsCount];
-  T val[ELEM_OPERATION::kCoeffsCount];
+  static const size_t kCoeffs = ELEM_OPERATION::kCoeffsCount > 0 ? ELEM_OPERATION::kCoeffsCount : 1;
+
+  /// \brief Offset of the member relative to the batch.
+  size_t offset;
+
+  /// \brief Global thread index of the first element of the member.
+  size_t first;
+
+  size_t count;
+  size_t dim;
+  bool interleaved;
+
+  /// \brief Member is a ProxZero filler, which just copies its argument.
+  bool identity;
+
+  T* dev_p[kCoeffs];
+  T val[kCoeffs];
+};
+
+/// 
+/// \brief Evaluates a contiguous run of small elementwise proxs with the
+///        same operation in a single kernel launch. Every thread looks up
+///        its member in a descriptor table, so members may differ in
+///        count, dimension, layout and coefficients. Built by
+///        Problem::Initialize() from proxs which report batchable().
+/// 
+template<typename T, class ELEM_OPERATION>
+class ProxElemOperationBatch : public Prox<T>
+{
+public:
+  ProxElemOperationBatch(const vector<shared_ptr<Prox<T>>>& members);
+
+  virtual void Initialize();
+  virtual void Release();
+
+  /// \brief Rebuilds the descriptor table, e.g. after coefficients of a
+  ///        member changed.
+  virtual void Update();
+
+  virtual size_t gpu_mem_amount() const;
+  virtual bool supports_fused_eval() const { return true; }
+  virtual bool supports_energy() const;
+
+  virtual void get_separable_structure(
+    vector<std::tuple<size_t, size_t, size_t> >& sep);
+
+  const vector<shared_ptr<Prox<T>>>& members() const { return members_; }
+
+protected:
+  virtual void EvalLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalFusedLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalGapLocal(
+    const typename thrust::device_vector<T>::iterator& gap_beg,
+    const typename thrust::device_vector<T>::iterator& gap_end,
+    const typename thrust::device_vector<T>::const_iterator& x_beg,
+    const typename thrust::device_vector<T>::const_iterator& y_beg,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream);
+
+private:
+  /// \brief Launches the batch kernel, reading the argument from d_arg or,
+  ///        if fused is set, computing it from prox_arg.
+  void Launch(
+    T *d_res,
+    const T *d_arg,
+    const ProxArgument<T>& prox_arg,
+    bool fused,
+    const T *d_tau,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  vector<shared_ptr<Prox<T>>> members_;
+
+  /// \brief Total number of elements, i.e. threads of a launch.
+  size_t total_count_;
+
+  /// \brief Largest dimension of all members, determines the shared
+  ///        memory layout.
+  size_t max_dim_;
+
+  thrust::device_vector<ProxElemOperationBatchEntry<T, ELEM_OPERATION> > d_entries_;
 };
 
 
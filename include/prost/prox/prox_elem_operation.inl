@@ -18,14 +18,21 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
 #include "prost/prox/shared_mem.hpp"
 #include "prost/prox/vector.hpp"
+#include "prost/prox/prox_argument.hpp"
+#include "prost/prox/prox_zero.hpp"
+#include "prost/prox/elemop/elem_operation_moreau.hpp"
+#include "prost/prox/elemop/elem_operation_energy.hpp"
+#include "prost/prox/elemop/function_1d_energy.hpp"
 
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
+#include "prost/launch_config.hpp"
 
 namespace prost {
 
@@ -93,39 +100,1256 @@ void ProxElemOperationKernel(
   }
 }
 
+// Writes the prox argument, computed on the fly, into the result and
+// then applies the elementwise operation in-place. All elementwise
+// operations read their argument before overwriting it, and the data
+// stays in cache, so the argument never has to round-trip through DRAM.
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationFusedKernel(
+  T *d_res,
+  ProxArgument<T> prox_arg,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  bool interleaved)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count) 
+  {
+    for(size_t i = 0; i < dim; i++)
+    {
+      const size_t index = interleaved ? (tx * dim + i) : (tx + count * i);
+      d_res[index] = prox_arg[index];
+    }
+
+    Vector<T> res(count, dim, interleaved, tx, d_res);
+    const Vector<const T> arg(count, dim, interleaved, tx, d_res);
+    const Vector<const T> tau_diag(count, dim, interleaved, tx, d_tau);
+
+    SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount> sh_mem(dim, threadIdx.x);
+
+    ELEM_OPERATION op(dim, sh_mem);
+    op(res, arg, tau_diag, tau, invert_tau);
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationFusedKernel(
+  T *d_res,
+  ProxArgument<T> prox_arg,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  ElemOpCoefficients<T, ELEM_OPERATION> coeffs,
+  bool interleaved)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count)
+  {
+    for(size_t i = 0; i < dim; i++)
+    {
+      const size_t index = interleaved ? (tx * dim + i) : (tx + count * i);
+      d_res[index] = prox_arg[index];
+    }
+
+    Vector<T> res(count, dim, interleaved, tx, d_res);
+    const Vector<const T> arg(count, dim, interleaved, tx, d_res);
+    const Vector<const T> tau_diag(count, dim, interleaved, tx, d_tau);
+
+    SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount> sh_mem(dim, threadIdx.x);
+
+    T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+    for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    {
+      if(coeffs.dev_p[i] == nullptr) 
+        coeffs_local[i] = coeffs.val[i];
+      else 
+        coeffs_local[i] = coeffs.dev_p[i][tx];
+    }
+
+    ELEM_OPERATION op(coeffs_local, dim, sh_mem);
+    op(res, arg, tau_diag, tau, invert_tau);
+  }
+}
+
+// One warp per element, for operations which are expensive in the
+// dimension. The whole warp returns together, so all lanes take part in
+// the shuffles.
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationWarpKernel(
+  T *d_res,
+  const T *d_arg,
+  size_t count,
+  size_t dim,
+  bool interleaved)
+{
+  const size_t tx = (threadIdx.x + blockDim.x * blockIdx.x) / kWarpSizeCUDA;
+  const unsigned int lane = threadIdx.x % kWarpSizeCUDA;
+
+  if(tx < count) 
+  {
+    Vector<T> res(count, dim, interleaved, tx, d_res);
+    const Vector<const T> arg(count, dim, interleaved, tx, d_arg);
+
+    ELEM_OPERATION::EvalWarp(res, arg, dim, lane);
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationWarpFusedKernel(
+  T *d_res,
+  ProxArgument<T> prox_arg,
+  size_t count,
+  size_t dim,
+  bool interleaved)
+{
+  const size_t tx = (threadIdx.x + blockDim.x * blockIdx.x) / kWarpSizeCUDA;
+  const unsigned int lane = threadIdx.x % kWarpSizeCUDA;
+
+  if(tx < count) 
+  {
+    for(size_t i = lane; i < dim; i += kWarpSizeCUDA)
+    {
+      const size_t index = interleaved ? (tx * dim + i) : (tx + count * i);
+      d_res[index] = prox_arg[index];
+    }
+
+    // make the argument written by the other lanes visible
+    __syncwarp();
+
+    Vector<T> res(count, dim, interleaved, tx, d_res);
+    const Vector<const T> arg(count, dim, interleaved, tx, d_res);
+
+    ELEM_OPERATION::EvalWarp(res, arg, dim, lane);
+  }
+}
+
+// Signatures of the elementwise kernels, to pick an overload when taking
+// their address. ARG is either a pointer or a ProxArgument.
+template<typename T, class ELEM_OPERATION, class ARG>
+struct ProxElemOperationKernelType
+{
+  typedef void (*Plain)(T *, ARG, const T *, T, bool, size_t, size_t, bool);
+  typedef void (*Coeffs)(T *, ARG, const T *, T, bool, size_t, size_t, 
+                         ElemOpCoefficients<T, ELEM_OPERATION>, bool);
+  typedef void (*Staged)(T *, ARG, const T *, T, bool, size_t, size_t, size_t);
+  typedef void (*StagedCoeffs)(T *, ARG, const T *, T, bool, size_t, size_t, 
+                               ElemOpCoefficients<T, ELEM_OPERATION>, size_t);
+};
+
+// Launches kernel over count threads with the block size chosen by 
+// LaunchConfig. Returns false without launching if the dynamic shared 
+// memory does not fit for a single warp.
+template<class ELEM_OPERATION, class KERNEL, class... Args>
+bool LaunchProxElemOperationKernel(
+  const char *name,
+  KERNEL kernel,
+  size_t count,
+  size_t smem_per_thread,
+  size_t smem_fixed,
+  size_t max_shared_mem,
+  cudaStream_t stream,
+  Args... args)
+{
+  LaunchConfig cfg(name, typeid(ELEM_OPERATION), reinterpret_cast<const void *>(kernel),
+                   count, smem_per_thread, smem_fixed, stream, max_shared_mem);
+
+  if(!cfg.fits())
+    return false;
+
+  kernel<<<cfg.grid(), cfg.block(), cfg.shared_mem(), stream>>>(args...);
+  return true;
+}
+
+// Launches the warp-cooperative kernel if the operation provides one and
+// the dimension is large enough, otherwise returns false. If prox_arg is
+// not a nullptr, the argument is computed on the fly.
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kWarpCooperative, bool>::type
+LaunchProxElemOperationWarp(
+  T *d_res,
+  const T *d_arg,
+  const ProxArgument<T> *prox_arg,
+  size_t count,
+  size_t dim,
+  bool interleaved,
+  cudaStream_t stream)
+{
+  if(dim < kElemOperationWarpMinDim)
+    return false;
+
+  if(prox_arg != nullptr)
+    return LaunchProxElemOperationKernel<ELEM_OPERATION>(
+      "ProxElemOperationWarpFusedKernel",
+      &ProxElemOperationWarpFusedKernel<T, ELEM_OPERATION>,
+      count * kWarpSizeCUDA, 0, 0, 0, stream,
+      d_res, *prox_arg, count, dim, interleaved);
+
+  return LaunchProxElemOperationKernel<ELEM_OPERATION>(
+    "ProxElemOperationWarpKernel",
+    &ProxElemOperationWarpKernel<T, ELEM_OPERATION>,
+    count * kWarpSizeCUDA, 0, 0, 0, stream,
+    d_res, d_arg, count, dim, interleaved);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<!ELEM_OPERATION::kWarpCooperative, bool>::type
+LaunchProxElemOperationWarp(
+  T *d_res,
+  const T *d_arg,
+  const ProxArgument<T> *prox_arg,
+  size_t count,
+  size_t dim,
+  bool interleaved,
+  cudaStream_t stream)
+{
+  return false;
+}
+
+// Start of the staging buffers in dynamic shared memory, behind the
+// shared memory of the elementwise operation.
+inline __host__ __device__
+size_t ProxElemOperationStagedOffset(size_t op_shmem_bytes)
+{
+  return (op_shmem_bytes + 15) / 16 * 16;
+}
+
+// Returns true if the layout is not coalesced and the staged kernels are
+// tried. They need 2 dim sizeof(T) bytes of shared memory per thread 
+// behind the ones of the operation, up to kMaxStagedSharedMem per block.
+inline bool ProxElemOperationStaged(size_t dim, bool interleaved)
+{
+  return interleaved && dim >= 2;
+}
+
+// For the interleaved layout thread tx accesses d_arg[tx * dim + i], which
+// isn't coalesced for dim > 1. The elements of a block are contiguous, so
+// they are loaded into shared memory with coalesced accesses, processed
+// there in-place and written back. ARG is either a pointer or a 
+// ProxArgument which is evaluated on the fly.
+template<typename T, class ELEM_OPERATION, class ARG>
+__global__
+void ProxElemOperationStagedKernel(
+  T *d_res,
+  ARG d_arg,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  size_t op_shmem_per_thread)
+{
+  extern __shared__ char sh_mem[];
+  T *sh_arg = reinterpret_cast<T *>(sh_mem + ProxElemOperationStagedOffset(op_shmem_per_thread * blockDim.x));
+  T *sh_tau = sh_arg + blockDim.x * dim;
+
+  const size_t first = blockIdx.x * blockDim.x;
+  const size_t block_count = min(static_cast<size_t>(blockDim.x), count - first);
+  const size_t ofs = first * dim;
+
+  for(size_t i = threadIdx.x; i < block_count * dim; i += blockDim.x)
+  {
+    sh_arg[i] = d_arg[ofs + i];
+    sh_tau[i] = d_tau[ofs + i];
+  }
+  __syncthreads();
+
+  if(threadIdx.x < block_count) 
+  {
+    Vector<T> res(block_count, dim, true, threadIdx.x, sh_arg);
+    const Vector<const T> arg(block_count, dim, true, threadIdx.x, sh_arg);
+    const Vector<const T> tau_diag(block_count, dim, true, threadIdx.x, sh_tau);
+
+    SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount> sh(dim, threadIdx.x);
+
+    ELEM_OPERATION op(dim, sh);
+    op(res, arg, tau_diag, tau, invert_tau);
+  }
+  __syncthreads();
+
+  for(size_t i = threadIdx.x; i < block_count * dim; i += blockDim.x)
+    d_res[ofs + i] = sh_arg[i];
+}
+
+template<typename T, class ELEM_OPERATION, class ARG>
+__global__
+void ProxElemOperationStagedKernel(
+  T *d_res,
+  ARG d_arg,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  ElemOpCoefficients<T, ELEM_OPERATION> coeffs,
+  size_t op_shmem_per_thread)
+{
+  extern __shared__ char sh_mem[];
+  T *sh_arg = reinterpret_cast<T *>(sh_mem + ProxElemOperationStagedOffset(op_shmem_per_thread * blockDim.x));
+  T *sh_tau = sh_arg + blockDim.x * dim;
+
+  const size_t first = blockIdx.x * blockDim.x;
+  const size_t block_count = min(static_cast<size_t>(blockDim.x), count - first);
+  const size_t ofs = first * dim;
+
+  for(size_t i = threadIdx.x; i < block_count * dim; i += blockDim.x)
+  {
+    sh_arg[i] = d_arg[ofs + i];
+    sh_tau[i] = d_tau[ofs + i];
+  }
+  __syncthreads();
+
+  if(threadIdx.x < block_count) 
+  {
+    Vector<T> res(block_count, dim, true, threadIdx.x, sh_arg);
+    const Vector<const T> arg(block_count, dim, true, threadIdx.x, sh_arg);
+    const Vector<const T> tau_diag(block_count, dim, true, threadIdx.x, sh_tau);
+
+    SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount> sh(dim, threadIdx.x);
+
+    T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+    for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    {
+      if(coeffs.dev_p[i] == nullptr) 
+        coeffs_local[i] = coeffs.val[i];
+      else 
+        coeffs_local[i] = coeffs.dev_p[i][first + threadIdx.x];
+    }
+
+    ELEM_OPERATION op(coeffs_local, dim, sh);
+    op(res, arg, tau_diag, tau, invert_tau);
+  }
+  __syncthreads();
+
+  for(size_t i = threadIdx.x; i < block_count * dim; i += blockDim.x)
+    d_res[ofs + i] = sh_arg[i];
+}
+
+// Evaluates all members of a ProxElemOperationBatch, one thread per
+// element. The member of a thread is found by a binary search over the
+// first element of each descriptor table entry. Shared memory is laid out
+// for the largest dimension of the batch, so members with a smaller 
+// dimension use a prefix of their slot.
+template<typename T, class ELEM_OPERATION>
+inline __device__
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type
+ProxElemOperationBatchApply(
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION>& entry,
+  size_t tx,
+  Vector<T>& res,
+  const Vector<const T>& arg,
+  const Vector<const T>& tau_diag,
+  T tau,
+  bool invert_tau,
+  SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount>& sh_mem)
+{
+  ELEM_OPERATION op(entry.dim, sh_mem);
+  op(res, arg, tau_diag, tau, invert_tau);
+}
+
+template<typename T, class ELEM_OPERATION>
+inline __device__
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type
+ProxElemOperationBatchApply(
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION>& entry,
+  size_t tx,
+  Vector<T>& res,
+  const Vector<const T>& arg,
+  const Vector<const T>& tau_diag,
+  T tau,
+  bool invert_tau,
+  SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount>& sh_mem)
+{
+  T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+  for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+  {
+    if(entry.dev_p[i] == nullptr) 
+      coeffs_local[i] = entry.val[i];
+    else 
+      coeffs_local[i] = entry.dev_p[i][tx];
+  }
+
+  ELEM_OPERATION op(coeffs_local, entry.dim, sh_mem);
+  op(res, arg, tau_diag, tau, invert_tau);
+}
+
+// Index of the descriptor table entry containing the global element tx.
+template<typename T, class ELEM_OPERATION>
+inline __device__
+size_t ProxElemOperationBatchFind(
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION> *d_entries,
+  size_t num_entries,
+  size_t tx)
+{
+  size_t lo = 0, hi = num_entries - 1;
+  while(lo < hi)
+  {
+    const size_t mid = (lo + hi + 1) / 2;
+
+    if(d_entries[mid].first <= tx)
+      lo = mid;
+    else
+      hi = mid - 1;
+  }
+
+  return lo;
+}
+
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationBatchKernel(
+  T *d_res,
+  const T *d_arg,
+  ProxArgument<T> prox_arg,
+  bool fused,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION> *d_entries,
+  size_t num_entries,
+  size_t total_count,
+  size_t max_dim)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < total_count)
+  {
+    const ProxElemOperationBatchEntry<T, ELEM_OPERATION> entry = 
+      d_entries[ProxElemOperationBatchFind<T, ELEM_OPERATION>(d_entries, num_entries, tx)];
+    const size_t el = tx - entry.first;
+
+    T *res_p = d_res + entry.offset;
+    const T *arg_p = fused ? res_p : (d_arg + entry.offset);
+
+    for(size_t i = 0; i < entry.dim; i++)
+    {
+      const size_t index = entry.interleaved ? (el * entry.dim + i) : (el + entry.count * i);
+
+      if(fused)
+        res_p[index] = prox_arg[entry.offset + index];
+      else if(entry.identity)
+        res_p[index] = arg_p[index];
+    }
+
+    if(entry.identity)
+      return;
+
+    Vector<T> res(entry.count, entry.dim, entry.interleaved, el, res_p);
+    const Vector<const T> arg(entry.count, entry.dim, entry.interleaved, el, arg_p);
+    const Vector<const T> tau_diag(entry.count, entry.dim, entry.interleaved, el, d_tau + entry.offset);
+
+    SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount> sh_mem(max_dim, threadIdx.x);
+
+    ProxElemOperationBatchApply<T, ELEM_OPERATION>(
+      entry, el, res, arg, tau_diag, tau, invert_tau, sh_mem);
+  }
+}
+
+// Writes the Fenchel-Young gap of each element into the first entry of
+// its group and zeros into the remaining ones, so that the gap of the 
+// prox is the sum over its range. One thread per element, no shared 
+// memory is needed.
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationGapKernel(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  size_t count,
+  size_t dim,
+  ElemOpCoefficients<T, ELEM_OPERATION> coeffs,
+  bool interleaved)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count)
+  {
+    Vector<T> gap(count, dim, interleaved, tx, d_gap);
+    const Vector<const T> x(count, dim, interleaved, tx, d_x);
+    const Vector<const T> y(count, dim, interleaved, tx, d_y);
+
+    T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+    for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    {
+      if(coeffs.dev_p[i] == nullptr) 
+        coeffs_local[i] = coeffs.val[i];
+      else 
+        coeffs_local[i] = coeffs.dev_p[i][tx];
+    }
+
+    for(size_t i = 1; i < dim; i++)
+      gap[i] = 0;
+
+    gap[0] = ElemOperationEnergy<T, ELEM_OPERATION>::FenchelYoung(
+      coeffs_local, x, y, dim, x_scale, y_scale);
+  }
+}
+
+// Batch version of ProxElemOperationGapKernel, identity members are
+// ProxZero whose conjugate is the indicator of {0}.
+template<typename T, class ELEM_OPERATION>
+__global__
+void ProxElemOperationBatchGapKernel(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION> *d_entries,
+  size_t num_entries,
+  size_t total_count)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < total_count)
+  {
+    const ProxElemOperationBatchEntry<T, ELEM_OPERATION> entry = 
+      d_entries[ProxElemOperationBatchFind<T, ELEM_OPERATION>(d_entries, num_entries, tx)];
+    const size_t el = tx - entry.first;
+
+    Vector<T> gap(entry.count, entry.dim, entry.interleaved, el, d_gap + entry.offset);
+    const Vector<const T> x(entry.count, entry.dim, entry.interleaved, el, d_x + entry.offset);
+    const Vector<const T> y(entry.count, entry.dim, entry.interleaved, el, d_y + entry.offset);
+
+    if(entry.identity)
+    {
+      const T y0 = y_scale * y[0];
+      gap[0] = EnergyIndicator<T>(abs(y0)) - x_scale * x[0] * y0;
+      return;
+    }
+
+    T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+    for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    {
+      if(entry.dev_p[i] == nullptr) 
+        coeffs_local[i] = entry.val[i];
+      else 
+        coeffs_local[i] = entry.dev_p[i][el];
+    }
+
+    for(size_t i = 1; i < entry.dim; i++)
+      gap[i] = 0;
+
+    gap[0] = ElemOperationEnergy<T, ELEM_OPERATION>::FenchelYoung(
+      coeffs_local, x, y, entry.dim, x_scale, y_scale);
+  }
+}
+
+// Launches the gap kernels if the operation provides an energy, otherwise
+// throws. Only operations with coefficients provide one.
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ElemOperationEnergy<T, ELEM_OPERATION>::kSupported>::type
+LaunchProxElemOperationGap(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  size_t count,
+  size_t dim,
+  const ElemOpCoefficients<T, ELEM_OPERATION>& coeffs,
+  bool interleaved,
+  cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  ProxElemOperationGapKernel<T, ELEM_OPERATION>
+    <<<grid, block, 0, stream>>>(
+      d_gap, d_x, d_y, x_scale, y_scale, count, dim, coeffs, interleaved);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<!ElemOperationEnergy<T, ELEM_OPERATION>::kSupported>::type
+LaunchProxElemOperationGap(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  size_t count,
+  size_t dim,
+  const ElemOpCoefficients<T, ELEM_OPERATION>& coeffs,
+  bool interleaved,
+  cudaStream_t stream)
+{
+  throw Exception("ProxElemOperation: the energy is not available for this operation.");
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ElemOperationEnergy<T, ELEM_OPERATION>::kSupported>::type
+LaunchProxElemOperationBatchGap(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION> *d_entries,
+  size_t num_entries,
+  size_t total_count,
+  cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((total_count + block.x - 1) / block.x, 1, 1);
+
+  ProxElemOperationBatchGapKernel<T, ELEM_OPERATION>
+    <<<grid, block, 0, stream>>>(
+      d_gap, d_x, d_y, x_scale, y_scale, d_entries, num_entries, total_count);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<!ElemOperationEnergy<T, ELEM_OPERATION>::kSupported>::type
+LaunchProxElemOperationBatchGap(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  const ProxElemOperationBatchEntry<T, ELEM_OPERATION> *d_entries,
+  size_t num_entries,
+  size_t total_count,
+  cudaStream_t stream)
+{
+  throw Exception("ProxElemOperationBatch: the energy is not available for this operation.");
+}
+
+// Host counterparts of the kernels above, used by BackendHost. Each
+// OpenMP thread owns a buffer which stands in for its shared memory slot.
+template<typename T, class ELEM_OPERATION>
+inline
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type
+ProxElemOperationHostApply(
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs,
+  size_t tx,
+  size_t dim,
+  Vector<T>& res,
+  const Vector<const T>& arg,
+  const Vector<const T>& tau_diag,
+  T tau,
+  bool invert_tau,
+  SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount>& sh_mem)
+{
+  ELEM_OPERATION op(dim, sh_mem);
+  op(res, arg, tau_diag, tau, invert_tau);
+}
+
+template<typename T, class ELEM_OPERATION>
+inline
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type
+ProxElemOperationHostApply(
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs,
+  size_t tx,
+  size_t dim,
+  Vector<T>& res,
+  const Vector<const T>& arg,
+  const Vector<const T>& tau_diag,
+  T tau,
+  bool invert_tau,
+  SharedMem<typename ELEM_OPERATION::SharedMemType, typename ELEM_OPERATION::GetSharedMemCount>& sh_mem)
+{
+  T coeffs_local[ELEM_OPERATION::kCoeffsCount];
+  for(int i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    coeffs_local[i] = (coeffs[i].size() > 1) ? coeffs[i][tx] : coeffs[i][0];
+
+  ELEM_OPERATION op(coeffs_local, dim, sh_mem);
+  op(res, arg, tau_diag, tau, invert_tau);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<!ELEM_OPERATION::kHostEval>::type
+ProxElemOperationHost(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  bool interleaved,
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs)
+{
+  throw Exception("ProxElemOperation: operation can only be evaluated on the GPU.");
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kHostEval>::type
+ProxElemOperationHost(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau,
+  size_t count,
+  size_t dim,
+  bool interleaved,
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs)
+{
+  typedef typename ELEM_OPERATION::SharedMemType SharedMemType;
+  typedef typename ELEM_OPERATION::GetSharedMemCount GetSharedMemCount;
+
+  const size_t sh_count = std::max<size_t>(GetSharedMemCount()(dim), 1);
+
+#pragma omp parallel
+  {
+    std::vector<SharedMemType> buffer(sh_count);
+    SharedMem<SharedMemType, GetSharedMemCount> sh_mem(dim, buffer.data());
+
+#pragma omp for
+    for(ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(count); i++)
+    {
+      const size_t tx = static_cast<size_t>(i);
+
+      Vector<T> res(count, dim, interleaved, tx, result);
+      const Vector<const T> arg_vec(count, dim, interleaved, tx, arg);
+      const Vector<const T> tau_vec(count, dim, interleaved, tx, tau_diag);
+
+      ProxElemOperationHostApply<T, ELEM_OPERATION>(
+        coeffs, tx, dim, res, arg_vec, tau_vec, tau, invert_tau, sh_mem);
+    }
+  }
+}
+
+// Coefficients of an operation passed to an operation wrapping it with
+// the same coefficients, i.e. ElemOperationMoreau.
+template<typename T, class OP, class OTHER>
+inline ElemOpCoefficients<T, OP> 
+ElemOpCoefficientsCast(const ElemOpCoefficients<T, OTHER>& other)
+{
+  ElemOpCoefficients<T, OP> coeffs;
+  for(size_t i = 0; i < OP::kCoeffsCount; i++)
+  {
+    coeffs.dev_p[i] = other.dev_p[i];
+    coeffs.val[i] = other.val[i];
+  }
+
+  return coeffs;
+}
+
+template<typename T, class ELEM_OPERATION>
+template<class OP>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalLocalOp(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  typename OP::GetSharedMemCount get_shared_mem_count;
+
+  const size_t op_bytes =
+    get_shared_mem_count(this->dim_) *
+    sizeof(typename OP::SharedMemType);
+
+  bool launched = LaunchProxElemOperationWarp<T, OP>(
+    thrust::raw_pointer_cast(&(*result_beg)),
+    thrust::raw_pointer_cast(&(*arg_beg)),
+    nullptr,
+    this->count_,
+    this->dim_,
+    this->interleaved_,
+    stream);
+
+  // falls back to the uncoalesced kernel if the staging buffers don't fit
+  if(!launched && ProxElemOperationStaged(this->dim_, this->interleaved_))
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationStagedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, const T *>::Staged>(
+        &ProxElemOperationStagedKernel<T, OP, const T *>),
+      this->count_,
+      op_bytes + 2 * this->dim_ * sizeof(T),
+      16,
+      kMaxStagedSharedMem,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      thrust::raw_pointer_cast(&(*arg_beg)),
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      op_bytes);
+
+  if(!launched)
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, const T *>::Plain>(
+        &ProxElemOperationKernel<T, OP>),
+      this->count_,
+      op_bytes,
+      0,
+      0,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      thrust::raw_pointer_cast(&(*arg_beg)),
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      this->interleaved_);
+
+  if(!launched)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperation: the shared memory for dimension " << this->dim_ 
+       << " exceeds the limit of the device.";
+    throw Exception(ss.str());
+  }
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+template<class OP>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalFusedLocalOp(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  typename OP::GetSharedMemCount get_shared_mem_count;
+
+  const size_t op_bytes =
+    get_shared_mem_count(this->dim_) *
+    sizeof(typename OP::SharedMemType);
+
+  bool launched = LaunchProxElemOperationWarp<T, OP>(
+    thrust::raw_pointer_cast(&(*result_beg)),
+    nullptr,
+    &arg,
+    this->count_,
+    this->dim_,
+    this->interleaved_,
+    stream);
+
+  // falls back to the uncoalesced kernel if the staging buffers don't fit
+  if(!launched && ProxElemOperationStaged(this->dim_, this->interleaved_))
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationStagedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, ProxArgument<T>>::Staged>(
+        &ProxElemOperationStagedKernel<T, OP, ProxArgument<T>>),
+      this->count_,
+      op_bytes + 2 * this->dim_ * sizeof(T),
+      16,
+      kMaxStagedSharedMem,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      arg,
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      op_bytes);
+
+  if(!launched)
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationFusedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, ProxArgument<T>>::Plain>(
+        &ProxElemOperationFusedKernel<T, OP>),
+      this->count_,
+      op_bytes,
+      0,
+      0,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      arg,
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      this->interleaved_);
+
+  if(!launched)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperation: the shared memory for dimension " << this->dim_ 
+       << " exceeds the limit of the device.";
+    throw Exception(ss.str());
+  }
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+template<class OP>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalLocalOp(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  const ElemOpCoefficients<T, OP> coeffs = ElemOpCoefficientsCast<T, OP>(coefficients());
+
+  typename OP::GetSharedMemCount get_shared_mem_count;
+
+  const size_t op_bytes =
+    get_shared_mem_count(this->dim_) *
+    sizeof(typename OP::SharedMemType);
+
+  bool launched = false;
+
+  // falls back to the uncoalesced kernel if the staging buffers don't fit
+  if(!launched && ProxElemOperationStaged(this->dim_, this->interleaved_))
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationStagedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, const T *>::StagedCoeffs>(
+        &ProxElemOperationStagedKernel<T, OP, const T *>),
+      this->count_,
+      op_bytes + 2 * this->dim_ * sizeof(T),
+      16,
+      kMaxStagedSharedMem,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      thrust::raw_pointer_cast(&(*arg_beg)),
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      coeffs,
+      op_bytes);
+
+  if(!launched)
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, const T *>::Coeffs>(
+        &ProxElemOperationKernel<T, OP>),
+      this->count_,
+      op_bytes,
+      0,
+      0,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      thrust::raw_pointer_cast(&(*arg_beg)),
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      coeffs,
+      this->interleaved_);
+
+  if(!launched)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperation: the shared memory for dimension " << this->dim_ 
+       << " exceeds the limit of the device.";
+    throw Exception(ss.str());
+  }
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+template<class OP>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalFusedLocalOp(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  const ElemOpCoefficients<T, OP> coeffs = ElemOpCoefficientsCast<T, OP>(coefficients());
+
+  typename OP::GetSharedMemCount get_shared_mem_count;
+
+  const size_t op_bytes =
+    get_shared_mem_count(this->dim_) *
+    sizeof(typename OP::SharedMemType);
+
+  bool launched = false;
+
+  // falls back to the uncoalesced kernel if the staging buffers don't fit
+  if(!launched && ProxElemOperationStaged(this->dim_, this->interleaved_))
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationStagedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, ProxArgument<T>>::StagedCoeffs>(
+        &ProxElemOperationStagedKernel<T, OP, ProxArgument<T>>),
+      this->count_,
+      op_bytes + 2 * this->dim_ * sizeof(T),
+      16,
+      kMaxStagedSharedMem,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      arg,
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      coeffs,
+      op_bytes);
+
+  if(!launched)
+    launched = LaunchProxElemOperationKernel<OP>(
+      "ProxElemOperationFusedKernel",
+      static_cast<typename ProxElemOperationKernelType<T, OP, ProxArgument<T>>::Coeffs>(
+        &ProxElemOperationFusedKernel<T, OP>),
+      this->count_,
+      op_bytes,
+      0,
+      0,
+      stream,
+      thrust::raw_pointer_cast(&(*result_beg)),
+      arg,
+      thrust::raw_pointer_cast(&(*tau_beg)),
+      tau,
+      invert_tau,
+      this->count_,
+      this->dim_,
+      coeffs,
+      this->interleaved_);
+
+  if(!launched)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperation: the shared memory for dimension " << this->dim_ 
+       << " exceeds the limit of the device.";
+    throw Exception(ss.str());
+  }
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  EvalLocalOp<ELEM_OPERATION>(
+    result_beg, result_end, arg_beg, arg_end, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  EvalFusedLocalOp<ELEM_OPERATION>(
+    result_beg, result_end, arg, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalMoreauLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  if(!supports_moreau_eval())
+    throw Exception("ProxElemOperation: Moreau evaluation requires an operation of fixed dimension.");
+
+  EvalLocalOp<MoreauOperation>(
+    result_beg, result_end, arg_beg, arg_end, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalMoreauFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  if(!supports_moreau_eval())
+    throw Exception("ProxElemOperation: Moreau evaluation requires an operation of fixed dimension.");
+
+  EvalFusedLocalOp<MoreauOperation>(
+    result_beg, result_end, arg, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  EvalLocalOp<ELEM_OPERATION>(
+    result_beg, result_end, arg_beg, arg_end, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  EvalFusedLocalOp<ELEM_OPERATION>(
+    result_beg, result_end, arg, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalMoreauLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  if(!supports_moreau_eval())
+    throw Exception("ProxElemOperation: Moreau evaluation requires an operation of fixed dimension.");
+
+  EvalLocalOp<MoreauOperation>(
+    result_beg, result_end, arg_beg, arg_end, tau_beg, tau_end, tau, invert_tau, stream);
+}
+
 template<typename T, class ELEM_OPERATION>
 void 
-ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalLocal(
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalMoreauFusedLocal(
   const typename thrust::device_vector<T>::iterator& result_beg,
   const typename thrust::device_vector<T>::iterator& result_end,
-  const typename thrust::device_vector<T>::const_iterator& arg_beg,
-  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const ProxArgument<T>& arg,
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
+  if(!supports_moreau_eval())
+    throw Exception("ProxElemOperation: Moreau evaluation requires an operation of fixed dimension.");
 
-  typename ELEM_OPERATION::GetSharedMemCount get_shared_mem_count;
+  EvalFusedLocalOp<MoreauOperation>(
+    result_beg, result_end, arg, tau_beg, tau_end, tau, invert_tau, stream);
+}
 
-  size_t shmem_bytes =
-    get_shared_mem_count(this->dim_) *
-    block.x *
-    sizeof(typename ELEM_OPERATION::SharedMemType);
-  
-  ProxElemOperationKernel<T, ELEM_OPERATION>
-    <<<grid, block, shmem_bytes>>>(
-      thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&(*arg_beg)),
-      thrust::raw_pointer_cast(&(*tau_beg)),
-      tau,
-      invert_tau,
-      this->count_,
-      this->dim_,
-      this->interleaved_);
-  cudaDeviceSynchronize();
+template<typename T, class ELEM_OPERATION>
+bool
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::supports_energy() const
+{
+  return ElemOperationEnergy<T, ELEM_OPERATION>::kSupported;
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalGapLocal(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const typename thrust::device_vector<T>::iterator& gap_end,
+  const typename thrust::device_vector<T>::const_iterator& x_beg,
+  const typename thrust::device_vector<T>::const_iterator& y_beg,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  LaunchProxElemOperationGap<T, ELEM_OPERATION>(
+    thrust::raw_pointer_cast(&(*gap_beg)),
+    thrust::raw_pointer_cast(&(*x_beg)),
+    thrust::raw_pointer_cast(&(*y_beg)),
+    x_scale,
+    y_scale,
+    this->count_,
+    this->dim_,
+    coefficients(),
+    this->interleaved_,
+    stream);
 
   // check for error
   cudaError_t error = cudaGetLastError();
@@ -140,25 +1364,109 @@ ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCo
 
 template<typename T, class ELEM_OPERATION>
 void 
-ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalLocal(
-  const typename thrust::device_vector<T>::iterator& result_beg,
-  const typename thrust::device_vector<T>::iterator& result_end,
-  const typename thrust::device_vector<T>::const_iterator& arg_beg,
-  const typename thrust::device_vector<T>::const_iterator& arg_end,
-  const typename thrust::device_vector<T>::const_iterator& tau_beg,
-  const typename thrust::device_vector<T>::const_iterator& tau_end,
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
   T tau,
   bool invert_tau)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
+  const std::array<std::vector<T>, 0> coeffs = {};
+  ProxElemOperationHost<T, ELEM_OPERATION>(
+    result, arg, tau_diag, tau, invert_tau, 
+    this->count_, this->dim_, this->interleaved_, coeffs);
+}
+
+template<typename T, class ELEM_OPERATION>
+void 
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau)
+{
+  ProxElemOperationHost<T, ELEM_OPERATION>(
+    result, arg, tau_diag, tau, invert_tau, 
+    this->count_, this->dim_, this->interleaved_, coeffs_);
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::Initialize() 
+{
+  for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+  { 
+    try
+    {
+      if(coeffs_[i].size() > 1)
+      {
+        d_coeffs_[i] = coeffs_[i];
+      }
+    }
+    catch(std::bad_alloc &e)
+    {
+      throw Exception(e.what());
+    }
+    catch(thrust::system_error &e)
+    {
+      throw Exception(e.what());
+    }
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::SetCoefficients(
+  const std::array<std::vector<T>, ELEM_OPERATION::kCoeffsCount>& coeffs,
+  cudaStream_t stream)
+{
+  for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+  {
+    if(coeffs[i].size() != 1 && coeffs[i].size() != this->count_)
+      throw Exception("Size of coefficients should be either 1 or count.");
+  }
+
+  for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+  {
+    coeffs_[i] = coeffs[i];
+
+    try
+    {
+      if(coeffs_[i].size() > 1 && d_coeffs_[i].size() == coeffs_[i].size())
+      {
+        cudaMemcpyAsync(thrust::raw_pointer_cast(d_coeffs_[i].data()),
+                        coeffs_[i].data(),
+                        sizeof(T) * coeffs_[i].size(),
+                        cudaMemcpyHostToDevice,
+                        stream);
+      }
+      else if(coeffs_[i].size() > 1)
+        d_coeffs_[i] = coeffs_[i];
+      else
+        d_coeffs_[i].clear();
+    }
+    catch(std::bad_alloc &e)
+    {
+      throw Exception(e.what());
+    }
+    catch(thrust::system_error &e)
+    {
+      throw Exception(e.what());
+    }
+  }
+}
 
+template<typename T, class ELEM_OPERATION>
+ElemOpCoefficients<T, ELEM_OPERATION>
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::coefficients() const
+{
   ElemOpCoefficients<T, ELEM_OPERATION> coeffs;
      
   for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
   {
     if(coeffs_[i].size() > 1) 
-      coeffs.dev_p[i] = thrust::raw_pointer_cast(&d_coeffs_[i][0]);
+      coeffs.dev_p[i] = const_cast<T*>(thrust::raw_pointer_cast(&d_coeffs_[i][0]));
     else
     {
       coeffs.dev_p[i] = nullptr;
@@ -166,25 +1474,228 @@ ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCo
     }
   }
 
+  return coeffs;
+}
+
+template<typename T, class ELEM_OPERATION>
+Prox<T>*
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type>::CreateBatch(
+  const vector<shared_ptr<Prox<T>>>& run) const
+{
+  return new ProxElemOperationBatch<T, ELEM_OPERATION>(run);
+}
+
+template<typename T, class ELEM_OPERATION>
+Prox<T>*
+ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::CreateBatch(
+  const vector<shared_ptr<Prox<T>>>& run) const
+{
+  return new ProxElemOperationBatch<T, ELEM_OPERATION>(run);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0>::type
+ProxElemOperationBatchCoefficients(
+  ProxElemOperationBatchEntry<T, ELEM_OPERATION>& entry,
+  const Prox<T> *prox)
+{
+  entry.dev_p[0] = nullptr;
+  entry.val[0] = 0;
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type
+ProxElemOperationBatchCoefficients(
+  ProxElemOperationBatchEntry<T, ELEM_OPERATION>& entry,
+  const Prox<T> *prox)
+{
+  const ProxElemOperation<T, ELEM_OPERATION> *elem_prox = 
+    dynamic_cast<const ProxElemOperation<T, ELEM_OPERATION> *>(prox);
+
+  if(elem_prox == nullptr)
+  {
+    for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+    {
+      entry.dev_p[i] = nullptr;
+      entry.val[i] = 0;
+    }
+    return;
+  }
+
+  const ElemOpCoefficients<T, ELEM_OPERATION> coeffs = elem_prox->coefficients();
+  for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
+  {
+    entry.dev_p[i] = coeffs.dev_p[i];
+    entry.val[i] = coeffs.val[i];
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+ProxElemOperationBatch<T, ELEM_OPERATION>::ProxElemOperationBatch(
+  const vector<shared_ptr<Prox<T>>>& members)
+  : Prox<T>(members.front()->index(),
+            members.back()->index() + members.back()->size() - members.front()->index(),
+            true),
+    members_(members),
+    total_count_(0),
+    max_dim_(1)
+{
+  for(auto& prox : members_)
+    this->diagsteps_ = this->diagsteps_ && prox->diagsteps();
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::Initialize()
+{
+  for(auto& prox : members_)
+    prox->Initialize();
+
+  Update();
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::Release()
+{
+  for(auto& prox : members_)
+    prox->Release();
+
+  d_entries_.clear();
+  d_entries_.shrink_to_fit();
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::Update()
+{
+  std::vector<ProxElemOperationBatchEntry<T, ELEM_OPERATION> > entries;
+  entries.reserve(members_.size());
+
+  total_count_ = 0;
+  max_dim_ = 1;
+
+  for(auto& prox : members_)
+  {
+    prox->Update();
+
+    ProxElemOperationBatchEntry<T, ELEM_OPERATION> entry;
+    entry.offset = prox->index() - this->index_;
+    entry.first = total_count_;
+
+    const ProxSeparableSum<T> *sep_prox = dynamic_cast<const ProxSeparableSum<T> *>(prox.get());
+
+    if(sep_prox != nullptr)
+    {
+      entry.count = sep_prox->count();
+      entry.dim = sep_prox->dim();
+      entry.interleaved = sep_prox->interleaved();
+      entry.identity = false;
+    }
+    else if(dynamic_cast<const ProxZero<T> *>(prox.get()) != nullptr)
+    {
+      entry.count = prox->size();
+      entry.dim = 1;
+      entry.interleaved = false;
+      entry.identity = true;
+    }
+    else
+    {
+      std::stringstream ss;
+      ss << "ProxElemOperationBatch: prox at index " << prox->index() << " can not be batched.";
+      throw Exception(ss.str());
+    }
+
+    ProxElemOperationBatchCoefficients<T, ELEM_OPERATION>(entry, prox.get());
+
+    total_count_ += entry.count;
+    max_dim_ = std::max(max_dim_, entry.dim);
+    entries.push_back(entry);
+  }
+
+  try
+  {
+    d_entries_ = entries;
+  }
+  catch(std::bad_alloc &e)
+  {
+    throw Exception(e.what());
+  }
+  catch(thrust::system_error &e)
+  {
+    throw Exception(e.what());
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+size_t
+ProxElemOperationBatch<T, ELEM_OPERATION>::gpu_mem_amount() const
+{
+  size_t mem = d_entries_.size() * sizeof(ProxElemOperationBatchEntry<T, ELEM_OPERATION>);
+
+  for(auto& prox : members_)
+    mem += prox->gpu_mem_amount();
+
+  return mem;
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::get_separable_structure(
+  vector<std::tuple<size_t, size_t, size_t> >& sep)
+{
+  for(auto& prox : members_)
+  {
+    if(!prox->diagsteps())
+      prox->get_separable_structure(sep);
+  }
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::Launch(
+  T *d_res,
+  const T *d_arg,
+  const ProxArgument<T>& prox_arg,
+  bool fused,
+  const T *d_tau,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
   typename ELEM_OPERATION::GetSharedMemCount get_shared_mem_count;
 
-  size_t shmem_bytes =
-    get_shared_mem_count(this->dim_) *
-    block.x *
+  const size_t op_bytes =
+    get_shared_mem_count(max_dim_) *
     sizeof(typename ELEM_OPERATION::SharedMemType);
-  
-  ProxElemOperationKernel<T, ELEM_OPERATION>
-    <<<grid, block, shmem_bytes>>>(
-      thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&(*arg_beg)),
-      thrust::raw_pointer_cast(&(*tau_beg)),
+
+  const bool launched = LaunchProxElemOperationKernel<ELEM_OPERATION>(
+      "ProxElemOperationBatchKernel",
+      &ProxElemOperationBatchKernel<T, ELEM_OPERATION>,
+      total_count_,
+      op_bytes,
+      0,
+      0,
+      stream,
+      d_res,
+      d_arg,
+      prox_arg,
+      fused,
+      d_tau,
       tau,
       invert_tau,
-      this->count_,
-      this->dim_,
-      coeffs,
-      this->interleaved_);
-  cudaDeviceSynchronize();
+      thrust::raw_pointer_cast(d_entries_.data()),
+      d_entries_.size(),
+      total_count_,
+      max_dim_);
+
+  if(!launched)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperationBatch: the shared memory for dimension " << max_dim_ 
+       << " exceeds the limit of the device.";
+    throw Exception(ss.str());
+  }
 
   // check for error
   cudaError_t error = cudaGetLastError();
@@ -199,25 +1710,90 @@ ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCo
 
 template<typename T, class ELEM_OPERATION>
 void
-ProxElemOperation<T, ELEM_OPERATION, typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0>::type>::Initialize() 
+ProxElemOperationBatch<T, ELEM_OPERATION>::EvalLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  for(size_t i = 0; i < ELEM_OPERATION::kCoeffsCount; i++)
-  { 
-    try
-    {
-      if(coeffs_[i].size() > 1)
-      {
-        d_coeffs_[i] = coeffs_[i];
-      }
-    }
-    catch(std::bad_alloc &e)
-    {
-      throw Exception(e.what());
-    }
-    catch(thrust::system_error &e)
-    {
-      throw Exception(e.what());
-    }
+  ProxArgument<T> prox_arg = ProxArgument<T>();
+
+  Launch(
+    thrust::raw_pointer_cast(&(*result_beg)),
+    thrust::raw_pointer_cast(&(*arg_beg)),
+    prox_arg,
+    false,
+    thrust::raw_pointer_cast(&(*tau_beg)),
+    tau,
+    invert_tau,
+    stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  Launch(
+    thrust::raw_pointer_cast(&(*result_beg)),
+    nullptr,
+    arg,
+    true,
+    thrust::raw_pointer_cast(&(*tau_beg)),
+    tau,
+    invert_tau,
+    stream);
+}
+
+template<typename T, class ELEM_OPERATION>
+bool
+ProxElemOperationBatch<T, ELEM_OPERATION>::supports_energy() const
+{
+  return ElemOperationEnergy<T, ELEM_OPERATION>::kSupported;
+}
+
+template<typename T, class ELEM_OPERATION>
+void
+ProxElemOperationBatch<T, ELEM_OPERATION>::EvalGapLocal(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const typename thrust::device_vector<T>::iterator& gap_end,
+  const typename thrust::device_vector<T>::const_iterator& x_beg,
+  const typename thrust::device_vector<T>::const_iterator& y_beg,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  LaunchProxElemOperationBatchGap<T, ELEM_OPERATION>(
+    thrust::raw_pointer_cast(&(*gap_beg)),
+    thrust::raw_pointer_cast(&(*x_beg)),
+    thrust::raw_pointer_cast(&(*y_beg)),
+    x_scale,
+    y_scale,
+    thrust::raw_pointer_cast(d_entries_.data()),
+    d_entries_.size(),
+    total_count_,
+    stream);
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
   }
 }
 
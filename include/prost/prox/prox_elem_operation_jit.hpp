@@ -0,0 +1,98 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PROX_ELEM_OPERATION_JIT_HPP_
+#define PROST_PROX_ELEM_OPERATION_JIT_HPP_
+
+#include <string>
+#include <thrust/device_vector.h>
+
+#include "prost/prox/prox_separable_sum.hpp"
+#include "prost/jit.hpp"
+#include "prost/common.hpp"
+
+namespace prost {
+
+///
+/// \brief Same as ProxElemOperation, but the kernel is generated and 
+///        compiled with NVRTC in Initialize(). The elementwise operation 
+///        is given as a C++ type expression in terms of T, e.g. 
+///        "ElemOperationNorm2<T, Function1DHuber<T> >". dim, the layout
+///        and all coefficients given by a single value are compile time
+///        constants of the kernel, so loops over dim get unrolled.
+///        Coefficients with count values are read from global memory.
+///
+///        The shared memory of the operation is queried from the compiled
+///        module, operations which need more than fits into a block of a
+///        warp are refused. Operations including the mass norm helpers
+///        are not supported.
+///
+template<typename T>
+class ProxElemOperationJIT : public ProxSeparableSum<T> 
+{
+public:
+  ProxElemOperationJIT(
+    size_t index,
+    size_t count,
+    size_t dim,
+    bool interleaved,
+    bool diagsteps,
+    const std::string& operation,
+    const vector<vector<T> >& coeffs);
+
+  virtual void Initialize();
+  virtual size_t gpu_mem_amount() const;
+
+  /// \brief Source code of the kernel, available after Initialize().
+  const std::string& source() const { return source_; }
+
+protected:
+  virtual void EvalLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+private:
+  std::string GenerateSource() const;
+
+  std::string operation_;
+  vector<vector<T> > coeffs_;
+
+  /// \brief Coefficients with count values and pointers to them.
+  vector<device_vector<T> > d_coeffs_;
+  device_vector<const T *> d_coeffs_ptr_;
+
+  std::string source_;
+  CUfunction kernel_;
+
+  /// \brief Shared memory of the operation per thread in bytes, as with
+  ///        GetSharedMemCount in ProxElemOperation.
+  size_t shared_mem_per_thread_;
+};
+
+} // namespace prost
+
+#endif // PROST_PROX_ELEM_OPERATION_JIT_HPP_
@@ -28,41 +28,73 @@
 #include <cuda_runtime.h>
 #include <cusparse.h>
 #include <cusolverDn.h>
+#include <cusolverSp.h>
 
 #include "prost/prox/prox.hpp"
 #include "prost/prox/vector.hpp"
 #include "prost/common.hpp"
+#include "prost/sparse_matrix.hpp"
 
 namespace prost {
 
+template<typename T> struct ProxIndRangeFactor;
+
 ///
 /// \brief Implements projection onto range of sparse matrix A. 
 ///        x = A * ((A' * A)^{-1} * (A' * x0))
 ///
+///        The Cholesky factor of A'A is shared through a process wide cache,
+///        keyed on the contents of the matrix, so that proxs with the same A
+///        alive at the same time (sweeps, batches, several problem handles)
+///        factorize only once. The factor is freed with the last of them.
+///
 template<typename T>
 class ProxIndRange : public Prox<T> 
 {
 public:
+  enum Factorization {
+    /// \brief Dense Cholesky factorization of the A'A given by setAA.
+    kFactorizationDense,
+
+    /// \brief Sparse Cholesky factorization of A'A, which is computed from
+    ///        A in an approximate minimum degree ordering. No setAA.
+    kFactorizationSparse,
+  };
+
   ProxIndRange(size_t index, 
 	       size_t size, 
-	       bool diagsteps) : Prox<T>(index, size, diagsteps) { }
+	       bool diagsteps) : Prox<T>(index, size, diagsteps), transpose_spmv_(false),
+                                 factorization_(kFactorizationDense) { }
 
-  // call before initialize
+  // call before initialize. If transpose_spmv is set, only the CSR copy
+  // of A is kept, and the host arrays are freed after the upload.
   void setA(int m,
 	    int n,
 	    int nnz,
 	    const vector<T>& val,
 	    const vector<int32_t>& ptr,
-	    const vector<int32_t>& ind);
+	    const vector<int32_t>& ind,
+	    bool transpose_spmv = false);
 
   // call before initialize
   void setAA(int m,
 	     int n,
 	     const vector<T>& val);
 
+  // call before initialize
+  void set_factorization(Factorization factorization) { factorization_ = factorization; }
+
   virtual void Initialize();
   
   virtual size_t gpu_mem_amount() const;
+  virtual size_t scratch_size() const 
+  { 
+    return (factorization_ == kFactorizationSparse) ? 3 * ncols_ : ncols_; 
+  }
+
+  /// \brief Forgets the cached factorizations. The cache does not own
+  ///        them, a factorization is freed with the last prox using it.
+  static void ClearFactorCache();
    
 protected:
   virtual void EvalLocal(
@@ -73,24 +105,37 @@ protected:
     const typename thrust::device_vector<T>::const_iterator& tau_beg,
     const typename thrust::device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau);
+    bool invert_tau,
+    cudaStream_t stream);
   
 private:
-  cusparseHandle_t cusp_handle_;
-  cusolverDnHandle_t cusolver_handle_;
-  cusparseMatDescr_t descr_;
+  /// \brief Solves (A'A) x = x using the Cholesky factorization, temp
+  ///        holds 2 * ncols_ elements for the sparse factorization.
+  void SolveAA(T *x, T *temp, cudaStream_t stream);
+
+  /// \brief Uploads A, afterwards only the GPU copy is kept if
+  ///        transpose_spmv is set.
+  void InitializeA();
+
+  /// \brief Factorizes host_AA_val_.
+  void FactorizeDense(ProxIndRangeFactor<T>& factor);
+
+  /// \brief Builds A'A from the host copy of A and factorizes it.
+  void FactorizeSparse(ProxIndRangeFactor<T>& factor);
 
   size_t nrows_, ncols_;
   size_t nnz_;
+  bool transpose_spmv_;
+  Factorization factorization_;
 
   vector<T> host_AA_val_;
-  device_vector<T> buffer_, AA_fac_, AA_val_;
+  shared_ptr<ProxIndRangeFactor<T>> factor_;
   device_vector<int> info_;
 
-  device_vector<int32_t> ind_, ind_t_; 
-  device_vector<int32_t> ptr_, ptr_t_; 
-  device_vector<T> val_, val_t_; 
-  device_vector<T> temp_;
+  /// \brief Workspace of the sparse triangular solves.
+  device_vector<char> solve_buffer_;
+
+  SparseMatrix<T> A_;
 
   vector<int32_t> host_ind_, host_ind_t_; 
   vector<int32_t> host_ptr_, host_ptr_t_; 
@@ -64,7 +64,8 @@ protected:
     const typename thrust::device_vector<T>::const_iterator& tau_beg,
     const typename thrust::device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau);
+    bool invert_tau,
+    cudaStream_t stream);
   
 private:    
   T alpha_;
@@ -72,7 +72,8 @@ protected:
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau);
+    bool invert_tau,
+    cudaStream_t stream);
 
 private:
   size_t dim_, dim_2_;
@@ -29,7 +29,10 @@
 namespace prost {
 
 /// 
-/// \brief Evaluates the conjugate prox using Moreau's identity.
+/// \brief Evaluates the conjugate prox using Moreau's identity. If the
+///        conjugate supports_moreau_eval(), the identity is evaluated
+///        inside its kernel in a single pass, otherwise the argument is
+///        scaled and combined in two additional passes.
 /// 
 template<typename T>
 class ProxMoreau : public Prox<T> {
@@ -41,8 +44,18 @@ public:
   virtual void Release();
 
   virtual size_t gpu_mem_amount() const;
+  virtual size_t scratch_size() const;
+  virtual bool supports_fused_eval() const { return conjugate_->supports_moreau_eval(); }
+  virtual bool supports_host_eval() const { return conjugate_->supports_host_eval(); }
+  virtual bool supports_energy() const { return conjugate_->supports_energy(); }
+  virtual void set_workspace(shared_ptr<ProxWorkspace<T>> workspace);
+  virtual void set_context(shared_ptr<ExecutionContext> context);
+  virtual void set_index(size_t index);
   virtual void get_separable_structure(vector<std::tuple<size_t, size_t, size_t> >& sep);
 
+  /// \brief Prox of the conjugate function evaluated by Moreau's identity.
+  const shared_ptr<Prox<T>>& conjugate() const { return conjugate_; }
+
 protected:
   virtual void EvalLocal(
     const typename device_vector<T>::iterator& result_beg,
@@ -52,11 +65,42 @@ protected:
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalFusedLocal(
+    const typename device_vector<T>::iterator& result_beg,
+    const typename device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename device_vector<T>::const_iterator& tau_beg,
+    const typename device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  /// \brief The gap of the conjugate with swapped arguments, since 
+  ///        h^{**} = h for the convex functions providing an energy.
+  virtual void EvalGapLocal(
+    const typename device_vector<T>::iterator& gap_beg,
+    const typename device_vector<T>::iterator& gap_end,
+    const typename device_vector<T>::const_iterator& x_beg,
+    const typename device_vector<T>::const_iterator& y_beg,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream);
+
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
     bool invert_tau);
 
 private:
   shared_ptr<Prox<T>> conjugate_;
-  device_vector<T> scaled_arg_;
+
+  /// \brief Scaled argument of EvalHostLocal.
+  vector<T> host_scaled_arg_;
 };
 
 } // namespace prost
@@ -41,6 +41,10 @@ public:
   virtual void Release();
 
   virtual size_t gpu_mem_amount() const;
+  virtual size_t scratch_size() const;
+  virtual void set_workspace(shared_ptr<ProxWorkspace<T>> workspace);
+  virtual void set_context(shared_ptr<ExecutionContext> context);
+  virtual void set_index(size_t index);
   virtual void get_separable_structure(vector<std::tuple<size_t, size_t, size_t> >& sep);
 
 protected:
@@ -52,11 +56,11 @@ protected:
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau);
+    bool invert_tau,
+    cudaStream_t stream);
 
 private:
   shared_ptr<Prox<T>> base_prox_;
-  device_vector<T> permuted_arg_;
   std::vector<int> perm_host_;
   device_vector<int> perm_;
 };
@@ -46,7 +46,22 @@ public:
   virtual void Initialize();
   virtual void Release();
 
+  /// \brief Replaces the coefficients after Initialize(). Each vector has
+  ///        to keep its size, the data is copied in place on the device.
+  void SetCoefficients(
+    const vector<T>& a,
+    const vector<T>& b,
+    const vector<T>& c,
+    const vector<T>& d,
+    const vector<T>& e,
+    cudaStream_t stream = 0);
+
   virtual size_t gpu_mem_amount() const;
+  virtual size_t scratch_size() const;
+  virtual bool supports_host_eval() const { return inner_fn_->supports_host_eval(); }
+  virtual void set_workspace(shared_ptr<ProxWorkspace<T>> workspace);
+  virtual void set_context(shared_ptr<ExecutionContext> context);
+  virtual void set_index(size_t index);
   virtual void get_separable_structure(vector<std::tuple<size_t, size_t, size_t> >& sep);
 
 protected:
@@ -58,14 +73,23 @@ protected:
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
     bool invert_tau);
 
 private:
   shared_ptr<Prox<T> > inner_fn_;
-  device_vector<T> scaled_arg_;
-  device_vector<T> scaled_tau_;
 
   vector<T> host_a_, host_b_, host_c_, host_d_, host_e_;
+
+  /// \brief Scaled argument and step sizes of EvalHostLocal.
+  vector<T> host_scaled_arg_, host_scaled_tau_;
   device_vector<T> dev_a_, dev_b_, dev_c_, dev_d_, dev_e_;
 };
 
@@ -0,0 +1,96 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_PROX_WORKSPACE_HPP_
+#define PROST_PROX_WORKSPACE_HPP_
+
+#include <thrust/device_vector.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+using thrust::device_vector;
+
+///
+/// \brief Device scratch memory shared by all proximal operators of a
+///        problem. Temporaries are handed out in a stack-like fashion,
+///        so nested operators (e.g. ProxTransform around ProxPermute)
+///        obtain disjoint slices. Since the proxs are evaluated one after
+///        another on the same stream, the memory of one prox can be reused
+///        by the next one and the total size is the maximum instead of the
+///        sum of the temporaries.
+///
+template<typename T>
+class ProxWorkspace {
+public:
+  ///
+  /// \brief Acquires count elements for the lifetime of the object, so
+  ///        they are given back also if the evaluation throws.
+  ///
+  class Slice {
+  public:
+    Slice(ProxWorkspace<T>& workspace, size_t count)
+      : workspace_(workspace), count_(count), begin_(workspace.Acquire(count)) { }
+
+    // slices are acquired and given back in stack order
+    ~Slice() { workspace_.offset_ -= count_; }
+
+    Slice(const Slice&) = delete;
+    Slice& operator=(const Slice&) = delete;
+
+    typename device_vector<T>::iterator begin() const { return begin_; }
+    typename device_vector<T>::iterator end() const { return begin_ + count_; }
+
+  private:
+    ProxWorkspace<T>& workspace_;
+    size_t count_;
+    typename device_vector<T>::iterator begin_;
+  };
+
+  ProxWorkspace();
+
+  /// \brief Makes sure that at least size elements are available. Must not
+  ///        be called while slices are handed out.
+  void Reserve(size_t size);
+
+  /// \brief Frees the device memory.
+  void Release();
+
+  /// \brief Hands out the next count elements of the workspace, prefer a
+  ///        Slice which gives them back on its own.
+  typename device_vector<T>::iterator Acquire(size_t count);
+
+  /// \brief Gives back the last count acquired elements.
+  void Release(size_t count);
+
+  size_t size() const { return data_.size(); }
+  size_t gpu_mem_amount() const { return data_.size() * sizeof(T); }
+
+private:
+  device_vector<T> data_;
+
+  /// \brief Number of elements currently handed out.
+  size_t offset_;
+};
+
+} // namespace prost
+
+#endif // PROST_PROX_WORKSPACE_HPP_
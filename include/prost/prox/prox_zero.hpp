@@ -35,6 +35,9 @@ public:
   virtual ~ProxZero();
 
   virtual size_t gpu_mem_amount() const { return 0; }
+  virtual bool supports_fused_eval() const { return true; }
+  virtual bool supports_host_eval() const { return true; }
+  virtual bool supports_energy() const { return true; }
 
 protected:
   virtual void EvalLocal(
@@ -45,6 +48,33 @@ protected:
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalFusedLocal(
+    const typename device_vector<T>::iterator& result_beg,
+    const typename device_vector<T>::iterator& result_end,
+    const ProxArgument<T>& arg,
+    const typename device_vector<T>::const_iterator& tau_beg,
+    const typename device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream);
+
+  virtual void EvalGapLocal(
+    const typename device_vector<T>::iterator& gap_beg,
+    const typename device_vector<T>::iterator& gap_end,
+    const typename device_vector<T>::const_iterator& x_beg,
+    const typename device_vector<T>::const_iterator& y_beg,
+    T x_scale,
+    T y_scale,
+    cudaStream_t stream);
+
+  virtual void EvalHostLocal(
+    T *result,
+    const T *arg,
+    const T *tau_diag,
+    T tau,
     bool invert_tau);
 };
 
@@ -36,14 +36,21 @@ public:
     sh_arg_ = reinterpret_cast<T*>(sh_mem);
   }
 
-  inline __device__
+  /// \brief Host version, the memory of the element is given by buffer.
+  __host__
+  SharedMem(size_t dim, T *buffer)
+      : dim_(dim), threadIdx_x_(0), sh_arg_(buffer)
+  {
+  }
+
+  inline __host__ __device__
   T operator[](size_t i) const
   {
     size_t index = threadIdx_x_ * get_count_fun_(dim_) + i;
     return sh_arg_[index];
   }
 
-  inline __device__
+  inline __host__ __device__
   T& operator[](size_t i)
   {
     // Out of bounds check?
@@ -21,12 +21,21 @@
 #ifndef PROST_SOLVER_HPP_
 #define PROST_SOLVER_HPP_
 
+#include <cuda_runtime.h>
+#include <thrust/device_vector.h>
+
 #include "prost/common.hpp"
+#include "prost/backend/convergence_history.hpp"
+#include "prost/profiler.hpp"
+#include "prost/execution_context.hpp"
+#include "prost/managed_memory.hpp"
 
 namespace prost {
 
 template<typename T> class Problem;
 template<typename T> class Backend;
+template<typename T> class Presolve;
+template<typename T> class Checkpoint;
 
 /// 
 /// \brief Solver for graph-form problems.
@@ -49,6 +58,12 @@ public:
     /// \brief absolute dual stopping tolerace
     T tol_abs_dual;
 
+    /// \brief Stop if the primal-dual gap falls below tol_gap * ncols, 
+    ///        in addition to the residual rule. The gap is evaluated on the
+    ///        device at the residual checks by backends supporting it, a
+    ///        non-positive value disables it.
+    T tol_gap;
+
     /// \brief maximum number of iterations
     int max_iters;
 
@@ -65,8 +80,96 @@ public:
     /// \brief Initial dual solution
     vector<T> y0;
 
-    /// \brief Solve the dual or primal problem?
+    /// \brief Initial primal and dual solution in device memory, used 
+    ///        instead of x0 and y0 if set. They are read in Initialize(),
+    ///        directly by backends supporting it and through the host
+    ///        otherwise.
+    const T *x0_device;
+    const T *y0_device;
+
+    /// \brief Copy the final iterate to cur_primal_sol() etc. at the end of
+    ///        Solve(). Can be disabled if the solution is read with
+    ///        CopySolutionDevice() and no intermediate callback is used.
+    bool host_solution;
+
+    /// \brief Solve the dual or primal problem? The problem is dualized
+    ///        once in Initialize() and restored in Release().
     bool solve_dual_problem;
+
+    /// \brief Replay captured CUDA graphs of several iterations in between
+    ///        residual evaluations and callbacks, if the backend supports it.
+    bool use_cuda_graph;
+
+    /// \brief Reduce the residuals into device memory and read them back
+    ///        asynchronously, so the host keeps queueing iterations while
+    ///        the convergence check is in flight. Convergence may be
+    ///        detected up to one residual interval late.
+    bool async_convergence_check;
+
+    /// \brief Space the residual evaluations by extrapolating the decay of
+    ///        the residuals instead of every residual_iter iterations. The
+    ///        residual_iter of the backend is then the smallest spacing.
+    bool adaptive_residuals;
+
+    /// \brief Largest spacing of adaptively scheduled residual evaluations.
+    int max_residual_iter;
+
+    /// \brief Take the solutions passed to the intermediate callback as 
+    ///        double-buffered snapshots on a side stream. The callback then
+    ///        receives the most recently completed snapshot and its iteration.
+    bool async_snapshots;
+
+    /// \brief Time the blocks, proxes and backend phases, see profile().
+    ///        Disables the CUDA graph replays.
+    bool profile;
+
+    /// \brief Math mode of the dense Kronecker blocks, allows TF32 or FP16
+    ///        tensor cores for float problems.
+    DenseMath dense_math;
+
+    /// \brief Time the block size candidates of the elementwise prox 
+    ///        kernels in their first launches and keep the fastest, see
+    ///        LaunchConfig. Results are cached in a tuning file per device
+    ///        in PROST_TUNING_DIR or ~/.prost.
+    bool autotune_launches;
+
+    /// \brief Memory the linear operator is stored in. In managed memory
+    ///        it may exceed the device memory and its blocks are streamed
+    ///        through the GPU, the iterates stay in device memory.
+    OperatorMemory operator_memory;
+
+    /// \brief Eliminate fixed variables and variables without entries in
+    ///        the linear operator before initializing, see Presolve. The
+    ///        remaining operator is stored as a single sparse matrix.
+    bool presolve;
+
+    /// \brief Number of entries of the device-side convergence history, 
+    ///        0 disables it. The backends record the residuals, eps values
+    ///        and step sizes of every iteration without synchronizing, the
+    ///        ring is flushed to the host at callbacks and at the end of
+    ///        the solve, see history(). Disables the CUDA graph replays.
+    int history_size;
+
+    /// \brief Evaluate the residuals for the history in every iteration
+    ///        instead of only where the backend evaluates them. Only used
+    ///        by BackendPDHG outside of the low_memory mode, where this 
+    ///        costs one fused reduction per iteration.
+    bool history_every_iter;
+
+    /// \brief File the complete state of the backend is periodically 
+    ///        written to, empty disables the checkpoints. They are staged 
+    ///        in device memory and written in the background, a checkpoint
+    ///        due while the previous one is still written is postponed.
+    string checkpoint_file;
+
+    /// \brief Every how many iterations to write a checkpoint, a 
+    ///        non-positive value only resumes.
+    int checkpoint_iter;
+
+    /// \brief Resume from checkpoint_file in Initialize() if it exists. 
+    ///        The following Solve() continues at the iteration of the
+    ///        checkpoint, with the problem and options it was taken with.
+    bool resume;
   };
 
   enum ConvergenceResult {
@@ -81,24 +184,133 @@ public:
   /// \brief Stopping callback. Used to terminate the solver
   ///        prematurely (i.e. by user input from Matlab).
   typedef function<bool()> StoppingCallback;
+
+  /// \brief Device pointers to the current solution (x, z, y, w) of the
+  ///        original problem, valid during a device callback. x and w have
+  ///        ncols entries, z and y have nrows entries.
+  struct DeviceSolution {
+    const T *x;
+    const T *z;
+    const T *y;
+    const T *w;
+    size_t ncols;
+    size_t nrows;
+
+    /// \brief Stream the solution was written on.
+    cudaStream_t stream;
+  };
+
+  /// \brief Intermediate callback reading the solution in device memory.
+  ///        Arguments: (iteration, solution). Returns true to stop.
+  typedef function<bool(int, const DeviceSolution&)> DeviceIntermCallback;
+
+  /// \brief Computes a few values from the solution on the device, e.g. the
+  ///        energy, and writes them to values in device memory on the 
+  ///        stream of the solution.
+  typedef function<void(const DeviceSolution&, T *values)> DeviceReduction;
+
+  /// \brief Receives the values of the DeviceReduction on the host.
+  ///        Arguments: (iteration, values). Returns true to stop.
+  typedef function<bool(int, const vector<T>&)> ReductionCallback;
   
   Solver(shared_ptr<Problem<T>> problem, shared_ptr<Backend<T>> backend);
   virtual ~Solver() {}
 
   void Initialize();
   typename Solver<T>::ConvergenceResult Solve();
+
+  /// \brief Solves again after the problem data was updated in place and
+  ///        Problem::Update() was called, starting from the last solution.
+  ///        Nothing is re-initialized, in particular the step sizes are 
+  ///        kept from the previous solve.
+  typename Solver<T>::ConvergenceResult Resolve();
   void Release();
 
   void SetOptions(const typename Solver<T>::Options &opts);
   void SetStoppingCallback(const typename Solver<T>::StoppingCallback& cb);
   void SetIntermCallback(const typename Solver<T>::IntermCallback& cb);
 
+  /// \brief Sets a callback, invoked like the intermediate callback, which
+  ///        reads the solution from device memory. The solution is not 
+  ///        copied to the host for it.
+  void SetDeviceIntermCallback(const typename Solver<T>::DeviceIntermCallback& cb);
+
+  /// \brief Sets a reduction of the solution to num_values values on the
+  ///        device, which are handed to cb at the callback iterations. 
+  ///        Only the values are copied to the host.
+  void SetReductionCallback(const typename Solver<T>::DeviceReduction& reduction,
+                            size_t num_values,
+                            const typename Solver<T>::ReductionCallback& cb);
+
   const vector<T>& cur_primal_sol() const; 
   const vector<T>& cur_dual_sol() const;
   const vector<T>& cur_primal_constr_sol() const;
   const vector<T>& cur_dual_constr_sol() const;
+
+  /// \brief Returns true if CopySolutionDevice() is supported, i.e. the
+  ///        backend keeps the iterate on the device and the problem was 
+  ///        not presolved.
+  bool device_solution() const;
+
+  /// \brief Copies the current solution (x, z, y, w) into device memory,
+  ///        sized like cur_primal_sol() etc. Pointers may be null.
+  void CopySolutionDevice(T *x, T *z, T *y, T *w);
+
+  /// \brief Breakdown of the GPU time of the last Solve() if profiling is
+  ///        enabled, sorted by descending time.
+  const vector<Profiler::Entry>& profile() const { return profile_; }
+
+  /// \brief Convergence history of the last Solve() if history_size is
+  ///        set, one entry per iteration in order.
+  const vector<HistoryEntry<T> >& history() const;
+
+  /// \brief Number of iterations missing in history(), as more than
+  ///        history_size iterations passed between two flushes.
+  size_t history_dropped() const;
+
+  /// \brief Primal-dual gap at the last residual check of the last 
+  ///        Solve(), infinity if it was not evaluated (see tol_gap).
+  T primal_dual_gap() const;
   
 protected:
+  /// \brief Initializes the problem, with the operator in managed memory if
+  ///        out_of_core is set, and the backend. Throws an 
+  ///        OutOfMemoryException if either runs out of device memory.
+  void InitializeProblemBackend(bool out_of_core);
+
+  /// \brief Initializes the problem and a backend running on the host,
+  ///        without creating a stream or an execution context.
+  void InitializeHost();
+
+  /// \brief Creates the checkpoint writer if checkpoint_file is set and
+  ///        restores the backend from it if resume is set.
+  void InitializeCheckpoint();
+
+  /// \brief Replaces problem_ by the reduced problem, if opts_.presolve is
+  ///        set and variables could be eliminated.
+  void PresolveProblem();
+
+  /// \brief Sizes the solution vectors, for the original problem if it
+  ///        was presolved.
+  void ResizeSolution();
+
+  /// \brief Copies the current iterate (or the latest snapshot, returning
+  ///        its iteration) of the backend to the cur_*_sol_ vectors,
+  ///        expanded to the original problem if it was presolved.
+  void FetchSolution();
+  int FetchSnapshot();
+  void ExpandSolution();
+
+  /// \brief Copies x0_device and y0_device to x0 and y0, for backends and
+  ///        presolves which take the initial iterate from the host.
+  void DownloadInitialIterate();
+
+  /// \brief Invokes the device callbacks with the current iterate, which
+  ///        is copied into device_sol_ on the device, or uploaded from the
+  ///        host if the backend does not keep it there. Returns true if a
+  ///        callback asks to stop.
+  bool InvokeDeviceCallbacks(int iter);
+
   typename Solver<T>::Options opts_;
   shared_ptr<Problem<T>> problem_;
   shared_ptr<Backend<T>> backend_;
@@ -108,8 +320,50 @@ protected:
   vector<T> cur_primal_constr_sol_; // z
   vector<T> cur_dual_constr_sol_; // w
 
+  /// \brief Presolve of the problem passed to the constructor, which is 
+  ///        kept in original_problem_ while problem_ is the reduced one.
+  shared_ptr<Presolve<T>> presolve_;
+  shared_ptr<Problem<T>> original_problem_;
+  vector<T> original_x0_, original_y0_;
+
+  /// \brief Solution (x, z, y, w) of the reduced problem.
+  vector<T> red_primal_sol_;
+  vector<T> red_primal_constr_sol_;
+  vector<T> red_dual_sol_;
+  vector<T> red_dual_constr_sol_;
+
+  vector<Profiler::Entry> profile_;
+
+  /// \brief Set while this solver has the shared profiler enabled.
+  bool profiling_;
+
   typename Solver<T>::IntermCallback interm_cb_;
   typename Solver<T>::StoppingCallback stopping_cb_;
+
+  typename Solver<T>::DeviceIntermCallback device_interm_cb_;
+  typename Solver<T>::DeviceReduction device_reduction_;
+  typename Solver<T>::ReductionCallback reduction_cb_;
+
+  /// \brief Solution handed to the device callbacks, allocated at their
+  ///        first invocation, and the reduced values.
+  thrust::device_vector<T> device_sol_x_;
+  thrust::device_vector<T> device_sol_z_;
+  thrust::device_vector<T> device_sol_y_;
+  thrust::device_vector<T> device_sol_w_;
+  thrust::device_vector<T> reduction_values_;
+  vector<T> host_reduction_values_;
+
+  /// \brief Stream all iterations are launched on.
+  cudaStream_t stream_;
+
+  /// \brief Library handles of this solver, handed to the problem.
+  shared_ptr<ExecutionContext> context_;
+
+  /// \brief Writer of the checkpoints, null if they are disabled.
+  shared_ptr<Checkpoint<T>> checkpoint_;
+
+  /// \brief Iteration the next Solve() starts at, set by resuming.
+  int start_iteration_;
 };
 
 } // namespace prost
@@ -0,0 +1,98 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_SPARSE_CHOLESKY_HPP_
+#define PROST_SPARSE_CHOLESKY_HPP_
+
+#include <thrust/device_vector.h>
+
+#include <cuda_runtime.h>
+#include <cusparse.h>
+#include <cusolverSp.h>
+#include <cusolverSp_LOWLEVEL_PREVIEW.h>
+
+#include "prost/common.hpp"
+
+namespace prost {
+
+///
+/// \brief Sparse Cholesky factorization of a symmetric positive definite
+///        matrix resident on the GPU, used by BackendADMM for the direct
+///        projection onto the graph of the linear operator.
+///
+/// The matrix is reordered by symmetric approximate minimum degree and
+/// analysed once in Initialize(). Factor() recomputes the numerical
+/// factorization for new values on the same pattern, so that Solve()
+/// only runs the two triangular solves.
+///
+template<typename T>
+class SparseCholesky {
+public:
+  SparseCholesky();
+  ~SparseCholesky();
+
+  /// \brief Analyses and factorizes the n x n matrix given in CSR. Both
+  ///        triangles of the matrix have to be stored.
+  void Initialize(
+    int n,
+    const vector<int32_t>& ptr,
+    const vector<int32_t>& ind,
+    const vector<T>& val);
+
+  /// \brief Refactorizes for new values on the pattern passed to Initialize.
+  void Factor(const vector<T>& val);
+
+  /// \brief Solves A x = b on the given stream, b and x may not alias.
+  void Solve(const T *d_b, T *d_x, cudaStream_t stream = 0);
+
+  void Release();
+
+  size_t gpu_mem_amount() const;
+
+  int n() const { return n_; }
+  int nnz() const { return nnz_; }
+
+private:
+  int n_, nnz_;
+  bool initialized_;
+
+  cusolverSpHandle_t handle_;
+  cusparseMatDescr_t descr_;
+  csrcholInfo_t info_;
+
+  /// \brief Fill-reducing permutation, row i of the reordered matrix is
+  ///        row perm_[i] of the original one.
+  vector<int32_t> host_perm_;
+
+  /// \brief Position in the original value array of each entry of the
+  ///        reordered matrix.
+  vector<int32_t> host_map_;
+
+  device_vector<int32_t> perm_;
+  device_vector<int32_t> ptr_, ind_;
+  device_vector<T> val_;
+  device_vector<T> b_perm_, x_perm_;
+  device_vector<char> buffer_;
+  size_t internal_bytes_;
+};
+
+} // namespace prost
+
+#endif // PROST_SPARSE_CHOLESKY_HPP_
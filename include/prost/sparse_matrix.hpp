@@ -0,0 +1,187 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_SPARSE_MATRIX_HPP_
+#define PROST_SPARSE_MATRIX_HPP_
+
+#include <thrust/device_vector.h>
+
+#include <cuda_runtime.h>
+#include <cusparse.h>
+
+#include "prost/common.hpp"
+#include "prost/managed_memory.hpp"
+
+/// \brief The generic cusparseSpMV API is available from CUDA 11 on, older
+///        toolkits fall back to the legacy csrmv routines.
+#if CUDART_VERSION >= 11000
+#define PROST_CUSPARSE_GENERIC 1
+#else
+#define PROST_CUSPARSE_GENERIC 0
+#endif
+
+namespace prost {
+
+///
+/// \brief Sparse CSR matrix resident on the GPU, used by BlockSparse and
+///        ProxIndRange for y = alpha * op(A) * x + beta * y.
+///
+/// The SpMV algorithm is chosen once from the row-length statistics of
+/// the matrix and the workspace is allocated (and, where supported,
+/// preprocessed) in Initialize(), so that Multiply() does no allocation.
+/// If transpose_spmv is set, the adjoint is computed by a transposed SpMV
+/// on the forward arrays and no CSC copy is kept on the device.
+///
+template<typename T>
+class SparseMatrix {
+public:
+  SparseMatrix();
+  ~SparseMatrix();
+
+  /// \brief Uploads the m x n matrix given in CSR (val, ptr, ind) and its
+  ///        transpose in CSR (val_t, ptr_t, ind_t).
+  void Initialize(
+    cusparseHandle_t handle,
+    int m,
+    int n,
+    int nnz,
+    const vector<T>& val,
+    const vector<int32_t>& ptr,
+    const vector<int32_t>& ind,
+    const vector<T>& val_t,
+    const vector<int32_t>& ptr_t,
+    const vector<int32_t>& ind_t,
+    bool transpose_spmv);
+
+  /// \brief Same as above for arrays in host memory, which may be pinned
+  ///        or mapped from a file. The arrays of the transpose are not read
+  ///        if transpose_spmv is set.
+  void Initialize(
+    cusparseHandle_t handle,
+    int m,
+    int n,
+    int nnz,
+    const T *val,
+    const int32_t *ptr,
+    const int32_t *ind,
+    const T *val_t,
+    const int32_t *ptr_t,
+    const int32_t *ind_t,
+    bool transpose_spmv);
+
+  /// \brief Frees the device arrays and descriptors.
+  void Release();
+
+  /// \brief Copies the device CSR arrays of the matrix back to the host.
+  void Download(
+    vector<T>& val,
+    vector<int32_t>& ptr,
+    vector<int32_t>& ind) const;
+
+  bool initialized() const { return initialized_; }
+
+  /// \brief Replaces the values of the matrix and of its transpose in place,
+  ///        keeping the sparsity pattern given in Initialize().
+  void SetValues(
+    const vector<T>& val,
+    const vector<T>& val_t,
+    cudaStream_t stream = 0);
+
+  /// \brief Computes y = alpha * op(A) * x + beta * y on the given stream.
+  void Multiply(
+    cusparseHandle_t handle,
+    bool transpose,
+    T alpha,
+    const T *x,
+    T beta,
+    T *y,
+    cudaStream_t stream = 0);
+
+  /// \brief Prepares MultiplyDense() for dense matrices with k columns,
+  ///        stored row-major or column-major. Requires the generic cuSPARSE
+  ///        API, otherwise supports_dense() stays false.
+  void InitializeDense(cusparseHandle_t handle, int k, bool row_major);
+
+  /// \brief Computes Y = alpha * op(A) * X + beta * Y on the given stream
+  ///        (SpMM), where X and Y are dense with the k columns and the 
+  ///        storage order given to InitializeDense().
+  void MultiplyDense(
+    cusparseHandle_t handle,
+    bool transpose,
+    T alpha,
+    const T *x,
+    T beta,
+    T *y,
+    cudaStream_t stream = 0);
+
+  bool supports_dense() const { return dense_cols_ > 0; }
+
+  size_t gpu_mem_amount() const;
+
+  bool transpose_spmv() const { return transpose_spmv_; }
+
+  /// \brief Device CSR arrays of the matrix and of its transpose, the
+  ///        latter are empty if transpose_spmv is set.
+  const operator_vector<int32_t>& ind() const { return ind_; }
+  const operator_vector<int32_t>& ptr() const { return ptr_; }
+  const operator_vector<T>& val() const { return val_; }
+  const operator_vector<int32_t>& ptr_t() const { return ptr_t_; }
+  const operator_vector<int32_t>& ind_t() const { return ind_t_; }
+  const operator_vector<T>& val_t() const { return val_t_; }
+
+  /// \brief Prefetches the CSR arrays read by Multiply(transpose) to the
+  ///        device, if they were allocated in managed memory.
+  void Prefetch(int device, bool transpose, cudaStream_t stream) const;
+
+private:
+  int m_, n_, nnz_;
+  bool transpose_spmv_;
+  bool initialized_;
+
+  /// \brief Number of columns and storage order of the dense matrices of
+  ///        MultiplyDense(), zero if it was not prepared.
+  int dense_cols_;
+  bool dense_row_major_;
+
+  /// \brief CSR arrays, in managed memory if they were uploaded inside a
+  ///        ManagedMemoryScope.
+  operator_vector<int32_t> ind_, ind_t_;
+  operator_vector<int32_t> ptr_, ptr_t_;
+  operator_vector<T> val_, val_t_;
+
+#if PROST_CUSPARSE_GENERIC
+  cusparseSpMatDescr_t mat_, mat_t_;
+  cusparseSpMVAlg_t alg_, alg_t_;
+
+  /// \brief Workspaces for forward and adjoint SpMV.
+  device_vector<char> buffer_, buffer_t_;
+
+  cusparseSpMMAlg_t spmm_alg_, spmm_alg_t_;
+
+  /// \brief Workspaces for forward and adjoint SpMM.
+  device_vector<char> dense_buffer_, dense_buffer_t_;
+#else
+  cusparseMatDescr_t descr_;
+#endif
+};
+
+} // namespace prost
+
+#endif // PROST_SPARSE_MATRIX_HPP_
@@ -0,0 +1,132 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PROST_SWEEP_SOLVER_HPP_
+#define PROST_SWEEP_SOLVER_HPP_
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+
+#include "prost/common.hpp"
+#include "prost/solver.hpp"
+
+namespace prost {
+
+template<typename T> class Problem;
+template<typename T> class Backend;
+
+/// 
+/// \brief Solves a problem for many parameter points on several GPUs.
+///        Every device gets its own copy of the problem and a host thread,
+///        which takes the next unsolved point, applies its parameters to 
+///        the initialized problem in place and solves again, warm-started
+///        from the previous point on that device.
+///
+/// @tparam typename T. Floating point-type.
+/// 
+template<typename T>
+class SweepSolver {
+public:
+  /// \brief Builds the copy of the problem for a device. Argument: index
+  ///        of the device in devices(). Called in the thread of the device.
+  typedef function<shared_ptr<Problem<T>>(size_t)> ProblemBuilder;
+
+  /// \brief Creates a new backend for a point. Argument: point.
+  typedef function<shared_ptr<Backend<T>>(size_t)> BackendBuilder;
+
+  /// \brief Applies the parameters of a point to the initialized problem
+  ///        of a device, e.g. by ProxElemOperation::SetCoefficients or 
+  ///        Problem::SetScalingAlpha. Arguments: (point, problem). Returns
+  ///        true if the backend has to be created again for the point, e.g.
+  ///        for other step sizes; the problem is then initialized again.
+  typedef function<bool(size_t, Problem<T>&)> ParameterSetter;
+
+  struct Result {
+    typename Solver<T>::ConvergenceResult result;
+
+    /// \brief CUDA device the point was solved on.
+    int device;
+
+    vector<T> x;
+    vector<T> z;
+    vector<T> y;
+    vector<T> w;
+  };
+
+  SweepSolver(
+    size_t num_points,
+    const ProblemBuilder& problem_builder,
+    const BackendBuilder& backend_builder,
+    const ParameterSetter& parameter_setter);
+  virtual ~SweepSolver() {}
+
+  /// \brief Devices to run on, all visible devices by default.
+  void SetDevices(const vector<int>& devices);
+
+  /// \brief Options of every solve. Intermediate callbacks are not called
+  ///        and presolve is not supported.
+  void SetOptions(const typename Solver<T>::Options &opts);
+
+  /// \brief Solves all points and blocks until they are done. Rethrows 
+  ///        the first exception of a device thread.
+  void Solve();
+
+  /// \brief Stops all devices after their current iteration, can be 
+  ///        called from any thread.
+  void Stop() { stop_ = true; }
+
+  size_t num_points() const { return num_points_; }
+  const vector<int>& devices() const { return devices_; }
+
+  /// \brief Result of each point, valid after Solve().
+  const vector<Result>& results() const { return results_; }
+
+protected:
+  /// \brief Solves points on devices_[device_index] until none is left.
+  void SolveDevice(size_t device_index);
+
+  /// \brief Creates and initializes a solver for the problem and point.
+  shared_ptr<Solver<T>> CreateSolver(shared_ptr<Problem<T>> problem, size_t point);
+
+  size_t num_points_;
+  ProblemBuilder problem_builder_;
+  BackendBuilder backend_builder_;
+  ParameterSetter parameter_setter_;
+
+  vector<int> devices_;
+  typename Solver<T>::Options opts_;
+  vector<Result> results_;
+
+  /// \brief Next point to be solved.
+  std::atomic<size_t> next_point_;
+  std::atomic<bool> stop_;
+
+  /// \brief Serializes building and initializing, which share static
+  ///        state such as the constant memory slots of BlockDiags.
+  std::mutex init_mutex_;
+
+  /// \brief First exception of each device thread.
+  vector<std::exception_ptr> errors_;
+};
+
+} // namespace prost
+
+#endif // PROST_SWEEP_SOLVER_HPP_
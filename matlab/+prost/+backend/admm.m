@@ -11,6 +11,11 @@ function [backend] = admm(varargin)
     addOptional(p, 'cg_tol_pow', 1.3);
     addOptional(p, 'cg_tol_min', 1e-5);
     addOptional(p, 'cg_tol_max', 1e-8);
+    addOptional(p, 'cg_fused', false);
+    addOptional(p, 'cg_jacobi', false);
+    addOptional(p, 'cg_check_iter', 5);
+    addOptional(p, 'projection', 'cgls');
+    addOptional(p, 'direct_max_nnz', 20000000);
    
     p.parse(varargin{:});
    
@@ -0,0 +1,17 @@
+function [backend] = host(varargin)
+% HOST  PDHG with constant steps on the CPU, multithreaded with OpenMP.
+%   For small problems and machines without a GPU. All blocks have to
+%   store their entries and all proxs have to support host evaluation.
+
+    p = inputParser;
+    addOptional(p, 'tau0', 1);
+    addOptional(p, 'sigma0', 1);
+    addOptional(p, 'residual_iter', 1);
+    addOptional(p, 'scale_steps_operator', true);
+    addOptional(p, 'normest_tol', 1e-6);
+   
+    p.parse(varargin{:});
+   
+    backend = { 'host', p.Results };
+
+end
@@ -5,13 +5,23 @@ function [backend] = pdhg(varargin)
     addOptional(p, 'sigma0', 1);
     addOptional(p, 'residual_iter', 1);
     addOptional(p, 'scale_steps_operator', true);
+    addOptional(p, 'normest_tol', 1e-6);
     addOptional(p, 'alg2_gamma', 0);
     addOptional(p, 'arg_alpha0', 0.5);
     addOptional(p, 'arg_nu', 0.95);
     addOptional(p, 'arg_delta', 1.5);
     addOptional(p, 'arb_delta', 1.05);
     addOptional(p, 'arb_tau', 0.8);
+    addOptional(p, 'restart_iter', 64);
+    addOptional(p, 'restart_beta_sufficient', 0.2);
+    addOptional(p, 'restart_beta_necessary', 0.8);
+    addOptional(p, 'restart_beta_artificial', 0.36);
+    addOptional(p, 'primal_weight_smoothing', 0.5);
     addOptional(p, 'stepsize', 'boyd');
+    addOptional(p, 'fuse_prox_arg', true);
+    addOptional(p, 'fuse_epilogue', true);
+    addOptional(p, 'low_memory', false);
+    addOptional(p, 'persistent_kernel', false);
    
     p.parse(varargin{:});
    
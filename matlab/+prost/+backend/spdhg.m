@@ -0,0 +1,16 @@
+function [backend] = spdhg(varargin)
+
+    p = inputParser;
+    addOptional(p, 'tau0', 1);
+    addOptional(p, 'sigma0', 1);
+    addOptional(p, 'residual_iter', 10);
+    addOptional(p, 'scale_steps_operator', true);
+    addOptional(p, 'normest_tol', 1e-6);
+    addOptional(p, 'block_fraction', 0.1);
+    addOptional(p, 'seed', 0);
+   
+    p.parse(varargin{:});
+   
+    backend = { 'spdhg', p.Results };
+
+end
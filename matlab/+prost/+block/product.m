@@ -0,0 +1,37 @@
+function [func] = product(varargin)
+% PRODUCT func = product(A1, A2, ..., An)
+%
+% Implements the product A1 * A2 * ... * An of blocks without forming
+% it, the factors are applied one after another. For example
+%
+%   product(sparse(B), gradient2d(nx, ny, 1))
+%
+% applies the sparse matrix B to the gradient. Factors whose size is
+% given by the variables (identity, zero) get the size of the
+% product.
+
+    factors = varargin;
+    func = @(row, col, nrows, ncols) product_block(row, col, nrows, ...
+                                                   ncols, factors);
+end
+
+function [block] = product_block(row, col, nrows, ncols, factors)
+    n = numel(factors);
+    data = cell(1, n);
+    
+    for i=1:n
+        factor = factors{i}(0, 0, nrows, ncols);
+        data{i} = factor{1};
+        sz = factor{2};
+        
+        if i == 1
+            prod_nrows = sz{1};
+        end
+        
+        if i == n
+            prod_ncols = sz{2};
+        end
+    end
+    
+    block = { { 'product', row, col, data }, { prod_nrows, prod_ncols } };
+end
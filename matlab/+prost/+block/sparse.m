@@ -1,10 +1,19 @@
-function [func] = sparse(K)    
-% SPARSE  func = sparse(K)
+function [func] = sparse(K, transpose_spmv)    
+% SPARSE  func = sparse(K, transpose_spmv)
 %
 % Implements a linear operator built of a sparse matrix K.
+%
+% If transpose_spmv is true (default false), the adjoint is computed
+% by a transposed sparse matrix-vector product and the transposed
+% copy of K is not stored. The host arrays are freed once K is on the
+% GPU. This halves the memory at the cost of a usually slower adjoint.
+    
+    if nargin < 2
+        transpose_spmv = false;
+    end
     
     sz = { size(K, 1), size(K, 2) };
-    data = { K };
+    data = { K, transpose_spmv };
     
     func = @(row, col, nrows, ncols) { { 'sparse', row, col, data }, sz };
 end
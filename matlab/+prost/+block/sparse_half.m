@@ -0,0 +1,14 @@
+function [func] = sparse_half(K)    
+% SPARSE_HALF  func = sparse_half(K)
+%
+% Implements a linear operator built of a sparse matrix K, whose values
+% are stored in half precision on the GPU. Halves the memory of the
+% values at the cost of about 3 significant digits. The nonzero values
+% have to lie within [6.1e-5, 65504] in absolute value, otherwise an
+% error is raised.
+    
+    sz = { size(K, 1), size(K, 2) };
+    data = { K };
+    
+    func = @(row, col, nrows, ncols) { { 'sparse_half', row, col, data }, sz };
+end
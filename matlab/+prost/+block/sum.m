@@ -0,0 +1,29 @@
+function [func] = sum(terms, coeffs)
+% SUM func = sum(terms, coeffs)
+%
+% Implements the weighted sum coeffs(1) * terms{1} + ... + coeffs(n) *
+% terms{n} of blocks of the same size without forming it. coeffs
+% defaults to ones. For a single term the block is scaled, e.g.
+%
+%   sum({ gradient2d(nx, ny, 1) }, 0.5)
+    
+    if nargin < 2
+        coeffs = ones(numel(terms), 1);
+    end
+    
+    func = @(row, col, nrows, ncols) sum_block(row, col, nrows, ncols, ...
+                                               terms, coeffs);
+end
+
+function [block] = sum_block(row, col, nrows, ncols, terms, coeffs)
+    n = numel(terms);
+    data = cell(1, n);
+    
+    for i=1:n
+        term = terms{i}(0, 0, nrows, ncols);
+        data{i} = term{1};
+        sz = term{2};
+    end
+    
+    block = { { 'sum', row, col, { data, coeffs } }, sz };
+end
@@ -1,11 +1,28 @@
-function [func] = ind_range(A, AA)
-% SUM_IND_RANGE  func = ind_range(A, AA)
+function [func] = ind_range(A, AA, transpose_spmv, factorization)
+% SUM_IND_RANGE  func = ind_range(A, AA, transpose_spmv, factorization)
 %
 %   Computes projection onto the range of A
 %   x = A (A'*A)^{-1} A' * y
 %
 % A must be a sparse matrix and AA = A' * A must be dense!
 %
-    func = @(idx, count) { 'ind_range', idx, count, false, { A, AA } };
+% If transpose_spmv is true (default false), A' * y is computed by a
+% transposed sparse matrix-vector product and only a single copy of A
+% is stored on the GPU.
+%
+% factorization is 'dense' (default) for a Cholesky factorization of
+% AA, or 'sparse' for a sparse Cholesky factorization of A' * A which is
+% computed from A, AA may then be empty. Factorizations are cached, so
+% solving again with the same A does not factorize again.
+%
+    if nargin < 3
+        transpose_spmv = false;
+    end
+
+    if nargin < 4
+        factorization = 'dense';
+    end
+
+    func = @(idx, count) { 'ind_range', idx, count, false, { A, AA, transpose_spmv, factorization } };
 
 end
@@ -0,0 +1,23 @@
+function [func] = sum_jit(dim, interleaved, operation, coeffs)
+% SUM_JIT  func = sum_jit(dim, interleaved, operation, coeffs)
+%
+%   Same as the other separable sums of elementwise operations, but
+%   the kernel is compiled at runtime for exactly this operation,
+%   dimension and set of constant coefficients. Requires prost to be
+%   built with PROST_WITH_NVRTC.
+%
+%   operation is a C++ type in terms of the scalar type T and coeffs
+%   a cell array with one entry per coefficient of the operation,
+%   either a scalar or a vector with one value per element. The 
+%   interleaved keyword is handled as in sum_norm2.
+%
+%   Example:
+%    - prost.function.sum_jit(2, true, 'ElemOperationNorm2<T, Function1DAbs<T> >', 
+%        { 1, 0, lmb, 0, 0, 0, 0 }): \sum_i lmb ||g_i||_2 
+
+    if nargin < 4
+        coeffs = {};
+    end
+   
+    func = @(idx, count) { 'elem_operation:jit', idx, count, false, { count / dim, dim, interleaved, operation, coeffs } };
+end
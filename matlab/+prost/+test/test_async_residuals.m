@@ -0,0 +1,62 @@
+function [passed] = test_async_residuals()
+
+    rng(1);
+    passed = true;
+
+    % needs many residual checks to converge. the asynchronous check sees
+    % the residuals at most one check later than the synchronous one.
+    n = 1000;
+    residual_iter = 10;
+    f = randn(n, 1);
+    D = spdiags([-ones(n, 1), ones(n, 1)], [0, 1], n - 1, n);
+
+    u = prost.variable(n);
+    g = prost.variable(n - 1);
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, 0.5, 0, 0));
+    prob.add_constraint(u, g, prost.block.sparse(D));
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', ...
+                                 'residual_iter', residual_iter);
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'history_size', 20000, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    sync = prost.solve(prob, backend, opts);
+
+    opts.async_convergence_check = true;
+    async = prost.solve(prob, backend, opts);
+
+    iters_sync = max(sync.history.iteration);
+    iters_async = max(async.history.iteration);
+
+    if ~strcmp(sync.result, 'Converged.') || iters_sync <= residual_iter
+        fprintf('failed! Reason: the problem should converge after some checks, took %d iterations.\n', ...
+                iters_sync);
+        passed = false;
+        return;
+    end
+
+    if ~strcmp(async.result, 'Converged.') || ...
+            iters_async < iters_sync || iters_async > iters_sync + residual_iter
+        fprintf('failed! Reason: asynchronous check ran %d iterations, synchronous one %d.\n', ...
+                iters_async, iters_sync);
+        passed = false;
+        return;
+    end
+
+    diff = norm(async.x - sync.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: solutions of both checks differ: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+end
@@ -0,0 +1,59 @@
+function [passed] = test_batch()
+
+    rng(1);
+    passed = true;
+
+    % the instances differ in their data and converge after a different
+    % number of iterations, the ones still running at the end are read
+    % from the final iterate
+    n = 200;
+    num_instances = 4;
+    offsets = [-1; 0; 1];
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', 'residual_iter', 10);
+
+    probs = cell(num_instances, 1);
+    factors = cell(num_instances, 1);
+    f = cell(num_instances, 1);
+    for i=1:num_instances
+        factors{i} = [-1; 1 + i; -1];
+        f{i} = randn(n, 1);
+        probs{i} = batch_problem(n, factors{i}, offsets, f{i});
+    end
+
+    result = prost.batch(probs, backend, opts);
+
+    for i=1:num_instances
+        ref = prost.solve(batch_problem(n, factors{i}, offsets, f{i}), ...
+                          backend, opts);
+
+        diff = norm(result(i).x - ref.x, Inf);
+        if diff > 1e-3
+            fprintf('failed! Reason: instance %d differs from its own solve: %f\n', ...
+                    i, diff);
+            passed = false;
+            return;
+        end
+    end
+
+end
+
+function [prob] = batch_problem(n, factors, offsets, f)
+
+    u = prost.variable(n);
+    g = prost.variable(n);
+
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+    prob.add_constraint(u, g, prost.block.diags(n, n, factors, offsets));
+
+end
@@ -0,0 +1,71 @@
+function [passed] = test_gap_stop()
+
+    rng(1);
+    passed = true;
+
+    % 1/2 |u - f|^2 + lmb |D u|_1, the residual tolerances are out of
+    % reach so only the gap can stop the solver
+    n = 1000;
+    lmb = 0.5;
+    f = randn(n, 1);
+    D = spdiags([-ones(n, 1), ones(n, 1)], [0, 1], n - 1, n);
+    energy = @(u) 0.5 * sum((u - f).^2) + lmb * sum(abs(D * u));
+
+    u = prost.variable(n);
+    g = prost.variable(n - 1);
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, lmb, 0, 0));
+    prob.add_constraint(u, g, prost.block.sparse(D));
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', ...
+                                 'residual_iter', 10);
+
+    tol_gap = 1e-4;
+    opts = prost.options('max_iters', 50000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_gap', tol_gap, ...
+                         'tol_rel_primal', 0, ...
+                         'tol_rel_dual', 0, ...
+                         'tol_abs_primal', 0, ...
+                         'tol_abs_dual', 0);
+
+    result = prost.solve(prob, backend, opts);
+
+    if ~strcmp(result.result, 'Converged.')
+        fprintf('failed! Reason: the gap did not stop the solver: %s\n', result.result);
+        passed = false;
+        return;
+    end
+
+    if ~(result.gap >= 0 && result.gap < tol_gap * n)
+        fprintf('failed! Reason: reported gap %f is not in [0, %f).\n', ...
+                result.gap, tol_gap * n);
+        passed = false;
+        return;
+    end
+
+    % the gap bounds the distance to the optimal energy
+    opts.tol_gap = 0;
+    opts.tol_rel_primal = 1e-8;
+    opts.tol_rel_dual = 1e-8;
+    opts.tol_abs_primal = 1e-8;
+    opts.tol_abs_dual = 1e-8;
+    ref = prost.solve(prob, backend, opts);
+
+    subopt = energy(result.x) - energy(ref.x);
+    if subopt > result.gap + 1e-3
+        fprintf('failed! Reason: suboptimality %f exceeds the gap %f.\n', ...
+                subopt, result.gap);
+        passed = false;
+        return;
+    end
+
+    if ~isinf(ref.gap)
+        fprintf('failed! Reason: gap reported without tol_gap: %f\n', ref.gap);
+        passed = false;
+        return;
+    end
+
+end
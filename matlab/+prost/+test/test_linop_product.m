@@ -0,0 +1,84 @@
+function [passed] = test_linop_product()
+
+    rng(1);
+    passed = true;
+
+    A1 = sprandn(300, 200, 0.05);
+    A2 = randn(200, 150);
+    A3 = sprandn(150, 120, 0.1);
+
+    cases = { { A1, A2 }, { A2', A1', sprandn(300, 80, 0.1) }, { A1, A2, A3 } };
+
+    for c=1:numel(cases)
+        factors = cases{c};
+        n = numel(factors);
+
+        K = factors{1};
+        blocks = cell(1, n);
+        for i=1:n
+            if i > 1
+                K = K * factors{i};
+            end
+
+            if issparse(factors{i})
+                blocks{i} = prost.block.sparse(factors{i});
+            else
+                blocks{i} = prost.block.dense(factors{i});
+            end
+        end
+        K = full(K);
+
+        block_fun = prost.block.product(blocks{:});
+        make_block_product = block_fun(0, 0, size(K, 1), size(K, 2));
+        linop = { make_block_product{1} };
+
+        x = randn(size(K, 2), 1);
+        y = randn(size(K, 1), 1);
+
+        [fw_cuda, rs_cuda, cs_cuda] = prost.eval_linop(linop, x, false);
+        [ad_cuda, ~, ~] = prost.eval_linop(linop, y, true);
+
+        if norm(fw_cuda - K * x, 'inf') > 1e-3
+            fprintf('failed! Reason: case %d, norm_diff_forward > 1e-3: %f\n', ...
+                    c, norm(fw_cuda - K * x, 'inf'));
+            passed = false;
+            return;
+        end
+
+        if norm(ad_cuda - K' * y, 'inf') > 1e-3
+            fprintf('failed! Reason: case %d, norm_diff_adjoint > 1e-3: %f\n', ...
+                    c, norm(ad_cuda - K' * y, 'inf'));
+            passed = false;
+            return;
+        end
+
+        % rows: sums of the first factor times the maximal row sums of
+        % the others, columns: the same from the last factor.
+        rs_bound = full(sum(abs(factors{1}), 2));
+        cs_bound = full(sum(abs(factors{n}), 1))';
+        for i=2:n
+            rs_bound = rs_bound * max(sum(abs(factors{i}), 2));
+        end
+        for i=1:n-1
+            cs_bound = cs_bound * max(sum(abs(factors{i}), 1));
+        end
+        rs_bound = full(rs_bound);
+        cs_bound = full(cs_bound);
+
+        if norm(rs_cuda - rs_bound, 'inf') > 1e-3 * max(rs_bound) || ...
+           norm(cs_cuda - cs_bound, 'inf') > 1e-3 * max(cs_bound)
+            fprintf('failed! Reason: case %d, row or column sums differ from the bound.\n', c);
+            passed = false;
+            return;
+        end
+
+        % the preconditioners rely on the bounds
+        if any(rs_cuda < sum(abs(K), 2) * (1 - 1e-4)) || ...
+           any(cs_cuda < sum(abs(K), 1)' * (1 - 1e-4))
+            fprintf('failed! Reason: case %d, row or column sums below the sums of A1 * A2.\n', c);
+            passed = false;
+            return;
+        end
+    end
+
+end
@@ -0,0 +1,78 @@
+function [passed] = test_linop_sparse_half()
+
+    rng(1);
+    passed = true;
+    
+    for n_test = 1:10
+        
+        nrows = randi(500);
+        ncols = randi(500);
+
+        % signed values spanning several orders of magnitude, all within
+        % the normal half precision range
+        scale = 10^randi([-2, 3]);
+        K = spfun(@(v) sign(v) .* (0.01 + abs(v)), sprandn(nrows, ncols, 0.01)) * scale;
+
+        block_fun = prost.block.sparse_half(K);
+        make_block_sparse = block_fun(0, 0, size(K, 1), size(K, 2));
+        linop = { make_block_sparse{1} };
+
+        % values are stored in half precision, compare relative errors
+        inp2 = rand(nrows, 1);
+        [y,rowsum,colsum] = prost.eval_linop(linop, inp2, true);
+        y_ml = K'*inp2;
+
+        if norm(y-y_ml) > 1e-2 * max(norm(y_ml), 1)
+            fprintf('failed! Reason: rel_diff_adjoint > 1e-2: %f\n', norm(y-y_ml) / max(norm(y_ml), 1));
+            passed = false;
+            
+            return;
+        end
+        
+        inp = rand(ncols, 1);
+        [x,~,~] = prost.eval_linop(linop, inp, false);
+        x_ml = K*inp;
+
+        if norm(x-x_ml) > 1e-2 * max(norm(x_ml), 1)
+            fprintf('failed! Reason: rel_diff_forward > 1e-2: %f\n', norm(x-x_ml) / max(norm(x_ml), 1));
+            passed = false;
+            
+            return;
+        end
+        
+        % preconditioners are computed from the full precision values
+        rowsum_ml = sum(abs(K), 2);
+        colsum_ml = sum(abs(K), 1)';
+        
+        if norm(rowsum-rowsum_ml) > 1e-3 * max(norm(rowsum_ml), 1)
+            fprintf('failed! Reason: rel_diff_rowsum > 1e-3: %f\n', norm(rowsum-rowsum_ml));
+            passed = false;
+            return;
+        end
+
+        if norm(colsum-colsum_ml) > 1e-3 * max(norm(colsum_ml), 1)
+            fprintf('failed! Reason: rel_diff_colsum > 1e-3: %f\n', norm(colsum-colsum_ml));
+            passed = false;
+            return;
+        end
+    end
+
+    % values which would overflow or be flushed to zero are rejected
+    for bad = [1e5, -7e4, 1e-6]
+        K = speye(10);
+        K(3, 4) = bad;
+
+        block_fun = prost.block.sparse_half(K);
+        make_block_sparse = block_fun(0, 0, size(K, 1), size(K, 2));
+        linop = { make_block_sparse{1} };
+
+        try
+            prost.eval_linop(linop, rand(10, 1), false);
+            fprintf('failed! Reason: value %g outside of the half range was accepted\n', bad);
+            passed = false;
+            return;
+        catch
+        end
+    end
+    
+end
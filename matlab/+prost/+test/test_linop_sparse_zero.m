@@ -3,87 +3,90 @@ function [passed] = test_linop_sparse_zero()
     rng(1);
     passed = true;
     
-    for n_test = 1:10
+    % with and without the single copy of K_mat
+    for transpose_spmv=[false, true]
+        for n_test = 1:10
         
-        K = [];
-        linop = {};
-        idx = 1;
-        row = 0;
-        nrows = randi(500);
-        ncols = randi(500);
+            K = [];
+            linop = {};
+            idx = 1;
+            row = 0;
+            nrows = randi(500);
+            ncols = randi(500);
 
-        By = randi(15);
-        Bx = randi(15);
+            By = randi(15);
+            Bx = randi(15);
 
-        for i=1:By
+            for i=1:By
             
-            K_row = [];
-            col = 0;
-            for j=1:Bx
+                K_row = [];
+                col = 0;
+                for j=1:Bx
                 
-                if randi([1,2]) == 1
-                    K_mat = sparse(nrows,ncols);
+                    if randi([1,2]) == 1
+                        K_mat = sparse(nrows,ncols);
                 
-                    block_fun = prost.block.zero();
-                    make_block_zero = block_fun(row, col, nrows, ncols);
+                        block_fun = prost.block.zero();
+                        make_block_zero = block_fun(row, col, nrows, ncols);
 
-                    linop{idx, 1} = make_block_zero{1};
-                else
-                    K_mat = sprand(nrows,ncols,0.01);
+                        linop{idx, 1} = make_block_zero{1};
+                    else
+                        K_mat = sprand(nrows,ncols,0.01);
                     
-                    block_fun = prost.block.sparse(K_mat);
-                    make_block_sparse = block_fun(row, col, size(K_mat, 1), ...
-                                                size(K_mat, 2));
+                        block_fun = prost.block.sparse(K_mat, transpose_spmv);
+                        make_block_sparse = block_fun(row, col, size(K_mat, 1), ...
+                                                    size(K_mat, 2));
                     
-                    linop{idx, 1} = make_block_sparse{1};
-                end
+                        linop{idx, 1} = make_block_sparse{1};
+                    end
                 
-                K_row = cat(2, K_row, K_mat);
-                idx = idx + 1;
-                col = col + ncols;
-            end
+                    K_row = cat(2, K_row, K_mat);
+                    idx = idx + 1;
+                    col = col + ncols;
+                end
             
-            row = row + nrows;
-            K = cat(1, K, K_row);
-        end
+                row = row + nrows;
+                K = cat(1, K, K_row);
+            end
         
         
         
-        inp2 = rand(nrows*By, 1);
-        [y,rowsum,colsum] = prost.eval_linop(linop, inp2, true);
-        y_ml = K'*inp2;
+            inp2 = rand(nrows*By, 1);
+            [y,rowsum,colsum] = prost.eval_linop(linop, inp2, true);
+            y_ml = K'*inp2;
 
-        if norm(y-y_ml) > 1e-3
-            fprintf('failed! Reason: norm_diff_adjoint > 1e-3: %f\n', norm(y-y_ml));
-            passed = false;
+            if norm(y-y_ml) > 1e-3
+                fprintf('failed! Reason: norm_diff_adjoint > 1e-3 (transpose_spmv=%d): %f\n', transpose_spmv, norm(y-y_ml));
+                passed = false;
             
-            return;
-        end
+                return;
+            end
         
-        inp = rand(ncols*Bx, 1);
-        [x,~,~] = prost.eval_linop(linop, inp, false);
-        x_ml = K*inp;
+            inp = rand(ncols*Bx, 1);
+            [x,~,~] = prost.eval_linop(linop, inp, false);
+            x_ml = K*inp;
 
-        if norm(x-x_ml) > 1e-3
-            fprintf('failed! Reason: norm_diff_forward > 1e-3: %f\n', norm(x-x_ml));
-            passed = false;
+            if norm(x-x_ml) > 1e-3
+                fprintf('failed! Reason: norm_diff_forward > 1e-3 (transpose_spmv=%d): %f\n', transpose_spmv, norm(x-x_ml));
+                passed = false;
             
-            return;
-        end
+                return;
+            end
         
-        rowsum_ml = sum(abs(K), 2);
-        colsum_ml = sum(abs(K), 1)';
+            rowsum_ml = sum(abs(K), 2);
+            colsum_ml = sum(abs(K), 1)';
         
-        if norm(rowsum-rowsum_ml) > 1e-3
-            fprintf('failed! Reason: norm_diff_rowsum > 1e-3: %f\n', norm(rowsum-rowsum_ml));
-            passed = false;
-            return;
-        end
+            if norm(rowsum-rowsum_ml) > 1e-3
+                fprintf('failed! Reason: norm_diff_rowsum > 1e-3 (transpose_spmv=%d): %f\n', transpose_spmv, norm(rowsum-rowsum_ml));
+                passed = false;
+                return;
+            end
 
-        if norm(colsum-colsum_ml) > 1e-3
-            fprintf('failed! Reason: norm_diff_colsum > 1e-3: %f\n', norm(colsum-colsum_ml));
-            passed = false;
-            return;
+            if norm(colsum-colsum_ml) > 1e-3
+                fprintf('failed! Reason: norm_diff_colsum > 1e-3 (transpose_spmv=%d): %f\n', transpose_spmv, norm(colsum-colsum_ml));
+                passed = false;
+                return;
+            end
         end
     end
     
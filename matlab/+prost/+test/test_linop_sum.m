@@ -0,0 +1,74 @@
+function [passed] = test_linop_sum()
+
+    rng(1);
+    passed = true;
+
+    m = 400;
+    n = 300;
+    A1 = sprandn(m, n, 0.05);
+    A2 = randn(m, n);
+
+    % terms with coefficient one are added directly, the others go
+    % through the scratch buffer, zero terms are skipped
+    coeffs = { [1; 1], [0.5; -2], [-3; 0], 1.5 };
+
+    for c=1:numel(coeffs)
+        cf = coeffs{c};
+
+        if numel(cf) == 1
+            terms = { prost.block.sparse(A1) };
+            K = cf * A1;
+        else
+            terms = { prost.block.sparse(A1), prost.block.dense(A2) };
+            K = cf(1) * A1 + cf(2) * A2;
+        end
+        K = full(K);
+
+        block_fun = prost.block.sum(terms, cf);
+        make_block_sum = block_fun(0, 0, m, n);
+        linop = { make_block_sum{1} };
+
+        x = randn(n, 1);
+        y = randn(m, 1);
+
+        [fw_cuda, rs_cuda, cs_cuda] = prost.eval_linop(linop, x, false);
+        [ad_cuda, ~, ~] = prost.eval_linop(linop, y, true);
+
+        if norm(fw_cuda - K * x, 'inf') > 1e-3
+            fprintf('failed! Reason: case %d, norm_diff_forward > 1e-3: %f\n', ...
+                    c, norm(fw_cuda - K * x, 'inf'));
+            passed = false;
+            return;
+        end
+
+        if norm(ad_cuda - K' * y, 'inf') > 1e-3
+            fprintf('failed! Reason: case %d, norm_diff_adjoint > 1e-3: %f\n', ...
+                    c, norm(ad_cuda - K' * y, 'inf'));
+            passed = false;
+            return;
+        end
+
+        % for alpha = 1 the bound is |c_1| |A_1| + |c_2| |A_2|
+        rs_bound = abs(cf(1)) * full(sum(abs(A1), 2));
+        cs_bound = abs(cf(1)) * full(sum(abs(A1), 1))';
+        if numel(cf) > 1
+            rs_bound = rs_bound + abs(cf(2)) * sum(abs(A2), 2);
+            cs_bound = cs_bound + abs(cf(2)) * sum(abs(A2), 1)';
+        end
+
+        if norm(rs_cuda - rs_bound, 'inf') > 1e-3 || ...
+           norm(cs_cuda - cs_bound, 'inf') > 1e-3
+            fprintf('failed! Reason: case %d, row or column sums differ from the bound.\n', c);
+            passed = false;
+            return;
+        end
+
+        if any(rs_cuda < sum(abs(K), 2) - 1e-3) || ...
+           any(cs_cuda < sum(abs(K), 1)' - 1e-3)
+            fprintf('failed! Reason: case %d, row or column sums below the sums of the sum.\n', c);
+            passed = false;
+            return;
+        end
+    end
+
+end
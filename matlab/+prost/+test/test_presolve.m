@@ -0,0 +1,92 @@
+function [passed] = test_presolve()
+
+    rng(1);
+    passed = true;
+
+    % u is free, v is fixed by ind_eq0, w has no entries in K and h has
+    % no entries in K either. the presolve substitutes v, minimizes the
+    % functions of w and h on the host and expands the solution of the
+    % remaining problem in u and g.
+    n = 200;
+    nv = 20;
+    nw = 10;
+    nh = 15;
+
+    A = sprandn(n, n, 0.02) + speye(n);
+    B = sprandn(n, nv, 0.1);
+    f = randn(n, 1);
+    v_val = randn(nv, 1);
+    w_val = randn(nw, 1);
+    h_val = randn(nh, 1);
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', ...
+                                 'residual_iter', 10);
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-7, ...
+                         'tol_rel_dual', 1e-7, ...
+                         'tol_abs_primal', 1e-7, ...
+                         'tol_abs_dual', 1e-7);
+
+    ref = prost.solve(presolve_problem(A, B, f, v_val, w_val, h_val), ...
+                      backend, opts);
+
+    opts.presolve = true;
+    result = prost.solve(presolve_problem(A, B, f, v_val, w_val, h_val), ...
+                         backend, opts);
+
+    v_idx = n + (1:nv);
+    w_idx = n + nv + (1:nw);
+    h_idx = n + (1:nh);
+
+    if norm(result.x(v_idx) - v_val, Inf) > 1e-6
+        fprintf('failed! Reason: fixed columns do not keep their value.\n');
+        passed = false;
+        return;
+    end
+
+    if norm(result.x(w_idx) - w_val, Inf) > 1e-4
+        fprintf('failed! Reason: empty columns are not minimized.\n');
+        passed = false;
+        return;
+    end
+
+    if norm(result.z(h_idx), Inf) > 1e-6
+        fprintf('failed! Reason: empty rows do not have z = 0.\n');
+        passed = false;
+        return;
+    end
+
+    names = { 'x', 'y', 'z', 'w' };
+    for i=1:numel(names)
+        diff = norm(result.(names{i}) - ref.(names{i}), Inf);
+        if diff > 1e-3
+            fprintf('failed! Reason: expanded %s differs from the solve without presolve: %f\n', ...
+                    names{i}, diff);
+            passed = false;
+            return;
+        end
+    end
+
+end
+
+function [prob] = presolve_problem(A, B, f, v_val, w_val, h_val)
+
+    u = prost.variable(size(A, 2));
+    v = prost.variable(numel(v_val));
+    w = prost.variable(numel(w_val));
+    g = prost.variable(size(A, 1));
+    h = prost.variable(numel(h_val));
+
+    prob = prost.min_problem( {u, v, w}, {g, h} );
+    prob.add_function(u, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+    prob.add_function(v, prost.function.sum_1d('ind_eq0', 1, v_val, 1, 0, 0));
+    prob.add_function(w, prost.function.sum_1d('square', 1, w_val, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(h, prost.function.sum_1d('square', 1, h_val, 1, 0, 0));
+    prob.add_constraint(u, g, prost.block.sparse(A));
+    prob.add_constraint(v, g, prost.block.sparse(B));
+
+end
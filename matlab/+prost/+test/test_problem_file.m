@@ -0,0 +1,107 @@
+function [passed] = test_problem_file()
+
+    rng(1);
+    passed = true;
+
+    m = 150;
+    n = 100;
+    A = sprandn(m, n, 0.05) + [speye(n); sparse(m - n, n)];
+    f = randn(m, 1);
+
+    u = prost.variable(n);
+    g = prost.variable(m);
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_constraint(u, g, prost.block.sparse(A));
+
+    backend = prost.backend.pdhg('stepsize', 'alg1');
+    opts = prost.options('max_iters', 500, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false);
+
+    filename = [tempname, '.prost'];
+    cleanup = onCleanup(@() delete_if_exists(filename));
+
+    % round trip: the loader has to reproduce the solve of the MEX input
+    prost.write_problem(filename, prob, backend, opts);
+    result = prost.solve_file(filename);
+    ref = prost.solve(prob, backend, opts);
+
+    names = { 'x', 'y', 'z', 'w' };
+    for i=1:numel(names)
+        diff = norm(result.(names{i}) - ref.(names{i}), Inf);
+        if diff > 1e-4
+            fprintf('failed! Reason: %s of the loaded problem differs: %f\n', ...
+                    names{i}, diff);
+            passed = false;
+            return;
+        end
+    end
+
+    fid = fopen(filename, 'r');
+    bytes = fread(fid, Inf, '*uint8');
+    fclose(fid);
+
+    % CSR of A as written by prost.write_problem
+    [ind, row] = find(A.');
+    ptr = int32([0; cumsum(accumarray(row(:), 1, [m 1]))]);
+    ind = int32(ind(:) - 1);
+
+    % truncated file
+    if ~load_fails(filename, bytes(1:end-100))
+        fprintf('failed! Reason: truncated file was loaded.\n');
+        passed = false;
+        return;
+    end
+
+    % last pointer beyond nnz
+    corrupt = patch_array(bytes, ptr, numel(ptr), int32(nnz(A) + 1));
+    if isempty(corrupt) || ~load_fails(filename, corrupt)
+        fprintf('failed! Reason: pointers not ending at nnz were accepted.\n');
+        passed = false;
+        return;
+    end
+
+    % column index out of range
+    corrupt = patch_array(bytes, ind, 1, int32(n));
+    if isempty(corrupt) || ~load_fails(filename, corrupt)
+        fprintf('failed! Reason: index out of range was accepted.\n');
+        passed = false;
+        return;
+    end
+
+end
+
+% Replaces element k of the int32 array arr in the file bytes by value,
+% returns [] if arr is not found exactly once.
+function [bytes] = patch_array(bytes, arr, k, value)
+    pos = strfind(char(bytes'), char(typecast(arr(:)', 'uint8')));
+
+    if numel(pos) ~= 1
+        bytes = [];
+        return;
+    end
+
+    at = pos + 4 * (k - 1);
+    bytes(at:at+3) = typecast(value, 'uint8');
+end
+
+function [failed] = load_fails(filename, bytes)
+    fid = fopen(filename, 'w');
+    fwrite(fid, bytes, 'uint8');
+    fclose(fid);
+
+    failed = false;
+    try
+        prost.solve_file(filename);
+    catch
+        failed = true;
+    end
+end
+
+function delete_if_exists(filename)
+    if exist(filename, 'file')
+        delete(filename);
+    end
+end
@@ -0,0 +1,57 @@
+function [passed] = test_prox_batch()
+
+    rng(1);
+    passed = true;
+
+    % members of a run share the operation but differ in dimension,
+    % layout and coefficients and are separated by zero fillers. the
+    % norm2 run and the 1d run end up in one launch each.
+    proxs = { prost.function.sum_norm2(2, false, 'abs', 1, 0.5, 1, 0, 0), ...
+              prost.function.zero(), ...
+              prost.function.sum_norm2(3, true, 'abs', 2, -1, 0.5, 0.1, 0), ...
+              prost.function.sum_norm2(5, false, 'abs', 0.5, 1, 2, 0, 0.2), ...
+              prost.function.zero(), ...
+              prost.function.sum_norm2(1, false, 'abs', 1, 0.3, 1, 0, 0), ...
+              prost.function.sum_1d('square', 1, 0.5, 1, 0, 0), ...
+              prost.function.sum_1d('square', 2, -0.5, 0.5, 0.1, 0), ...
+              prost.function.zero(), ...
+              prost.function.sum_1d('square', 0.5, 1, 2, 0, 0.3) };
+    sizes = [ 200, 17, 300, 500, 1, 90, 128, 333, 40, 64 ];
+    is_zero = logical([ 0, 1, 0, 0, 1, 0, 0, 0, 1, 0 ]);
+
+    n = sum(sizes);
+    arg = randn(n, 1);
+    Tau = rand(n, 1) + 0.5;
+
+    for tau=[0.1, 1, 10]
+        [res_single, num_single] = prost.eval_prox_list(proxs, sizes, arg, tau, Tau, false);
+        [res_batch, num_batch] = prost.eval_prox_list(proxs, sizes, arg, tau, Tau, true);
+
+        if num_batch ~= 2
+            fprintf('failed! Reason: expected 2 batched proxs, got %d of %d.\n', ...
+                    num_batch, num_single);
+            passed = false;
+            return;
+        end
+
+        diff = norm(res_batch - res_single, Inf);
+        if diff > 1e-5
+            fprintf('failed! Reason: batched evaluation differs (tau=%f): %f\n', ...
+                    tau, diff);
+            passed = false;
+            return;
+        end
+
+        % the fillers keep their argument
+        offsets = cumsum([0, sizes]);
+        for k=find(is_zero)
+            idx = offsets(k) + (1:sizes(k));
+            if norm(res_batch(idx) - arg(idx), Inf) > 1e-6
+                fprintf('failed! Reason: zero prox %d changed its argument.\n', k);
+                passed = false;
+                return;
+            end
+        end
+    end
+
+end
@@ -0,0 +1,104 @@
+function [passed] = test_prox_gap()
+
+    rng(1);
+    passed = true;
+
+    % h(x) = c f(a x - b) + d x + e/2 x^2, the conjugate is compared to
+    % the supremum of y z - h(z) over a grid
+    z = linspace(-40, 40, 400001);
+    n = 50;
+
+    funs = { 'abs', 'square', 'huber', 'max_pos0', 'ind_box01', 'ind_geq0' };
+    f1d = { @(t, al) abs(t), ...
+            @(t, al) t.^2 / 2, ...
+            @(t, al) (abs(t) <= al) .* t.^2 / (2 * al) + (abs(t) > al) .* (abs(t) - al / 2), ...
+            @(t, al) max(0, t), ...
+            @(t, al) indicator(t >= 0 & t <= 1), ...
+            @(t, al) indicator(t >= 0) };
+
+    for k=1:numel(funs)
+        % with e > 0 the conjugate is finite everywhere, it is attained at
+        % the prox
+        a = 0.5 + rand();
+        b = randn() * 0.5;
+        c = 0.5 + rand();
+        d = randn() * 0.5;
+        e = 0.5 + rand();
+        al = 0.5;
+
+        h = @(t) c * f1d{k}(a * t - b, al) + d * t + e / 2 * t.^2;
+
+        % x inside the domain of h
+        x = b / a + rand(n, 1) / a;
+        y = randn(n, 1) * 3;
+
+        gap = prost.eval_prox_gap( ...
+            prost.function.sum_1d(funs{k}, a, b, c, d, e, al, 0), x, y);
+
+        hz = h(z);
+        hstar = max(y * z - hz, [], 2);
+        gap_ml = h(x) + hstar - x .* y;
+
+        diff = norm(gap - gap_ml, Inf);
+        if diff > 1e-3 * max(1, norm(gap_ml, Inf))
+            fprintf('failed! Reason: gap of %s differs from the supremum: %f\n', ...
+                    funs{k}, diff);
+            passed = false;
+            return;
+        end
+
+        if any(gap < -1e-4)
+            fprintf('failed! Reason: negative gap of %s.\n', funs{k});
+            passed = false;
+            return;
+        end
+    end
+
+    % without the quadratic term the conjugate is c f^*((y - d) / (ac))
+    % + b (y - d) / a, y inside its domain for abs
+    a = 2; b = 0.3; c = 0.7; d = -0.2;
+    h = @(t) c * abs(a * t - b) + d * t;
+    x = randn(n, 1);
+    y = d + (2 * rand(n, 1) - 1) * 0.9 * a * c;
+
+    gap = prost.eval_prox_gap(prost.function.sum_1d('abs', a, b, c, d, 0), x, y);
+    gap_ml = h(x) + max(y * z - h(z), [], 2) - x .* y;
+
+    if norm(gap - gap_ml, Inf) > 1e-3
+        fprintf('failed! Reason: gap of abs without quadratic term differs: %f\n', ...
+                norm(gap - gap_ml, Inf));
+        passed = false;
+        return;
+    end
+
+    % h(x) = phi(|x|) on groups of 3, the supremum over z reduces to the
+    % one of t |y| - phi(t) over t >= 0
+    dim = 3;
+    a = 1.5; b = 0.2; c = 0.8; d = 0.1; e = 0.6;
+    phi = @(t) c * f1d{3}(a * t - b, 0.5) + d * t + e / 2 * t.^2;
+    x = randn(n * dim, 1);
+    y = randn(n * dim, 1) * 2;
+
+    gap = prost.eval_prox_gap( ...
+        prost.function.sum_norm2(dim, false, 'huber', a, b, c, d, e, 0.5, 0), x, y);
+
+    X = reshape(x, n, dim);
+    Y = reshape(y, n, dim);
+    t = z(z >= 0);
+    nx = sqrt(sum(X.^2, 2));
+    ny = sqrt(sum(Y.^2, 2));
+    gap_ml = phi(nx) + max(ny * t - phi(t), [], 2) - sum(X .* Y, 2);
+
+    if abs(sum(gap) - sum(gap_ml)) > 1e-3 * n
+        fprintf('failed! Reason: gap of norm2 differs from the supremum: %f\n', ...
+                abs(sum(gap) - sum(gap_ml)));
+        passed = false;
+        return;
+    end
+
+end
+
+function [v] = indicator(feasible)
+    v = zeros(size(feasible));
+    v(~feasible) = Inf;
+end
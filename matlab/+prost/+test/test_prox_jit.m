@@ -0,0 +1,41 @@
+function [passed] = test_prox_jit()
+
+    rng(1);
+    passed = true;
+
+    % runtime compilation is optional, nothing to compare without it
+    if ~prost.has_nvrtc()
+        fprintf(' skipped, built without NVRTC.');
+        return;
+    end
+
+    N = 1000;
+    d = 7;
+
+    P = -2 + 4 * rand(N * d, 1);
+    tau = 1;
+    Tau = 0.5 + rand(N * d, 1);
+
+    % runtime compiled operations against their static instantiations,
+    % with per-element and constant coefficients
+    a = 1 + rand(N, 1);
+    coeffs = { a, 0, 1, 0.1, 0.5, 0.2, 0 };
+
+    jit = { prost.function.sum_jit(d, false, 'ElemOperationNorm2<T, Function1DHuber<T> >', coeffs), ...
+            prost.function.sum_jit(d, false, 'ElemOperationIndSimplex<T>') };
+    ref = { prost.function.sum_norm2(d, false, 'huber', coeffs{:}), ...
+            prost.function.sum_ind_simplex(d, false) };
+
+    for i=1:numel(jit)
+        Q = prost.eval_prox(jit{i}, P, tau, Tau);
+        Q2 = prost.eval_prox(ref{i}, P, tau, Tau);
+
+        if norm(Q - Q2, Inf) > 1e-5
+            fprintf('failed! Reason: JIT prox %d differs from the static one: %f\n', ...
+                    i, norm(Q - Q2, Inf));
+            passed = false;
+            return;
+        end
+    end
+
+end
@@ -0,0 +1,33 @@
+function [passed] = test_prox_sum_ind_soc()
+
+    % small cones are handled by one thread, medium ones by a warp and
+    % large ones by a thread block
+    for d=[4, 64, 4096]
+        N = 50;
+        tau = 1;
+        Tau = ones(N * d, 1);
+        P = randn(N, d);
+
+        Q = prost.eval_prox( prost.function.sum_ind_soc(d, false, 1), P(:), tau, Tau);
+        Q = reshape(Q, N, d);
+
+        x0 = P(:, 1:d-1);
+        y0 = P(:, d);
+        nx0 = sqrt(sum(x0.^2, 2));
+
+        fac = (y0 + nx0) ./ (2 * nx0);
+        fac(nx0 <= y0) = 1;
+        fac(nx0 <= -y0) = 0;
+
+        Q2 = [x0 .* repmat(fac, 1, d-1), fac .* nx0];
+        Q2(nx0 <= y0, d) = y0(nx0 <= y0);
+
+        diff = Q - Q2;
+        if norm(diff(:), Inf) > 1e-4
+            passed = false;
+            return;
+        end
+    end
+
+    passed = true;
+end
@@ -1,19 +1,21 @@
 function [passed] = test_prox_sum_ind_sum()
 
-    N = 21;
-    tau = 1;
-    Tau = ones(N, 1);
-    d = 3;
-    y = randn(N, 1);
+    % small dimensions are handled by one thread, large ones by a warp
+    for d=[3, 64]
+        N = 7 * d;
+        tau = 1;
+        Tau = ones(N, 1);
+        y = randn(N, 1);
 
-    [x, time] = prost.eval_prox( prost.function.sum_ind_sum(d, false), y, tau, Tau);
-    x = reshape(x, [N/d, d]);
+        [x, time] = prost.eval_prox( prost.function.sum_ind_sum(d, false), y, tau, Tau);
+        x = reshape(x, [N/d, d]);
 
-    diff = sum(x, 2) - ones(N/d, 1);
+        diff = sum(x, 2) - ones(N/d, 1);
 
-    if norm(diff, Inf) > 1e-5
-        passed = false;
-        return;
+        if norm(diff, Inf) > 1e-5
+            passed = false;
+            return;
+        end
     end
 
     passed = true;
@@ -0,0 +1,62 @@
+function [passed] = test_resolve_update()
+
+    rng(1);
+    passed = true;
+
+    % without preconditioning the step sizes only depend on |K|. scaling
+    % the factors of K by 20 diverges with the steps of the old operator.
+    n = 500;
+    offsets = [-1; 0; 1];
+    factors = [-1; 2; -1];
+    f = rand(n, 1);
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', ...
+                                 'scale_steps_operator', true, ...
+                                 'residual_iter', 10);
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    prob = resolve_problem(n, factors, offsets, f);
+    handle = prost.create_problem(prob, backend, opts);
+    prost.resolve(handle, prob);
+
+    prob_new = resolve_problem(n, 20 * factors, offsets, f);
+    prost.update(handle, prob_new);
+    result = prost.resolve(handle, prob_new);
+    prost.release_problem(handle);
+
+    ref = prost.solve(resolve_problem(n, 20 * factors, offsets, f), backend, opts);
+
+    if ~all(isfinite(result.x))
+        fprintf('failed! Reason: resolve after the update diverged.\n');
+        passed = false;
+        return;
+    end
+
+    diff = norm(result.x - ref.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: resolve differs from a new solve: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+end
+
+function [prob] = resolve_problem(n, factors, offsets, f)
+
+    u = prost.variable(n);
+    g = prost.variable(n);
+
+    prob = prost.min_problem( {u}, {g} );
+    prob.set_scaling_identity();
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+    prob.add_constraint(u, g, prost.block.diags(n, n, factors, offsets));
+
+end
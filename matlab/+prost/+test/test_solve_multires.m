@@ -0,0 +1,53 @@
+function [passed] = test_solve_multires()
+
+    rng(1);
+    passed = true;
+
+    % ROF is strongly convex, so the warm start from the coarse levels must
+    % lead to the solution of the direct solve. the odd grid size checks
+    % the rounding of the coarse grids.
+    ny = 45;
+    nx = 38;
+    lmb = 10;
+    f = rand(ny * nx, 1);
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', 'residual_iter', 10);
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    ref = prost.solve(rof_problem(nx, ny, f, lmb), backend, opts);
+    result = prost.solve_multires(rof_problem(nx, ny, f, lmb), [ny nx], ...
+                                  3, backend, opts);
+
+    if ~strcmp(result.result, 'Converged.')
+        fprintf('failed! Reason: multiresolution solve did not converge.\n');
+        passed = false;
+        return;
+    end
+
+    diff = norm(result.x - ref.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: multiresolution solve differs from the direct one: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+end
+
+function [prob] = rof_problem(nx, ny, f, lmb)
+
+    u = prost.variable(nx * ny);
+    q = prost.variable(2 * nx * ny);
+
+    prob = prost.min_max_problem( {u}, {q} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, lmb));
+    prob.add_function(q, prost.function.sum_norm2(2, false, 'ind_leq0', 1, 1, 1));
+    prob.add_dual_pair(u, q, prost.block.gradient2d(nx, ny, 1));
+
+end
@@ -0,0 +1,62 @@
+function [passed] = test_spdhg()
+
+    rng(1);
+    passed = true;
+
+    % the strongly convex primal has a unique solution, so the sampled
+    % dual blocks have to reach the one of the deterministic method
+    n = 300;
+    num_blocks = 4;
+    A = cell(num_blocks, 1);
+    for i=1:num_blocks
+        A{i} = sprandn(n, n, 0.02) + speye(n);
+    end
+    f = randn(n, 1);
+
+    opts = prost.options('max_iters', 50000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-7, ...
+                         'tol_rel_dual', 1e-7, ...
+                         'tol_abs_primal', 1e-7, ...
+                         'tol_abs_dual', 1e-7);
+
+    ref = prost.solve(spdhg_problem(A, f), ...
+                      prost.backend.pdhg('stepsize', 'alg1', ...
+                                         'residual_iter', 10), opts);
+
+    result = prost.solve(spdhg_problem(A, f), ...
+                         prost.backend.spdhg('block_fraction', 0.5, ...
+                                             'seed', 42), opts);
+
+    if ~all(isfinite(result.x))
+        fprintf('failed! Reason: SPDHG diverged.\n');
+        passed = false;
+        return;
+    end
+
+    diff = norm(result.x - ref.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: SPDHG differs from PDHG: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+end
+
+function [prob] = spdhg_problem(A, f)
+
+    u = prost.variable(numel(f));
+    g = cell(1, numel(A));
+    for i=1:numel(A)
+        g{i} = prost.variable(size(A{i}, 1));
+    end
+
+    prob = prost.min_problem( {u}, g );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    for i=1:numel(A)
+        prob.add_function(g{i}, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+        prob.add_constraint(u, g{i}, prost.block.sparse(A{i}));
+    end
+
+end
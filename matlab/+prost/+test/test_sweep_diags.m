@@ -0,0 +1,70 @@
+function [passed] = test_sweep_diags()
+
+    rng(1);
+    passed = true;
+
+    % every point re-creates the solver, which initializes the diags
+    % block again. more points than fit into the constant memory at
+    % once have to reuse the slots of the previous ones.
+    n = 300;
+    ndiags = 128;
+    num_points = 12;
+
+    offsets = (0:ndiags-1)';
+    factors = [1; 1e-3 * rand(ndiags - 1, 1)];
+    f = rand(n, 1);
+
+    make_problem = @(lmb) sweep_problem(n, factors, offsets, f, lmb);
+
+    lmbs = linspace(0.1, 1, num_points);
+    points = cell(num_points, 1);
+    backends = cell(num_points, 1);
+    for i=1:num_points
+        points{i} = make_problem(lmbs(i));
+        backends{i} = prost.backend.pdhg('stepsize', 'alg1', ...
+                                         'residual_iter', 10);
+    end
+
+    opts = prost.options('max_iters', 5000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    result = prost.sweep(make_problem(lmbs(1)), backends, opts, points);
+
+    if numel(result) ~= num_points
+        fprintf('failed! Reason: expected %d results, got %d\n', ...
+                num_points, numel(result));
+        passed = false;
+        return;
+    end
+
+    % the first and last point against separate solves
+    for i=[1, num_points]
+        prob = make_problem(lmbs(i));
+        ref = prost.solve(prob, backends{i}, opts);
+
+        diff = norm(result(i).x - ref.x, Inf);
+        if diff > 1e-3
+            fprintf('failed! Reason: point %d differs from its solve: %f\n', i, diff);
+            passed = false;
+            return;
+        end
+    end
+
+end
+
+function [prob] = sweep_problem(n, factors, offsets, f, lmb)
+
+    u = prost.variable(n);
+    g = prost.variable(n);
+
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, lmb, 0, 0));
+    prob.add_constraint(u, g, prost.block.diags(n, n, factors, offsets));
+
+end
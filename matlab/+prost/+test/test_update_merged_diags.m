@@ -0,0 +1,104 @@
+function [passed] = test_update_merged_diags()
+
+    rng(1);
+    passed = true;
+
+    % the two small diags blocks are merged into one sparse matrix and
+    % give their constant memory back. the single diags block of the
+    % second problem is not merged and takes the freed slots, the update
+    % of the first problem must not write into them.
+    n = 100;
+    offsets = [-1; 0; 1];
+    factors = [-1; 2; -1];
+    f = rand(n, 1);
+
+    backend = prost.backend.pdhg('stepsize', 'alg1', ...
+                                 'residual_iter', 10);
+
+    opts = prost.options('max_iters', 20000, ...
+                         'num_cback_calls', 0, ...
+                         'verbose', false, ...
+                         'tol_rel_primal', 1e-6, ...
+                         'tol_rel_dual', 1e-6, ...
+                         'tol_abs_primal', 1e-6, ...
+                         'tol_abs_dual', 1e-6);
+
+    merged = merged_problem(n, factors, factors, offsets, f, false);
+    handle_merged = prost.create_problem(merged, backend, opts);
+    prost.resolve(handle_merged, merged);
+
+    single = single_problem(n, factors, offsets, f, false);
+    handle_single = prost.create_problem(single, backend, opts);
+    prost.resolve(handle_single, single);
+
+    merged_new = merged_problem(n, 3 * factors, factors, offsets, f, false);
+    prost.update(handle_merged, merged_new);
+    result_merged = prost.resolve(handle_merged, merged_new);
+    result_single = prost.resolve(handle_single, single);
+
+    prost.release_problem(handle_merged);
+    prost.release_problem(handle_single);
+
+    % references with a single sparse block each, which is never merged
+    ref_merged = prost.solve(merged_problem(n, 3 * factors, factors, offsets, f, true), ...
+                             backend, opts);
+    ref_single = prost.solve(single_problem(n, factors, offsets, f, true), ...
+                             backend, opts);
+
+    diff = norm(result_merged.x - ref_merged.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: updated merged diags differ from the unmerged solve: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+    diff = norm(result_single.x - ref_single.x, Inf);
+    if diff > 1e-3
+        fprintf('failed! Reason: update changed the diags block of another problem: %f\n', diff);
+        passed = false;
+        return;
+    end
+
+end
+
+function [block] = diags_block(n, factors, offsets, as_sparse)
+    if as_sparse
+        block = prost.block.sparse(spdiags(repmat(factors', n, 1), offsets, n, n));
+    else
+        block = prost.block.diags(n, n, factors, offsets);
+    end
+end
+
+function [prob] = merged_problem(n, factors1, factors2, offsets, f, as_sparse)
+
+    u = prost.variable(n);
+    g = prost.variable(2 * n);
+    g1 = prost.sub_variable(g, n);
+    g2 = prost.sub_variable(g, n);
+
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+
+    if as_sparse
+        K = [spdiags(repmat(factors1', n, 1), offsets, n, n); ...
+             spdiags(repmat(factors2', n, 1), offsets, n, n)];
+        prob.add_constraint(u, g, prost.block.sparse(K));
+    else
+        prob.add_constraint(u, g1, diags_block(n, factors1, offsets, false));
+        prob.add_constraint(u, g2, diags_block(n, factors2, offsets, false));
+    end
+
+end
+
+function [prob] = single_problem(n, factors, offsets, f, as_sparse)
+
+    u = prost.variable(n);
+    g = prost.variable(n);
+
+    prob = prost.min_problem( {u}, {g} );
+    prob.add_function(u, prost.function.sum_1d('square', 1, f, 1, 0, 0));
+    prob.add_function(g, prost.function.sum_1d('abs', 1, 0, 0.1, 0, 0));
+    prob.add_constraint(u, g, diags_block(n, factors, offsets, as_sparse));
+
+end
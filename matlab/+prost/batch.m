@@ -0,0 +1,28 @@
+function [result] = batch(probs, backend, opts)
+% BATCH  result = batch(probs, backend, opts)
+%
+%   Solves the problems in the cell array probs at once as one batched
+%   problem on the GPU. All problems need the same variables, blocks and
+%   functions and may only differ in their data, e.g. the coefficients
+%   of the functions or the entries of the blocks. The scaling of the
+%   first problem is used for all, a custom scaling is not supported.
+%
+%   Output is a struct array with the fields x, y and result per
+%   problem, an instance is frozen at the residual check it converged
+%   in. Intermediate callbacks, verbose output, presolve and gpu_arrays
+%   are not supported.
+
+    data = cell(numel(probs), 1);
+    for i=1:numel(probs)
+        probs{i}.finalize();
+        data{i} = probs{i}.data;
+
+        if probs{i}.nrows ~= probs{1}.nrows || probs{i}.ncols ~= probs{1}.ncols
+            error('All problems of a batch need the same size.');
+        end
+    end
+
+    result = prost_('batch', data, probs{1}.nrows, probs{1}.ncols, ...
+                    backend, opts);
+
+end
@@ -0,0 +1,22 @@
+function [handle] = create_problem(prob, backend, opts)
+% CREATE_PROBLEM  handle = create_problem(prob, backend, opts)
+%
+%   Initializes the problem prob with the specified backend and options
+%   on the GPU and returns a handle to it. The problem stays resident
+%   between calls, so repeated solves do not pay for its construction,
+%   preconditioning and step size estimation again. It is freed by
+%   prost.release_problem or prost.release.
+%
+%   Example:
+%   - h = prost.create_problem(prob, backend, opts);
+%     result = prost.resolve(h, prob);
+%     prost.update(h, prob_with_new_data);
+%     result = prost.resolve(h, prob);
+%     prost.release_problem(h);
+
+    prob.finalize();
+
+    handle = prost_('create_problem', prob.data, prob.nrows, prob.ncols, ...
+                    backend, opts);
+
+end
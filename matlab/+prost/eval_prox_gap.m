@@ -0,0 +1,10 @@
+function [gap] = eval_prox_gap(prox, x, y)
+% EVAL_PROX_GAP  gap = eval_prox_gap(prox, x, y)
+%
+% Evaluates the Fenchel-Young gap h(x) + h^*(y) - <x, y> of the function
+% h of prox, split into terms adding up to it. Only available for the
+% proxs for which the solver evaluates the primal-dual gap.
+    
+    gap = prost_('eval_prox_gap', prox(0, size(x, 1)), x, y);
+    
+end
@@ -0,0 +1,17 @@
+function [result, num_proxs] = eval_prox_list(proxs, sizes, arg, tau, Tau, batch)
+% EVAL_PROX_LIST  [result, num_proxs] = eval_prox_list(proxs, sizes, arg, tau, Tau, batch)
+%
+% Evaluates the proxs one after another, prox i on the next sizes(i)
+% entries of arg. If batch is set, runs of small proxs are merged as in
+% the solver. num_proxs is the number of proxs evaluated after merging.
+
+    made = cell(numel(proxs), 1);
+    idx = 0;
+    for i=1:numel(proxs)
+        made{i} = proxs{i}(idx, sizes(i));
+        idx = idx + sizes(i);
+    end
+    
+    [result, num_proxs] = prost_('eval_prox_list', made, arg, tau, Tau, batch);
+    
+end
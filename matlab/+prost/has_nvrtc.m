@@ -0,0 +1,5 @@
+function [available] = has_nvrtc()
+% HAS_NVRTC  True if prost was built with PROST_WITH_NVRTC and supports
+%   runtime compiled proxs (prost.function.sum_jit).
+    available = prost_('has_nvrtc');
+end
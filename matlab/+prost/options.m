@@ -5,6 +5,7 @@ function [opts] = options(varargin)
     addOptional(p, 'tol_rel_dual', 1e-4);
     addOptional(p, 'tol_abs_primal', 1e-4);
     addOptional(p, 'tol_abs_dual', 1e-4);
+    addOptional(p, 'tol_gap', 0);
     addOptional(p, 'max_iters', 1000);
     addOptional(p, 'num_cback_calls', 10);
     addOptional(p, 'verbose', true);
@@ -12,6 +13,23 @@ function [opts] = options(varargin)
     addOptional(p, 'x0', []);
     addOptional(p, 'y0', []);
     addOptional(p, 'solve_dual', false);
+    addOptional(p, 'use_cuda_graph', false);
+    addOptional(p, 'async_convergence_check', false);
+    addOptional(p, 'adaptive_residuals', false);
+    addOptional(p, 'max_residual_iter', 100);
+    addOptional(p, 'async_snapshots', false);
+    addOptional(p, 'profile', false);
+    addOptional(p, 'dense_math', 'default');
+    addOptional(p, 'autotune_launches', false);
+    addOptional(p, 'operator_memory', 'device');
+    addOptional(p, 'presolve', false);
+    addOptional(p, 'history_size', 0);
+    addOptional(p, 'history_every_iter', false);
+    addOptional(p, 'checkpoint_file', '');
+    addOptional(p, 'checkpoint_iter', 1000);
+    addOptional(p, 'resume', false);
+    addOptional(p, 'gpu_arrays', false);
+    addOptional(p, 'interm_cb_gpu', false);
 
     p.parse(varargin{:});
     
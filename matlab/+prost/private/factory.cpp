@@ -15,9 +15,87 @@ namespace matlab
 
 mxArray *Solver_interm_cb_handle = nullptr;
 
+static bool gpu_arrays_enabled = false;
+
+// A gpuArray passed as initial iterate, kept alive during the solve. Its
+// data is used as device array of type real, arrays of the other 
+// precision are converted into a copy on the GPU.
+class GPUInput {
+ public:
+  GPUInput(const mxArray *p) : array_(mxGPUCreateFromMxArray(p)), converted_(nullptr)
+  {
+    size_ = mxGPUGetNumberOfElements(array_);
+    const mxClassID cls = mxGPUGetClassID(array_);
+
+    if(mxGPUGetComplexity(array_) != mxREAL || 
+       (cls != mxDOUBLE_CLASS && cls != mxSINGLE_CLASS))
+    {
+      mxGPUDestroyGPUArray(array_);
+      throw Exception("gpuArray has to be real and of type single or double.");
+    }
+
+    if(cls == GetRealClassID())
+    {
+      data_ = reinterpret_cast<const real *>(mxGPUGetDataReadOnly(array_));
+      return;
+    }
+
+    if(cudaMalloc(&converted_, size_ * sizeof(real)) != cudaSuccess)
+    {
+      mxGPUDestroyGPUArray(array_);
+      throw Exception("Out of device memory converting a gpuArray.");
+    }
+
+    if(cls == mxDOUBLE_CLASS)
+      ConvertDevice(reinterpret_cast<const double *>(mxGPUGetDataReadOnly(array_)), converted_, size_);
+    else
+      ConvertDevice(reinterpret_cast<const float *>(mxGPUGetDataReadOnly(array_)), converted_, size_);
+
+    data_ = converted_;
+  }
+
+  ~GPUInput()
+  {
+    if(converted_ != nullptr)
+      cudaFree(converted_);
+
+    mxGPUDestroyGPUArray(array_);
+  }
+
+  const real *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const mxGPUArray *array_;
+  real *converted_;
+  const real *data_;
+  size_t size_;
+};
+
+static std::vector<std::shared_ptr<GPUInput>> gpu_inputs;
+
+void SetGPUArraysEnabled(bool enabled)
+{
+  gpu_arrays_enabled = enabled;
+
+  if(enabled)
+    mxInitGPU();
+}
+
+void ReleaseGPUInputs()
+{
+  gpu_inputs.clear();
+}
+
+mxClassID GetRealClassID()
+{
+  return sizeof(real) == sizeof(float) ? mxSINGLE_CLASS : mxDOUBLE_CLASS;
+}
+
 static map<string, function<Prox<real>*(size_t, size_t, bool, const mxArray*)>> default_prox_reg = {
   { "elem_operation:ind_simplex",                     CreateProxElemOperationIndSimplex                                                     },
   { "elem_operation:ind_sum",                         CreateProxElemOperationIndSum                                                         },
+  { "elem_operation:jit",                             CreateProxElemOperationJIT                                                            },
   { "elem_operation:ind_psd_cone_3x3",                CreateProxElemOperationIndPsdCone3x3                                                  },
   { "elem_operation:1d:zero",                         CreateProxElemOperation1D<Function1DZero<real>>                                       },
   { "elem_operation:1d:abs",                          CreateProxElemOperation1D<Function1DAbs<real>>                                        },
@@ -81,15 +159,68 @@ const static map<string, function<Block<real>*(size_t, size_t, const mxArray*)>>
   { "gradient3d",     CreateBlockGradient3D   },
   { "id_kron_dense",  CreateBlockIdKronDense  },
   { "id_kron_sparse", CreateBlockIdKronSparse },
+  { "product",        CreateBlockProduct      },
   { "sparse",         CreateBlockSparse       },
+  { "sparse_half",    CreateBlockSparseHalf   },
   { "dense_kron_id",  CreateBlockDenseKronId  },
   { "sparse_kron_id", CreateBlockSparseKronId },
+  { "sum",            CreateBlockSum          },
   { "zero",           CreateBlockZero         },
 };
 
+// Proxs whose data can be replaced after Initialize(), see ParseProxUpdate().
+static map<string, function<ProxUpdate(Prox<real>*, size_t, const mxArray*)>> default_prox_update_reg = {
+  { "elem_operation:1d:zero",                       UpdateProxElemOperation1D<Function1DZero<real>>                                     },
+  { "elem_operation:1d:abs",                        UpdateProxElemOperation1D<Function1DAbs<real>>                                      },
+  { "elem_operation:1d:square",                     UpdateProxElemOperation1D<Function1DSquare<real>>                                   },
+  { "elem_operation:1d:ind_leq0",                   UpdateProxElemOperation1D<Function1DIndLeq0<real>>                                  },
+  { "elem_operation:1d:ind_geq0",                   UpdateProxElemOperation1D<Function1DIndGeq0<real>>                                  },
+  { "elem_operation:1d:ind_eq0",                    UpdateProxElemOperation1D<Function1DIndEq0<real>>                                   },
+  { "elem_operation:1d:ind_box01",                  UpdateProxElemOperation1D<Function1DIndBox01<real>>                                 },
+  { "elem_operation:1d:max_pos0",                   UpdateProxElemOperation1D<Function1DMaxPos0<real>>                                  },
+  { "elem_operation:1d:l0",                         UpdateProxElemOperation1D<Function1DL0<real>>                                       },
+  { "elem_operation:1d:huber",                      UpdateProxElemOperation1D<Function1DHuber<real>>                                    },
+  { "elem_operation:1d:lq",                         UpdateProxElemOperation1D<Function1DLq<real>>                                       },
+  { "elem_operation:1d:lq_plus_eps",                UpdateProxElemOperation1D<Function1DLqPlusEps<real>>                                },
+  { "elem_operation:1d:trunclin",                   UpdateProxElemOperation1D<Function1DTruncLinear<real>>                              },
+  { "elem_operation:1d:truncquad",                  UpdateProxElemOperation1D<Function1DTruncQuad<real>>                                },
+  { "elem_operation:norm2:zero",                    UpdateProxElemOperationNorm2<Function1DZero<real>>                                  },
+  { "elem_operation:norm2:abs",                     UpdateProxElemOperationNorm2<Function1DAbs<real>>                                   },
+  { "elem_operation:norm2:square",                  UpdateProxElemOperationNorm2<Function1DSquare<real>>                                },
+  { "elem_operation:norm2:ind_leq0",                UpdateProxElemOperationNorm2<Function1DIndLeq0<real>>                               },
+  { "elem_operation:norm2:ind_geq0",                UpdateProxElemOperationNorm2<Function1DIndGeq0<real>>                               },
+  { "elem_operation:norm2:ind_eq0",                 UpdateProxElemOperationNorm2<Function1DIndEq0<real>>                                },
+  { "elem_operation:norm2:ind_box01",               UpdateProxElemOperationNorm2<Function1DIndBox01<real>>                              },
+  { "elem_operation:norm2:max_pos0",                UpdateProxElemOperationNorm2<Function1DMaxPos0<real>>                               },
+  { "elem_operation:norm2:l0",                      UpdateProxElemOperationNorm2<Function1DL0<real>>                                    },
+  { "elem_operation:norm2:huber",                   UpdateProxElemOperationNorm2<Function1DHuber<real>>                                 },
+  { "elem_operation:norm2:lq",                      UpdateProxElemOperationNorm2<Function1DLq<real>>                                    },
+  { "elem_operation:norm2:lq_plus_eps",             UpdateProxElemOperationNorm2<Function1DLqPlusEps<real>>                             },
+  { "elem_operation:norm2:trunclin",                UpdateProxElemOperationNorm2<Function1DTruncLinear<real>>                           },
+  { "elem_operation:norm2:truncquad",               UpdateProxElemOperationNorm2<Function1DTruncQuad<real>>                             },
+  { "elem_operation:singular_nx2:sum_1d:zero",      UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DZero<real>>>     },
+  { "elem_operation:singular_nx2:sum_1d:abs",       UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DAbs<real>>>      },
+  { "elem_operation:singular_nx2:sum_1d:square",    UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DSquare<real>>>   },
+  { "elem_operation:singular_nx2:sum_1d:ind_leq0",  UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DIndLeq0<real>>>  },
+  { "elem_operation:singular_nx2:sum_1d:ind_geq0",  UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DIndGeq0<real>>>  },
+  { "elem_operation:singular_nx2:sum_1d:ind_eq0",   UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DIndEq0<real>>>   },
+  { "elem_operation:singular_nx2:sum_1d:ind_box01", UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DIndBox01<real>>> },
+  { "elem_operation:singular_nx2:sum_1d:max_pos0",  UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DMaxPos0<real>>>  },
+  { "elem_operation:singular_nx2:sum_1d:l0",        UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DL0<real>>>       },
+  { "elem_operation:singular_nx2:sum_1d:huber",     UpdateProxElemOperationSingularNx2<Function2DSum1D<real, Function1DHuber<real>>>    },
+  { "elem_operation:singular_nx2:ind_l1_ball",      UpdateProxElemOperationSingularNx2<Function2DIndL1Ball<real>>                       },
+  { "transform",                                    UpdateProxTransform                                                                 },
+};
+
+const static map<string, function<BlockUpdate(Block<real>*, const mxArray*)>> default_block_update_reg = {
+  { "diags", UpdateBlockDiags },
+};
+
 const static map<string, function<Backend<real>*(const mxArray*)>> default_backend_reg = {
   { "admm", CreateBackendADMM },
+  { "host", CreateBackendHost },
   { "pdhg", CreateBackendPDHG },
+  { "spdhg", CreateBackendSPDHG },
 };
 
 bool
@@ -116,11 +247,98 @@ SolverIntermCallback(int iter, const std::vector<real>& primal, const std::vecto
   return is_converged;
 }
 
+mxGPUArray *
+CreateGPUVector(size_t n)
+{
+  const mwSize dims[2] = { n, 1 };
+  return mxGPUCreateGPUArray(2, dims, GetRealClassID(), mxREAL, MX_GPU_DO_NOT_INITIALIZE);
+}
+
+// Copies n elements of device memory into a new gpuArray.
+static mxArray *
+CreateGPUVectorFromDevice(const real *data, size_t n, cudaStream_t stream)
+{
+  mxGPUArray *array = CreateGPUVector(n);
+  cudaMemcpyAsync(mxGPUGetData(array), data, n * sizeof(real), cudaMemcpyDeviceToDevice, stream);
+  cudaStreamSynchronize(stream);
+
+  mxArray *result = mxGPUCreateMxArrayOnGPU(array);
+  mxGPUDestroyGPUArray(array);
+  return result;
+}
+
+bool
+SolverDeviceIntermCallback(int iter, const Solver<real>::DeviceSolution& sol)
+{
+  mxArray *cb_rhs[4];
+  cb_rhs[0] = Solver_interm_cb_handle;
+  cb_rhs[1] = mxCreateDoubleScalar(iter);
+  cb_rhs[2] = CreateGPUVectorFromDevice(sol.x, sol.ncols, sol.stream);
+  cb_rhs[3] = CreateGPUVectorFromDevice(sol.y, sol.nrows, sol.stream);
+
+  mxArray *cb_lhs[1];
+
+  mexCallMATLAB(1, cb_lhs, 4, cb_rhs, "feval");
+
+  mxDestroyArray(cb_rhs[2]);
+  mxDestroyArray(cb_rhs[3]);
+
+  bool is_converged = static_cast<double>(mxGetScalar(cb_lhs[0]));
+
+  return is_converged;
+}
+
+// Gathers a gpuArray with n elements into an std::vector of the specified
+// type with a single copy from the device.
+template<typename T>
+std::vector<T> GetGPUVector(const mxArray *p)
+{
+  if(!gpu_arrays_enabled)
+    throw Exception("gpuArray inputs require the option gpu_arrays.");
+
+  const mxGPUArray *array = mxGPUCreateFromMxArray(p);
+  const size_t n = mxGPUGetNumberOfElements(array);
+  const mxClassID cls = mxGPUGetClassID(array);
+  const void *data = mxGPUGetDataReadOnly(array);
+
+  std::vector<T> result;
+
+  if(cls == mxDOUBLE_CLASS)
+  {
+    std::vector<double> host(n);
+    cudaMemcpy(host.data(), data, n * sizeof(double), cudaMemcpyDeviceToHost);
+    result.assign(host.begin(), host.end());
+  }
+  else if(cls == mxSINGLE_CLASS)
+  {
+    std::vector<float> host(n);
+    cudaMemcpy(host.data(), data, n * sizeof(float), cudaMemcpyDeviceToHost);
+    result.assign(host.begin(), host.end());
+  }
+
+  mxGPUDestroyGPUArray(array);
+
+  if(cls != mxDOUBLE_CLASS && cls != mxSINGLE_CLASS)
+    throw Exception("Argument has to be passed as a gpuArray of type single or double.");
+
+  return result;
+}
+
 // Reads a vector from matlab and converts it to std::vector of
 // the specified type.
 template<typename T>
 std::vector<T> GetVector(const mxArray *p)
 {
+  if(mxIsGPUArray(p))
+  {
+    std::vector<T> result = GetGPUVector<T>(p);
+
+    if(result.empty())
+      throw Exception("Empty vector passed.");
+
+    return result;
+  }
+
   const mwSize *dims = mxGetDimensions(p);
   
   if(dims[1] != 1 && dims[0] != 1)
@@ -151,6 +369,38 @@ std::vector<T> GetVector(const mxArray *p)
     throw Exception("Argument has to be passed as a vector of type single or double.");
 }
 
+// Reads a dense matrix in column-first order, from host memory or from
+// a gpuArray.
+std::vector<real> GetDenseMatrix(const mxArray *p, size_t& nrows, size_t& ncols)
+{
+  if(mxIsGPUArray(p))
+  {
+    const mxGPUArray *array = mxGPUCreateFromMxArray(p);
+    const mwSize *dims = mxGPUGetDimensions(array);
+    nrows = dims[0];
+    ncols = mxGPUGetNumberOfDimensions(array) > 1 ? dims[1] : 1;
+    mxFree(const_cast<mwSize *>(dims));
+    mxGPUDestroyGPUArray(array);
+
+    return GetGPUVector<real>(p);
+  }
+
+  if(mxIsSparse(p))
+    throw Exception("Matrix must be dense!");
+
+  nrows = mxGetM(p);
+  ncols = mxGetN(p);
+
+  if(mxIsSingle(p))
+  {
+    float *vals = reinterpret_cast<float *>(mxGetData(p));
+    return std::vector<real>(vals, vals + nrows * ncols);
+  }
+
+  double *vals = reinterpret_cast<double *>(mxGetData(p));
+  return std::vector<real>(vals, vals + nrows * ncols);
+}
+
 // Reads a cell-array of matlab vectors into an std::array of std::vector.
 template<size_t COEFFS_COUNT>
 void GetCoefficients(
@@ -318,6 +568,70 @@ CreateProxElemOperationSingularNx2(size_t idx, size_t size, bool diagsteps, cons
     idx, count, dim, interleaved, diagsteps, coeffs);   
 }
 
+// Casts a prox to the type an update function expects.
+template<class PROX>
+PROX *CastProx(Prox<real> *prox)
+{
+  PROX *result = dynamic_cast<PROX *>(prox);
+
+  if(!result)
+    throw Exception("Type of the prox changed, it can only be updated with the same function.");
+
+  return result;
+}
+
+template<class FUN_1D>
+ProxUpdate UpdateProxElemOperation1D(Prox<real> *prox, size_t size, const mxArray *data)
+{
+  typedef ProxElemOperation<real, ElemOperation1D<real, FUN_1D>> ProxType;
+  CastProx<ProxType>(prox);
+
+  std::array<std::vector<real>, 7> coeffs;
+  GetCoefficients<7>(coeffs, mxGetCell(data, 3), size);
+
+  return [coeffs](Prox<real> *target) { CastProx<ProxType>(target)->SetCoefficients(coeffs); };
+}
+
+template<class FUN_1D>
+ProxUpdate UpdateProxElemOperationNorm2(Prox<real> *prox, size_t size, const mxArray *data)
+{
+  typedef ProxElemOperation<real, ElemOperationNorm2<real, FUN_1D>> ProxType;
+  CastProx<ProxType>(prox);
+
+  size_t count = GetScalarFromCellArray<size_t>(data, 0);
+
+  std::array<std::vector<real>, 7> coeffs;
+  GetCoefficients<7>(coeffs, mxGetCell(data, 3), count);
+
+  return [coeffs](Prox<real> *target) { CastProx<ProxType>(target)->SetCoefficients(coeffs); };
+}
+
+template<class FUN_2D>
+ProxUpdate UpdateProxElemOperationSingularNx2(Prox<real> *prox, size_t size, const mxArray *data)
+{
+  typedef ProxElemOperation<real, ElemOperationSingularNx2<real, FUN_2D>> ProxType;
+  CastProx<ProxType>(prox);
+
+  size_t count = GetScalarFromCellArray<size_t>(data, 0);
+
+  std::array<std::vector<real>, 7> coeffs;
+  GetCoefficients<7>(coeffs, mxGetCell(data, 3), count);
+
+  return [coeffs](Prox<real> *target) { CastProx<ProxType>(target)->SetCoefficients(coeffs); };
+}
+
+ProxUpdate UpdateProxTransform(Prox<real> *prox, size_t size, const mxArray *data)
+{
+  CastProx<ProxTransform<real>>(prox);
+
+  std::array<std::vector<real>, 5> coeffs;
+  GetCoefficients<5>(coeffs, data, size);
+
+  return [coeffs](Prox<real> *target) {
+    CastProx<ProxTransform<real>>(target)->SetCoefficients(
+      coeffs[0], coeffs[1], coeffs[2], coeffs[3], coeffs[4]);
+  };
+}
 
 ProxElemOperation<real, ElemOperationIndSimplex<real> >* 
 CreateProxElemOperationIndSimplex(size_t idx, size_t size, bool diagsteps, const mxArray *data) 
@@ -338,6 +652,24 @@ CreateProxElemOperationIndSum(size_t idx, size_t size, bool diagsteps, const mxA
 
   return new ProxElemOperation<real, ElemOperationIndSum<real> >(idx, count, dim, interleaved, diagsteps);   
 }
+
+ProxElemOperationJIT<real>* 
+CreateProxElemOperationJIT(size_t idx, size_t size, bool diagsteps, const mxArray *data) 
+{
+  size_t count = GetScalarFromCellArray<size_t>(data, 0);
+  size_t dim = GetScalarFromCellArray<size_t>(data, 1);
+  bool interleaved = GetScalarFromCellArray<bool>(data, 2);
+  std::string operation(mxArrayToString(mxGetCell(data, 3)));
+
+  const mxArray *cell_coeffs = mxGetCell(data, 4);
+  const mwSize *dims = mxGetDimensions(cell_coeffs);
+
+  std::vector<std::vector<real> > coeffs(dims[0] * dims[1]);
+  for(size_t i = 0; i < coeffs.size(); i++) 
+    coeffs[i] = GetVector<real>(mxGetCell(cell_coeffs, i));
+
+  return new ProxElemOperationJIT<real>(idx, count, dim, interleaved, diagsteps, operation, coeffs);
+}
     
 ProxElemOperation<real, ElemOperationIndPsdCone3x3<real> >*
 CreateProxElemOperationIndPsdCone3x3(size_t idx, size_t size, bool diagsteps, const mxArray *data)
@@ -476,16 +808,29 @@ CreateProxIndRange(size_t idx, size_t size, bool diagsteps, const mxArray *data)
   std::vector<int32_t> vec_ptr(ptr, ptr + (ncols + 1));
   std::vector<int32_t> vec_ind(ind, ind + nnz); 
   
-  prox->setA(nrows, ncols, nnz, vec_val, vec_ptr, vec_ind);
+  bool transpose_spmv = false;
+  if(mxGetNumberOfElements(data) > 2)
+    transpose_spmv = GetScalarFromCellArray<bool>(data, 2);
+
+  prox->setA(nrows, ncols, nnz, vec_val, vec_ptr, vec_ind, transpose_spmv);
+
+  std::string factorization = "dense";
+  if(mxGetNumberOfElements(data) > 3)
+    factorization = mxArrayToString(mxGetCell(data, 3));
+
+  if(factorization == "sparse")
+  {
+    prox->set_factorization(ProxIndRange<real>::kFactorizationSparse);
+    return prox;
+  }
+  else if(factorization != "dense")
+    throw Exception("Factorization not recognized. Options are {'dense', 'sparse'}.");
 
   pm = mxGetCell(data, 1);
   if(mxIsSparse(pm))
     throw Exception("Matrix AA must be dense!");
   
-  nrows = mxGetM(pm);
-  ncols = mxGetN(pm);
-  double *vals = reinterpret_cast<double *>(mxGetData(pm));  
-  std::vector<real> dense_vals(vals, vals + nrows * ncols);
+  std::vector<real> dense_vals = GetDenseMatrix(pm, nrows, ncols);
 
   prox->setAA(nrows, ncols, dense_vals);
 
@@ -508,13 +853,23 @@ CreateBlockDiags(size_t row, size_t col, const mxArray *pm)
   return new BlockDiags<real>(row, col, nrows, ncols, ndiags, offsets, factors);
 }
 
+BlockUpdate UpdateBlockDiags(Block<real> *block, const mxArray *pm)
+{
+  if(!dynamic_cast<BlockDiags<real> *>(block))
+    throw Exception("Type of the block changed, it can only be updated with the same block.");
+
+  std::vector<real> factors = GetVector<real>(mxGetCell(pm, 2));
+
+  return [factors](Block<real> *target) {
+    static_cast<BlockDiags<real> *>(target)->SetFactors(factors);
+  };
+}
+
 BlockDense<real>*
 CreateBlockDense(size_t row, size_t col, const mxArray *pm)
 {
-  size_t nrows = mxGetM(mxGetCell(pm, 0));
-  size_t ncols = mxGetN(mxGetCell(pm, 0));
-  double *data = reinterpret_cast<double *>(mxGetData(mxGetCell(pm, 0)));
-  std::vector<real> r_data(data, data + nrows * ncols);
+  size_t nrows, ncols;
+  std::vector<real> r_data = GetDenseMatrix(mxGetCell(pm, 0), nrows, ncols);
 
   //cout << nrows << "," << ncols << "," << r_data.size() << endl;
   
@@ -565,7 +920,44 @@ CreateBlockSparse(size_t row, size_t col, const mxArray *data)
   std::vector<int32_t> vec_ptr(ptr, ptr + (ncols + 1));
   std::vector<int32_t> vec_ind(ind, ind + nnz); 
 
+  bool transpose_spmv = false;
+  if(mxGetNumberOfElements(data) > 1)
+    transpose_spmv = GetScalarFromCellArray<bool>(data, 1);
+
   return BlockSparse<real>::CreateFromCSC(
+    row, 
+    col,
+    nrows,
+    ncols,
+    nnz,
+    vec_val,
+    vec_ptr,
+    vec_ind,
+    transpose_spmv);
+}
+
+BlockSparseHalf<real>*
+CreateBlockSparseHalf(size_t row, size_t col, const mxArray *data)
+{
+  mxArray *pm = mxGetCell(data, 0);
+
+  if(!mxIsSparse(pm))
+    throw Exception("Matrix must be sparse!");
+  
+  double *val = mxGetPr(pm);
+  mwIndex *ind = mxGetIr(pm);
+  mwIndex *ptr = mxGetJc(pm);
+  const mwSize *dims = mxGetDimensions(pm);
+
+  int nrows = dims[0];
+  int ncols = dims[1];
+  int nnz = ptr[ncols];
+
+  std::vector<real> vec_val(val, val + nnz);
+  std::vector<int32_t> vec_ptr(ptr, ptr + (ncols + 1));
+  std::vector<int32_t> vec_ind(ind, ind + nnz); 
+
+  return BlockSparseHalf<real>::CreateFromCSC(
     row, 
     col,
     nrows,
@@ -615,10 +1007,8 @@ CreateBlockIdKronSparse(size_t row, size_t col, const mxArray *data)
 prost::BlockIdKronDense<real>*
 CreateBlockIdKronDense(size_t row, size_t col, const mxArray *pm)
 {
-  size_t nrows = mxGetM(mxGetCell(pm, 0));
-  size_t ncols = mxGetN(mxGetCell(pm, 0));
-  double *data = reinterpret_cast<double *>(mxGetData(mxGetCell(pm, 0)));
-  std::vector<real> r_data(data, data + nrows * ncols);
+  size_t nrows, ncols;
+  std::vector<real> r_data = GetDenseMatrix(mxGetCell(pm, 0), nrows, ncols);
   size_t diaglength = GetScalarFromCellArray<size_t>(pm, 1);
 
   return BlockIdKronDense<real>::CreateFromColFirstData(diaglength, row, col, nrows, ncols, r_data);
@@ -627,10 +1017,8 @@ CreateBlockIdKronDense(size_t row, size_t col, const mxArray *pm)
 prost::BlockDenseKronId<real>*
 CreateBlockDenseKronId(size_t row, size_t col, const mxArray *pm)
 {
-  size_t nrows = mxGetM(mxGetCell(pm, 0));
-  size_t ncols = mxGetN(mxGetCell(pm, 0));
-  double *data = reinterpret_cast<double *>(mxGetData(mxGetCell(pm, 0)));
-  std::vector<real> r_data(data, data + nrows * ncols);
+  size_t nrows, ncols;
+  std::vector<real> r_data = GetDenseMatrix(mxGetCell(pm, 0), nrows, ncols);
   size_t diaglength = GetScalarFromCellArray<size_t>(pm, 1);
 
   return BlockDenseKronId<real>::CreateFromColFirstData(diaglength, row, col, nrows, ncols, r_data);
@@ -680,6 +1068,31 @@ CreateBlockZero(size_t row, size_t col, const mxArray *data)
   
   return new BlockZero<real>(row, col, nrows, ncols);
 }
+
+BlockProduct<real>*
+CreateBlockProduct(size_t row, size_t col, const mxArray *data)
+{
+  vector<shared_ptr<Block<real>>> factors;
+
+  for(size_t i = 0; i < mxGetNumberOfElements(data); i++)
+    factors.push_back(CreateBlock(mxGetCell(data, i)));
+
+  return new BlockProduct<real>(row, col, factors);
+}
+
+BlockSum<real>*
+CreateBlockSum(size_t row, size_t col, const mxArray *data)
+{
+  const mxArray *cell_terms = mxGetCell(data, 0);
+  vector<shared_ptr<Block<real>>> terms;
+
+  for(size_t i = 0; i < mxGetNumberOfElements(cell_terms); i++)
+    terms.push_back(CreateBlock(mxGetCell(cell_terms, i)));
+
+  vector<real> coeffs = GetVector<real>(mxGetCell(data, 1));
+
+  return new BlockSum<real>(row, col, terms, coeffs);
+}
   
 BackendPDHG<real>* 
 CreateBackendPDHG(const mxArray *data)
@@ -691,12 +1104,22 @@ CreateBackendPDHG(const mxArray *data)
   opts.sigma0 =               GetScalarFromField<real>(data, "sigma0");
   opts.residual_iter =        GetScalarFromField<int>(data,  "residual_iter"); 
   opts.scale_steps_operator = GetScalarFromField<bool>(data, "scale_steps_operator");
+  opts.normest_tol =          GetScalarFromField<real>(data, "normest_tol");
   opts.alg2_gamma =           GetScalarFromField<real>(data, "alg2_gamma");
   opts.arg_alpha0 =           GetScalarFromField<real>(data, "arg_alpha0");
   opts.arg_nu =               GetScalarFromField<real>(data, "arg_nu");
   opts.arg_delta =            GetScalarFromField<real>(data, "arg_delta");
   opts.arb_delta =            GetScalarFromField<real>(data, "arb_delta");
   opts.arb_tau =              GetScalarFromField<real>(data, "arb_tau");
+  opts.restart_iter =         GetScalarFromField<int>(data,  "restart_iter");
+  opts.restart_beta_sufficient = GetScalarFromField<real>(data, "restart_beta_sufficient");
+  opts.restart_beta_necessary =  GetScalarFromField<real>(data, "restart_beta_necessary");
+  opts.restart_beta_artificial = GetScalarFromField<real>(data, "restart_beta_artificial");
+  opts.primal_weight_smoothing = GetScalarFromField<real>(data, "primal_weight_smoothing");
+  opts.fuse_prox_arg =        GetScalarFromField<bool>(data, "fuse_prox_arg");
+  opts.fuse_epilogue =        GetScalarFromField<bool>(data, "fuse_epilogue");
+  opts.low_memory =           GetScalarFromField<bool>(data, "low_memory");
+  opts.persistent_kernel =    GetScalarFromField<bool>(data, "persistent_kernel");
 
   std::string stepsize_variant(mxArrayToString(mxGetField(data, 0, "stepsize")));
 
@@ -708,8 +1131,10 @@ CreateBackendPDHG(const mxArray *data)
     opts.stepsize_variant= BackendPDHG<real>::StepsizeVariant::kPDHGStepsResidualGoldstein;
   else if(stepsize_variant == "boyd")
     opts.stepsize_variant= BackendPDHG<real>::StepsizeVariant::kPDHGStepsResidualBoyd;
+  else if(stepsize_variant == "restarted")
+    opts.stepsize_variant= BackendPDHG<real>::StepsizeVariant::kPDHGStepsRestarted;
   else
-    throw Exception("Couldn't recognize step-size variant. Valid options are {alg1,alg2,goldstein,boyd}.");
+    throw Exception("Couldn't recognize step-size variant. Valid options are {alg1,alg2,goldstein,boyd,restarted}.");
 
   BackendPDHG<real> *backend = new BackendPDHG<real>(opts);
 
@@ -729,15 +1154,66 @@ CreateBackendADMM(const mxArray *data)
   opts.arb_tau =        GetScalarFromField<real>(data, "arb_tau");
   opts.alpha =          GetScalarFromField<real>(data, "alpha");
   opts.cg_max_iter =    GetScalarFromField<int>(data, "cg_max_iter");
+  opts.cg_fused =       GetScalarFromField<bool>(data, "cg_fused");
+  opts.cg_jacobi =      GetScalarFromField<bool>(data, "cg_jacobi");
+  opts.cg_check_iter =  GetScalarFromField<int>(data, "cg_check_iter");
   opts.cg_tol_pow  =    GetScalarFromField<real>(data, "cg_tol_pow");
   opts.cg_tol_min  =    GetScalarFromField<real>(data, "cg_tol_min");
   opts.cg_tol_max  =    GetScalarFromField<real>(data, "cg_tol_max");
+  opts.direct_max_nnz = GetScalarFromField<int>(data, "direct_max_nnz");
+
+  std::string projection(mxArrayToString(mxGetField(data, 0, "projection")));
+
+  if(projection == "cgls")
+    opts.projection = BackendADMM<real>::ProjectionMode::kProjectionCGLS;
+  else if(projection == "cholesky")
+    opts.projection = BackendADMM<real>::ProjectionMode::kProjectionCholesky;
+  else if(projection == "auto")
+    opts.projection = BackendADMM<real>::ProjectionMode::kProjectionAuto;
+  else
+    throw Exception("Couldn't recognize projection mode. Valid options are {cgls,cholesky,auto}.");
 
   BackendADMM<real> *backend = new BackendADMM<real>(opts);
 
   return backend;
 }
     
+BackendSPDHG<real>* 
+CreateBackendSPDHG(const mxArray *data)
+{
+  BackendSPDHG<real>::Options opts;
+
+  // read options from data
+  opts.tau0 =                 GetScalarFromField<real>(data, "tau0");
+  opts.sigma0 =               GetScalarFromField<real>(data, "sigma0");
+  opts.residual_iter =        GetScalarFromField<int>(data,  "residual_iter"); 
+  opts.scale_steps_operator = GetScalarFromField<bool>(data, "scale_steps_operator");
+  opts.normest_tol =          GetScalarFromField<real>(data, "normest_tol");
+  opts.block_fraction =       GetScalarFromField<real>(data, "block_fraction");
+  opts.seed =                 GetScalarFromField<unsigned int>(data, "seed");
+
+  BackendSPDHG<real> *backend = new BackendSPDHG<real>(opts);
+
+  return backend;
+}
+
+BackendHost<real>* 
+CreateBackendHost(const mxArray *data)
+{
+  BackendHost<real>::Options opts;
+
+  // read options from data
+  opts.tau0 =                 GetScalarFromField<real>(data, "tau0");
+  opts.sigma0 =               GetScalarFromField<real>(data, "sigma0");
+  opts.residual_iter =        GetScalarFromField<int>(data,  "residual_iter"); 
+  opts.scale_steps_operator = GetScalarFromField<bool>(data, "scale_steps_operator");
+  opts.normest_tol =          GetScalarFromField<real>(data, "normest_tol");
+
+  BackendHost<real> *backend = new BackendHost<real>(opts);
+
+  return backend;
+}
+
 std::shared_ptr<Prox<real> >
 CreateProx(const mxArray *pm) 
 {
@@ -869,7 +1345,7 @@ CreateBackend(const mxArray *pm)
 }
 
 std::shared_ptr<Problem<real> >
-CreateProblem(const mxArray *pm, size_t nrows, size_t ncols)
+CreateProblem(const mxArray *pm, size_t nrows, size_t ncols, ProblemParts *parts)
 {
   Problem<real> *prob = new Problem<real>;
 
@@ -879,35 +1355,167 @@ CreateProblem(const mxArray *pm, size_t nrows, size_t ncols)
   std::vector<const mxArray *> prox_gstar = GetCellArray(mxGetField(pm, 0, "prox_gstar"));
   std::vector<const mxArray *> prox_fstar = GetCellArray(mxGetField(pm, 0, "prox_fstar"));
 
+  ProblemParts created;
+
+  for(auto& b : blocks) created.blocks.push_back(CreateBlock(b));
+  for(auto& p : prox_g) created.prox_g.push_back(CreateProx(p));
+  for(auto& p : prox_f) created.prox_f.push_back(CreateProx(p));
+  for(auto& p : prox_gstar) created.prox_gstar.push_back(CreateProx(p));
+  for(auto& p : prox_fstar) created.prox_fstar.push_back(CreateProx(p));
+
   // add blocks
-  for(auto& b : blocks) prob->AddBlock(CreateBlock(b));
+  for(auto& b : created.blocks) prob->AddBlock(b);
 
   // add proxs
-  for(auto& p : prox_g) prob->AddProx_g(CreateProx(p));
-  for(auto& p : prox_f) prob->AddProx_f(CreateProx(p));
-  for(auto& p : prox_gstar) prob->AddProx_gstar(CreateProx(p));
-  for(auto& p : prox_fstar) prob->AddProx_fstar(CreateProx(p));
+  for(auto& p : created.prox_g) prob->AddProx_g(p);
+  for(auto& p : created.prox_f) prob->AddProx_f(p);
+  for(auto& p : created.prox_gstar) prob->AddProx_gstar(p);
+  for(auto& p : created.prox_fstar) prob->AddProx_fstar(p);
+
+  if(parts)
+    *parts = created;
+
+  SetProblemScaling(pm, *prob);
+  prob->SetDimensions(nrows, ncols);
 
-  // set scaling
+  return std::shared_ptr<Problem<real> >(prob);
+}
+
+void
+SetProblemScaling(const mxArray *pm, Problem<real>& problem)
+{
   std::string scaling(mxArrayToString(mxGetField(pm, 0, "scaling")));
 
   if(scaling == "alpha")
-    prob->SetScalingAlpha( GetScalarFromField<real>(pm, "scaling_alpha") );
+    problem.SetScalingAlpha( GetScalarFromField<real>(pm, "scaling_alpha") );
   else if(scaling == "identity")
-    prob->SetScalingIdentity();
+    problem.SetScalingIdentity();
   else if(scaling == "custom")
   {
     std::vector<real> left = GetVector<real>(mxGetField(pm, 0, "scaling_left"));
     std::vector<real> right = GetVector<real>(mxGetField(pm, 0, "scaling_right"));
 
-    prob->SetScalingCustom(left, right);
+    problem.SetScalingCustom(left, right);
   }
   else
     throw Exception("Problem scaling variant not recognized. Options are {'alpha', 'identity', 'custom'}.");
+}
 
-  prob->SetDimensions(nrows, ncols);
+ProxUpdate
+ParseProxUpdate(Prox<real>& prox, const mxArray *pm)
+{
+  std::string name(mxArrayToString(mxGetCell(pm, 0)));
+  size_t idx = GetScalarFromCellArray<size_t>(pm, 1);
+  size_t size = GetScalarFromCellArray<size_t>(pm, 2);
+  mxArray *data = mxGetCell(pm, 4);
 
-  return std::shared_ptr<Problem<real> >(prob);
+  if(idx != prox.index() || size != prox.size())
+  {
+    std::ostringstream ss;
+    ss << "Updating prox with ID '" << name << "' failed. Reason: Index or size changed.";
+    throw Exception(ss.str());
+  }
+
+  ProxUpdate update;
+
+  try
+  {
+    for(auto& p : get_prox_update_reg())
+      if(p.first.compare(name) == 0)
+        update = p.second(&prox, size, data);
+  }
+  catch(Exception& e)
+  {
+    std::ostringstream ss;
+    ss << "Updating prox with ID '" << name << "' failed. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+
+  return update;
+}
+
+BlockUpdate
+ParseBlockUpdate(Block<real>& block, const mxArray *pm)
+{
+  std::string name(mxArrayToString(mxGetCell(pm, 0)));
+  size_t row = GetScalarFromCellArray<size_t>(pm, 1);
+  size_t col = GetScalarFromCellArray<size_t>(pm, 2);
+  mxArray *data = mxGetCell(pm, 3);
+
+  if(row != block.row() || col != block.col())
+  {
+    std::ostringstream ss;
+    ss << "Updating block with ID '" << name << "' failed. Reason: Position changed.";
+    throw Exception(ss.str());
+  }
+
+  BlockUpdate update;
+
+  try
+  {
+    for(auto& b : get_block_update_reg())
+      if(b.first.compare(name) == 0)
+        update = b.second(&block, data);
+  }
+  catch(Exception& e)
+  {
+    std::ostringstream ss;
+    ss << "Updating block with ID '" << name << "' failed. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+
+  return update;
+}
+
+ProblemUpdate
+ParseProblemUpdate(const ProblemParts& parts, const mxArray *pm)
+{
+  std::vector<const mxArray *> blocks = GetCellArray(mxGetField(pm, 0, "linop"));
+  std::vector<const mxArray *> prox_g = GetCellArray(mxGetField(pm, 0, "prox_g"));
+  std::vector<const mxArray *> prox_f = GetCellArray(mxGetField(pm, 0, "prox_f"));
+  std::vector<const mxArray *> prox_gstar = GetCellArray(mxGetField(pm, 0, "prox_gstar"));
+  std::vector<const mxArray *> prox_fstar = GetCellArray(mxGetField(pm, 0, "prox_fstar"));
+
+  if(blocks.size() != parts.blocks.size() ||
+     prox_g.size() != parts.prox_g.size() ||
+     prox_f.size() != parts.prox_f.size() ||
+     prox_gstar.size() != parts.prox_gstar.size() ||
+     prox_fstar.size() != parts.prox_fstar.size())
+  {
+    throw Exception("The structure of the problem changed, it has to be created again.");
+  }
+
+  ProblemUpdate update;
+
+  for(size_t i = 0; i < blocks.size(); i++) update.blocks.push_back(ParseBlockUpdate(*parts.blocks[i], blocks[i]));
+  for(size_t i = 0; i < prox_g.size(); i++) update.prox_g.push_back(ParseProxUpdate(*parts.prox_g[i], prox_g[i]));
+  for(size_t i = 0; i < prox_f.size(); i++) update.prox_f.push_back(ParseProxUpdate(*parts.prox_f[i], prox_f[i]));
+  for(size_t i = 0; i < prox_gstar.size(); i++) update.prox_gstar.push_back(ParseProxUpdate(*parts.prox_gstar[i], prox_gstar[i]));
+  for(size_t i = 0; i < prox_fstar.size(); i++) update.prox_fstar.push_back(ParseProxUpdate(*parts.prox_fstar[i], prox_fstar[i]));
+
+  std::string scaling(mxArrayToString(mxGetField(pm, 0, "scaling")));
+  update.scaling_alpha = (scaling == "alpha");
+  if(update.scaling_alpha)
+    update.alpha = GetScalarFromField<real>(pm, "scaling_alpha");
+
+  return update;
+}
+
+void
+ApplyProblemUpdate(const ProblemUpdate& update, const ProblemParts& parts, Problem<real>& problem)
+{
+  for(size_t i = 0; i < update.blocks.size(); i++)
+    if(update.blocks[i]) update.blocks[i](parts.blocks[i].get());
+
+  const std::vector<ProxUpdate> *updates[4] = { &update.prox_g, &update.prox_f, &update.prox_gstar, &update.prox_fstar };
+  const std::vector<shared_ptr<Prox<real>>> *proxs[4] = { &parts.prox_g, &parts.prox_f, &parts.prox_gstar, &parts.prox_fstar };
+
+  for(int l = 0; l < 4; l++)
+    for(size_t i = 0; i < updates[l]->size(); i++)
+      if((*updates[l])[i]) (*updates[l])[i]((*proxs[l])[i].get());
+
+  if(update.scaling_alpha)
+    problem.SetScalingAlpha(update.alpha);
 }
 
 Solver<real>::Options 
@@ -919,13 +1527,79 @@ CreateSolverOptions(const mxArray *pm)
   opts.tol_rel_dual =       GetScalarFromField<real>(pm, "tol_rel_dual");
   opts.tol_abs_primal =     GetScalarFromField<real>(pm, "tol_abs_primal");
   opts.tol_abs_dual =       GetScalarFromField<real>(pm, "tol_abs_dual");
+  opts.tol_gap =            GetScalarFromField<real>(pm, "tol_gap");
   opts.max_iters =          GetScalarFromField<int>(pm,  "max_iters");
   opts.num_cback_calls =    GetScalarFromField<int>(pm,  "num_cback_calls");
   opts.verbose =            GetScalarFromField<bool>(pm, "verbose");
   opts.solve_dual_problem = GetScalarFromField<bool>(pm, "solve_dual");
+  opts.use_cuda_graph =     GetScalarFromField<bool>(pm, "use_cuda_graph");
+  opts.async_convergence_check = GetScalarFromField<bool>(pm, "async_convergence_check");
+  opts.adaptive_residuals = GetScalarFromField<bool>(pm, "adaptive_residuals");
+  opts.max_residual_iter = GetScalarFromField<int>(pm, "max_residual_iter");
+  opts.async_snapshots = GetScalarFromField<bool>(pm, "async_snapshots");
+  opts.profile = GetScalarFromField<bool>(pm, "profile");
+  opts.autotune_launches = GetScalarFromField<bool>(pm, "autotune_launches");
+  opts.presolve = GetScalarFromField<bool>(pm, "presolve");
+  opts.history_size = GetScalarFromField<int>(pm, "history_size");
+  opts.history_every_iter = GetScalarFromField<bool>(pm, "history_every_iter");
+  opts.checkpoint_iter = GetScalarFromField<int>(pm, "checkpoint_iter");
+  opts.resume = GetScalarFromField<bool>(pm, "resume");
+
+  const mxArray *checkpoint_file = mxGetField(pm, 0, "checkpoint_file");
+  if(checkpoint_file != nullptr && mxIsChar(checkpoint_file) && !mxIsEmpty(checkpoint_file))
+    opts.checkpoint_file = std::string(mxArrayToString(checkpoint_file));
+
+  std::string dense_math(mxArrayToString(mxGetField(pm, 0, "dense_math")));
+
+  if(dense_math == "default")
+    opts.dense_math = DenseMath::kDefault;
+  else if(dense_math == "tf32")
+    opts.dense_math = DenseMath::kTF32;
+  else if(dense_math == "fp16")
+    opts.dense_math = DenseMath::kFP16;
+  else
+    throw Exception("Dense math mode not recognized. Options are {'default', 'tf32', 'fp16'}.");
+
+  std::string operator_memory(mxArrayToString(mxGetField(pm, 0, "operator_memory")));
+
+  if(operator_memory == "device")
+    opts.operator_memory = OperatorMemory::kDevice;
+  else if(operator_memory == "managed")
+    opts.operator_memory = OperatorMemory::kManaged;
+  else if(operator_memory == "auto")
+    opts.operator_memory = OperatorMemory::kAuto;
+  else
+    throw Exception("Operator memory not recognized. Options are {'device', 'managed', 'auto'}.");
+
+  // gpuArray iterates are read by the backend directly from the device
+  opts.x0_device = nullptr;
+  opts.y0_device = nullptr;
+  opts.host_solution = !GetScalarFromField<bool>(pm, "gpu_arrays");
+
+  const mxArray *x0 = mxGetField(pm, 0, "x0");
+  const mxArray *y0 = mxGetField(pm, 0, "y0");
+
+  if(mxIsGPUArray(x0) || mxIsGPUArray(y0))
+  {
+    if(!gpu_arrays_enabled)
+      throw Exception("gpuArray inputs require the option gpu_arrays.");
+  }
 
-  if(mxGetM(mxGetField(pm, 0, "x0")) > 0) opts.x0 = GetVector<real>(mxGetField(pm, 0, "x0"));
-  if(mxGetM(mxGetField(pm, 0, "y0")) > 0) opts.y0 = GetVector<real>(mxGetField(pm, 0, "y0"));
+  if(mxIsGPUArray(x0))
+  {
+    gpu_inputs.push_back(std::shared_ptr<GPUInput>(new GPUInput(x0)));
+    opts.x0_device = gpu_inputs.back()->data();
+  }
+  else if(mxGetM(x0) > 0) 
+    opts.x0 = GetVector<real>(x0);
+
+  if(mxIsGPUArray(y0))
+  {
+    gpu_inputs.push_back(std::shared_ptr<GPUInput>(new GPUInput(y0)));
+    opts.y0_device = gpu_inputs.back()->data();
+  }
+  else if(mxGetM(y0) > 0) 
+    opts.y0 = GetVector<real>(y0);
 
   Solver_interm_cb_handle = mxGetField(pm, 0, "interm_cb");
 
@@ -946,10 +1620,26 @@ map<string, function<prost::Block<real>*(size_t, size_t, const mxArray*)>>& get_
   return block_reg;
 }
 
+map<string, function<ProxUpdate(prost::Prox<real>*, size_t, const mxArray*)>>& get_prox_update_reg()
+{
+  static map<string, function<ProxUpdate(Prox<real>*, size_t, const mxArray*)>> prox_update_reg;
+
+  return prox_update_reg;
+}
+
+map<string, function<BlockUpdate(prost::Block<real>*, const mxArray*)>>& get_block_update_reg()
+{
+  static map<string, function<BlockUpdate(Block<real>*, const mxArray*)>> block_update_reg;
+
+  return block_update_reg;
+}
+
 struct InitRegistries {
   InitRegistries() {
     get_prox_reg().insert(default_prox_reg.begin(), default_prox_reg.end());
     get_block_reg().insert(default_block_reg.begin(), default_block_reg.end());
+    get_prox_update_reg().insert(default_prox_update_reg.begin(), default_prox_update_reg.end());
+    get_block_update_reg().insert(default_block_update_reg.begin(), default_block_update_reg.end());
   }
 };
 
@@ -10,16 +10,22 @@
 #include "prost/linop/block_gradient3d.hpp"
 #include "prost/linop/block_id_kron_dense.hpp"
 #include "prost/linop/block_id_kron_sparse.hpp"
+#include "prost/linop/block_product.hpp"
 #include "prost/linop/block_sparse.hpp"
+#include "prost/linop/block_sparse_half.hpp"
 #include "prost/linop/block_sparse_kron_id.hpp"
+#include "prost/linop/block_sum.hpp"
 #include "prost/linop/block_zero.hpp"
 
 #include "prost/backend/backend.hpp"
 #include "prost/backend/backend_admm.hpp"
+#include "prost/backend/backend_host.hpp"
 #include "prost/backend/backend_pdhg.hpp"
+#include "prost/backend/backend_spdhg.hpp"
 
 #include "prost/prox/prox.hpp"
 #include "prost/prox/prox_elem_operation.hpp"
+#include "prost/prox/prox_elem_operation_jit.hpp"
 #include "prost/prox/elemop/elem_operation_1d.hpp"
 #include "prost/prox/elemop/elem_operation_norm2.hpp"
 #include "prost/prox/elemop/elem_operation_ind_simplex.hpp"
@@ -48,6 +54,7 @@
 // has to be included at end, otherwise 
 // some compiler problems with std::printf 
 #include "mex.h"
+#include "gpu/mxGPUArray.h"
 #include "config.hpp"
 
 namespace matlab
@@ -61,14 +68,86 @@ using std::map;
 
 bool SolverIntermCallback(int iter, const vector<real>& primal, const vector<real>& dual);
 
+// Calls the MATLAB callback with the solution as gpuArrays, copied on the
+// device. Requires SetGPUArraysEnabled(true).
+bool SolverDeviceIntermCallback(int iter, const prost::Solver<real>::DeviceSolution& sol);
+
+// MATLAB function handle called by SolverIntermCallback and
+// SolverDeviceIntermCallback.
+extern mxArray *Solver_interm_cb_handle;
+
+// The blocks and proxs of a problem in the order of its description, 
+// kept to update their data in place after Problem::Initialize().
+struct ProblemParts
+{
+  vector<shared_ptr<prost::Block<real>>> blocks;
+  vector<shared_ptr<prost::Prox<real>>> prox_g;
+  vector<shared_ptr<prost::Prox<real>>> prox_f;
+  vector<shared_ptr<prost::Prox<real>>> prox_gstar;
+  vector<shared_ptr<prost::Prox<real>>> prox_fstar;
+};
+
 shared_ptr<prost::Prox<real>>    CreateProx(const mxArray *pm);
 shared_ptr<prost::Block<real>>   CreateBlock(const mxArray *pm);
 shared_ptr<prost::Backend<real>> CreateBackend(const mxArray *pm);
-shared_ptr<prost::Problem<real>> CreateProblem(const mxArray *pm, size_t nrows, size_t ncols);
+shared_ptr<prost::Problem<real>> CreateProblem(const mxArray *pm, size_t nrows, size_t ncols, ProblemParts *parts = nullptr);
 prost::Solver<real>::Options     CreateSolverOptions(const mxArray *pm);
 
+// Sets the scaling given in the problem description pm.
+void SetProblemScaling(const mxArray *pm, prost::Problem<real>& problem);
+
+// Reads a cell array and writes its contents into a vector. A 2d cell array
+// gets linearized.
+std::vector<const mxArray*> GetCellArray(const mxArray *cell_array);
+
+// Replaces the data of a block or prox in place, created from a description
+// by the update functions in get_prox_update_reg(). The target has to be
+// of the type the update was parsed for.
+typedef function<void(prost::Prox<real>*)>  ProxUpdate;
+typedef function<void(prost::Block<real>*)> BlockUpdate;
+
+// Data of a problem description with the same structure as the one of
+// ProblemParts, one update per block and prox (empty if it has none).
+// Parsing uses the MATLAB API and has to run on the main thread, the
+// update can then be applied to several copies of the problem.
+struct ProblemUpdate
+{
+  vector<BlockUpdate> blocks;
+  vector<ProxUpdate> prox_g;
+  vector<ProxUpdate> prox_f;
+  vector<ProxUpdate> prox_gstar;
+  vector<ProxUpdate> prox_fstar;
+
+  // alpha of the scaling, if it is set to "alpha"
+  bool scaling_alpha;
+  real alpha;
+};
+
+ProxUpdate    ParseProxUpdate(prost::Prox<real>& prox, const mxArray *pm);
+BlockUpdate   ParseBlockUpdate(prost::Block<real>& block, const mxArray *pm);
+ProblemUpdate ParseProblemUpdate(const ProblemParts& parts, const mxArray *pm);
+
+// Applies the update to the blocks and proxs of parts, which belong to
+// problem. Problem::Update() has to be called afterwards.
+void ApplyProblemUpdate(const ProblemUpdate& update, const ProblemParts& parts, prost::Problem<real>& problem);
+
+// gpuArrays are only accepted if enabled, as the device is then shared 
+// with MATLAB and must not be reset.
+void SetGPUArraysEnabled(bool enabled);
+
+// Frees the gpuArray inputs the last solver options point to.
+void ReleaseGPUInputs();
+
+// Class of the gpuArrays holding values of type real.
+mxClassID GetRealClassID();
+
+// Creates a gpuArray column vector of type real without initializing it.
+mxGPUArray *CreateGPUVector(size_t n);
+
 map<string, function<prost::Prox<real>*(size_t, size_t, bool, const mxArray*)>>& get_prox_reg();
 map<string, function<prost::Block<real>*(size_t, size_t, const mxArray*)>>& get_block_reg();
+map<string, function<ProxUpdate(prost::Prox<real>*, size_t, const mxArray*)>>& get_prox_update_reg();
+map<string, function<BlockUpdate(prost::Block<real>*, const mxArray*)>>& get_block_update_reg();
 
 // prox operator create functions
 prost::ProxIndRange<real>*
@@ -91,6 +170,9 @@ CreateProxElemOperationIndSimplex(size_t idx, size_t size, bool diagsteps, const
 
 prost::ProxElemOperation<real, prost::ElemOperationIndSum<real> >* 
 CreateProxElemOperationIndSum(size_t idx, size_t size, bool diagsteps, const mxArray *data);
+
+prost::ProxElemOperationJIT<real>* 
+CreateProxElemOperationJIT(size_t idx, size_t size, bool diagsteps, const mxArray *data);
   
 template<class FUN_2D>
 prost::ProxElemOperation<real, prost::ElemOperationSingularNx2<real, FUN_2D> >*
@@ -127,6 +209,18 @@ CreateProxTransform(size_t idx, size_t size, bool diagsteps, const mxArray *data
 prost::ProxZero<real>*
 CreateProxZero(size_t idx, size_t size, bool diagsteps, const mxArray *data);
 
+// prox operator update functions
+template<class FUN_1D>
+ProxUpdate UpdateProxElemOperation1D(prost::Prox<real> *prox, size_t size, const mxArray *data);
+
+template<class FUN_1D>
+ProxUpdate UpdateProxElemOperationNorm2(prost::Prox<real> *prox, size_t size, const mxArray *data);
+
+template<class FUN_2D>
+ProxUpdate UpdateProxElemOperationSingularNx2(prost::Prox<real> *prox, size_t size, const mxArray *data);
+
+ProxUpdate UpdateProxTransform(prost::Prox<real> *prox, size_t size, const mxArray *data);
+
 // block create functions
 prost::BlockDense<real>*
 CreateBlockDense(size_t row, size_t col, const mxArray *pm);
@@ -140,6 +234,9 @@ CreateBlockZero(size_t row, size_t col, const mxArray *data);
 prost::BlockSparse<real>*
 CreateBlockSparse(size_t row, size_t col, const mxArray *data);
 
+prost::BlockSparseHalf<real>*
+CreateBlockSparseHalf(size_t row, size_t col, const mxArray *data);
+
 prost::BlockIdKronSparse<real>*
 CreateBlockIdKronSparse(size_t row, size_t col, const mxArray *data);
 
@@ -157,7 +254,16 @@ CreateBlockIdKronDense(size_t row, size_t col, const mxArray *pm);
 
 prost::BlockDenseKronId<real>*
 CreateBlockDenseKronId(size_t row, size_t col, const mxArray *pm);
+
+prost::BlockProduct<real>*
+CreateBlockProduct(size_t row, size_t col, const mxArray *pm);
+
+prost::BlockSum<real>*
+CreateBlockSum(size_t row, size_t col, const mxArray *pm);
   
+// block update functions
+BlockUpdate UpdateBlockDiags(prost::Block<real> *block, const mxArray *pm);
+
 // backends
 prost::BackendPDHG<real>* 
 CreateBackendPDHG(const mxArray *data);
@@ -165,6 +271,12 @@ CreateBackendPDHG(const mxArray *data);
 prost::BackendADMM<real>* 
 CreateBackendADMM(const mxArray *data);
 
+prost::BackendHost<real>* 
+CreateBackendHost(const mxArray *data);
+
+prost::BackendSPDHG<real>* 
+CreateBackendSPDHG(const mxArray *data);
+
 } // namespace matlab
 
 #endif // MATLAB_FACTORY_HPP_
@@ -1,11 +1,19 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "prost/batch_solver.hpp"
 #include "prost/common.hpp"
 #include "prost/exception.hpp"
+#include "prost/jit.hpp"
+#include "prost/problem_file.hpp"
+#include "prost/sweep_solver.hpp"
 #include "factory.hpp"
 
 using namespace matlab; 
@@ -65,108 +73,749 @@ static bool MexStoppingCallback() {
   return false;
 }
 
-static void SolveProblem(MEX_ARGS) {
+// Copies a host vector into a newly created gpuArray.
+static mxArray *CreateGPUVectorFromHost(const std::vector<real>& v) {
+  mxGPUArray *array = CreateGPUVector(v.size());
+  cudaMemcpy(mxGPUGetData(array), v.data(), v.size() * sizeof(real), cudaMemcpyHostToDevice);
+  mxArray *result = mxGPUCreateMxArrayOnGPU(array);
+  mxGPUDestroyGPUArray(array);
+  return result;
+}
+
+// Copies the solution, profile and history of the last solve into a
+// MATLAB struct. The solution is returned as gpuArrays if gpu_arrays is set.
+static mxArray *CreateResult(Solver<real>& solver, 
+                             Solver<real>::ConvergenceResult result,
+                             bool gpu_arrays) {
+  // the problem is still dualized if solve_dual was set, take the sizes
+  // from the solution
+  mxArray *mex_primal_sol;
+  mxArray *mex_primal_constr_sol;
+  mxArray *mex_dual_sol;
+  mxArray *mex_dual_constr_sol;
+  mxArray *result_string;
+
+  if(gpu_arrays && solver.device_solution())
+  {
+    // copy the iterates on the device, the host solution was not fetched
+    mxGPUArray *x = CreateGPUVector(solver.cur_primal_sol().size());
+    mxGPUArray *z = CreateGPUVector(solver.cur_primal_constr_sol().size());
+    mxGPUArray *y = CreateGPUVector(solver.cur_dual_sol().size());
+    mxGPUArray *w = CreateGPUVector(solver.cur_dual_constr_sol().size());
+
+    solver.CopySolutionDevice(
+      reinterpret_cast<real *>(mxGPUGetData(x)),
+      reinterpret_cast<real *>(mxGPUGetData(z)),
+      reinterpret_cast<real *>(mxGPUGetData(y)),
+      reinterpret_cast<real *>(mxGPUGetData(w)));
+
+    mex_primal_sol = mxGPUCreateMxArrayOnGPU(x);
+    mex_primal_constr_sol = mxGPUCreateMxArrayOnGPU(z);
+    mex_dual_sol = mxGPUCreateMxArrayOnGPU(y);
+    mex_dual_constr_sol = mxGPUCreateMxArrayOnGPU(w);
+
+    mxGPUDestroyGPUArray(x);
+    mxGPUDestroyGPUArray(z);
+    mxGPUDestroyGPUArray(y);
+    mxGPUDestroyGPUArray(w);
+  }
+  else if(gpu_arrays)
+  {
+    mex_primal_sol = CreateGPUVectorFromHost(solver.cur_primal_sol());
+    mex_primal_constr_sol = CreateGPUVectorFromHost(solver.cur_primal_constr_sol());
+    mex_dual_sol = CreateGPUVectorFromHost(solver.cur_dual_sol());
+    mex_dual_constr_sol = CreateGPUVectorFromHost(solver.cur_dual_constr_sol());
+  }
+  else
+  {
+    mex_primal_sol = mxCreateDoubleMatrix(solver.cur_primal_sol().size(), 1, mxREAL);
+    mex_primal_constr_sol = mxCreateDoubleMatrix(solver.cur_primal_constr_sol().size(), 1, mxREAL);
+    mex_dual_sol = mxCreateDoubleMatrix(solver.cur_dual_sol().size(), 1, mxREAL);
+    mex_dual_constr_sol = mxCreateDoubleMatrix(solver.cur_dual_constr_sol().size(), 1, mxREAL);
+
+    std::copy(solver.cur_dual_sol().begin(),
+              solver.cur_dual_sol().end(),
+              (double *)mxGetPr(mex_dual_sol));
+
+    std::copy(solver.cur_primal_sol().begin(),
+              solver.cur_primal_sol().end(),
+              (double *)mxGetPr(mex_primal_sol));
+
+    std::copy(solver.cur_primal_constr_sol().begin(),
+              solver.cur_primal_constr_sol().end(),
+              (double *)mxGetPr(mex_primal_constr_sol));
+
+    std::copy(solver.cur_dual_constr_sol().begin(),
+              solver.cur_dual_constr_sol().end(),
+              (double *)mxGetPr(mex_dual_constr_sol));
+  }
+
+  switch(result)
+  {
+    case Solver<real>::ConvergenceResult::kConverged:
+      result_string = mxCreateString("Converged.");
+      break;
+
+    case Solver<real>::ConvergenceResult::kStoppedMaxIters:
+      result_string = mxCreateString("Reached maximum iterations.");
+      break;
+
+    case Solver<real>::ConvergenceResult::kStoppedUser:
+      result_string = mxCreateString("Stopped by user.");
+      break;
+  }
+
+  // per-component GPU times, empty if profiling is disabled
+  const char *profile_fieldnames[5] = {
+    "name",
+    "calls",
+    "time_ms",
+    "bytes",
+    "bandwidth_gbs"
+  };
+
+  const std::vector<Profiler::Entry>& profile = solver.profile();
+  mxArray *mex_profile = mxCreateStructMatrix(profile.size(), 1, 5, profile_fieldnames);
+
+  for(size_t i = 0; i < profile.size(); i++)
+  {
+    mxSetFieldByNumber(mex_profile, i, 0, mxCreateString(profile[i].name.c_str()));
+    mxSetFieldByNumber(mex_profile, i, 1, mxCreateDoubleScalar(profile[i].calls));
+    mxSetFieldByNumber(mex_profile, i, 2, mxCreateDoubleScalar(profile[i].time_ms));
+    mxSetFieldByNumber(mex_profile, i, 3, mxCreateDoubleScalar(profile[i].bytes));
+    mxSetFieldByNumber(mex_profile, i, 4, mxCreateDoubleScalar(profile[i].bandwidth()));
+  }
+
+  // convergence history as one column per quantity, empty if disabled
+  const char *history_fieldnames[11] = {
+    "iteration",
+    "primal_residual",
+    "dual_residual",
+    "eps_primal",
+    "eps_dual",
+    "tau",
+    "sigma",
+    "theta",
+    "rho",
+    "cg_iters",
+    "dropped"
+  };
+
+  const std::vector<HistoryEntry<real> >& history = solver.history();
+  mxArray *mex_history = mxCreateStructMatrix(1, 1, 11, history_fieldnames);
+
+  for(int f = 0; f < 10; f++)
+  {
+    mxArray *col = mxCreateDoubleMatrix(history.size(), 1, mxREAL);
+    double *data = (double *)mxGetPr(col);
+
+    for(size_t i = 0; i < history.size(); i++)
+    {
+      const HistoryEntry<real>& e = history[i];
+      const double values[10] = { 
+        (double)e.iteration, e.primal_residual, e.dual_residual, e.eps_primal, e.eps_dual,
+        e.tau, e.sigma, e.theta, e.rho, (double)e.cg_iters };
+
+      data[i] = values[f];
+    }
+
+    mxSetFieldByNumber(mex_history, 0, f, col);
+  }
+
+  mxSetFieldByNumber(mex_history, 0, 10, mxCreateDoubleScalar(solver.history_dropped()));
+
+  const char *fieldnames[8] = {
+    "x",
+    "y",
+    "z",
+    "w",
+    "result",
+    "profile",
+    "history",
+    "gap"
+  };
+
+  mxArray *mex_result = mxCreateStructMatrix(1, 1, 8, fieldnames);
+
+  mxSetFieldByNumber(mex_result, 0, 0, mex_primal_sol);
+  mxSetFieldByNumber(mex_result, 0, 1, mex_dual_sol);
+  mxSetFieldByNumber(mex_result, 0, 2, mex_primal_constr_sol);
+  mxSetFieldByNumber(mex_result, 0, 3, mex_dual_constr_sol);
+  mxSetFieldByNumber(mex_result, 0, 4, result_string);
+  mxSetFieldByNumber(mex_result, 0, 5, mex_profile);
+  mxSetFieldByNumber(mex_result, 0, 6, mex_history);
+  mxSetFieldByNumber(mex_result, 0, 7, mxCreateDoubleScalar(solver.primal_dual_gap()));
+
+  return mex_result;
+}
+
+// Problems created by create_problem. They stay initialized on the GPU
+// between MEX calls until they are freed by release_problem or release.
+struct ProblemHandle {
+  ProblemHandle() : interm_cb(nullptr), device(0), gpu_arrays(false), presolve(false), updated(false) { }
+
+  ~ProblemHandle() {
+    if(solver)
+      solver->Release();
+
+    if(interm_cb)
+      mxDestroyArray(interm_cb);
+  }
+
+  std::shared_ptr<Problem<real> > problem;
+  std::shared_ptr<Backend<real> > backend;
+  std::shared_ptr<Solver<real> > solver;
+  ProblemParts parts;
+
+  // persistent copy of the intermediate callback of the options
+  mxArray *interm_cb;
+
+  int device;
+  bool gpu_arrays;
+  bool presolve;
+
+  // data was changed by update since the last solve
+  bool updated;
+};
+
+static std::map<int, std::shared_ptr<ProblemHandle> > problem_handles;
+static int next_problem_handle = 1;
+
+// Selects the device for a new solve. The device is only reset if no
+// problem handles are resident, as the reset would free their memory.
+static void SelectDevice(bool gpu_arrays) {
+  // with gpu_arrays the solver runs in the device context of MATLAB's
+  // gpuArrays, which must not be reset.
+  if(gpu_arrays)
+  {
+    SetGPUArraysEnabled(true);
+    cudaGetDevice(&current_gpu_device);
+    return;
+  }
+
   cudaError_t error = cudaSetDevice(current_gpu_device);
-  cudaDeviceReset();
   if(error != cudaSuccess)
     throw Exception("Invalid CUDA device.");
 
-  BlockDiags<real>::ResetConstMem();
+  if(problem_handles.empty())
+  {
+    cudaDeviceReset();
+    BlockDiags<real>::ResetConstMem();
+  }
+}
+
+static bool GetGPUArraysOption(const mxArray *opts) {
+  const mxArray *gpu_arrays = mxGetField(opts, 0, "gpu_arrays");
+  return (gpu_arrays != nullptr) && (mxGetScalar(gpu_arrays) != 0);
+}
+
+static void PrintDevice() {
+  std::cout << "prost v" << prost::get_version().c_str() << std::endl;
+  cudaDeviceProp prop;
+  cudaGetDeviceProperties(&prop, current_gpu_device);
+  int sm_per_multiproc = _ConvertSMVer2Cores(prop.major, prop.minor);
+  printf("Running on device number %d: %s (%.1f GB, %d Cores), float precision: %d bit.\n", current_gpu_device, prop.name, (double)prop.totalGlobalMem/(1024.*1024*1024), prop.multiProcessorCount * sm_per_multiproc, sizeof(real) * 8);
+}
+
+static std::shared_ptr<ProblemHandle> GetProblemHandle(const mxArray *p) {
+  auto it = problem_handles.find(static_cast<int>(mxGetScalar(p)));
+
+  if(it == problem_handles.end())
+    throw Exception("Invalid problem handle, it was released or not created.");
+
+  return it->second;
+}
+
+// Creates and initializes the problem, backend and solver of a handle.
+static std::shared_ptr<ProblemHandle> CreateHandle(const mxArray **prhs) {
+  std::shared_ptr<ProblemHandle> handle(new ProblemHandle);
 
   size_t nrows = static_cast<size_t>(mxGetScalar(prhs[1]));
   size_t ncols = static_cast<size_t>(mxGetScalar(prhs[2]));
 
-  std::shared_ptr<Problem<real> > problem = CreateProblem(prhs[0], nrows, ncols);
-  std::shared_ptr<Backend<real> > backend = CreateBackend(prhs[3]);
+  handle->problem = CreateProblem(prhs[0], nrows, ncols, &handle->parts);
+  handle->backend = CreateBackend(prhs[3]);
   Solver<real>::Options opts = CreateSolverOptions(prhs[4]);
 
-  if(opts.verbose) {
-    std::cout << "prost v" << prost::get_version().c_str() << std::endl;
-    cudaDeviceProp prop;
-    cudaGetDeviceProperties(&prop, current_gpu_device);
-    int sm_per_multiproc = _ConvertSMVer2Cores(prop.major, prop.minor);
-    printf("Running on device number %d: %s (%.1f GB, %d Cores), float precision: %d bit.\n", current_gpu_device, prop.name, (double)prop.totalGlobalMem/(1024.*1024*1024), prop.multiProcessorCount * sm_per_multiproc, sizeof(real) * 8);
-  }
+  if(opts.verbose)
+    PrintDevice();
 
-  std::shared_ptr<Solver<real> > solver( new Solver<real>(problem, backend) );
+  std::shared_ptr<Solver<real> > solver( new Solver<real>(handle->problem, handle->backend) );
   solver->SetOptions(opts);
-  solver->SetIntermCallback(SolverIntermCallback);
   solver->SetStoppingCallback(MexStoppingCallback);
 
+  // the gpuArray callback keeps the solution on the device
+  const mxArray *interm_cb_gpu = mxGetField(prhs[4], 0, "interm_cb_gpu");
+  if((interm_cb_gpu != nullptr) && (mxGetScalar(interm_cb_gpu) != 0))
+  {
+    if(!GetGPUArraysOption(prhs[4]))
+      throw Exception("The option interm_cb_gpu requires the option gpu_arrays.");
+
+    solver->SetDeviceIntermCallback(SolverDeviceIntermCallback);
+  }
+  else
+    solver->SetIntermCallback(SolverIntermCallback);
+
   solver->Initialize();
 
-  Solver<real>::ConvergenceResult result = solver->Solve();
+  handle->solver = solver;
+  handle->device = current_gpu_device;
+  handle->presolve = opts.presolve;
 
-  // Copy result back to MATLAB
-  mxArray *mex_primal_sol = mxCreateDoubleMatrix(problem->ncols(), 1, mxREAL);
-  mxArray *mex_primal_constr_sol = mxCreateDoubleMatrix(problem->nrows(), 1, mxREAL);
-  mxArray *mex_dual_sol = mxCreateDoubleMatrix(problem->nrows(), 1, mxREAL);
-  mxArray *mex_dual_constr_sol = mxCreateDoubleMatrix(problem->ncols(), 1, mxREAL);
-  mxArray *result_string;
+  return handle;
+}
 
-  switch(result)
+// Solves a problem written by prost.write_problem, as the native loader
+// reads it.
+static void SolveFile(MEX_ARGS) {
+  if(nrhs != 1)
+    throw Exception("solve_file: One input required.");
+
+  char *path = mxArrayToString(prhs[0]);
+  if(path == nullptr)
+    throw Exception("solve_file: The file name has to be a string.");
+
+  std::string filename(path);
+  mxFree(path);
+
+  SelectDevice(false);
+
+  ProblemFile<real> file(filename);
+  Solver<real>::Options opts = file.CreateSolverOptions();
+
+  if(opts.verbose)
+    PrintDevice();
+
+  Solver<real> solver(file.CreateProblem(), file.CreateBackend());
+  solver.SetOptions(opts);
+  solver.Initialize();
+
+  Solver<real>::ConvergenceResult result = solver.Solve();
+  plhs[0] = CreateResult(solver, result, false);
+  solver.Release();
+}
+
+static void SolveProblem(MEX_ARGS) {
+  const bool gpu_arrays = GetGPUArraysOption(prhs[4]);
+
+  SelectDevice(gpu_arrays);
+
+  try
   {
-    case Solver<real>::ConvergenceResult::kConverged:
-      result_string = mxCreateString("Converged.");
-      break;
+    std::shared_ptr<ProblemHandle> handle = CreateHandle(prhs);
+    ReleaseGPUInputs();
 
-    case Solver<real>::ConvergenceResult::kStoppedMaxIters:
-      result_string = mxCreateString("Reached maximum iterations.");
-      break;
+    Solver<real>::ConvergenceResult result = handle->solver->Solve();
+    plhs[0] = CreateResult(*handle->solver, result, gpu_arrays);
+  }
+  catch(...)
+  {
+    ReleaseGPUInputs();
+    SetGPUArraysEnabled(false);
+    throw;
+  }
 
-    case Solver<real>::ConvergenceResult::kStoppedUser:
-      result_string = mxCreateString("Stopped by user.");
-      break;
+  SetGPUArraysEnabled(false);
+}
+
+static void CreateProblemHandle(MEX_ARGS) {
+  if(nrhs != 5)
+    throw Exception("create_problem: Five inputs required.");
+
+  const bool gpu_arrays = GetGPUArraysOption(prhs[4]);
+
+  SelectDevice(gpu_arrays);
+
+  std::shared_ptr<ProblemHandle> handle;
+
+  try
+  {
+    handle = CreateHandle(prhs);
+  }
+  catch(...)
+  {
+    ReleaseGPUInputs();
+    SetGPUArraysEnabled(false);
+    throw;
+  }
+
+  ReleaseGPUInputs();
+  SetGPUArraysEnabled(false);
+
+  handle->gpu_arrays = gpu_arrays;
+  if(Solver_interm_cb_handle)
+  {
+    handle->interm_cb = mxDuplicateArray(Solver_interm_cb_handle);
+    mexMakeArrayPersistent(handle->interm_cb);
+  }
+
+  // keep the MEX file, and with it the handles, loaded
+  mexLock();
+
+  const int id = next_problem_handle++;
+  problem_handles[id] = handle;
+
+  plhs[0] = mxCreateDoubleScalar(id);
+}
+
+static void UpdateProblemHandle(MEX_ARGS) {
+  if(nrhs != 2)
+    throw Exception("update: Two inputs required.");
+
+  std::shared_ptr<ProblemHandle> handle = GetProblemHandle(prhs[0]);
+
+  // the reduced problem does not see updates of the original one
+  if(handle->presolve)
+    throw Exception("update: Problems created with presolve cannot be updated.");
+
+  cudaSetDevice(handle->device);
+
+  ProblemUpdate update = ParseProblemUpdate(handle->parts, prhs[1]);
+  ApplyProblemUpdate(update, handle->parts, *handle->problem);
+  handle->problem->Update();
+  handle->updated = true;
+}
+
+static void ResolveProblemHandle(MEX_ARGS) {
+  if(nrhs != 1)
+    throw Exception("resolve: One input required.");
+
+  std::shared_ptr<ProblemHandle> handle = GetProblemHandle(prhs[0]);
+
+  cudaSetDevice(handle->device);
+
+  if(handle->gpu_arrays)
+    SetGPUArraysEnabled(true);
+
+  Solver_interm_cb_handle = handle->interm_cb;
+
+  try
+  {
+    // starts from the last iterate, Resolve() also lets the backend
+    // refresh the data derived from the problem
+    Solver<real>::ConvergenceResult result = 
+      handle->updated ? handle->solver->Resolve() : handle->solver->Solve();
+
+    handle->updated = false;
+
+    plhs[0] = CreateResult(*handle->solver, result, handle->gpu_arrays);
+  }
+  catch(...)
+  {
+    SetGPUArraysEnabled(false);
+    throw;
+  }
+
+  SetGPUArraysEnabled(false);
+}
+
+static void ReleaseProblemHandle(MEX_ARGS) {
+  if(nrhs != 1)
+    throw Exception("release_problem: One input required.");
+
+  std::shared_ptr<ProblemHandle> handle = GetProblemHandle(prhs[0]);
+  
+  cudaSetDevice(handle->device);
+
+  problem_handles.erase(static_cast<int>(mxGetScalar(prhs[0])));
+  handle.reset();
+
+  mexUnlock();
+}
+
+// Solves the problem for every point of a parameter sweep on one or more
+// devices. Inputs: prob, nrows, ncols, backend or a cell with a backend
+// per point, opts, a cell with the problem data of each point and 
+// optionally the devices.
+static void Sweep(MEX_ARGS) {
+  if(nrhs < 6)
+    throw Exception("sweep: At least six inputs required.");
+
+  if(GetGPUArraysOption(prhs[4]))
+    throw Exception("sweep: The option gpu_arrays is not supported.");
+
+  const mxArray *cell_points = prhs[5];
+  const size_t num_points = mxGetNumberOfElements(cell_points);
+  const bool backend_per_point = mxIsCell(prhs[3]);
+
+  if(backend_per_point && mxGetNumberOfElements(prhs[3]) != num_points)
+    throw Exception("sweep: One backend per point required.");
+
+  std::vector<int> devices;
+  if(nrhs > 6 && !mxIsEmpty(prhs[6]))
+  {
+    const double *ids = mxGetPr(prhs[6]);
+    devices.assign(ids, ids + mxGetNumberOfElements(prhs[6]));
+  }
+  else
+    devices.push_back(current_gpu_device);
+
+  size_t nrows = static_cast<size_t>(mxGetScalar(prhs[1]));
+  size_t ncols = static_cast<size_t>(mxGetScalar(prhs[2]));
+
+  // All MATLAB data is read here, the device threads must not call into
+  // MATLAB. Every device gets its own copy of the problem, the updates
+  // of the points are parsed once and applied to the copies.
+  std::vector<std::shared_ptr<Problem<real> > > problems(devices.size());
+  std::vector<ProblemParts> parts(devices.size());
+  std::map<Problem<real> *, size_t> problem_index;
+
+  for(size_t d = 0; d < devices.size(); d++)
+  {
+    problems[d] = CreateProblem(prhs[0], nrows, ncols, &parts[d]);
+    problem_index[problems[d].get()] = d;
+  }
+
+  std::vector<ProblemUpdate> updates;
+  std::vector<std::shared_ptr<Backend<real> > > backends;
+
+  for(size_t p = 0; p < num_points; p++)
+  {
+    updates.push_back(ParseProblemUpdate(parts[0], mxGetCell(cell_points, p)));
+    backends.push_back(CreateBackend(backend_per_point ? mxGetCell(prhs[3], p) : prhs[3]));
+  }
+
+  Solver<real>::Options opts = CreateSolverOptions(prhs[4]);
+  opts.verbose = false;
+  ReleaseGPUInputs();
+
+  SweepSolver<real> sweep(
+    num_points,
+    [&problems](size_t d) { return problems[d]; },
+    [&backends](size_t p) { return backends[p]; },
+    [&](size_t p, Problem<real>& problem) {
+      const size_t d = problem_index.at(&problem);
+      ApplyProblemUpdate(updates[p], parts[d], problem);
+
+      // the backends of the points may differ in their step sizes
+      return backend_per_point;
+    });
+
+  sweep.SetDevices(devices);
+  sweep.SetOptions(opts);
+
+  if(problem_handles.empty())
+  {
+    for(int device : devices)
+    {
+      if(cudaSetDevice(device) != cudaSuccess)
+        throw Exception("sweep: Invalid CUDA device.");
+
+      cudaDeviceReset();
+    }
+
+    BlockDiags<real>::ResetConstMem();
   }
 
-  std::copy(solver->cur_dual_sol().begin(),
-	    solver->cur_dual_sol().end(),
-	    (double *)mxGetPr(mex_dual_sol));
+  // solve in a separate thread, so that Ctrl-C can be polled here
+  std::atomic<bool> done(false);
+  std::exception_ptr error;
+
+  std::thread worker([&] {
+    try
+    {
+      sweep.Solve();
+    }
+    catch(...)
+    {
+      error = std::current_exception();
+    }
+
+    done = true;
+  });
+
+  while(!done)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
 
-  std::copy(solver->cur_primal_sol().begin(),
-	    solver->cur_primal_sol().end(),
-	    (double *)mxGetPr(mex_primal_sol));
+    if(MexStoppingCallback())
+      sweep.Stop();
+  }
 
-  std::copy(solver->cur_primal_constr_sol().begin(),
-            solver->cur_primal_constr_sol().end(),
-            (double *)mxGetPr(mex_primal_constr_sol));
+  worker.join();
+  cudaSetDevice(current_gpu_device);
 
-  std::copy(solver->cur_dual_constr_sol().begin(),
-            solver->cur_dual_constr_sol().end(),
-            (double *)mxGetPr(mex_dual_constr_sol));
+  if(error)
+    std::rethrow_exception(error);
 
-  const char *fieldnames[5] = {
+  const char *fieldnames[6] = {
     "x",
     "y",
     "z",
     "w",
+    "result",
+    "device"
+  };
+
+  plhs[0] = mxCreateStructMatrix(num_points, 1, 6, fieldnames);
+
+  for(size_t p = 0; p < num_points; p++)
+  {
+    const SweepSolver<real>::Result& r = sweep.results()[p];
+    const std::vector<real> *sol[4] = { &r.x, &r.y, &r.z, &r.w };
+
+    for(int f = 0; f < 4; f++)
+    {
+      mxArray *v = mxCreateDoubleMatrix(sol[f]->size(), 1, mxREAL);
+      std::copy(sol[f]->begin(), sol[f]->end(), (double *)mxGetPr(v));
+      mxSetFieldByNumber(plhs[0], p, f, v);
+    }
+
+    // points not reached after a stop are left empty
+    if(r.x.empty())
+      mxSetFieldByNumber(plhs[0], p, 4, mxCreateString("Stopped by user."));
+    else
+    {
+      switch(r.result)
+      {
+        case Solver<real>::ConvergenceResult::kConverged:
+          mxSetFieldByNumber(plhs[0], p, 4, mxCreateString("Converged."));
+          break;
+
+        case Solver<real>::ConvergenceResult::kStoppedMaxIters:
+          mxSetFieldByNumber(plhs[0], p, 4, mxCreateString("Reached maximum iterations."));
+          break;
+
+        case Solver<real>::ConvergenceResult::kStoppedUser:
+          mxSetFieldByNumber(plhs[0], p, 4, mxCreateString("Stopped by user."));
+          break;
+      }
+    }
+
+    mxSetFieldByNumber(plhs[0], p, 5, mxCreateDoubleScalar(r.device));
+  }
+}
+
+// Replaces the index in cell i of a block or prox description by the
+// index shifted by offset.
+static void ShiftDescriptionIndex(mxArray *desc, size_t i, size_t offset) {
+  mxArray *index = mxGetCell(desc, i);
+  const double shifted = mxGetScalar(index) + static_cast<double>(offset);
+
+  mxDestroyArray(index);
+  mxSetCell(desc, i, mxCreateDoubleScalar(shifted));
+}
+
+// Adds the blocks and proxs of the problem description pm to problem,
+// moved to the given row and column offsets.
+static void AddShiftedInstance(
+  const mxArray *pm, 
+  size_t row_offset, 
+  size_t col_offset, 
+  Problem<real>& problem) 
+{
+  for(auto& b : GetCellArray(mxGetField(pm, 0, "linop")))
+  {
+    mxArray *desc = mxDuplicateArray(b);
+    ShiftDescriptionIndex(desc, 1, row_offset);
+    ShiftDescriptionIndex(desc, 2, col_offset);
+    problem.AddBlock(CreateBlock(desc));
+    mxDestroyArray(desc);
+  }
+
+  // g acts on the primal variables, f on the dual ones
+  const char *names[4] = { "prox_g", "prox_f", "prox_gstar", "prox_fstar" };
+  const size_t offsets[4] = { col_offset, row_offset, col_offset, row_offset };
+
+  for(int k = 0; k < 4; k++)
+  {
+    for(auto& p : GetCellArray(mxGetField(pm, 0, names[k])))
+    {
+      mxArray *desc = mxDuplicateArray(p);
+      ShiftDescriptionIndex(desc, 1, offsets[k]);
+      std::shared_ptr<Prox<real> > prox = CreateProx(desc);
+      mxDestroyArray(desc);
+
+      switch(k)
+      {
+        case 0: problem.AddProx_g(prox); break;
+        case 1: problem.AddProx_f(prox); break;
+        case 2: problem.AddProx_gstar(prox); break;
+        case 3: problem.AddProx_fstar(prox); break;
+      }
+    }
+  }
+}
+
+static void Batch(MEX_ARGS) {
+  if(nrhs != 5)
+    throw Exception("batch: Five inputs required.");
+
+  if(GetGPUArraysOption(prhs[4]))
+    throw Exception("batch: The option gpu_arrays is not supported.");
+
+  const mxArray *cell_instances = prhs[0];
+  const size_t num_instances = mxGetNumberOfElements(cell_instances);
+
+  if(num_instances == 0)
+    throw Exception("batch: At least one instance required.");
+
+  size_t nrows = static_cast<size_t>(mxGetScalar(prhs[1]));
+  size_t ncols = static_cast<size_t>(mxGetScalar(prhs[2]));
+
+  // the scaling of the first instance is used for the whole batch
+  const mxArray *first = mxGetCell(cell_instances, 0);
+  std::string scaling(mxArrayToString(mxGetField(first, 0, "scaling")));
+  if(scaling == "custom")
+    throw Exception("batch: A custom scaling is not supported.");
+
+  SelectDevice(false);
+
+  Solver<real>::Options opts = CreateSolverOptions(prhs[4]);
+  opts.verbose = false;
+
+  BatchSolver<real> batch(num_instances, nrows, ncols, CreateBackend(prhs[3]));
+  SetProblemScaling(first, *batch.problem());
+  batch.SetOptions(opts);
+  batch.SetStoppingCallback(MexStoppingCallback);
+
+  batch.Initialize(
+    [cell_instances](size_t instance, size_t row_offset, size_t col_offset, Problem<real>& problem) {
+      AddShiftedInstance(mxGetCell(cell_instances, instance), row_offset, col_offset, problem);
+    });
+
+  const Solver<real>::ConvergenceResult result = batch.Solve();
+
+  const char *fieldnames[3] = {
+    "x",
+    "y",
     "result"
   };
 
-  plhs[0] = mxCreateStructMatrix(1, 1, 5, fieldnames);
+  plhs[0] = mxCreateStructMatrix(num_instances, 1, 3, fieldnames);
 
-  mxSetFieldByNumber(plhs[0], 0, 0, mex_primal_sol);
-  mxSetFieldByNumber(plhs[0], 0, 1, mex_dual_sol);
-  mxSetFieldByNumber(plhs[0], 0, 2, mex_primal_constr_sol);
-  mxSetFieldByNumber(plhs[0], 0, 3, mex_dual_constr_sol);
-  mxSetFieldByNumber(plhs[0], 0, 4, result_string);
+  std::vector<real> x, y;
+  for(size_t i = 0; i < num_instances; i++)
+  {
+    batch.instance_primal_sol(i, x);
+    batch.instance_dual_sol(i, y);
+
+    mxArray *mex_x = mxCreateDoubleMatrix(x.size(), 1, mxREAL);
+    mxArray *mex_y = mxCreateDoubleMatrix(y.size(), 1, mxREAL);
+    std::copy(x.begin(), x.end(), (double *)mxGetPr(mex_x));
+    std::copy(y.begin(), y.end(), (double *)mxGetPr(mex_y));
+    mxSetFieldByNumber(plhs[0], i, 0, mex_x);
+    mxSetFieldByNumber(plhs[0], i, 1, mex_y);
+
+    if(batch.instance_converged(i))
+      mxSetFieldByNumber(plhs[0], i, 2, mxCreateString("Converged."));
+    else if(result == Solver<real>::ConvergenceResult::kStoppedUser)
+      mxSetFieldByNumber(plhs[0], i, 2, mxCreateString("Stopped by user."));
+    else
+      mxSetFieldByNumber(plhs[0], i, 2, mxCreateString("Reached maximum iterations."));
+  }
 
-  solver->Release();
+  batch.Release();
 }
 
 static void EvalLinOp(MEX_ARGS) {
-  BlockDiags<real>::ResetConstMem();
-
   if(nrhs != 3)
     throw Exception("eval_lin_op: Three inputs required!");
 
   if(nlhs < 3)
     throw Exception("eval_lin_op: At least three outputs (result, rowsum, colsum) required.");
 
-  cudaError_t error = cudaSetDevice(current_gpu_device);
-  cudaDeviceReset();
-  if(error != cudaSuccess)
-    throw Exception("Invalid CUDA device.");
+  SelectDevice(false);
 
   // read input arguments
   std::shared_ptr<LinearOperator<real> > linop(new LinearOperator<real>());
@@ -206,14 +855,11 @@ static void EvalLinOp(MEX_ARGS) {
   plhs[2] = mxCreateDoubleMatrix(linop->ncols(), 1, mxREAL);
 
   std::copy(res.begin(), res.end(), (double *)mxGetPr(plhs[0]));
-  std::vector<double> rowsum(linop->nrows());
-  std::vector<double> colsum(linop->ncols());
+  std::vector<real> rowsum;
+  std::vector<real> colsum;
 
-  for(size_t row = 0; row < linop->nrows(); row++)
-    rowsum[row] = linop->row_sum(row, 1);
-
-  for(size_t col = 0; col < linop->ncols(); col++)
-    colsum[col] = linop->col_sum(col, 1);
+  linop->RowSums(rowsum, 1);
+  linop->ColSums(colsum, 1);
 
   std::copy(rowsum.begin(), rowsum.end(), (double *)mxGetPr(plhs[1]));
   std::copy(colsum.begin(), colsum.end(), (double *)mxGetPr(plhs[2]));
@@ -230,10 +876,7 @@ static void EvalProx(MEX_ARGS) {
   if(nlhs == 0)
     throw Exception("One output (result of prox) required.");
 
-  cudaError_t error = cudaSetDevice(current_gpu_device);
-  cudaDeviceReset();
-  if(error != cudaSuccess)
-    throw Exception("Invalid CUDA device.");
+  SelectDevice(false);
 
   // check dimensions
   const mwSize *dims = mxGetDimensions(prhs[1]);
@@ -275,11 +918,125 @@ static void EvalProx(MEX_ARGS) {
   pr[0] = milliseconds;
 }
 
+static void EvalProxGap(MEX_ARGS) {
+  if(nrhs < 3)
+    throw Exception("eval_prox_gap: Three inputs (prox, x, y) required.");
+
+  if(nlhs == 0)
+    throw Exception("One output (Fenchel-Young gap) required.");
+
+  SelectDevice(false);
+
+  const size_t n = mxGetM(prhs[1]);
+  if(mxGetN(prhs[1]) != 1 || mxGetM(prhs[2]) != n || mxGetN(prhs[2]) != 1)
+    throw Exception("eval_prox_gap: x and y have to be vectors of the same size.");
+
+  std::shared_ptr<Prox<real>> prox = CreateProx(prhs[0]);
+  prox->Initialize();
+
+  if(prox->size() != n)
+  {
+    stringstream ss;
+    ss << "Size of input argument (" << n << ") doesn't match size of prox (" << prox->size() << ")!\n";
+    throw Exception(ss.str());
+  }
+
+  if(!prox->supports_energy())
+    throw Exception("eval_prox_gap: The energy is not available for this prox.");
+
+  double *x = (double *)mxGetPr(prhs[1]);
+  double *y = (double *)mxGetPr(prhs[2]);
+
+  const thrust::device_vector<real> d_x(x, x + n);
+  const thrust::device_vector<real> d_y(y, y + n);
+  thrust::device_vector<real> d_gap(n, 0);
+
+  prox->EvalGap(d_gap.begin(), d_x, d_y, 1, 1);
+
+  std::vector<real> h_gap(n);
+  thrust::copy(d_gap.begin(), d_gap.end(), h_gap.begin());
+
+  plhs[0] = mxCreateDoubleMatrix(n, 1, mxREAL);
+  std::copy(h_gap.begin(), h_gap.end(), (double *)mxGetPr(plhs[0]));
+}
+
+static void EvalProxList(MEX_ARGS) {
+  if(nrhs < 5)
+    throw Exception("eval_prox_list: Five inputs (proxs, arg, tau, tau_diag, batch) required.");
+
+  if(nlhs == 0)
+    throw Exception("One output (result of proxs) required.");
+
+  if(!mxIsCell(prhs[0]))
+    throw Exception("eval_prox_list: Proxs have to be given as a cell array.");
+
+  SelectDevice(false);
+
+  const size_t n = mxGetM(prhs[1]);
+  if(mxGetN(prhs[1]) != 1 || mxGetNumberOfElements(prhs[3]) != n)
+    throw Exception("Input to prox should be a vector!");
+
+  // the proxs have to cover [0, n) in order, as after CoverDomainProx()
+  Problem<real>::ProxList proxs;
+  size_t next = 0;
+  for(size_t i = 0; i < mxGetNumberOfElements(prhs[0]); i++)
+  {
+    proxs.push_back(CreateProx(mxGetCell(prhs[0], i)));
+
+    if(proxs.back()->index() != next)
+      throw Exception("eval_prox_list: Proxs have to be contiguous and sorted.");
+
+    next = proxs.back()->end() + 1;
+  }
+
+  if(next != n)
+    throw Exception("eval_prox_list: Proxs do not cover the input.");
+
+  // evaluate the list as Problem::Initialize() leaves it
+  if(mxGetScalar(prhs[4]) != 0)
+    Problem<real>::BatchProxes(proxs);
+
+  for(auto& prox : proxs)
+    prox->Initialize();
+
+  double *arg = (double *)mxGetPr(prhs[1]);
+  double *tau_diag = (double *)mxGetPr(prhs[3]);
+
+  const thrust::device_vector<real> d_arg(arg, arg + n);
+  const thrust::device_vector<real> d_tau(tau_diag, tau_diag + n);
+  thrust::device_vector<real> d_res(n);
+  const real tau = (real) mxGetScalar(prhs[2]);
+
+  for(auto& prox : proxs)
+    prox->Eval(d_res, d_arg, d_tau, tau);
+
+  std::vector<real> h_result(n);
+  thrust::copy(d_res.begin(), d_res.end(), h_result.begin());
+
+  plhs[0] = mxCreateDoubleMatrix(n, 1, mxREAL);
+  std::copy(h_result.begin(), h_result.end(), (double *)mxGetPr(plhs[0]));
+
+  if(nlhs > 1)
+    plhs[1] = mxCreateDoubleScalar(static_cast<double>(proxs.size()));
+}
+
 static void Init(MEX_ARGS) {
   mexLock(); 
 }
 
 static void Release(MEX_ARGS) {
+  // free the resident problems before the device is reset
+  for(auto& h : problem_handles)
+  {
+    cudaSetDevice(h.second->device);
+    h.second->solver->Release();
+    h.second->solver.reset();
+    mexUnlock();
+  }
+
+  problem_handles.clear();
+  ProxIndRange<real>::ClearFactorCache();
+
   mexUnlock();
   cudaDeviceReset();
 }
@@ -296,6 +1053,10 @@ static void ListGPUs(MEX_ARGS) {
   }
 }
 
+static void HasNVRTC(MEX_ARGS) {
+  plhs[0] = mxCreateLogicalScalar(JITKernelCache::available());
+}
+
 static void SetGPU(MEX_ARGS) {
   int id = mxGetScalar(prhs[0]);
 
@@ -303,13 +1064,23 @@ static void SetGPU(MEX_ARGS) {
 }
 
 const static map<string, function<void(MEX_ARGS)>> cmd_reg = {
-  { "init",          Init         },
-  { "release",       Release      },
-  { "solve_problem", SolveProblem },
-  { "eval_linop",    EvalLinOp    },
-  { "eval_prox",     EvalProx     },
-  { "list_gpus",     ListGPUs     },
-  { "set_gpu",       SetGPU       },
+  { "init",            Init                 },
+  { "release",         Release              },
+  { "solve_problem",   SolveProblem         },
+  { "solve_file",      SolveFile            },
+  { "create_problem",  CreateProblemHandle  },
+  { "update",          UpdateProblemHandle  },
+  { "resolve",         ResolveProblemHandle },
+  { "release_problem", ReleaseProblemHandle },
+  { "sweep",           Sweep                },
+  { "batch",           Batch                },
+  { "eval_linop",      EvalLinOp            },
+  { "eval_prox",       EvalProx             },
+  { "eval_prox_list",  EvalProxList         },
+  { "eval_prox_gap",   EvalProxGap          },
+  { "list_gpus",       ListGPUs             },
+  { "set_gpu",         SetGPU               },
+  { "has_nvrtc",       HasNVRTC             },
 };
 
 void mexFunction(MEX_ARGS)
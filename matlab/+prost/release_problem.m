@@ -0,0 +1,8 @@
+function release_problem(handle)
+% RELEASE_PROBLEM  release_problem(handle)
+%
+%   Frees the problem created by prost.create_problem on the GPU.
+    
+    prost_('release_problem', handle);
+    
+end
@@ -0,0 +1,15 @@
+function [result] = resolve(handle, prob)
+% RESOLVE  result = resolve(handle, prob)
+%
+%   Solves the problem behind handle, warm-started from the last
+%   iterate, or from x0 and y0 of the options at the first call. The 
+%   result is returned as in prost.solve. If prob is given, its 
+%   variables are filled with the solution.
+
+    result = prost_('resolve', handle);
+
+    if nargin > 1
+        prob.fill_variables( result );
+    end
+    
+end
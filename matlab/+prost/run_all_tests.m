@@ -11,16 +11,34 @@ function run_all_tests()
         'linop_id_kron_dense'; ...
         'linop_id_kron_sparse'; ...
         'linop_sparse_zero'; ...
+        'linop_sparse_half'; ...
         'linop_sparse_kron_id'; ...
+        'linop_product'; ...
+        'linop_sum'; ...
         'prox_conjugate'; ...
         'prox_conj_trans'; ...
         'prox_ind_range'; ...
         'prox_permute'; ...
         'prox_sum_ind_simplex'; ...
         'prox_sum_ind_sum'; ...
+        'prox_sum_ind_soc'; ...
         'prox_sum_norm2'; ...
         'prox_transform'; ...
+        'prox_batch'; ...
+        'prox_gap'; ...
+        'prox_jit'; ...
         'prox_sum_ind_psd_cone'; ...
+        'sweep_diags'; ...
+        'resolve_update'; ...
+        'update_merged_diags'; ...
+        'update_host'; ...
+        'presolve'; ...
+        'problem_file'; ...
+        'gap_stop'; ...
+        'spdhg'; ...
+        'async_residuals'; ...
+        'batch'; ...
+        'solve_multires'; ...
                  };
 
     num_passed = 0;
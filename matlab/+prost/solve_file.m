@@ -0,0 +1,11 @@
+function [result] = solve_file(filename)
+% SOLVE_FILE  result = solve_file(filename)
+%
+%   Loads a problem written by prost.write_problem with the native
+%   loader prost::ProblemFile and solves it with the backend and 
+%   options stored in the file. The result is returned as in 
+%   prost.solve.
+
+    result = prost_('solve_file', filename);
+
+end
@@ -0,0 +1,336 @@
+function [result] = solve_multires(prob, grid, levels, backend, opts)
+% SOLVE_MULTIRES  result = solve_multires(prob, grid, levels, backend, opts)
+%
+%   Solves the problem prob coarse to fine on an image grid of size
+%   grid = [ny nx]. The problem is restricted to levels - 1 coarser
+%   grids, each halving nx and ny. Every level is solved with the
+%   options opts and its primal and dual solution, upsampled to the
+%   next finer grid, is used as x0 and y0 there. The last level is
+%   the problem itself and the result is returned as in prost.solve.
+%
+%   Every variable has to be a multiple of nx*ny long and is assumed to
+%   be stored like the argument of prost.block.gradient2d, i.e. as an
+%   [ny nx L] array, or as an [L ny nx] array if the gradient blocks
+%   have label_first set. The label dimension is not coarsened.
+%
+%   Supported are gradient2d, gradient3d, sparse, zero and identity
+%   blocks and zero, elementwise, transformed and conjugated functions.
+%   Gradients are rebuilt on the coarse grid, sparse blocks are
+%   restricted as R * K * P with the averaging R and the piecewise
+%   constant upsampling P, and coefficient vectors are averaged.
+%
+%   Example:
+%   - prost.solve_multires(prob, [ny nx], 4, backend, opts)
+
+    prob.finalize();
+
+    if levels < 1
+        error('At least one level is required.');
+    end
+
+    [row_segs, col_segs] = variable_segments(prob);
+    inner = label_inner(prob.data.linop);
+
+    grids = { grid(:)' };
+    for l=2:levels
+        grids{l} = ceil(grids{l - 1} / 2);
+    end
+
+    % solve the coarse levels, without intermediate callbacks
+    coarse_opts = opts;
+    coarse_opts.interm_cb = @(it, x, y) false;
+    coarse_opts.num_cback_calls = 0;
+
+    x = [];
+    y = [];
+    for l=levels:-1:2
+        s = 2^(l - 1);
+        [data, nrows, ncols] = restrict_problem(prob.data, grid, s, ...
+                                                row_segs, col_segs, inner);
+
+        if ~isempty(x)
+            % upsample from level l + 1 to level l
+            x = level_prolongation(col_segs, grid, s, 2, inner) * x;
+            y = level_prolongation(row_segs, grid, s, 2, inner) * y;
+        end
+
+        coarse_opts.x0 = x;
+        coarse_opts.y0 = y;
+
+        if opts.verbose
+            fprintf('Level %d of %d: %d x %d.\n', levels - l + 1, ...
+                    levels, grids{l}(1), grids{l}(2));
+        end
+
+        res = prost_('solve_problem', data, nrows, ncols, backend, ...
+                     coarse_opts);
+        x = res.x;
+        y = res.y;
+    end
+
+    if ~isempty(x)
+        opts.x0 = level_prolongation(col_segs, grid, 1, 2, inner) * x;
+        opts.y0 = level_prolongation(row_segs, grid, 1, 2, inner) * y;
+    end
+
+    result = prost.solve(prob, backend, opts);
+
+end
+
+function [rows, cols] = variable_segments(prob)
+% returns [idx, dim] of the top level dual and primal variables
+
+    if isprop(prob, 'dual_vars')
+        dual_vars = prob.dual_vars;
+    else
+        dual_vars = prob.constrained_vars;
+    end
+
+    rows = zeros(0, 2);
+    for i=1:numel(dual_vars)
+        rows(end + 1, :) = [dual_vars{i}.idx, dual_vars{i}.dim];
+    end
+
+    cols = zeros(0, 2);
+    for i=1:numel(prob.primal_vars)
+        cols(end + 1, :) = [prob.primal_vars{i}.idx, prob.primal_vars{i}.dim];
+    end
+end
+
+function [inner] = label_inner(linop)
+% number of labels stored before the pixels, from the gradient blocks
+
+    inner = 1;
+    for i=1:numel(linop)
+        block = linop{i};
+        if any(strcmp(block{1}, { 'gradient2d', 'gradient3d' })) && block{4}{4}
+            if (inner ~= 1) && (inner ~= block{4}{3})
+                error('Gradient blocks with label_first need the same number of labels.');
+            end
+
+            inner = block{4}{3};
+        end
+    end
+end
+
+function [P] = prolongation(grid, s)
+% piecewise constant upsampling from ceil(grid / s) to grid
+
+    ny = grid(1);
+    nx = grid(2);
+    cy = ceil(ny / s);
+
+    [yy, xx] = ndgrid(1:ny, 1:nx);
+    coarse = ceil(yy / s) + (ceil(xx / s) - 1) * cy;
+
+    P = sparse(1:ny*nx, coarse(:), 1, ny*nx, cy*ceil(nx / s));
+end
+
+function [P] = layout_prolongation(len, grid, s, inner)
+% upsampling of a vector of length len, stored as [inner ny nx outer]
+
+    N = prod(grid);
+    k = len / N;
+
+    if k ~= round(k)
+        error('Vector of length %d does not fit the grid.', len);
+    end
+
+    if mod(k, inner) ~= 0
+        inner = 1;
+    end
+
+    P = kron(speye(k / inner), kron(prolongation(grid, s), speye(inner)));
+end
+
+function [R] = layout_restriction(len, grid, s, inner)
+% averaging, the left inverse of layout_prolongation
+
+    P = layout_prolongation(len, grid, s, inner);
+    R = spdiags(1 ./ full(sum(P, 1))', 0, size(P, 2), size(P, 2)) * P';
+end
+
+function [P] = level_prolongation(segs, grid, s, factor, inner)
+% upsampling of all variables from the grid coarsened by s * factor
+% to the grid coarsened by s
+
+    coarse_grid = ceil(grid / s);
+    N = prod(grid);
+
+    blocks = cell(1, size(segs, 1));
+    for i=1:size(segs, 1)
+        len = segs(i, 2) / N * prod(coarse_grid);
+        blocks{i} = layout_prolongation(len, coarse_grid, factor, inner);
+    end
+
+    P = blkdiag(blocks{:});
+end
+
+function [c_idx, c_count] = restrict_range(idx, count, segs, grid, s, inner)
+% maps the range [idx, idx + count) to the coarse grid
+
+    N = prod(grid);
+    Nc = prod(ceil(grid / s));
+
+    c_seg = 0;
+    for i=1:size(segs, 1)
+        if (idx >= segs(i, 1)) && (idx < segs(i, 1) + segs(i, 2))
+            break;
+        end
+
+        c_seg = c_seg + segs(i, 2) / N * Nc;
+    end
+
+    off = idx - segs(i, 1);
+    k = segs(i, 2) / N;
+    if mod(k, inner) ~= 0
+        inner = 1;
+    end
+
+    slice = inner * N;
+    if (mod(off, slice) ~= 0) || (mod(count, slice) ~= 0) || ...
+            (off + count > segs(i, 2))
+        error(['Range starting at %d does not cover whole slices of ' ...
+               'a variable and cannot be restricted.'], idx);
+    end
+
+    c_idx = c_seg + off / N * Nc;
+    c_count = count / N * Nc;
+end
+
+function [val] = restrict_coefficient(val, grid, s, inner)
+% averages coefficient vectors, scalars are kept
+
+    if numel(val) > 1
+        val = layout_restriction(numel(val), grid, s, inner) * val(:);
+    end
+end
+
+function [data, nrows, ncols] = restrict_problem(data, grid, s, row_segs, ...
+                                                 col_segs, inner)
+
+    N = prod(grid);
+    coarse_grid = ceil(grid / s);
+    Nc = prod(coarse_grid);
+
+    nrows = sum(row_segs(:, 2)) / N * Nc;
+    ncols = sum(col_segs(:, 2)) / N * Nc;
+
+    for i=1:numel(data.linop)
+        data.linop{i} = restrict_block(data.linop{i}, grid, s, row_segs, ...
+                                       col_segs, inner);
+    end
+
+    data.prox_g = restrict_proxs(data.prox_g, grid, s, col_segs, inner);
+    data.prox_gstar = restrict_proxs(data.prox_gstar, grid, s, col_segs, inner);
+    data.prox_f = restrict_proxs(data.prox_f, grid, s, row_segs, inner);
+    data.prox_fstar = restrict_proxs(data.prox_fstar, grid, s, row_segs, inner);
+
+    if strcmp(data.scaling, 'custom')
+        data.scaling_left = restrict_coefficient(data.scaling_left, ...
+                                                 grid, s, inner);
+        data.scaling_right = restrict_coefficient(data.scaling_right, ...
+                                                  grid, s, inner);
+    end
+end
+
+function [block] = restrict_block(block, grid, s, row_segs, col_segs, inner)
+
+    row = block{2};
+    col = block{3};
+
+    switch block{1}
+      case { 'gradient2d', 'gradient3d' }
+        bdata = block{4};
+        if bdata{1} * bdata{2} ~= prod(grid)
+            error('Gradient block does not fit the grid.');
+        end
+
+        per_pixel = 2 + strcmp(block{1}, 'gradient3d');
+        [c_row, ~] = restrict_range(row, per_pixel * prod(grid) * bdata{3}, ...
+                                    row_segs, grid, s, inner);
+        [c_col, ~] = restrict_range(col, prod(grid) * bdata{3}, ...
+                                    col_segs, grid, s, inner);
+
+        bdata{1} = ceil(bdata{1} / s);
+        bdata{2} = ceil(bdata{2} / s);
+        block = { block{1}, c_row, c_col, bdata };
+
+      case 'sparse'
+        K = block{4}{1};
+        [c_row, ~] = restrict_range(row, size(K, 1), row_segs, grid, s, inner);
+        [c_col, ~] = restrict_range(col, size(K, 2), col_segs, grid, s, inner);
+
+        K = layout_restriction(size(K, 1), grid, s, inner) * K * ...
+            layout_prolongation(size(K, 2), grid, s, inner);
+
+        block = { 'sparse', c_row, c_col, { K, block{4}{2} } };
+
+      case 'zero'
+        [c_row, c_nrows] = restrict_range(row, block{4}{1}, row_segs, ...
+                                          grid, s, inner);
+        [c_col, c_ncols] = restrict_range(col, block{4}{2}, col_segs, ...
+                                          grid, s, inner);
+
+        block = { 'zero', c_row, c_col, { c_nrows, c_ncols } };
+
+      case 'diags'
+        bdata = block{4};
+        if any(bdata{4} ~= 0) || (bdata{1} ~= bdata{2}) || ...
+                (numel(bdata{3}) > 1)
+            error('Only scaled identities can be restricted out of diags blocks.');
+        end
+
+        [c_row, c_nrows] = restrict_range(row, bdata{1}, row_segs, ...
+                                          grid, s, inner);
+        [c_col, c_ncols] = restrict_range(col, bdata{2}, col_segs, ...
+                                          grid, s, inner);
+
+        block = { 'diags', c_row, c_col, { c_nrows, c_ncols, bdata{3}, 0 } };
+
+      otherwise
+        error('Blocks of type %s cannot be restricted.', block{1});
+    end
+end
+
+function [proxs] = restrict_proxs(proxs, grid, s, segs, inner)
+
+    for i=1:numel(proxs)
+        proxs{i} = restrict_prox(proxs{i}, grid, s, segs, inner);
+    end
+end
+
+function [prox] = restrict_prox(prox, grid, s, segs, inner)
+
+    [c_idx, c_count] = restrict_range(prox{2}, prox{3}, segs, grid, s, inner);
+    pdata = prox{5};
+    ratio = c_count / prox{3};
+
+    if strcmp(prox{1}, 'zero')
+        % no data
+
+    elseif strncmp(prox{1}, 'elem_operation:', 15)
+        pdata{1} = pdata{1} * ratio;
+
+        if numel(pdata) > 3
+            for j=1:numel(pdata{4})
+                pdata{4}{j} = restrict_coefficient(pdata{4}{j}, grid, s, inner);
+            end
+        end
+
+    elseif strcmp(prox{1}, 'transform')
+        for j=1:5
+            pdata{j} = restrict_coefficient(pdata{j}, grid, s, inner);
+        end
+
+        pdata{6} = restrict_prox(pdata{6}, grid, s, segs, inner);
+
+    elseif strcmp(prox{1}, 'moreau')
+        pdata{1} = restrict_prox(pdata{1}, grid, s, segs, inner);
+
+    else
+        error('Functions of type %s cannot be restricted.', prox{1});
+    end
+
+    prox = { prox{1}, c_idx, c_count, prox{4}, pdata };
+end
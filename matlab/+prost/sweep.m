@@ -0,0 +1,37 @@
+function [result] = sweep(prob, backend, opts, points, devices)
+% SWEEP  result = sweep(prob, backend, opts, points, devices)
+%
+%   Solves the problem prob for many parameter points on one or more
+%   GPUs. points is a cell array of problems built like prob, which
+%   differ only in the data prost.update can replace, i.e. the
+%   coefficients of elementwise and transformed functions, the factors
+%   of diags blocks and the alpha of the scaling. Every device keeps its
+%   own copy of the problem initialized and solves the next unsolved
+%   point warm-started from its previous one.
+%
+%   backend is either one backend for all points or a cell array with a
+%   backend per point, e.g. for other step sizes; the backend is then
+%   created again for every point. devices are the CUDA device numbers
+%   to run on, by default the one selected by prost.set_gpu.
+%
+%   Output is a struct array with the fields x, y, z, w, result and
+%   device per point, prob.fill_variables(result(i)) reads one back.
+%   Intermediate callbacks, verbose output, presolve and gpu_arrays are
+%   not supported.
+
+    if nargin < 5
+        devices = [];
+    end
+
+    prob.finalize();
+
+    data = cell(numel(points), 1);
+    for i=1:numel(points)
+        points{i}.finalize();
+        data{i} = points{i}.data;
+    end
+
+    result = prost_('sweep', prob.data, prob.nrows, prob.ncols, ...
+                    backend, opts, data, devices);
+
+end
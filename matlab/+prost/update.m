@@ -0,0 +1,16 @@
+function update(handle, prob)
+% UPDATE  update(handle, prob)
+%
+%   Replaces the data of the problem behind handle by the data of prob,
+%   which has to be built like the problem passed to 
+%   prost.create_problem. Updated in place are the coefficients of
+%   elementwise and transformed functions, the factors of diags
+%   blocks and the alpha of the scaling, all other data is fixed when
+%   the problem is created.
+%   The next prost.resolve starts from the last iterate.
+
+    prob.finalize();
+
+    prost_('update', handle, prob.data);
+
+end
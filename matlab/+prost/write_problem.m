@@ -0,0 +1,95 @@
+function write_problem(filename, prob, backend, opts, precision)
+% WRITE_PROBLEM  write_problem(filename, prob, backend, opts, precision)
+%
+%   Writes the problem prob together with the backend and the options
+%   into a binary file, which is loaded without MATLAB by the C++ class
+%   prost::ProblemFile. Numeric data is stored in the given precision,
+%   'single' (default, the precision of the MEX interface) or 'double'.
+%   Sparse matrices are stored in CSR and CSC, so that the loader
+%   uploads them to the GPU straight from the mapped file. Function 
+%   handles, e.g. the intermediate callback, are not stored.
+%
+%   Example:
+%   - prost.write_problem('denoising.prost', prob, backend, opts);
+
+    if nargin < 5
+        precision = 'single';
+    end
+
+    if ~any(strcmp(precision, {'single', 'double'}))
+        error('Precision has to be single or double.');
+    end
+
+    prob.finalize();
+
+    root = struct('prob', prob.data, 'nrows', prob.nrows, ...
+                  'ncols', prob.ncols, 'backend', {backend}, 'opts', opts);
+
+    fid = fopen(filename, 'w', 'ieee-le');
+    if fid < 0
+        error('Could not open %s for writing.', filename);
+    end
+    cleanup = onCleanup(@() fclose(fid));
+
+    fwrite(fid, 'PROSTPRB', 'char*1');
+    fwrite(fid, [1 0], 'uint32');
+    write_node(fid, root, precision);
+
+end
+
+% node types, see include/prost/problem_file.hpp
+function write_node(fid, v, precision)
+    if ischar(v)
+        write_header(fid, 5, numel(v), 0);
+        fwrite(fid, v, 'char*1');
+    elseif issparse(v)
+        [m, n] = size(v);
+        write_header(fid, 4 - strcmp(precision, 'double'), m, n);
+        fwrite(fid, nnz(v), 'uint64');
+
+        % CSR of v from the CSC of its transpose
+        [ind, row, val] = find(v.');
+        write_array(fid, [0; cumsum(accumarray(row(:), 1, [m 1]))], 'int32');
+        write_array(fid, ind(:) - 1, 'int32');
+        write_array(fid, full(val(:)), precision);
+
+        [ind_t, col, val_t] = find(v);
+        write_array(fid, [0; cumsum(accumarray(col(:), 1, [n 1]))], 'int32');
+        write_array(fid, ind_t(:) - 1, 'int32');
+        write_array(fid, full(val_t(:)), precision);
+    elseif isnumeric(v) || islogical(v)
+        sz = size(v);
+        write_header(fid, 2 - strcmp(precision, 'double'), sz(1), prod(sz(2:end)));
+        write_array(fid, double(v(:)), precision);
+    elseif iscell(v)
+        sz = size(v);
+        write_header(fid, 6, sz(1), prod(sz(2:end)));
+        for i=1:numel(v)
+            write_node(fid, v{i}, precision);
+        end
+    elseif isstruct(v) && numel(v) == 1
+        names = fieldnames(v);
+        write_header(fid, 7, numel(names), 0);
+        for i=1:numel(names)
+            write_node(fid, names{i}, precision);
+            write_node(fid, v.(names{i}), precision);
+        end
+    else
+        write_header(fid, 0, 0, 0);
+    end
+end
+
+function write_header(fid, type, a, b)
+    pad(fid, 8);
+    fwrite(fid, [type 0], 'uint32');
+    fwrite(fid, [a b], 'uint64');
+end
+
+function write_array(fid, v, precision)
+    pad(fid, 64);
+    fwrite(fid, v, precision);
+end
+
+function pad(fid, alignment)
+    fwrite(fid, zeros(mod(-ftell(fid), alignment), 1), 'uint8');
+end
@@ -19,11 +19,15 @@
 */
 
 #include <algorithm>
+#include <cmath>
+#include <iostream>
 
 #include <thrust/for_each.h>
+#include <thrust/reduce.h>
 #include <thrust/device_vector.h>
 #include <thrust/transform_reduce.h>
 #include <thrust/iterator/zip_iterator.h>
+#include <thrust/system/cuda/execution_policy.h>
 
 #include "prost/backend/backend_admm.hpp"
 #include "prost/linop/linearoperator.hpp"
@@ -33,22 +37,10 @@
 #include "prost/cgls.hpp"
 #include "prost/exception.hpp"
 #include "prost/problem.hpp"
+#include "prost/profiler.hpp"
 
 namespace prost {
 
-// compute norm using cuBLAS
-void nrm2(cublasHandle_t hdl, int n, const double *x, double *result) 
-{
-  cublasDnrm2(hdl, n, x, static_cast<int>(1), result);
-}
-
-void nrm2(cublasHandle_t hdl, int n, const float *x, double *result) 
-{
-  float result_float;
-  cublasSnrm2(hdl, n, x, static_cast<int>(1), &result_float);
-  *result = static_cast<double>(result_float);
-}
-
 /// \brief <0> = (alpha <1> + (1-alpha) <2> + <3>) / sqrt(<4>)
 template<typename T>
 struct temp1_functor
@@ -195,14 +187,115 @@ struct get_dual_functor
   T expo_;
 };
 
+/// \brief Accumulates (|Kx - z|^2, |z|^2) from d_res = Kx - z into 
+///        d_sums[0..2) and overwrites d_res with the dual variable
+///        y = -rho Sigma (z_half - z_proj + z_dual).
+template<typename T>
+__global__
+void ADMMPrimalResidualKernel(
+  T *d_partials,
+  T *d_sums,
+  unsigned int *d_count,
+  T *d_res,
+  const T *d_z_half,
+  const T *d_z_proj,
+  const T *d_z_dual,
+  const T *d_scaling_left,
+  size_t count,
+  T rho)
+{
+  T acc[2] = { 0, 0 };
+
+  for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < count; i += blockDim.x * gridDim.x)
+  {
+    const T s = d_scaling_left[i];
+    const T r = d_res[i];
+    const T z = d_z_half[i];
+
+    acc[0] += s * r * r;
+    acc[1] += s * z * z;
+
+    d_res[i] = -rho * s * (z - d_z_proj[i] + d_z_dual[i]);
+  }
+
+  ResidualSumsReduce<T, 2>(acc, d_partials, d_sums, d_count);
+}
+
+/// \brief Writes the dual variable w = -rho Tau^{-1} (x_half - x_proj + x_dual)
+///        to d_w and accumulates |w|^2 into d_sums[0].
+template<typename T>
+__global__
+void ADMMDualVariableKernel(
+  T *d_partials,
+  T *d_sums,
+  unsigned int *d_count,
+  T *d_w,
+  const T *d_x_half,
+  const T *d_x_proj,
+  const T *d_x_dual,
+  const T *d_scaling_right,
+  size_t count,
+  T rho)
+{
+  T acc[1] = { 0 };
+
+  for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < count; i += blockDim.x * gridDim.x)
+  {
+    const T t = d_scaling_right[i];
+    const T w = -rho * (d_x_half[i] - d_x_proj[i] + d_x_dual[i]) / t;
+
+    acc[0] += t * w * w;
+    d_w[i] = w;
+  }
+
+  ResidualSumsReduce<T, 1>(acc, d_partials, d_sums, d_count);
+}
+
+/// \brief Accumulates |K^T y + w|^2 from d_res = K^T y + w into d_sums[0].
+template<typename T>
+__global__
+void ADMMDualResidualKernel(
+  T *d_partials,
+  T *d_sums,
+  unsigned int *d_count,
+  const T *d_res,
+  const T *d_scaling_right,
+  size_t count)
+{
+  T acc[1] = { 0 };
+
+  for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < count; i += blockDim.x * gridDim.x)
+    acc[0] += d_scaling_right[i] * d_res[i] * d_res[i];
+
+  ResidualSumsReduce<T, 1>(acc, d_partials, d_sums, d_count);
+}
+
+/// \brief <0> = shift + scale * <1> * <2>
+template<typename T>
+struct jacobi_functor
+{
+  jacobi_functor(T shift, T scale) : shift_(shift), scale_(scale) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    thrust::get<0>(t) = shift_ + scale_ * thrust::get<1>(t) * thrust::get<2>(t);
+  }
+
+  T shift_;
+  T scale_;
+};
+
 template<typename T>
 struct GemvPrecondK 
 {
   GemvPrecondK(const thrust::device_vector<T>& Sigma,
                const thrust::device_vector<T>& Tau,
                shared_ptr<LinearOperator<T>> linop,
-               thrust::device_vector<T>& temp)
-    : Sigma_(Sigma), Tau_(Tau), linop_(linop), temp_(temp)
+               thrust::device_vector<T>& temp,
+               cudaStream_t stream = 0)
+    : Sigma_(Sigma), Tau_(Tau), linop_(linop), temp_(temp), stream_(stream)
   {
   }
   
@@ -218,22 +311,22 @@ struct GemvPrecondK
     if(op == 'n') // forward
     {      
       // temp = Tau^{1/2} * x
-      thrust::transform(Tau_.begin(), Tau_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Tau_.begin(), Tau_.end(),
         x.begin(),
         temp_.begin(),
         gemv_functor1<T>());
       
       // y = (beta / (alpha * Sigma^{1/2})) * y
-      thrust::transform(Sigma_.begin(), Sigma_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Sigma_.begin(), Sigma_.end(),
         y.begin(),
         y.begin(),
         gemv_functor2<T>(alpha, beta));
 
       // y += A * temp
-      linop_->Eval(y, temp_, 1);
+      linop_->Eval(y, temp_, 1, stream_);
 
       // y = alpha * Sigma^{1/2} * y
-      thrust::transform(Sigma_.begin(), Sigma_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Sigma_.begin(), Sigma_.end(),
         y.begin(),
         y.begin(),
         gemv_functor3<T>(alpha));
@@ -241,22 +334,22 @@ struct GemvPrecondK
     else // adjoint
     {
       // temp = Sigma^{1/2} * x
-      thrust::transform(Sigma_.begin(), Sigma_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Sigma_.begin(), Sigma_.end(),
         x.begin(),
         temp_.begin(),
         gemv_functor1<T>());
 
       // y = (beta / (alpha * Tau^{1/2})) * y
-      thrust::transform(Tau_.begin(), Tau_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Tau_.begin(), Tau_.end(),
         y.begin(),
         y.begin(),
         gemv_functor2<T>(alpha, beta));
 
       // y += A^T * temp
-      linop_->EvalAdjoint(y, temp_, 1);
+      linop_->EvalAdjoint(y, temp_, 1, stream_);
 
       // y = alpha * Tau^{1/2} * y
-      thrust::transform(Tau_.begin(), Tau_.end(),
+      thrust::transform(thrust::cuda::par.on(stream_), Tau_.begin(), Tau_.end(),
         y.begin(),
         y.begin(),
         gemv_functor3<T>(alpha));
@@ -269,6 +362,7 @@ struct GemvPrecondK
   const thrust::device_vector<T>& Tau_;
   thrust::device_vector<T>& temp_;
   shared_ptr<LinearOperator<T>> linop_;
+  cudaStream_t stream_;
 };
 
 template<typename T>
@@ -302,12 +396,15 @@ void BackendADMM<T>::Initialize()
     temp1_.resize(n, 0);
     temp2_.resize(m, 0);
     temp3_.resize(l, 0);
+
+    residual_sums_.Initialize();
+    this->InitializeHistory();
   }
   catch(std::bad_alloc& e)
   {
     std::stringstream ss;
     ss << "Out of memory: " << e.what();
-    throw Exception(ss.str());
+    throw OutOfMemoryException(ss.str());
   }
 
   // check if proxs are available (or create via moreau)
@@ -346,16 +443,230 @@ void BackendADMM<T>::Initialize()
   delta_ = opts_.arb_delta;
   rho_ = opts_.rho0;
   iteration_ = 0;
+  this->ResetResidualSchedule(opts_.residual_iter);
   arb_u_ = arb_l_ = 0;
 
-  cublasCreate_v2(&hdl_);
+  // owned by the context of the solver
+  hdl_ = this->problem_->context().cublas(this->problem_->context().stream());
+
+  direct_ = false;
+
+  if(opts_.cg_fused)
+  {
+    fused_cgls_.Initialize(n);
+
+    if(opts_.cg_jacobi)
+      ComputeJacobiPreconditioner(0);
+  }
+
+  if(opts_.projection != kProjectionCGLS)
+  {
+    direct_ = FactorProjectionSystem();
+
+    if(!direct_)
+    {
+      if(opts_.projection == kProjectionCholesky)
+        throw Exception("ADMM Cholesky projection requires an operator made of blocks which store their entries and a system with at most direct_max_nnz nonzeros.");
+
+      if(this->solver_opts_.verbose)
+        std::cout << "ADMM: falling back to the CGLS projection." << std::endl;
+    }
+  }
+}
+
+template<typename T>
+bool BackendADMM<T>::AssembleProjectionSystem(
+  vector<int32_t>& ptr,
+  vector<int32_t>& ind,
+  vector<T>& val)
+{
+  const size_t m = this->problem_->nrows();
+  const size_t n = this->problem_->ncols();
+
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+
+  if(!this->problem_->linop()->GetTriplets(rows, cols, vals))
+    return false;
+
+  vector<T> sigma(m), tau(n);
+  thrust::copy(this->problem_->scaling_left().begin(), this->problem_->scaling_left().end(), sigma.begin());
+  thrust::copy(this->problem_->scaling_right().begin(), this->problem_->scaling_right().end(), tau.begin());
+
+  // B = Sigma^{1/2} K Tau^{1/2} is p x q with p <= q, so that the smaller
+  // of the two normal equation systems is factorized.
+  const bool outer = (m <= n);
+  const size_t p = outer ? m : n;
+  const size_t q = outer ? n : m;
+
+  // B and B^T in CSR by counting sort
+  vector<int32_t> b_ptr(p + 1, 0), bt_ptr(q + 1, 0);
+  vector<int32_t> b_ind(vals.size()), bt_ind(vals.size());
+  vector<T> b_val(vals.size()), bt_val(vals.size());
+
+  for(size_t k = 0; k < vals.size(); k++)
+  {
+    const int32_t r = outer ? rows[k] : cols[k];
+    const int32_t c = outer ? cols[k] : rows[k];
+
+    b_ptr[r + 1]++;
+    bt_ptr[c + 1]++;
+  }
+
+  for(size_t i = 0; i < p; i++)
+    b_ptr[i + 1] += b_ptr[i];
+
+  for(size_t j = 0; j < q; j++)
+    bt_ptr[j + 1] += bt_ptr[j];
+
+  vector<int32_t> b_pos(b_ptr.begin(), b_ptr.end() - 1);
+  vector<int32_t> bt_pos(bt_ptr.begin(), bt_ptr.end() - 1);
+
+  for(size_t k = 0; k < vals.size(); k++)
+  {
+    const int32_t r = outer ? rows[k] : cols[k];
+    const int32_t c = outer ? cols[k] : rows[k];
+    const T a = std::sqrt(sigma[rows[k]]) * vals[k] * std::sqrt(tau[cols[k]]);
+
+    b_ind[b_pos[r]] = c;
+    b_val[b_pos[r]++] = a;
+    bt_ind[bt_pos[c]] = r;
+    bt_val[bt_pos[c]++] = a;
+  }
+
+  // M = I + B B^T row by row (Gustavson), M_it = \sum_j B_ij B_tj
+  vector<int32_t> marker(p, -1);
+  vector<T> acc(p, 0);
+  vector<int32_t> row_ind;
+
+  ptr.assign(1, 0);
+  ind.clear();
+  val.clear();
+
+  for(size_t i = 0; i < p; i++)
+  {
+    row_ind.clear();
+    marker[i] = i;
+    acc[i] = 1;
+    row_ind.push_back(i);
+
+    for(int32_t k = b_ptr[i]; k < b_ptr[i + 1]; k++)
+    {
+      const int32_t j = b_ind[k];
+
+      for(int32_t l = bt_ptr[j]; l < bt_ptr[j + 1]; l++)
+      {
+        const int32_t t = bt_ind[l];
+
+        if(marker[t] != static_cast<int32_t>(i))
+        {
+          marker[t] = i;
+          acc[t] = 0;
+          row_ind.push_back(t);
+        }
+
+        acc[t] += b_val[k] * bt_val[l];
+      }
+    }
+
+    if(ind.size() + row_ind.size() > static_cast<size_t>(opts_.direct_max_nnz))
+      return false;
+
+    std::sort(row_ind.begin(), row_ind.end());
+
+    for(int32_t t : row_ind)
+    {
+      ind.push_back(t);
+      val.push_back(acc[t]);
+    }
+
+    ptr.push_back(ind.size());
+  }
+
+  return true;
+}
+
+template<typename T>
+bool BackendADMM<T>::FactorProjectionSystem()
+{
+  vector<int32_t> ptr, ind;
+  vector<T> val;
+
+  if(!AssembleProjectionSystem(ptr, ind, val))
+    return false;
+
+  cholesky_.Initialize(ptr.size() - 1, ptr, ind, val);
+
+  if(this->solver_opts_.verbose)
+    std::cout << "ADMM: factorized " << cholesky_.n() << "x" << cholesky_.n()
+              << " projection system with " << cholesky_.nnz() << " nonzeros." << std::endl;
+
+  return true;
+}
+
+template<typename T>
+void BackendADMM<T>::ComputeJacobiPreconditioner(cudaStream_t stream)
+{
+  const size_t m = this->problem_->nrows();
+  const size_t n = this->problem_->ncols();
+  device_vector<T>& diag = fused_cgls_.diag();
+
+  diag.resize(n);
+
+  // diag(A^T A)_j = tau_j \sum_i sigma_i K_ij^2, with sigma_i replaced 
+  // by its mean so that the column sums of the blocks can be used.
+  const T sigma_mean = thrust::reduce(
+    thrust::cuda::par.on(stream),
+    this->problem_->scaling_left().begin(),
+    this->problem_->scaling_left().end(),
+    static_cast<T>(0)) / std::max<size_t>(m, 1);
+
+  this->problem_->linop()->ColSums(diag.begin(), 2, stream);
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          diag.begin(),
+          diag.begin(),
+          this->problem_->scaling_right().begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          diag.end(),
+          diag.end(),
+          this->problem_->scaling_right().end())),
+
+      jacobi_functor<T>(1, sigma_mean));
 }
 
 template<typename T>
-void BackendADMM<T>::PerformIteration()
+void BackendADMM<T>::ProblemChanged(cudaStream_t stream)
 {
+  // the residuals and their decay of the old problem do not carry over
+  this->RestartResiduals();
+
+  if(opts_.cg_fused && opts_.cg_jacobi)
+    ComputeJacobiPreconditioner(stream);
+
+  // the scaling or the operator may have changed, refactorize
+  if(direct_)
+  {
+    cudaStreamSynchronize(stream);
+
+    if(!FactorProjectionSystem())
+      throw Exception("ADMM: projection system can no longer be assembled after the problem changed.");
+  }
+}
+
+template<typename T>
+void BackendADMM<T>::PerformIteration(cudaStream_t stream)
+{
+  ProfileRange range("BackendADMM::PerformIteration", 0, stream);
+
+  cublasSetStream(hdl_, stream);
+
   // . temp1_ = T^{-1/2} (alpha x_half_ + (1-alpha) x_proj_ + x_dual_)
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           temp1_.begin(),
           x_half_.begin(),
@@ -374,6 +685,7 @@ void BackendADMM<T>::PerformIteration()
   
   // . temp2_ = Sigma^{1/2} (z_half_ + z_dual_) 
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           temp2_.begin(),
           z_half_.begin(),
@@ -393,18 +705,24 @@ void BackendADMM<T>::PerformIteration()
     this->problem_->scaling_left(),
     this->problem_->scaling_right(),
     this->problem_->linop(),
-    temp3_);
+    temp3_,
+    stream);
 
   // z_dual_ is not needed, hence use it to store projection variable
-  thrust::copy(temp2_.begin(), temp2_.end(), z_dual_.begin());
+  thrust::copy(thrust::cuda::par.on(stream), temp2_.begin(), temp2_.end(), z_dual_.begin());
   thrust::device_vector<T>& tmp_proj_arg = z_dual_;
 
   // set x_proj_ to temp3_ for warm-starting
-  thrust::copy(temp3_.begin(), temp3_.begin() + x_proj_.size(), x_proj_.begin());
+  thrust::copy(thrust::cuda::par.on(stream), temp3_.begin(), temp3_.begin() + x_proj_.size(), x_proj_.begin());
 
   // tmp_proj_arg = temp2_ - Sigma^{1/2} K Tau^{1/2} temp_1
   gemv('n', -1, temp1_, 1, tmp_proj_arg);
   
+  // step size and CG iterations of this iteration for the history
+  const T rho = rho_;
+  int cg_iters = -1;
+  const int *d_cg_iters = nullptr;
+
   double cg_tol = opts_.cg_tol_min / 
     std::pow(static_cast<T>(iteration_ + 1), opts_.cg_tol_pow);
   cg_tol = std::max(cg_tol, opts_.cg_tol_max);
@@ -418,33 +736,76 @@ void BackendADMM<T>::PerformIteration()
   thrust::device_vector<T>& tmp_r = z_proj_;
   thrust::device_vector<T>& tmp_s = x_dual_;
 
-  // TODO: memset x_proj_ to zero or use warm-starting?!
-  //thrust::fill(x_proj_.begin(), x_proj_.end(), 0);
-
-  // Minimize |Kx-d|^2 + |x|^2 for d = temp2_ - K temp_1 with cgls Method
-  int num_cg_iters_taken;
-  cgls::Solve<T, GemvPrecondK<T> >(
-    hdl_, 
-    gemv, 
-    this->problem_->nrows(),
-    this->problem_->ncols(), 
-    tmp_proj_arg, 
-    x_proj_, 
-    1, 
-    cg_tol, 
-    opts_.cg_max_iter, 
-    true,
-    tmp_p, 
-    tmp_q, 
-    tmp_r, 
-    tmp_s,
-    num_cg_iters_taken);
+  if(direct_)
+  {
+    // Minimize |Ax-d|^2 + |x|^2 exactly, x = A^T (I + A A^T)^{-1} d
+    // or x = (I + A^T A)^{-1} A^T d.
+    if(this->problem_->nrows() <= this->problem_->ncols())
+    {
+      cholesky_.Solve(thrust::raw_pointer_cast(tmp_proj_arg.data()),
+                      thrust::raw_pointer_cast(tmp_q.data()), stream);
+      gemv('t', 1, tmp_q, 0, x_proj_);
+    }
+    else
+    {
+      gemv('t', 1, tmp_proj_arg, 0, tmp_p);
+      cholesky_.Solve(thrust::raw_pointer_cast(tmp_p.data()),
+                      thrust::raw_pointer_cast(x_proj_.data()), stream);
+    }
+  }
+  else if(opts_.cg_fused)
+  {
+    fused_cgls_.Solve(
+      gemv,
+      this->problem_->nrows(),
+      this->problem_->ncols(),
+      tmp_proj_arg,
+      x_proj_,
+      1,
+      cg_tol,
+      opts_.cg_max_iter,
+      opts_.cg_check_iter,
+      tmp_p,
+      tmp_q,
+      tmp_r,
+      tmp_s,
+      stream);
+
+    d_cg_iters = fused_cgls_.d_iterations();
+  }
+  else
+  {
+    // TODO: memset x_proj_ to zero or use warm-starting?!
+    //thrust::fill(x_proj_.begin(), x_proj_.end(), 0);
+
+    // Minimize |Kx-d|^2 + |x|^2 for d = temp2_ - K temp_1 with cgls Method
+    int num_cg_iters_taken;
+    cgls::Solve<T, GemvPrecondK<T> >(
+      hdl_, 
+      gemv, 
+      this->problem_->nrows(),
+      this->problem_->ncols(), 
+      tmp_proj_arg, 
+      x_proj_, 
+      1, 
+      cg_tol, 
+      opts_.cg_max_iter, 
+      true,
+      tmp_p, 
+      tmp_q, 
+      tmp_r, 
+      tmp_s,
+      num_cg_iters_taken);
+
+    cg_iters = num_cg_iters_taken;
+  }
 
   // remember previous x_proj for warm-starting cg in the next iteration
-  thrust::copy(x_proj_.begin(), x_proj_.end(), temp3_.begin());
+  thrust::copy(thrust::cuda::par.on(stream), x_proj_.begin(), x_proj_.end(), temp3_.begin());
 
   // x_proj = Tau^{1/2} (x_proj + temp1_)
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           x_proj_.begin(),
           temp1_.begin(),
@@ -458,10 +819,11 @@ void BackendADMM<T>::PerformIteration()
       x_proj_functor<T>());
 
   // z_proj = K x_proj
-  this->problem_->linop()->Eval(z_proj_, x_proj_);
+  this->problem_->linop()->Eval(z_proj_, x_proj_, 0, stream);
   
   // x_dual_ = temp1_ * Tau^{1/2} - x_proj_
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           x_dual_.begin(),
           temp1_.begin(),
@@ -478,6 +840,7 @@ void BackendADMM<T>::PerformIteration()
 
   // z_dual_ = temp2_ / Sigma^{1/2} - z_proj_
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           z_dual_.begin(),
           temp2_.begin(),
@@ -494,6 +857,7 @@ void BackendADMM<T>::PerformIteration()
 
   // temp1_ = x_proj_ - x_dual_
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           temp1_.begin(),
           x_proj_.begin(),
@@ -508,10 +872,11 @@ void BackendADMM<T>::PerformIteration()
 
   // x_half_ = prox_g(temp_)
   for(auto& p : prox_g_)
-    p->Eval(x_half_, temp1_, this->problem_->scaling_right(), 1 / rho_);
+    p->Eval(x_half_, temp1_, this->problem_->scaling_right(), 1 / rho_, false, stream);
 
   // temp2_ = z_proj_ - z_dual_
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           temp2_.begin(),
           z_proj_.begin(),
@@ -526,108 +891,79 @@ void BackendADMM<T>::PerformIteration()
 
   // z_half_ = prox_f(temp_)
   for(auto& p : prox_f_)
-    p->Eval(z_half_, temp2_, this->problem_->scaling_left(), rho_, true); 
+    p->Eval(z_half_, temp2_, this->problem_->scaling_left(), rho_, true, stream); 
 
   iteration_++;
 
-  // compute residuals every "opts_.residual_iter" iterations and
-  // adapt stepsizes for residual base adaptive schemes
-  if(iteration_ == 0 || (iteration_ % opts_.residual_iter) == 0)
-  {   
-    double primal_residual;
-    double primal_var_norm;
-    double dual_residual;
-    double dual_var_norm;
-
-    thrust::copy(z_half_.begin(), z_half_.end(), temp2_.begin());
-    this->problem_->linop()->Eval(temp2_, x_half_, -1);
-
-    // scale with Sigma^{1/2}
-    thrust::transform(
-      this->problem_->scaling_left().begin(), 
-      this->problem_->scaling_left().end(), 
-      temp2_.begin(), 
-      temp2_.begin(),
-      gemv_functor1<T>());
-
-    nrm2(hdl_, this->problem_->nrows(), thrust::raw_pointer_cast(temp2_.data()), &primal_residual);
-
-    // scale with Sigma^{1/2}
-    thrust::transform(
-      this->problem_->scaling_left().begin(), 
-      this->problem_->scaling_left().end(), 
-      z_half_.begin(), 
-      temp2_.begin(),
-      gemv_functor1<T>());
-
-    nrm2(hdl_, this->problem_->nrows(), thrust::raw_pointer_cast(temp2_.data()), &primal_var_norm);
-
-    // Compute dual variable temp1_ = w
-    thrust::for_each(
-      thrust::make_zip_iterator(thrust::make_tuple(
-          temp1_.begin(),
-          x_half_.begin(),
-          x_proj_.begin(),
-          x_dual_.begin(),
-          this->problem_->scaling_right().begin())),
-
-      thrust::make_zip_iterator(thrust::make_tuple(
-          temp1_.end(),
-          x_half_.end(),
-          x_proj_.end(),
-          x_dual_.end(),
-          this->problem_->scaling_right().end())),
-
-      get_dual_functor<T>(rho_, -1));
-
-    // scale with Tau^{1/2}
-    thrust::transform(
-      this->problem_->scaling_right().begin(), 
-      this->problem_->scaling_right().end(), 
-      temp1_.begin(), 
-      temp2_.begin(),
-      gemv_functor1<T>());
-
-    // reduce temp2_ to get norm w
-    nrm2(hdl_, this->problem_->ncols(), thrust::raw_pointer_cast(temp2_.data()), &dual_var_norm);
-
-    // compute dual variable temp2_ = y
-    thrust::for_each(
-      thrust::make_zip_iterator(thrust::make_tuple(
-          temp2_.begin(),
-          z_half_.begin(),
-          z_proj_.begin(),
-          z_dual_.begin(),
-          this->problem_->scaling_left().begin())),
-
-      thrust::make_zip_iterator(thrust::make_tuple(
-          temp2_.end(),
-          z_half_.end(),
-          z_proj_.end(),
-          z_dual_.end(), 
-          this->problem_->scaling_left().end())),
+  // compute residuals when the schedule says so and adapt stepsizes 
+  // for residual base adaptive schemes
+  const bool residuals = this->residual_schedule_.is_due(iteration_);
 
-      get_dual_functor<T>(rho_, 1));
+  if(residuals)
+  {
+    this->residual_schedule_.Issued(iteration_);
+   
+    const size_t m = this->problem_->nrows();
+    const size_t n = this->problem_->ncols();
+    dim3 block(kBlockSizeCUDA, 1, 1);
+
+    // temp2_ = K x_half - z_half
+    thrust::copy(thrust::cuda::par.on(stream), z_half_.begin(), z_half_.end(), temp2_.begin());
+    this->problem_->linop()->Eval(temp2_, x_half_, -1, stream);
+
+    // reduce primal residual and norm, then temp2_ = y
+    ADMMPrimalResidualKernel<T>
+      <<<ResidualSums<T>::grid_size(m), block, 0, stream>>>(
+        residual_sums_.d_partials(),
+        residual_sums_.d_sums(),
+        residual_sums_.d_count(),
+        thrust::raw_pointer_cast(temp2_.data()),
+        thrust::raw_pointer_cast(z_half_.data()),
+        thrust::raw_pointer_cast(z_proj_.data()),
+        thrust::raw_pointer_cast(z_dual_.data()),
+        thrust::raw_pointer_cast(this->problem_->scaling_left().data()),
+        m,
+        rho_);
+
+    // temp1_ = w and its norm
+    ADMMDualVariableKernel<T>
+      <<<ResidualSums<T>::grid_size(n), block, 0, stream>>>(
+        residual_sums_.d_partials(),
+        residual_sums_.d_sums() + 3,
+        residual_sums_.d_count(),
+        thrust::raw_pointer_cast(temp1_.data()),
+        thrust::raw_pointer_cast(x_half_.data()),
+        thrust::raw_pointer_cast(x_proj_.data()),
+        thrust::raw_pointer_cast(x_dual_.data()),
+        thrust::raw_pointer_cast(this->problem_->scaling_right().data()),
+        n,
+        rho_);
 
     // Compute w + K^T y
-    this->problem_->linop()->EvalAdjoint(temp1_, temp2_, 1);
+    this->problem_->linop()->EvalAdjoint(temp1_, temp2_, 1, stream);
+
+    ADMMDualResidualKernel<T>
+      <<<ResidualSums<T>::grid_size(n), block, 0, stream>>>(
+        residual_sums_.d_partials(),
+        residual_sums_.d_sums() + 2,
+        residual_sums_.d_count(),
+        thrust::raw_pointer_cast(temp1_.data()),
+        thrust::raw_pointer_cast(this->problem_->scaling_right().data()),
+        n);
 
-    // scale with Tau^{1/2}
-    thrust::transform(
-      this->problem_->scaling_right().begin(), 
-      this->problem_->scaling_right().end(), 
-      temp1_.begin(), 
-      temp1_.begin(),
-      gemv_functor1<T>());
+    // single transfer of all four sums
+    residual_sums_.CopyToHost(stream);
+    residual_sums_.Ready(true);
 
-    // reduce temp1_ to get residual
-    nrm2(hdl_, this->problem_->ncols(), thrust::raw_pointer_cast(temp1_.data()), &dual_residual);
+    const T *sums = residual_sums_.host();
 
     // fill variables, adapt stepsizes, rescale tilde variables
-    this->primal_residual_ = primal_residual;
-    this->primal_var_norm_ = primal_var_norm;
-    this->dual_residual_ = dual_residual;
-    this->dual_var_norm_ = dual_var_norm;
+    this->primal_residual_ = std::sqrt(sums[0]);
+    this->primal_var_norm_ = std::sqrt(sums[1]);
+    this->dual_residual_ = std::sqrt(sums[2]);
+    this->dual_var_norm_ = std::sqrt(sums[3]);
+
+    this->UpdateResidualSchedule(iteration_);
 
     T eps_primal = this->eps_primal();
     T eps_dual = this->eps_dual();
@@ -650,24 +986,38 @@ void BackendADMM<T>::PerformIteration()
     if(std::abs(rho_ - rho_prev) > 1e-7)
     {
       thrust::transform(
+          thrust::cuda::par.on(stream),
           x_dual_.begin(),
           x_dual_.end(),
           x_dual_.begin(),
           (rho_prev / rho_) * thrust::placeholders::_1);
 
       thrust::transform(
+          thrust::cuda::par.on(stream),
           z_dual_.begin(),
           z_dual_.end(),
           z_dual_.begin(),
           (rho_prev / rho_) * thrust::placeholders::_1);
     }
   }
+
+  if(this->history_.enabled())
+  {
+    const T nan = ConvergenceHistory<T>::nan();
+
+    this->history_.Record(
+      this->MakeHistoryEntry(iteration_, residuals, nan, nan, nan, rho, cg_iters),
+      nullptr, d_cg_iters, stream);
+  }
 }
 
 template<typename T>
 void BackendADMM<T>::Release()
 {
-  cublasDestroy_v2(hdl_);
+  residual_sums_.Release();
+  this->history_.Release();
+  cholesky_.Release();
+  fused_cgls_.Release();
 }
 
 template<typename T>
@@ -744,13 +1094,44 @@ void BackendADMM<T>::current_solution(
   thrust::copy(z_half_.begin(), z_half_.end(), primal_z.begin());
 }
 
+template<typename T>
+void BackendADMM<T>::StateVectors(vector<thrust::device_vector<T>*>& vectors)
+{
+  // temp3_ holds the warm start of the projection
+  vectors = { &x_half_, &z_half_, &x_proj_, &z_proj_, &x_dual_, &z_dual_, &temp3_ };
+}
+
+template<typename T>
+void BackendADMM<T>::GetStateScalars(vector<double>& scalars)
+{
+  scalars.push_back(rho_);
+  scalars.push_back(delta_);
+  scalars.push_back(arb_u_);
+  scalars.push_back(arb_l_);
+  scalars.push_back(static_cast<double>(iteration_));
+  this->GetBaseStateScalars(scalars);
+}
+
+template<typename T>
+void BackendADMM<T>::SetStateScalars(const vector<double>& scalars, cudaStream_t stream)
+{
+  size_t pos = 0;
+  rho_ = static_cast<T>(scalars[pos++]);
+  delta_ = static_cast<T>(scalars[pos++]);
+  arb_u_ = static_cast<int>(scalars[pos++]);
+  arb_l_ = static_cast<int>(scalars[pos++]);
+  iteration_ = static_cast<size_t>(scalars[pos++]);
+  this->SetBaseStateScalars(scalars, pos);
+}
+
 template<typename T>
 size_t BackendADMM<T>::gpu_mem_amount() const
 {
   size_t m = this->problem_->nrows();
   size_t n = this->problem_->ncols();
 
-  return (4 * (n + m) + std::max(m, n)) * sizeof(T);
+  return (4 * (n + m) + std::max(m, n)) * sizeof(T) + cholesky_.gpu_mem_amount() +
+    fused_cgls_.gpu_mem_amount();
 }
 
 // Explicit template instantiation
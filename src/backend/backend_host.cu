@@ -0,0 +1,489 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "prost/backend/backend_host.hpp"
+#include "prost/linop/linearoperator.hpp"
+#include "prost/prox/prox.hpp"
+#include "prost/prox/prox_moreau.hpp"
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+
+namespace prost {
+
+// Converts triplets into CSR format with sorted column indices. Rows are
+// the first, columns the second index vector.
+template<typename T>
+static void TripletsToCSR(
+  size_t num_rows,
+  const vector<int32_t>& rows,
+  const vector<int32_t>& cols,
+  const vector<T>& vals,
+  vector<int32_t>& ptr,
+  vector<int32_t>& ind,
+  vector<T>& val)
+{
+  const size_t nnz = vals.size();
+
+  // counting sort over the columns first, so that the stable sort over the
+  // rows leaves the columns of each row sorted
+  int32_t num_cols = 0;
+  for(int32_t c : cols)
+    num_cols = std::max(num_cols, c + 1);
+
+  vector<int32_t> col_ptr(num_cols + 1, 0), order(nnz);
+  for(size_t k = 0; k < nnz; k++)
+    col_ptr[cols[k] + 1]++;
+
+  for(int32_t j = 0; j < num_cols; j++)
+    col_ptr[j + 1] += col_ptr[j];
+
+  for(size_t k = 0; k < nnz; k++)
+    order[col_ptr[cols[k]]++] = static_cast<int32_t>(k);
+
+  ptr.assign(num_rows + 1, 0);
+  ind.resize(nnz);
+  val.resize(nnz);
+
+  for(size_t k = 0; k < nnz; k++)
+    ptr[rows[k] + 1]++;
+
+  for(size_t i = 0; i < num_rows; i++)
+    ptr[i + 1] += ptr[i];
+
+  vector<int32_t> pos(ptr.begin(), ptr.end() - 1);
+  for(int32_t k : order)
+  {
+    ind[pos[rows[k]]] = cols[k];
+    val[pos[rows[k]]++] = vals[k];
+  }
+}
+
+template<typename T>
+BackendHost<T>::BackendHost(const typename BackendHost<T>::Options& opts)
+  : opts_(opts)
+{
+}
+
+template<typename T>
+BackendHost<T>::~BackendHost()
+{
+}
+
+template<typename T>
+void 
+BackendHost<T>::Initialize()
+{
+  const size_t m = this->problem_->nrows();
+  const size_t n = this->problem_->ncols();
+
+  try
+  {
+    x_.assign(n, 0);
+    x_prev_.assign(n, 0);
+    kty_.assign(n, 0);
+    kty_prev_.assign(n, 0);
+    arg_primal_.assign(n, 0);
+    y_.assign(m, 0);
+    y_prev_.assign(m, 0);
+    kx_.assign(m, 0);
+    kx_prev_.assign(m, 0);
+    arg_dual_.assign(m, 0);
+  }
+  catch(std::bad_alloc& e)
+  {
+    std::stringstream ss;
+    ss << "Out of host memory: " << e.what();
+    throw Exception(ss.str());
+  }
+
+  BuildOperator();
+
+  iteration_ = 0;
+  this->ResetResidualSchedule(opts_.residual_iter);
+  theta_ = 1;
+
+  // the conjugates are evaluated through the Moreau identity. the proxs
+  // are not initialized, as they live on the host.
+  prox_g_.clear();
+  prox_fstar_.clear();
+
+  if(this->problem_->prox_g().empty())
+  {
+    if(this->problem_->prox_gstar().empty())
+      throw Exception("Neither prox_g nor prox_gstar specified.");
+
+    for(auto& p : this->problem_->prox_gstar())
+      prox_g_.push_back( std::shared_ptr<Prox<T> >(new ProxMoreau<T>(p)) );
+  }
+  else
+    prox_g_ = this->problem_->prox_g();
+
+  if(this->problem_->prox_fstar().empty())
+  {
+    if(this->problem_->prox_f().empty())
+      throw Exception("Neither prox_f nor prox_fstar specified.");
+
+    for(auto& p : this->problem_->prox_f())
+      prox_fstar_.push_back( std::shared_ptr<Prox<T> >(new ProxMoreau<T>(p)) );
+  }
+  else
+    prox_fstar_ = this->problem_->prox_fstar();
+
+  // set residuals to zero
+  this->primal_var_norm_ = 0;
+  this->dual_var_norm_ = 0;
+  this->primal_residual_ = 0;
+  this->dual_residual_ = 0;
+
+  ResetStepsizes();
+
+  if(this->solver_opts_.x0.size() > 0)
+  {
+    if(this->solver_opts_.x0.size() == n)
+    {
+      x_ = this->solver_opts_.x0;
+      x_prev_ = this->solver_opts_.x0;
+    }
+    else
+      throw Exception("Initial primal solution has wrong size.");
+  }
+
+  if(this->solver_opts_.y0.size() > 0)
+  {
+    if(this->solver_opts_.y0.size() == m)
+    {
+      y_ = this->solver_opts_.y0;
+      y_prev_ = this->solver_opts_.y0;
+    }
+    else
+      throw Exception("Initial dual solution has wrong size.");
+  }
+
+  Multiply(kx_, x_, false);
+  Multiply(kty_, y_, true);
+}
+
+template<typename T>
+void 
+BackendHost<T>::BuildOperator()
+{
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+
+  if(!this->problem_->linop()->GetTriplets(rows, cols, vals))
+    throw Exception("BackendHost: the linear operator contains blocks which do not store their entries.");
+
+  TripletsToCSR<T>(this->problem_->nrows(), rows, cols, vals, ptr_, ind_, val_);
+  TripletsToCSR<T>(this->problem_->ncols(), cols, rows, vals, ptr_t_, ind_t_, val_t_);
+}
+
+template<typename T>
+void 
+BackendHost<T>::Multiply(vector<T>& result, const vector<T>& rhs, bool adjoint) const
+{
+  const vector<int32_t>& ptr = adjoint ? ptr_t_ : ptr_;
+  const vector<int32_t>& ind = adjoint ? ind_t_ : ind_;
+  const vector<T>& val = adjoint ? val_t_ : val_;
+
+  const ptrdiff_t num_rows = static_cast<ptrdiff_t>(ptr.size()) - 1;
+
+#pragma omp parallel for schedule(static)
+  for(ptrdiff_t r = 0; r < num_rows; r++)
+  {
+    T sum = 0;
+
+#pragma omp simd reduction(+:sum)
+    for(int32_t i = ptr[r]; i < ptr[r + 1]; i++)
+      sum += val[i] * rhs[ind[i]];
+
+    result[r] = sum;
+  }
+}
+
+template<typename T>
+T 
+BackendHost<T>::NormEstimate(T tol, int max_iters) const
+{
+  // power method on A^T A with A = Sigma^{1/2} K Tau^{1/2}, like
+  // Problem::normest
+  const vector<T>& sigma = this->problem_->host_scaling_left();
+  const vector<T>& tau = this->problem_->host_scaling_right();
+  const ptrdiff_t n = static_cast<ptrdiff_t>(x_.size());
+  const ptrdiff_t m = static_cast<ptrdiff_t>(y_.size());
+
+  vector<T> v(n, 1), tv(n), av(m), atav(n);
+  T norm = 0;
+
+  for(int it = 0; it < max_iters; it++)
+  {
+    T norm_v = 0;
+#pragma omp parallel for simd reduction(+:norm_v)
+    for(ptrdiff_t i = 0; i < n; i++)
+      norm_v += v[i] * v[i];
+
+    norm_v = std::sqrt(norm_v);
+    if(norm_v == 0)
+      return 0;
+
+#pragma omp parallel for simd
+    for(ptrdiff_t i = 0; i < n; i++)
+      tv[i] = std::sqrt(tau[i]) * v[i] / norm_v;
+
+    Multiply(av, tv, false);
+
+#pragma omp parallel for simd
+    for(ptrdiff_t i = 0; i < m; i++)
+      av[i] *= sigma[i];
+
+    Multiply(atav, av, true);
+
+#pragma omp parallel for simd
+    for(ptrdiff_t i = 0; i < n; i++)
+      v[i] = std::sqrt(tau[i]) * atav[i];
+
+    // v_j^T A^T A v_j / |v_j|^2, with v_j normalized
+    T rayleigh = 0;
+#pragma omp parallel for simd reduction(+:rayleigh)
+    for(ptrdiff_t i = 0; i < n; i++)
+      rayleigh += v[i] * tv[i] / std::sqrt(tau[i]);
+
+    const T norm_prev = norm;
+    norm = std::sqrt(std::max<T>(rayleigh, 0));
+
+    if(it > 0 && std::abs(norm - norm_prev) <= tol * norm)
+      break;
+  }
+
+  return norm;
+}
+
+template<typename T>
+void 
+BackendHost<T>::PerformIteration(cudaStream_t stream)
+{
+  const vector<T>& sigma_diag = this->problem_->host_scaling_left();
+  const vector<T>& tau_diag = this->problem_->host_scaling_right();
+  const ptrdiff_t n = static_cast<ptrdiff_t>(x_.size());
+  const ptrdiff_t m = static_cast<ptrdiff_t>(y_.size());
+  const T tau = tau_, sigma = sigma_, theta = theta_;
+
+  // x^{k+1} = prox_g(x^k - tau T K^T y^k)
+  {
+    const T *x = x_.data(), *t = tau_diag.data(), *kty = kty_.data();
+    T *arg = arg_primal_.data();
+
+#pragma omp parallel for simd
+    for(ptrdiff_t i = 0; i < n; i++)
+      arg[i] = x[i] - tau * t[i] * kty[i];
+  }
+
+  x_.swap(x_prev_);
+  for(auto& p : prox_g_)
+    p->EvalHost(x_, arg_primal_, tau_diag, tau_, false);
+
+  // y^{k+1} = prox_fstar(y^k + sigma S K (x^{k+1} + theta (x^{k+1} - x^k)))
+  kx_.swap(kx_prev_);
+  Multiply(kx_, x_, false);
+
+  {
+    const T *y = y_.data(), *s = sigma_diag.data();
+    const T *kx = kx_.data(), *kx_prev = kx_prev_.data();
+    T *arg = arg_dual_.data();
+
+#pragma omp parallel for simd
+    for(ptrdiff_t i = 0; i < m; i++)
+      arg[i] = y[i] + sigma * s[i] * ((1 + theta) * kx[i] - theta * kx_prev[i]);
+  }
+
+  y_.swap(y_prev_);
+  for(auto& p : prox_fstar_)
+    p->EvalHost(y_, arg_dual_, sigma_diag, sigma_, false);
+
+  kty_.swap(kty_prev_);
+  Multiply(kty_, y_, true);
+
+  const bool residuals = this->residual_schedule_.is_due(iteration_);
+
+  if(residuals)
+  {
+    this->residual_schedule_.Issued(iteration_);
+    ComputeResiduals();
+    this->UpdateResidualSchedule(iteration_);
+  }
+
+  iteration_++;
+
+  this->RecordHistoryHost(this->MakeHistoryEntry(
+    iteration_, residuals, tau, sigma, theta, ConvergenceHistory<T>::nan(), -1));
+}
+
+template<typename T>
+void 
+BackendHost<T>::ComputeResiduals()
+{
+  const vector<T>& sigma_diag = this->problem_->host_scaling_left();
+  const vector<T>& tau_diag = this->problem_->host_scaling_right();
+  const ptrdiff_t n = static_cast<ptrdiff_t>(x_.size());
+  const ptrdiff_t m = static_cast<ptrdiff_t>(y_.size());
+  const T tau = tau_, sigma = sigma_, theta = theta_;
+
+  // same scaling as primal_residual_transform and dual_residual_transform
+  // of BackendPDHG
+  T res_primal = 0, norm_z = 0;
+  {
+    const T *y = y_.data(), *y_prev = y_prev_.data(), *s = sigma_diag.data();
+    const T *kx = kx_.data(), *kx_prev = kx_prev_.data();
+
+#pragma omp parallel for simd reduction(+:res_primal,norm_z)
+    for(ptrdiff_t i = 0; i < m; i++)
+    {
+      const T sqrt_s = std::sqrt(s[i]);
+      const T z_hat = (y_prev[i] - y[i]) / (sigma * sqrt_s) + 
+        sqrt_s * ((1 + theta) * kx[i] - theta * kx_prev[i]);
+      const T diff = z_hat - sqrt_s * kx[i];
+
+      res_primal += diff * diff;
+      norm_z += z_hat * z_hat;
+    }
+  }
+
+  T res_dual = 0, norm_w = 0;
+  {
+    const T *x = x_.data(), *x_prev = x_prev_.data(), *t = tau_diag.data();
+    const T *kty = kty_.data(), *kty_prev = kty_prev_.data();
+
+#pragma omp parallel for simd reduction(+:res_dual,norm_w)
+    for(ptrdiff_t i = 0; i < n; i++)
+    {
+      const T sqrt_t = std::sqrt(t[i]);
+      const T w_hat = (x_prev[i] - x[i]) / (tau * sqrt_t) - sqrt_t * kty_prev[i];
+      const T diff = w_hat + sqrt_t * kty[i];
+
+      res_dual += diff * diff;
+      norm_w += w_hat * w_hat;
+    }
+  }
+
+  this->primal_residual_ = std::sqrt(res_primal);
+  this->primal_var_norm_ = std::sqrt(norm_z);
+  this->dual_residual_ = std::sqrt(res_dual);
+  this->dual_var_norm_ = std::sqrt(norm_w);
+}
+
+template<typename T>
+void 
+BackendHost<T>::ResetStepsizes()
+{
+  tau_ = opts_.tau0;
+  sigma_ = opts_.sigma0;
+
+  if(opts_.scale_steps_operator)
+  {
+    T norm = NormEstimate(opts_.normest_tol);
+
+    if(std::abs(norm - 1) > 0.1)
+    {
+      tau_ /= norm;
+      sigma_ /= norm;
+
+      if(this->solver_opts_.verbose)
+        std::cout << "|K|=" << norm << " => Rescaled tau=" << tau_ << ", sigma=" << sigma_ << "." << std::endl; 
+    }
+  }
+}
+
+template<typename T>
+void 
+BackendHost<T>::ProblemChanged(cudaStream_t stream)
+{
+  // the entries of the blocks may have changed in place
+  BuildOperator();
+  this->RestartResiduals();
+
+  // the steps have to fit the norm of the new operator
+  if(opts_.scale_steps_operator)
+  {
+    ResetStepsizes();
+    theta_ = 1;
+  }
+
+  Multiply(kty_, y_, true);
+}
+
+template<typename T>
+void 
+BackendHost<T>::Release()
+{
+  prox_g_.clear();
+  prox_fstar_.clear();
+
+  val_.clear(); val_.shrink_to_fit();
+  val_t_.clear(); val_t_.shrink_to_fit();
+  ptr_.clear(); ptr_.shrink_to_fit();
+  ind_.clear(); ind_.shrink_to_fit();
+  ptr_t_.clear(); ptr_t_.shrink_to_fit();
+  ind_t_.clear(); ind_t_.shrink_to_fit();
+}
+
+template<typename T>
+void 
+BackendHost<T>::current_solution(vector<T>& primal, vector<T>& dual) 
+{
+  std::copy(x_.begin(), x_.end(), primal.begin());
+  std::copy(y_.begin(), y_.end(), dual.begin());
+}
+
+template<typename T>
+void 
+BackendHost<T>::current_solution(
+    vector<T>& primal_x,
+    vector<T>& primal_z,
+    vector<T>& dual_y,
+    vector<T>& dual_w) 
+{
+  const vector<T>& sigma_diag = this->problem_->host_scaling_left();
+  const vector<T>& tau_diag = this->problem_->host_scaling_right();
+  const ptrdiff_t n = static_cast<ptrdiff_t>(x_.size());
+  const ptrdiff_t m = static_cast<ptrdiff_t>(y_.size());
+
+  std::copy(x_.begin(), x_.end(), primal_x.begin());
+  std::copy(y_.begin(), y_.end(), dual_y.begin());
+
+  // as compute_w_variable_functor and compute_z_variable_functor
+#pragma omp parallel for simd
+  for(ptrdiff_t i = 0; i < n; i++)
+    dual_w[i] = (x_prev_[i] - x_[i]) / (tau_diag[i] * tau_) - kty_prev_[i];
+
+#pragma omp parallel for simd
+  for(ptrdiff_t i = 0; i < m; i++)
+    primal_z[i] = (y_prev_[i] - y_[i]) / (sigma_ * sigma_diag[i]) + 
+      (1 + theta_) * kx_[i] - theta_ * kx_prev_[i];
+}
+
+// Explicit template instantiation
+template class BackendHost<float>;
+template class BackendHost<double>;
+
+} // namespace prost
@@ -19,18 +19,30 @@
 */
 
 #include <algorithm>
+#include <cmath>
 
+#include <thrust/copy.h>
+#include <thrust/fill.h>
 #include <thrust/for_each.h>
+#include <thrust/functional.h>
+#include <thrust/reduce.h>
 #include <thrust/device_vector.h>
+#include <thrust/transform.h>
 #include <thrust/transform_reduce.h>
+#include <thrust/iterator/constant_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
 #include <thrust/iterator/zip_iterator.h>
+#include <thrust/system/cuda/execution_policy.h>
 
 #include "prost/backend/backend_pdhg.hpp"
+#include "prost/backend/persistent_pdhg.hpp"
 #include "prost/linop/linearoperator.hpp"
 #include "prost/prox/prox.hpp"
+#include "prost/prox/prox_argument.hpp"
 #include "prost/prox/prox_moreau.hpp"
 #include "prost/exception.hpp"
 #include "prost/problem.hpp"
+#include "prost/profiler.hpp"
 
 namespace prost {
 
@@ -69,72 +81,56 @@ struct dual_proxarg_functor
   T theta_;
 };
 
-/// \brief Computes the (scaled) dual residual 
+/// \brief Reduces (|Kx - z|^2, |z|^2) over the first num_rows and 
+///        (|K^T y + w|^2, |w|^2) over the first num_cols entries in a
+///        single pass, into d_sums[0..4).
 template<typename T>
-struct dual_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T,T,T>, thrust::tuple<T,T> >
+__global__
+void ResidualSumsKernel(
+  T *d_partials,
+  T *d_sums,
+  unsigned int *d_count,
+  const T *d_y_prev,
+  const T *d_y,
+  const T *d_scaling_left,
+  const T *d_kx_prev,
+  const T *d_kx,
+  size_t num_rows,
+  const T *d_x_prev,
+  const T *d_x,
+  const T *d_scaling_right,
+  const T *d_kty_prev,
+  const T *d_kty,
+  size_t num_cols,
+  primal_residual_transform<T> primal,
+  dual_residual_transform<T> dual)
 {
-  typedef typename thrust::tuple<T,T,T,T,T> InputTuple;
-  typedef typename thrust::tuple<T,T> OutputTuple;
+  T acc[4] = { 0, 0, 0, 0 };
 
-  __host__ __device__ dual_residual_transform(T tau)
-  : tau_(tau) { }
-
-  __host__ __device__
-  OutputTuple operator()(const InputTuple& t)
-  {
-    const T tau_diag = thrust::get<2>(t);
-    const T w_hat = (thrust::get<0>(t) - thrust::get<1>(t)) / (tau_ * sqrt(tau_diag)) - 
-                    sqrt(tau_diag) * thrust::get<3>(t);
-    const T diff = w_hat + sqrt(tau_diag) * thrust::get<4>(t); // w_hat^{k+1} + T K^T y^{k+1}
-
-    return OutputTuple(diff * diff, w_hat * w_hat);
-  }  
-
-  T tau_;
-};
-
-/// \brief Computes the (scaled) primal residual
-template<typename T>
-struct primal_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T,T,T>, thrust::tuple<T, T> >
-{
-  typedef typename thrust::tuple<T,T,T,T,T> InputTuple;
-  typedef typename thrust::tuple<T,T> OutputTuple;
-
-  __host__ __device__ primal_residual_transform(T sigma, T theta)
-      : sigma_(sigma), theta_(theta) { }
-
-  __host__ __device__
-  OutputTuple operator()(const InputTuple& t)
+  const size_t count = max(num_rows, num_cols);
+  for(size_t i = threadIdx.x + blockIdx.x * blockDim.x; i < count; i += blockDim.x * gridDim.x)
   {
-    const T sigma_diag = thrust::get<2>(t);
-    const T z_hat = (thrust::get<0>(t) - thrust::get<1>(t)) / (sigma_ * sqrt(sigma_diag)) +
-                    sqrt(sigma_diag) * ((1 + theta_) * thrust::get<4>(t) - theta_ * thrust::get<3>(t));
-      
-    const T diff = z_hat - sqrt(sigma_diag) * thrust::get<4>(t);
-
-    return OutputTuple(diff * diff, z_hat * z_hat);
-  }  
+    if(i < num_rows)
+    {
+      thrust::tuple<T, T> r = primal(thrust::make_tuple(
+        d_y_prev[i], d_y[i], d_scaling_left[i], d_kx_prev[i], d_kx[i]));
 
-  T sigma_;
-  T theta_;
-};
+      acc[0] += thrust::get<0>(r);
+      acc[1] += thrust::get<1>(r);
+    }
 
-/// \brief Helper 
-template<typename T>
-struct residual_tuple_sum : public thrust::binary_function< thrust::tuple<T, T>, 
-                                                              thrust::tuple<T, T>,
-  thrust::tuple<T, T> >
-{
-  typedef typename thrust::tuple<T, T> Tuple;
+    if(i < num_cols)
+    {
+      thrust::tuple<T, T> r = dual(thrust::make_tuple(
+        d_x_prev[i], d_x[i], d_scaling_right[i], d_kty_prev[i], d_kty[i]));
 
-  __host__ __device__
-  Tuple operator()(const Tuple& t0, const Tuple& t1) const
-  {
-    return Tuple(
-        thrust::get<0>(t0) + thrust::get<0>(t1), 
-        thrust::get<1>(t0) + thrust::get<1>(t1));
+      acc[2] += thrust::get<0>(r);
+      acc[3] += thrust::get<1>(r);
+    }
   }
-};
+
+  ResidualSumsReduce<T, 4>(acc, d_partials, d_sums, d_count);
+}
 
 /*
           x_prev_.end(), 0
@@ -185,15 +181,153 @@ struct compute_z_variable_functor
   T theta_;
 };
 
+/// \brief Recovers x^k = <0> + tau T K^T y^k from the primal prox argument
+///        in <0> and overwrites it by x^{k+1} + theta (x^{k+1} - x^k). If
+///        store_w is set, <3> is overwritten by w^{k+1} = (<0> - x^{k+1}) / (tau T).
+template<typename T>
+struct low_memory_extrapolate_functor
+{
+  __host__ __device__ low_memory_extrapolate_functor(T tau, T theta, bool store_w)
+      : tau_(tau), theta_(theta), store_w_(store_w) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    const T arg = thrust::get<0>(t);
+    const T x = thrust::get<1>(t);
+    const T tau_diag = tau_ * thrust::get<2>(t);
+    const T x_prev = arg + tau_diag * thrust::get<3>(t);
+
+    thrust::get<0>(t) = (1 + theta_) * x - theta_ * x_prev;
+
+    if(store_w_)
+      thrust::get<3>(t) = (arg - x) / tau_diag;
+  }
+
+  T tau_;
+  T theta_;
+  bool store_w_;
+};
+
+/// \brief Computes <0> = -z^{k+1} = -(<1> - <2>) / (sigma <3>) from the dual
+///        prox argument in <1> and y^{k+1} in <2>.
+template<typename T>
+struct low_memory_z_functor
+{
+  __host__ __device__ low_memory_z_functor(T sigma) : sigma_(sigma) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    thrust::get<0>(t) = (thrust::get<2>(t) - thrust::get<1>(t)) / (sigma_ * thrust::get<3>(t));
+  }
+
+  T sigma_;
+};
+
+/// \brief Computes d (a + b)^2 for (a, b, d).
+template<typename T>
+struct low_memory_square_transform : public thrust::unary_function<thrust::tuple<T,T,T>, T>
+{
+  __host__ __device__
+  T operator()(const thrust::tuple<T,T,T>& t) const
+  {
+    const T v = thrust::get<0>(t) + thrust::get<1>(t);
+
+    return thrust::get<2>(t) * v * v;
+  }
+};
+
+/// \brief Multiplies by a constant factor.
+template<typename T>
+struct restart_scale_functor : public thrust::unary_function<T, T>
+{
+  __host__ __device__ restart_scale_functor(T scale) : scale_(scale) { }
+
+  __host__ __device__
+  T operator()(const T& x) const
+  {
+    return scale_ * x;
+  }
+
+  T scale_;
+};
+
+/// \brief Computes |x1 - scale0 x0|^2 / (tau T), the primal part of the 
+///        squared fixed point residual.
+template<typename T>
+struct restart_primal_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T>, T>
+{
+  __host__ __device__ restart_primal_residual_transform(T tau, T scale0)
+      : tau_(tau), scale0_(scale0) { }
+
+  __host__ __device__
+  T operator()(const thrust::tuple<T,T,T>& t) const
+  {
+    const T dx = thrust::get<1>(t) - scale0_ * thrust::get<0>(t);
+
+    return dx * dx / (tau_ * thrust::get<2>(t));
+  }
+
+  T tau_;
+  T scale0_;
+};
+
+/// \brief Computes |y1 - scale0 y0|^2 / (sigma S) - 2 (K x1 - scale0 K x0)(y1 - scale0 y0),
+///        the dual and coupling part of the squared fixed point residual.
+template<typename T>
+struct restart_dual_residual_transform : public thrust::unary_function<thrust::tuple<T,T,T,T,T>, T>
+{
+  __host__ __device__ restart_dual_residual_transform(T sigma, T scale0)
+      : sigma_(sigma), scale0_(scale0) { }
+
+  __host__ __device__
+  T operator()(const thrust::tuple<T,T,T,T,T>& t) const
+  {
+    const T dy = thrust::get<1>(t) - scale0_ * thrust::get<0>(t);
+    const T dkx = thrust::get<4>(t) - scale0_ * thrust::get<3>(t);
+
+    return dy * dy / (sigma_ * thrust::get<2>(t)) - 2 * dkx * dy;
+  }
+
+  T sigma_;
+  T scale0_;
+};
+
+/// \brief Computes |a - b|^2 / d, used for the distance to the last restart point.
+template<typename T>
+struct restart_distance_transform : public thrust::unary_function<thrust::tuple<T,T,T>, T>
+{
+  __host__ __device__
+  T operator()(const thrust::tuple<T,T,T>& t) const
+  {
+    const T diff = thrust::get<0>(t) - thrust::get<1>(t);
+
+    return diff * diff / thrust::get<2>(t);
+  }
+};
+
 template<typename T>
 BackendPDHG<T>::BackendPDHG(const typename BackendPDHG<T>::Options& opts)
-    : opts_(opts)
+    : opts_(opts), async_residuals_(false), residual_pending_(false), capturing_(false),
+      gap_enabled_(false), snapshot_stream_(nullptr), snapshot_count_(0)
 {
+  for(Snapshot& snap : snapshots_)
+  {
+    snap.host = nullptr;
+    snap.staged = nullptr;
+    snap.copied = nullptr;
+    snap.pending = false;
+    snap.order = 0;
+  }
 }
 
 template<typename T>
 BackendPDHG<T>::~BackendPDHG()
 {
+  Release();
 }
 
 template<typename T>
@@ -204,29 +338,38 @@ BackendPDHG<T>::Initialize()
   size_t n = this->problem_->ncols();
   size_t l = std::max(m, n);
 
+  if(opts_.low_memory &&
+     opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+  {
+    throw Exception("BackendPDHG: the restarted step size scheme needs the previous iterates, disable low_memory.");
+  }
+
+  // in the low memory mode the previous iterates are not stored
+  const size_t n_prev = opts_.low_memory ? 0 : n;
+  const size_t m_prev = opts_.low_memory ? 0 : m;
+
   // allocate variables
   try
   {
     x_.resize(n, 0);
-    x_prev_.resize(n, 0);
-    kty_prev_.resize(n, 0);
+    x_prev_.resize(n_prev, 0);
+    kty_prev_.resize(n_prev, 0);
     kty_.resize(n, 0);
     y_.resize(m, 0);
-    y_prev_.resize(m, 0);
+    y_prev_.resize(m_prev, 0);
     kx_.resize(m, 0);
-    kx_prev_.resize(m, 0);
+    kx_prev_.resize(m_prev, 0);
     temp_.resize(l, 0);
   }
   catch(std::bad_alloc& e)
   {
     std::stringstream ss;
     ss << "Out of memory: " << e.what();
-    throw Exception(ss.str());
+    throw OutOfMemoryException(ss.str());
   }
 
   iteration_ = 0;
-  tau_ = opts_.tau0;
-  sigma_ = opts_.sigma0;
+  this->ResetResidualSchedule(opts_.residual_iter);
   theta_ = 1;
 
   arb_l_ = arb_u_ = 0;
@@ -265,32 +408,138 @@ BackendPDHG<T>::Initialize()
   else
     prox_fstar_ = this->problem_->prox_fstar();
 
-  // set residuals to zero
-  this->primal_var_norm_ = 0;
-  this->dual_var_norm_ = 0;
-  this->primal_residual_ = 0;
-  this->dual_residual_ = 0;
+  // fuse prox argument computation into the proxs if all of them support it
+  auto fusable = [](const shared_ptr<Prox<T> >& p) { return p->supports_fused_eval(); };
+  // the fused proxs read the previous iterate from a separate buffer
+  fused_primal_ = opts_.fuse_prox_arg && !opts_.low_memory &&
+    std::all_of(prox_g_.begin(), prox_g_.end(), fusable);
+  fused_dual_ = opts_.fuse_prox_arg && !opts_.low_memory &&
+    std::all_of(prox_fstar_.begin(), prox_fstar_.end(), fusable);
+  primal_arg_ready_ = false;
+
+  // only fused iterations with constant step sizes are free of host
+  // synchronization and can be captured into a graph. the graph has to
+  // contain an even number of iterations, so the buffer swaps cancel out,
+  // and must not contain an iteration which evaluates the residuals.
+  graph_length_ = 0;
+#if CUDART_VERSION >= 10010
+  graph_exec_ = nullptr;
+
+  if(fused_primal_ && fused_dual_ &&
+     opts_.stepsize_variant != BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg2)
+  {
+    graph_length_ = 2 * ((opts_.residual_iter - 1) / 2);
+  }
+#endif
 
-  if(opts_.scale_steps_operator)
+  // the residuals are reduced into device memory and read back through
+  // pinned memory, asynchronously if requested
+  async_residuals_ = this->solver_opts_.async_convergence_check && !opts_.low_memory;
+  residual_pending_ = false;
+  residual_iteration_ = 0;
+  capturing_ = false;
+
+  residual_sums_.Initialize();
+  this->InitializeHistory();
+
+  // the gap needs K x^k and K^T y^k of the same iterate, which the low 
+  // memory mode does not keep
+  auto has_energy = [](const shared_ptr<Prox<T> >& p) { return p->supports_energy(); };
+  gap_enabled_ = this->solver_opts_.tol_gap > 0 && !opts_.low_memory &&
+    std::all_of(prox_g_.begin(), prox_g_.end(), has_energy) &&
+    std::all_of(prox_fstar_.begin(), prox_fstar_.end(), has_energy);
+
+  if(this->solver_opts_.tol_gap > 0 && !gap_enabled_ && this->solver_opts_.verbose)
+    cout << "BackendPDHG: the primal-dual gap is not available for this problem, using the residuals only." << endl;
+
+  if(gap_enabled_)
   {
-    T norm = this->problem_->normest();
+    try
+    {
+      gap_terms_.resize(n + m);
+    }
+    catch(std::bad_alloc& e)
+    {
+      throw OutOfMemoryException("BackendPDHG: out of memory for the primal-dual gap.");
+    }
+  }
 
-    if(std::abs(norm - 1) > 0.1)
+  // running sums and restart point of the restarted scheme
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+  {
+    if(opts_.restart_iter < 1)
+      throw Exception("BackendPDHG: restart_iter has to be positive.");
+
+    try
     {
-      tau_ /= norm;
-      sigma_ /= norm;
+      x_sum_.resize(n);
+      y_sum_.resize(m);
+      kx_sum_.resize(m);
+      x_plus_.resize(n);
+      y_plus_.resize(m);
+      kx_plus_.resize(m);
+      x_restart_.resize(n);
+      y_restart_.resize(m);
+    }
+    catch(std::bad_alloc& e)
+    {
+      throw OutOfMemoryException("BackendPDHG: out of memory for the restarts.");
+    }
+  }
 
-      if(this->solver_opts_.verbose)
-        cout << "|K|=" << norm << " => Rescaled tau=" << tau_ << ", sigma=" << sigma_ << "." << endl; 
+  // buffers for the snapshots passed to the intermediate callback
+  if(this->solver_opts_.async_snapshots && snapshot_stream_ == nullptr)
+  {
+    if(cudaStreamCreateWithFlags(&snapshot_stream_, cudaStreamNonBlocking) != cudaSuccess)
+    {
+      snapshot_stream_ = nullptr;
+      throw Exception("BackendPDHG: failed to create the snapshot stream.");
+    }
+
+    for(Snapshot& snap : snapshots_)
+    {
+      try
+      {
+        snap.staging.resize(2 * (n + m));
+      }
+      catch(std::bad_alloc& e)
+      {
+        throw OutOfMemoryException("BackendPDHG: out of memory for the snapshots.");
+      }
+
+      if(cudaMallocHost(&snap.host, 2 * (n + m) * sizeof(T)) != cudaSuccess)
+      {
+        snap.host = nullptr;
+        throw Exception("BackendPDHG: failed to allocate pinned memory for the snapshots.");
+      }
+
+      cudaEventCreateWithFlags(&snap.staged, cudaEventDisableTiming);
+      cudaEventCreateWithFlags(&snap.copied, cudaEventDisableTiming);
     }
   }
 
+  for(Snapshot& snap : snapshots_)
+    snap.pending = false;
+  snapshot_count_ = 0;
+
+  // no residuals are known before the first check has been consumed,
+  // which with asynchronous checks is some iterations after it is issued
+  this->primal_var_norm_ = 0;
+  this->dual_var_norm_ = 0;
+  this->primal_residual_ = std::numeric_limits<T>::infinity();
+  this->dual_residual_ = std::numeric_limits<T>::infinity();
+  this->primal_dual_gap_ = std::numeric_limits<T>::infinity();
+
+  ResetStepsizes();
+
   if(this->solver_opts_.x0.size() > 0)
   {
     if(this->solver_opts_.x0.size() == n)
     {
       x_ = this->solver_opts_.x0;
-      x_prev_ = this->solver_opts_.x0;
+
+      if(!opts_.low_memory)
+        x_prev_ = this->solver_opts_.x0;
     }
     else
       throw Exception("Initial primal solution has wrong size.");
@@ -301,20 +550,151 @@ BackendPDHG<T>::Initialize()
     if(this->solver_opts_.y0.size() == m)
     {
       y_ = this->solver_opts_.y0;
-      y_prev_ = this->solver_opts_.y0;
+
+      if(!opts_.low_memory)
+        y_prev_ = this->solver_opts_.y0;
     }
     else
       throw Exception("Initial dual solution has wrong size.");
   }
+
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+    ResetRestart(0);
+
+  InitializePersistent();
+}
+
+template<typename T>
+void
+BackendPDHG<T>::InitializePersistent()
+{
+  persistent_.reset();
+
+  if(!opts_.persistent_kernel)
+    return;
+
+  // the kernel does not evaluate the proxs' energies
+  if(gap_enabled_)
+  {
+    if(this->solver_opts_.verbose)
+      cout << "BackendPDHG: the persistent kernel does not support the primal-dual gap, using regular iterations." << endl;
+
+    return;
+  }
+
+  // the kernel decides on its own when to check the residuals, the other
+  // step size schemes adapt on the host
+  if(opts_.low_memory || this->residual_schedule_.adaptive() ||
+     (opts_.stepsize_variant != BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg1 &&
+      opts_.stepsize_variant != BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg2))
+  {
+    if(this->solver_opts_.verbose)
+      cout << "BackendPDHG: the persistent kernel needs constant or strongly convex step sizes and a fixed residual schedule." << endl;
+
+    return;
+  }
+
+  typename PersistentPDHG<T>::Settings settings;
+  settings.residual_iter = opts_.residual_iter;
+  settings.alg2 = (opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg2);
+  settings.alg2_gamma = opts_.alg2_gamma;
+  settings.eps_abs_primal = std::sqrt(this->problem_->nrows()) * this->solver_opts_.tol_abs_primal;
+  settings.eps_rel_primal = this->solver_opts_.tol_rel_primal;
+  settings.eps_abs_dual = std::sqrt(this->problem_->ncols()) * this->solver_opts_.tol_abs_dual;
+  settings.eps_rel_dual = this->solver_opts_.tol_rel_dual;
+
+  shared_ptr<PersistentPDHG<T> > persistent(new PersistentPDHG<T>());
+
+  if(persistent->Initialize(*this->problem_, prox_g_, prox_fstar_, settings))
+    persistent_ = persistent;
+  else if(this->solver_opts_.verbose)
+    cout << "BackendPDHG: problem not supported by the persistent kernel, using regular iterations." << endl;
+}
+
+template<typename T>
+void 
+BackendPDHG<T>::PerformIteration(cudaStream_t stream)
+{
+  if(opts_.low_memory)
+  {
+    PerformLowMemoryIteration(stream);
+    return;
+  }
+
+  const bool residuals = is_residual_iteration();
+  const T tau = tau_, sigma = sigma_, theta = theta_;
+
+  PrimalStep(stream);
+  DualStep(stream);
+
+  // sums of the history, before the step sizes are adapted
+  const bool history_sums = this->history_.enabled() && !residuals &&
+    this->solver_opts_.history_every_iter;
+
+  if(history_sums)
+    LaunchResidualSums(stream, y_.size(), x_.size(), false);
+
+  UpdateResidualsAndStepsizes(stream);
+
+  iteration_++;
+
+  if(this->history_.enabled())
+  {
+    this->history_.Record(
+      this->MakeHistoryEntry(iteration_, false, tau, sigma, theta, ConvergenceHistory<T>::nan(), -1),
+      (residuals || history_sums) ? residual_sums_.d_sums() : nullptr,
+      nullptr,
+      stream);
+  }
+
+  AdjointStep(stream);
+
+  // x_, y_, K x and K^T y all belong to the new iterate now
+  if(residuals && gap_enabled_)
+    ComputeGap(stream);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::ComputeGap(cudaStream_t stream)
+{
+  ProfileRange range("BackendPDHG::ComputeGap", 0, stream);
+
+  const size_t n = x_.size();
+
+  // g at (x, -K^T y) and f^* at (y, K x)
+  for(auto& prox : prox_g_)
+    prox->EvalGap(gap_terms_.begin(), x_, kty_, 1, -1, stream);
+
+  for(auto& prox : prox_fstar_)
+    prox->EvalGap(gap_terms_.begin() + n, y_, kx_, 1, 1, stream);
+
+  const T gap = thrust::reduce(
+    thrust::cuda::par.on(stream), 
+    gap_terms_.begin(), 
+    gap_terms_.end(), 
+    static_cast<T>(0));
+
+  // the terms add up to a nonnegative value. a negative sum comes from
+  // the slack of the indicators or from rounding and bounds nothing, so it
+  // must not pass tol_gap; the residuals still stop the solver then.
+  this->primal_dual_gap_ = (gap < 0) ? std::numeric_limits<T>::infinity() : gap;
 }
 
 template<typename T>
 void 
-BackendPDHG<T>::PerformIteration()
+BackendPDHG<T>::PerformLowMemoryIteration(cudaStream_t stream)
 {
-  // compute primal prox arg into temp_
-  // thrust::get<3>(t) = thrust::get<0>(t) - tau_ * thrust::get<1>(t) * thrust::get<2>(t);
+  ProfileRange range("BackendPDHG::PerformLowMemoryIteration", 0, stream);
+
+  const size_t m = y_.size();
+  const size_t n = x_.size();
+  const bool residuals = is_residual_iteration();
+  const T tau = tau_, sigma = sigma_, theta = theta_;
+
+  // x^{k+1} = prox_g(x^k - tau T K^T y^k), the argument stays in temp_
   thrust::for_each(
+      thrust::cuda::par.on(stream),
 
       thrust::make_zip_iterator(thrust::make_tuple(
           x_.begin(), 
@@ -326,120 +706,706 @@ BackendPDHG<T>::PerformIteration()
           x_.end(), 
           this->problem_->scaling_right().end(), 
           kty_.end(), 
-          temp_.end())),
+          temp_.begin() + n)),
 
       primal_proxarg_functor<T>(tau_));
 
-  // remember previous primal iterate
-  x_.swap(x_prev_);
-
-  // apply prox_g
   for(auto& p : prox_g_)
-    p->Eval(x_, temp_, this->problem_->scaling_right(), tau_);
+    p->Eval(x_, temp_, this->problem_->scaling_right(), tau_, false, stream);
 
-  // remember Kx^k
-  kx_.swap(kx_prev_);
+  // temp_ = x^{k+1} + theta (x^{k+1} - x^k). for the residuals, K^T y^k 
+  // is replaced by w^{k+1}, it is recomputed below.
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
 
-  // compute Kx^{k+1}
-  this->problem_->linop()->Eval(kx_, x_);
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin(),
+          x_.begin(), 
+          this->problem_->scaling_right().begin(), 
+          kty_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin() + n,
+          x_.end(), 
+          this->problem_->scaling_right().end(), 
+          kty_.end())),
+
+      low_memory_extrapolate_functor<T>(tau_, theta_, residuals));
+
+  // y^{k+1} = prox_fstar(y^k + sigma S K temp_), the argument stays in temp_
+  this->problem_->linop()->Eval(kx_, temp_, 0, stream);
 
-  // compute dual prox arg
-  // thrust::get<4>(t) = thrust::get<0>(t) + sigma_ * thrust::get<1>(t) * 
-  //                     ((1 + theta_) * thrust::get<2>(t) - theta_ * thrust::get<3>(t));
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           y_.begin(),
           this->problem_->scaling_left().begin(),
           kx_.begin(),
-          kx_prev_.begin(),
+          kx_.begin(),
           temp_.begin())),
 
       thrust::make_zip_iterator(thrust::make_tuple(
           y_.end(),
           this->problem_->scaling_left().end(),
           kx_.end(),
-          kx_prev_.end(),
-          temp_.end())),
+          kx_.end(),
+          temp_.begin() + m)),
 
-      dual_proxarg_functor<T>(sigma_, theta_));
+      dual_proxarg_functor<T>(sigma_, 0));
 
-  y_.swap(y_prev_);
-    
-  // apply prox_fstar
   for(auto& p : prox_fstar_)
-    p->Eval(y_, temp_, this->problem_->scaling_left(), sigma_);
+    p->Eval(y_, temp_, this->problem_->scaling_left(), sigma_, false, stream);
 
-  UpdateResidualsAndStepsizes();
+  if(!residuals)
+  {
+    this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+    UpdateStepsizesAlg2();
+    iteration_++;
+
+    this->history_.Record(
+      this->MakeHistoryEntry(iteration_, false, tau, sigma, theta, ConvergenceHistory<T>::nan(), -1),
+      nullptr, nullptr, stream);
+    return;
+  }
 
-  iteration_++;
+  ProfileRange residual_range("BackendPDHG::LowMemoryResiduals", 0, stream);
 
-  // remember K^T y^k
-  kty_.swap(kty_prev_);
+  this->residual_schedule_.Issued(iteration_);
 
-  // compute K^T y^{k+1}
-  this->problem_->linop()->EvalAdjoint(kty_, y_);
-}
+  // kx_ = -z^{k+1}, then kx_ = K x^{k+1} - z^{k+1}
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.begin(),
+          temp_.begin(),
+          y_.begin(),
+          this->problem_->scaling_left().begin())),
 
-template<typename T>
-void
-BackendPDHG<T>::UpdateResidualsAndStepsizes()
-{
-  // compute residuals every "opts_.residual_iter" iterations and
-  // adapt stepsizes for residual base adaptive schemes
-  if(iteration_ == 0 || (iteration_ % opts_.residual_iter) == 0)
-  {
-    // compute primal residual |Kx - z|^2 and norm |z|^2
-    thrust::tuple<T, T> primal = thrust::transform_reduce(
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.end(),
+          temp_.begin() + m,
+          y_.end(),
+          this->problem_->scaling_left().end())),
 
-        thrust::make_zip_iterator(thrust::make_tuple(
-            y_prev_.begin(),
-            y_.begin(),
-            this->problem_->scaling_left().begin(),
-            kx_prev_.begin(),
-            kx_.begin())),
+      low_memory_z_functor<T>(sigma_));
 
-        thrust::make_zip_iterator(thrust::make_tuple(
-            y_prev_.end(),
-            y_.end(),
-            this->problem_->scaling_left().end(),
-            kx_prev_.end(),
-            kx_.end())),
+  const T primal_var_norm = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.begin(), thrust::make_constant_iterator<T>(0), this->problem_->scaling_left().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.end(), thrust::make_constant_iterator<T>(0), this->problem_->scaling_left().end())),
+      low_memory_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
 
-        primal_residual_transform<T>(sigma_, theta_),
-        thrust::tuple<T, T>(0, 0),
-        residual_tuple_sum<T>());
+  this->problem_->linop()->Eval(kx_, x_, 1, stream);
 
-    // compute dual residual |K^T y + w|^2 and norm |w|^2
-    thrust::tuple<T, T> dual = thrust::transform_reduce(
+  const T primal_residual = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.begin(), thrust::make_constant_iterator<T>(0), this->problem_->scaling_left().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          kx_.end(), thrust::make_constant_iterator<T>(0), this->problem_->scaling_left().end())),
+      low_memory_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
+
+  // w^{k+1} moves to temp_, kty_ = K^T y^{k+1}
+  thrust::copy(thrust::cuda::par.on(stream), kty_.begin(), kty_.end(), temp_.begin());
+  this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+
+  const T dual_var_norm = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin(), thrust::make_constant_iterator<T>(0), this->problem_->scaling_right().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin() + n, thrust::make_constant_iterator<T>(0), this->problem_->scaling_right().end())),
+      low_memory_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
+
+  const T dual_residual = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin(), kty_.begin(), this->problem_->scaling_right().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          temp_.begin() + n, kty_.end(), this->problem_->scaling_right().end())),
+      low_memory_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
+
+  this->primal_residual_ = std::sqrt(primal_residual);
+  this->primal_var_norm_ = std::sqrt(primal_var_norm);
+  this->dual_residual_ = std::sqrt(dual_residual);
+  this->dual_var_norm_ = std::sqrt(dual_var_norm);
+
+  this->UpdateResidualSchedule(iteration_);
+  AdaptStepsizes(this->eps_primal(), this->eps_dual());
+  UpdateStepsizesAlg2();
+  iteration_++;
+
+  // the residuals are on the host already
+  this->history_.Record(
+    this->MakeHistoryEntry(iteration_, true, tau, sigma, theta, ConvergenceHistory<T>::nan(), -1),
+    nullptr, nullptr, stream);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::ResetStepsizes()
+{
+  tau_ = opts_.tau0;
+  sigma_ = opts_.sigma0;
+
+  if(opts_.scale_steps_operator)
+  {
+    T norm = this->problem_->normest(opts_.normest_tol);
+
+    if(std::abs(norm - 1) > 0.1)
+    {
+      tau_ /= norm;
+      sigma_ /= norm;
+
+      if(this->solver_opts_.verbose)
+        cout << "|K|=" << norm << " => Rescaled tau=" << tau_ << ", sigma=" << sigma_ << "." << endl; 
+    }
+  }
+}
+
+template<typename T>
+void
+BackendPDHG<T>::ProblemChanged(cudaStream_t stream)
+{
+  // captured graphs contain scalar coefficients as kernel parameters
+  DestroyGraph();
+
+  if(residual_pending_)
+    ConsumeResidualSums(true);
+
+  // the residuals, their decay and the gap of the old problem do not
+  // carry over
+  this->RestartResiduals();
+
+  // tau sigma |K|^2 <= 1 has to hold for the new operator, the steps
+  // adapted to the old one are discarded
+  if(opts_.scale_steps_operator)
+  {
+    ResetStepsizes();
+    theta_ = 1;
+  }
+
+  // the primal step reads K^T y and possibly the prepared prox argument,
+  // the dual step K x. all have to be recomputed with the new operator
+  primal_arg_ready_ = false;
+  this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+  this->problem_->linop()->Eval(kx_, x_, static_cast<T>(0), stream);
+
+  // the sums contain K x of the old operator
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+    ResetRestart(stream);
+
+  // the kernel holds a copy of the operator and the scalar coefficients
+  if(persistent_)
+    InitializePersistent();
+}
+
+template<typename T>
+void 
+BackendPDHG<T>::PrimalStep(cudaStream_t stream)
+{
+  ProfileRange range("BackendPDHG::PrimalStep", 0, stream);
+
+  if(fused_primal_)
+  {
+    // remember previous primal iterate
+    x_.swap(x_prev_);
+
+    // apply prox_g, computing x^k - tau T K^T y^k on the fly
+    ProxArgument<T> arg;
+    arg.x = thrust::raw_pointer_cast(x_prev_.data());
+    arg.d = thrust::raw_pointer_cast(this->problem_->scaling_right().data());
+    arg.a = thrust::raw_pointer_cast(kty_.data());
+    arg.b = nullptr;
+    arg.step = -tau_;
+    arg.theta = 0;
+
+    for(auto& p : prox_g_)
+      p->EvalFused(x_, arg, this->problem_->scaling_right(), tau_, false, stream);
+  }
+  else if(primal_arg_ready_)
+  {
+    // prox arg was computed into temp_ by AdjointStep
+    primal_arg_ready_ = false;
+
+    x_.swap(x_prev_);
+
+    for(auto& p : prox_g_)
+      p->Eval(x_, temp_, this->problem_->scaling_right(), tau_, false, stream);
+  }
+  else
+  {
+    // compute primal prox arg into temp_
+    // thrust::get<3>(t) = thrust::get<0>(t) - tau_ * thrust::get<1>(t) * thrust::get<2>(t);
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
 
         thrust::make_zip_iterator(thrust::make_tuple(
-            x_prev_.begin(),
-            x_.begin(),
-            this->problem_->scaling_right().begin(),
-            kty_prev_.begin(),
-            kty_.begin())),
+            x_.begin(), 
+            this->problem_->scaling_right().begin(), 
+            kty_.begin(), 
+            temp_.begin())),
 
         thrust::make_zip_iterator(thrust::make_tuple(
-            x_prev_.end(),
-            x_.end(),
-            this->problem_->scaling_right().end(),
-            kty_prev_.end(),
-            kty_.end())),
+            x_.end(), 
+            this->problem_->scaling_right().end(), 
+            kty_.end(), 
+            temp_.end())),
+
+        primal_proxarg_functor<T>(tau_));
+
+    // remember previous primal iterate
+    x_.swap(x_prev_);
+
+    // apply prox_g
+    for(auto& p : prox_g_)
+      p->Eval(x_, temp_, this->problem_->scaling_right(), tau_, false, stream);
+  }
+}
+
+template<typename T>
+void 
+BackendPDHG<T>::DualStep(cudaStream_t stream)
+{
+  ProfileRange range("BackendPDHG::DualStep", 0, stream);
+
+  // remember Kx^k
+  kx_.swap(kx_prev_);
+
+  if(!fused_dual_ && opts_.fuse_epilogue)
+  {
+    // compute Kx^{k+1} and the dual prox arg
+    // y^k + sigma S K (x^{k+1} + theta (x^{k+1} - x^k)) into temp_
+    Epilogue<T> epi;
+    epi.out = thrust::raw_pointer_cast(temp_.data());
+    epi.arg.x = thrust::raw_pointer_cast(y_.data());
+    epi.arg.d = thrust::raw_pointer_cast(this->problem_->scaling_left().data());
+    epi.arg.a = nullptr;
+    epi.arg.b = thrust::raw_pointer_cast(kx_prev_.data());
+    epi.arg.step = sigma_;
+    epi.arg.theta = theta_;
+
+    this->problem_->linop()->Eval(kx_, x_, epi, stream);
+
+    y_.swap(y_prev_);
+
+    for(auto& p : prox_fstar_)
+      p->Eval(y_, temp_, this->problem_->scaling_left(), sigma_, false, stream);
+
+    return;
+  }
+
+  // compute Kx^{k+1}
+  this->problem_->linop()->Eval(kx_, x_, 0, stream);
+
+  if(fused_dual_)
+  {
+    y_.swap(y_prev_);
+
+    // apply prox_fstar, computing y^k + sigma S K (x^{k+1} + theta (x^{k+1} - x^k))
+    // on the fly
+    ProxArgument<T> arg;
+    arg.x = thrust::raw_pointer_cast(y_prev_.data());
+    arg.d = thrust::raw_pointer_cast(this->problem_->scaling_left().data());
+    arg.a = thrust::raw_pointer_cast(kx_.data());
+    arg.b = thrust::raw_pointer_cast(kx_prev_.data());
+    arg.step = sigma_;
+    arg.theta = theta_;
+
+    for(auto& p : prox_fstar_)
+      p->EvalFused(y_, arg, this->problem_->scaling_left(), sigma_, false, stream);
+  }
+  else
+  {
+    // compute dual prox arg
+    // thrust::get<4>(t) = thrust::get<0>(t) + sigma_ * thrust::get<1>(t) * 
+    //                     ((1 + theta_) * thrust::get<2>(t) - theta_ * thrust::get<3>(t));
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.begin(),
+            this->problem_->scaling_left().begin(),
+            kx_.begin(),
+            kx_prev_.begin(),
+            temp_.begin())),
+
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.end(),
+            this->problem_->scaling_left().end(),
+            kx_.end(),
+            kx_prev_.end(),
+            temp_.end())),
+
+        dual_proxarg_functor<T>(sigma_, theta_));
+
+    y_.swap(y_prev_);
+    
+    // apply prox_fstar
+    for(auto& p : prox_fstar_)
+      p->Eval(y_, temp_, this->problem_->scaling_left(), sigma_, false, stream);
+  }
+}
+
+template<typename T>
+void 
+BackendPDHG<T>::AdjointStep(cudaStream_t stream)
+{
+  ProfileRange range("BackendPDHG::AdjointStep", 0, stream);
+
+  // remember K^T y^k
+  kty_.swap(kty_prev_);
+
+  if(!fused_primal_ && opts_.fuse_epilogue)
+  {
+    // compute K^T y^{k+1} and the next primal prox arg
+    // x^{k+1} - tau T K^T y^{k+1} into temp_
+    Epilogue<T> epi;
+    epi.out = thrust::raw_pointer_cast(temp_.data());
+    epi.arg.x = thrust::raw_pointer_cast(x_.data());
+    epi.arg.d = thrust::raw_pointer_cast(this->problem_->scaling_right().data());
+    epi.arg.a = nullptr;
+    epi.arg.b = nullptr;
+    epi.arg.step = -tau_;
+    epi.arg.theta = 0;
+
+    this->problem_->linop()->EvalAdjoint(kty_, y_, epi, stream);
+    primal_arg_ready_ = true;
+    return;
+  }
+
+  // compute K^T y^{k+1}
+  this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+}
+
+template<typename T>
+int
+BackendPDHG<T>::graph_iterations() const
+{
+  if(graph_length_ == 0 || is_residual_iteration())
+    return 0;
+
+  // the window may not reach the next residual evaluation
+  size_t next_residual = this->residual_schedule_.next_due(iteration_);
+
+  if(iteration_ + graph_length_ > next_residual)
+    return 0;
+
+  // nor the next restart check
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+  {
+    if(is_restart_iteration())
+      return 0;
+
+    size_t next_restart = (iteration_ / opts_.restart_iter + 1) * opts_.restart_iter;
+
+    if(iteration_ + graph_length_ > next_restart)
+      return 0;
+  }
+
+  return graph_length_;
+}
+
+template<typename T>
+bool
+BackendPDHG<T>::PerformGraphIterations(cudaStream_t stream)
+{
+#if CUDART_VERSION >= 10010
+  const size_t parity = iteration_ % 2;
+
+  // step sizes are baked into the kernel parameters, recapture if they changed
+  if(graph_exec_ != nullptr &&
+     (graph_parity_ != parity || graph_tau_ != tau_ ||
+      graph_sigma_ != sigma_ || graph_theta_ != theta_))
+  {
+    DestroyGraph();
+  }
+
+  if(graph_exec_ == nullptr)
+  {
+    if(cudaStreamBeginCapture(stream, cudaStreamCaptureModeGlobal) != cudaSuccess)
+    {
+      cudaGetLastError();
+      graph_length_ = 0;
+      return false;
+    }
+
+    // nothing is executed during capture, only the host-side state (buffer
+    // swaps, iteration counter) is advanced and has to be restored.
+    const size_t iteration = iteration_;
+    capturing_ = true;
+    for(int i = 0; i < graph_length_; i++)
+      PerformIteration(stream);
+    capturing_ = false;
+    iteration_ = iteration;
+
+    cudaGraph_t graph = nullptr;
+    cudaError_t err = cudaStreamEndCapture(stream, &graph);
+
+    if(err == cudaSuccess)
+    {
+#if CUDART_VERSION >= 12000
+      err = cudaGraphInstantiate(&graph_exec_, graph, 0);
+#else
+      err = cudaGraphInstantiate(&graph_exec_, graph, nullptr, nullptr, 0);
+#endif
+    }
+
+    if(graph != nullptr)
+      cudaGraphDestroy(graph);
+
+    if(err != cudaSuccess)
+    {
+      // some operator does not support capture, don't try again
+      cudaGetLastError();
+      graph_exec_ = nullptr;
+      graph_length_ = 0;
+
+      if(this->solver_opts_.verbose)
+        cout << "CUDA graph capture failed: " << cudaGetErrorString(err) << "." << endl;
+
+      return false;
+    }
+
+    graph_parity_ = parity;
+    graph_tau_ = tau_;
+    graph_sigma_ = sigma_;
+    graph_theta_ = theta_;
+  }
+
+  if(cudaGraphLaunch(graph_exec_, stream) != cudaSuccess)
+    throw Exception("BackendPDHG: launching the CUDA graph failed.");
+
+  iteration_ += graph_length_;
+  return true;
+#else
+  return false;
+#endif
+}
+
+template<typename T>
+int
+BackendPDHG<T>::PerformPersistentIterations(int count, cudaStream_t stream)
+{
+  // a requested check is left to a regular iteration, the kernel only
+  // checks its fixed schedule
+  if(this->residual_schedule_.requested())
+    return 0;
+
+  // the kernel reuses the buffers of the residual sums
+  if(residual_pending_)
+    ConsumeResidualSums(true);
+
+  // the primal prox argument is computed from K^T y inside the kernel
+  primal_arg_ready_ = false;
+
+  PersistentPDHGState<T> state;
+  state.x = thrust::raw_pointer_cast(x_.data());
+  state.x_prev = thrust::raw_pointer_cast(x_prev_.data());
+  state.y = thrust::raw_pointer_cast(y_.data());
+  state.y_prev = thrust::raw_pointer_cast(y_prev_.data());
+  state.kx = thrust::raw_pointer_cast(kx_.data());
+  state.kx_prev = thrust::raw_pointer_cast(kx_prev_.data());
+  state.kty = thrust::raw_pointer_cast(kty_.data());
+  state.kty_prev = thrust::raw_pointer_cast(kty_prev_.data());
+  state.scaling_left = thrust::raw_pointer_cast(this->problem_->scaling_left().data());
+  state.scaling_right = thrust::raw_pointer_cast(this->problem_->scaling_right().data());
+  state.tau = tau_;
+  state.sigma = sigma_;
+  state.theta = theta_;
+  state.iteration = iteration_;
+
+  const int done = persistent_->Run(state, count, residual_sums_, stream);
+
+  if(done == 0)
+    return 0;
+
+  // each iteration swaps the current and previous iterates once
+  if(done % 2 == 1)
+  {
+    x_.swap(x_prev_);
+    y_.swap(y_prev_);
+    kx_.swap(kx_prev_);
+    kty_.swap(kty_prev_);
+  }
+
+  tau_ = state.tau;
+  sigma_ = state.sigma;
+  theta_ = state.theta;
+  iteration_ = state.iteration;
+
+  // residuals of the last iteration
+  const T *sums = residual_sums_.host();
+  this->primal_residual_ = std::sqrt(sums[0]);
+  this->primal_var_norm_ = std::sqrt(sums[1]);
+  this->dual_residual_ = std::sqrt(sums[2]);
+  this->dual_var_norm_ = std::sqrt(sums[3]);
+
+  this->residual_schedule_.Issued(iteration_ - 1);
+  this->UpdateResidualSchedule(iteration_ - 1);
+
+  return done;
+}
+
+template<typename T>
+void
+BackendPDHG<T>::DestroyGraph()
+{
+#if CUDART_VERSION >= 10010
+  if(graph_exec_ != nullptr)
+  {
+    cudaGraphExecDestroy(graph_exec_);
+    graph_exec_ = nullptr;
+  }
+#endif
+}
+
+template<typename T>
+void
+BackendPDHG<T>::UpdateResidualsAndStepsizes(cudaStream_t stream)
+{
+  ProfileRange range("BackendPDHG::UpdateResidualsAndStepsizes", 0, stream);
+
+  if(async_residuals_)
+  {
+    // pick up the check in flight without blocking, unless a new check is
+    // due. the step sizes are then adapted with the arrived residuals.
+    if(!capturing_)
+      ConsumeResidualSums(is_residual_iteration());
+
+    if(is_residual_iteration())
+      IssueResidualSums(stream);
+  }
+  else if(is_residual_iteration())
+  {
+    // compute residuals every "opts_.residual_iter" iterations and
+    // adapt stepsizes for residual base adaptive schemes
+    T sums[4];
+    this->residual_schedule_.Issued(iteration_);
+    ComputeResidualSums(stream, y_.size(), x_.size(), sums);
+
+    this->primal_residual_ = std::sqrt(sums[0]);
+    this->primal_var_norm_ = std::sqrt(sums[1]);
+    this->dual_residual_ = std::sqrt(sums[2]);
+    this->dual_var_norm_ = std::sqrt(sums[3]);
+
+    this->UpdateResidualSchedule(iteration_);
+    AdaptStepsizes(this->eps_primal(), this->eps_dual());
+  }
+
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+  {
+    AccumulateAverage(stream);
 
-        dual_residual_transform<T>(tau_),
-        thrust::tuple<T, T>(0, 0),
-        residual_tuple_sum<T>());
+    if(is_restart_iteration() && !capturing_)
+      CheckRestart(stream);
+  }
+
+  UpdateStepsizesAlg2();
+}
+
+template<typename T>
+void
+BackendPDHG<T>::IssueResidualSums(cudaStream_t stream)
+{
+  LaunchResidualSums(stream, y_.size(), x_.size());
+
+  residual_pending_ = true;
+  residual_iteration_ = iteration_;
+  this->residual_schedule_.Issued(iteration_);
+}
+
+template<typename T>
+bool
+BackendPDHG<T>::ConsumeResidualSums(bool block)
+{
+  if(!residual_pending_)
+    return false;
 
-    this->primal_residual_ = std::sqrt(thrust::get<0>(primal));
-    this->primal_var_norm_ = std::sqrt(thrust::get<1>(primal));
-    this->dual_residual_ = std::sqrt(thrust::get<0>(dual));
-    this->dual_var_norm_ = std::sqrt(thrust::get<1>(dual));
+  if(!residual_sums_.Ready(block))
+    return false;
 
-    T eps_primal = this->eps_primal();
-    T eps_dual = this->eps_dual();
+  residual_pending_ = false;
+
+  const T *sums = residual_sums_.host();
+  this->primal_residual_ = std::sqrt(sums[0]);
+  this->primal_var_norm_ = std::sqrt(sums[1]);
+  this->dual_residual_ = std::sqrt(sums[2]);
+  this->dual_var_norm_ = std::sqrt(sums[3]);
+
+  this->UpdateResidualSchedule(residual_iteration_);
+  AdaptStepsizes(this->eps_primal(), this->eps_dual());
+
+  return true;
+}
 
-    switch(opts_.stepsize_variant)
-    {      
+template<typename T>
+void
+BackendPDHG<T>::ComputeResidualSums(
+  cudaStream_t stream, 
+  size_t num_rows, 
+  size_t num_cols, 
+  T sums[4])
+{
+  LaunchResidualSums(stream, num_rows, num_cols);
+  residual_sums_.Ready(true);
+
+  std::copy(residual_sums_.host(), residual_sums_.host() + 4, sums);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::LaunchResidualSums(
+  cudaStream_t stream, 
+  size_t num_rows, 
+  size_t num_cols,
+  bool to_host)
+{
+  ProfileRange range("BackendPDHG::ResidualSums", 
+                     5.0 * sizeof(T) * (num_rows + num_cols), stream);
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid(ResidualSums<T>::grid_size(std::max(num_rows, num_cols)), 1, 1);
+
+  ResidualSumsKernel<T>
+    <<<grid, block, 0, stream>>>(
+      residual_sums_.d_partials(),
+      residual_sums_.d_sums(),
+      residual_sums_.d_count(),
+      thrust::raw_pointer_cast(y_prev_.data()),
+      thrust::raw_pointer_cast(y_.data()),
+      thrust::raw_pointer_cast(this->problem_->scaling_left().data()),
+      thrust::raw_pointer_cast(kx_prev_.data()),
+      thrust::raw_pointer_cast(kx_.data()),
+      num_rows,
+      thrust::raw_pointer_cast(x_prev_.data()),
+      thrust::raw_pointer_cast(x_.data()),
+      thrust::raw_pointer_cast(this->problem_->scaling_right().data()),
+      thrust::raw_pointer_cast(kty_prev_.data()),
+      thrust::raw_pointer_cast(kty_.data()),
+      num_cols,
+      primal_residual_transform<T>(sigma_, theta_),
+      dual_residual_transform<T>(tau_));
+
+  if(to_host)
+    residual_sums_.CopyToHost(stream);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::AdaptStepsizes(T eps_primal, T eps_dual)
+{
+  switch(opts_.stepsize_variant)
+  {
     case BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualGoldstein: {
       T scale = eps_dual / eps_primal;
 	
@@ -456,30 +1422,34 @@ BackendPDHG<T>::UpdateResidualsAndStepsizes()
         sigma_ = sigma_ / (1 - arg_alpha_);
         arg_alpha_ = arg_alpha_ * opts_.arg_nu;
       }
-      
+    
     } break;
 
-      case BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualBoyd:
-        if( (this->dual_residual_ < eps_dual) && (opts_.arb_tau * iteration_ > arb_l_) )
-        {
-          tau_ /= opts_.arb_delta;
-          sigma_ *= opts_.arb_delta;
-          arb_u_ = iteration_;
-        }
-        else if( (this->primal_residual_ < eps_primal) && (opts_.arb_tau * iteration_ > arb_u_) )
-        {
-          tau_ *= opts_.arb_delta;
-          sigma_ /= opts_.arb_delta;
-          arb_l_ = iteration_;
-        }
-
-        break;
-
-      default:
-        break;
-    }
+    case BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualBoyd:
+      if( (this->dual_residual_ < eps_dual) && (opts_.arb_tau * iteration_ > arb_l_) )
+      {
+        tau_ /= opts_.arb_delta;
+        sigma_ *= opts_.arb_delta;
+        arb_u_ = iteration_;
+      }
+      else if( (this->primal_residual_ < eps_primal) && (opts_.arb_tau * iteration_ > arb_u_) )
+      {
+        tau_ *= opts_.arb_delta;
+        sigma_ /= opts_.arb_delta;
+        arb_l_ = iteration_;
+      }
+
+      break;
+
+    default:
+      break;
   }
+}
 
+template<typename T>
+void
+BackendPDHG<T>::UpdateStepsizesAlg2()
+{
   if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg2)
   {
     theta_ = 1. / std::sqrt(1. + 2. * opts_.alg2_gamma * tau_);
@@ -488,9 +1458,293 @@ BackendPDHG<T>::UpdateResidualsAndStepsizes()
   }
 }
 
+template<typename T>
+bool
+BackendPDHG<T>::is_restart_iteration() const
+{
+  return iteration_ > 0 && (iteration_ % opts_.restart_iter) == 0;
+}
+
+template<typename T>
+void
+BackendPDHG<T>::AccumulateAverage(cudaStream_t stream)
+{
+  thrust::transform(thrust::cuda::par.on(stream), 
+    x_.begin(), x_.end(), x_sum_.begin(), x_sum_.begin(), thrust::plus<T>());
+
+  thrust::transform(thrust::cuda::par.on(stream), 
+    y_.begin(), y_.end(), y_sum_.begin(), y_sum_.begin(), thrust::plus<T>());
+
+  thrust::transform(thrust::cuda::par.on(stream), 
+    kx_.begin(), kx_.end(), kx_sum_.begin(), kx_sum_.begin(), thrust::plus<T>());
+}
+
+template<typename T>
+void
+BackendPDHG<T>::ResetRestart(cudaStream_t stream)
+{
+  thrust::fill(thrust::cuda::par.on(stream), x_sum_.begin(), x_sum_.end(), 0);
+  thrust::fill(thrust::cuda::par.on(stream), y_sum_.begin(), y_sum_.end(), 0);
+  thrust::fill(thrust::cuda::par.on(stream), kx_sum_.begin(), kx_sum_.end(), 0);
+
+  thrust::copy(thrust::cuda::par.on(stream), x_.begin(), x_.end(), x_restart_.begin());
+  thrust::copy(thrust::cuda::par.on(stream), y_.begin(), y_.end(), y_restart_.begin());
+
+  restart_iteration_ = iteration_;
+  restart_residual_ = -1;
+  restart_residual_prev_ = -1;
+}
+
+template<typename T>
+T
+BackendPDHG<T>::FixedPointResidual(
+  const thrust::device_vector<T>& x0,
+  const thrust::device_vector<T>& x1,
+  const thrust::device_vector<T>& y0,
+  const thrust::device_vector<T>& y1,
+  const thrust::device_vector<T>& kx0,
+  const thrust::device_vector<T>& kx1,
+  T scale0,
+  cudaStream_t stream)
+{
+  T primal = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x0.begin(),
+          x1.begin(),
+          this->problem_->scaling_right().begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x0.end(),
+          x1.end(),
+          this->problem_->scaling_right().end())),
+
+      restart_primal_residual_transform<T>(tau_, scale0),
+      static_cast<T>(0),
+      thrust::plus<T>());
+
+  T dual = thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y0.begin(),
+          y1.begin(),
+          this->problem_->scaling_left().begin(),
+          kx0.begin(),
+          kx1.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y0.end(),
+          y1.end(),
+          this->problem_->scaling_left().end(),
+          kx0.end(),
+          kx1.end())),
+
+      restart_dual_residual_transform<T>(sigma_, scale0),
+      static_cast<T>(0),
+      thrust::plus<T>());
+
+  // P is only positive semi-definite up to rounding
+  return std::sqrt(std::max(primal + dual, static_cast<T>(0)));
+}
+
+template<typename T>
+void
+BackendPDHG<T>::CheckRestart(cudaStream_t stream)
+{
+  const size_t count = iteration_ - restart_iteration_ + 1;
+  const T scale = static_cast<T>(1) / static_cast<T>(count);
+
+  // z^k -> z^{k+1} is one PDHG step, so the current residual comes for free
+  const T res_current = FixedPointResidual(
+    x_prev_, x_, y_prev_, y_, kx_prev_, kx_, 1, stream);
+
+  // one PDHG step from the average iterate into x_plus_, y_plus_
+  thrust::transform(thrust::cuda::par.on(stream),
+    y_sum_.begin(), y_sum_.end(), y_plus_.begin(), restart_scale_functor<T>(scale));
+
+  this->problem_->linop()->EvalAdjoint(x_plus_, y_plus_, 0, stream);
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          thrust::make_transform_iterator(x_sum_.begin(), restart_scale_functor<T>(scale)),
+          this->problem_->scaling_right().begin(), 
+          x_plus_.begin(), 
+          temp_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          thrust::make_transform_iterator(x_sum_.end(), restart_scale_functor<T>(scale)),
+          this->problem_->scaling_right().end(), 
+          x_plus_.end(), 
+          temp_.begin() + x_plus_.size())),
+
+      primal_proxarg_functor<T>(tau_));
+
+  for(auto& p : prox_g_)
+    p->Eval(x_plus_, temp_, this->problem_->scaling_right(), tau_, false, stream);
+
+  this->problem_->linop()->Eval(kx_plus_, x_plus_, 0, stream);
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          thrust::make_transform_iterator(y_sum_.begin(), restart_scale_functor<T>(scale)),
+          this->problem_->scaling_left().begin(),
+          kx_plus_.begin(),
+          thrust::make_transform_iterator(kx_sum_.begin(), restart_scale_functor<T>(scale)),
+          temp_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          thrust::make_transform_iterator(y_sum_.end(), restart_scale_functor<T>(scale)),
+          this->problem_->scaling_left().end(),
+          kx_plus_.end(),
+          thrust::make_transform_iterator(kx_sum_.end(), restart_scale_functor<T>(scale)),
+          temp_.begin() + y_plus_.size())),
+
+      dual_proxarg_functor<T>(sigma_, theta_));
+
+  for(auto& p : prox_fstar_)
+    p->Eval(y_plus_, temp_, this->problem_->scaling_left(), sigma_, false, stream);
+
+  const T res_average = FixedPointResidual(
+    x_sum_, x_plus_, y_sum_, y_plus_, kx_sum_, kx_plus_, scale, stream);
+
+  // restart candidate is the iterate with the smaller residual
+  const bool to_average = res_average < res_current;
+  const T res = to_average ? res_average : res_current;
+
+  if(restart_residual_ < 0)
+  {
+    restart_residual_ = res;
+    restart_residual_prev_ = res;
+    return;
+  }
+
+  const bool restart = 
+    (res <= opts_.restart_beta_sufficient * restart_residual_) ||
+    (res <= opts_.restart_beta_necessary * restart_residual_ && res > restart_residual_prev_) ||
+    (count >= opts_.restart_beta_artificial * iteration_);
+
+  restart_residual_prev_ = res;
+
+  if(!restart)
+    return;
+
+  if(to_average)
+  {
+    thrust::transform(thrust::cuda::par.on(stream),
+      x_sum_.begin(), x_sum_.end(), x_.begin(), restart_scale_functor<T>(scale));
+
+    thrust::transform(thrust::cuda::par.on(stream),
+      y_sum_.begin(), y_sum_.end(), y_.begin(), restart_scale_functor<T>(scale));
+
+    thrust::transform(thrust::cuda::par.on(stream),
+      kx_sum_.begin(), kx_sum_.end(), kx_.begin(), restart_scale_functor<T>(scale));
+
+    // the following AdjointStep moves K^T y into kty_prev_, which is read
+    // by the next residual evaluation
+    this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+  }
+
+  // re-balance the primal weight omega = sqrt(sigma / tau) by the distance
+  // travelled since the last restart, keeping tau * sigma fixed
+  const T dist_x = std::sqrt( thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_.begin(), x_restart_.begin(), this->problem_->scaling_right().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_.end(), x_restart_.end(), this->problem_->scaling_right().end())),
+      restart_distance_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>()) );
+
+  const T dist_y = std::sqrt( thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_.begin(), y_restart_.begin(), this->problem_->scaling_left().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_.end(), y_restart_.end(), this->problem_->scaling_left().end())),
+      restart_distance_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>()) );
+
+  if(dist_x > 1e-10 && dist_y > 1e-10)
+  {
+    const T eta = std::sqrt(tau_ * sigma_);
+    const T smoothing = opts_.primal_weight_smoothing;
+    const T omega = std::exp(smoothing * std::log(dist_y / dist_x) + 
+                             (1 - smoothing) * std::log(std::sqrt(sigma_ / tau_)));
+
+    tau_ = eta / omega;
+    sigma_ = eta * omega;
+  }
+
+  if(this->solver_opts_.verbose)
+  {
+    cout << "Restart to " << (to_average ? "average" : "current") 
+         << " iterate at iteration " << iteration_ + 1 
+         << ", tau=" << tau_ << ", sigma=" << sigma_ << "." << endl;
+  }
+
+  // the sums start with the next iterate
+  ResetRestart(stream);
+  restart_iteration_ = iteration_ + 1;
+  restart_residual_ = res;
+  restart_residual_prev_ = res;
+}
+
 template<typename T>
 void 
-BackendPDHG<T>::Release() { }
+BackendPDHG<T>::Release() 
+{
+  DestroyGraph();
+  persistent_.reset();
+
+  residual_sums_.Release();
+  residual_pending_ = false;
+  this->history_.Release();
+
+  gap_terms_.clear();
+  gap_terms_.shrink_to_fit();
+
+  ReleaseSnapshots();
+}
+
+template<typename T>
+void
+BackendPDHG<T>::ReleaseSnapshots()
+{
+  if(snapshot_stream_ == nullptr)
+    return;
+
+  cudaStreamSynchronize(snapshot_stream_);
+
+  for(Snapshot& snap : snapshots_)
+  {
+    if(snap.host != nullptr)
+      cudaFreeHost(snap.host);
+
+    if(snap.staged != nullptr)
+      cudaEventDestroy(snap.staged);
+
+    if(snap.copied != nullptr)
+      cudaEventDestroy(snap.copied);
+
+    snap.host = nullptr;
+    snap.staged = nullptr;
+    snap.copied = nullptr;
+    snap.pending = false;
+    snap.staging.clear();
+    snap.staging.shrink_to_fit();
+  }
+
+  cudaStreamDestroy(snapshot_stream_);
+  snapshot_stream_ = nullptr;
+}
 
 template<typename T>
 void 
@@ -507,21 +1761,39 @@ BackendPDHG<T>::gpu_mem_amount() const
   size_t m = this->problem_->nrows();
   size_t n = this->problem_->ncols();
 
-  return (4 * (n + m) + std::max(n, m)) * sizeof(T);
+  size_t snapshots = this->solver_opts_.async_snapshots ? 4 * (n + m) : 0;
+
+  size_t restarts = 0;
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+    restarts = 3 * n + 5 * m;
+  
+  // x, y, K x, K^T y, temp and in the regular mode their previous values
+  const size_t iterates = opts_.low_memory ? 2 * (n + m) : 4 * (n + m);
+
+  const size_t persistent = persistent_ ? persistent_->gpu_mem_amount() : 0;
+
+  const size_t gap = gap_terms_.size();
+
+  return (iterates + std::max(n, m) + snapshots + restarts + gap) * sizeof(T) + persistent;
 }
 
 template<typename T>
-void
-BackendPDHG<T>::current_solution(
-    vector<T>& primal_x,
-    vector<T>& primal_z,
-    vector<T>& dual_y,
-    vector<T>& dual_w) 
+const thrust::device_vector<T>&
+BackendPDHG<T>::ComputeW(cudaStream_t stream)
 {
-  thrust::copy(x_.begin(), x_.end(), primal_x.begin());
-  thrust::copy(y_.begin(), y_.end(), dual_y.begin());
+  // temp_ is overwritten
+  primal_arg_ready_ = false;
+
+  // without the previous iterates w = -K^T y is returned, which agrees
+  // with the regular one up to the residuals
+  if(opts_.low_memory)
+  {
+    thrust::transform(thrust::cuda::par.on(stream), kty_.begin(), kty_.end(), temp_.begin(), thrust::negate<T>());
+    return temp_;
+  }
 
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           x_prev_.begin(),
           x_.begin(),
@@ -534,13 +1806,28 @@ BackendPDHG<T>::current_solution(
           x_.end(),
           this->problem_->scaling_right().end(),
           kty_prev_.end(),
-          temp_.end())),
+          temp_.begin() + x_.size())),
 
       compute_w_variable_functor<T>(tau_));
 
-  thrust::copy(temp_.begin(), temp_.begin() + dual_w.size(), dual_w.begin());
-  
+  return temp_;
+}
+
+template<typename T>
+const thrust::device_vector<T>&
+BackendPDHG<T>::ComputeZ(cudaStream_t stream)
+{
+  primal_arg_ready_ = false;
+
+  // z = K x in the low memory mode, kx_ is only used within an iteration
+  if(opts_.low_memory)
+  {
+    this->problem_->linop()->Eval(kx_, x_, 0, stream);
+    return kx_;
+  }
+
   thrust::for_each(
+      thrust::cuda::par.on(stream),
       thrust::make_zip_iterator(thrust::make_tuple(
           y_prev_.begin(),
           y_.begin(),
@@ -555,11 +1842,305 @@ BackendPDHG<T>::current_solution(
           this->problem_->scaling_left().end(),
           kx_.end(),
           kx_prev_.end(),
-          temp_.end())),
+          temp_.begin() + y_.size())),
 
       compute_z_variable_functor<T>(sigma_, theta_));
 
-  thrust::copy(temp_.begin(), temp_.begin() + primal_z.size(), primal_z.begin());  
+  return temp_;
+}
+
+template<typename T>
+void
+BackendPDHG<T>::current_solution(
+    vector<T>& primal_x,
+    vector<T>& primal_z,
+    vector<T>& dual_y,
+    vector<T>& dual_w) 
+{
+  thrust::copy(x_.begin(), x_.end(), primal_x.begin());
+  thrust::copy(y_.begin(), y_.end(), dual_y.begin());
+
+  const thrust::device_vector<T>& w = ComputeW(0);
+  thrust::copy(w.begin(), w.begin() + dual_w.size(), dual_w.begin());
+
+  const thrust::device_vector<T>& z = ComputeZ(0);
+  thrust::copy(z.begin(), z.begin() + primal_z.size(), primal_z.begin());  
+}
+
+template<typename T>
+void
+BackendPDHG<T>::current_solution_device(T *x, T *z, T *y, T *w, cudaStream_t stream)
+{
+  const size_t n = x_.size();
+  const size_t m = y_.size();
+
+  if(x != nullptr)
+    cudaMemcpyAsync(x, thrust::raw_pointer_cast(x_.data()), n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(y != nullptr)
+    cudaMemcpyAsync(y, thrust::raw_pointer_cast(y_.data()), m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(w != nullptr)
+    cudaMemcpyAsync(w, thrust::raw_pointer_cast(ComputeW(stream).data()), n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(z != nullptr)
+    cudaMemcpyAsync(z, thrust::raw_pointer_cast(ComputeZ(stream).data()), m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::SetIterateDevice(const T *x, const T *y, cudaStream_t stream)
+{
+  const size_t n = x_.size();
+  const size_t m = y_.size();
+
+  // the previous iterates equal the current ones, as after Initialize()
+  if(x != nullptr)
+  {
+    cudaMemcpyAsync(thrust::raw_pointer_cast(x_.data()), x, n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+    if(!opts_.low_memory)
+      cudaMemcpyAsync(thrust::raw_pointer_cast(x_prev_.data()), x, n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+  }
+
+  if(y != nullptr)
+  {
+    cudaMemcpyAsync(thrust::raw_pointer_cast(y_.data()), y, m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+    if(!opts_.low_memory)
+      cudaMemcpyAsync(thrust::raw_pointer_cast(y_prev_.data()), y, m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+    // the primal step reads K^T y
+    primal_arg_ready_ = false;
+    this->problem_->linop()->EvalAdjoint(kty_, y_, 0, stream);
+  }
+
+  if(opts_.stepsize_variant == BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted)
+    ResetRestart(stream);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::BeginSnapshot(int parts, int tag, cudaStream_t stream)
+{
+  if(snapshot_stream_ == nullptr)
+  {
+    Backend<T>::BeginSnapshot(parts, tag, stream);
+    return;
+  }
+
+  const size_t n = x_.size();
+  const size_t m = y_.size();
+
+  // reuse the older buffer. its previous copy to the host has to be
+  // finished before the staging area is overwritten.
+  Snapshot& snap = snapshots_[snapshot_count_ % 2];
+  if(snapshot_count_ >= 2)
+    cudaStreamWaitEvent(stream, snap.copied, 0);
+
+  // staging layout is [x, z, y, w]
+  T *d_x = thrust::raw_pointer_cast(snap.staging.data());
+  T *d_z = d_x + n;
+  T *d_y = d_z + m;
+  T *d_w = d_y + m;
+
+  if(parts & Backend<T>::kSnapshotX)
+    cudaMemcpyAsync(d_x, thrust::raw_pointer_cast(x_.data()), n * sizeof(T),
+                    cudaMemcpyDeviceToDevice, stream);
+
+  if(parts & Backend<T>::kSnapshotY)
+    cudaMemcpyAsync(d_y, thrust::raw_pointer_cast(y_.data()), m * sizeof(T),
+                    cudaMemcpyDeviceToDevice, stream);
+
+  // z and w are written to the staging area directly, so temp_ is untouched
+  if(opts_.low_memory)
+  {
+    // z = K x and w = -K^T y, as in current_solution
+    if(parts & Backend<T>::kSnapshotZ)
+    {
+      this->problem_->linop()->Eval(kx_, x_, 0, stream);
+      cudaMemcpyAsync(d_z, thrust::raw_pointer_cast(kx_.data()), m * sizeof(T),
+                      cudaMemcpyDeviceToDevice, stream);
+    }
+
+    if(parts & Backend<T>::kSnapshotW)
+      thrust::transform(thrust::cuda::par.on(stream), kty_.begin(), kty_.end(),
+                        thrust::device_pointer_cast(d_w), thrust::negate<T>());
+  }
+  else if(parts & Backend<T>::kSnapshotZ)
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_prev_.begin(),
+            y_.begin(),
+            this->problem_->scaling_left().begin(),
+            kx_.begin(),
+            kx_prev_.begin(),
+            thrust::device_pointer_cast(d_z))),
+
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_prev_.end(),
+            y_.end(),
+            this->problem_->scaling_left().end(),
+            kx_.end(),
+            kx_prev_.end(),
+            thrust::device_pointer_cast(d_z + m))),
+
+        compute_z_variable_functor<T>(sigma_, theta_));
+
+  if(!opts_.low_memory && (parts & Backend<T>::kSnapshotW))
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
+        thrust::make_zip_iterator(thrust::make_tuple(
+            x_prev_.begin(),
+            x_.begin(),
+            this->problem_->scaling_right().begin(),
+            kty_prev_.begin(),
+            thrust::device_pointer_cast(d_w))),
+
+        thrust::make_zip_iterator(thrust::make_tuple(
+            x_prev_.end(),
+            x_.end(),
+            this->problem_->scaling_right().end(),
+            kty_prev_.end(),
+            thrust::device_pointer_cast(d_w + n))),
+
+        compute_w_variable_functor<T>(tau_));
+
+  // the iterations go on while the side stream copies to the host
+  cudaEventRecord(snap.staged, stream);
+  cudaStreamWaitEvent(snapshot_stream_, snap.staged, 0);
+
+  const size_t offsets[4] = { 0, n, n + m, n + 2 * m };
+  const size_t sizes[4] = { n, m, m, n };
+  const int flags[4] = { Backend<T>::kSnapshotX, Backend<T>::kSnapshotZ,
+                         Backend<T>::kSnapshotY, Backend<T>::kSnapshotW };
+
+  for(int i = 0; i < 4; i++)
+  {
+    if(parts & flags[i])
+      cudaMemcpyAsync(snap.host + offsets[i], d_x + offsets[i], sizes[i] * sizeof(T),
+                      cudaMemcpyDeviceToHost, snapshot_stream_);
+  }
+
+  cudaEventRecord(snap.copied, snapshot_stream_);
+
+  snap.parts = parts;
+  snap.tag = tag;
+  snap.pending = true;
+  snap.order = snapshot_count_++;
+}
+
+template<typename T>
+int
+BackendPDHG<T>::FinishSnapshot(
+    vector<T>& primal_x,
+    vector<T>& primal_z,
+    vector<T>& dual_y,
+    vector<T>& dual_w,
+    bool block)
+{
+  if(snapshot_stream_ == nullptr)
+    return Backend<T>::FinishSnapshot(primal_x, primal_z, dual_y, dual_w, block);
+
+  // newest pending snapshot first
+  Snapshot *newer = &snapshots_[0], *older = &snapshots_[1];
+  if(newer->order < older->order)
+    std::swap(newer, older);
+
+  Snapshot *snap = nullptr;
+  if(newer->pending)
+  {
+    if(block)
+      cudaEventSynchronize(newer->copied);
+
+    if(cudaEventQuery(newer->copied) == cudaSuccess)
+      snap = newer;
+  }
+
+  if(snap == nullptr && older->pending && cudaEventQuery(older->copied) == cudaSuccess)
+    snap = older;
+
+  if(snap == nullptr)
+    return -1;
+
+  // an older snapshot is outdated once a newer one is read
+  if(snap == newer)
+    older->pending = false;
+  snap->pending = false;
+
+  const size_t n = x_.size();
+  const size_t m = y_.size();
+
+  if(snap->parts & Backend<T>::kSnapshotX)
+    std::copy(snap->host, snap->host + n, primal_x.begin());
+
+  if(snap->parts & Backend<T>::kSnapshotZ)
+    std::copy(snap->host + n, snap->host + n + m, primal_z.begin());
+
+  if(snap->parts & Backend<T>::kSnapshotY)
+    std::copy(snap->host + n + m, snap->host + n + 2 * m, dual_y.begin());
+
+  if(snap->parts & Backend<T>::kSnapshotW)
+    std::copy(snap->host + n + 2 * m, snap->host + 2 * (n + m), dual_w.begin());
+
+  return snap->tag;
+}
+
+template<typename T>
+void
+BackendPDHG<T>::StateVectors(vector<thrust::device_vector<T>*>& vectors)
+{
+  // temp_ holds the next primal prox argument if primal_arg_ready_ is set,
+  // the running sums are empty outside of the restarted scheme
+  vectors = { &x_, &y_, &x_prev_, &y_prev_, &temp_, &kx_, &kty_, &kx_prev_, &kty_prev_,
+              &x_sum_, &y_sum_, &kx_sum_, &x_plus_, &y_plus_, &kx_plus_, 
+              &x_restart_, &y_restart_ };
+}
+
+template<typename T>
+void
+BackendPDHG<T>::GetStateScalars(vector<double>& scalars)
+{
+  // the arriving residuals may still adapt the step sizes
+  if(residual_pending_)
+    ConsumeResidualSums(true);
+
+  scalars.push_back(tau_);
+  scalars.push_back(sigma_);
+  scalars.push_back(theta_);
+  scalars.push_back(static_cast<double>(iteration_));
+  scalars.push_back(arb_l_);
+  scalars.push_back(arb_u_);
+  scalars.push_back(arg_alpha_);
+  scalars.push_back(static_cast<double>(restart_iteration_));
+  scalars.push_back(restart_residual_);
+  scalars.push_back(restart_residual_prev_);
+  scalars.push_back(primal_arg_ready_ ? 1 : 0);
+  this->GetBaseStateScalars(scalars);
+}
+
+template<typename T>
+void
+BackendPDHG<T>::SetStateScalars(const vector<double>& scalars, cudaStream_t stream)
+{
+  // captured graphs contain the step sizes and the iteration parity
+  DestroyGraph();
+  residual_pending_ = false;
+
+  size_t pos = 0;
+  tau_ = static_cast<T>(scalars[pos++]);
+  sigma_ = static_cast<T>(scalars[pos++]);
+  theta_ = static_cast<T>(scalars[pos++]);
+  iteration_ = static_cast<size_t>(scalars[pos++]);
+  arb_l_ = static_cast<int>(scalars[pos++]);
+  arb_u_ = static_cast<int>(scalars[pos++]);
+  arg_alpha_ = static_cast<T>(scalars[pos++]);
+  restart_iteration_ = static_cast<size_t>(scalars[pos++]);
+  restart_residual_ = static_cast<T>(scalars[pos++]);
+  restart_residual_prev_ = static_cast<T>(scalars[pos++]);
+  primal_arg_ready_ = scalars[pos++] != 0;
+  this->SetBaseStateScalars(scalars, pos);
 }
 
 // Explicit template instantiation
@@ -0,0 +1,685 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de>
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <sstream>
+
+#include <thrust/copy.h>
+#include <thrust/for_each.h>
+#include <thrust/functional.h>
+#include <thrust/device_vector.h>
+#include <thrust/transform.h>
+#include <thrust/transform_reduce.h>
+#include <thrust/iterator/constant_iterator.h>
+#include <thrust/iterator/zip_iterator.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include "prost/backend/backend_spdhg.hpp"
+#include "prost/linop/linearoperator.hpp"
+#include "prost/prox/prox.hpp"
+#include "prost/prox/prox_moreau.hpp"
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+#include "prost/profiler.hpp"
+
+namespace prost {
+
+/// \brief Computes <3> = x^k - tau T zbar^k from (x, T, zbar).
+template<typename T>
+struct spdhg_primal_arg_functor
+{
+  __host__ __device__ spdhg_primal_arg_functor(T tau) : tau_(tau) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    thrust::get<3>(t) = thrust::get<0>(t) - tau_ * thrust::get<1>(t) * thrust::get<2>(t);
+  }
+
+  T tau_;
+};
+
+/// \brief Computes <3> = y^k + sigma S K x^{k+1} from (y, S, K x) and
+///        remembers y^k in <4>.
+template<typename T>
+struct spdhg_dual_arg_functor
+{
+  __host__ __device__ spdhg_dual_arg_functor(T sigma) : sigma_(sigma) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    const T y = thrust::get<0>(t);
+
+    thrust::get<3>(t) = y + sigma_ * thrust::get<1>(t) * thrust::get<2>(t);
+    thrust::get<4>(t) = y;
+  }
+
+  T sigma_;
+};
+
+/// \brief Computes <1> = y^{k+1} - y^k from y^{k+1} in <0> and y^k in <1>.
+template<typename T>
+struct spdhg_dual_diff_functor
+{
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    thrust::get<1>(t) = thrust::get<0>(t) - thrust::get<1>(t);
+  }
+};
+
+/// \brief Computes z^{k+1} = z^k + dz and zbar^{k+1} = z^{k+1} + dz / p
+///        for (z, zbar, dz).
+template<typename T>
+struct spdhg_extrapolate_functor
+{
+  __host__ __device__ spdhg_extrapolate_functor(T inv_prob) : inv_prob_(inv_prob) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    const T dz = thrust::get<2>(t);
+    const T z = thrust::get<0>(t) + dz;
+
+    thrust::get<0>(t) = z;
+    thrust::get<1>(t) = z + inv_prob_ * dz;
+  }
+
+  T inv_prob_;
+};
+
+/// \brief Computes <0> = (<0> - <1>) / (step <2>), turning a prox argument
+///        and the prox result into the subgradient of the prox.
+template<typename T>
+struct spdhg_subgradient_functor
+{
+  __host__ __device__ spdhg_subgradient_functor(T step) : step_(step) { }
+
+  template <typename Tuple>
+  __host__ __device__
+  void operator()(Tuple t)
+  {
+    thrust::get<0>(t) = (thrust::get<0>(t) - thrust::get<1>(t)) / (step_ * thrust::get<2>(t));
+  }
+
+  T step_;
+};
+
+/// \brief Computes d (a + b)^2 for (a, b, d).
+template<typename T>
+struct spdhg_square_transform : public thrust::unary_function<thrust::tuple<T,T,T>, T>
+{
+  __host__ __device__
+  T operator()(const thrust::tuple<T,T,T>& t) const
+  {
+    const T v = thrust::get<0>(t) + thrust::get<1>(t);
+
+    return thrust::get<2>(t) * v * v;
+  }
+};
+
+/// \brief Returns sum_i d_i (a_i + b_i)^2.
+template<typename T>
+static T SquaredNorm(
+  const thrust::device_vector<T>& a,
+  const thrust::device_vector<T>& b,
+  const thrust::device_vector<T>& d,
+  cudaStream_t stream)
+{
+  return thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(a.begin(), b.begin(), d.begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(a.end(), b.end(), d.end())),
+      spdhg_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
+}
+
+/// \brief Returns sum_i d_i a_i^2.
+template<typename T>
+static T SquaredNorm(
+  const thrust::device_vector<T>& a,
+  const thrust::device_vector<T>& d,
+  cudaStream_t stream)
+{
+  return thrust::transform_reduce(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          a.begin(), thrust::make_constant_iterator<T>(0), d.begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          a.end(), thrust::make_constant_iterator<T>(0), d.end())),
+      spdhg_square_transform<T>(),
+      static_cast<T>(0),
+      thrust::plus<T>());
+}
+
+template<typename T>
+BackendSPDHG<T>::BackendSPDHG(const typename BackendSPDHG<T>::Options& opts)
+    : opts_(opts), iteration_(0)
+{
+}
+
+template<typename T>
+BackendSPDHG<T>::~BackendSPDHG()
+{
+  Release();
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::PrepareProblem(Problem<T>& problem)
+{
+  // merged blocks and batched proxs span many data terms, the dual blocks
+  // could not be updated separately anymore
+  problem.set_merge_blocks(false);
+  problem.set_batch_proxes(false);
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::Initialize()
+{
+  size_t m = this->problem_->nrows();
+  size_t n = this->problem_->ncols();
+
+  if(opts_.block_fraction <= 0 || opts_.block_fraction > 1)
+    throw Exception("BackendSPDHG: block_fraction has to be in (0, 1].");
+
+  try
+  {
+    x_.resize(n, 0);
+    x_arg_.resize(n, 0);
+    z_.resize(n, 0);
+    z_bar_.resize(n, 0);
+    dz_.resize(n, 0);
+    y_.resize(m, 0);
+    kx_.resize(m, 0);
+    y_arg_.resize(m, 0);
+    dy_.resize(m, 0);
+  }
+  catch(std::bad_alloc& e)
+  {
+    std::stringstream ss;
+    ss << "Out of memory: " << e.what();
+    throw OutOfMemoryException(ss.str());
+  }
+
+  // check if proxs are available (or create via moreau)
+  prox_g_.clear();
+  if(this->problem_->prox_g().empty())
+  {
+    if(this->problem_->prox_gstar().empty())
+      throw Exception("Neither prox_g nor prox_gstar specified.");
+
+    for(auto& p : this->problem_->prox_gstar())
+    {
+      Prox<T> *moreau = new ProxMoreau<T>(p);
+      moreau->Initialize();
+
+      prox_g_.push_back( std::shared_ptr<Prox<T> >(moreau) );
+    }
+  }
+  else
+    prox_g_ = this->problem_->prox_g();
+
+  if(this->problem_->prox_fstar().empty() && this->problem_->prox_f().empty())
+    throw Exception("Neither prox_f nor prox_fstar specified.");
+
+  BuildDualBlocks();
+
+  batch_ = static_cast<size_t>(std::ceil(opts_.block_fraction * dual_blocks_.size()));
+  batch_ = std::max<size_t>(1, std::min(batch_, dual_blocks_.size()));
+  prob_ = static_cast<T>(batch_) / static_cast<T>(dual_blocks_.size());
+
+  order_.resize(dual_blocks_.size());
+  for(size_t i = 0; i < order_.size(); i++)
+    order_[i] = i;
+
+  rng_.seed(opts_.seed);
+
+  iteration_ = 0;
+  this->ResetResidualSchedule(opts_.residual_iter);
+  this->InitializeHistory();
+
+  this->primal_var_norm_ = 0;
+  this->dual_var_norm_ = 0;
+  this->primal_residual_ = 0;
+  this->dual_residual_ = 0;
+
+  ResetStepsizes();
+
+  if(this->solver_opts_.verbose)
+  {
+    cout << "SPDHG: " << dual_blocks_.size() << " dual blocks, " << batch_
+         << " updated per iteration => tau=" << tau_ << ", sigma=" << sigma_ << "." << endl;
+  }
+
+  if(this->solver_opts_.x0.size() > 0)
+  {
+    if(this->solver_opts_.x0.size() == n)
+      x_ = this->solver_opts_.x0;
+    else
+      throw Exception("Initial primal solution has wrong size.");
+  }
+
+  if(this->solver_opts_.y0.size() > 0)
+  {
+    if(this->solver_opts_.y0.size() == m)
+      y_ = this->solver_opts_.y0;
+    else
+      throw Exception("Initial dual solution has wrong size.");
+  }
+
+  this->problem_->linop()->EvalAdjoint(z_, y_);
+  z_bar_ = z_;
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::BuildDualBlocks()
+{
+  const size_t m = this->problem_->nrows();
+
+  vector< shared_ptr<Prox<T> > > prox_fstar;
+  if(this->problem_->prox_fstar().empty())
+  {
+    for(auto& p : this->problem_->prox_f())
+    {
+      Prox<T> *moreau = new ProxMoreau<T>(p);
+      moreau->Initialize();
+
+      prox_fstar.push_back( std::shared_ptr<Prox<T> >(moreau) );
+    }
+  }
+  else
+    prox_fstar = this->problem_->prox_fstar();
+
+  std::sort(prox_fstar.begin(), prox_fstar.end(),
+            [](const shared_ptr<Prox<T> >& a, const shared_ptr<Prox<T> >& b) { return a->index() < b->index(); });
+
+  // a dual block has to be a union of prox ranges and of parts of the
+  // operator, i.e. its bounds are bounds of both partitions
+  vector<size_t> linop_bounds;
+  this->problem_->linop()->RowPartition(linop_bounds);
+  linop_bounds.push_back(m);
+
+  vector<size_t> prox_bounds(1, 0);
+  for(auto& p : prox_fstar)
+  {
+    prox_bounds.push_back(p->index());
+    prox_bounds.push_back(p->index() + p->size());
+  }
+  prox_bounds.push_back(m);
+
+  for(vector<size_t> *b : { &linop_bounds, &prox_bounds })
+  {
+    std::sort(b->begin(), b->end());
+    b->erase(std::unique(b->begin(), b->end()), b->end());
+  }
+
+  vector<size_t> bounds;
+  std::set_intersection(linop_bounds.begin(), linop_bounds.end(),
+                        prox_bounds.begin(), prox_bounds.end(),
+                        std::back_inserter(bounds));
+
+  dual_blocks_.clear();
+  size_t k = 0;
+  for(size_t i = 0; i + 1 < bounds.size(); i++)
+  {
+    DualBlock block;
+    block.begin = bounds[i];
+    block.end = bounds[i + 1];
+
+    while(k < prox_fstar.size() && prox_fstar[k]->index() < block.end)
+      block.proxs.push_back(prox_fstar[k++]);
+
+    dual_blocks_.push_back(block);
+  }
+
+  if(dual_blocks_.empty())
+    throw Exception("BackendSPDHG: the problem has no dual variables.");
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::PerformIteration(cudaStream_t stream)
+{
+  const bool residuals = this->residual_schedule_.is_due(iteration_);
+
+  PrimalStep(stream);
+  DualStep(stream);
+
+  if(residuals)
+    ComputeResiduals(stream);
+
+  iteration_++;
+
+  this->history_.Record(
+    this->MakeHistoryEntry(iteration_, residuals, tau_, sigma_, 1, ConvergenceHistory<T>::nan(), -1),
+    nullptr, nullptr, stream);
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::PrimalStep(cudaStream_t stream)
+{
+  ProfileRange range("BackendSPDHG::PrimalStep", 0, stream);
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_.begin(),
+          this->problem_->scaling_right().begin(),
+          z_bar_.begin(),
+          x_arg_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_.end(),
+          this->problem_->scaling_right().end(),
+          z_bar_.end(),
+          x_arg_.end())),
+
+      spdhg_primal_arg_functor<T>(tau_));
+
+  for(auto& p : prox_g_)
+    p->Eval(x_, x_arg_, this->problem_->scaling_right(), tau_, false, stream);
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::DualStep(cudaStream_t stream)
+{
+  ProfileRange range("BackendSPDHG::DualStep", 0, stream);
+
+  shared_ptr<LinearOperator<T>> linop = this->problem_->linop();
+
+  // sample batch_ blocks without replacement
+  for(size_t i = 0; i < batch_; i++)
+  {
+    std::uniform_int_distribution<size_t> dist(i, order_.size() - 1);
+    std::swap(order_[i], order_[dist(rng_)]);
+  }
+
+  cudaMemsetAsync(thrust::raw_pointer_cast(dz_.data()), 0, dz_.size() * sizeof(T), stream);
+
+  for(size_t i = 0; i < batch_; i++)
+  {
+    const DualBlock& block = dual_blocks_[order_[i]];
+    const size_t rows = block.end - block.begin;
+
+    // K_i x^{k+1}
+    cudaMemsetAsync(thrust::raw_pointer_cast(kx_.data()) + block.begin, 0, rows * sizeof(T), stream);
+    linop->EvalRowsAdd(kx_, x_, block.begin, block.end, stream);
+
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.begin() + block.begin,
+            this->problem_->scaling_left().begin() + block.begin,
+            kx_.begin() + block.begin,
+            y_arg_.begin() + block.begin,
+            dy_.begin() + block.begin)),
+
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.begin() + block.end,
+            this->problem_->scaling_left().begin() + block.end,
+            kx_.begin() + block.end,
+            y_arg_.begin() + block.end,
+            dy_.begin() + block.end)),
+
+        spdhg_dual_arg_functor<T>(sigma_));
+
+    for(auto& p : block.proxs)
+      p->Eval(y_, y_arg_, this->problem_->scaling_left(), sigma_, false, stream);
+
+    thrust::for_each(
+        thrust::cuda::par.on(stream),
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.begin() + block.begin,
+            dy_.begin() + block.begin)),
+
+        thrust::make_zip_iterator(thrust::make_tuple(
+            y_.begin() + block.end,
+            dy_.begin() + block.end)),
+
+        spdhg_dual_diff_functor<T>());
+
+    // K_i^T (y_i^{k+1} - y_i^k)
+    linop->EvalAdjointRowsAdd(dz_, dy_, block.begin, block.end, stream);
+  }
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          z_.begin(),
+          z_bar_.begin(),
+          dz_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          z_.end(),
+          z_bar_.end(),
+          dz_.end())),
+
+      spdhg_extrapolate_functor<T>(1 / prob_));
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::ComputeResiduals(cudaStream_t stream)
+{
+  ProfileRange range("BackendSPDHG::Residuals", 0, stream);
+
+  this->residual_schedule_.Issued(iteration_);
+
+  // full dual step y_hat = prox_fstar(y^{k+1} + sigma S K x^{k+1}) into
+  // dy_. z_hat = K x^{k+1} + (y^{k+1} - y_hat) / (sigma S) is a subgradient
+  // of f at y_hat.
+  this->problem_->linop()->Eval(kx_, x_, 0, stream);
+
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_.begin(),
+          this->problem_->scaling_left().begin(),
+          kx_.begin(),
+          y_arg_.begin(),
+          dy_.begin())),
+
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_.end(),
+          this->problem_->scaling_left().end(),
+          kx_.end(),
+          y_arg_.end(),
+          dy_.end())),
+
+      spdhg_dual_arg_functor<T>(sigma_));
+
+  for(auto& block : dual_blocks_)
+    for(auto& p : block.proxs)
+      p->Eval(dy_, y_arg_, this->problem_->scaling_left(), sigma_, false, stream);
+
+  // y_arg_ = z_hat - K x^{k+1}
+  thrust::copy(thrust::cuda::par.on(stream), y_.begin(), y_.end(), y_arg_.begin());
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_arg_.begin(), dy_.begin(), this->problem_->scaling_left().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          y_arg_.end(), dy_.end(), this->problem_->scaling_left().end())),
+      spdhg_subgradient_functor<T>(sigma_));
+
+  // x_arg_ = w_hat = (x^k - x^{k+1}) / (tau T) - zbar^k, a subgradient of
+  // g at x^{k+1}
+  thrust::for_each(
+      thrust::cuda::par.on(stream),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_arg_.begin(), x_.begin(), this->problem_->scaling_right().begin())),
+      thrust::make_zip_iterator(thrust::make_tuple(
+          x_arg_.end(), x_.end(), this->problem_->scaling_right().end())),
+      spdhg_subgradient_functor<T>(tau_));
+
+  const thrust::device_vector<T>& left = this->problem_->scaling_left();
+  const thrust::device_vector<T>& right = this->problem_->scaling_right();
+
+  this->primal_residual_ = std::sqrt(SquaredNorm(y_arg_, left, stream));
+  this->primal_var_norm_ = std::sqrt(SquaredNorm(kx_, y_arg_, left, stream));
+  this->dual_residual_ = std::sqrt(SquaredNorm(x_arg_, z_, right, stream));
+  this->dual_var_norm_ = std::sqrt(SquaredNorm(x_arg_, right, stream));
+
+  this->UpdateResidualSchedule(iteration_);
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::ResetStepsizes()
+{
+  // tau sigma |K_i|^2 <= p_i for all dual blocks i
+  tau_ = opts_.tau0 * prob_;
+  sigma_ = opts_.sigma0;
+
+  if(opts_.scale_steps_operator)
+  {
+    T norm = this->problem_->normest(opts_.normest_tol);
+
+    if(std::abs(norm - 1) > 0.1)
+    {
+      tau_ /= norm;
+      sigma_ /= norm;
+    }
+  }
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::ProblemChanged(cudaStream_t stream)
+{
+  this->RestartResiduals();
+
+  if(opts_.scale_steps_operator)
+    ResetStepsizes();
+
+  // z and zbar are K^T y of the old operator
+  this->problem_->linop()->EvalAdjoint(z_, y_, 0, stream);
+  thrust::copy(thrust::cuda::par.on(stream), z_.begin(), z_.end(), z_bar_.begin());
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::Release()
+{
+  this->history_.Release();
+  dual_blocks_.clear();
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::current_solution(std::vector<T>& primal, std::vector<T>& dual)
+{
+  thrust::copy(x_.begin(), x_.end(), primal.begin());
+  thrust::copy(y_.begin(), y_.end(), dual.begin());
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::current_solution(
+  std::vector<T>& primal_x,
+  std::vector<T>& primal_z,
+  std::vector<T>& dual_y,
+  std::vector<T>& dual_w)
+{
+  // z = K x and w = -K^T y, the latter is kept up to date in z_
+  this->problem_->linop()->Eval(kx_, x_);
+
+  thrust::copy(x_.begin(), x_.end(), primal_x.begin());
+  thrust::copy(kx_.begin(), kx_.end(), primal_z.begin());
+  thrust::copy(y_.begin(), y_.end(), dual_y.begin());
+  thrust::copy(z_.begin(), z_.end(), dual_w.begin());
+
+  for(auto& w : dual_w)
+    w = -w;
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::current_solution_device(T *x, T *z, T *y, T *w, cudaStream_t stream)
+{
+  const size_t n = x_.size();
+  const size_t m = y_.size();
+
+  if(x != nullptr)
+    cudaMemcpyAsync(x, thrust::raw_pointer_cast(x_.data()), n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(y != nullptr)
+    cudaMemcpyAsync(y, thrust::raw_pointer_cast(y_.data()), m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(z != nullptr)
+  {
+    this->problem_->linop()->Eval(kx_, x_, 0, stream);
+    cudaMemcpyAsync(z, thrust::raw_pointer_cast(kx_.data()), m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+  }
+
+  // dz_ is only used within an iteration
+  if(w != nullptr)
+  {
+    thrust::transform(thrust::cuda::par.on(stream), z_.begin(), z_.end(), dz_.begin(), thrust::negate<T>());
+    cudaMemcpyAsync(w, thrust::raw_pointer_cast(dz_.data()), n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+  }
+}
+
+template<typename T>
+void
+BackendSPDHG<T>::SetIterateDevice(const T *x, const T *y, cudaStream_t stream)
+{
+  if(x != nullptr)
+    cudaMemcpyAsync(thrust::raw_pointer_cast(x_.data()), x, x_.size() * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(y != nullptr)
+  {
+    cudaMemcpyAsync(thrust::raw_pointer_cast(y_.data()), y, y_.size() * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+    this->problem_->linop()->EvalAdjoint(z_, y_, 0, stream);
+    thrust::copy(thrust::cuda::par.on(stream), z_.begin(), z_.end(), z_bar_.begin());
+  }
+}
+
+template<typename T>
+size_t
+BackendSPDHG<T>::gpu_mem_amount() const
+{
+  size_t m = this->problem_->nrows();
+  size_t n = this->problem_->ncols();
+
+  // x, x_arg, z, zbar, dz and y, K x, y_arg, dy
+  return (5 * n + 4 * m) * sizeof(T);
+}
+
+// Explicit template instantiation
+template class BackendSPDHG<float>;
+template class BackendSPDHG<double>;
+
+} // namespace prost
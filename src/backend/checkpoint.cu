@@ -0,0 +1,316 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "prost/backend/checkpoint.hpp"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#include "prost/backend/backend.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+static const char kCheckpointMagic[8] = { 'P', 'R', 'O', 'S', 'T', 'C', 'K', 'P' };
+static const uint32_t kCheckpointVersion = 1;
+
+template<typename T>
+Checkpoint<T>::Checkpoint(const string& path)
+  : path_(path), device_(0), host_(nullptr), capacity_(0), stream_(nullptr),
+    staged_(nullptr), copied_(nullptr), iteration_(0), written_(true)
+{
+  cudaGetDevice(&device_);
+
+  if(cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking) != cudaSuccess)
+  {
+    stream_ = nullptr;
+    throw Exception("Checkpoint: failed to create the stream.");
+  }
+
+  cudaEventCreateWithFlags(&staged_, cudaEventDisableTiming);
+  cudaEventCreateWithFlags(&copied_, cudaEventDisableTiming);
+}
+
+template<typename T>
+Checkpoint<T>::~Checkpoint()
+{
+  // an error of the last write cannot be reported anymore
+  if(writer_.joinable())
+    writer_.join();
+
+  if(host_ != nullptr)
+    cudaFreeHost(host_);
+
+  if(staged_ != nullptr)
+    cudaEventDestroy(staged_);
+
+  if(copied_ != nullptr)
+    cudaEventDestroy(copied_);
+
+  if(stream_ != nullptr)
+    cudaStreamDestroy(stream_);
+}
+
+template<typename T>
+bool Checkpoint<T>::Begin(Backend<T>& backend, int iteration, cudaStream_t stream)
+{
+  // the buffers are in use until the file is written, skip this one
+  if(writer_.joinable())
+  {
+    if(!written_)
+      return false;
+
+    Join();
+  }
+
+  vector<thrust::device_vector<T>*> vectors;
+  backend.StateVectors(vectors);
+
+  scalars_.clear();
+  backend.GetStateScalars(scalars_);
+
+  size_t total = 0;
+  sizes_.resize(vectors.size());
+  for(size_t i = 0; i < vectors.size(); i++)
+  {
+    sizes_[i] = vectors[i]->size();
+    total += sizes_[i];
+  }
+
+  if(total > capacity_)
+  {
+    if(host_ != nullptr)
+      cudaFreeHost(host_);
+
+    host_ = nullptr;
+    capacity_ = 0;
+
+    try
+    {
+      staging_.clear();
+      staging_.shrink_to_fit();
+      staging_.resize(total);
+    }
+    catch(std::bad_alloc& e)
+    {
+      throw OutOfMemoryException("Checkpoint: out of memory for the staging buffer.");
+    }
+
+    if(cudaMallocHost(&host_, total * sizeof(T)) != cudaSuccess)
+    {
+      host_ = nullptr;
+      throw Exception("Checkpoint: failed to allocate pinned memory.");
+    }
+
+    capacity_ = total;
+  }
+
+  T *d_staging = thrust::raw_pointer_cast(staging_.data());
+  size_t offset = 0;
+  for(size_t i = 0; i < vectors.size(); i++)
+  {
+    if(sizes_[i] > 0)
+      cudaMemcpyAsync(d_staging + offset, thrust::raw_pointer_cast(vectors[i]->data()),
+                      sizes_[i] * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+    offset += sizes_[i];
+  }
+
+  // the iterations go on while the side stream copies to the host
+  cudaEventRecord(staged_, stream);
+  cudaStreamWaitEvent(stream_, staged_, 0);
+
+  if(total > 0)
+    cudaMemcpyAsync(host_, d_staging, total * sizeof(T), cudaMemcpyDeviceToHost, stream_);
+
+  cudaEventRecord(copied_, stream_);
+
+  iteration_ = iteration;
+  written_ = false;
+  writer_ = std::thread(&Checkpoint<T>::Write, this);
+
+  return true;
+}
+
+template<typename T>
+void Checkpoint<T>::Finish()
+{
+  if(writer_.joinable())
+    Join();
+}
+
+template<typename T>
+void Checkpoint<T>::Join()
+{
+  writer_.join();
+
+  if(!error_.empty())
+  {
+    const string error = error_;
+    error_.clear();
+    throw Exception("Checkpoint: " + error);
+  }
+}
+
+template<typename T>
+void Checkpoint<T>::Write()
+{
+  cudaSetDevice(device_);
+
+  if(cudaEventSynchronize(copied_) != cudaSuccess)
+  {
+    error_ = "copying the state to the host failed.";
+    written_ = true;
+    return;
+  }
+
+  // written next to the previous checkpoint, which is only replaced once
+  // the new one is complete
+  const string tmp_path = path_ + ".tmp";
+  FILE *fp = std::fopen(tmp_path.c_str(), "wb");
+  bool ok = (fp != nullptr);
+
+  auto put = [&](const void *data, size_t bytes) {
+    ok = ok && (std::fwrite(data, 1, bytes, fp) == bytes);
+  };
+
+  const uint32_t version = kCheckpointVersion;
+  const uint32_t value_size = sizeof(T);
+  const uint64_t iteration = iteration_;
+  const uint64_t num_scalars = scalars_.size();
+  const uint64_t num_vectors = sizes_.size();
+  size_t total = 0;
+
+  put(kCheckpointMagic, sizeof(kCheckpointMagic));
+  put(&version, sizeof(version));
+  put(&value_size, sizeof(value_size));
+  put(&iteration, sizeof(iteration));
+  put(&num_scalars, sizeof(num_scalars));
+  put(scalars_.data(), num_scalars * sizeof(double));
+  put(&num_vectors, sizeof(num_vectors));
+
+  for(size_t size : sizes_)
+  {
+    const uint64_t size64 = size;
+    put(&size64, sizeof(size64));
+    total += size;
+  }
+
+  put(host_, total * sizeof(T));
+
+  if(fp != nullptr)
+    ok = (std::fclose(fp) == 0) && ok;
+
+#if defined(_WIN32)
+  // rename does not replace existing files on Windows
+  if(ok)
+    std::remove(path_.c_str());
+#endif
+
+  ok = ok && (std::rename(tmp_path.c_str(), path_.c_str()) == 0);
+
+  if(!ok)
+  {
+    std::remove(tmp_path.c_str());
+    error_ = "failed to write '" + path_ + "'.";
+  }
+
+  written_ = true;
+}
+
+template<typename T>
+int Checkpoint<T>::Restore(Backend<T>& backend, cudaStream_t stream)
+{
+  FILE *fp = std::fopen(path_.c_str(), "rb");
+  if(fp == nullptr)
+    return -1;
+
+  std::unique_ptr<FILE, int(*)(FILE*)> file(fp, &std::fclose);
+
+  auto get = [&](void *data, size_t bytes) {
+    if(std::fread(data, 1, bytes, fp) != bytes)
+      throw Exception("Checkpoint: '" + path_ + "' is truncated.");
+  };
+
+  char magic[sizeof(kCheckpointMagic)];
+  uint32_t version, value_size;
+  uint64_t iteration, num_scalars, num_vectors;
+
+  get(magic, sizeof(magic));
+  if(std::memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0)
+    throw Exception("Checkpoint: '" + path_ + "' is not a checkpoint.");
+
+  get(&version, sizeof(version));
+  if(version != kCheckpointVersion)
+    throw Exception("Checkpoint: version of '" + path_ + "' is not supported.");
+
+  get(&value_size, sizeof(value_size));
+  if(value_size != sizeof(T))
+    throw Exception("Checkpoint: '" + path_ + "' was written in a different precision.");
+
+  get(&iteration, sizeof(iteration));
+  get(&num_scalars, sizeof(num_scalars));
+  vector<double> scalars(num_scalars);
+  get(scalars.data(), num_scalars * sizeof(double));
+
+  get(&num_vectors, sizeof(num_vectors));
+  vector<uint64_t> sizes(num_vectors);
+  get(sizes.data(), num_vectors * sizeof(uint64_t));
+
+  // the layout of the state depends on the backend, its options and the
+  // size of the problem
+  vector<thrust::device_vector<T>*> vectors;
+  vector<double> current;
+  backend.StateVectors(vectors);
+  backend.GetStateScalars(current);
+
+  bool match = (scalars.size() == current.size()) && (sizes.size() == vectors.size());
+  for(size_t i = 0; match && i < sizes.size(); i++)
+    match = (sizes[i] == vectors[i]->size());
+
+  if(!match)
+    throw Exception("Checkpoint: '" + path_ + "' does not match the problem and backend.");
+
+  vector<T> values;
+  for(size_t i = 0; i < vectors.size(); i++)
+  {
+    values.resize(sizes[i]);
+    get(values.data(), sizes[i] * sizeof(T));
+
+    if(sizes[i] > 0)
+    {
+      cudaMemcpyAsync(thrust::raw_pointer_cast(vectors[i]->data()), values.data(),
+                      sizes[i] * sizeof(T), cudaMemcpyHostToDevice, stream);
+      cudaStreamSynchronize(stream);
+    }
+  }
+
+  backend.SetStateScalars(scalars, stream);
+
+  return static_cast<int>(iteration);
+}
+
+// Explicit template instantiation
+template class Checkpoint<float>;
+template class Checkpoint<double>;
+
+} // namespace prost
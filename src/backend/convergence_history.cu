@@ -0,0 +1,222 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include <algorithm>
+#include <limits>
+
+#include "prost/backend/convergence_history.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+__global__
+void ConvergenceHistoryRecordKernel(
+  HistoryEntry<T> *d_entry,
+  HistoryEntry<T> entry,
+  const T *d_sums,
+  T eps_abs_primal,
+  T tol_rel_primal,
+  T eps_abs_dual,
+  T tol_rel_dual,
+  const int *d_cg_iters)
+{
+  if(d_sums != nullptr)
+  {
+    entry.primal_residual = sqrt(d_sums[0]);
+    entry.eps_primal = eps_abs_primal + tol_rel_primal * sqrt(d_sums[1]);
+    entry.dual_residual = sqrt(d_sums[2]);
+    entry.eps_dual = eps_abs_dual + tol_rel_dual * sqrt(d_sums[3]);
+  }
+
+  if(d_cg_iters != nullptr)
+    entry.cg_iters = *d_cg_iters;
+
+  *d_entry = entry;
+}
+
+template<typename T>
+ConvergenceHistory<T>::ConvergenceHistory()
+  : capacity_(0), host_(nullptr), event_(nullptr), 
+    recorded_(0), flushed_(0), collected_(0), pending_(false), dropped_(0)
+{
+}
+
+template<typename T>
+ConvergenceHistory<T>::~ConvergenceHistory()
+{
+  Release();
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Initialize(
+  size_t capacity,
+  T eps_abs_primal,
+  T tol_rel_primal,
+  T eps_abs_dual,
+  T tol_rel_dual)
+{
+  Release();
+
+  eps_abs_primal_ = eps_abs_primal;
+  tol_rel_primal_ = tol_rel_primal;
+  eps_abs_dual_ = eps_abs_dual;
+  tol_rel_dual_ = tol_rel_dual;
+  recorded_ = flushed_ = collected_ = 0;
+  pending_ = false;
+
+  if(capacity == 0)
+    return;
+
+  try
+  {
+    ring_.resize(capacity);
+  }
+  catch(std::bad_alloc& e)
+  {
+    throw OutOfMemoryException("ConvergenceHistory: out of memory for the ring buffer.");
+  }
+
+  if(cudaMallocHost(&host_, capacity * sizeof(HistoryEntry<T>)) != cudaSuccess)
+  {
+    host_ = nullptr;
+    throw Exception("ConvergenceHistory: failed to allocate pinned memory.");
+  }
+
+  cudaEventCreateWithFlags(&event_, cudaEventDisableTiming);
+  capacity_ = capacity;
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Release()
+{
+  if(event_ != nullptr)
+  {
+    cudaEventSynchronize(event_);
+    cudaEventDestroy(event_);
+    event_ = nullptr;
+  }
+
+  if(host_ != nullptr)
+  {
+    cudaFreeHost(host_);
+    host_ = nullptr;
+  }
+
+  ring_.clear(); ring_.shrink_to_fit();
+  capacity_ = 0;
+  pending_ = false;
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Clear()
+{
+  if(pending_)
+    cudaEventSynchronize(event_);
+
+  // entries recorded before are not collected anymore
+  flushed_ = collected_ = recorded_;
+  pending_ = false;
+
+  entries_.clear();
+  dropped_ = 0;
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Record(
+  const HistoryEntry<T>& entry,
+  const T *d_sums,
+  const int *d_cg_iters,
+  cudaStream_t stream)
+{
+  if(capacity_ == 0)
+    return;
+
+  ConvergenceHistoryRecordKernel<T>
+    <<<1, 1, 0, stream>>>(
+      thrust::raw_pointer_cast(ring_.data()) + (recorded_ % capacity_),
+      entry,
+      d_sums,
+      eps_abs_primal_,
+      tol_rel_primal_,
+      eps_abs_dual_,
+      tol_rel_dual_,
+      d_cg_iters);
+
+  recorded_++;
+}
+
+template<typename T>
+void ConvergenceHistory<T>::RecordHost(const HistoryEntry<T>& entry)
+{
+  entries_.push_back(entry);
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Flush(cudaStream_t stream)
+{
+  Collect();
+
+  if(capacity_ == 0 || recorded_ == collected_)
+    return;
+
+  // the ring is small, copying all of it avoids splitting wrapped ranges
+  cudaMemcpyAsync(host_, 
+                  thrust::raw_pointer_cast(ring_.data()),
+                  std::min(recorded_, capacity_) * sizeof(HistoryEntry<T>),
+                  cudaMemcpyDeviceToHost, 
+                  stream);
+  cudaEventRecord(event_, stream);
+
+  flushed_ = recorded_;
+  pending_ = true;
+}
+
+template<typename T>
+void ConvergenceHistory<T>::Collect()
+{
+  if(!pending_)
+    return;
+
+  cudaEventSynchronize(event_);
+  pending_ = false;
+
+  const size_t fresh = flushed_ - collected_;
+  const size_t kept = std::min(fresh, capacity_);
+  dropped_ += fresh - kept;
+
+  for(size_t k = flushed_ - kept; k < flushed_; k++)
+    entries_.push_back(host_[k % capacity_]);
+
+  collected_ = flushed_;
+}
+
+template<typename T>
+T ConvergenceHistory<T>::nan()
+{
+  return std::numeric_limits<T>::quiet_NaN();
+}
+
+// Explicit template instantiation
+template class ConvergenceHistory<float>;
+template class ConvergenceHistory<double>;
+
+} // namespace prost
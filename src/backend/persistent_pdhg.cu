@@ -0,0 +1,869 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+#include "prost/backend/persistent_pdhg.hpp"
+#include "prost/backend/residual_sums.hpp"
+#include "prost/linop/linearoperator.hpp"
+#include "prost/linop/block_gradient2d.hpp"
+#include "prost/linop/block_gradient3d.hpp"
+#include "prost/linop/block_zero.hpp"
+#include "prost/prox/prox.hpp"
+#include "prost/prox/prox_elem_operation.hpp"
+#include "prost/prox/prox_moreau.hpp"
+#include "prost/prox/prox_zero.hpp"
+#include "prost/prox/elemop/elem_operation_1d.hpp"
+#include "prost/prox/elemop/function_1d.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+
+namespace prost {
+
+/// \brief Function1D types of the ElemOperation1D proxs supported by the
+///        persistent kernel, stored in PersistentProxSegment::fun.
+enum PersistentFunction1D
+{
+  kPersistentZero = 0,
+  kPersistentAbs,
+  kPersistentSquare,
+  kPersistentIndLeq0,
+  kPersistentIndGeq0,
+  kPersistentIndEq0,
+  kPersistentIndBox01,
+  kPersistentMaxPos0,
+  kPersistentL0,
+  kPersistentHuber,
+  kPersistentLq,
+  kPersistentTruncQuad,
+  kPersistentLqPlusEps,
+  kPersistentTruncLinear,
+};
+
+/// \brief Arguments of the persistent kernel.
+template<typename T>
+struct PersistentPDHGParams
+{
+  PersistentPDHGState<T> state;
+  size_t nrows;
+  size_t ncols;
+  int count;
+
+  const int32_t *row_ptr, *row_ind;
+  const T *row_val;
+  const int32_t *col_ptr, *col_ind;
+  const T *col_val;
+
+  const PersistentStencil *stencils;
+  int num_stencils;
+
+  const PersistentProxSegment<T> *segments;
+  const int32_t *segment_g;
+  const int32_t *segment_f;
+
+  typename PersistentPDHG<T>::Settings settings;
+
+  T *d_partials;
+  T *d_sums;
+  unsigned int *d_count;
+  unsigned int *d_barrier;
+  double *d_status;
+};
+
+/// \brief Evaluates the ElemOperation1D with the function FUN on a single
+///        element held in registers.
+template<typename T, class FUN>
+inline __device__
+T PersistentElemOperation1D(T *coeffs, T arg, T tau_diag, T tau, bool invert_tau)
+{
+  typedef ElemOperation1D<T, FUN> OP;
+
+  T res;
+  Vector<T> res_vec(1, 1, false, 0, &res);
+  const Vector<const T> arg_vec(1, 1, false, 0, &arg);
+  const Vector<const T> tau_vec(1, 1, false, 0, &tau_diag);
+
+  SharedMem<typename OP::SharedMemType, typename OP::GetSharedMemCount> sh_mem(1, threadIdx.x);
+
+  OP op(coeffs, 1, sh_mem);
+  op(res_vec, arg_vec, tau_vec, tau, invert_tau);
+
+  return res;
+}
+
+template<typename T>
+inline __device__
+T PersistentProx1D(int fun, T *coeffs, T arg, T tau_diag, T tau, bool invert_tau)
+{
+  switch(fun)
+  {
+  case kPersistentZero:
+    return PersistentElemOperation1D<T, Function1DZero<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentAbs:
+    return PersistentElemOperation1D<T, Function1DAbs<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentSquare:
+    return PersistentElemOperation1D<T, Function1DSquare<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentIndLeq0:
+    return PersistentElemOperation1D<T, Function1DIndLeq0<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentIndGeq0:
+    return PersistentElemOperation1D<T, Function1DIndGeq0<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentIndEq0:
+    return PersistentElemOperation1D<T, Function1DIndEq0<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentIndBox01:
+    return PersistentElemOperation1D<T, Function1DIndBox01<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentMaxPos0:
+    return PersistentElemOperation1D<T, Function1DMaxPos0<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentL0:
+    return PersistentElemOperation1D<T, Function1DL0<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentHuber:
+    return PersistentElemOperation1D<T, Function1DHuber<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentLq:
+    return PersistentElemOperation1D<T, Function1DLq<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentTruncQuad:
+    return PersistentElemOperation1D<T, Function1DTruncQuad<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentLqPlusEps:
+    return PersistentElemOperation1D<T, Function1DLqPlusEps<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  case kPersistentTruncLinear:
+    return PersistentElemOperation1D<T, Function1DTruncLinear<T> >(coeffs, arg, tau_diag, tau, invert_tau);
+  }
+
+  return arg;
+}
+
+/// \brief Prox of the variable i with the given argument, the conjugate
+///        is evaluated the same way as by ProxMoreau.
+template<typename T>
+inline __device__
+T PersistentProx(
+  const PersistentProxSegment<T> *segments,
+  int32_t segment,
+  size_t i,
+  T arg,
+  T tau_diag,
+  T tau)
+{
+  if(segment < 0)
+    return arg;
+
+  const PersistentProxSegment<T>& s = segments[segment];
+
+  T coeffs[PersistentProxSegment<T>::kCoeffs];
+  if(s.fun >= 0)
+  {
+    const size_t el = i - s.index;
+
+    for(int c = 0; c < PersistentProxSegment<T>::kCoeffs; c++)
+      coeffs[c] = (s.dev_p[c] == nullptr) ? s.val[c] : s.dev_p[c][el];
+  }
+
+  if(!s.moreau)
+    return (s.fun < 0) ? arg : PersistentProx1D<T>(s.fun, coeffs, arg, tau_diag, tau, false);
+
+  const T scaled = arg / (tau * tau_diag);
+  const T res = (s.fun < 0) ? scaled : PersistentProx1D<T>(s.fun, coeffs, scaled, tau_diag, tau, true);
+
+  return arg - tau * tau_diag * res;
+}
+
+/// \brief Position of the variable idx of a gradient block and the 
+///        offsets of its neighbours in x, y and l direction.
+struct PersistentStencilPoint
+{
+  size_t x, y, l;
+  size_t sx, sy, sl;
+};
+
+inline __device__
+PersistentStencilPoint PersistentStencilLocate(const PersistentStencil& s, size_t idx)
+{
+  PersistentStencilPoint p;
+
+  if(s.label_first)
+  {
+    p.l = idx % s.L;
+    p.y = (idx / s.L) % s.ny;
+    p.x = idx / (s.L * s.ny);
+    p.sl = 1;
+    p.sy = s.L;
+    p.sx = s.ny * s.L;
+  }
+  else
+  {
+    p.y = idx % s.ny;
+    p.x = (idx / s.ny) % s.nx;
+    p.l = idx / (s.nx * s.ny);
+    p.sy = 1;
+    p.sx = s.ny;
+    p.sl = s.nx * s.ny;
+  }
+
+  return p;
+}
+
+/// \brief Row r of the gradient of rhs, relative to the block. Same
+///        boundary conditions as BlockGradient2DKernel and 
+///        BlockGradient3DKernel.
+template<typename T>
+inline __device__
+T PersistentStencilRow(const PersistentStencil& s, const T *rhs, size_t r)
+{
+  const size_t N = s.nx * s.ny * s.L;
+  const size_t c = r / N;
+  const size_t idx = r % N;
+  const PersistentStencilPoint p = PersistentStencilLocate(s, idx);
+
+  const T val_pt = rhs[idx];
+
+  if(c == 0)
+    return (p.x < s.nx - 1) ? (rhs[idx + p.sx] - val_pt) : static_cast<T>(0);
+
+  if(c == 1)
+    return (p.y < s.ny - 1) ? (rhs[idx + p.sy] - val_pt) : static_cast<T>(0);
+
+  return (p.l < s.L - 1) ? (rhs[idx + p.sl] - val_pt) : -val_pt; // dirichlet
+}
+
+/// \brief Column idx of the adjoint, minus the divergence of rhs.
+template<typename T>
+inline __device__
+T PersistentStencilColumn(const PersistentStencil& s, const T *rhs, size_t idx)
+{
+  const size_t N = s.nx * s.ny * s.L;
+  const PersistentStencilPoint p = PersistentStencilLocate(s, idx);
+
+  T divx = (p.x < s.nx - 1) ? rhs[idx] : static_cast<T>(0);
+  if(p.x > 0)
+    divx -= rhs[idx - p.sx];
+
+  T divy = (p.y < s.ny - 1) ? rhs[N + idx] : static_cast<T>(0);
+  if(p.y > 0)
+    divy -= rhs[N + idx - p.sy];
+
+  if(s.dims < 3)
+    return -(divx + divy);
+
+  T divl = rhs[2 * N + idx];
+  if(p.l > 0)
+    divl -= rhs[2 * N + idx - p.sl];
+
+  return -(divx + divy + divl);
+}
+
+/// \brief Row r of K x.
+template<typename T>
+inline __device__
+T PersistentEvalRow(const PersistentPDHGParams<T>& p, const T *x, size_t r)
+{
+  T sum = 0;
+
+  for(int32_t k = p.row_ptr[r]; k < p.row_ptr[r + 1]; k++)
+    sum += p.row_val[k] * x[p.row_ind[k]];
+
+  for(int i = 0; i < p.num_stencils; i++)
+  {
+    const PersistentStencil& s = p.stencils[i];
+
+    if(r >= s.row && r < s.row + s.dims * s.nx * s.ny * s.L)
+      sum += PersistentStencilRow<T>(s, x + s.col, r - s.row);
+  }
+
+  return sum;
+}
+
+/// \brief Column j of K^T y.
+template<typename T>
+inline __device__
+T PersistentEvalColumn(const PersistentPDHGParams<T>& p, const T *y, size_t j)
+{
+  T sum = 0;
+
+  for(int32_t k = p.col_ptr[j]; k < p.col_ptr[j + 1]; k++)
+    sum += p.col_val[k] * y[p.col_ind[k]];
+
+  for(int i = 0; i < p.num_stencils; i++)
+  {
+    const PersistentStencil& s = p.stencils[i];
+
+    if(j >= s.col && j < s.col + s.nx * s.ny * s.L)
+      sum += PersistentStencilColumn<T>(s, y + s.row, j - s.col);
+  }
+
+  return sum;
+}
+
+/// \brief Barrier over all blocks of the cooperative launch, the global
+///        memory writes before it are visible to all threads after it.
+///        d_barrier[0] counts the arrived blocks, the last one resets it
+///        and releases the others by incrementing d_barrier[1].
+inline __device__
+void PersistentGridSync(unsigned int *d_barrier)
+{
+  __syncthreads();
+
+  if(threadIdx.x == 0)
+  {
+    volatile unsigned int *generation = d_barrier + 1;
+    const unsigned int gen = *generation;
+
+    __threadfence();
+
+    if(atomicAdd(d_barrier, 1) == gridDim.x - 1)
+    {
+      atomicExch(d_barrier, 0);
+      __threadfence();
+      atomicAdd(d_barrier + 1, 1);
+    }
+    else
+    {
+      while(*generation == gen) { }
+    }
+
+    __threadfence();
+  }
+
+  __syncthreads();
+}
+
+template<typename T>
+inline __device__
+void PersistentSwap(T *&a, T *&b)
+{
+  T *tmp = a;
+  a = b;
+  b = tmp;
+}
+
+///
+/// \brief Performs up to p.count iterations of BackendPDHG, in the same
+///        order of operations as PerformIteration(). All threads hold the
+///        step sizes and swap the iterate pointers in lockstep.
+///
+template<typename T>
+__global__
+void PersistentPDHGKernel(PersistentPDHGParams<T> p)
+{
+  const size_t tid = threadIdx.x + blockIdx.x * blockDim.x;
+  const size_t stride = blockDim.x * gridDim.x;
+
+  PersistentPDHGState<T> s = p.state;
+  const T *scaling_left = s.scaling_left;
+  const T *scaling_right = s.scaling_right;
+  const typename PersistentPDHG<T>::Settings& opts = p.settings;
+
+  // x^{k+1} = prox_g(x^k - tau T K^T y^k)
+  PersistentSwap(s.x, s.x_prev);
+  for(size_t j = tid; j < p.ncols; j += stride)
+  {
+    const T d = scaling_right[j];
+    s.x[j] = PersistentProx<T>(p.segments, p.segment_g[j], j, 
+                               s.x_prev[j] - s.tau * d * s.kty[j], d, s.tau);
+  }
+  PersistentGridSync(p.d_barrier);
+
+  int k = 0;
+  bool stop = false;
+
+  while(!stop)
+  {
+    // K x^{k+1} and y^{k+1} = prox_fstar(y^k + sigma S K (x^{k+1} + theta (x^{k+1} - x^k)))
+    PersistentSwap(s.kx, s.kx_prev);
+    PersistentSwap(s.y, s.y_prev);
+    for(size_t r = tid; r < p.nrows; r += stride)
+    {
+      const T kx = PersistentEvalRow<T>(p, s.x, r);
+      const T d = scaling_left[r];
+
+      s.kx[r] = kx;
+      s.y[r] = PersistentProx<T>(p.segments, p.segment_f[r], r, 
+                                 s.y_prev[r] + s.sigma * d * ((1 + s.theta) * kx - s.theta * s.kx_prev[r]), 
+                                 d, s.sigma);
+    }
+    PersistentGridSync(p.d_barrier);
+
+    k++;
+    stop = (k == p.count);
+
+    const bool due = stop || ((opts.residual_iter > 0) ? 
+                              (s.iteration % opts.residual_iter) == 0 : s.iteration == 0);
+
+    if(due)
+    {
+      T acc[4] = { 0, 0, 0, 0 };
+      primal_residual_transform<T> primal(s.sigma, s.theta);
+      dual_residual_transform<T> dual(s.tau);
+
+      const size_t count = max(p.nrows, p.ncols);
+      for(size_t i = tid; i < count; i += stride)
+      {
+        if(i < p.nrows)
+        {
+          thrust::tuple<T, T> r = primal(thrust::make_tuple(
+            s.y_prev[i], s.y[i], scaling_left[i], s.kx_prev[i], s.kx[i]));
+
+          acc[0] += thrust::get<0>(r);
+          acc[1] += thrust::get<1>(r);
+        }
+
+        if(i < p.ncols)
+        {
+          thrust::tuple<T, T> r = dual(thrust::make_tuple(
+            s.x_prev[i], s.x[i], scaling_right[i], s.kty_prev[i], s.kty[i]));
+
+          acc[2] += thrust::get<0>(r);
+          acc[3] += thrust::get<1>(r);
+        }
+      }
+
+      ResidualSumsReduce<T, 4>(acc, p.d_partials, p.d_sums, p.d_count);
+      PersistentGridSync(p.d_barrier);
+
+      const volatile T *sums = p.d_sums;
+      const T eps_primal = opts.eps_abs_primal + opts.eps_rel_primal * sqrt(sums[1]);
+      const T eps_dual = opts.eps_abs_dual + opts.eps_rel_dual * sqrt(sums[3]);
+
+      if(sqrt(sums[0]) < eps_primal && sqrt(sums[2]) < eps_dual)
+        stop = true;
+    }
+
+    if(opts.alg2)
+    {
+      s.theta = 1. / sqrt(1. + 2. * opts.alg2_gamma * s.tau);
+      s.tau = s.theta * s.tau;
+      s.sigma = s.sigma / s.theta;
+    }
+
+    s.iteration++;
+
+    // K^T y^{k+1}, followed by the primal step of the next iteration
+    PersistentSwap(s.kty, s.kty_prev);
+    if(!stop)
+      PersistentSwap(s.x, s.x_prev);
+
+    for(size_t j = tid; j < p.ncols; j += stride)
+    {
+      const T kty = PersistentEvalColumn<T>(p, s.y, j);
+      s.kty[j] = kty;
+
+      if(!stop)
+      {
+        const T d = scaling_right[j];
+        s.x[j] = PersistentProx<T>(p.segments, p.segment_g[j], j, 
+                                   s.x_prev[j] - s.tau * d * kty, d, s.tau);
+      }
+    }
+    PersistentGridSync(p.d_barrier);
+  }
+
+  if(tid == 0)
+  {
+    p.d_status[0] = s.tau;
+    p.d_status[1] = s.sigma;
+    p.d_status[2] = s.theta;
+    p.d_status[3] = k;
+  }
+}
+
+/// \brief Sorts the entries into compressed rows, major holds the row and
+///        minor the column of each entry (or vice versa for the transpose).
+template<typename T>
+static void PersistentBuildCSR(
+  size_t count,
+  const vector<int32_t>& major,
+  const vector<int32_t>& minor,
+  const vector<T>& vals,
+  vector<int32_t>& ptr,
+  vector<int32_t>& ind,
+  vector<T>& val)
+{
+  ptr.assign(count + 1, 0);
+  for(int32_t r : major)
+    ptr[r + 1]++;
+
+  for(size_t r = 0; r < count; r++)
+    ptr[r + 1] += ptr[r];
+
+  ind.resize(major.size());
+  val.resize(major.size());
+
+  vector<int32_t> pos(ptr.begin(), ptr.end() - 1);
+  for(size_t k = 0; k < major.size(); k++)
+  {
+    const int32_t dst = pos[major[k]]++;
+    ind[dst] = minor[k];
+    val[dst] = vals[k];
+  }
+}
+
+template<typename T>
+static bool PersistentAddSegment(
+  const Prox<T>& prox,
+  int fun,
+  bool moreau,
+  T *const *dev_p,
+  const T *val,
+  vector<PersistentProxSegment<T> >& segments,
+  vector<int32_t>& segment_of)
+{
+  if(prox.index() + prox.size() > segment_of.size())
+    return false;
+
+  PersistentProxSegment<T> seg;
+  seg.index = prox.index();
+  seg.fun = fun;
+  seg.moreau = moreau;
+
+  for(int c = 0; c < PersistentProxSegment<T>::kCoeffs; c++)
+  {
+    seg.dev_p[c] = (dev_p == nullptr) ? nullptr : dev_p[c];
+    seg.val[c] = (val == nullptr) ? 0 : val[c];
+  }
+
+  const int32_t id = static_cast<int32_t>(segments.size());
+  segments.push_back(seg);
+
+  std::fill(segment_of.begin() + prox.index(), 
+            segment_of.begin() + prox.index() + prox.size(), id);
+
+  return true;
+}
+
+template<typename T>
+static bool PersistentAppendZero(
+  const Prox<T>& prox,
+  bool moreau,
+  vector<PersistentProxSegment<T> >& segments,
+  vector<int32_t>& segment_of)
+{
+  if(dynamic_cast<const ProxZero<T> *>(&prox) == nullptr)
+    return false;
+
+  return PersistentAddSegment<T>(prox, -1, moreau, nullptr, nullptr, segments, segment_of);
+}
+
+/// \brief Appends a ProxElemOperation with the ElemOperation1D of FUN, or
+///        a batch of them.
+template<typename T, class FUN>
+static bool PersistentAppendFunction1D(
+  const Prox<T>& prox,
+  int fun,
+  bool moreau,
+  vector<PersistentProxSegment<T> >& segments,
+  vector<int32_t>& segment_of)
+{
+  typedef ElemOperation1D<T, FUN> OP;
+
+  const ProxElemOperation<T, OP> *elem = dynamic_cast<const ProxElemOperation<T, OP> *>(&prox);
+  if(elem != nullptr)
+  {
+    const ElemOpCoefficients<T, OP> coeffs = elem->coefficients();
+    return PersistentAddSegment<T>(prox, fun, moreau, coeffs.dev_p, coeffs.val, segments, segment_of);
+  }
+
+  const ProxElemOperationBatch<T, OP> *batch = dynamic_cast<const ProxElemOperationBatch<T, OP> *>(&prox);
+  if(batch == nullptr)
+    return false;
+
+  for(auto& member : batch->members())
+  {
+    if(!PersistentAppendZero<T>(*member, moreau, segments, segment_of) &&
+       !PersistentAppendFunction1D<T, FUN>(*member, fun, moreau, segments, segment_of))
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+template<typename T>
+static bool PersistentAppendProx(
+  const Prox<T>& prox,
+  bool moreau,
+  vector<PersistentProxSegment<T> >& segments,
+  vector<int32_t>& segment_of)
+{
+  const ProxMoreau<T> *conj = dynamic_cast<const ProxMoreau<T> *>(&prox);
+  if(conj != nullptr)
+    return !moreau && PersistentAppendProx<T>(*conj->conjugate(), true, segments, segment_of);
+
+  return PersistentAppendZero<T>(prox, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DZero<T> >(prox, kPersistentZero, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DAbs<T> >(prox, kPersistentAbs, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DSquare<T> >(prox, kPersistentSquare, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DIndLeq0<T> >(prox, kPersistentIndLeq0, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DIndGeq0<T> >(prox, kPersistentIndGeq0, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DIndEq0<T> >(prox, kPersistentIndEq0, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DIndBox01<T> >(prox, kPersistentIndBox01, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DMaxPos0<T> >(prox, kPersistentMaxPos0, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DL0<T> >(prox, kPersistentL0, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DHuber<T> >(prox, kPersistentHuber, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DLq<T> >(prox, kPersistentLq, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DTruncQuad<T> >(prox, kPersistentTruncQuad, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DLqPlusEps<T> >(prox, kPersistentLqPlusEps, moreau, segments, segment_of) ||
+    PersistentAppendFunction1D<T, Function1DTruncLinear<T> >(prox, kPersistentTruncLinear, moreau, segments, segment_of);
+}
+
+template<typename T>
+PersistentPDHG<T>::PersistentPDHG()
+  : nrows_(0), ncols_(0), host_status_(nullptr), grid_size_(0)
+{
+}
+
+template<typename T>
+PersistentPDHG<T>::~PersistentPDHG()
+{
+  Release();
+}
+
+template<typename T>
+bool PersistentPDHG<T>::Initialize(
+  Problem<T>& problem,
+  const vector<shared_ptr<Prox<T>>>& prox_g,
+  const vector<shared_ptr<Prox<T>>>& prox_fstar,
+  const Settings& settings)
+{
+  Release();
+
+#if CUDART_VERSION >= 9000
+  int device = 0;
+  int cooperative = 0;
+  int num_sms = 0;
+  cudaGetDevice(&device);
+  cudaDeviceGetAttribute(&cooperative, cudaDevAttrCooperativeLaunch, device);
+  cudaDeviceGetAttribute(&num_sms, cudaDevAttrMultiProcessorCount, device);
+
+  if(!cooperative)
+    return false;
+
+  int blocks_per_sm = 0;
+  if(cudaOccupancyMaxActiveBlocksPerMultiprocessor(
+       &blocks_per_sm, PersistentPDHGKernel<T>, kBlockSizeCUDA, 0) != cudaSuccess)
+  {
+    cudaGetLastError();
+    return false;
+  }
+
+  if(blocks_per_sm == 0)
+    return false;
+
+  settings_ = settings;
+  nrows_ = problem.nrows();
+  ncols_ = problem.ncols();
+
+  // the stored blocks are assembled into a sparse matrix, the gradients
+  // are evaluated matrix-free
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+  vector<PersistentStencil> stencils;
+
+  for(auto& block : problem.linop()->blocks())
+  {
+    if(dynamic_cast<const BlockZero<T> *>(block.get()) != nullptr)
+      continue;
+
+    const BlockGradient2D<T> *grad2d = dynamic_cast<const BlockGradient2D<T> *>(block.get());
+    const BlockGradient3D<T> *grad3d = dynamic_cast<const BlockGradient3D<T> *>(block.get());
+
+    if(grad2d != nullptr || grad3d != nullptr)
+    {
+      PersistentStencil s;
+      s.row = block->row();
+      s.col = block->col();
+      s.nx = grad2d ? grad2d->nx() : grad3d->nx();
+      s.ny = grad2d ? grad2d->ny() : grad3d->ny();
+      s.L = grad2d ? grad2d->L() : grad3d->L();
+      s.label_first = grad2d ? grad2d->label_first() : grad3d->label_first();
+      s.dims = grad2d ? 2 : 3;
+
+      stencils.push_back(s);
+      continue;
+    }
+
+    if(!block->AppendTriplets(rows, cols, vals))
+      return false;
+  }
+
+  if(vals.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+    return false;
+
+  vector<int32_t> row_ptr, row_ind, col_ptr, col_ind;
+  vector<T> row_val, col_val;
+  PersistentBuildCSR<T>(nrows_, rows, cols, vals, row_ptr, row_ind, row_val);
+  PersistentBuildCSR<T>(ncols_, cols, rows, vals, col_ptr, col_ind, col_val);
+
+  // variables without a prox are left unchanged
+  vector<PersistentProxSegment<T> > segments;
+  vector<int32_t> segment_g(ncols_, -1), segment_f(nrows_, -1);
+
+  for(auto& prox : prox_g)
+    if(!PersistentAppendProx<T>(*prox, false, segments, segment_g))
+      return false;
+
+  for(auto& prox : prox_fstar)
+    if(!PersistentAppendProx<T>(*prox, false, segments, segment_f))
+      return false;
+
+  // all blocks have to be resident at the same time
+  const size_t needed = (std::max(nrows_, ncols_) + kBlockSizeCUDA - 1) / kBlockSizeCUDA;
+  grid_size_ = static_cast<int>(std::min<size_t>(
+    std::min<size_t>(blocks_per_sm * num_sms, kResidualSumsMaxBlocks), 
+    std::max<size_t>(needed, 1)));
+
+  try
+  {
+    row_ptr_ = row_ptr;
+    row_ind_ = row_ind;
+    row_val_ = row_val;
+    col_ptr_ = col_ptr;
+    col_ind_ = col_ind;
+    col_val_ = col_val;
+    stencils_ = stencils;
+    segments_ = segments;
+    segment_g_ = segment_g;
+    segment_f_ = segment_f;
+    barrier_.assign(2, 0);
+    status_.assign(4, 0);
+  }
+  catch(std::bad_alloc& e)
+  {
+    std::stringstream ss;
+    ss << "PersistentPDHG: out of memory: " << e.what();
+    throw OutOfMemoryException(ss.str());
+  }
+
+  if(cudaMallocHost(&host_status_, 4 * sizeof(double)) != cudaSuccess)
+  {
+    host_status_ = nullptr;
+    throw Exception("PersistentPDHG: failed to allocate pinned memory.");
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+template<typename T>
+void PersistentPDHG<T>::Release()
+{
+  if(host_status_ != nullptr)
+  {
+    cudaFreeHost(host_status_);
+    host_status_ = nullptr;
+  }
+
+  row_ptr_.clear(); row_ptr_.shrink_to_fit();
+  row_ind_.clear(); row_ind_.shrink_to_fit();
+  row_val_.clear(); row_val_.shrink_to_fit();
+  col_ptr_.clear(); col_ptr_.shrink_to_fit();
+  col_ind_.clear(); col_ind_.shrink_to_fit();
+  col_val_.clear(); col_val_.shrink_to_fit();
+  stencils_.clear(); stencils_.shrink_to_fit();
+  segments_.clear(); segments_.shrink_to_fit();
+  segment_g_.clear(); segment_g_.shrink_to_fit();
+  segment_f_.clear(); segment_f_.shrink_to_fit();
+  barrier_.clear(); barrier_.shrink_to_fit();
+  status_.clear(); status_.shrink_to_fit();
+
+  grid_size_ = 0;
+}
+
+template<typename T>
+int PersistentPDHG<T>::Run(
+  PersistentPDHGState<T>& state, 
+  int count, 
+  ResidualSums<T>& sums, 
+  cudaStream_t stream)
+{
+  if(count <= 0 || grid_size_ == 0)
+    return 0;
+
+#if CUDART_VERSION >= 9000
+  PersistentPDHGParams<T> p;
+  p.state = state;
+  p.nrows = nrows_;
+  p.ncols = ncols_;
+  p.count = count;
+  p.row_ptr = thrust::raw_pointer_cast(row_ptr_.data());
+  p.row_ind = thrust::raw_pointer_cast(row_ind_.data());
+  p.row_val = thrust::raw_pointer_cast(row_val_.data());
+  p.col_ptr = thrust::raw_pointer_cast(col_ptr_.data());
+  p.col_ind = thrust::raw_pointer_cast(col_ind_.data());
+  p.col_val = thrust::raw_pointer_cast(col_val_.data());
+  p.stencils = thrust::raw_pointer_cast(stencils_.data());
+  p.num_stencils = static_cast<int>(stencils_.size());
+  p.segments = thrust::raw_pointer_cast(segments_.data());
+  p.segment_g = thrust::raw_pointer_cast(segment_g_.data());
+  p.segment_f = thrust::raw_pointer_cast(segment_f_.data());
+  p.settings = settings_;
+  p.d_partials = sums.d_partials();
+  p.d_sums = sums.d_sums();
+  p.d_count = sums.d_count();
+  p.d_barrier = thrust::raw_pointer_cast(barrier_.data());
+  p.d_status = thrust::raw_pointer_cast(status_.data());
+
+  void *args[] = { &p };
+
+  cudaError_t err = cudaLaunchCooperativeKernel(
+    (const void *)PersistentPDHGKernel<T>, dim3(grid_size_, 1, 1), dim3(kBlockSizeCUDA, 1, 1), 
+    args, 0, stream);
+
+  if(err != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << "PersistentPDHG: cooperative launch failed: " << cudaGetErrorString(err) << ".";
+    throw Exception(ss.str());
+  }
+
+  cudaMemcpyAsync(host_status_, p.d_status, 4 * sizeof(double), 
+                  cudaMemcpyDeviceToHost, stream);
+  sums.CopyToHost(stream);
+  sums.Ready(true);
+
+  const int done = static_cast<int>(host_status_[3]);
+  state.tau = static_cast<T>(host_status_[0]);
+  state.sigma = static_cast<T>(host_status_[1]);
+  state.theta = static_cast<T>(host_status_[2]);
+  state.iteration += done;
+
+  return done;
+#else
+  return 0;
+#endif
+}
+
+template<typename T>
+size_t PersistentPDHG<T>::gpu_mem_amount() const
+{
+  return (row_ptr_.size() + row_ind_.size() + col_ptr_.size() + col_ind_.size() +
+          segment_g_.size() + segment_f_.size()) * sizeof(int32_t) +
+    (row_val_.size() + col_val_.size()) * sizeof(T) +
+    stencils_.size() * sizeof(PersistentStencil) +
+    segments_.size() * sizeof(PersistentProxSegment<T>);
+}
+
+// Explicit template instantiation
+template class PersistentPDHG<float>;
+template class PersistentPDHG<double>;
+
+} // namespace prost
@@ -0,0 +1,160 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "prost/backend/residual_schedule.hpp"
+
+namespace prost {
+
+ResidualSchedule::ResidualSchedule()
+  : adaptive_(false), interval_(1), max_interval_(1)
+{
+  Restart();
+}
+
+void ResidualSchedule::Reset(int interval, bool adaptive, int max_interval)
+{
+  adaptive_ = adaptive;
+  interval_ = interval;
+  max_interval_ = max_interval;
+
+  if(adaptive_)
+  {
+    interval_ = std::max(interval_, 1);
+    max_interval_ = std::max(max_interval_, interval_);
+  }
+
+  Restart();
+}
+
+void ResidualSchedule::Restart()
+{
+  gap_ = std::max(interval_, 1);
+  next_ = 0;
+  requested_ = true;
+  has_prev_ = false;
+  prev_iteration_ = 0;
+  prev_log_ratio_ = 0;
+  rate_ = 0;
+}
+
+bool ResidualSchedule::is_due(size_t iteration) const
+{
+  if(requested_)
+    return true;
+
+  if(!adaptive_)
+  {
+    if(interval_ <= 0)
+      return iteration == 0;
+
+    return (iteration % interval_) == 0;
+  }
+
+  return iteration >= next_;
+}
+
+size_t ResidualSchedule::next_due(size_t iteration) const
+{
+  if(!adaptive_)
+  {
+    if(interval_ <= 0)
+      return std::numeric_limits<size_t>::max();
+
+    return (iteration / interval_ + 1) * interval_;
+  }
+
+  return std::max(next_, iteration + 1);
+}
+
+void ResidualSchedule::Issued(size_t iteration)
+{
+  requested_ = false;
+
+  // tentative until the residuals arrive
+  next_ = iteration + gap_;
+}
+
+void ResidualSchedule::Update(size_t iteration, double primal_ratio, double dual_ratio)
+{
+  if(!adaptive_)
+    return;
+
+  const double ratio = std::max(primal_ratio, dual_ratio);
+
+  if(!std::isfinite(ratio) || ratio <= 1)
+  {
+    // converged or broken, keep checking densely
+    gap_ = interval_;
+  }
+  else
+  {
+    const double log_ratio = std::log(ratio);
+
+    if(has_prev_ && iteration > prev_iteration_)
+    {
+      const double rate = (prev_log_ratio_ - log_ratio) / (iteration - prev_iteration_);
+      rate_ = (rate_ > 0) ? 0.5 * (rate_ + rate) : rate;
+    }
+
+    double gap;
+    if(rate_ > 0)
+      gap = 0.5 * log_ratio / rate_; // halfway to the predicted convergence
+    else
+      gap = 2.0 * gap_; // no decay measured yet, back off
+
+    gap = std::min(std::max(gap, static_cast<double>(interval_)), 
+                   static_cast<double>(max_interval_));
+    gap_ = static_cast<size_t>(gap);
+
+    has_prev_ = true;
+    prev_iteration_ = iteration;
+    prev_log_ratio_ = log_ratio;
+  }
+
+  next_ = iteration + gap_;
+}
+
+void ResidualSchedule::GetState(std::vector<double>& state) const
+{
+  state.push_back(static_cast<double>(gap_));
+  state.push_back(static_cast<double>(next_));
+  state.push_back(requested_ ? 1 : 0);
+  state.push_back(has_prev_ ? 1 : 0);
+  state.push_back(static_cast<double>(prev_iteration_));
+  state.push_back(prev_log_ratio_);
+  state.push_back(rate_);
+}
+
+void ResidualSchedule::SetState(const std::vector<double>& state, size_t& pos)
+{
+  gap_ = static_cast<size_t>(state[pos++]);
+  next_ = static_cast<size_t>(state[pos++]);
+  requested_ = state[pos++] != 0;
+  has_prev_ = state[pos++] != 0;
+  prev_iteration_ = static_cast<size_t>(state[pos++]);
+  prev_log_ratio_ = state[pos++];
+  rate_ = state[pos++];
+}
+
+} // namespace prost
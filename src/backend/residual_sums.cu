@@ -0,0 +1,112 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+
+#include "prost/backend/residual_sums.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+ResidualSums<T>::ResidualSums()
+  : host_(nullptr), event_(nullptr)
+{
+}
+
+template<typename T>
+ResidualSums<T>::~ResidualSums()
+{
+  Release();
+}
+
+template<typename T>
+void ResidualSums<T>::Initialize()
+{
+  sums_.resize(kNumSums);
+  partials_.resize(kResidualSumsMaxBlocks * kNumSums);
+  count_.assign(1, 0);
+
+  if(host_ == nullptr)
+  {
+    if(cudaMallocHost(&host_, kNumSums * sizeof(T)) != cudaSuccess)
+    {
+      host_ = nullptr;
+      throw Exception("ResidualSums: failed to allocate pinned memory.");
+    }
+
+    std::fill(host_, host_ + kNumSums, 0);
+  }
+
+  if(event_ == nullptr)
+    cudaEventCreateWithFlags(&event_, cudaEventDisableTiming);
+}
+
+template<typename T>
+void ResidualSums<T>::Release()
+{
+  if(event_ != nullptr)
+  {
+    cudaEventSynchronize(event_);
+    cudaEventDestroy(event_);
+    event_ = nullptr;
+  }
+
+  if(host_ != nullptr)
+  {
+    cudaFreeHost(host_);
+    host_ = nullptr;
+  }
+
+  sums_.clear(); sums_.shrink_to_fit();
+  partials_.clear(); partials_.shrink_to_fit();
+  count_.clear(); count_.shrink_to_fit();
+}
+
+template<typename T>
+size_t ResidualSums<T>::grid_size(size_t count)
+{
+  const size_t blocks = (count + kBlockSizeCUDA - 1) / kBlockSizeCUDA;
+
+  return std::max<size_t>(1, std::min(blocks, kResidualSumsMaxBlocks));
+}
+
+template<typename T>
+void ResidualSums<T>::CopyToHost(cudaStream_t stream)
+{
+  cudaMemcpyAsync(host_, d_sums(), kNumSums * sizeof(T),
+                  cudaMemcpyDeviceToHost, stream);
+  cudaEventRecord(event_, stream);
+}
+
+template<typename T>
+bool ResidualSums<T>::Ready(bool block)
+{
+  if(block)
+    return cudaEventSynchronize(event_) == cudaSuccess;
+
+  return cudaEventQuery(event_) == cudaSuccess;
+}
+
+// Explicit template instantiation
+template class ResidualSums<float>;
+template class ResidualSums<double>;
+
+} // namespace prost
@@ -0,0 +1,665 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "prost/batch_solver.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <typeinfo>
+
+#include <thrust/copy.h>
+#include <thrust/fill.h>
+#include <thrust/for_each.h>
+#include <thrust/functional.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/discard_iterator.h>
+#include <thrust/iterator/permutation_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <thrust/iterator/zip_iterator.h>
+#include <thrust/reduce.h>
+#include <thrust/replace.h>
+
+#include "prost/backend/backend.hpp"
+#include "prost/linop/block.hpp"
+#include "prost/linop/block_sparse.hpp"
+#include "prost/linop/linearoperator.hpp"
+#include "prost/prox/prox.hpp"
+#include "prost/problem.hpp"
+#include "prost/solver.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+namespace {
+
+typedef std::pair<size_t, size_t> Slot;
+
+/// \brief Returns the ranges [index, index + size) of the proxs sorted by
+///        index, with the gaps in between, covering [0, n). Returns false
+///        if the proxs overlap or exceed n.
+template<typename T>
+bool ProxSlots(const vector<shared_ptr<Prox<T>>>& proxs, size_t n, vector<Slot>& slots)
+{
+  vector<Slot> ranges;
+  for(auto& prox : proxs)
+    ranges.push_back(Slot(prox->index(), prox->size()));
+
+  std::sort(ranges.begin(), ranges.end());
+
+  slots.clear();
+  size_t next = 0;
+  for(auto& range : ranges)
+  {
+    if(range.first < next || range.first + range.second > n)
+      return false;
+
+    if(range.first > next)
+      slots.push_back(Slot(next, range.first - next));
+
+    slots.push_back(range);
+    next = range.first + range.second;
+  }
+
+  if(next < n)
+    slots.push_back(Slot(next, n - next));
+
+  return true;
+}
+
+/// \brief The copies of slot [index, index + size) of all instances occupy
+///        [N index, N (index + size)), instance after instance.
+void SlotIndex(const vector<Slot>& slots, size_t num_instances, size_t n, vector<size_t>& index)
+{
+  index.resize(num_instances * n);
+
+  for(auto& slot : slots)
+    for(size_t i = 0; i < num_instances; i++)
+      for(size_t j = 0; j < slot.second; j++)
+        index[i * n + slot.first + j] = num_instances * slot.first + i * slot.second + j;
+}
+
+template<typename T>
+vector<shared_ptr<Prox<T>>> SortedByIndex(const vector<shared_ptr<Prox<T>>>& proxs)
+{
+  vector<shared_ptr<Prox<T>>> sorted = proxs;
+  std::sort(sorted.begin(), sorted.end(),
+            [](const shared_ptr<Prox<T>>& a, const shared_ptr<Prox<T>>& b) {
+              return a->index() < b->index();
+            });
+
+  return sorted;
+}
+
+/// \brief True if both lists have proxs of the same type at the same
+///        places.
+template<typename T>
+bool SameLayout(const vector<shared_ptr<Prox<T>>>& a, const vector<shared_ptr<Prox<T>>>& b)
+{
+  if(a.size() != b.size())
+    return false;
+
+  for(size_t k = 0; k < a.size(); k++)
+  {
+    if(a[k]->index() != b[k]->index() || a[k]->size() != b[k]->size() ||
+       a[k]->diagsteps() != b[k]->diagsteps() || typeid(*a[k]) != typeid(*b[k]))
+      return false;
+  }
+
+  return true;
+}
+
+} // namespace
+
+/// \brief Instance of the k-th entry, if the entries are ordered instance
+///        after instance with count entries each.
+struct batch_instance_of
+{
+  batch_instance_of(size_t count) : count_(count) { }
+
+  __host__ __device__
+  size_t operator()(size_t k) const { return k / count_; }
+
+  size_t count_;
+};
+
+/// \brief Squared residual (a + sign b)^2 and squared norm b^2.
+template<typename T>
+struct batch_residual_terms
+{
+  batch_residual_terms(T sign) : sign_(sign) { }
+
+  __host__ __device__
+  thrust::tuple<T, T> operator()(const thrust::tuple<T, T>& t) const
+  {
+    const T r = thrust::get<0>(t) + sign_ * thrust::get<1>(t);
+    return thrust::make_tuple(r * r, thrust::get<1>(t) * thrust::get<1>(t));
+  }
+
+  T sign_;
+};
+
+template<typename T>
+struct batch_tuple_plus
+{
+  __host__ __device__
+  thrust::tuple<T, T> operator()(const thrust::tuple<T, T>& a, const thrust::tuple<T, T>& b) const
+  {
+    return thrust::make_tuple(thrust::get<0>(a) + thrust::get<0>(b), thrust::get<1>(a) + thrust::get<1>(b));
+  }
+};
+
+/// \brief Copies the entries of the instances which converged in this
+///        check (mask 2) into the frozen solution.
+template<typename T>
+struct batch_freeze
+{
+  batch_freeze(const int *mask, const size_t *index, const T *sol, T *frozen, size_t count)
+    : mask_(mask), index_(index), sol_(sol), frozen_(frozen), count_(count) { }
+
+  __device__
+  void operator()(size_t k) const
+  {
+    if(mask_[k / count_] == 2)
+      frozen_[k] = sol_[index_[k]];
+  }
+
+  const int *mask_;
+  const size_t *index_;
+  const T *sol_;
+  T *frozen_;
+  size_t count_;
+};
+
+/// \brief Marks the active instances whose residuals are below their
+///        tolerances, d_residuals holds |K x - z|^2, |z|^2, |K^T y + w|^2
+///        and |w|^2 of all instances one after another.
+template<typename T>
+__global__
+void BatchCheckInstancesKernel(
+  T *d_values,
+  int *d_mask,
+  const T *d_residuals,
+  size_t num_instances,
+  T abs_primal,
+  T rel_primal,
+  T abs_dual,
+  T rel_dual)
+{
+  const size_t i = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(i >= num_instances)
+    return;
+
+  const T res_primal = sqrt(d_residuals[i]);
+  const T norm_primal = sqrt(d_residuals[num_instances + i]);
+  const T res_dual = sqrt(d_residuals[2 * num_instances + i]);
+  const T norm_dual = sqrt(d_residuals[3 * num_instances + i]);
+
+  int mask = d_mask[i];
+  if(mask == 0 && 
+     res_primal <= abs_primal + rel_primal * norm_primal &&
+     res_dual <= abs_dual + rel_dual * norm_dual)
+  {
+    mask = 2;
+  }
+
+  d_mask[i] = mask;
+  d_values[i] = res_primal;
+  d_values[num_instances + i] = res_dual;
+  d_values[2 * num_instances + i] = static_cast<T>(mask);
+}
+
+template<typename T>
+BatchSolver<T>::BatchSolver(
+  size_t num_instances, 
+  size_t nrows, 
+  size_t ncols, 
+  shared_ptr<Backend<T>> backend)
+    : num_instances_(num_instances), nrows_(nrows), ncols_(ncols), strided_(false),
+      problem_(new Problem<T>()), backend_(backend)
+{
+  if(num_instances_ == 0)
+    throw Exception("BatchSolver: at least one instance is required.");
+
+  if(nrows_ == 0 || ncols_ == 0)
+    throw Exception("BatchSolver: the instances must not be empty.");
+}
+
+template<typename T> 
+void BatchSolver<T>::SetOptions(const typename Solver<T>::Options& opts) 
+{
+  opts_ = opts;
+}
+
+template<typename T>
+void BatchSolver<T>::SetStoppingCallback(const typename Solver<T>::StoppingCallback& cb) 
+{
+  stopping_cb_ = cb;
+}
+
+template<typename T>
+void BatchSolver<T>::SetIntermCallback(const typename Solver<T>::IntermCallback& cb) 
+{
+  interm_cb_ = cb;
+}
+
+template<typename T>
+bool BatchSolver<T>::BuildStrided(const typename BatchSolver<T>::InstanceBuilder& builder)
+{
+  const size_t N = num_instances_;
+  const size_t kIndexMax = static_cast<size_t>(std::numeric_limits<int32_t>::max());
+
+  // a custom scaling is given for the stacked layout
+  if(problem_->scaling_type() == Problem<T>::Scaling::kScalingCustom)
+    return false;
+
+  if(N * nrows_ > kIndexMax || N * ncols_ > kIndexMax)
+    return false;
+
+  vector<shared_ptr<Problem<T>>> instances(N);
+  for(size_t i = 0; i < N; i++)
+  {
+    instances[i] = shared_ptr<Problem<T>>(new Problem<T>());
+    builder(i, 0, 0, *instances[i]);
+  }
+
+  // prox_f, prox_fstar, prox_g, prox_gstar of each instance
+  auto lists = [](const Problem<T>& p) {
+    return vector<const ProxList *>({ &p.prox_f(), &p.prox_fstar(), &p.prox_g(), &p.prox_gstar() });
+  };
+
+  vector<vector<ProxList>> sorted(N);
+  for(size_t i = 0; i < N; i++)
+  {
+    for(const ProxList *list : lists(*instances[i]))
+    {
+      sorted[i].push_back(SortedByIndex<T>(*list));
+
+      if(!SameLayout<T>(sorted[i].back(), sorted[0][sorted[i].size() - 1]))
+        return false;
+    }
+  }
+
+  // the rows and columns are split where the proxs of f and g begin
+  vector<Slot> row_slots, col_slots;
+  if(!ProxSlots<T>(sorted[0][0].empty() ? sorted[0][1] : sorted[0][0], nrows_, row_slots) ||
+     !ProxSlots<T>(sorted[0][2].empty() ? sorted[0][3] : sorted[0][2], ncols_, col_slots))
+    return false;
+
+  vector<size_t> row_index, col_index;
+  SlotIndex(row_slots, N, nrows_, row_index);
+  SlotIndex(col_slots, N, ncols_, col_index);
+
+  // the entries of all blocks of all instances
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+  for(size_t i = 0; i < N; i++)
+  {
+    const size_t first = vals.size();
+
+    for(auto& block : instances[i]->linop()->blocks())
+    {
+      if(block->row() + block->nrows() > nrows_ || block->col() + block->ncols() > ncols_)
+        throw Exception("BatchSolver: block exceeds the size of an instance.");
+
+      if(!block->AppendTriplets(rows, cols, vals))
+        return false;
+    }
+
+    if(vals.size() > kIndexMax)
+      return false;
+
+    for(size_t k = first; k < vals.size(); k++)
+    {
+      rows[k] = static_cast<int32_t>(row_index[i * nrows_ + rows[k]]);
+      cols[k] = static_cast<int32_t>(col_index[i * ncols_ + cols[k]]);
+    }
+  }
+
+  if(!vals.empty())
+  {
+    problem_->AddBlock(shared_ptr<Block<T>>(
+      BlockSparse<T>::CreateFromTriplets(
+        0, 0, static_cast<int>(N * nrows_), static_cast<int>(N * ncols_), rows, cols, vals)));
+  }
+
+  // move the copies of each prox next to each other and evaluate them by
+  // one batched prox where possible
+  for(size_t l = 0; l < sorted[0].size(); l++)
+  {
+    const bool by_rows = (l < 2);
+    const vector<size_t>& index = by_rows ? row_index : col_index;
+    const size_t count = by_rows ? nrows_ : ncols_;
+
+    for(size_t k = 0; k < sorted[0][l].size(); k++)
+    {
+      ProxList run(N);
+      for(size_t i = 0; i < N; i++)
+      {
+        run[i] = sorted[i][l][k];
+        run[i]->set_index(index[i * count + run[i]->index()]);
+      }
+
+      shared_ptr<Prox<T>> batch;
+      if(N > 1 && run[0]->batchable())
+        batch = shared_ptr<Prox<T>>(run[0]->CreateBatch(run));
+
+      ProxList added = batch ? ProxList(1, batch) : run;
+      for(auto& prox : added)
+      {
+        switch(l)
+        {
+          case 0: problem_->AddProx_f(prox); break;
+          case 1: problem_->AddProx_fstar(prox); break;
+          case 2: problem_->AddProx_g(prox); break;
+          case 3: problem_->AddProx_gstar(prox); break;
+        }
+      }
+    }
+  }
+
+  row_index_.swap(row_index);
+  col_index_.swap(col_index);
+  return true;
+}
+
+template<typename T>
+void BatchSolver<T>::BuildStacked(const typename BatchSolver<T>::InstanceBuilder& builder)
+{
+  // instance i occupies rows [i * nrows, (i + 1) * nrows) and columns
+  // [i * ncols, (i + 1) * ncols) of the block-diagonal operator
+  for(size_t i = 0; i < num_instances_; i++)
+    builder(i, i * nrows_, i * ncols_, *problem_);
+
+  row_index_.resize(num_instances_ * nrows_);
+  col_index_.resize(num_instances_ * ncols_);
+
+  for(size_t k = 0; k < row_index_.size(); k++)
+    row_index_[k] = k;
+
+  for(size_t k = 0; k < col_index_.size(); k++)
+    col_index_[k] = k;
+}
+
+template<typename T>
+void BatchSolver<T>::Initialize(const typename BatchSolver<T>::InstanceBuilder& builder) 
+{
+  // the residuals are evaluated on the operator of problem()
+  if(opts_.presolve || opts_.solve_dual_problem)
+    throw Exception("BatchSolver: presolve and solve_dual_problem are not supported.");
+
+  const size_t N = num_instances_;
+
+  strided_ = BuildStrided(builder);
+  if(!strided_)
+    BuildStacked(builder);
+
+  problem_->SetDimensions(N * nrows_, N * ncols_);
+
+  d_row_index_ = row_index_;
+  d_col_index_ = col_index_;
+
+  // the initial solutions are given instance after instance. the final
+  // iterate of the unconverged instances is read from cur_primal_sol().
+  typename Solver<T>::Options opts = opts_;
+  opts.host_solution = true;
+  if(opts.x0.size() == N * ncols_)
+    for(size_t k = 0; k < col_index_.size(); k++)
+      opts.x0[col_index_[k]] = opts_.x0[k];
+
+  if(opts.y0.size() == N * nrows_)
+    for(size_t k = 0; k < row_index_.size(); k++)
+      opts.y0[row_index_[k]] = opts_.y0[k];
+
+  d_mask_.assign(N, 0);
+  d_residuals_.resize(4 * N);
+  d_frozen_x_.resize(N * ncols_);
+  d_frozen_y_.resize(N * nrows_);
+  d_x_.resize(N * ncols_);
+  d_w_.resize(N * ncols_);
+  d_kty_.resize(N * ncols_);
+  d_y_.resize(N * nrows_);
+  d_z_.resize(N * nrows_);
+  d_kx_.resize(N * nrows_);
+
+  converged_.assign(N, false);
+  primal_residual_.assign(N, std::numeric_limits<T>::infinity());
+  dual_residual_.assign(N, std::numeric_limits<T>::infinity());
+
+  solver_ = shared_ptr<Solver<T>>(new Solver<T>(problem_, backend_));
+  solver_->SetOptions(opts);
+  solver_->SetStoppingCallback(stopping_cb_);
+  solver_->SetIntermCallback(interm_cb_);
+  solver_->SetReductionCallback(
+    [this](const typename Solver<T>::DeviceSolution& sol, T *values) { CheckInstances(sol, values); },
+    3 * N,
+    [this](int iter, const vector<T>& values) { return ReadInstances(values); });
+  solver_->Initialize();
+}
+
+template<typename T>
+void BatchSolver<T>::CheckInstances(const typename Solver<T>::DeviceSolution& sol, T *d_values)
+{
+  const size_t N = num_instances_;
+  const size_t m = N * nrows_;
+  const size_t n = N * ncols_;
+  cudaStream_t stream = sol.stream;
+
+  // the operator reads device vectors
+  if(sol.x != thrust::raw_pointer_cast(d_x_.data()))
+    cudaMemcpyAsync(thrust::raw_pointer_cast(d_x_.data()), sol.x, n * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  if(sol.y != thrust::raw_pointer_cast(d_y_.data()))
+    cudaMemcpyAsync(thrust::raw_pointer_cast(d_y_.data()), sol.y, m * sizeof(T), cudaMemcpyDeviceToDevice, stream);
+
+  problem_->linop()->Eval(d_kx_, d_x_, static_cast<T>(0), stream);
+  problem_->linop()->EvalAdjoint(d_kty_, d_y_, static_cast<T>(0), stream);
+
+  // |K x - z|^2 and |z|^2, gathered instance after instance
+  thrust::reduce_by_key(
+    thrust::cuda::par.on(stream),
+    thrust::make_transform_iterator(thrust::counting_iterator<size_t>(0), batch_instance_of(nrows_)),
+    thrust::make_transform_iterator(thrust::counting_iterator<size_t>(m), batch_instance_of(nrows_)),
+    thrust::make_transform_iterator(
+      thrust::make_zip_iterator(thrust::make_tuple(
+        thrust::make_permutation_iterator(d_kx_.begin(), d_row_index_.begin()),
+        thrust::make_permutation_iterator(thrust::device_pointer_cast(sol.z), d_row_index_.begin()))),
+      batch_residual_terms<T>(-1)),
+    thrust::make_discard_iterator(),
+    thrust::make_zip_iterator(thrust::make_tuple(d_residuals_.begin(), d_residuals_.begin() + N)),
+    thrust::equal_to<size_t>(),
+    batch_tuple_plus<T>());
+
+  // |K^T y + w|^2 and |w|^2
+  thrust::reduce_by_key(
+    thrust::cuda::par.on(stream),
+    thrust::make_transform_iterator(thrust::counting_iterator<size_t>(0), batch_instance_of(ncols_)),
+    thrust::make_transform_iterator(thrust::counting_iterator<size_t>(n), batch_instance_of(ncols_)),
+    thrust::make_transform_iterator(
+      thrust::make_zip_iterator(thrust::make_tuple(
+        thrust::make_permutation_iterator(d_kty_.begin(), d_col_index_.begin()),
+        thrust::make_permutation_iterator(thrust::device_pointer_cast(sol.w), d_col_index_.begin()))),
+      batch_residual_terms<T>(1)),
+    thrust::make_discard_iterator(),
+    thrust::make_zip_iterator(thrust::make_tuple(d_residuals_.begin() + 2 * N, d_residuals_.begin() + 3 * N)),
+    thrust::equal_to<size_t>(),
+    batch_tuple_plus<T>());
+
+  // the tolerances of Backend::eps_primal() and eps_dual() per instance
+  BatchCheckInstancesKernel<T>
+    <<<(N + kBlockSizeCUDA - 1) / kBlockSizeCUDA, kBlockSizeCUDA, 0, stream>>>(
+      d_values,
+      thrust::raw_pointer_cast(d_mask_.data()),
+      thrust::raw_pointer_cast(d_residuals_.data()),
+      N,
+      std::sqrt(static_cast<T>(nrows_)) * opts_.tol_abs_primal,
+      opts_.tol_rel_primal,
+      std::sqrt(static_cast<T>(ncols_)) * opts_.tol_abs_dual,
+      opts_.tol_rel_dual);
+
+  thrust::for_each(
+    thrust::cuda::par.on(stream),
+    thrust::counting_iterator<size_t>(0),
+    thrust::counting_iterator<size_t>(n),
+    batch_freeze<T>(thrust::raw_pointer_cast(d_mask_.data()),
+                    thrust::raw_pointer_cast(d_col_index_.data()),
+                    thrust::raw_pointer_cast(d_x_.data()),
+                    thrust::raw_pointer_cast(d_frozen_x_.data()),
+                    ncols_));
+
+  thrust::for_each(
+    thrust::cuda::par.on(stream),
+    thrust::counting_iterator<size_t>(0),
+    thrust::counting_iterator<size_t>(m),
+    batch_freeze<T>(thrust::raw_pointer_cast(d_mask_.data()),
+                    thrust::raw_pointer_cast(d_row_index_.data()),
+                    thrust::raw_pointer_cast(d_y_.data()),
+                    thrust::raw_pointer_cast(d_frozen_y_.data()),
+                    nrows_));
+
+  thrust::replace(thrust::cuda::par.on(stream), d_mask_.begin(), d_mask_.end(), 2, 1);
+}
+
+template<typename T>
+bool BatchSolver<T>::ReadInstances(const vector<T>& values)
+{
+  const size_t N = num_instances_;
+
+  for(size_t i = 0; i < N; i++)
+  {
+    primal_residual_[i] = values[i];
+    dual_residual_[i] = values[N + i];
+    converged_[i] = (values[2 * N + i] != 0);
+  }
+
+  return num_converged() == N;
+}
+
+template<typename T>
+typename Solver<T>::ConvergenceResult BatchSolver<T>::Solve() 
+{
+  if(!solver_)
+    throw Exception("BatchSolver: Initialize() has to be called before Solve().");
+
+  const size_t N = num_instances_;
+
+  thrust::fill(d_mask_.begin(), d_mask_.end(), 0);
+  converged_.assign(N, false);
+
+  typename Solver<T>::ConvergenceResult result = solver_->Solve();
+
+  // check the final iterate, the callbacks may not have seen it
+  if(solver_->device_solution())
+  {
+    solver_->CopySolutionDevice(
+      thrust::raw_pointer_cast(d_x_.data()),
+      thrust::raw_pointer_cast(d_z_.data()),
+      thrust::raw_pointer_cast(d_y_.data()),
+      thrust::raw_pointer_cast(d_w_.data()));
+  }
+  else
+  {
+    thrust::copy(solver_->cur_primal_sol().begin(), solver_->cur_primal_sol().end(), d_x_.begin());
+    thrust::copy(solver_->cur_primal_constr_sol().begin(), solver_->cur_primal_constr_sol().end(), d_z_.begin());
+    thrust::copy(solver_->cur_dual_sol().begin(), solver_->cur_dual_sol().end(), d_y_.begin());
+    thrust::copy(solver_->cur_dual_constr_sol().begin(), solver_->cur_dual_constr_sol().end(), d_w_.begin());
+  }
+
+  typename Solver<T>::DeviceSolution sol;
+  sol.x = thrust::raw_pointer_cast(d_x_.data());
+  sol.z = thrust::raw_pointer_cast(d_z_.data());
+  sol.y = thrust::raw_pointer_cast(d_y_.data());
+  sol.w = thrust::raw_pointer_cast(d_w_.data());
+  sol.ncols = d_x_.size();
+  sol.nrows = d_y_.size();
+  sol.stream = 0;
+
+  thrust::device_vector<T> d_values(3 * N);
+  CheckInstances(sol, thrust::raw_pointer_cast(d_values.data()));
+
+  vector<T> values(3 * N);
+  thrust::copy(d_values.begin(), d_values.end(), values.begin());
+  ReadInstances(values);
+
+  return result;
+}
+
+template<typename T>
+void BatchSolver<T>::Release() 
+{
+  if(solver_)
+    solver_->Release();
+}
+
+template<typename T>
+size_t BatchSolver<T>::num_converged() const
+{
+  return std::count(converged_.begin(), converged_.end(), true);
+}
+
+template<typename T>
+void BatchSolver<T>::instance_primal_sol(size_t instance, vector<T>& x) const
+{
+  if(instance >= num_instances_)
+    throw Exception("BatchSolver: instance index out of range.");
+
+  x.resize(ncols_);
+
+  if(converged_[instance])
+  {
+    thrust::copy(d_frozen_x_.begin() + instance * ncols_, 
+                 d_frozen_x_.begin() + (instance + 1) * ncols_, 
+                 x.begin());
+    return;
+  }
+
+  const vector<T>& sol = solver_->cur_primal_sol();
+  for(size_t j = 0; j < ncols_; j++)
+    x[j] = sol[col_index_[instance * ncols_ + j]];
+}
+
+template<typename T>
+void BatchSolver<T>::instance_dual_sol(size_t instance, vector<T>& y) const
+{
+  if(instance >= num_instances_)
+    throw Exception("BatchSolver: instance index out of range.");
+
+  y.resize(nrows_);
+
+  if(converged_[instance])
+  {
+    thrust::copy(d_frozen_y_.begin() + instance * nrows_, 
+                 d_frozen_y_.begin() + (instance + 1) * nrows_, 
+                 y.begin());
+    return;
+  }
+
+  const vector<T>& sol = solver_->cur_dual_sol();
+  for(size_t i = 0; i < nrows_; i++)
+    y[i] = sol[row_index_[instance * nrows_ + i]];
+}
+
+// Explicit template instantiation
+template class BatchSolver<float>;
+template class BatchSolver<double>;
+
+} // namespace prost
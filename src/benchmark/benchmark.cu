@@ -0,0 +1,793 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+///
+/// \brief Native benchmark of the linear operator blocks, the elementwise
+///        proximal operators and full PDHG/ADMM iterations.
+///
+/// Usage: prost_benchmark [--double] [--repeats N] [--sizes n1,n2,...]
+///                        [--filter substring] [--baseline file]
+///                        [--save file] [--tolerance t]
+///
+/// Kernels are timed with CUDA events on a dedicated stream, after a warm-up
+/// and without any allocation inside the timed region. Blocks and proxes are
+/// reported in GB/s (estimated from the bytes they have to touch), backends
+/// in iterations per second. With --baseline, every result which is slower
+/// than the stored one by more than the tolerance is reported as regression
+/// and the program exits with a non-zero status.
+///
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <thrust/device_vector.h>
+
+#include "prost/linop/block.hpp"
+#include "prost/linop/block_dense.hpp"
+#include "prost/linop/block_dense_kron_id.hpp"
+#include "prost/linop/block_diags.hpp"
+#include "prost/linop/block_gradient2d.hpp"
+#include "prost/linop/block_gradient3d.hpp"
+#include "prost/linop/block_id_kron_dense.hpp"
+#include "prost/linop/block_id_kron_sparse.hpp"
+#include "prost/linop/block_sparse.hpp"
+#include "prost/linop/block_sparse_half.hpp"
+#include "prost/linop/block_sparse_kron_id.hpp"
+#include "prost/linop/block_zero.hpp"
+
+#include "prost/prox/prox.hpp"
+#include "prost/prox/prox_elem_operation.hpp"
+#include "prost/prox/prox_elem_operation_jit.hpp"
+#include "prost/prox/prox_ind_soc.hpp"
+#include "prost/prox/elemop/elem_operation_1d.hpp"
+#include "prost/prox/elemop/elem_operation_norm2.hpp"
+#include "prost/prox/elemop/elem_operation_ind_simplex.hpp"
+#include "prost/prox/elemop/elem_operation_ind_sum.hpp"
+#include "prost/prox/elemop/elem_operation_singular_nx2.hpp"
+#include "prost/prox/elemop/elem_operation_ind_psd_cone_3x3.hpp"
+#include "prost/prox/elemop/elem_operation_mass_norm.hpp"
+#include "prost/prox/elemop/function_1d.hpp"
+#include "prost/prox/elemop/function_2d.hpp"
+
+#include "prost/backend/backend_admm.hpp"
+#include "prost/backend/backend_pdhg.hpp"
+
+#include "prost/common.hpp"
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+#include "prost/solver.hpp"
+
+namespace prost {
+namespace benchmark {
+
+using thrust::device_vector;
+
+struct Settings
+{
+  int warmup;
+  int repeats;
+  std::vector<size_t> sizes;
+  std::string filter;
+  std::string baseline;
+  std::string save;
+  double tolerance;
+};
+
+struct Measurement
+{
+  std::string name;
+  size_t size;
+  double ms;
+  double value;
+  std::string unit;
+};
+
+///
+/// \brief Measures GPU time between two points on a stream.
+///
+class Timer
+{
+public:
+  Timer() 
+  {
+    cudaEventCreate(&start_);
+    cudaEventCreate(&stop_);
+  }
+
+  ~Timer()
+  {
+    cudaEventDestroy(start_);
+    cudaEventDestroy(stop_);
+  }
+
+  void Start(cudaStream_t stream) { cudaEventRecord(start_, stream); }
+
+  /// \brief Returns the elapsed time in milliseconds.
+  double Stop(cudaStream_t stream)
+  {
+    float ms = 0;
+    cudaEventRecord(stop_, stream);
+    cudaEventSynchronize(stop_);
+    cudaEventElapsedTime(&ms, start_, stop_);
+    return ms;
+  }
+
+private:
+  cudaEvent_t start_;
+  cudaEvent_t stop_;
+};
+
+/// \brief Returns the mean time of one call of fn in milliseconds.
+template<class FN>
+double TimeMean(FN fn, const Settings& settings, cudaStream_t stream)
+{
+  for(int i = 0; i < settings.warmup; i++)
+    fn();
+
+  Timer timer;
+  timer.Start(stream);
+  for(int i = 0; i < settings.repeats; i++)
+    fn();
+
+  return timer.Stop(stream) / settings.repeats;
+}
+
+bool Selected(const Settings& settings, const std::string& name)
+{
+  return settings.filter.empty() || name.find(settings.filter) != std::string::npos;
+}
+
+void Report(std::vector<Measurement>& results, const Measurement& m)
+{
+  std::cout << std::left << std::setw(52) << m.name 
+            << std::right << std::setw(10) << m.size
+            << std::setw(12) << std::fixed << std::setprecision(4) << m.ms << " ms"
+            << std::setw(12) << std::setprecision(2) << m.value << " " << m.unit 
+            << std::endl;
+
+  results.push_back(m);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Blocks
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief Random m x n CSC matrix with nnz_col sorted entries per column.
+template<typename T>
+void RandomCSC(int m, int n, int nnz_col, std::mt19937& rng, 
+               vector<T>& val, vector<int32_t>& ptr, vector<int32_t>& ind)
+{
+  std::uniform_int_distribution<int> row_dist(0, m - 1);
+  std::uniform_real_distribution<T> val_dist(-1, 1);
+
+  ptr.assign(1, 0);
+  ind.clear();
+  val.clear();
+
+  for(int j = 0; j < n; j++)
+  {
+    std::vector<int32_t> rows;
+    for(int k = 0; k < nnz_col; k++)
+      rows.push_back(row_dist(rng));
+
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+    for(int32_t r : rows)
+    {
+      ind.push_back(r);
+      val.push_back(val_dist(rng));
+    }
+
+    ptr.push_back(static_cast<int32_t>(ind.size()));
+  }
+}
+
+template<typename T>
+std::vector<T> RandomVector(size_t n, std::mt19937& rng)
+{
+  std::uniform_real_distribution<T> dist(-1, 1);
+  std::vector<T> v(n);
+  for(T& x : v)
+    x = dist(rng);
+  return v;
+}
+
+/// \brief All block types with roughly n columns.
+template<typename T>
+std::vector<std::pair<std::string, shared_ptr<Block<T> > > >
+CreateBlocks(size_t n, std::mt19937& rng)
+{
+  std::vector<std::pair<std::string, shared_ptr<Block<T> > > > blocks;
+  auto add = [&](const std::string& name, Block<T> *block) {
+    blocks.push_back(std::make_pair(name, shared_ptr<Block<T> >(block)));
+  };
+
+  add("block_zero", new BlockZero<T>(0, 0, n, n));
+
+  add("block_diags_3", new BlockDiags<T>(0, 0, n, n, 3, 
+    std::vector<ssize_t>{ -1, 0, 1 }, std::vector<T>{ -1, 2, -1 }));
+
+  // L = 4 labels, pixel-first and label-first
+  const size_t L = 4;
+  const size_t nx2 = std::max<size_t>(std::sqrt(n / L), 2);
+  add("block_gradient2d", new BlockGradient2D<T>(0, 0, nx2, nx2, L, false));
+  add("block_gradient2d_label_first", new BlockGradient2D<T>(0, 0, nx2, nx2, L, true));
+
+  const size_t nx3 = std::max<size_t>(std::cbrt(n / L), 2);
+  add("block_gradient3d", new BlockGradient3D<T>(0, 0, nx3, nx3, L, false));
+  add("block_gradient3d_label_first", new BlockGradient3D<T>(0, 0, nx3, nx3, L, true));
+
+  // tall dense matrix with 64 columns
+  const size_t dense_cols = 64;
+  const size_t dense_rows = std::max<size_t>(n / dense_cols, 1);
+  add("block_dense", BlockDense<T>::CreateFromColFirstData(0, 0, dense_rows, dense_cols,
+    RandomVector<T>(dense_rows * dense_cols, rng)));
+
+  // small 8x8 dense factor times identity
+  const size_t kron = 8;
+  const size_t diaglength = std::max<size_t>(n / kron, 1);
+  add("block_dense_kron_id", BlockDenseKronId<T>::CreateFromColFirstData(
+    diaglength, 0, 0, kron, kron, RandomVector<T>(kron * kron, rng)));
+  add("block_id_kron_dense", BlockIdKronDense<T>::CreateFromColFirstData(
+    diaglength, 0, 0, kron, kron, RandomVector<T>(kron * kron, rng)));
+
+  vector<T> val;
+  vector<int32_t> ptr, ind;
+  
+  RandomCSC<T>(n, n, 5, rng, val, ptr, ind);
+  add("block_sparse", BlockSparse<T>::CreateFromCSC(0, 0, n, n, val.size(), val, ptr, ind, false));
+  add("block_sparse_transpose_spmv", BlockSparse<T>::CreateFromCSC(0, 0, n, n, val.size(), val, ptr, ind, true));
+  add("block_sparse_half", BlockSparseHalf<T>::CreateFromCSC(0, 0, n, n, val.size(), val, ptr, ind));
+
+  const int sparse_kron = 16;
+  const size_t sparse_diaglength = std::max<size_t>(n / sparse_kron, 1);
+  RandomCSC<T>(sparse_kron, sparse_kron, 3, rng, val, ptr, ind);
+  add("block_id_kron_sparse", BlockIdKronSparse<T>::CreateFromCSC(
+    0, 0, sparse_diaglength, sparse_kron, sparse_kron, val.size(), val, ptr, ind));
+  add("block_sparse_kron_id", BlockSparseKronId<T>::CreateFromCSC(
+    0, 0, sparse_diaglength, sparse_kron, sparse_kron, val.size(), val, ptr, ind));
+
+  return blocks;
+}
+
+template<typename T>
+void BenchmarkBlocks(const Settings& settings, cudaStream_t stream, std::vector<Measurement>& results)
+{
+  std::mt19937 rng(42);
+
+  for(size_t n : settings.sizes)
+  {
+    for(auto& named : CreateBlocks<T>(n, rng))
+    {
+      const std::string& name = named.first;
+      Block<T>& block = *named.second;
+
+      if(!Selected(settings, name))
+        continue;
+
+      block.Initialize();
+
+      device_vector<T> x(block.ncols(), 1);
+      device_vector<T> y(block.nrows(), 1);
+
+      // operator data, right hand side and read-modify-write of the result
+      const double bytes_fwd = block.gpu_mem_amount() + 
+        sizeof(T) * (block.ncols() + 2.0 * block.nrows());
+      const double bytes_adj = block.gpu_mem_amount() + 
+        sizeof(T) * (block.nrows() + 2.0 * block.ncols());
+
+      double ms = TimeMean([&]() { block.EvalAdd(y, x, stream); }, settings, stream);
+      Report(results, { name, n, ms, bytes_fwd / (ms * 1e6), "GB/s" });
+
+      ms = TimeMean([&]() { block.EvalAdjointAdd(x, y, stream); }, settings, stream);
+      Report(results, { name + "_adjoint", n, ms, bytes_adj / (ms * 1e6), "GB/s" });
+
+      block.Release();
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Proxes
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief Coefficients (a, b, c, d, e, alpha, beta) of the 1D functions. 
+template<typename T, size_t COUNT>
+std::array<std::vector<T>, COUNT> Coefficients(const std::vector<T>& values)
+{
+  std::array<std::vector<T>, COUNT> coeffs;
+  for(size_t i = 0; i < COUNT; i++)
+    coeffs[i].assign(1, i < values.size() ? values[i] : 1);
+  return coeffs;
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount == 0, Prox<T> *>::type
+CreateElemProx(size_t count, size_t dim, const std::vector<T>& values)
+{
+  return new ProxElemOperation<T, ELEM_OPERATION>(0, count, dim, false, true);
+}
+
+template<typename T, class ELEM_OPERATION>
+typename std::enable_if<ELEM_OPERATION::kCoeffsCount != 0, Prox<T> *>::type
+CreateElemProx(size_t count, size_t dim, const std::vector<T>& values)
+{
+  return new ProxElemOperation<T, ELEM_OPERATION>(0, count, dim, false, true,
+    Coefficients<T, ELEM_OPERATION::kCoeffsCount>(values));
+}
+
+/// \brief All instantiations of ProxElemOperation on roughly n variables.
+template<typename T>
+std::vector<std::pair<std::string, shared_ptr<Prox<T> > > >
+CreateProxes(size_t n)
+{
+  std::vector<std::pair<std::string, shared_ptr<Prox<T> > > > proxes;
+
+  // f(x) = c * fun(a x - b) with alpha = beta = 1
+  const std::vector<T> coeffs{ 1, 0, 1, 0, 0, 1, 1 };
+
+  auto add = [&](const std::string& name, size_t dim, Prox<T> *prox) {
+    proxes.push_back(std::make_pair(name + "_dim" + std::to_string(dim), shared_ptr<Prox<T> >(prox)));
+  };
+
+#define PROST_BENCHMARK_FUN_1D(NAME, FUN)                                        \
+  add("elem_1d_" NAME, 1, CreateElemProx<T, ElemOperation1D<T, FUN<T> > >(n, 1, coeffs));        \
+  add("elem_norm2_" NAME, 3, CreateElemProx<T, ElemOperationNorm2<T, FUN<T> > >(n / 3, 3, coeffs));
+
+  PROST_BENCHMARK_FUN_1D("zero", Function1DZero)
+  PROST_BENCHMARK_FUN_1D("abs", Function1DAbs)
+  PROST_BENCHMARK_FUN_1D("square", Function1DSquare)
+  PROST_BENCHMARK_FUN_1D("ind_leq0", Function1DIndLeq0)
+  PROST_BENCHMARK_FUN_1D("ind_geq0", Function1DIndGeq0)
+  PROST_BENCHMARK_FUN_1D("ind_eq0", Function1DIndEq0)
+  PROST_BENCHMARK_FUN_1D("ind_box01", Function1DIndBox01)
+  PROST_BENCHMARK_FUN_1D("max_pos0", Function1DMaxPos0)
+  PROST_BENCHMARK_FUN_1D("l0", Function1DL0)
+  PROST_BENCHMARK_FUN_1D("huber", Function1DHuber)
+  PROST_BENCHMARK_FUN_1D("lq", Function1DLq)
+  PROST_BENCHMARK_FUN_1D("lq_plus_eps", Function1DLqPlusEps)
+  PROST_BENCHMARK_FUN_1D("trunc_quad", Function1DTruncQuad)
+  PROST_BENCHMARK_FUN_1D("trunc_linear", Function1DTruncLinear)
+#undef PROST_BENCHMARK_FUN_1D
+
+#define PROST_BENCHMARK_SINGULAR_NX2(NAME, FUN)                                  \
+  add("elem_singular_nx2_" NAME, 4,                                              \
+      CreateElemProx<T, ElemOperationSingularNx2<T, Function2DSum1D<T, FUN<T> > > >(n / 4, 4, coeffs));
+
+  PROST_BENCHMARK_SINGULAR_NX2("zero", Function1DZero)
+  PROST_BENCHMARK_SINGULAR_NX2("abs", Function1DAbs)
+  PROST_BENCHMARK_SINGULAR_NX2("square", Function1DSquare)
+  PROST_BENCHMARK_SINGULAR_NX2("ind_leq0", Function1DIndLeq0)
+  PROST_BENCHMARK_SINGULAR_NX2("ind_geq0", Function1DIndGeq0)
+  PROST_BENCHMARK_SINGULAR_NX2("ind_eq0", Function1DIndEq0)
+  PROST_BENCHMARK_SINGULAR_NX2("ind_box01", Function1DIndBox01)
+  PROST_BENCHMARK_SINGULAR_NX2("max_pos0", Function1DMaxPos0)
+  PROST_BENCHMARK_SINGULAR_NX2("l0", Function1DL0)
+  PROST_BENCHMARK_SINGULAR_NX2("huber", Function1DHuber)
+#undef PROST_BENCHMARK_SINGULAR_NX2
+
+  add("elem_singular_nx2_ind_l1_ball", 4, 
+      CreateElemProx<T, ElemOperationSingularNx2<T, Function2DIndL1Ball<T> > >(n / 4, 4, coeffs));
+  add("elem_singular_nx2_moreau_ind_l1_ball", 4, 
+      CreateElemProx<T, ElemOperationSingularNx2<T, Function2DMoreau<T, Function2DIndL1Ball<T> > > >(n / 4, 4, coeffs));
+
+  add("elem_ind_simplex", 8, CreateElemProx<T, ElemOperationIndSimplex<T> >(n / 8, 8, coeffs));
+  add("elem_ind_sum", 8, CreateElemProx<T, ElemOperationIndSum<T> >(n / 8, 8, coeffs));
+#ifdef PROST_WITH_NVRTC
+  // same as elem_norm2_abs, with the coefficients folded into the kernel
+  std::vector<std::vector<T> > jit_coeffs;
+  for(T c : coeffs)
+    jit_coeffs.push_back(std::vector<T>(1, c));
+
+  add("elem_jit_norm2_abs", 3, new ProxElemOperationJIT<T>(0, n / 3, 3, false, true,
+    "ElemOperationNorm2<T, Function1DAbs<T> >", jit_coeffs));
+#endif
+
+  add("elem_ind_simplex_256", 256, CreateElemProx<T, ElemOperationIndSimplex<T> >(n / 256, 256, coeffs));
+  add("elem_ind_sum_256", 256, CreateElemProx<T, ElemOperationIndSum<T> >(n / 256, 256, coeffs));
+  add("elem_ind_psd_cone_3x3", 9, CreateElemProx<T, ElemOperationIndPsdCone3x3<T> >(n / 9, 9, coeffs));
+  add("elem_mass4", 6, CreateElemProx<T, ElemOperationMass4<T, false> >(n / 6, 6, coeffs));
+  add("elem_mass4_conjugate", 6, CreateElemProx<T, ElemOperationMass4<T, true> >(n / 6, 6, coeffs));
+  add("elem_mass5", 10, CreateElemProx<T, ElemOperationMass5<T, false> >(n / 10, 10, coeffs));
+  add("elem_mass5_conjugate", 10, CreateElemProx<T, ElemOperationMass5<T, true> >(n / 10, 10, coeffs));
+
+  // one thread, one warp and one block per cone
+  for(size_t d : { 3, 64, 4096 })
+    add("ind_soc", d, new ProxIndSOC<T>(0, n / d, d, false, false, 1));
+
+  return proxes;
+}
+
+template<typename T>
+void BenchmarkProxes(const Settings& settings, cudaStream_t stream, std::vector<Measurement>& results)
+{
+  std::mt19937 rng(7);
+
+  for(size_t n : settings.sizes)
+  {
+    for(auto& named : CreateProxes<T>(n))
+    {
+      const std::string& name = named.first;
+      Prox<T>& prox = *named.second;
+
+      if(!Selected(settings, name))
+        continue;
+
+      prox.Initialize();
+
+      std::vector<T> h_arg = RandomVector<T>(prox.size(), rng);
+      device_vector<T> arg(h_arg.begin(), h_arg.end());
+      device_vector<T> tau_diag(prox.size(), 1);
+      device_vector<T> result(prox.size());
+
+      // read argument and step sizes, write result
+      const double bytes = prox.gpu_mem_amount() + 3.0 * sizeof(T) * prox.size();
+
+      double ms = TimeMean([&]() { prox.Eval(result, arg, tau_diag, 1, false, stream); }, 
+                           settings, stream);
+      Report(results, { name, n, ms, bytes / (ms * 1e6), "GB/s" });
+
+      prox.Release();
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Backends
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief Vectorial ROF denoising with L = 3 channels on roughly n pixels.
+template<typename T>
+shared_ptr<Problem<T> > CreateROF(size_t n, std::mt19937& rng)
+{
+  const size_t L = 3;
+  const size_t nx = std::max<size_t>(std::sqrt(n / L), 2);
+  const size_t N = nx * nx * L;
+
+  shared_ptr<Problem<T> > problem(new Problem<T>());
+  problem->AddBlock(shared_ptr<Block<T> >(new BlockGradient2D<T>(0, 0, nx, nx, L, false)));
+
+  // g(x) = 1/2 |x - f|^2 
+  std::array<std::vector<T>, 7> data_coeffs = Coefficients<T, 7>({ 1, 0, 1, 0, 0, 1, 1 });
+  data_coeffs[1] = RandomVector<T>(N, rng);
+  problem->AddProx_g(shared_ptr<Prox<T> >(
+    new ProxElemOperation<T, ElemOperation1D<T, Function1DSquare<T> > >(0, N, 1, false, true, data_coeffs)));
+
+  // f^*(y) = indicator of |y_i| <= 1 on the 2L-dimensional gradients
+  problem->AddProx_fstar(shared_ptr<Prox<T> >(
+    CreateElemProx<T, ElemOperationNorm2<T, Function1DIndLeq0<T> > >(nx * nx, 2 * L, { 1, 1, 1, 0, 0, 1, 1 })));
+
+  problem->SetDimensions(2 * N, N);
+  problem->SetScalingIdentity();
+  problem->Initialize();
+
+  return problem;
+}
+
+template<typename T>
+void BenchmarkBackend(const std::string& name, size_t n, shared_ptr<Backend<T> > backend, 
+                      shared_ptr<Problem<T> > problem, const Settings& settings, 
+                      cudaStream_t stream, std::vector<Measurement>& results)
+{
+  typename Solver<T>::Options solver_opts = typename Solver<T>::Options();
+  solver_opts.max_iters = settings.warmup + settings.repeats;
+
+  backend->SetProblem(problem);
+  backend->SetOptions(solver_opts);
+  backend->Initialize();
+
+  const double ms = TimeMean([&]() { backend->PerformIteration(stream); }, settings, stream);
+  Report(results, { name, n, ms, 1000.0 / ms, "it/s" });
+
+  backend->Release();
+  problem->Release();
+}
+
+template<typename T>
+void BenchmarkBackends(const Settings& settings, cudaStream_t stream, std::vector<Measurement>& results)
+{
+  std::mt19937 rng(1);
+
+  for(size_t n : settings.sizes)
+  {
+    if(Selected(settings, "backend_pdhg"))
+    {
+      typename BackendPDHG<T>::Options opts = typename BackendPDHG<T>::Options();
+      opts.tau0 = 1;
+      opts.sigma0 = 1;
+      opts.residual_iter = 10;
+      opts.scale_steps_operator = true;
+      opts.normest_tol = 1e-6;
+      opts.arg_alpha0 = 0.5;
+      opts.arg_nu = 0.95;
+      opts.arg_delta = 1.5;
+      opts.arb_delta = 1.05;
+      opts.arb_tau = 0.8;
+      opts.restart_iter = 64;
+      opts.restart_beta_sufficient = 0.2;
+      opts.restart_beta_necessary = 0.8;
+      opts.restart_beta_artificial = 0.36;
+      opts.primal_weight_smoothing = 0.5;
+      opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualBoyd;
+      opts.fuse_prox_arg = true;
+      opts.fuse_epilogue = true;
+      opts.low_memory = false;
+      opts.persistent_kernel = false;
+
+      BenchmarkBackend<T>("backend_pdhg", n, shared_ptr<Backend<T> >(new BackendPDHG<T>(opts)),
+                          CreateROF<T>(n, rng), settings, stream, results);
+    }
+
+    if(Selected(settings, "backend_pdhg_low_memory"))
+    {
+      typename BackendPDHG<T>::Options opts = typename BackendPDHG<T>::Options();
+      opts.tau0 = 1;
+      opts.sigma0 = 1;
+      opts.residual_iter = 10;
+      opts.scale_steps_operator = true;
+      opts.normest_tol = 1e-6;
+      opts.arg_alpha0 = 0.5;
+      opts.arg_nu = 0.95;
+      opts.arg_delta = 1.5;
+      opts.arb_delta = 1.05;
+      opts.arb_tau = 0.8;
+      opts.restart_iter = 64;
+      opts.restart_beta_sufficient = 0.2;
+      opts.restart_beta_necessary = 0.8;
+      opts.restart_beta_artificial = 0.36;
+      opts.primal_weight_smoothing = 0.5;
+      opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualBoyd;
+      opts.fuse_prox_arg = true;
+      opts.fuse_epilogue = true;
+      opts.low_memory = true;
+      opts.persistent_kernel = false;
+
+      BenchmarkBackend<T>("backend_pdhg_low_memory", n, shared_ptr<Backend<T> >(new BackendPDHG<T>(opts)),
+                          CreateROF<T>(n, rng), settings, stream, results);
+    }
+
+    if(Selected(settings, "backend_admm"))
+    {
+      typename BackendADMM<T>::Options opts = typename BackendADMM<T>::Options();
+      opts.rho0 = 1;
+      opts.residual_iter = 10;
+      opts.arb_delta = 1.05;
+      opts.arb_tau = 0.8;
+      opts.arb_gamma = 1.01;
+      opts.alpha = 1.7;
+      opts.cg_max_iter = 10;
+      opts.cg_tol_pow = 1.3;
+      opts.cg_tol_min = 1e-5;
+      opts.cg_tol_max = 1e-8;
+      opts.cg_fused = false;
+      opts.cg_jacobi = false;
+      opts.cg_check_iter = 5;
+      opts.projection = BackendADMM<T>::kProjectionCGLS;
+      opts.direct_max_nnz = 20000000;
+
+      BenchmarkBackend<T>("backend_admm", n, shared_ptr<Backend<T> >(new BackendADMM<T>(opts)),
+                          CreateROF<T>(n, rng), settings, stream, results);
+    }
+
+    if(Selected(settings, "backend_admm_fused"))
+    {
+      typename BackendADMM<T>::Options opts = typename BackendADMM<T>::Options();
+      opts.rho0 = 1;
+      opts.residual_iter = 10;
+      opts.arb_delta = 1.05;
+      opts.arb_tau = 0.8;
+      opts.arb_gamma = 1.01;
+      opts.alpha = 1.7;
+      opts.cg_max_iter = 10;
+      opts.cg_tol_pow = 1.3;
+      opts.cg_tol_min = 1e-5;
+      opts.cg_tol_max = 1e-8;
+      opts.cg_fused = true;
+      opts.cg_jacobi = true;
+      opts.cg_check_iter = 5;
+      opts.projection = BackendADMM<T>::kProjectionCGLS;
+      opts.direct_max_nnz = 20000000;
+
+      BenchmarkBackend<T>("backend_admm_fused", n, shared_ptr<Backend<T> >(new BackendADMM<T>(opts)),
+                          CreateROF<T>(n, rng), settings, stream, results);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Baselines
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief Baseline file format: one "name size value" triplet per line,
+///        lines starting with '#' are ignored.
+std::map<std::pair<std::string, size_t>, double> ReadBaseline(const std::string& file)
+{
+  std::map<std::pair<std::string, size_t>, double> baseline;
+  std::ifstream in(file);
+
+  if(!in)
+  {
+    std::stringstream ss;
+    ss << "Could not open baseline file '" << file << "'.";
+    throw Exception(ss.str());
+  }
+
+  std::string line;
+  while(std::getline(in, line))
+  {
+    if(line.empty() || line[0] == '#')
+      continue;
+
+    std::istringstream is(line);
+    std::string name;
+    size_t size;
+    double value;
+
+    if(is >> name >> size >> value)
+      baseline[std::make_pair(name, size)] = value;
+  }
+
+  return baseline;
+}
+
+void WriteBaseline(const std::string& file, const std::vector<Measurement>& results)
+{
+  std::ofstream out(file);
+
+  if(!out)
+  {
+    std::stringstream ss;
+    ss << "Could not write baseline file '" << file << "'.";
+    throw Exception(ss.str());
+  }
+
+  out << "# name size value (GB/s for blocks and proxes, it/s for backends)" << std::endl;
+  for(const Measurement& m : results)
+    out << m.name << " " << m.size << " " << m.value << std::endl;
+}
+
+/// \brief Returns the number of results slower than the baseline.
+int CompareBaseline(const std::vector<Measurement>& results, 
+                    const std::map<std::pair<std::string, size_t>, double>& baseline,
+                    double tolerance)
+{
+  int regressions = 0;
+
+  for(const Measurement& m : results)
+  {
+    auto it = baseline.find(std::make_pair(m.name, m.size));
+    if(it == baseline.end())
+      continue;
+
+    if(m.value < (1 - tolerance) * it->second)
+    {
+      std::cout << "REGRESSION " << m.name << " (" << m.size << "): " 
+                << std::setprecision(2) << m.value << " " << m.unit 
+                << ", baseline " << it->second << " " << m.unit << std::endl;
+
+      regressions++;
+    }
+  }
+
+  return regressions;
+}
+
+template<typename T>
+int Run(const Settings& settings)
+{
+  cudaStream_t stream;
+  if(cudaStreamCreate(&stream) != cudaSuccess)
+    throw Exception("Failed to create the CUDA stream.");
+
+  std::vector<Measurement> results;
+  BenchmarkBlocks<T>(settings, stream, results);
+  BenchmarkProxes<T>(settings, stream, results);
+  BenchmarkBackends<T>(settings, stream, results);
+
+  cudaStreamDestroy(stream);
+
+  if(!settings.save.empty())
+    WriteBaseline(settings.save, results);
+
+  if(settings.baseline.empty())
+    return 0;
+
+  int regressions = CompareBaseline(results, ReadBaseline(settings.baseline), settings.tolerance);
+  std::cout << regressions << " regression(s) against " << settings.baseline << "." << std::endl;
+
+  return regressions > 0 ? 1 : 0;
+}
+
+std::vector<size_t> ParseSizes(const std::string& str)
+{
+  std::vector<size_t> sizes;
+  std::stringstream ss(str);
+  std::string item;
+
+  while(std::getline(ss, item, ','))
+    sizes.push_back(std::stoul(item));
+
+  return sizes;
+}
+
+} // namespace benchmark
+} // namespace prost
+
+int main(int argc, char **argv)
+{
+  using namespace prost::benchmark;
+
+  Settings settings;
+  settings.warmup = 3;
+  settings.repeats = 20;
+  settings.sizes = { 1 << 16, 1 << 20, 1 << 22 };
+  settings.tolerance = 0.1;
+  bool use_double = false;
+
+  for(int i = 1; i < argc; i++)
+  {
+    const std::string arg(argv[i]);
+    const bool has_value = (i + 1) < argc;
+
+    if(arg == "--double")
+      use_double = true;
+    else if(arg == "--repeats" && has_value)
+      settings.repeats = std::max(1, std::atoi(argv[++i]));
+    else if(arg == "--sizes" && has_value)
+      settings.sizes = ParseSizes(argv[++i]);
+    else if(arg == "--filter" && has_value)
+      settings.filter = argv[++i];
+    else if(arg == "--baseline" && has_value)
+      settings.baseline = argv[++i];
+    else if(arg == "--save" && has_value)
+      settings.save = argv[++i];
+    else if(arg == "--tolerance" && has_value)
+      settings.tolerance = std::atof(argv[++i]);
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [--double] [--repeats N] [--sizes n1,n2,...]"
+                << " [--filter substring] [--baseline file] [--save file] [--tolerance t]" 
+                << std::endl;
+      return 2;
+    }
+  }
+
+  try
+  {
+    return use_double ? Run<double>(settings) : Run<float>(settings);
+  }
+  catch(prost::Exception& e)
+  {
+    std::cerr << "Benchmark failed: " << e.what() << std::endl;
+    return 2;
+  }
+}
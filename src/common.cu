@@ -18,7 +18,16 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "prost/common.hpp"
+#include "prost/config.hpp"
 
 namespace prost {
 
@@ -29,6 +38,11 @@ string get_version() {
   return AS_STRING(PROST_VERSION);
 }
 
+uint64_t new_version_id() {
+  static std::atomic<uint64_t> next_id(1);
+  return next_id++;
+}
+
 template<typename T>
 std::list<double> linspace(T start_in, T end_in, int num_in) {
   double start = static_cast<double>(start_in);
@@ -50,35 +64,118 @@ template std::list<double> linspace<float>(float, float, int);
 template std::list<double> linspace<size_t>(size_t, size_t, int);
 template std::list<double> linspace<int>(int, int, int);
 
-// TODO: this is really awful C code. rewrite this.
+// Row chunks with their own column counts have to hold enough entries to
+// pay for the threads, and the counts of all chunks are kept bounded.
+static const int kCsr2cscMinNnzPerChunk = 1 << 16;
+static const size_t kCsr2cscMaxCounts = 1 << 24;
+
 template<typename T>
 void csr2csc(
   int n, int m, int nz, 
   T *a, int *col_idx, int *row_start,
   T *csc_a, int *row_idx, int *col_start)
 {
-  int i, j, k, l;
-  int *ptr;
-
-  for (i=0; i<=m; i++) col_start[i] = 0;
-
-  /* determine column lengths */
-  for (i=0; i<nz; i++) col_start[col_idx[i]+1]++;
-  for (i=0; i<m; i++) col_start[i+1] += col_start[i];
-
-  /* go through the structure once more. Fill in output matrix. */
-  for (i=0, ptr=row_start; i<n; i++, ptr++)
-    for (j=*ptr; j<*(ptr+1); j++){
-      k = col_idx[j];
-      l = col_start[k]++;
-      row_idx[l] = i;
-      if (a) csc_a[l] = a[j];
+  int chunks = 1;
+
+#ifdef _OPENMP
+  chunks = std::min(omp_get_max_threads(), nz / kCsr2cscMinNnzPerChunk);
+  chunks = std::min(chunks, static_cast<int>(kCsr2cscMaxCounts / (m + 1)));
+#endif
+
+  if(chunks <= 1)
+  {
+    // counting sort over the columns, visiting the rows in order leaves
+    // the row indices of each column sorted
+    std::fill(col_start, col_start + m + 1, 0);
+
+    for(int k = 0; k < nz; k++)
+      col_start[col_idx[k] + 1]++;
+
+    for(int j = 0; j < m; j++)
+      col_start[j + 1] += col_start[j];
+
+    for(int i = 0; i < n; i++)
+    {
+      for(int k = row_start[i]; k < row_start[i + 1]; k++)
+      {
+        const int l = col_start[col_idx[k]]++;
+        row_idx[l] = i;
+        if(a) csc_a[l] = a[k];
+      }
     }
 
-  /* shift back col_start */
-  for (i=m; i>0; i--) col_start[i] = col_start[i-1];
+    // col_start[j] now is the start of column j + 1
+    for(int j = m; j > 0; j--)
+      col_start[j] = col_start[j - 1];
+
+    col_start[0] = 0;
+    return;
+  }
+
+  // contiguous row ranges with about the same number of entries, chunk c
+  // writes its part of each column after the parts of chunks 0..c-1, so
+  // the row indices stay sorted
+  vector<int> row_begin(chunks + 1);
+  for(int c = 0; c <= chunks; c++)
+  {
+    const int target = static_cast<int>(static_cast<int64_t>(nz) * c / chunks);
+    row_begin[c] = static_cast<int>(std::lower_bound(row_start, row_start + n + 1, target) - row_start);
+  }
+  row_begin[0] = 0;
+  row_begin[chunks] = n;
+
+  vector<int> offsets(static_cast<size_t>(chunks) * m, 0);
+
+#pragma omp parallel for schedule(static, 1)
+  for(int c = 0; c < chunks; c++)
+  {
+    int *counts = &offsets[static_cast<size_t>(c) * m];
+    for(int k = row_start[row_begin[c]]; k < row_start[row_begin[c + 1]]; k++)
+      counts[col_idx[k]]++;
+  }
 
   col_start[0] = 0;
+
+#pragma omp parallel for schedule(static)
+  for(int j = 0; j < m; j++)
+  {
+    int count = 0;
+    for(int c = 0; c < chunks; c++)
+      count += offsets[static_cast<size_t>(c) * m + j];
+
+    col_start[j + 1] = count;
+  }
+
+  for(int j = 0; j < m; j++)
+    col_start[j + 1] += col_start[j];
+
+#pragma omp parallel for schedule(static)
+  for(int j = 0; j < m; j++)
+  {
+    int pos = col_start[j];
+    for(int c = 0; c < chunks; c++)
+    {
+      int& offset = offsets[static_cast<size_t>(c) * m + j];
+      const int count = offset;
+      offset = pos;
+      pos += count;
+    }
+  }
+
+#pragma omp parallel for schedule(static, 1)
+  for(int c = 0; c < chunks; c++)
+  {
+    int *pos = &offsets[static_cast<size_t>(c) * m];
+    for(int i = row_begin[c]; i < row_begin[c + 1]; i++)
+    {
+      for(int k = row_start[i]; k < row_start[i + 1]; k++)
+      {
+        const int l = pos[col_idx[k]]++;
+        row_idx[l] = i;
+        if(a) csc_a[l] = a[k];
+      }
+    }
+  }
 }
 
 // Beginning of GPU Architecture defintions
@@ -130,5 +227,31 @@ template void csr2csc<double>(int n, int m, int nz,
                               double *csc_a, int *row_idx, int *col_start);
 
 
+template<typename S, typename T>
+__global__
+void ConvertDeviceKernel(const S *src, T *dst, size_t count)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count)
+    dst[tx] = static_cast<T>(src[tx]);
+}
+
+template<typename S, typename T>
+void ConvertDevice(const S *src, T *dst, size_t count, cudaStream_t stream)
+{
+  if(count == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  ConvertDeviceKernel<S, T><<<grid, block, 0, stream>>>(src, dst, count);
+}
+
+template void ConvertDevice<float, float>(const float *, float *, size_t, cudaStream_t);
+template void ConvertDevice<float, double>(const float *, double *, size_t, cudaStream_t);
+template void ConvertDevice<double, float>(const double *, float *, size_t, cudaStream_t);
+template void ConvertDevice<double, double>(const double *, double *, size_t, cudaStream_t);
 
 } // namespace prost
\ No newline at end of file
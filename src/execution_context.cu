@@ -0,0 +1,148 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+
+#include "prost/execution_context.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+namespace {
+
+/// \brief Makes the device of the context current for the handle creation.
+class DeviceGuard {
+public:
+  explicit DeviceGuard(int device) : prev_(-1)
+  {
+    int cur;
+    cudaGetDevice(&cur);
+
+    if(cur != device)
+    {
+      prev_ = cur;
+      cudaSetDevice(device);
+    }
+  }
+
+  ~DeviceGuard()
+  {
+    if(prev_ >= 0)
+      cudaSetDevice(prev_);
+  }
+
+private:
+  int prev_;
+};
+
+void CheckStatus(bool success, const char *name)
+{
+  if(!success)
+  {
+    std::stringstream ss;
+    ss << "ExecutionContext: failed to create the " << name << " handle.";
+    throw Exception(ss.str());
+  }
+}
+
+} // namespace
+
+ExecutionContext::ExecutionContext(int device)
+  : device_(device), stream_(0), dense_math_(DenseMath::kDefault), out_of_core_(false),
+    cublas_(nullptr), cusparse_(nullptr), cusolver_dn_(nullptr),
+    cusolver_sp_(nullptr)
+{
+  if(device_ < 0)
+    cudaGetDevice(&device_);
+}
+
+ExecutionContext::~ExecutionContext()
+{
+  DeviceGuard guard(device_);
+
+  if(cublas_ != nullptr)
+    cublasDestroy_v2(cublas_);
+
+  if(cusparse_ != nullptr)
+    cusparseDestroy(cusparse_);
+
+  if(cusolver_dn_ != nullptr)
+    cusolverDnDestroy(cusolver_dn_);
+
+  if(cusolver_sp_ != nullptr)
+    cusolverSpDestroy(cusolver_sp_);
+}
+
+shared_ptr<ExecutionContext> ExecutionContext::Default()
+{
+  static shared_ptr<ExecutionContext> context(new ExecutionContext());
+
+  return context;
+}
+
+cublasHandle_t ExecutionContext::cublas(cudaStream_t stream)
+{
+  if(cublas_ == nullptr)
+  {
+    DeviceGuard guard(device_);
+    CheckStatus(cublasCreate_v2(&cublas_) == CUBLAS_STATUS_SUCCESS, "cuBLAS");
+  }
+
+  cublasSetStream(cublas_, stream);
+  return cublas_;
+}
+
+cusparseHandle_t ExecutionContext::cusparse(cudaStream_t stream)
+{
+  if(cusparse_ == nullptr)
+  {
+    DeviceGuard guard(device_);
+    CheckStatus(cusparseCreate(&cusparse_) == CUSPARSE_STATUS_SUCCESS, "cuSPARSE");
+  }
+
+  cusparseSetStream(cusparse_, stream);
+  return cusparse_;
+}
+
+cusolverDnHandle_t ExecutionContext::cusolver_dn(cudaStream_t stream)
+{
+  if(cusolver_dn_ == nullptr)
+  {
+    DeviceGuard guard(device_);
+    CheckStatus(cusolverDnCreate(&cusolver_dn_) == CUSOLVER_STATUS_SUCCESS, "cuSOLVER");
+  }
+
+  cusolverDnSetStream(cusolver_dn_, stream);
+  return cusolver_dn_;
+}
+
+cusolverSpHandle_t ExecutionContext::cusolver_sp(cudaStream_t stream)
+{
+  if(cusolver_sp_ == nullptr)
+  {
+    DeviceGuard guard(device_);
+    CheckStatus(cusolverSpCreate(&cusolver_sp_) == CUSOLVER_STATUS_SUCCESS, "cuSOLVER sparse");
+  }
+
+  cusolverSpSetStream(cusolver_sp_, stream);
+  return cusolver_sp_;
+}
+
+} // namespace prost
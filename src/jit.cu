@@ -0,0 +1,213 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef PROST_WITH_NVRTC
+#include <nvrtc.h>
+#endif
+
+#include "prost/jit.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+#define STRINGIFY(m) #m
+#define AS_STRING(m) STRINGIFY(m)
+
+#ifdef PROST_WITH_NVRTC
+
+// NVRTC ships without the C++ standard library. The elementwise operations
+// only need the declaration of numeric_limits.
+static const char *kJITLimitsHeader = 
+  "#pragma once\n"
+  "namespace std { template<class T> struct numeric_limits; }\n";
+
+static void CheckNVRTC(nvrtcResult result, const char *what)
+{
+  if(result != NVRTC_SUCCESS)
+  {
+    std::stringstream ss;
+    ss << "NVRTC error in " << what << ": " << nvrtcGetErrorString(result);
+    throw Exception(ss.str());
+  }
+}
+
+static void CheckDriver(CUresult result, const char *what)
+{
+  if(result != CUDA_SUCCESS)
+  {
+    const char *msg = nullptr;
+    cuGetErrorString(result, &msg);
+
+    std::stringstream ss;
+    ss << "CUDA driver error in " << what << ": " << (msg ? msg : "unknown");
+    throw Exception(ss.str());
+  }
+}
+
+static std::string JITIncludeDir()
+{
+  const char *dir = std::getenv("PROST_INCLUDE_DIR");
+  if(dir != nullptr)
+    return dir;
+
+#ifdef PROST_JIT_INCLUDE_DIR
+  return AS_STRING(PROST_JIT_INCLUDE_DIR);
+#else
+  throw Exception("JITKernelCache: set PROST_INCLUDE_DIR to the prost include directory.");
+#endif
+}
+
+bool JITKernelCache::available()
+{
+  return true;
+}
+
+CUfunction JITKernelCache::Get(const std::string& source, const std::string& name)
+{
+  static std::mutex mutex;
+  static std::map<std::string, CUmodule> modules;
+  static std::map<std::string, CUfunction> cache;
+
+  int device;
+  cudaGetDevice(&device);
+
+  std::stringstream module_key;
+  module_key << device << "\n" << source;
+  const std::string key = name + "\n" + module_key.str();
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  auto it = cache.find(key);
+  if(it != cache.end())
+    return it->second;
+
+  // the other kernels of a source are taken from the compiled module
+  auto mod = modules.find(module_key.str());
+  if(mod != modules.end())
+  {
+    CUfunction kernel;
+    CheckDriver(cuModuleGetFunction(&kernel, mod->second, name.c_str()), "cuModuleGetFunction");
+
+    cache[key] = kernel;
+    return kernel;
+  }
+
+  // makes sure the runtime created the primary context the module is
+  // loaded into
+  cudaFree(0);
+
+  int major, minor;
+  cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, device);
+  cudaDeviceGetAttribute(&minor, cudaDevAttrComputeCapabilityMinor, device);
+
+  std::stringstream arch;
+  arch << "--gpu-architecture=compute_" << major << minor;
+  const std::string arch_opt = arch.str();
+  const std::string include_opt = "-I" + JITIncludeDir();
+
+  const char *opts[] = { arch_opt.c_str(), include_opt.c_str(), "--std=c++11" };
+  const char *headers[] = { kJITLimitsHeader };
+  const char *header_names[] = { "limits" };
+
+  nvrtcProgram prog;
+  CheckNVRTC(nvrtcCreateProgram(&prog, source.c_str(), "prost_jit.cu", 1, headers, header_names), 
+             "nvrtcCreateProgram");
+
+  const nvrtcResult result = nvrtcCompileProgram(prog, 3, opts);
+  if(result != NVRTC_SUCCESS)
+  {
+    size_t log_size;
+    nvrtcGetProgramLogSize(prog, &log_size);
+    std::string log(log_size, '\0');
+    nvrtcGetProgramLog(prog, &log[0]);
+    nvrtcDestroyProgram(&prog);
+
+    std::stringstream ss;
+    ss << "JITKernelCache: compilation of '" << name << "' failed:" << std::endl << log;
+    throw Exception(ss.str());
+  }
+
+  size_t ptx_size;
+  CheckNVRTC(nvrtcGetPTXSize(prog, &ptx_size), "nvrtcGetPTXSize");
+  std::string ptx(ptx_size, '\0');
+  CheckNVRTC(nvrtcGetPTX(prog, &ptx[0]), "nvrtcGetPTX");
+  nvrtcDestroyProgram(&prog);
+
+  // modules stay loaded until the context is destroyed
+  CUmodule module;
+  CUfunction kernel;
+  CheckDriver(cuModuleLoadData(&module, ptx.c_str()), "cuModuleLoadData");
+  modules[module_key.str()] = module;
+
+  CheckDriver(cuModuleGetFunction(&kernel, module, name.c_str()), "cuModuleGetFunction");
+
+  cache[key] = kernel;
+  return kernel;
+}
+
+void JITKernelCache::Launch(
+  CUfunction kernel,
+  dim3 grid,
+  dim3 block,
+  size_t shared_mem_bytes,
+  cudaStream_t stream,
+  void **params)
+{
+  CheckDriver(cuLaunchKernel(kernel, 
+                             grid.x, grid.y, grid.z, 
+                             block.x, block.y, block.z,
+                             shared_mem_bytes,
+                             static_cast<CUstream>(stream),
+                             params,
+                             nullptr),
+              "cuLaunchKernel");
+}
+
+#else
+
+bool JITKernelCache::available()
+{
+  return false;
+}
+
+CUfunction JITKernelCache::Get(const std::string& source, const std::string& name)
+{
+  throw Exception("JITKernelCache: prost was built without NVRTC support (PROST_WITH_NVRTC).");
+}
+
+void JITKernelCache::Launch(
+  CUfunction kernel,
+  dim3 grid,
+  dim3 block,
+  size_t shared_mem_bytes,
+  cudaStream_t stream,
+  void **params)
+{
+  throw Exception("JITKernelCache: prost was built without NVRTC support (PROST_WITH_NVRTC).");
+}
+
+#endif
+
+} // namespace prost
@@ -0,0 +1,402 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "prost/launch_config.hpp"
+#include "prost/config.hpp"
+
+namespace prost {
+
+namespace {
+
+/// \brief Tuning state of one kernel, device, problem size bucket and 
+///        shared memory requirement.
+struct LaunchTuning
+{
+  std::string key;
+  int device;
+  size_t block_size;
+  bool tuned;
+  bool opt_in;
+
+  std::vector<size_t> candidates;
+  std::vector<float> times;
+  size_t started;
+  size_t finished;
+};
+
+/// \brief Block sizes read from and appended to the tuning file of a device.
+struct DeviceTuning
+{
+  bool loaded;
+  std::string file;
+  std::map<std::string, size_t> stored;
+
+  DeviceTuning() : loaded(false) { }
+};
+
+typedef std::tuple<int, const void *, int, size_t, size_t, size_t> LaunchKey;
+
+std::mutex tuning_mutex;
+std::map<LaunchKey, LaunchTuning> tunings;
+std::map<int, DeviceTuning> device_tunings;
+bool autotune_launches = false;
+
+std::string TuningDirectory()
+{
+  const char *dir = std::getenv("PROST_TUNING_DIR");
+  if(dir != nullptr)
+    return dir;
+
+#if defined(_MSC_VER)
+  const char *home = std::getenv("USERPROFILE");
+#else
+  const char *home = std::getenv("HOME");
+#endif
+
+  if(home == nullptr)
+    return std::string();
+
+  return std::string(home) + "/.prost";
+}
+
+void MakeDirectory(const std::string& dir)
+{
+#if defined(_MSC_VER)
+  _mkdir(dir.c_str());
+#else
+  mkdir(dir.c_str(), 0755);
+#endif
+}
+
+/// \brief Reads the tuning file of the device, named after the device and
+///        its compute capability. Lines are "key block_size".
+DeviceTuning& LoadDeviceTuning(int device)
+{
+  DeviceTuning& dt = device_tunings[device];
+
+  if(dt.loaded)
+    return dt;
+
+  dt.loaded = true;
+
+  const std::string dir = TuningDirectory();
+  if(dir.empty())
+    return dt;
+
+  cudaDeviceProp prop;
+  if(cudaGetDeviceProperties(&prop, device) != cudaSuccess)
+    return dt;
+
+  std::string name(prop.name);
+  for(char& c : name)
+    if(!std::isalnum(static_cast<unsigned char>(c)))
+      c = '_';
+
+  std::stringstream file;
+  file << dir << "/launch-" << name << "-sm" << prop.major << prop.minor << ".txt";
+  dt.file = file.str();
+
+  std::ifstream in(dt.file.c_str());
+  std::string line;
+  while(std::getline(in, line))
+  {
+    const size_t sep = line.rfind(' ');
+    if(sep == std::string::npos)
+      continue;
+
+    const size_t block_size = std::strtoul(line.c_str() + sep + 1, nullptr, 10);
+    if(block_size > 0 && (block_size % kWarpSizeCUDA) == 0)
+      dt.stored[line.substr(0, sep)] = block_size;
+  }
+
+  return dt;
+}
+
+void StoreDeviceTuning(int device, const std::string& key, size_t block_size)
+{
+  DeviceTuning& dt = LoadDeviceTuning(device);
+  dt.stored[key] = block_size;
+
+  if(dt.file.empty())
+    return;
+
+  MakeDirectory(TuningDirectory());
+
+  std::ofstream out(dt.file.c_str(), std::ios::app);
+  if(out)
+    out << key << " " << block_size << std::endl;
+}
+
+/// \brief Largest multiple of the warp size which the kernel can be 
+///        launched with and whose dynamic shared memory fits into limit.
+size_t MaxBlockSize(const cudaFuncAttributes& attr, size_t smem_per_thread, size_t smem_fixed, size_t limit)
+{
+  size_t max_threads = std::min<size_t>(attr.maxThreadsPerBlock, 1024);
+  max_threads -= max_threads % kWarpSizeCUDA;
+
+  const size_t static_bytes = attr.sharedSizeBytes;
+  if(static_bytes + smem_fixed > limit)
+    return 0;
+
+  size_t max_block = max_threads;
+  if(smem_per_thread > 0)
+    max_block = std::min(max_block, (limit - static_bytes - smem_fixed) / smem_per_thread);
+
+  return max_block - max_block % kWarpSizeCUDA;
+}
+
+/// \brief Powers of two from 64 up to max_block and the block size the 
+///        occupancy calculator suggests.
+std::vector<size_t> TuningCandidates(
+  const void *kernel, 
+  size_t max_block, 
+  size_t smem_per_thread, 
+  size_t smem_fixed)
+{
+  std::vector<size_t> candidates;
+
+  for(size_t b = 2 * kWarpSizeCUDA; b <= max_block; b *= 2)
+    candidates.push_back(b);
+
+  int min_grid = 0, block = 0;
+  auto smem = [=](int b) { return smem_fixed + b * smem_per_thread; };
+  if(cudaOccupancyMaxPotentialBlockSizeVariableSMem(
+       &min_grid, &block, kernel, smem, static_cast<int>(max_block)) == cudaSuccess && block > 0)
+  {
+    const size_t b = block - block % kWarpSizeCUDA;
+
+    if(b > 0 && std::find(candidates.begin(), candidates.end(), b) == candidates.end())
+      candidates.push_back(b);
+  }
+  else
+    cudaGetLastError();
+
+  if(candidates.empty())
+    candidates.push_back(max_block);
+
+  return candidates;
+}
+
+int SizeBucket(size_t count)
+{
+  int bucket = 0;
+  while(count > 1)
+  {
+    count >>= 1;
+    bucket++;
+  }
+
+  return bucket;
+}
+
+bool IsCapturing(cudaStream_t stream)
+{
+#if CUDART_VERSION >= 10000
+  cudaStreamCaptureStatus status;
+  if(cudaStreamIsCapturing(stream, &status) != cudaSuccess)
+  {
+    cudaGetLastError();
+    return true;
+  }
+
+  return status != cudaStreamCaptureStatusNone;
+#else
+  return false;
+#endif
+}
+
+} // namespace
+
+LaunchConfig::LaunchConfig(
+  const char *name,
+  const std::type_info& type,
+  const void *kernel,
+  size_t count,
+  size_t smem_per_thread,
+  size_t smem_fixed,
+  cudaStream_t stream,
+  size_t max_shared_mem)
+  : block_size_(0), count_(count), smem_per_thread_(smem_per_thread), smem_fixed_(smem_fixed),
+    trial_(nullptr), candidate_(0), start_(nullptr), stop_(nullptr), stream_(stream)
+{
+  int device;
+  cudaGetDevice(&device);
+
+  const LaunchKey lkey(device, kernel, SizeBucket(count), smem_per_thread, smem_fixed, max_shared_mem);
+
+  std::lock_guard<std::mutex> lock(tuning_mutex);
+
+  auto it = tunings.find(lkey);
+  if(it == tunings.end())
+  {
+    LaunchTuning t;
+    t.device = device;
+    t.tuned = false;
+    t.opt_in = false;
+    t.started = 0;
+    t.finished = 0;
+
+    std::stringstream key;
+    key << name << ":" << type.name() << ":" << std::get<2>(lkey) << ":" 
+        << smem_per_thread << ":" << smem_fixed << ":" << max_shared_mem;
+    t.key = key.str();
+
+    // shared memory beyond the default limit needs an opt-in per kernel
+    int limit_default = 0, limit_optin = 0;
+    cudaDeviceGetAttribute(&limit_default, cudaDevAttrMaxSharedMemoryPerBlock, device);
+#if CUDART_VERSION >= 9000
+    cudaDeviceGetAttribute(&limit_optin, cudaDevAttrMaxSharedMemoryPerBlockOptin, device);
+#endif
+    size_t limit = std::max(limit_default, limit_optin);
+    if(max_shared_mem > 0)
+      limit = std::min(limit, max_shared_mem);
+
+    cudaFuncAttributes attr;
+    if(cudaFuncGetAttributes(&attr, kernel) != cudaSuccess)
+    {
+      cudaGetLastError();
+      attr.maxThreadsPerBlock = kBlockSizeCUDA;
+      attr.sharedSizeBytes = 0;
+    }
+
+    const size_t max_block = MaxBlockSize(attr, smem_per_thread, smem_fixed, limit);
+    t.block_size = std::min(kBlockSizeCUDA, max_block);
+
+    if(autotune_launches && max_block > 0)
+    {
+      DeviceTuning& dt = LoadDeviceTuning(device);
+      auto stored = dt.stored.find(t.key);
+
+      if(stored != dt.stored.end() && stored->second <= max_block)
+      {
+        t.block_size = stored->second;
+        t.tuned = true;
+      }
+      else if(count >= kLaunchTuneMinCount)
+      {
+        t.candidates = TuningCandidates(kernel, max_block, smem_per_thread, smem_fixed);
+        t.times.assign(t.candidates.size(), std::numeric_limits<float>::max());
+      }
+      else
+        t.tuned = true;
+    }
+    else
+      t.tuned = true;
+
+#if CUDART_VERSION >= 9000
+    const size_t max_bytes = smem_fixed + max_block * smem_per_thread;
+    if(max_block > 0 && max_bytes > static_cast<size_t>(limit_default))
+    {
+      t.opt_in = cudaFuncSetAttribute(kernel, cudaFuncAttributeMaxDynamicSharedMemorySize, 
+                                      static_cast<int>(max_bytes)) == cudaSuccess;
+
+      if(!t.opt_in)
+      {
+        cudaGetLastError();
+        t.block_size = std::min(t.block_size, 
+                                MaxBlockSize(attr, smem_per_thread, smem_fixed, limit_default));
+        t.tuned = true;
+      }
+    }
+#endif
+
+    it = tunings.insert(std::make_pair(lkey, t)).first;
+  }
+
+  LaunchTuning& t = it->second;
+  block_size_ = t.block_size;
+
+  if(t.tuned || t.started >= t.candidates.size() * kLaunchTuneTrials || IsCapturing(stream))
+    return;
+
+  // time this launch with the next candidate, the result doesn't 
+  // depend on the block size
+  candidate_ = t.started % t.candidates.size();
+  block_size_ = t.candidates[candidate_];
+  t.started++;
+
+  cudaEventCreate(&start_);
+  cudaEventCreate(&stop_);
+  cudaEventRecord(start_, stream);
+  trial_ = &t;
+}
+
+LaunchConfig::~LaunchConfig()
+{
+  if(trial_ == nullptr)
+    return;
+
+  cudaEventRecord(stop_, stream_);
+  cudaEventSynchronize(stop_);
+
+  float ms = std::numeric_limits<float>::max();
+  if(cudaEventElapsedTime(&ms, start_, stop_) != cudaSuccess)
+    cudaGetLastError();
+
+  cudaEventDestroy(start_);
+  cudaEventDestroy(stop_);
+
+  std::lock_guard<std::mutex> lock(tuning_mutex);
+
+  LaunchTuning& t = *static_cast<LaunchTuning *>(trial_);
+  t.times[candidate_] = std::min(t.times[candidate_], ms);
+  t.finished++;
+
+  if(t.finished < t.candidates.size() * kLaunchTuneTrials)
+    return;
+
+  const size_t best = std::min_element(t.times.begin(), t.times.end()) - t.times.begin();
+  t.block_size = t.candidates[best];
+  t.tuned = true;
+
+  StoreDeviceTuning(t.device, t.key, t.block_size);
+}
+
+void LaunchConfig::SetAutotune(bool autotune)
+{
+  std::lock_guard<std::mutex> lock(tuning_mutex);
+  autotune_launches = autotune;
+}
+
+bool LaunchConfig::autotune()
+{
+  std::lock_guard<std::mutex> lock(tuning_mutex);
+  return autotune_launches;
+}
+
+} // namespace prost
@@ -18,10 +18,29 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <thrust/functional.h>
+#include <thrust/transform.h>
+#include <thrust/system/cuda/execution_policy.h>
+
 #include "prost/linop/block.hpp"
+#include "prost/exception.hpp"
+#include "prost/profiler.hpp"
 
 namespace prost {
 
+// operator data, right hand side and read-modify-write of the result
+template<typename T>
+static double ProfileBytes(const Block<T>& block, bool adjoint)
+{
+  if(!Profiler::enabled())
+    return 0;
+
+  const size_t res = adjoint ? block.ncols() : block.nrows();
+  const size_t rhs = adjoint ? block.nrows() : block.ncols();
+
+  return block.gpu_mem_amount() + sizeof(T) * (rhs + 2.0 * res);
+}
+
 template<typename T>
 Block<T>::Block(size_t row, size_t col, size_t nrows, size_t ncols) 
   : row_(row), col_(col), nrows_(nrows), ncols_(ncols) 
@@ -42,32 +61,176 @@ template<typename T>
 void Block<T>::Release()
 {
 }
+
+template<typename T>
+ExecutionContext& Block<T>::context()
+{
+  if(!context_)
+    context_ = ExecutionContext::Default();
+
+  return *context_;
+}
   
 template<typename T>
 void Block<T>::EvalAdd(
   thrust::device_vector<T>& result, 
-  const thrust::device_vector<T>& rhs)
+  const thrust::device_vector<T>& rhs,
+  cudaStream_t stream)
 {
+  ProfileRange range(typeid(*this), "", ProfileBytes(*this, false), stream);
+
   EvalLocalAdd(
     result.begin() + row_,
     result.begin() + row_ + nrows_,
     rhs.cbegin() + col_,
-    rhs.cbegin() + col_ + ncols_);
+    rhs.cbegin() + col_ + ncols_,
+    stream);
 }
 
 template<typename T>
 void Block<T>::EvalAdjointAdd(
   thrust::device_vector<T>& result, 
-  const thrust::device_vector<T>& rhs)
+  const thrust::device_vector<T>& rhs,
+  cudaStream_t stream)
 {
+  ProfileRange range(typeid(*this), " (adjoint)", ProfileBytes(*this, true), stream);
+
   EvalAdjointLocalAdd(
     result.begin() + col_,
     result.begin() + col_ + ncols_,
     rhs.cbegin() + row_,
-    rhs.cbegin() + row_ + nrows_);
+    rhs.cbegin() + row_ + nrows_,
+    stream);
+}
+
+template<typename T>
+void Block<T>::EvalAdd(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  ProfileRange range(typeid(*this), "", ProfileBytes(*this, false), stream);
+
+  EvalLocalAddEpilogue(
+    result.begin() + row_,
+    result.begin() + row_ + nrows_,
+    rhs.cbegin() + col_,
+    rhs.cbegin() + col_ + ncols_,
+    epilogue.Offset(row_),
+    stream);
+}
+
+template<typename T>
+void Block<T>::EvalAdjointAdd(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  ProfileRange range(typeid(*this), " (adjoint)", ProfileBytes(*this, true), stream);
+
+  EvalAdjointLocalAddEpilogue(
+    result.begin() + col_,
+    result.begin() + col_ + ncols_,
+    rhs.cbegin() + row_,
+    rhs.cbegin() + row_ + nrows_,
+    epilogue.Offset(col_),
+    stream);
+}
+
+template<typename T>
+void Block<T>::EvalLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  throw Exception("Block does not support epilogue fusion.");
+}
+
+template<typename T>
+void Block<T>::EvalAdjointLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  throw Exception("Block does not support epilogue fusion.");
 }
 
 // Explicit template instantiation
+template<typename T>
+bool Block<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  return false;
+}
+
+template<typename T>
+void Block<T>::RowSumsAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  RowSumsLocalAdd(sums_begin + row_, alpha, stream);
+}
+
+template<typename T>
+void Block<T>::ColSumsAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  ColSumsLocalAdd(sums_begin + col_, alpha, stream);
+}
+
+template<typename T>
+void Block<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  vector<T> host_sums(nrows_);
+  for(size_t row = 0; row < nrows_; row++)
+    host_sums[row] = row_sum(row, alpha);
+
+  device_vector<T> sums(host_sums);
+  thrust::transform(
+    thrust::cuda::par.on(stream),
+    sums.begin(),
+    sums.end(),
+    sums_begin,
+    sums_begin,
+    thrust::plus<T>());
+}
+
+template<typename T>
+void Block<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  vector<T> host_sums(ncols_);
+  for(size_t col = 0; col < ncols_; col++)
+    host_sums[col] = col_sum(col, alpha);
+
+  device_vector<T> sums(host_sums);
+  thrust::transform(
+    thrust::cuda::par.on(stream),
+    sums.begin(),
+    sums.end(),
+    sums_begin,
+    sums_begin,
+    thrust::plus<T>());
+}
+
 template class Block<float>;
 template class Block<double>;
 
@@ -19,14 +19,12 @@
 */
 
 #include "prost/linop/block_dense.hpp"
+#include "prost/linop/block_sums.hpp"
 #include "prost/exception.hpp"
 
 namespace prost
 {
 
-template<> cublasHandle_t BlockDense<float>::cublas_handle_ = nullptr;
-template<> cublasHandle_t BlockDense<double>::cublas_handle_ = nullptr;
-
 template<typename T>
 BlockDense<T>::BlockDense(size_t row, size_t col, size_t nrows, size_t ncols)
     : Block<T>(row, col, nrows, ncols)
@@ -46,9 +44,6 @@ BlockDense<T>* BlockDense<T>::CreateFromColFirstData(
 template<typename T>
 void BlockDense<T>::Initialize()
 {
-  if(cublas_handle_ == nullptr)
-    cublasCreate_v2(&cublas_handle_);
-
   data_.resize(this->nrows() * this->ncols());
   thrust::copy(host_data_.begin(), host_data_.end(), data_.begin());
 }
@@ -79,17 +74,24 @@ size_t BlockDense<T>::gpu_mem_amount() const
   return this->nrows() * this->ncols() * sizeof(T);
 }
 
+template<typename T>
+void BlockDense<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  PrefetchOperatorVector(data_, device, stream);
+}
+
 template<>
 void BlockDense<float>::EvalLocalAdd(
     const typename device_vector<float>::iterator& res_begin,
     const typename device_vector<float>::iterator& res_end,
     const typename device_vector<float>::const_iterator& rhs_begin,
-    const typename device_vector<float>::const_iterator& rhs_end)
+    const typename device_vector<float>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
   static const float alpha = 1.f;
   static const float beta = 1.f;
 
-  cublasStatus_t status = cublasSgemv(cublas_handle_,
+  cublasStatus_t status = cublasSgemv(this->context().cublas(stream),
                                       CUBLAS_OP_N,
                                       static_cast<int>(this->nrows()),
                                       static_cast<int>(this->ncols()),
@@ -111,12 +113,13 @@ void BlockDense<double>::EvalLocalAdd(
     const typename device_vector<double>::iterator& res_begin,
     const typename device_vector<double>::iterator& res_end,
     const typename device_vector<double>::const_iterator& rhs_begin,
-    const typename device_vector<double>::const_iterator& rhs_end)
+    const typename device_vector<double>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
   static const double alpha = 1.f;
   static const double beta = 1.f;
 
-  cublasStatus_t status = cublasDgemv(cublas_handle_,
+  cublasStatus_t status = cublasDgemv(this->context().cublas(stream),
                                       CUBLAS_OP_N,
                                       static_cast<int>(this->nrows()),
                                       static_cast<int>(this->ncols()),
@@ -138,12 +141,13 @@ void BlockDense<float>::EvalAdjointLocalAdd(
     const typename device_vector<float>::iterator& res_begin,
     const typename device_vector<float>::iterator& res_end,
     const typename device_vector<float>::const_iterator& rhs_begin,
-    const typename device_vector<float>::const_iterator& rhs_end)
+    const typename device_vector<float>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
   static const float alpha = 1.f;
   static const float beta = 1.f;
 
-  cublasStatus_t status = cublasSgemv(cublas_handle_,
+  cublasStatus_t status = cublasSgemv(this->context().cublas(stream),
                                       CUBLAS_OP_T,
                                       static_cast<int>(this->nrows()),
                                       static_cast<int>(this->ncols()),
@@ -165,12 +169,13 @@ void BlockDense<double>::EvalAdjointLocalAdd(
     const typename device_vector<double>::iterator& res_begin,
     const typename device_vector<double>::iterator& res_end,
     const typename device_vector<double>::const_iterator& rhs_begin,
-    const typename device_vector<double>::const_iterator& rhs_end)
+    const typename device_vector<double>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
   static const double alpha = 1.f;
   static const double beta = 1.f;
 
-  cublasStatus_t status = cublasDgemv(cublas_handle_,
+  cublasStatus_t status = cublasDgemv(this->context().cublas(stream),
                                       CUBLAS_OP_T,
                                       static_cast<int>(this->nrows()),
                                       static_cast<int>(this->ncols()),
@@ -187,6 +192,66 @@ void BlockDense<double>::EvalAdjointLocalAdd(
     throw Exception("BlockDense::EvalLocalAdd failed.");
 }
 
+template<typename T>
+void BlockDense<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->nrows(),
+    1,
+    this->nrows(),
+    1,
+    this->nrows(),
+    this->ncols(),
+    alpha,
+    stream);
+}
+
+template<typename T>
+void BlockDense<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->ncols(),
+    1,
+    this->ncols(),
+    this->nrows(),
+    1,
+    this->nrows(),
+    alpha,
+    stream);
+}
+
+template<typename T>
+bool BlockDense<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  for(size_t c = 0; c < this->ncols(); c++)
+    for(size_t r = 0; r < this->nrows(); r++)
+    {
+      const T val = host_data_[c * this->nrows() + r];
+
+      if(val != 0)
+      {
+        rows.push_back(this->row() + r);
+        cols.push_back(this->col() + c);
+        vals.push_back(val);
+      }
+    }
+
+  return true;
+}
+
 // Explicit template instantiation
 template class BlockDense<float>;
 template class BlockDense<double>;
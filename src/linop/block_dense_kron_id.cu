@@ -19,51 +19,14 @@
 */
 
 #include "prost/linop/block_dense_kron_id.hpp"
+#include "prost/linop/block_sums.hpp"
+#include "prost/linop/dense_gemm.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost
 {
 
-template<typename T, bool transpose>
-__global__ void BlockDenseKronIdKernel(
-    T *result,
-    const T *rhs,
-    size_t diaglength,
-    size_t nrows,
-    size_t ncols,
-    const T *data)
-{
-  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
-
-  if(!transpose) {
-    if(tx < diaglength * nrows) {
-      size_t row = tx / diaglength;
-      size_t col_ofs = tx % diaglength;
-
-      T sum = 0;
-      for(int32_t i = 0; i < ncols; i++) {
-	sum += data[i * nrows + row] * rhs[i * diaglength + col_ofs];
-      }
-
-      result[tx] += sum;
-    }
-  }
-  else {
-    if(tx < diaglength * ncols) {
-      size_t col = tx / diaglength;
-      size_t row_ofs = tx % diaglength;
-
-      T sum = 0;
-      for(int32_t i = 0; i < nrows; i++) {
-	sum += data[i + col * nrows] * rhs[i * diaglength + row_ofs];
-      }
-
-      result[tx] += sum;
-    }
-  }
-}
-
 template<typename T>
 BlockDenseKronId<T>::BlockDenseKronId(size_t row, size_t col, size_t nrows, size_t ncols)
     : Block<T>(row, col, nrows, ncols)
@@ -126,34 +89,35 @@ size_t BlockDenseKronId<T>::gpu_mem_amount() const
   return host_data_.size() * sizeof(T);
 }
 
+template<typename T>
+void BlockDenseKronId<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  PrefetchOperatorVector(data_, device, stream);
+}
+
 template<typename T>
 void BlockDenseKronId<T>::EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->nrows() + block.x) / block.x, 1, 1);
-
-  BlockDenseKronIdKernel<T, false>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_nrows_,
-          mat_ncols_,
-          thrust::raw_pointer_cast(data_.data()));
-  cudaDeviceSynchronize();
-
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
-  {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockDenseKronId (forward): CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
-  }
+  // kron(M, I) x = vec(X M^T) with X the column-major diaglength x
+  // mat_ncols_ matrix holding x, so this is a single GEMM
+  DenseGemm::Multiply<T>(this->context(), false, true,
+    static_cast<int>(diaglength_),
+    static_cast<int>(mat_nrows_),
+    static_cast<int>(mat_ncols_),
+    1,
+    thrust::raw_pointer_cast(&(*rhs_begin)),
+    static_cast<int>(diaglength_),
+    thrust::raw_pointer_cast(data_.data()),
+    static_cast<int>(mat_nrows_),
+    1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    static_cast<int>(diaglength_),
+    stream);
 }
 
 template<typename T>
@@ -161,29 +125,87 @@ void BlockDenseKronId<T>::EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  // kron(M, I)^T y = vec(Y M)
+  DenseGemm::Multiply<T>(this->context(), false, false,
+    static_cast<int>(diaglength_),
+    static_cast<int>(mat_ncols_),
+    static_cast<int>(mat_nrows_),
+    1,
+    thrust::raw_pointer_cast(&(*rhs_begin)),
+    static_cast<int>(diaglength_),
+    thrust::raw_pointer_cast(data_.data()),
+    static_cast<int>(mat_nrows_),
+    1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    static_cast<int>(diaglength_),
+    stream);
+}
+
+template<typename T>
+void BlockDenseKronId<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->nrows(),
+    diaglength_,
+    mat_nrows_,
+    1,
+    mat_nrows_,
+    mat_ncols_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+void BlockDenseKronId<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->ncols(),
+    diaglength_,
+    mat_ncols_,
+    mat_nrows_,
+    1,
+    mat_nrows_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+bool BlockDenseKronId<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->ncols() + block.x) / block.x, 1, 1);
-
-  BlockDenseKronIdKernel<T, true>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_nrows_,
-          mat_ncols_,
-          thrust::raw_pointer_cast(data_.data()));
-  cudaDeviceSynchronize();
-
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
-  {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockDenseKronId (adjoint): CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
-  }
+  // (A kron I)_{r d + k, c d + k} = A_{r c}
+  for(size_t c = 0; c < mat_ncols_; c++)
+    for(size_t r = 0; r < mat_nrows_; r++)
+    {
+      const T val = host_data_[c * mat_nrows_ + r];
+
+      if(val == 0)
+        continue;
+
+      for(size_t k = 0; k < diaglength_; k++)
+      {
+        rows.push_back(this->row() + r * diaglength_ + k);
+        cols.push_back(this->col() + c * diaglength_ + k);
+        vals.push_back(val);
+      }
+    }
+
+  return true;
 }
 
 // Explicit template instantiation
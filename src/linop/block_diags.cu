@@ -18,7 +18,13 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
 #include "prost/linop/block_diags.hpp"
+#include "prost/linop/block_sums.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
@@ -30,17 +36,117 @@ static const size_t kMaxNumberOfDiagonals = 1024;
 __constant__ float cmem_factors[kMaxNumberOfDiagonals];
 __constant__ ssize_t cmem_offsets[kMaxNumberOfDiagonals];
 
-template<> size_t BlockDiags<float>::cmem_counter_ = 0;
-template<> size_t BlockDiags<double>::cmem_counter_ = 0;
+// Slots of the constant memory in use, per device. Every device has its 
+// own copy of the constant memory, the slots of released blocks are
+// reused by the next ones. Solvers on different host threads initialize
+// their blocks concurrently, so the table is guarded by a mutex.
+static std::map<int, std::vector<bool> > cmem_used;
+static std::mutex cmem_mutex;
+
+// Allocates count contiguous slots on the device by first fit, returns
+// false if there is no such range.
+static bool AllocateConstMem(int device, size_t count, size_t& offset)
+{
+  std::lock_guard<std::mutex> lock(cmem_mutex);
+  std::vector<bool>& used = cmem_used[device];
+  used.resize(kMaxNumberOfDiagonals, false);
+
+  size_t run = 0;
+  for(size_t i = 0; i < kMaxNumberOfDiagonals; i++)
+  {
+    run = used[i] ? 0 : run + 1;
+
+    if(run == count)
+    {
+      offset = i + 1 - count;
+      std::fill(used.begin() + offset, used.begin() + offset + count, true);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void FreeConstMem(int device, size_t offset, size_t count)
+{
+  std::lock_guard<std::mutex> lock(cmem_mutex);
+  std::vector<bool>& used = cmem_used[device];
+
+  if(used.size() >= offset + count)
+    std::fill(used.begin() + offset, used.begin() + offset + count, false);
+}
+
+template<typename T>
+__global__
+void BlockDiagsRowSumsKernel(T *d_sums,
+			     size_t ndiags,
+			     size_t nrows,
+			     size_t ncols,
+			     size_t cmem_idx,
+			     T alpha)
+{
+  size_t row = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(row >= nrows)
+    return;
+
+  T sum = 0;
+  for(size_t i = 0; i < ndiags; i++)
+  {
+    const ssize_t col = row + cmem_offsets[cmem_idx + i];
+
+    if(col < 0)
+      continue;
+
+    if(col >= ncols)
+      break;
+
+    sum += pow(fabs(static_cast<T>(cmem_factors[cmem_idx + i])), alpha);
+  }
+
+  d_sums[row] += sum;
+}
 
 template<typename T>
 __global__
+void BlockDiagsColSumsKernel(T *d_sums,
+			     size_t ndiags,
+			     size_t nrows,
+			     size_t ncols,
+			     size_t cmem_idx,
+			     T alpha)
+{
+  ssize_t col = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(col >= ncols)
+    return;
+
+  T sum = 0;
+  for(size_t i = 0; i < ndiags; i++)
+  {
+    ssize_t ofs = cmem_offsets[cmem_idx + i];
+    
+    if(ofs <= col && (col - ofs) < nrows && (col - ofs) >= 0)
+    {
+      sum += pow(fabs(static_cast<T>(cmem_factors[cmem_idx + i])), alpha);
+    }
+
+    if(ofs > col)
+      break;
+  }
+
+  d_sums[col] += sum;
+}
+
+template<typename T, class EPILOGUE>
+__global__
 void BlockDiagsKernel(T *d_res,
 		      const T *d_rhs,
 		      size_t ndiags,
 		      size_t nrows,
 		      size_t ncols,
-		      size_t cmem_idx)
+		      size_t cmem_idx,
+		      EPILOGUE epilogue)
 {
   size_t row = threadIdx.x + blockIdx.x * blockDim.x;
 
@@ -61,17 +167,20 @@ void BlockDiagsKernel(T *d_res,
     result += d_rhs[col] * cmem_factors[cmem_idx + i];
   }
 
-  d_res[row] += result;
+  const T v = d_res[row] + result;
+  d_res[row] = v;
+  epilogue(row, v);
 }
 
-template<typename T>
+template<typename T, class EPILOGUE>
 __global__
 void BlockDiagsAdjointKernel(T *d_res,
 			     const T *d_rhs,
 			     size_t ndiags,
 			     size_t nrows,
 			     size_t ncols,
-			     size_t cmem_idx)
+			     size_t cmem_idx,
+			     EPILOGUE epilogue)
 {
   ssize_t col = threadIdx.x + blockIdx.x * blockDim.x;
 
@@ -92,7 +201,9 @@ void BlockDiagsAdjointKernel(T *d_res,
       break;
   }
 
-  d_res[col] += result;
+  const T v = d_res[col] + result;
+  d_res[col] = v;
+  epilogue(col, v);
 }
 
 template<typename T>
@@ -103,20 +214,60 @@ BlockDiags<T>::BlockDiags(size_t row,
 			  size_t ndiags,
 			  const std::vector<ssize_t>& offsets,
 			  const std::vector<T>& factors)
-  : Block<T>(row, col, nrows, ncols), cmem_offset_(0), ndiags_(ndiags), offsets_(offsets)
+  : Block<T>(row, col, nrows, ncols), cmem_offset_(0), cmem_device_(-1), ndiags_(ndiags), offsets_(offsets)
 {
   factors_ = std::vector<float>(factors.begin(), factors.end());
 
+  factor_order_.resize(factors.size());
+  for(size_t i = 0; i < factors.size(); i++)
+    factor_order_[i] = i;
+
   // bubble sort, sort according to offsets 
   for(size_t i = 0; i < factors.size(); i++) {
     for(size_t j = i; j < offsets.size(); j++) {
       if(offsets_[i] > offsets_[j]) {
         std::swap(offsets_[i], offsets_[j]);
         std::swap(factors_[i], factors_[j]);
+        std::swap(factor_order_[i], factor_order_[j]);
       }
     }
   }
 }
+
+template<typename T>
+BlockDiags<T>::~BlockDiags()
+{
+  Release();
+}
+
+template<typename T>
+void BlockDiags<T>::ResetConstMem()
+{
+  std::lock_guard<std::mutex> lock(cmem_mutex);
+  cmem_used.clear();
+}
+
+template<typename T>
+void BlockDiags<T>::SetFactors(const std::vector<T>& factors, cudaStream_t stream)
+{
+  if(factors.size() != factors_.size())
+    throw Exception("BlockDiags: the number of factors must not change.");
+
+  // same order as the sorted offsets
+  for(size_t i = 0; i < factors_.size(); i++)
+    factors_[i] = factors[factor_order_[i]];
+
+  // the slots of a released block may belong to another one by now
+  if(cmem_device_ < 0)
+    return;
+
+  cudaMemcpyToSymbolAsync(cmem_factors,
+			  &factors_[0],
+			  sizeof(float) * ndiags_,
+			  cmem_offset_ * sizeof(float),
+			  cudaMemcpyHostToDevice,
+			  stream);
+}
   
 template<typename T>
 T BlockDiags<T>::row_sum(size_t row, T alpha) const
@@ -164,12 +315,18 @@ T BlockDiags<T>::col_sum(size_t col, T alpha) const
 template<typename T>
 void BlockDiags<T>::Initialize()
 {
-  cmem_offset_ = cmem_counter_;
-  cmem_counter_ += ndiags_;
+  // a repeated Initialize() keeps its slots if the device did not change
+  int device;
+  cudaGetDevice(&device);
 
-  if(cmem_counter_ >= kMaxNumberOfDiagonals) 
+  if(cmem_device_ != device)
   {
-    throw Exception("Out of constant memory. Too many BlockDiags or too many diagonals.");
+    Release();
+
+    if(ndiags_ > 0 && !AllocateConstMem(device, ndiags_, cmem_offset_))
+      throw Exception("Out of constant memory. Too many BlockDiags or too many diagonals.");
+
+    cmem_device_ = device;
   }
 
   cudaMemcpyToSymbol(cmem_factors,
@@ -183,40 +340,174 @@ void BlockDiags<T>::Initialize()
 		     cmem_offset_ * sizeof(size_t)); 
 }
   
+template<typename T>
+void BlockDiags<T>::Release()
+{
+  if(cmem_device_ < 0)
+    return;
+
+  FreeConstMem(cmem_device_, cmem_offset_, ndiags_);
+  cmem_device_ = -1;
+}
+  
+template<typename T>
+template<class EPILOGUE>
+void BlockDiags<T>::Launch(T *d_res,
+			   const T *d_rhs,
+			   bool adjoint,
+			   const EPILOGUE& epilogue,
+			   cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+
+  if(adjoint)
+  {
+    dim3 grid((this->ncols() + block.x - 1) / block.x, 1, 1);
+
+    BlockDiagsAdjointKernel<T, EPILOGUE>
+      <<<grid, block, 0, stream>>>(d_res,
+			d_rhs,
+			ndiags_,
+			this->nrows(),
+			this->ncols(),
+			cmem_offset_,
+			epilogue);
+  }
+  else
+  {
+    dim3 grid((this->nrows() + block.x - 1) / block.x, 1, 1);
+
+    BlockDiagsKernel<T, EPILOGUE>
+      <<<grid, block, 0, stream>>>(d_res,
+			d_rhs,
+			ndiags_,
+			this->nrows(),
+			this->ncols(),
+			cmem_offset_,
+			epilogue);
+  }
+}
+
 template<typename T>
 void BlockDiags<T>::EvalLocalAdd(const typename device_vector<T>::iterator& res_begin,
 				 const typename device_vector<T>::iterator& res_end,
 				 const typename device_vector<T>::const_iterator& rhs_begin,
-				 const typename device_vector<T>::const_iterator& rhs_end)
+				 const typename device_vector<T>::const_iterator& rhs_end,
+				 cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->nrows() + block.x - 1) / block.x, 1, 1);
-
-  BlockDiagsKernel<T>
-    <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
-		      thrust::raw_pointer_cast(&(*rhs_begin)),
-		      ndiags_,
-		      this->nrows(),
-		      this->ncols(),
-		      cmem_offset_);
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+	 thrust::raw_pointer_cast(&(*rhs_begin)),
+	 false,
+	 NoEpilogue<T>(),
+	 stream);
 }
 
 template<typename T>
 void BlockDiags<T>::EvalAdjointLocalAdd(const typename device_vector<T>::iterator& res_begin,
 					const typename device_vector<T>::iterator& res_end,
 					const typename device_vector<T>::const_iterator& rhs_begin,
-					const typename device_vector<T>::const_iterator& rhs_end)
+					const typename device_vector<T>::const_iterator& rhs_end,
+					cudaStream_t stream)
+{
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+	 thrust::raw_pointer_cast(&(*rhs_begin)),
+	 true,
+	 NoEpilogue<T>(),
+	 stream);
+}
+
+template<typename T>
+void BlockDiags<T>::EvalLocalAddEpilogue(const typename device_vector<T>::iterator& res_begin,
+					 const typename device_vector<T>::iterator& res_end,
+					 const typename device_vector<T>::const_iterator& rhs_begin,
+					 const typename device_vector<T>::const_iterator& rhs_end,
+					 const Epilogue<T>& epilogue,
+					 cudaStream_t stream)
+{
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+	 thrust::raw_pointer_cast(&(*rhs_begin)),
+	 false,
+	 epilogue,
+	 stream);
+}
+
+template<typename T>
+void BlockDiags<T>::EvalAdjointLocalAddEpilogue(const typename device_vector<T>::iterator& res_begin,
+						const typename device_vector<T>::iterator& res_end,
+						const typename device_vector<T>::const_iterator& rhs_begin,
+						const typename device_vector<T>::const_iterator& rhs_end,
+						const Epilogue<T>& epilogue,
+						cudaStream_t stream)
+{
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+	 thrust::raw_pointer_cast(&(*rhs_begin)),
+	 true,
+	 epilogue,
+	 stream);
+}
+
+template<typename T>
+void BlockDiags<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
 {
   dim3 block(kBlockSizeCUDA, 1, 1);
   dim3 grid((this->nrows() + block.x - 1) / block.x, 1, 1);
 
-  BlockDiagsAdjointKernel<T>
-    <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
-		      thrust::raw_pointer_cast(&(*rhs_begin)),
-		      ndiags_,
-		      this->nrows(),
-		      this->ncols(),
-		      cmem_offset_);
+  BlockDiagsRowSumsKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      ndiags_,
+      this->nrows(),
+      this->ncols(),
+      cmem_offset_,
+      alpha);
+
+  BlockSumsCheckError("BlockDiags");
+}
+
+template<typename T>
+void BlockDiags<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((this->ncols() + block.x - 1) / block.x, 1, 1);
+
+  BlockDiagsColSumsKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*sums_begin)),
+      ndiags_,
+      this->nrows(),
+      this->ncols(),
+      cmem_offset_,
+      alpha);
+
+  BlockSumsCheckError("BlockDiags");
+}
+
+template<typename T>
+bool BlockDiags<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  for(size_t r = 0; r < this->nrows(); r++)
+    for(size_t i = 0; i < ndiags_; i++)
+    {
+      const ssize_t c = r + offsets_[i];
+
+      if(c < 0 || c >= static_cast<ssize_t>(this->ncols()))
+        continue;
+
+      rows.push_back(this->row() + r);
+      cols.push_back(this->col() + c);
+      vals.push_back(factors_[i]);
+    }
+
+  return true;
 }
 
 // Explicit template instantiation
@@ -19,6 +19,8 @@
 */
 
 #include "prost/linop/block_gradient2d.hpp"
+#include "prost/linop/block_sums.hpp"
+#include "prost/linop/block_gradient_tiled.hpp"
 
 namespace prost {
 
@@ -167,15 +169,28 @@ void BlockGradient2D<T>::EvalLocalAdd(
   const typename device_vector<T>::iterator& res_begin,
   const typename device_vector<T>::iterator& res_end,
   const typename device_vector<T>::const_iterator& rhs_begin,
-  const typename device_vector<T>::const_iterator& rhs_end)
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
+  if(LaunchBlockGradientTiled<T, false, NoEpilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+				       thrust::raw_pointer_cast(&(*rhs_begin)),
+				       nx_,
+				       ny_,
+				       L_,
+				       label_first_,
+				       false,
+				       NoEpilogue<T>(),
+				       stream))
+    return;
+
+  // volume exceeds the grid limits of the tiled kernel
   dim3 block(1, 128, 1);
   dim3 grid((nx_ + block.x - 1) / block.x,
 	    (ny_*L_ + block.y - 1) / block.y,
 	    1);
 
   BlockGradient2DKernel<T>
-    <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+    <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 		      thrust::raw_pointer_cast(&(*rhs_begin)),
 		      nx_,
 		      ny_,
@@ -188,15 +203,28 @@ void BlockGradient2D<T>::EvalAdjointLocalAdd(
   const typename device_vector<T>::iterator& res_begin,
   const typename device_vector<T>::iterator& res_end,
   const typename device_vector<T>::const_iterator& rhs_begin,
-  const typename device_vector<T>::const_iterator& rhs_end)
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
+  if(LaunchBlockGradientTiled<T, false, NoEpilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+				       thrust::raw_pointer_cast(&(*rhs_begin)),
+				       nx_,
+				       ny_,
+				       L_,
+				       label_first_,
+				       true,
+				       NoEpilogue<T>(),
+				       stream))
+    return;
+
+  // volume exceeds the grid limits of the tiled kernel
   dim3 block(2, 128, 1);
   dim3 grid((nx_ + block.x - 1) / block.x,
 	    (ny_*L_ + block.y - 1) / block.y,
 	    1);
 
   BlockGradient2DKernelAdjoint<T>
-    <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+    <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 		      thrust::raw_pointer_cast(&(*rhs_begin)),
 		      nx_,
 		      ny_,
@@ -204,6 +232,72 @@ void BlockGradient2D<T>::EvalAdjointLocalAdd(
 		      label_first_);
 }
   
+template<typename T>
+void BlockGradient2D<T>::EvalLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(LaunchBlockGradientTiled<T, false, Epilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+					 thrust::raw_pointer_cast(&(*rhs_begin)),
+					 nx_,
+					 ny_,
+					 L_,
+					 label_first_,
+					 false,
+					 epilogue,
+					 stream))
+    return;
+
+  EvalLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  ApplyEpilogue(thrust::raw_pointer_cast(&(*res_begin)), res_end - res_begin, epilogue, stream);
+}
+
+template<typename T>
+void BlockGradient2D<T>::EvalAdjointLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(LaunchBlockGradientTiled<T, false, Epilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+					 thrust::raw_pointer_cast(&(*rhs_begin)),
+					 nx_,
+					 ny_,
+					 L_,
+					 label_first_,
+					 true,
+					 epilogue,
+					 stream))
+    return;
+
+  EvalAdjointLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  ApplyEpilogue(thrust::raw_pointer_cast(&(*res_begin)), res_end - res_begin, epilogue, stream);
+}
+
+template<typename T>
+void BlockGradient2D<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsConstant<T>(sums_begin, this->nrows(), row_sum(0, alpha), stream);
+}
+
+template<typename T>
+void BlockGradient2D<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsConstant<T>(sums_begin, this->ncols(), col_sum(0, alpha), stream);
+}
+
 // Explicit template instantiation
 template class BlockGradient2D<float>;
 template class BlockGradient2D<double>;
@@ -19,6 +19,8 @@
 */
 
 #include "prost/linop/block_gradient3d.hpp"
+#include "prost/linop/block_sums.hpp"
+#include "prost/linop/block_gradient_tiled.hpp"
 
 namespace prost {
 
@@ -178,8 +180,21 @@ void BlockGradient3D<T>::EvalLocalAdd(
   const typename device_vector<T>::iterator& res_begin,
   const typename device_vector<T>::iterator& res_end,
   const typename device_vector<T>::const_iterator& rhs_begin,
-  const typename device_vector<T>::const_iterator& rhs_end)
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
+  if(LaunchBlockGradientTiled<T, true, NoEpilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+				       thrust::raw_pointer_cast(&(*rhs_begin)),
+				       nx_,
+				       ny_,
+				       L_,
+				       label_first_,
+				       false,
+				       NoEpilogue<T>(),
+				       stream))
+    return;
+
+  // volume exceeds the grid limits of the tiled kernel
   if(!label_first_)
   {
     dim3 block(1, 128, 1);
@@ -188,7 +203,7 @@ void BlockGradient3D<T>::EvalLocalAdd(
 	      1);
 
     BlockGradient3DKernel<T, false>
-      <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+      <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 			thrust::raw_pointer_cast(&(*rhs_begin)),
 			nx_,
 			ny_,
@@ -202,7 +217,7 @@ void BlockGradient3D<T>::EvalLocalAdd(
 	      1);
 
     BlockGradient3DKernel<T, true>
-      <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+      <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 			thrust::raw_pointer_cast(&(*rhs_begin)),
 			nx_,
 			ny_,
@@ -215,8 +230,21 @@ void BlockGradient3D<T>::EvalAdjointLocalAdd(
   const typename device_vector<T>::iterator& res_begin,
   const typename device_vector<T>::iterator& res_end,
   const typename device_vector<T>::const_iterator& rhs_begin,
-  const typename device_vector<T>::const_iterator& rhs_end)
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
+  if(LaunchBlockGradientTiled<T, true, NoEpilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+				       thrust::raw_pointer_cast(&(*rhs_begin)),
+				       nx_,
+				       ny_,
+				       L_,
+				       label_first_,
+				       true,
+				       NoEpilogue<T>(),
+				       stream))
+    return;
+
+  // volume exceeds the grid limits of the tiled kernel
   if(!label_first_)
   {
     dim3 block(2, 128, 1);
@@ -225,7 +253,7 @@ void BlockGradient3D<T>::EvalAdjointLocalAdd(
       1);
 
     BlockGradient3DKernelAdjoint<T, false>
-      <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+      <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 			thrust::raw_pointer_cast(&(*rhs_begin)),
 			nx_,
 			ny_,
@@ -239,7 +267,7 @@ void BlockGradient3D<T>::EvalAdjointLocalAdd(
       1);
 
     BlockGradient3DKernelAdjoint<T, true>
-      <<<grid, block>>>(thrust::raw_pointer_cast(&(*res_begin)),
+      <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(&(*res_begin)),
 			thrust::raw_pointer_cast(&(*rhs_begin)),
 			nx_,
 			ny_,
@@ -247,6 +275,72 @@ void BlockGradient3D<T>::EvalAdjointLocalAdd(
   }
 }
   
+template<typename T>
+void BlockGradient3D<T>::EvalLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(LaunchBlockGradientTiled<T, true, Epilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+					 thrust::raw_pointer_cast(&(*rhs_begin)),
+					 nx_,
+					 ny_,
+					 L_,
+					 label_first_,
+					 false,
+					 epilogue,
+					 stream))
+    return;
+
+  EvalLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  ApplyEpilogue(thrust::raw_pointer_cast(&(*res_begin)), res_end - res_begin, epilogue, stream);
+}
+
+template<typename T>
+void BlockGradient3D<T>::EvalAdjointLocalAddEpilogue(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(LaunchBlockGradientTiled<T, true, Epilogue<T> >(thrust::raw_pointer_cast(&(*res_begin)),
+					 thrust::raw_pointer_cast(&(*rhs_begin)),
+					 nx_,
+					 ny_,
+					 L_,
+					 label_first_,
+					 true,
+					 epilogue,
+					 stream))
+    return;
+
+  EvalAdjointLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  ApplyEpilogue(thrust::raw_pointer_cast(&(*res_begin)), res_end - res_begin, epilogue, stream);
+}
+
+template<typename T>
+void BlockGradient3D<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsConstant<T>(sums_begin, this->nrows(), row_sum(0, alpha), stream);
+}
+
+template<typename T>
+void BlockGradient3D<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsConstant<T>(sums_begin, this->ncols(), col_sum(0, alpha), stream);
+}
+
 // Explicit template instantiation
 template class BlockGradient3D<float>;
 template class BlockGradient3D<double>;
@@ -19,51 +19,14 @@
 */
 
 #include "prost/linop/block_id_kron_dense.hpp"
+#include "prost/linop/block_sums.hpp"
+#include "prost/linop/dense_gemm.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost
 {
 
-template<typename T, bool transpose>
-__global__ void BlockIdKronDenseKernel(
-    T *result,
-    const T *rhs,
-    size_t diaglength,
-    size_t nrows,
-    size_t ncols,
-    const T *data)
-{
-  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
-
-  if(!transpose) {
-    if(tx < diaglength * nrows) {
-      size_t row = tx % nrows;
-      size_t col_ofs = (tx / nrows) * ncols;
-
-      T sum = 0;
-      for(int32_t i = 0; i < ncols; i++) {
-	sum += data[i * nrows + row] * rhs[col_ofs + i];
-      }
-
-      result[tx] += sum;
-    }
-  }
-  else {
-    if(tx < diaglength * ncols) {
-      size_t col = tx % ncols;
-      size_t row_ofs = (tx / ncols) * nrows;
-
-      T sum = 0;
-      for(int32_t i = 0; i < nrows; i++) {
-	sum += data[i + col * nrows] * rhs[row_ofs + i];
-      }
-
-      result[tx] += sum;
-    }
-  }
-}
-
 template<typename T>
 BlockIdKronDense<T>::BlockIdKronDense(size_t row, size_t col, size_t nrows, size_t ncols)
     : Block<T>(row, col, nrows, ncols)
@@ -126,34 +89,36 @@ size_t BlockIdKronDense<T>::gpu_mem_amount() const
   return host_data_.size() * sizeof(T);
 }
 
+template<typename T>
+void BlockIdKronDense<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  PrefetchOperatorVector(data_, device, stream);
+}
+
 template<typename T>
 void BlockIdKronDense<T>::EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->nrows() + block.x) / block.x, 1, 1);
-
-  BlockIdKronDenseKernel<T, false>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_nrows_,
-          mat_ncols_,
-          thrust::raw_pointer_cast(data_.data()));
-  cudaDeviceSynchronize();
-
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
-  {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockIdKronDense (forward): CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
-  }
+  // kron(I, M) x = vec(M X) with X the column-major mat_ncols_ x
+  // diaglength matrix holding x. All diagonal blocks share M, so the
+  // batch collapses into a single GEMM.
+  DenseGemm::Multiply<T>(this->context(), false, false,
+    static_cast<int>(mat_nrows_),
+    static_cast<int>(diaglength_),
+    static_cast<int>(mat_ncols_),
+    1,
+    thrust::raw_pointer_cast(data_.data()),
+    static_cast<int>(mat_nrows_),
+    thrust::raw_pointer_cast(&(*rhs_begin)),
+    static_cast<int>(mat_ncols_),
+    1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    static_cast<int>(mat_nrows_),
+    stream);
 }
 
 template<typename T>
@@ -161,29 +126,85 @@ void BlockIdKronDense<T>::EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  // kron(I, M)^T y = vec(M^T Y)
+  DenseGemm::Multiply<T>(this->context(), true, false,
+    static_cast<int>(mat_ncols_),
+    static_cast<int>(diaglength_),
+    static_cast<int>(mat_nrows_),
+    1,
+    thrust::raw_pointer_cast(data_.data()),
+    static_cast<int>(mat_nrows_),
+    thrust::raw_pointer_cast(&(*rhs_begin)),
+    static_cast<int>(mat_nrows_),
+    1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    static_cast<int>(mat_ncols_),
+    stream);
+}
+
+template<typename T>
+void BlockIdKronDense<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->ncols() + block.x) / block.x, 1, 1);
-
-  BlockIdKronDenseKernel<T, true>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_nrows_,
-          mat_ncols_,
-          thrust::raw_pointer_cast(data_.data()));
-  cudaDeviceSynchronize();
-
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
-  {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockIdKronDense (adjoint): CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
-  }
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->nrows(),
+    1,
+    mat_nrows_,
+    1,
+    mat_nrows_,
+    mat_ncols_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+void BlockIdKronDense<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsDense<T>(
+    sums_begin,
+    data_,
+    this->ncols(),
+    1,
+    mat_ncols_,
+    mat_nrows_,
+    1,
+    mat_nrows_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+bool BlockIdKronDense<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  // (I kron A)_{k m + r, k n + c} = A_{r c}
+  for(size_t k = 0; k < diaglength_; k++)
+    for(size_t c = 0; c < mat_ncols_; c++)
+      for(size_t r = 0; r < mat_nrows_; r++)
+      {
+        const T val = host_data_[c * mat_nrows_ + r];
+
+        if(val != 0)
+        {
+          rows.push_back(this->row() + k * mat_nrows_ + r);
+          cols.push_back(this->col() + k * mat_ncols_ + c);
+          vals.push_back(val);
+        }
+      }
+
+  return true;
 }
 
 // Explicit template instantiation
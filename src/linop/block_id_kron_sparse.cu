@@ -19,12 +19,13 @@
 */
 
 #include "prost/linop/block_id_kron_sparse.hpp"
+#include "prost/linop/block_sums.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
 
-template<typename T>
+template<typename T, class EPILOGUE>
 __global__ void BlockIdKronSparseKernel(
     T *result,
     const T *rhs,
@@ -33,7 +34,8 @@ __global__ void BlockIdKronSparseKernel(
     size_t ncols,
     const int32_t *ind,
     const int32_t *ptr,
-    const float *val)
+    const T *val,
+    EPILOGUE epilogue)
 {
   const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
 
@@ -48,7 +50,9 @@ __global__ void BlockIdKronSparseKernel(
     for(int32_t i = ptr[row]; i < stop; i++)
       sum += val[i] * rhs[ind[i] + col_ofs];
 
-    result[tx] += sum;
+    const T v = result[tx] + sum;
+    result[tx] = v;
+    epilogue(tx, v);
   }
 }
 
@@ -80,7 +84,7 @@ BlockIdKronSparse<T> *BlockIdKronSparse<T>::CreateFromCSC(
   // create data on host
   block->host_ind_t_ = ind; 
   block->host_ptr_t_ = ptr; 
-  block->host_val_t_ = std::vector<float>(val.begin(), val.end()); 
+  block->host_val_t_ = val; 
 
   block->host_ind_.resize(block->mat_nnz_);
   block->host_val_.resize(block->mat_nnz_);
@@ -103,24 +107,29 @@ BlockIdKronSparse<T> *BlockIdKronSparse<T>::CreateFromCSC(
 template<typename T>
 void BlockIdKronSparse<T>::Initialize()
 {
-  // forward
-  ind_.resize(mat_nnz_);
-  val_.resize(mat_nnz_);
-  ptr_.resize(mat_nrows_ + 1);
-
-  // transpose
-  ind_t_.resize(mat_nnz_);
-  val_t_.resize(mat_nnz_);
-  ptr_t_.resize(mat_ncols_ + 1);
-
-  // copy to GPU
-  thrust::copy(host_ind_t_.begin(), host_ind_t_.end(), ind_t_.begin());
-  thrust::copy(host_ptr_t_.begin(), host_ptr_t_.end(), ptr_t_.begin());
-  thrust::copy(host_val_t_.begin(), host_val_t_.end(), val_t_.begin());
+  ExecutionContext& context = this->context();
+
+  mat_.Initialize(
+    context.cusparse(context.stream()),
+    mat_nrows_,
+    mat_ncols_,
+    mat_nnz_,
+    host_val_,
+    host_ptr_,
+    host_ind_,
+    host_val_t_,
+    host_ptr_t_,
+    host_ind_t_,
+    false);
+
+  // the input holds diaglength column-major blocks of size mat_ncols_
+  mat_.InitializeDense(context.cusparse(context.stream()), diaglength_, false);
+}
 
-  thrust::copy(host_ind_.begin(), host_ind_.end(), ind_.begin());
-  thrust::copy(host_ptr_.begin(), host_ptr_.end(), ptr_.begin());
-  thrust::copy(host_val_.begin(), host_val_.end(), val_.begin());
+template<typename T>
+void BlockIdKronSparse<T>::Release()
+{
+  mat_.Release();
 }
 
 template<typename T>
@@ -152,7 +161,77 @@ T BlockIdKronSparse<T>::col_sum(size_t col, T alpha) const
 template<typename T>
 size_t BlockIdKronSparse<T>::gpu_mem_amount() const
 {
-  return (host_ind_.size() + host_ind_t_.size() + host_ptr_.size() + host_ptr_t_.size()) * sizeof(int32_t) + (host_val_.size() + host_val_t_.size()) * sizeof(T);
+  return mat_.gpu_mem_amount();
+}
+
+template<typename T>
+void BlockIdKronSparse<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  mat_.Prefetch(device, transpose, stream);
+}
+
+template<typename T>
+template<class EPILOGUE>
+void BlockIdKronSparse<T>::Launch(
+    T *d_res,
+    const T *d_rhs,
+    bool adjoint,
+    const EPILOGUE& epilogue,
+    cudaStream_t stream)
+{
+  if(!adjoint)
+  {
+    dim3 block(kBlockSizeCUDA, 1, 1);
+    dim3 grid((this->nrows() + block.x) / block.x, 1, 1);
+
+    BlockIdKronSparseKernel<T, EPILOGUE>
+        <<<grid, block, 0, stream>>>(
+            d_res,
+            d_rhs,
+            diaglength_,
+            mat_nrows_,
+            mat_ncols_,
+            thrust::raw_pointer_cast(mat_.ind().data()),
+            thrust::raw_pointer_cast(mat_.ptr().data()),
+            thrust::raw_pointer_cast(mat_.val().data()),
+            epilogue);
+
+    cudaError_t error = cudaGetLastError();
+    if(error != cudaSuccess)
+    {
+      // print the CUDA error message and throw exception
+      std::stringstream ss;
+      ss << "BlockIdKronSparse: CUDA error: " << cudaGetErrorString(error) << std::endl;
+      throw Exception(ss.str());
+    }
+  }
+  else
+  {
+    dim3 block(kBlockSizeCUDA, 1, 1);
+    dim3 grid((this->ncols() + block.x) / block.x, 1, 1);
+
+    BlockIdKronSparseKernel<T, EPILOGUE>
+        <<<grid, block, 0, stream>>>(
+            d_res,
+            d_rhs,
+            diaglength_,
+            mat_ncols_,
+            mat_nrows_,
+            thrust::raw_pointer_cast(mat_.ind_t().data()),
+            thrust::raw_pointer_cast(mat_.ptr_t().data()),
+            thrust::raw_pointer_cast(mat_.val_t().data()),
+            epilogue);
+
+    // check for error  
+    cudaError_t error = cudaGetLastError();
+    if(error != cudaSuccess)
+    {
+      // print the CUDA error message and throw exception
+      std::stringstream ss;
+      ss << "BlockIdKronSparse: CUDA error: " << cudaGetErrorString(error) << std::endl;
+      throw Exception(ss.str());
+    }
+  }
 }
 
 template<typename T>
@@ -160,31 +239,23 @@ void BlockIdKronSparse<T>::EvalLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
-{
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->nrows() + block.x) / block.x, 1, 1);
-
-  BlockIdKronSparseKernel<T>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_nrows_,
-          mat_ncols_,
-          thrust::raw_pointer_cast(ind_.data()),
-          thrust::raw_pointer_cast(ptr_.data()),
-          thrust::raw_pointer_cast(val_.data()));
-  cudaDeviceSynchronize();
-
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  if(mat_.supports_dense())
   {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockIdKronSparse: CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
+    mat_.MultiplyDense(this->context().cusparse(stream), false, 1,
+      thrust::raw_pointer_cast(&(*rhs_begin)), 1,
+      thrust::raw_pointer_cast(&(*res_begin)),
+      stream);
+    return;
   }
+
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+         thrust::raw_pointer_cast(&(*rhs_begin)),
+         false,
+         NoEpilogue<T>(),
+         stream);
 }
 
 template<typename T>
@@ -192,32 +263,108 @@ void BlockIdKronSparse<T>::EvalAdjointLocalAdd(
     const typename device_vector<T>::iterator& res_begin,
     const typename device_vector<T>::iterator& res_end,
     const typename device_vector<T>::const_iterator& rhs_begin,
-    const typename device_vector<T>::const_iterator& rhs_end)
-{
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->ncols() + block.x) / block.x, 1, 1);
-
-  BlockIdKronSparseKernel<T>
-      <<<grid, block>>>(
-          thrust::raw_pointer_cast(&(*res_begin)),
-          thrust::raw_pointer_cast(&(*rhs_begin)),
-          diaglength_,
-          mat_ncols_,
-          mat_nrows_,
-          thrust::raw_pointer_cast(ind_t_.data()),
-          thrust::raw_pointer_cast(ptr_t_.data()),
-          thrust::raw_pointer_cast(val_t_.data()));
-  cudaDeviceSynchronize();
-
-  // check for error  
-  cudaError_t error = cudaGetLastError();
-  if(error != cudaSuccess)
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  if(mat_.supports_dense())
   {
-    // print the CUDA error message and throw exception
-    std::stringstream ss;
-    ss << "BlockIdKronSparse: CUDA error: " << cudaGetErrorString(error) << std::endl;
-    throw Exception(ss.str());
+    mat_.MultiplyDense(this->context().cusparse(stream), true, 1,
+      thrust::raw_pointer_cast(&(*rhs_begin)), 1,
+      thrust::raw_pointer_cast(&(*res_begin)),
+      stream);
+    return;
   }
+
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+         thrust::raw_pointer_cast(&(*rhs_begin)),
+         true,
+         NoEpilogue<T>(),
+         stream);
+}
+
+template<typename T>
+void BlockIdKronSparse<T>::EvalLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream)
+{
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+         thrust::raw_pointer_cast(&(*rhs_begin)),
+         false,
+         epilogue,
+         stream);
+}
+
+template<typename T>
+void BlockIdKronSparse<T>::EvalAdjointLocalAddEpilogue(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    const Epilogue<T>& epilogue,
+    cudaStream_t stream)
+{
+  Launch(thrust::raw_pointer_cast(&(*res_begin)),
+         thrust::raw_pointer_cast(&(*rhs_begin)),
+         true,
+         epilogue,
+         stream);
+}
+
+template<typename T>
+void BlockIdKronSparse<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsCSR<T, T>(
+    sums_begin,
+    mat_.ptr(),
+    mat_.val(),
+    this->nrows(),
+    1,
+    mat_nrows_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+void BlockIdKronSparse<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsCSR<T, T>(
+    sums_begin,
+    mat_.ptr_t(),
+    mat_.val_t(),
+    this->ncols(),
+    1,
+    mat_ncols_,
+    alpha,
+    stream);
+}
+
+template<typename T>
+bool BlockIdKronSparse<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  // (I kron A)_{k m + r, k n + c} = A_{r c}
+  for(size_t k = 0; k < diaglength_; k++)
+    for(size_t r = 0; r < mat_nrows_; r++)
+      for(int32_t i = host_ptr_[r]; i < host_ptr_[r + 1]; i++)
+      {
+        rows.push_back(this->row() + k * mat_nrows_ + r);
+        cols.push_back(this->col() + k * mat_ncols_ + host_ind_[i]);
+        vals.push_back(host_val_[i]);
+      }
+
+  return true;
 }
 
 // Explicit template instantiation
@@ -0,0 +1,377 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+
+#include <thrust/fill.h>
+#include <thrust/functional.h>
+#include <thrust/reduce.h>
+#include <thrust/transform.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include "prost/linop/block_product.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+struct BlockProductPow
+{
+  BlockProductPow(T alpha) : alpha(alpha) { }
+
+  __host__ __device__ T operator()(const T& x) const
+  {
+    return pow(x, alpha);
+  }
+
+  T alpha;
+};
+
+template<typename T>
+struct BlockProductAxpy
+{
+  BlockProductAxpy(T c) : c(c) { }
+
+  __host__ __device__ T operator()(const T& x, const T& y) const
+  {
+    return c * x + y;
+  }
+
+  T c;
+};
+
+template<typename T>
+static const vector<shared_ptr<Block<T>>>& CheckFactors(const vector<shared_ptr<Block<T>>>& factors)
+{
+  if(factors.empty())
+    throw Exception("BlockProduct: at least one factor is required.");
+
+  for(size_t i = 1; i < factors.size(); i++)
+  {
+    if(factors[i - 1]->ncols() != factors[i]->nrows())
+    {
+      std::ostringstream ss;
+      ss << "BlockProduct: factor " << i - 1 << " has " << factors[i - 1]->ncols();
+      ss << " columns, but factor " << i << " has " << factors[i]->nrows() << " rows.";
+      throw Exception(ss.str());
+    }
+  }
+
+  return factors;
+}
+
+template<typename T>
+BlockProduct<T>::BlockProduct(
+  size_t row,
+  size_t col,
+  const vector<shared_ptr<Block<T>>>& factors)
+  : Block<T>(row, col, 
+             CheckFactors(factors).front()->nrows(), 
+             factors.back()->ncols()),
+    factors_(factors),
+    row_bound_alpha_(std::numeric_limits<T>::quiet_NaN()), row_bound_(0),
+    col_bound_alpha_(std::numeric_limits<T>::quiet_NaN()), col_bound_(0)
+{
+}
+
+template<typename T>
+void BlockProduct<T>::Initialize()
+{
+  for(auto& factor : factors_)
+  {
+    // the factors use the handles of the product
+    if(Block<T>::context_)
+      factor->set_context(Block<T>::context_);
+
+    factor->Initialize();
+  }
+
+  scratch_.resize(factors_.size() - 1);
+  for(size_t i = 0; i < scratch_.size(); i++)
+    scratch_[i].resize(factors_[i]->ncols());
+}
+
+template<typename T>
+void BlockProduct<T>::Release()
+{
+  for(auto& factor : factors_)
+    factor->Release();
+
+  scratch_.clear();
+  scratch_.shrink_to_fit();
+}
+
+template<typename T>
+void BlockProduct<T>::Update()
+{
+  for(auto& factor : factors_)
+    factor->Update();
+
+  // the bounds have to be recomputed from the new data
+  row_bound_alpha_ = col_bound_alpha_ = std::numeric_limits<T>::quiet_NaN();
+}
+
+template<typename T>
+T BlockProduct<T>::FactorSum(size_t factor, size_t idx, T alpha, bool by_cols) const
+{
+  if(alpha <= 1)
+  {
+    return by_cols ? 
+      factors_[factor]->col_sum(idx, alpha) : 
+      factors_[factor]->row_sum(idx, alpha);
+  }
+
+  const T sum = by_cols ? 
+    factors_[factor]->col_sum(idx, 1) : 
+    factors_[factor]->row_sum(idx, 1);
+
+  return std::pow(sum, alpha);
+}
+
+template<typename T>
+T BlockProduct<T>::TailBound(T alpha, bool by_cols) const
+{
+  T& cached_alpha = by_cols ? col_bound_alpha_ : row_bound_alpha_;
+  T& bound = by_cols ? col_bound_ : row_bound_;
+
+  if(cached_alpha == alpha)
+    return bound;
+
+  // rows are bounded through the factors 1..n-1, columns through 0..n-2
+  const size_t skip = by_cols ? factors_.size() - 1 : 0;
+
+  bound = 1;
+  for(size_t f = 0; f < factors_.size(); f++)
+  {
+    if(f == skip)
+      continue;
+
+    const size_t count = by_cols ? factors_[f]->ncols() : factors_[f]->nrows();
+
+    T max_sum = 0;
+    for(size_t i = 0; i < count; i++)
+      max_sum = std::max(max_sum, FactorSum(f, i, alpha, by_cols));
+
+    bound *= max_sum;
+  }
+
+  cached_alpha = alpha;
+  return bound;
+}
+
+template<typename T>
+void BlockProduct<T>::FactorSums(
+  size_t factor, 
+  device_vector<T>& sums, 
+  T alpha, 
+  bool by_cols, 
+  cudaStream_t stream)
+{
+  Block<T>& block = *factors_[factor];
+
+  sums.resize(by_cols ? block.ncols() : block.nrows());
+  thrust::fill(thrust::cuda::par.on(stream), sums.begin(), sums.end(), static_cast<T>(0));
+
+  const T factor_alpha = (alpha <= 1) ? alpha : 1;
+  if(by_cols)
+    block.ColSumsLocalAdd(sums.begin(), factor_alpha, stream);
+  else
+    block.RowSumsLocalAdd(sums.begin(), factor_alpha, stream);
+
+  if(alpha > 1)
+  {
+    thrust::transform(
+      thrust::cuda::par.on(stream),
+      sums.begin(),
+      sums.end(),
+      sums.begin(),
+      BlockProductPow<T>(alpha));
+  }
+}
+
+template<typename T>
+T BlockProduct<T>::TailBound(T alpha, bool by_cols, cudaStream_t stream)
+{
+  T& cached_alpha = by_cols ? col_bound_alpha_ : row_bound_alpha_;
+  T& bound = by_cols ? col_bound_ : row_bound_;
+
+  if(cached_alpha == alpha)
+    return bound;
+
+  const size_t skip = by_cols ? factors_.size() - 1 : 0;
+  device_vector<T> sums;
+
+  bound = 1;
+  for(size_t f = 0; f < factors_.size(); f++)
+  {
+    if(f == skip)
+      continue;
+
+    FactorSums(f, sums, alpha, by_cols, stream);
+    bound *= thrust::reduce(
+      thrust::cuda::par.on(stream),
+      sums.begin(),
+      sums.end(),
+      static_cast<T>(0),
+      thrust::maximum<T>());
+  }
+
+  cached_alpha = alpha;
+  return bound;
+}
+
+template<typename T>
+void BlockProduct<T>::SumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  bool by_cols,
+  cudaStream_t stream)
+{
+  const T bound = TailBound(alpha, by_cols, stream);
+
+  device_vector<T> sums;
+  FactorSums(by_cols ? factors_.size() - 1 : 0, sums, alpha, by_cols, stream);
+
+  thrust::transform(
+    thrust::cuda::par.on(stream),
+    sums.begin(),
+    sums.end(),
+    sums_begin,
+    sums_begin,
+    BlockProductAxpy<T>(bound));
+}
+
+template<typename T>
+void BlockProduct<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  SumsLocalAdd(sums_begin, alpha, false, stream);
+}
+
+template<typename T>
+void BlockProduct<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  SumsLocalAdd(sums_begin, alpha, true, stream);
+}
+
+template<typename T>
+T BlockProduct<T>::row_sum(size_t row, T alpha) const
+{
+  return FactorSum(0, row, alpha, false) * TailBound(alpha, false);
+}
+
+template<typename T>
+T BlockProduct<T>::col_sum(size_t col, T alpha) const
+{
+  return FactorSum(factors_.size() - 1, col, alpha, true) * TailBound(alpha, true);
+}
+
+template<typename T>
+size_t BlockProduct<T>::gpu_mem_amount() const
+{
+  size_t mem = 0;
+
+  for(auto& factor : factors_)
+    mem += factor->gpu_mem_amount();
+
+  for(size_t i = 0; i + 1 < factors_.size(); i++)
+    mem += factors_[i]->ncols() * sizeof(T);
+
+  return mem;
+}
+
+template<typename T>
+void BlockProduct<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  for(auto& factor : factors_)
+    factor->Prefetch(device, transpose, stream);
+}
+
+template<typename T>
+void BlockProduct<T>::EvalLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
+{
+  const size_t n = factors_.size();
+
+  // apply the factors from right to left, factor i writes scratch_[i - 1]
+  for(size_t i = n - 1; i > 0; i--)
+  {
+    device_vector<T>& out = scratch_[i - 1];
+
+    thrust::fill(thrust::cuda::par.on(stream), out.begin(), out.end(), static_cast<T>(0));
+
+    if(i == n - 1)
+      factors_[i]->EvalLocalAdd(out.begin(), out.end(), rhs_begin, rhs_end, stream);
+    else
+      factors_[i]->EvalLocalAdd(out.begin(), out.end(), scratch_[i].cbegin(), scratch_[i].cend(), stream);
+  }
+
+  if(n == 1)
+    factors_[0]->EvalLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  else
+    factors_[0]->EvalLocalAdd(res_begin, res_end, scratch_[0].cbegin(), scratch_[0].cend(), stream);
+}
+
+template<typename T>
+void BlockProduct<T>::EvalAdjointLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
+{
+  const size_t n = factors_.size();
+
+  // K^T = A_n^T ... A_1^T, factor i writes scratch_[i]
+  for(size_t i = 0; i + 1 < n; i++)
+  {
+    device_vector<T>& out = scratch_[i];
+
+    thrust::fill(thrust::cuda::par.on(stream), out.begin(), out.end(), static_cast<T>(0));
+
+    if(i == 0)
+      factors_[i]->EvalAdjointLocalAdd(out.begin(), out.end(), rhs_begin, rhs_end, stream);
+    else
+      factors_[i]->EvalAdjointLocalAdd(out.begin(), out.end(), scratch_[i - 1].cbegin(), scratch_[i - 1].cend(), stream);
+  }
+
+  if(n == 1)
+    factors_[0]->EvalAdjointLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+  else
+    factors_[n - 1]->EvalAdjointLocalAdd(res_begin, res_end, scratch_[n - 2].cbegin(), scratch_[n - 2].cend(), stream);
+}
+
+// Explicit template instantiation
+template class BlockProduct<float>;
+template class BlockProduct<double>;
+
+} // namespace prost
@@ -23,13 +23,11 @@
 #include <sstream>
 
 #include "prost/linop/block_sparse.hpp"
+#include "prost/linop/block_sums.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
 
-template<> cusparseHandle_t BlockSparse<float>::cusp_handle_ = nullptr;
-template<> cusparseHandle_t BlockSparse<double>::cusp_handle_ = nullptr;
-
 template<typename T>
 BlockSparse<T>* BlockSparse<T>::CreateFromCSC(
   size_t row,
@@ -39,10 +37,12 @@ BlockSparse<T>* BlockSparse<T>::CreateFromCSC(
   int nnz,
   const std::vector<T>& val,
   const std::vector<int32_t>& ptr,
-  const std::vector<int32_t>& ind)
+  const std::vector<int32_t>& ind,
+  bool transpose_spmv)
 {
   BlockSparse<T> *block = new BlockSparse<T>(row, col, m, n);
   block->nnz_ = nnz;
+  block->transpose_spmv_ = transpose_spmv;
 
   // create data on host
   block->host_ind_t_ = ind; 
@@ -64,12 +64,193 @@ BlockSparse<T>* BlockSparse<T>::CreateFromCSC(
     &block->host_ind_[0],
     &block->host_ptr_[0]);
 
+  block->ReleaseHost();
+
+  return block;
+}
+
+template<typename T>
+BlockSparse<T>* BlockSparse<T>::CreateFromTriplets(
+  size_t row,
+  size_t col,
+  int m,
+  int n,
+  const std::vector<int32_t>& rows,
+  const std::vector<int32_t>& cols,
+  const std::vector<T>& vals,
+  bool transpose_spmv)
+{
+  BlockSparse<T> *block = new BlockSparse<T>(row, col, m, n);
+  block->transpose_spmv_ = transpose_spmv;
+  block->SetHostTriplets(rows, cols, vals);
+  block->ReleaseHost();
+
+  return block;
+}
+
+template<typename T>
+BlockSparse<T>* BlockSparse<T>::CreateFromHostCSR(
+  size_t row,
+  size_t col,
+  int m,
+  int n,
+  int nnz,
+  const T *val,
+  const int32_t *ptr,
+  const int32_t *ind,
+  const T *val_t,
+  const int32_t *ptr_t,
+  const int32_t *ind_t,
+  shared_ptr<const void> owner,
+  bool transpose_spmv)
+{
+  BlockSparse<T> *block = new BlockSparse<T>(row, col, m, n);
+  block->nnz_ = nnz;
+  block->transpose_spmv_ = transpose_spmv;
+
+  block->external_val_ = val;
+  block->external_ptr_ = ptr;
+  block->external_ind_ = ind;
+  block->external_val_t_ = val_t;
+  block->external_ptr_t_ = ptr_t;
+  block->external_ind_t_ = ind_t;
+  block->external_owner_ = owner;
+
   return block;
 }
 
+template<typename T>
+void BlockSparse<T>::SetTriplets(
+  const std::vector<int32_t>& rows,
+  const std::vector<int32_t>& cols,
+  const std::vector<T>& vals,
+  cudaStream_t stream)
+{
+  if(vals.size() != nnz_)
+    throw Exception("BlockSparse: the number of nonzeros must not change.");
+
+  SetHostTriplets(rows, cols, vals);
+  mat_.SetValues(host_val_, host_val_t_, stream);
+
+  cached_row_sums_.clear();
+  cached_col_sums_.clear();
+
+  // the block holds its own arrays from now on
+  external_owner_.reset();
+
+  // the upload is asynchronous, keep the host copy until it is done
+  if(transpose_spmv_)
+  {
+    cudaStreamSynchronize(stream);
+    ReleaseHost();
+  }
+}
+
+template<typename T>
+void BlockSparse<T>::SetHostTriplets(
+  const std::vector<int32_t>& rows,
+  const std::vector<int32_t>& cols,
+  const std::vector<T>& vals)
+{
+  const int m = static_cast<int>(this->nrows());
+  const int n = static_cast<int>(this->ncols());
+  const int nnz = static_cast<int>(vals.size());
+
+  // order by rows first, so that the counting sort over the columns
+  // leaves the row indices of each column sorted
+  std::vector<int32_t> row_ptr(m + 1, 0), order(nnz);
+
+  for(int k = 0; k < nnz; k++)
+    row_ptr[rows[k] + 1]++;
+
+  for(int i = 0; i < m; i++)
+    row_ptr[i + 1] += row_ptr[i];
+
+  for(int k = 0; k < nnz; k++)
+    order[row_ptr[rows[k]]++] = k;
+
+  // CSC by counting sort over the columns
+  nnz_ = nnz;
+  host_ptr_t_.assign(n + 1, 0);
+  host_ind_t_.resize(nnz);
+  host_val_t_.resize(nnz);
+
+  for(int k = 0; k < nnz; k++)
+    host_ptr_t_[cols[k] + 1]++;
+
+  for(int j = 0; j < n; j++)
+    host_ptr_t_[j + 1] += host_ptr_t_[j];
+
+  std::vector<int32_t> pos(host_ptr_t_.begin(), host_ptr_t_.end() - 1);
+  for(int32_t k : order)
+  {
+    host_ind_t_[pos[cols[k]]] = rows[k];
+    host_val_t_[pos[cols[k]]++] = vals[k];
+  }
+
+  host_ind_.resize(nnz_);
+  host_val_.resize(nnz_);
+  host_ptr_.resize(this->nrows() + 1);
+
+  csr2csc(
+    this->ncols(), 
+    this->nrows(), 
+    nnz_,
+    &host_val_t_[0],
+    &host_ind_t_[0],
+    &host_ptr_t_[0],
+    &host_val_[0],
+    &host_ind_[0],
+    &host_ptr_[0]);
+}
+
+template<typename T>
+void BlockSparse<T>::ReleaseHost()
+{
+  if(!transpose_spmv_)
+    return;
+
+  host_ind_t_.clear(); host_ind_t_.shrink_to_fit();
+  host_val_t_.clear(); host_val_t_.shrink_to_fit();
+  host_ptr_t_.clear(); host_ptr_t_.shrink_to_fit();
+
+  if(mat_.initialized())
+  {
+    host_ind_.clear(); host_ind_.shrink_to_fit();
+    host_val_.clear(); host_val_.shrink_to_fit();
+    host_ptr_.clear(); host_ptr_.shrink_to_fit();
+  }
+}
+
+template<typename T>
+void BlockSparse<T>::HostCSR(
+  vector<T>& val,
+  vector<int32_t>& ptr,
+  vector<int32_t>& ind) const
+{
+  if(external_owner_)
+  {
+    val.assign(external_val_, external_val_ + nnz_);
+    ptr.assign(external_ptr_, external_ptr_ + this->nrows() + 1);
+    ind.assign(external_ind_, external_ind_ + nnz_);
+  }
+  else if(host_ptr_.empty())
+    mat_.Download(val, ptr, ind);
+  else
+  {
+    val = host_val_;
+    ptr = host_ptr_;
+    ind = host_ind_;
+  }
+}
+
 template<typename T>
 BlockSparse<T>::BlockSparse(size_t row, size_t col, size_t nrows, size_t ncols)
-  : Block<T>(row, col, nrows, ncols)
+  : Block<T>(row, col, nrows, ncols), transpose_spmv_(false),
+    external_val_(nullptr), external_val_t_(nullptr),
+    external_ptr_(nullptr), external_ptr_t_(nullptr),
+    external_ind_(nullptr), external_ind_t_(nullptr),
+    cached_row_alpha_(0), cached_col_alpha_(0)
 {
 }
 
@@ -81,38 +262,96 @@ BlockSparse<T>::~BlockSparse()
 template<typename T>
 void BlockSparse<T>::Initialize()
 {
-  if(cusp_handle_ == nullptr)
-    cusparseCreate(&cusp_handle_);
-
-  cusparseCreateMatDescr(&descr_);
-  cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
-  cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
-
-  // forward
-  ind_.resize(nnz_);
-  val_.resize(nnz_);
-  ptr_.resize(this->nrows() + 1);
-
-  // transpose
-  ind_t_.resize(nnz_);
-  val_t_.resize(nnz_);
-  ptr_t_.resize(this->ncols() + 1);
-
-  // copy to GPU
-  thrust::copy(host_ind_t_.begin(), host_ind_t_.end(), ind_t_.begin());
-  thrust::copy(host_ptr_t_.begin(), host_ptr_t_.end(), ptr_t_.begin());
-  thrust::copy(host_val_t_.begin(), host_val_t_.end(), val_t_.begin());
-
-  thrust::copy(host_ind_.begin(), host_ind_.end(), ind_.begin());
-  thrust::copy(host_ptr_.begin(), host_ptr_.end(), ptr_.begin());
-  thrust::copy(host_val_.begin(), host_val_.end(), val_.begin());
+  ExecutionContext& context = this->context();
+
+  if(external_owner_)
+  {
+    mat_.Initialize(
+      context.cusparse(context.stream()),
+      this->nrows(),
+      this->ncols(),
+      nnz_,
+      external_val_,
+      external_ptr_,
+      external_ind_,
+      external_val_t_,
+      external_ptr_t_,
+      external_ind_t_,
+      transpose_spmv_);
+
+    return;
+  }
+
+  // single copy already resident on the GPU
+  if(host_ptr_.empty() && mat_.initialized())
+    return;
+
+  mat_.Initialize(
+    context.cusparse(context.stream()),
+    this->nrows(),
+    this->ncols(),
+    nnz_,
+    host_val_,
+    host_ptr_,
+    host_ind_,
+    host_val_t_,
+    host_ptr_t_,
+    host_ind_t_,
+    transpose_spmv_);
+
+  ReleaseHost();
+}
+
+template<typename T>
+void BlockSparse<T>::Release()
+{
+  // the GPU holds the only copy, move it back for a later Initialize()
+  if(mat_.initialized() && host_ptr_.empty() && !external_owner_)
+    mat_.Download(host_val_, host_ptr_, host_ind_);
+
+  mat_.Release();
+}
+
+template<typename T>
+const vector<T>& BlockSparse<T>::CachedSums(T alpha, bool by_cols) const
+{
+  vector<T>& sums = by_cols ? cached_col_sums_ : cached_row_sums_;
+  T& cached_alpha = by_cols ? cached_col_alpha_ : cached_row_alpha_;
+
+  if(!sums.empty() && cached_alpha == alpha)
+    return sums;
+
+  // one download of the matrix if the GPU holds the only copy
+  vector<T> val;
+  vector<int32_t> ptr, ind;
+  HostCSR(val, ptr, ind);
+
+  sums.assign(by_cols ? this->ncols() : this->nrows(), 0);
+  for(size_t r = 0; r < this->nrows(); r++)
+    for(int32_t i = ptr[r]; i < ptr[r + 1]; i++)
+      sums[by_cols ? ind[i] : r] += std::pow(std::abs(val[i]), alpha);
+
+  cached_alpha = alpha;
+  return sums;
 }
 
 template<typename T>
 T BlockSparse<T>::row_sum(size_t row, T alpha) const
 {
+  // the CSR may only be on the GPU
+  if(transpose_spmv_)
+    return CachedSums(alpha, false)[row];
+
   T sum = 0;
 
+  if(external_owner_)
+  {
+    for(int32_t i = external_ptr_[row]; i < external_ptr_[row + 1]; i++)
+      sum += std::pow(std::abs(external_val_[i]), alpha);
+
+    return sum;
+  }
+
   for(int32_t i = host_ptr_[row]; i < host_ptr_[row + 1]; i++)
     sum += std::pow(std::abs(host_val_[i]), alpha);
 
@@ -122,8 +361,20 @@ T BlockSparse<T>::row_sum(size_t row, T alpha) const
 template<typename T>
 T BlockSparse<T>::col_sum(size_t col, T alpha) const
 {
+  // no CSC copy
+  if(transpose_spmv_)
+    return CachedSums(alpha, true)[col];
+
   T sum = 0;
 
+  if(external_owner_)
+  {
+    for(int32_t i = external_ptr_t_[col]; i < external_ptr_t_[col + 1]; i++)
+      sum += std::pow(std::abs(external_val_t_[i]), alpha);
+
+    return sum;
+  }
+
   for(int32_t i = host_ptr_t_[col]; i < host_ptr_t_[col + 1]; i++)
     sum += std::pow(std::abs(host_val_t_[i]), alpha);
 
@@ -133,149 +384,110 @@ T BlockSparse<T>::col_sum(size_t col, T alpha) const
 template<typename T>
 size_t BlockSparse<T>::gpu_mem_amount() const
 {
-  size_t total_bytes = 0;
-
-  total_bytes += 2 * nnz_ * sizeof(int32_t);
-  total_bytes += (this->nrows() + this->ncols() + 2) * sizeof(int32_t);
-  total_bytes += 2 * nnz_ * sizeof(T);
-
-  return total_bytes;
+  return mat_.gpu_mem_amount();
 }
 
-template<>
-void BlockSparse<float>::EvalLocalAdd(
-  const typename thrust::device_vector<float>::iterator& res_begin,
-  const typename thrust::device_vector<float>::iterator& res_end,
-  const typename thrust::device_vector<float>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<float>::const_iterator& rhs_end)
+template<typename T>
+void BlockSparse<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
 {
-  cusparseStatus_t stat;
-  const float alpha = 1;
-  const float beta = 1;
-
-  stat = cusparseScsrmv(cusp_handle_,
-    CUSPARSE_OPERATION_NON_TRANSPOSE,
-    nrows(),
-    ncols(),
-    nnz_,
-    &alpha,
-    descr_,
-    thrust::raw_pointer_cast(val_.data()),
-    thrust::raw_pointer_cast(ptr_.data()),
-    thrust::raw_pointer_cast(ind_.data()),
-    thrust::raw_pointer_cast(&(*rhs_begin)),
-    &beta,
-    thrust::raw_pointer_cast(&(*res_begin)));
-
-  if(stat != CUSPARSE_STATUS_SUCCESS)
-  {
-    std::ostringstream ss;
-    ss << "Sparse Matrix-Vector multiplication failed. Error code = " << stat << ".";
+  mat_.Prefetch(device, transpose, stream);
+}
 
-    throw Exception(ss.str());
-  }
+template<typename T>
+void BlockSparse<T>::EvalLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
+{
+  mat_.Multiply(this->context().cusparse(stream), false, 1, 
+    thrust::raw_pointer_cast(&(*rhs_begin)), 1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    stream);
 }
 
-template<>
-void BlockSparse<float>::EvalAdjointLocalAdd(
-  const typename thrust::device_vector<float>::iterator& res_begin,
-  const typename thrust::device_vector<float>::iterator& res_end,
-  const typename thrust::device_vector<float>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<float>::const_iterator& rhs_end)
+template<typename T>
+void BlockSparse<T>::EvalAdjointLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
-  cusparseStatus_t stat;
-  const float alpha = 1;
-  const float beta = 1;
-
-  stat = cusparseScsrmv(cusp_handle_,
-    CUSPARSE_OPERATION_NON_TRANSPOSE,
-    ncols(),
-    nrows(),
-    nnz_,
-    &alpha,
-    descr_,
-    thrust::raw_pointer_cast(val_t_.data()),
-    thrust::raw_pointer_cast(ptr_t_.data()),
-    thrust::raw_pointer_cast(ind_t_.data()),
-    thrust::raw_pointer_cast(&(*rhs_begin)),
-    &beta,
-    thrust::raw_pointer_cast(&(*res_begin)));
-
-  if(stat != CUSPARSE_STATUS_SUCCESS)
-  {
-    std::ostringstream ss;
-    ss << "Sparse Matrix-Vector multiplication failed. Error code = " << stat << ".";
+  mat_.Multiply(this->context().cusparse(stream), true, 1, 
+    thrust::raw_pointer_cast(&(*rhs_begin)), 1,
+    thrust::raw_pointer_cast(&(*res_begin)),
+    stream);
+}
 
-    throw Exception(ss.str());
-  }
+template<typename T>
+void BlockSparse<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsCSR<T, T>(
+    sums_begin,
+    mat_.ptr(),
+    mat_.val(),
+    this->nrows(),
+    1,
+    this->nrows(),
+    alpha,
+    stream);
 }
 
-template<>
-void BlockSparse<double>::EvalLocalAdd(
-  const typename thrust::device_vector<double>::iterator& res_begin,
-  const typename thrust::device_vector<double>::iterator& res_end,
-  const typename thrust::device_vector<double>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<double>::const_iterator& rhs_end)
+template<typename T>
+void BlockSparse<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
 {
-  cusparseStatus_t stat;
-  const double alpha = 1;
-  const double beta = 1;
-
-  stat = cusparseDcsrmv(cusp_handle_,
-    CUSPARSE_OPERATION_NON_TRANSPOSE,
-    nrows(),
-    ncols(),
-    nnz_,
-    &alpha,
-    descr_,
-    thrust::raw_pointer_cast(val_.data()),
-    thrust::raw_pointer_cast(ptr_.data()),
-    thrust::raw_pointer_cast(ind_.data()),
-    thrust::raw_pointer_cast(&(*rhs_begin)),
-    &beta,
-    thrust::raw_pointer_cast(&(*res_begin)));
-
-  if(stat != CUSPARSE_STATUS_SUCCESS)
+  // without a CSC copy the columns are accumulated atomically
+  if(transpose_spmv_)
   {
-    std::ostringstream ss;
-    ss << "Sparse Matrix-Vector multiplication failed. Error code = " << stat << ".";
-
-    throw Exception(ss.str());
+    BlockSumsCSRTranspose<T, T>(
+      sums_begin,
+      mat_.ptr(),
+      mat_.ind(),
+      mat_.val(),
+      this->nrows(),
+      alpha,
+      stream);
+    return;
   }
+
+  BlockSumsCSR<T, T>(
+    sums_begin,
+    mat_.ptr_t(),
+    mat_.val_t(),
+    this->ncols(),
+    1,
+    this->ncols(),
+    alpha,
+    stream);
 }
 
-template<>
-void BlockSparse<double>::EvalAdjointLocalAdd(
-  const typename thrust::device_vector<double>::iterator& res_begin,
-  const typename thrust::device_vector<double>::iterator& res_end,
-  const typename thrust::device_vector<double>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<double>::const_iterator& rhs_end)
+template<typename T>
+bool BlockSparse<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
 {
-  cusparseStatus_t stat;
-  const double alpha = 1;
-  const double beta = 1;
-
-  stat = cusparseDcsrmv(cusp_handle_,
-    CUSPARSE_OPERATION_NON_TRANSPOSE,
-    ncols(),
-    nrows(),
-    nnz_,
-    &alpha,
-    descr_,
-    thrust::raw_pointer_cast(val_t_.data()),
-    thrust::raw_pointer_cast(ptr_t_.data()),
-    thrust::raw_pointer_cast(ind_t_.data()),
-    thrust::raw_pointer_cast(&(*rhs_begin)),
-    &beta,
-    thrust::raw_pointer_cast(&(*res_begin)));
-
-  if(stat != CUSPARSE_STATUS_SUCCESS)
-  {
-    std::ostringstream ss;
-    ss << "Sparse Matrix-Vector multiplication failed. Error code = " << stat << ".";
-
-    throw Exception(ss.str());
-  }
+  vector<T> val;
+  vector<int32_t> ptr, ind;
+  HostCSR(val, ptr, ind);
+
+  for(size_t r = 0; r < this->nrows(); r++)
+    for(int32_t i = ptr[r]; i < ptr[r + 1]; i++)
+    {
+      rows.push_back(this->row() + r);
+      cols.push_back(this->col() + ind[i]);
+      vals.push_back(val[i]);
+    }
+
+  return true;
 }
 
 // Explicit template instantiation
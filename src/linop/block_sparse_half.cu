@@ -0,0 +1,319 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cmath>
+#include <sstream>
+
+#include "prost/linop/block_sparse_half.hpp"
+#include "prost/linop/block_sums.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+/// \brief CSR matrix-vector product result += K * rhs, one thread per row. 
+///        The half precision values are converted to T before multiplying.
+template<typename T>
+__global__ void BlockSparseHalfKernel(
+    T *result,
+    const T *rhs,
+    size_t nrows,
+    const int32_t *ind,
+    const int32_t *ptr,
+    const __half *val)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
+
+  if(tx < nrows)
+  {
+    T sum = 0;
+    int32_t stop = ptr[tx + 1];
+
+    for(int32_t i = ptr[tx]; i < stop; i++)
+      sum += static_cast<T>(__half2float(val[i])) * rhs[ind[i]];
+
+    result[tx] += sum;
+  }
+}
+
+/// \brief Largest finite and smallest normal half precision value. Larger
+///        values would become inf, smaller ones lose their relative 
+///        precision as subnormals or are flushed to zero.
+static const double kHalfMax = 65504.0;
+static const double kHalfMinNormal = 6.103515625e-05;
+
+/// \brief Throws if a nonzero value can not be stored in half precision 
+///        with its relative precision of about 3 digits.
+template<typename T>
+static void CheckHalfRange(const vector<T>& values)
+{
+  for(size_t i = 0; i < values.size(); i++)
+  {
+    const double v = std::abs(static_cast<double>(values[i]));
+
+    if(v > kHalfMax || (v > 0 && v < kHalfMinNormal) || std::isnan(v))
+    {
+      std::stringstream ss;
+      ss << "BlockSparseHalf: value " << values[i] << " is outside of the "
+         << "half precision range [" << kHalfMinNormal << ", " << kHalfMax 
+         << "], rescale the operator or use a full precision sparse block.";
+      throw Exception(ss.str());
+    }
+  }
+}
+
+/// \brief Converts full precision values to half precision with round-to-nearest.
+template<typename T>
+static vector<__half> ToHalf(const vector<T>& values)
+{
+  vector<__half> result(values.size());
+
+  for(size_t i = 0; i < values.size(); i++)
+    result[i] = __float2half_rn(static_cast<float>(values[i]));
+
+  return result;
+}
+
+template<typename T>
+BlockSparseHalf<T>::BlockSparseHalf(size_t row, size_t col, size_t nrows, size_t ncols)
+    : Block<T>(row, col, nrows, ncols)
+{
+}
+
+template<typename T>
+BlockSparseHalf<T> *BlockSparseHalf<T>::CreateFromCSC(
+    size_t row,
+    size_t col,
+    int m,
+    int n,
+    int nnz,
+    const vector<T>& val,
+    const vector<int32_t>& ptr,
+    const vector<int32_t>& ind)
+{
+  CheckHalfRange(val);
+
+  BlockSparseHalf<T> *block = new BlockSparseHalf<T>(row, col, m, n);
+  block->nnz_ = nnz;
+
+  // create data on host
+  block->host_ind_t_ = ind; 
+  block->host_ptr_t_ = ptr; 
+  block->host_val_t_ = val; 
+
+  block->host_ind_.resize(block->nnz_);
+  block->host_val_.resize(block->nnz_);
+  block->host_ptr_.resize(block->nrows() + 1);
+
+  csr2csc(
+    block->ncols(), 
+    block->nrows(), 
+    block->nnz_, 
+    &block->host_val_t_[0],
+    &block->host_ind_t_[0],
+    &block->host_ptr_t_[0],
+    &block->host_val_[0],
+    &block->host_ind_[0],
+    &block->host_ptr_[0]);
+
+  return block;
+}
+
+template<typename T>
+void BlockSparseHalf<T>::Initialize()
+{
+  vector<__half> host_half = ToHalf(host_val_);
+  vector<__half> host_half_t = ToHalf(host_val_t_);
+
+  ind_ = host_ind_;
+  ptr_ = host_ptr_;
+  val_ = host_half;
+
+  ind_t_ = host_ind_t_;
+  ptr_t_ = host_ptr_t_;
+  val_t_ = host_half_t;
+}
+
+template<typename T>
+T BlockSparseHalf<T>::row_sum(size_t row, T alpha) const
+{
+  T sum = 0;
+
+  for(int32_t i = host_ptr_[row]; i < host_ptr_[row + 1]; i++)
+    sum += std::pow(std::abs(host_val_[i]), alpha);
+
+  return sum;
+}
+
+template<typename T>
+T BlockSparseHalf<T>::col_sum(size_t col, T alpha) const
+{
+  T sum = 0;
+
+  for(int32_t i = host_ptr_t_[col]; i < host_ptr_t_[col + 1]; i++)
+    sum += std::pow(std::abs(host_val_t_[i]), alpha);
+
+  return sum;
+}
+
+template<typename T>
+size_t BlockSparseHalf<T>::gpu_mem_amount() const
+{
+  size_t total_bytes = 0;
+
+  total_bytes += 2 * nnz_ * sizeof(int32_t);
+  total_bytes += (this->nrows() + this->ncols() + 2) * sizeof(int32_t);
+  total_bytes += 2 * nnz_ * sizeof(__half);
+
+  return total_bytes;
+}
+
+template<typename T>
+void BlockSparseHalf<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  if(transpose)
+  {
+    PrefetchOperatorVector(ptr_t_, device, stream);
+    PrefetchOperatorVector(ind_t_, device, stream);
+    PrefetchOperatorVector(val_t_, device, stream);
+  }
+  else
+  {
+    PrefetchOperatorVector(ptr_, device, stream);
+    PrefetchOperatorVector(ind_, device, stream);
+    PrefetchOperatorVector(val_, device, stream);
+  }
+}
+
+template<typename T>
+void BlockSparseHalf<T>::EvalLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((this->nrows() + block.x - 1) / block.x, 1, 1);
+
+  BlockSparseHalfKernel<T>
+      <<<grid, block, 0, stream>>>(
+          thrust::raw_pointer_cast(&(*res_begin)),
+          thrust::raw_pointer_cast(&(*rhs_begin)),
+          this->nrows(),
+          thrust::raw_pointer_cast(ind_.data()),
+          thrust::raw_pointer_cast(ptr_.data()),
+          thrust::raw_pointer_cast(val_.data()));
+
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << "BlockSparseHalf: CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void BlockSparseHalf<T>::EvalAdjointLocalAdd(
+    const typename device_vector<T>::iterator& res_begin,
+    const typename device_vector<T>::iterator& res_end,
+    const typename device_vector<T>::const_iterator& rhs_begin,
+    const typename device_vector<T>::const_iterator& rhs_end,
+    cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((this->ncols() + block.x - 1) / block.x, 1, 1);
+
+  BlockSparseHalfKernel<T>
+      <<<grid, block, 0, stream>>>(
+          thrust::raw_pointer_cast(&(*res_begin)),
+          thrust::raw_pointer_cast(&(*rhs_begin)),
+          this->ncols(),
+          thrust::raw_pointer_cast(ind_t_.data()),
+          thrust::raw_pointer_cast(ptr_t_.data()),
+          thrust::raw_pointer_cast(val_t_.data()));
+
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << "BlockSparseHalf: CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void BlockSparseHalf<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsCSR<T, __half>(
+    sums_begin,
+    ptr_,
+    val_,
+    this->nrows(),
+    1,
+    this->nrows(),
+    alpha,
+    stream);
+}
+
+template<typename T>
+void BlockSparseHalf<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  BlockSumsCSR<T, __half>(
+    sums_begin,
+    ptr_t_,
+    val_t_,
+    this->ncols(),
+    1,
+    this->ncols(),
+    alpha,
+    stream);
+}
+
+template<typename T>
+bool BlockSparseHalf<T>::AppendTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  // entries as seen by the kernels, which read them in half precision
+  for(size_t r = 0; r < this->nrows(); r++)
+    for(int32_t i = host_ptr_[r]; i < host_ptr_[r + 1]; i++)
+    {
+      rows.push_back(this->row() + r);
+      cols.push_back(this->col() + host_ind_[i]);
+      vals.push_back(static_cast<T>(__half2float(__float2half_rn(static_cast<float>(host_val_[i])))));
+    }
+
+  return true;
+}
+
+// Explicit template instantiation
+template class BlockSparseHalf<float>;
+template class BlockSparseHalf<double>;
+
+} // namespace prost
@@ -0,0 +1,298 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include <thrust/fill.h>
+#include <thrust/transform.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include "prost/linop/block_sum.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+struct BlockSumAxpy
+{
+  BlockSumAxpy(T c) : c(c) { }
+
+  __host__ __device__ T operator()(const T& x, const T& y) const
+  {
+    return c * x + y;
+  }
+
+  T c;
+};
+
+template<typename T>
+static const vector<shared_ptr<Block<T>>>& CheckTerms(
+  const vector<shared_ptr<Block<T>>>& terms,
+  const vector<T>& coeffs)
+{
+  if(terms.empty())
+    throw Exception("BlockSum: at least one term is required.");
+
+  if(coeffs.size() != terms.size())
+    throw Exception("BlockSum: the number of coefficients does not match the number of terms.");
+
+  for(size_t i = 1; i < terms.size(); i++)
+  {
+    if(terms[i]->nrows() != terms[0]->nrows() || terms[i]->ncols() != terms[0]->ncols())
+    {
+      std::ostringstream ss;
+      ss << "BlockSum: term " << i << " is " << terms[i]->nrows() << "x" << terms[i]->ncols();
+      ss << ", but term 0 is " << terms[0]->nrows() << "x" << terms[0]->ncols() << ".";
+      throw Exception(ss.str());
+    }
+  }
+
+  return terms;
+}
+
+template<typename T>
+BlockSum<T>::BlockSum(
+  size_t row,
+  size_t col,
+  const vector<shared_ptr<Block<T>>>& terms,
+  const vector<T>& coeffs)
+  : Block<T>(row, col, 
+             CheckTerms(terms, coeffs).front()->nrows(), 
+             terms.front()->ncols()),
+    terms_(terms),
+    coeffs_(coeffs)
+{
+}
+
+template<typename T>
+void BlockSum<T>::Initialize()
+{
+  for(auto& term : terms_)
+  {
+    // the terms use the handles of the sum
+    if(Block<T>::context_)
+      term->set_context(Block<T>::context_);
+
+    term->Initialize();
+  }
+
+  if(std::any_of(coeffs_.begin(), coeffs_.end(), [](T c) { return c != 1; }))
+    scratch_.resize(std::max(this->nrows(), this->ncols()));
+}
+
+template<typename T>
+void BlockSum<T>::Release()
+{
+  for(auto& term : terms_)
+    term->Release();
+
+  scratch_.clear();
+  scratch_.shrink_to_fit();
+}
+
+template<typename T>
+void BlockSum<T>::Update()
+{
+  for(auto& term : terms_)
+    term->Update();
+}
+
+template<typename T>
+T BlockSum<T>::Bound(size_t idx, T alpha, bool by_cols) const
+{
+  T sum = 0;
+
+  for(size_t i = 0; i < terms_.size(); i++)
+  {
+    if(coeffs_[i] == 0)
+      continue;
+
+    const T s = by_cols ? terms_[i]->col_sum(idx, alpha) : terms_[i]->row_sum(idx, alpha);
+    sum += std::pow(std::abs(coeffs_[i]), alpha) * s;
+  }
+
+  // |x_1 + ... + x_n|^alpha <= n^(alpha - 1) (|x_1|^alpha + ... + |x_n|^alpha)
+  if(alpha > 1)
+    sum *= std::pow(static_cast<T>(terms_.size()), alpha - 1);
+
+  return sum;
+}
+
+template<typename T>
+void BlockSum<T>::SumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  bool by_cols,
+  cudaStream_t stream)
+{
+  const size_t count = by_cols ? this->ncols() : this->nrows();
+  const T scale = (alpha > 1) ? std::pow(static_cast<T>(terms_.size()), alpha - 1) : 1;
+
+  device_vector<T> sums(count);
+
+  for(size_t i = 0; i < terms_.size(); i++)
+  {
+    if(coeffs_[i] == 0)
+      continue;
+
+    thrust::fill(thrust::cuda::par.on(stream), sums.begin(), sums.end(), static_cast<T>(0));
+
+    if(by_cols)
+      terms_[i]->ColSumsLocalAdd(sums.begin(), alpha, stream);
+    else
+      terms_[i]->RowSumsLocalAdd(sums.begin(), alpha, stream);
+
+    thrust::transform(
+      thrust::cuda::par.on(stream),
+      sums.begin(),
+      sums.end(),
+      sums_begin,
+      sums_begin,
+      BlockSumAxpy<T>(scale * std::pow(std::abs(coeffs_[i]), alpha)));
+  }
+}
+
+template<typename T>
+void BlockSum<T>::RowSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  SumsLocalAdd(sums_begin, alpha, false, stream);
+}
+
+template<typename T>
+void BlockSum<T>::ColSumsLocalAdd(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  SumsLocalAdd(sums_begin, alpha, true, stream);
+}
+
+template<typename T>
+T BlockSum<T>::row_sum(size_t row, T alpha) const
+{
+  return Bound(row, alpha, false);
+}
+
+template<typename T>
+T BlockSum<T>::col_sum(size_t col, T alpha) const
+{
+  return Bound(col, alpha, true);
+}
+
+template<typename T>
+size_t BlockSum<T>::gpu_mem_amount() const
+{
+  size_t mem = 0;
+
+  for(auto& term : terms_)
+    mem += term->gpu_mem_amount();
+
+  if(std::any_of(coeffs_.begin(), coeffs_.end(), [](T c) { return c != 1; }))
+    mem += std::max(this->nrows(), this->ncols()) * sizeof(T);
+
+  return mem;
+}
+
+template<typename T>
+void BlockSum<T>::Prefetch(int device, bool transpose, cudaStream_t stream)
+{
+  for(auto& term : terms_)
+    term->Prefetch(device, transpose, stream);
+}
+
+template<typename T>
+void BlockSum<T>::EvalTerms(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  bool transpose,
+  cudaStream_t stream)
+{
+  const size_t size = res_end - res_begin;
+
+  for(size_t i = 0; i < terms_.size(); i++)
+  {
+    if(coeffs_[i] == 0)
+      continue;
+
+    if(coeffs_[i] == 1)
+    {
+      if(transpose)
+        terms_[i]->EvalAdjointLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+      else
+        terms_[i]->EvalLocalAdd(res_begin, res_end, rhs_begin, rhs_end, stream);
+
+      continue;
+    }
+
+    // res += c * A_i rhs through the scratch buffer
+    const typename device_vector<T>::iterator tmp_begin = scratch_.begin();
+    const typename device_vector<T>::iterator tmp_end = scratch_.begin() + size;
+
+    thrust::fill(thrust::cuda::par.on(stream), tmp_begin, tmp_end, static_cast<T>(0));
+
+    if(transpose)
+      terms_[i]->EvalAdjointLocalAdd(tmp_begin, tmp_end, rhs_begin, rhs_end, stream);
+    else
+      terms_[i]->EvalLocalAdd(tmp_begin, tmp_end, rhs_begin, rhs_end, stream);
+
+    thrust::transform(
+      thrust::cuda::par.on(stream),
+      tmp_begin,
+      tmp_end,
+      res_begin,
+      res_begin,
+      BlockSumAxpy<T>(coeffs_[i]));
+  }
+}
+
+template<typename T>
+void BlockSum<T>::EvalLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
+{
+  EvalTerms(res_begin, res_end, rhs_begin, rhs_end, false, stream);
+}
+
+template<typename T>
+void BlockSum<T>::EvalAdjointLocalAdd(
+  const typename device_vector<T>::iterator& res_begin,
+  const typename device_vector<T>::iterator& res_end,
+  const typename device_vector<T>::const_iterator& rhs_begin,
+  const typename device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
+{
+  EvalTerms(res_begin, res_end, rhs_begin, rhs_end, true, stream);
+}
+
+// Explicit template instantiation
+template class BlockSum<float>;
+template class BlockSum<double>;
+
+} // namespace prost
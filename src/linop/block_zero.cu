@@ -38,7 +38,8 @@ void BlockZero<T>::EvalLocalAdd(
   const typename thrust::device_vector<T>::iterator& res_begin,
   const typename thrust::device_vector<T>::iterator& res_end,
   const typename thrust::device_vector<T>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<T>::const_iterator& rhs_end)
+  const typename thrust::device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
   // do nothing for zero operator
 }
@@ -48,7 +49,8 @@ void BlockZero<T>::EvalAdjointLocalAdd(
   const typename thrust::device_vector<T>::iterator& res_begin,
   const typename thrust::device_vector<T>::iterator& res_end,
   const typename thrust::device_vector<T>::const_iterator& rhs_begin,
-  const typename thrust::device_vector<T>::const_iterator& rhs_end)
+  const typename thrust::device_vector<T>::const_iterator& rhs_end,
+  cudaStream_t stream)
 {
   // do nothing for zero operator
 }
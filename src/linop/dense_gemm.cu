@@ -0,0 +1,125 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+
+#include "prost/linop/dense_gemm.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+namespace {
+
+#if CUDART_VERSION >= 11000
+
+cublasComputeType_t ComputeType(float, DenseMath math)
+{
+  switch(math)
+  {
+  case DenseMath::kTF32:
+    return CUBLAS_COMPUTE_32F_FAST_TF32;
+
+  case DenseMath::kFP16:
+    return CUBLAS_COMPUTE_32F_FAST_16F;
+
+  default:
+    return CUBLAS_COMPUTE_32F;
+  }
+}
+
+cublasComputeType_t ComputeType(double, DenseMath math)
+{
+  return CUBLAS_COMPUTE_64F;
+}
+
+cudaDataType DataType(float) { return CUDA_R_32F; }
+cudaDataType DataType(double) { return CUDA_R_64F; }
+
+#else
+
+cublasStatus_t LegacyGemm(
+  cublasHandle_t handle, cublasOperation_t op_a, cublasOperation_t op_b,
+  int m, int n, int k, const float *alpha, const float *a, int lda,
+  const float *b, int ldb, const float *beta, float *c, int ldc)
+{
+  return cublasSgemm(handle, op_a, op_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+cublasStatus_t LegacyGemm(
+  cublasHandle_t handle, cublasOperation_t op_a, cublasOperation_t op_b,
+  int m, int n, int k, const double *alpha, const double *a, int lda,
+  const double *b, int ldb, const double *beta, double *c, int ldc)
+{
+  return cublasDgemm(handle, op_a, op_b, m, n, k, alpha, a, lda, b, ldb, beta, c, ldc);
+}
+
+#endif
+
+} // namespace
+
+template<typename T>
+void DenseGemm::Multiply(
+  ExecutionContext& context,
+  bool trans_a,
+  bool trans_b,
+  int m,
+  int n,
+  int k,
+  T alpha,
+  const T *a,
+  int lda,
+  const T *b,
+  int ldb,
+  T beta,
+  T *c,
+  int ldc,
+  cudaStream_t stream)
+{
+  cublasHandle_t hdl = context.cublas(stream);
+
+  const cublasOperation_t op_a = trans_a ? CUBLAS_OP_T : CUBLAS_OP_N;
+  const cublasOperation_t op_b = trans_b ? CUBLAS_OP_T : CUBLAS_OP_N;
+
+#if CUDART_VERSION >= 11000
+  const cudaDataType type = DataType(T(0));
+
+  cublasStatus_t status = cublasGemmEx(hdl, op_a, op_b, m, n, k,
+                                       &alpha, a, type, lda, b, type, ldb,
+                                       &beta, c, type, ldc,
+                                       ComputeType(T(0), context.dense_math()),
+                                       CUBLAS_GEMM_DEFAULT);
+#else
+  cublasStatus_t status = LegacyGemm(hdl, op_a, op_b, m, n, k,
+                                     &alpha, a, lda, b, ldb, &beta, c, ldc);
+#endif
+
+  if(status != CUBLAS_STATUS_SUCCESS)
+  {
+    std::stringstream ss;
+    ss << "DenseGemm: cuBLAS GEMM failed. Error code = " << status << ".";
+    throw Exception(ss.str());
+  }
+}
+
+// Explicit template instantiation
+template void DenseGemm::Multiply<float>(ExecutionContext&, bool, bool, int, int, int, float, const float *, int, const float *, int, float, float *, int, cudaStream_t);
+template void DenseGemm::Multiply<double>(ExecutionContext&, bool, bool, int, int, int, double, const double *, int, const double *, int, double, double *, int, cudaStream_t);
+
+} // namespace prost
@@ -18,10 +18,47 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <utility>
+
+#include <thrust/system/cuda/execution_policy.h>
+
 #include "prost/linop/dual_linearoperator.hpp"
+#include "prost/config.hpp"
 
 namespace prost {
 
+/// \brief Negates a vector in-place. Used instead of thrust::transform so the
+///        dual operator can be captured into a CUDA graph.
+template<typename T>
+__global__
+void DualLinearOperatorNegateKernel(T *d_res, size_t count)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count)
+    d_res[tx] = -d_res[tx];
+}
+
+template<typename T>
+static void NegateAsync(device_vector<T>& result, size_t begin, size_t end, cudaStream_t stream)
+{
+  if(end <= begin)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((end - begin + block.x - 1) / block.x, 1, 1);
+
+  DualLinearOperatorNegateKernel<T>
+      <<<grid, block, 0, stream>>>(thrust::raw_pointer_cast(result.data()) + begin, end - begin);
+}
+
+template<typename T>
+static void NegateAsync(device_vector<T>& result, cudaStream_t stream)
+{
+  NegateAsync(result, 0, result.size(), stream);
+}
+
 template<typename T>
 DualLinearOperator<T>::DualLinearOperator(shared_ptr<LinearOperator<T>> child)
     : child_(child)
@@ -39,46 +76,105 @@ template<typename T>
 void DualLinearOperator<T>::Eval(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta)
+    T beta,
+    cudaStream_t stream)
 {
   if(beta == 0)
   {
-    thrust::fill(result.begin(), result.end(), 0);
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
   }
   else if(beta != 1)
   {
-    thrust::transform(result.begin(), result.end(), result.begin(), -beta * thrust::placeholders::_1);
+    thrust::transform(thrust::cuda::par.on(stream), result.begin(), result.end(), result.begin(), -beta * thrust::placeholders::_1);
   }
 
-  for(auto& block : child_->blocks_)
-    block->EvalAdjointAdd(result, rhs);
+  child_->EvalBlocksAdd(result, rhs, true, stream);
 
-  thrust::transform(result.begin(), result.end(), result.begin(),
-                    thrust::negate<float>());
+  NegateAsync(result, stream);
 }
 
 template<typename T>
 void DualLinearOperator<T>::EvalAdjoint(
     device_vector<T>& result, 
     const device_vector<T>& rhs,
-    T beta)
+    T beta,
+    cudaStream_t stream)
 {
   if(beta == 0)
   {
-    thrust::fill(result.begin(), result.end(), 0);
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
   }
   else if(beta != 1)
   {
-    thrust::transform(result.begin(), result.end(), result.begin(), -beta * thrust::placeholders::_1);
+    thrust::transform(thrust::cuda::par.on(stream), result.begin(), result.end(), result.begin(), -beta * thrust::placeholders::_1);
   }
 
-  for(auto& block : child_->blocks_)
-    block->EvalAdd(result, rhs);
+  child_->EvalBlocksAdd(result, rhs, false, stream);
 
-  thrust::transform(result.begin(), result.end(), result.begin(),
-                    thrust::negate<float>());
+  NegateAsync(result, stream);
 }
   
+template<typename T>
+void DualLinearOperator<T>::RowPartition(vector<size_t>& bounds) const
+{
+  child_->Partition(true, bounds);
+}
+
+template<typename T>
+void DualLinearOperator<T>::EvalRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream)
+{
+  // the rows are columns of the child, which only writes to them. 
+  // result - K^T rhs = -(-result + K^T rhs)
+  child_->CollectRangeBlocks(true, row_begin, row_end);
+
+  NegateAsync(result, row_begin, row_end, stream);
+  child_->EvalRangeBlocksAdd(result, rhs, true, stream);
+  NegateAsync(result, row_begin, row_end, stream);
+}
+
+template<typename T>
+void DualLinearOperator<T>::EvalAdjointRowsAdd(
+    device_vector<T>& result,
+    const device_vector<T>& rhs,
+    size_t row_begin,
+    size_t row_end,
+    cudaStream_t stream)
+{
+  child_->CollectRangeBlocks(true, row_begin, row_end);
+
+  // the blocks of a column range may share rows, negate the union of 
+  // their row ranges exactly once
+  vector<std::pair<size_t, size_t>>& ranges = negate_ranges_;
+  ranges.clear();
+  for(auto& block : child_->range_blocks_)
+    ranges.push_back(std::make_pair(block->row(), block->row() + block->nrows()));
+
+  std::sort(ranges.begin(), ranges.end());
+
+  size_t num_merged = 0;
+  for(size_t i = 0; i < ranges.size(); i++)
+  {
+    if(num_merged > 0 && ranges[i].first <= ranges[num_merged - 1].second)
+      ranges[num_merged - 1].second = std::max(ranges[num_merged - 1].second, ranges[i].second);
+    else
+      ranges[num_merged++] = ranges[i];
+  }
+  ranges.resize(num_merged);
+
+  for(auto& r : ranges)
+    NegateAsync(result, r.first, r.second, stream);
+
+  child_->EvalRangeBlocksAdd(result, rhs, false, stream);
+
+  for(auto& r : ranges)
+    NegateAsync(result, r.first, r.second, stream);
+}
+
 template<typename T>
 T DualLinearOperator<T>::row_sum(size_t row, T alpha) const
 {
@@ -91,6 +187,40 @@ T DualLinearOperator<T>::col_sum(size_t col, T alpha) const
   return child_->row_sum(col, alpha);
 }
 
+template<typename T>
+void DualLinearOperator<T>::RowSums(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  child_->ColSums(sums_begin, alpha, stream);
+}
+
+template<typename T>
+void DualLinearOperator<T>::ColSums(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  child_->RowSums(sums_begin, alpha, stream);
+}
+
+template<typename T>
+bool DualLinearOperator<T>::GetTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  // entries of -K^T
+  if(!child_->GetTriplets(cols, rows, vals))
+    return false;
+
+  for(auto& v : vals)
+    v = -v;
+
+  return true;
+}
+
 template<typename T>
 size_t DualLinearOperator<T>::nrows() const
 {
@@ -0,0 +1,68 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+
+#include "prost/linop/epilogue.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+__global__
+void ApplyEpilogueKernel(const T *d_val, size_t count, Epilogue<T> epilogue)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < count)
+    epilogue(tx, d_val[tx]);
+}
+
+template<typename T>
+void ApplyEpilogue(
+  const T *values,
+  size_t count,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(count == 0)
+    return;
+
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((count + block.x - 1) / block.x, 1, 1);
+
+  ApplyEpilogueKernel<T>
+    <<<grid, block, 0, stream>>>(values, count, epilogue);
+
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << "ApplyEpilogue: CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+// Explicit template instantiation
+template void ApplyEpilogue<float>(const float*, size_t, const Epilogue<float>&, cudaStream_t);
+template void ApplyEpilogue<double>(const double*, size_t, const Epilogue<double>&, cudaStream_t);
+
+} // namespace prost
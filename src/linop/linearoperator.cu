@@ -19,53 +19,37 @@
 */
 
 #include <algorithm>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <queue>
+#include <sstream>
 #include <thrust/device_vector.h>
 #include <thrust/fill.h>
+#include <thrust/system/cuda/execution_policy.h>
 
 #include "prost/linop/linearoperator.hpp"
+#include "prost/linop/block_sparse.hpp"
+#include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
 
-template<typename T>
-bool LinearOperator<T>::RectangleOverlap(
-  size_t x1, size_t y1,
-  size_t x2, size_t y2,
-  size_t a1, size_t b1,
-  size_t a2, size_t b2) 
-{ 
-  return (x1 <= a2) && (x2 >= a1) && (y1 <= b2) && (y2 >= b1);
-}
-
-// used for sorting blocks
-template<typename T>
-struct BlockCompareRow {
-  bool operator()(Block<T>* const& left, Block<T>* const& right) {
-    if(left->row() < right->row())
-      return true;
-
-    return false;
-  }
-};
-
-template<typename T>
-struct BlockCompareCol 
-{
-  bool operator()(Block<T>* const& left, Block<T>* const& right) 
-  {
-    if(left->col() < right->col())
-      return true;
-
-    return false;
-  }
-};
-
 template<typename T>
 LinearOperator<T>::LinearOperator() 
 {
   nrows_ = 0;
   ncols_ = 0;
+  version_ = new_version_id();
+  epilogue_rows_ = false;
+  epilogue_cols_ = false;
+  fork_event_ = nullptr;
+  merge_blocks_ = true;
+  prefetch_stream_ = nullptr;
+  prefetched_event_ = nullptr;
+  evaluated_event_ = nullptr;
 }
 
 template<typename T>
@@ -83,45 +67,281 @@ void LinearOperator<T>::AddBlock(std::shared_ptr<Block<T>> block)
 template<typename T>
 void LinearOperator<T>::Initialize() 
 {
-  // check if any two linear operators overlap
   nrows_ = 0;
   ncols_ = 0;
 
-  size_t area = 0;
-  
-  bool overlap = false;
-  for(size_t i = 0; i < blocks_.size(); i++) 
+  vector<size_t> layout;
+  layout.reserve(4 * blocks_.size());
+
+  for(auto& block : blocks_)
   {
-    std::shared_ptr<Block<T> > block_i = blocks_[i];
+    nrows_ = std::max(block->row() + block->nrows(), nrows_);
+    ncols_ = std::max(block->col() + block->ncols(), ncols_);
 
-    nrows_ = std::max(block_i->row() + block_i->nrows(), nrows_);
-    ncols_ = std::max(block_i->col() + block_i->ncols(), ncols_);
+    layout.push_back(block->row());
+    layout.push_back(block->col());
+    layout.push_back(block->nrows());
+    layout.push_back(block->ncols());
+  }
 
-    area += block_i->nrows() * block_i->ncols();
-    
-    for(size_t j = i + 1; j < blocks_.size(); j++) 
+  // check if any two blocks overlap, unless they were checked before
+  if(layout != checked_layout_)
+  {
+    CheckOverlap();
+    checked_layout_.swap(layout);
+  }
+
+  for(auto& block : blocks_)
+  {
+    if(context_)
+      block->set_context(context_);
+
+    block->Initialize();
+  }
+
+  MergeBlocks();
+  BuildSchedule();
+  version_ = new_version_id();
+
+  if(context_ && context_->out_of_core() && prefetch_stream_ == nullptr)
+  {
+    cudaStreamCreateWithFlags(&prefetch_stream_, cudaStreamNonBlocking);
+    cudaEventCreateWithFlags(&prefetched_event_, cudaEventDisableTiming);
+    cudaEventCreateWithFlags(&evaluated_event_, cudaEventDisableTiming);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::CheckOverlap() const
+{
+  vector<const Block<T> *> sorted;
+  sorted.reserve(blocks_.size());
+
+  for(auto& block : blocks_)
+    if(block->nrows() > 0 && block->ncols() > 0)
+      sorted.push_back(block.get());
+
+  std::sort(sorted.begin(), sorted.end(),
+            [](const Block<T> *a, const Block<T> *b) { return a->row() < b->row(); });
+
+  // blocks intersecting the current row by their first column, their
+  // column ranges are disjoint
+  std::map<size_t, const Block<T> *> active;
+
+  // last row + 1 and first column of the active blocks, to drop them 
+  // once the sweep has passed them
+  typedef std::pair<size_t, size_t> RowEnd;
+  std::priority_queue<RowEnd, vector<RowEnd>, std::greater<RowEnd>> row_ends;
+
+  for(const Block<T> *block : sorted)
+  {
+    while(!row_ends.empty() && row_ends.top().first <= block->row())
+    {
+      active.erase(row_ends.top().second);
+      row_ends.pop();
+    }
+
+    const size_t col_beg = block->col();
+    const size_t col_end = block->col() + block->ncols();
+
+    // the next block to the right and the previous one to the left are
+    // the only candidates for an overlap
+    const Block<T> *other = nullptr;
+    auto it = active.lower_bound(col_beg);
+
+    if(it != active.end() && it->first < col_end)
+      other = it->second;
+    else if(it != active.begin() && 
+            std::prev(it)->first + std::prev(it)->second->ncols() > col_beg)
+      other = std::prev(it)->second;
+
+    if(other)
     {
-      std::shared_ptr<Block<T> > block_j = blocks_[j];
-
-      overlap |= RectangleOverlap(block_i->col(), block_i->row(),
-                                  block_i->col() + block_i->ncols() - 1,
-                                  block_i->row() + block_i->nrows() - 1,
-                                  block_j->col(), block_j->row(),
-                                  block_j->col() + block_j->ncols() - 1,
-                                  block_j->row() + block_j->nrows() - 1);      
+      std::stringstream ss;
+      ss << "Blocks are overlapping inside the linear operator: ";
+      ss << "block at (" << other->row() << ", " << other->col() << ") of size ";
+      ss << other->nrows() << "x" << other->ncols() << " and block at (";
+      ss << block->row() << ", " << block->col() << ") of size ";
+      ss << block->nrows() << "x" << block->ncols() << ". Recheck the indices.";
+      throw Exception(ss.str());
     }
+
+    active[col_beg] = block;
+    row_ends.push(RowEnd(block->row() + block->nrows(), col_beg));
   }
+}
+
+template<typename T>
+void LinearOperator<T>::Update()
+{
+  for(auto& block : blocks_)
+    block->Update();
 
-  if(overlap) 
-    throw Exception("Blocks are overlapping inside the linear operator. Recheck the indices.");
+  version_ = new_version_id();
 
-/*
-  if(area != nrows_ * ncols_)  
-    std::cout << "Warning: There's empty space between the blocks inside the linear operator. Recheck the indicies." << std::endl;
-*/
+  if(!merged_block_)
+    return;
+
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+  size_t row_beg, row_end, col_beg, col_end;
+
+  MergedTriplets(rows, cols, vals, row_beg, row_end, col_beg, col_end);
+  merged_block_->SetTriplets(rows, cols, vals);
+}
+
+template<typename T>
+void LinearOperator<T>::MergeBlocks()
+{
+  merged_.clear();
+  merged_block_.reset();
+  eval_blocks_ = blocks_;
+
+  if(!merge_blocks_ || blocks_.size() < 2)
+    return;
+
+  size_t nnz = 0;
+  vector<int32_t> rows, cols;
+  vector<T> vals;
 
   for(auto& block : blocks_)
-    block->Initialize();
+  {
+    // only launch-bound blocks gain from merging, this also keeps large
+    // structured blocks (e.g. Kronecker products) from being expanded
+    const size_t vec_bytes = (block->nrows() + block->ncols()) * sizeof(T);
+    const size_t own_bytes = block->gpu_mem_amount() + vec_bytes;
+
+    if(own_bytes > kBlockLaunchCostBytes)
+      continue;
+
+    rows.clear();
+    cols.clear();
+    vals.clear();
+
+    if(!block->AppendTriplets(rows, cols, vals))
+      continue;
+
+    const size_t csr_bytes = 
+      vals.size() * (sizeof(T) + sizeof(int32_t)) + 
+      block->nrows() * sizeof(int32_t) + 
+      vec_bytes;
+
+    if(csr_bytes <= own_bytes + kBlockLaunchCostBytes)
+    {
+      merged_.push_back(block);
+      nnz += vals.size();
+    }
+  }
+
+  if(merged_.size() < 2 || nnz == 0 || 
+     nnz > static_cast<size_t>(std::numeric_limits<int32_t>::max()))
+  {
+    merged_.clear();
+    return;
+  }
+
+  vector<int32_t> rows_merged, cols_merged;
+  vector<T> vals_merged;
+  size_t row_beg, row_end, col_beg, col_end;
+
+  MergedTriplets(rows_merged, cols_merged, vals_merged, row_beg, row_end, col_beg, col_end);
+
+  merged_block_ = shared_ptr<BlockSparse<T>>(
+    BlockSparse<T>::CreateFromTriplets(
+      row_beg, col_beg,
+      row_end - row_beg, col_end - col_beg,
+      rows_merged, cols_merged, vals_merged));
+
+  if(context_)
+    merged_block_->set_context(context_);
+
+  merged_block_->Initialize();
+
+  // merged blocks keep their host data for row_sum/col_sum and triplets
+  for(auto& block : merged_)
+    block->Release();
+
+  eval_blocks_.assign(1, merged_block_);
+  for(auto& block : blocks_)
+  {
+    if(std::find(merged_.begin(), merged_.end(), block) == merged_.end())
+      eval_blocks_.push_back(block);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::MergedTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals,
+  size_t& row_beg, size_t& row_end,
+  size_t& col_beg, size_t& col_end) const
+{
+  row_beg = nrows_;
+  col_beg = ncols_;
+  row_end = 0;
+  col_end = 0;
+
+  for(auto& block : merged_)
+  {
+    row_beg = std::min(row_beg, block->row());
+    col_beg = std::min(col_beg, block->col());
+    row_end = std::max(row_end, block->row() + block->nrows());
+    col_end = std::max(col_end, block->col() + block->ncols());
+  }
+
+  rows.clear();
+  cols.clear();
+  vals.clear();
+
+  for(auto& block : merged_)
+    block->AppendTriplets(rows, cols, vals);
+
+  for(size_t k = 0; k < vals.size(); k++)
+  {
+    rows[k] -= row_beg;
+    cols[k] -= col_beg;
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::BuildSchedule()
+{
+  BuildWaves(row_waves_, false);
+  BuildWaves(col_waves_, true);
+
+  row_sorted_ = eval_blocks_;
+  col_sorted_ = eval_blocks_;
+
+  std::sort(row_sorted_.begin(), row_sorted_.end(),
+            [](const shared_ptr<Block<T>>& a, const shared_ptr<Block<T>>& b) { return a->row() < b->row(); });
+  std::sort(col_sorted_.begin(), col_sorted_.end(),
+            [](const shared_ptr<Block<T>>& a, const shared_ptr<Block<T>>& b) { return a->col() < b->col(); });
+
+  epilogue_rows_ = EpilogueFusable(row_waves_, false, nrows_);
+  epilogue_cols_ = EpilogueFusable(col_waves_, true, ncols_);
+
+  // streams are only needed if at least two blocks can run concurrently
+  size_t num_streams = 0;
+  for(auto& wave : row_waves_)
+    num_streams = std::max(num_streams, wave.size());
+  for(auto& wave : col_waves_)
+    num_streams = std::max(num_streams, wave.size());
+  num_streams = std::min(num_streams, kMaxBlockStreams);
+
+  if(num_streams > 1 && streams_.empty())
+  {
+    cudaEventCreateWithFlags(&fork_event_, cudaEventDisableTiming);
+
+    // the first block of each wave runs on the caller's stream
+    streams_.resize(num_streams - 1);
+    join_events_.resize(num_streams - 1);
+    for(size_t i = 0; i < streams_.size(); i++)
+    {
+      cudaStreamCreateWithFlags(&streams_[i], cudaStreamNonBlocking);
+      cudaEventCreateWithFlags(&join_events_[i], cudaEventDisableTiming);
+    }
+  }
 }
 
 template<typename T>
@@ -129,44 +349,384 @@ void LinearOperator<T>::Release()
 {
   for(auto& block : blocks_)
     block->Release();
+
+  if(merged_block_)
+    merged_block_->Release();
+
+  for(auto& s : streams_)
+    cudaStreamDestroy(s);
+  for(auto& e : join_events_)
+    cudaEventDestroy(e);
+  streams_.clear();
+  join_events_.clear();
+
+  if(fork_event_ != nullptr)
+  {
+    cudaEventDestroy(fork_event_);
+    fork_event_ = nullptr;
+  }
+
+  if(prefetch_stream_ != nullptr)
+  {
+    cudaStreamDestroy(prefetch_stream_);
+    cudaEventDestroy(prefetched_event_);
+    cudaEventDestroy(evaluated_event_);
+    prefetch_stream_ = nullptr;
+    prefetched_event_ = nullptr;
+    evaluated_event_ = nullptr;
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::BuildWaves(
+  vector<vector<shared_ptr<Block<T>>>>& waves,
+  bool by_cols)
+{
+  waves.clear();
+
+  auto begin = [by_cols](const shared_ptr<Block<T>>& block) {
+    return by_cols ? block->col() : block->row();
+  };
+
+  auto end = [by_cols](const shared_ptr<Block<T>>& block) {
+    return by_cols ? (block->col() + block->ncols()) : (block->row() + block->nrows());
+  };
+
+  vector<shared_ptr<Block<T>>> sorted = eval_blocks_;
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [&](const shared_ptr<Block<T>>& a, const shared_ptr<Block<T>>& b) { return begin(a) < begin(b); });
+
+  // end of the last block and index of each wave, the one which became
+  // free first on top
+  typedef std::pair<size_t, size_t> WaveEnd;
+  std::priority_queue<WaveEnd, vector<WaveEnd>, std::greater<WaveEnd>> wave_ends;
+
+  for(auto& block : sorted)
+  {
+    size_t wave;
+
+    if(!wave_ends.empty() && wave_ends.top().first <= begin(block))
+    {
+      wave = wave_ends.top().second;
+      wave_ends.pop();
+    }
+    else
+    {
+      wave = waves.size();
+      waves.push_back(vector<shared_ptr<Block<T>>>());
+    }
+
+    waves[wave].push_back(block);
+    wave_ends.push(WaveEnd(end(block), wave));
+  }
+}
+
+template<typename T>
+bool LinearOperator<T>::EpilogueFusable(
+  const vector<vector<shared_ptr<Block<T>>>>& waves,
+  bool by_cols,
+  size_t size) const
+{
+  if(waves.size() != 1)
+    return false;
+
+  // blocks in a wave are disjoint, so they cover everything iff their sizes add up
+  size_t covered = 0;
+  for(auto& block : waves[0])
+  {
+    if(!block->supports_epilogue())
+      return false;
+
+    covered += by_cols ? block->ncols() : block->nrows();
+  }
+
+  return covered == size;
+}
+
+template<typename T>
+void LinearOperator<T>::EvalBlocksAdd(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  bool transpose,
+  cudaStream_t stream,
+  const Epilogue<T> *epilogue)
+{
+  if(prefetch_stream_ != nullptr)
+  {
+    EvalBlocksStreamed(result, rhs, transpose, stream, epilogue);
+    return;
+  }
+
+  const vector<vector<shared_ptr<Block<T>>>>& waves = transpose ? col_waves_ : row_waves_;
+
+  for(auto& wave : waves)
+  {
+    // the waves themselves write overlapping ranges and run one after another
+    size_t num_forked = std::min(wave.size() - 1, streams_.size());
+
+    if(num_forked > 0)
+    {
+      cudaEventRecord(fork_event_, stream);
+      for(size_t i = 0; i < num_forked; i++)
+        cudaStreamWaitEvent(streams_[i], fork_event_, 0);
+    }
+
+    for(size_t i = 0; i < wave.size(); i++)
+    {
+      cudaStream_t s = (i % (num_forked + 1) == 0) ? stream : streams_[i % (num_forked + 1) - 1];
+
+      if(epilogue != nullptr)
+      {
+        if(transpose)
+          wave[i]->EvalAdjointAdd(result, rhs, *epilogue, s);
+        else
+          wave[i]->EvalAdd(result, rhs, *epilogue, s);
+      }
+      else
+      {
+        if(transpose)
+          wave[i]->EvalAdjointAdd(result, rhs, s);
+        else
+          wave[i]->EvalAdd(result, rhs, s);
+      }
+    }
+
+    for(size_t i = 0; i < num_forked; i++)
+    {
+      cudaEventRecord(join_events_[i], streams_[i]);
+      cudaStreamWaitEvent(stream, join_events_[i], 0);
+    }
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::EvalBlocksStreamed(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  bool transpose,
+  cudaStream_t stream,
+  const Epilogue<T> *epilogue)
+{
+  if(eval_blocks_.empty())
+    return;
+
+  const int device = context_->device();
+
+  // the prefetch of block i+1 waits for block i-1 to finish, so that it 
+  // only evicts pages which are no longer needed. before the first block
+  // this orders the prefetches after the previous evaluation.
+  cudaEventRecord(evaluated_event_, stream);
+  cudaStreamWaitEvent(prefetch_stream_, evaluated_event_, 0);
+  eval_blocks_[0]->Prefetch(device, transpose, prefetch_stream_);
+  cudaEventRecord(prefetched_event_, prefetch_stream_);
+
+  for(size_t i = 0; i < eval_blocks_.size(); i++)
+  {
+    cudaStreamWaitEvent(stream, prefetched_event_, 0);
+
+    if(i + 1 < eval_blocks_.size())
+    {
+      cudaStreamWaitEvent(prefetch_stream_, evaluated_event_, 0);
+      eval_blocks_[i + 1]->Prefetch(device, transpose, prefetch_stream_);
+      cudaEventRecord(prefetched_event_, prefetch_stream_);
+    }
+
+    if(epilogue != nullptr)
+    {
+      if(transpose)
+        eval_blocks_[i]->EvalAdjointAdd(result, rhs, *epilogue, stream);
+      else
+        eval_blocks_[i]->EvalAdd(result, rhs, *epilogue, stream);
+    }
+    else
+    {
+      if(transpose)
+        eval_blocks_[i]->EvalAdjointAdd(result, rhs, stream);
+      else
+        eval_blocks_[i]->EvalAdd(result, rhs, stream);
+    }
+
+    cudaEventRecord(evaluated_event_, stream);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::Partition(bool by_cols, vector<size_t>& bounds) const
+{
+  const vector<shared_ptr<Block<T>>>& sorted = by_cols ? col_sorted_ : row_sorted_;
+  const size_t size = by_cols ? ncols_ : nrows_;
+
+  // sweep over the blocks by their first index, a new part starts where
+  // no block reaches over
+  bounds.assign(1, 0);
+  size_t reach = 0;
+
+  for(auto& block : sorted)
+  {
+    const size_t begin = by_cols ? block->col() : block->row();
+    const size_t end = begin + (by_cols ? block->ncols() : block->nrows());
+
+    if(begin >= reach)
+    {
+      if(reach > bounds.back())
+        bounds.push_back(reach);
+
+      if(begin > bounds.back())
+        bounds.push_back(begin);
+    }
+
+    reach = std::max(reach, end);
+  }
+
+  if(reach > bounds.back())
+    bounds.push_back(reach);
+
+  if(size > bounds.back())
+    bounds.push_back(size);
+}
+
+template<typename T>
+void LinearOperator<T>::CollectRangeBlocks(bool by_cols, size_t begin, size_t end)
+{
+  const vector<shared_ptr<Block<T>>>& sorted = by_cols ? col_sorted_ : row_sorted_;
+
+  auto first = std::lower_bound(
+    sorted.begin(), sorted.end(), begin,
+    [by_cols](const shared_ptr<Block<T>>& block, size_t idx) 
+    { return (by_cols ? block->col() : block->row()) < idx; });
+
+  range_blocks_.clear();
+  for(auto it = first; it != sorted.end(); ++it)
+  {
+    if((by_cols ? (*it)->col() : (*it)->row()) >= end)
+      break;
+
+    range_blocks_.push_back(*it);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::EvalRangeBlocksAdd(
+  thrust::device_vector<T>& result,
+  const thrust::device_vector<T>& rhs,
+  bool transpose,
+  cudaStream_t stream)
+{
+  // the blocks of a range are few, they are evaluated on the caller's 
+  // stream. out of core they are paged in on demand.
+  for(auto& block : range_blocks_)
+  {
+    if(transpose)
+      block->EvalAdjointAdd(result, rhs, stream);
+    else
+      block->EvalAdd(result, rhs, stream);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::RowPartition(vector<size_t>& bounds) const
+{
+  Partition(false, bounds);
+}
+
+template<typename T>
+void LinearOperator<T>::EvalRowsAdd(
+  thrust::device_vector<T>& result,
+  const thrust::device_vector<T>& rhs,
+  size_t row_begin,
+  size_t row_end,
+  cudaStream_t stream)
+{
+  CollectRangeBlocks(false, row_begin, row_end);
+  EvalRangeBlocksAdd(result, rhs, false, stream);
+}
+
+template<typename T>
+void LinearOperator<T>::EvalAdjointRowsAdd(
+  thrust::device_vector<T>& result,
+  const thrust::device_vector<T>& rhs,
+  size_t row_begin,
+  size_t row_end,
+  cudaStream_t stream)
+{
+  CollectRangeBlocks(false, row_begin, row_end);
+  EvalRangeBlocksAdd(result, rhs, true, stream);
 }
 
 template<typename T>
 void LinearOperator<T>::Eval(
     thrust::device_vector<T>& result, 
     const thrust::device_vector<T>& rhs,
-    T beta)
+    T beta,
+    cudaStream_t stream)
 {
   if(beta == 0)
   {
-    thrust::fill(result.begin(), result.end(), 0);
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
   }
   else if(beta != 1)
   {
-    thrust::transform(result.begin(), result.end(), result.begin(), beta * thrust::placeholders::_1);
+    thrust::transform(thrust::cuda::par.on(stream), result.begin(), result.end(), result.begin(), beta * thrust::placeholders::_1);
   }
 
-  for(auto& block : blocks_)
-    block->EvalAdd(result, rhs);
+  EvalBlocksAdd(result, rhs, false, stream);
 }
 
 template<typename T>
 void LinearOperator<T>::EvalAdjoint(
   thrust::device_vector<T>& result, 
   const thrust::device_vector<T>& rhs,
-  T beta)
+  T beta,
+  cudaStream_t stream)
 {
   if(beta == 0)
   {
-    thrust::fill(result.begin(), result.end(), 0);
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
   }
   else if(beta != 1)
   {
-    thrust::transform(result.begin(), result.end(), result.begin(), beta * thrust::placeholders::_1);
+    thrust::transform(thrust::cuda::par.on(stream), result.begin(), result.end(), result.begin(), beta * thrust::placeholders::_1);
   }
 
-  for(auto& block : blocks_)
-    block->EvalAdjointAdd(result, rhs);
+  EvalBlocksAdd(result, rhs, true, stream);
+}
+
+template<typename T>
+void LinearOperator<T>::Eval(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(epilogue_rows_)
+  {
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
+    EvalBlocksAdd(result, rhs, false, stream, &epilogue);
+  }
+  else
+  {
+    Eval(result, rhs, 0, stream);
+    ApplyEpilogue(thrust::raw_pointer_cast(result.data()), result.size(), epilogue, stream);
+  }
+}
+
+template<typename T>
+void LinearOperator<T>::EvalAdjoint(
+  thrust::device_vector<T>& result, 
+  const thrust::device_vector<T>& rhs,
+  const Epilogue<T>& epilogue,
+  cudaStream_t stream)
+{
+  if(epilogue_cols_)
+  {
+    cudaMemsetAsync(thrust::raw_pointer_cast(result.data()), 0, result.size() * sizeof(T), stream);
+    EvalBlocksAdd(result, rhs, true, stream, &epilogue);
+  }
+  else
+  {
+    EvalAdjoint(result, rhs, 0, stream);
+    ApplyEpilogue(thrust::raw_pointer_cast(result.data()), result.size(), epilogue, stream);
+  }
 }
 
 template<typename T>
@@ -252,12 +812,71 @@ T LinearOperator<T>::col_sum(size_t col, T alpha) const
   return sum;
 }
 
+template<typename T>
+void LinearOperator<T>::RowSums(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  thrust::fill(thrust::cuda::par.on(stream), sums_begin, sums_begin + nrows_, T(0));
+
+  for(auto& block : eval_blocks_)
+    block->RowSumsAdd(sums_begin, alpha, stream);
+}
+
+template<typename T>
+void LinearOperator<T>::ColSums(
+  const typename device_vector<T>::iterator& sums_begin,
+  T alpha,
+  cudaStream_t stream)
+{
+  thrust::fill(thrust::cuda::par.on(stream), sums_begin, sums_begin + ncols_, T(0));
+
+  for(auto& block : eval_blocks_)
+    block->ColSumsAdd(sums_begin, alpha, stream);
+}
+
+template<typename T>
+void LinearOperator<T>::RowSums(vector<T>& sums, T alpha)
+{
+  device_vector<T> d_sums(nrows());
+  RowSums(d_sums.begin(), alpha);
+  sums.resize(nrows());
+  thrust::copy(d_sums.begin(), d_sums.end(), sums.begin());
+}
+
+template<typename T>
+void LinearOperator<T>::ColSums(vector<T>& sums, T alpha)
+{
+  device_vector<T> d_sums(ncols());
+  ColSums(d_sums.begin(), alpha);
+  sums.resize(ncols());
+  thrust::copy(d_sums.begin(), d_sums.end(), sums.begin());
+}
+
+template<typename T>
+bool LinearOperator<T>::GetTriplets(
+  vector<int32_t>& rows,
+  vector<int32_t>& cols,
+  vector<T>& vals) const
+{
+  rows.clear();
+  cols.clear();
+  vals.clear();
+
+  for(auto& block : blocks_)
+    if(!block->AppendTriplets(rows, cols, vals))
+      return false;
+
+  return true;
+}
+
 template<typename T>
 size_t LinearOperator<T>::gpu_mem_amount() const 
 {
   size_t mem = 0;
 
-  for(auto& block : blocks_)
+  for(auto& block : eval_blocks_)
     mem += block->gpu_mem_amount();
 
   return mem;
@@ -0,0 +1,114 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <new>
+
+#include "prost/managed_memory.hpp"
+
+namespace prost {
+
+namespace {
+
+/// \brief Set while a ManagedMemoryScope is alive on this thread.
+thread_local bool managed_scope = false;
+
+} // namespace
+
+void *AllocateOperatorMemory(size_t bytes)
+{
+  if(bytes == 0)
+    return nullptr;
+
+  void *ptr = nullptr;
+
+  if(managed_scope)
+  {
+    if(cudaMallocManaged(&ptr, bytes, cudaMemAttachGlobal) != cudaSuccess)
+    {
+      cudaGetLastError();
+      throw std::bad_alloc();
+    }
+
+    // the operator is only read by the iterations, so the pages can be
+    // duplicated on the GPU and are dropped instead of written back when
+    // they are evicted.
+    int device;
+    cudaGetDevice(&device);
+    cudaMemAdvise(ptr, bytes, cudaMemAdviseSetReadMostly, device);
+    cudaMemAdvise(ptr, bytes, cudaMemAdviseSetAccessedBy, device);
+    cudaGetLastError();
+  }
+  else if(cudaMalloc(&ptr, bytes) != cudaSuccess)
+  {
+    cudaGetLastError();
+    throw std::bad_alloc();
+  }
+
+  return ptr;
+}
+
+void FreeOperatorMemory(void *ptr)
+{
+  if(ptr != nullptr)
+    cudaFree(ptr);
+}
+
+void PrefetchOperatorMemory(
+  const void *ptr,
+  size_t bytes,
+  int device,
+  cudaStream_t stream)
+{
+  if(ptr == nullptr || bytes == 0)
+    return;
+
+  cudaPointerAttributes attr;
+  if(cudaPointerGetAttributes(&attr, ptr) != cudaSuccess)
+  {
+    cudaGetLastError();
+    return;
+  }
+
+  if(attr.type != cudaMemoryTypeManaged)
+    return;
+
+  cudaStreamCaptureStatus status;
+  if(cudaStreamIsCapturing(stream, &status) != cudaSuccess ||
+     status != cudaStreamCaptureStatusNone)
+    return;
+
+  if(device < 0)
+    cudaGetDevice(&device);
+
+  cudaMemPrefetchAsync(ptr, bytes, device, stream);
+}
+
+ManagedMemoryScope::ManagedMemoryScope(bool enable)
+  : prev_(managed_scope)
+{
+  managed_scope = prev_ || enable;
+}
+
+ManagedMemoryScope::~ManagedMemoryScope()
+{
+  managed_scope = prev_;
+}
+
+} // namespace prost
@@ -0,0 +1,461 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "prost/presolve.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+#include "prost/linop/block_sparse.hpp"
+#include "prost/linop/block_zero.hpp"
+#include "prost/linop/linearoperator.hpp"
+#include "prost/prox/prox.hpp"
+#include "prost/prox/prox_elem_operation.hpp"
+#include "prost/prox/prox_moreau.hpp"
+#include "prost/prox/prox_transform.hpp"
+#include "prost/prox/prox_zero.hpp"
+#include "prost/prox/elemop/elem_operation_1d.hpp"
+#include "prost/prox/elemop/function_1d.hpp"
+
+namespace prost {
+
+/// \brief Proximal point iterations in Presolve::Minimize. Proxs of
+///        indicator functions and their conjugates return after a single
+///        step, smooth functions contract by 1 / (1 + step * curvature).
+///        Slower rates are not trusted to bound the distance to the 
+///        minimizer.
+static const int kPresolveMaxIters = 1000;
+static const double kPresolveStep = 100;
+static const double kPresolveMaxRate = 0.9;
+
+template<typename T>
+using ProxIndEq0 = ProxElemOperation<T, ElemOperation1D<T, Function1DIndEq0<T>>>;
+
+/// \brief Writes the point x = b / a the variables of prox are fixed to,
+///        if prox is a 1D ind_eq0 with nonzero a and c.
+template<typename T>
+bool FixedValues(const shared_ptr<Prox<T>>& prox, vector<T>& x)
+{
+  shared_ptr<ProxIndEq0<T>> ind_eq0 = std::dynamic_pointer_cast<ProxIndEq0<T>>(prox);
+
+  if(!ind_eq0)
+    return false;
+
+  // coefficients h(x) = c f(ax - b) + dx + (e/2) x^2, scalars are broadcast
+  const auto& coeffs = ind_eq0->host_coefficients();
+  if(coeffs[0].empty() || coeffs[1].empty() || coeffs[2].empty())
+    return false;
+
+  auto coeff = [&coeffs](size_t k, size_t i) { 
+    return coeffs[k].size() > 1 ? coeffs[k][i] : coeffs[k][0]; 
+  };
+
+  for(size_t i = 0; i < prox->size(); i++)
+    if(coeff(0, i) == 0 || coeff(2, i) == 0)
+      return false;
+
+  for(size_t i = 0; i < prox->size(); i++)
+    x[prox->index() + i] = coeff(1, i) / coeff(0, i);
+
+  return true;
+}
+
+template<typename T>
+Presolve<T>::Presolve(shared_ptr<Problem<T>> problem)
+  : problem_(problem)
+{
+}
+
+template<typename T>
+bool Presolve<T>::Reduce(const vector<T>& x0, const vector<T>& y0)
+{
+  const size_t m = problem_->nrows();
+  const size_t n = problem_->ncols();
+
+  vector<int32_t> rows, cols;
+  vector<T> vals;
+
+  if(problem_->dualized() || !problem_->linop()->GetTriplets(rows, cols, vals))
+    return false;
+
+  const bool use_g = !problem_->prox_g().empty();
+  const bool use_f = !problem_->prox_f().empty();
+  const ProxList& col_proxs = use_g ? problem_->prox_g() : problem_->prox_gstar();
+  const ProxList& row_proxs = use_f ? problem_->prox_f() : problem_->prox_fstar();
+
+  // invalid problems are left to Problem::Initialize() to report
+  if(col_proxs.empty() || row_proxs.empty())
+    return false;
+
+  for(auto& prox : col_proxs)
+    if(prox->index() + prox->size() > n)
+      return false;
+
+  for(auto& prox : row_proxs)
+    if(prox->index() + prox->size() > m)
+      return false;
+
+  col_value_ = (x0.size() == n) ? x0 : vector<T>(n, 0);
+  row_value_ = (y0.size() == m) ? y0 : vector<T>(m, 0);
+
+  vector<bool> fixed(n, false);
+  if(use_g)
+  {
+    for(auto& prox : col_proxs)
+      if(FixedValues(prox, col_value_))
+        std::fill(fixed.begin() + prox->index(), 
+                  fixed.begin() + prox->index() + prox->size(), true);
+  }
+
+  // move the fixed columns to the right hand side
+  vector<bool> col_empty(n, true), row_empty(m, true);
+  shift_.assign(m, 0);
+  elim_rows_.clear();
+  elim_cols_.clear();
+  elim_vals_.clear();
+
+  for(size_t k = 0; k < vals.size(); k++)
+  {
+    if(vals[k] == 0)
+      continue;
+
+    if(fixed[cols[k]])
+    {
+      shift_[rows[k]] += vals[k] * col_value_[cols[k]];
+      elim_rows_.push_back(rows[k]);
+      elim_cols_.push_back(cols[k]);
+      elim_vals_.push_back(vals[k]);
+    }
+    else
+    {
+      col_empty[cols[k]] = false;
+      row_empty[rows[k]] = false;
+    }
+  }
+
+  for(size_t i = 0; i < m; i++)
+    if(shift_[i] != 0)
+      row_empty[i] = false;
+
+  // columns: fixed ones and minimizers of g over the empty ones
+  vector<bool> keep_col(n, true), keep_row(m, true);
+  ProxList kept_cols, kept_rows;
+
+  for(auto& prox : Cover(col_proxs, col_empty))
+  {
+    const size_t beg = prox->index(), end = prox->index() + prox->size();
+    bool eliminate = fixed[beg];
+
+    if(!eliminate && prox->supports_host_eval() &&
+       std::find(col_empty.begin() + beg, col_empty.begin() + end, false) == col_empty.begin() + end)
+    {
+      if(use_g)
+        eliminate = Minimize(*prox, col_value_);
+      else
+      {
+        ProxMoreau<T> g(prox);
+        eliminate = Minimize(g, col_value_);
+      }
+    }
+
+    if(eliminate)
+      std::fill(keep_col.begin() + beg, keep_col.begin() + end, false);
+    else
+      kept_cols.push_back(prox);
+  }
+
+  // rows: minimizers of f^* over the empty ones, z = 0 there
+  for(auto& prox : Cover(row_proxs, row_empty))
+  {
+    const size_t beg = prox->index(), end = prox->index() + prox->size();
+    bool eliminate = false;
+
+    if(prox->supports_host_eval() &&
+       std::find(row_empty.begin() + beg, row_empty.begin() + end, false) == row_empty.begin() + end)
+    {
+      if(use_f)
+      {
+        ProxMoreau<T> fstar(prox);
+        eliminate = Minimize(fstar, row_value_);
+      }
+      else
+        eliminate = Minimize(*prox, row_value_);
+    }
+
+    if(eliminate)
+      std::fill(keep_row.begin() + beg, keep_row.begin() + end, false);
+    else
+      kept_rows.push_back(prox);
+  }
+
+  const size_t red_n = std::count(keep_col.begin(), keep_col.end(), true);
+  const size_t red_m = std::count(keep_row.begin(), keep_row.end(), true);
+
+  if((red_n == n && red_m == m) || red_n == 0 || red_m == 0)
+    return false;
+
+  col_map_.assign(n, -1);
+  row_map_.assign(m, -1);
+
+  for(size_t j = 0, next = 0; j < n; j++)
+    if(keep_col[j])
+      col_map_[j] = next++;
+
+  for(size_t i = 0, next = 0; i < m; i++)
+    if(keep_row[i])
+      row_map_[i] = next++;
+
+  // the eliminated rows and columns have no entries left
+  vector<int32_t> red_rows, red_cols;
+  vector<T> red_vals;
+
+  for(size_t k = 0; k < vals.size(); k++)
+  {
+    if(vals[k] == 0 || fixed[cols[k]])
+      continue;
+
+    red_rows.push_back(row_map_[rows[k]]);
+    red_cols.push_back(col_map_[cols[k]]);
+    red_vals.push_back(vals[k]);
+  }
+
+  reduced_ = shared_ptr<Problem<T>>(new Problem<T>());
+  reduced_->SetDimensions(red_m, red_n);
+
+  if(red_vals.empty())
+    reduced_->AddBlock(shared_ptr<Block<T>>(new BlockZero<T>(0, 0, red_m, red_n)));
+  else
+    reduced_->AddBlock(shared_ptr<Block<T>>(
+        BlockSparse<T>::CreateFromTriplets(0, 0, red_m, red_n, red_rows, red_cols, red_vals)));
+
+  reduced_->scaling_type_ = problem_->scaling_type_;
+  reduced_->scaling_alpha_ = problem_->scaling_alpha_;
+  reduced_->scaling_left_host_ = Restrict(problem_->scaling_left_host_, row_map_);
+  reduced_->scaling_right_host_ = Restrict(problem_->scaling_right_host_, col_map_);
+  reduced_->batch_proxes_ = problem_->batch_proxes_;
+  reduced_->merge_blocks_ = problem_->merge_blocks_;
+
+  moved_.clear();
+  for(auto& prox : kept_cols)
+  {
+    moved_.push_back(std::make_pair(prox, prox->index()));
+    prox->set_index(col_map_[prox->index()]);
+
+    if(use_g)
+      reduced_->AddProx_g(prox);
+    else
+      reduced_->AddProx_gstar(prox);
+  }
+
+  for(auto& prox : kept_rows)
+  {
+    const size_t index = prox->index();
+    vector<T> neg_shift(prox->size());
+    std::transform(shift_.begin() + index, shift_.begin() + index + prox->size(),
+                   neg_shift.begin(), [](T c) { return -c; });
+
+    moved_.push_back(std::make_pair(prox, index));
+    prox->set_index(row_map_[index]);
+
+    shared_ptr<Prox<T>> red_prox = prox;
+    if(std::any_of(neg_shift.begin(), neg_shift.end(), [](T c) { return c != 0; }))
+    {
+      // f(z + c) = f(z - b) with b = -c, its conjugate is f^*(y) - <c, y>
+      const vector<T> one(1, 1), zero(1, 0);
+
+      if(use_f)
+        red_prox = shared_ptr<Prox<T>>(new ProxTransform<T>(prox, one, neg_shift, one, zero, zero));
+      else
+        red_prox = shared_ptr<Prox<T>>(new ProxTransform<T>(prox, one, zero, one, neg_shift, zero));
+    }
+
+    if(use_f)
+      reduced_->AddProx_f(red_prox);
+    else
+      reduced_->AddProx_fstar(red_prox);
+  }
+
+  return true;
+}
+
+template<typename T>
+void Presolve<T>::Restore()
+{
+  for(auto& moved : moved_)
+    moved.first->set_index(moved.second);
+
+  moved_.clear();
+}
+
+template<typename T>
+void Presolve<T>::Expand(
+  const vector<T>& x,
+  const vector<T>& z,
+  const vector<T>& y,
+  const vector<T>& w,
+  vector<T>& full_x,
+  vector<T>& full_z,
+  vector<T>& full_y,
+  vector<T>& full_w) const
+{
+  const size_t m = problem_->nrows();
+  const size_t n = problem_->ncols();
+
+  full_x.resize(n);
+  full_w.resize(n);
+  full_y.resize(m);
+  full_z.resize(m);
+
+  for(size_t j = 0; j < n; j++)
+  {
+    full_x[j] = (col_map_[j] >= 0) ? x[col_map_[j]] : col_value_[j];
+    full_w[j] = (col_map_[j] >= 0) ? w[col_map_[j]] : 0;
+  }
+
+  for(size_t i = 0; i < m; i++)
+  {
+    full_y[i] = (row_map_[i] >= 0) ? y[row_map_[i]] : row_value_[i];
+    full_z[i] = ((row_map_[i] >= 0) ? z[row_map_[i]] : 0) + shift_[i];
+  }
+
+  // w = -K^T y of the fixed columns, the empty ones have w = 0
+  for(size_t k = 0; k < elim_vals_.size(); k++)
+    full_w[elim_cols_[k]] -= elim_vals_[k] * full_y[elim_rows_[k]];
+}
+
+template<typename T>
+typename Presolve<T>::ProxList Presolve<T>::Cover(
+  const ProxList& proxs, 
+  const vector<bool>& empty)
+{
+  ProxList sorted = proxs;
+  std::sort(sorted.begin(), sorted.end(), 
+            [](const shared_ptr<Prox<T>>& a, const shared_ptr<Prox<T>>& b) { 
+              return a->index() < b->index(); 
+            });
+
+  ProxList covered;
+  size_t next = 0;
+
+  for(size_t i = 0; i <= sorted.size(); i++)
+  {
+    const size_t gap_end = (i < sorted.size()) ? sorted[i]->index() : empty.size();
+
+    if(gap_end < next)
+      throw Exception("Presolve: prox operators are overlapping.");
+
+    while(next < gap_end)
+    {
+      size_t run_end = next + 1;
+      while(run_end < gap_end && empty[run_end] == empty[next])
+        run_end++;
+
+      covered.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(next, run_end - next)));
+      next = run_end;
+    }
+
+    if(i < sorted.size())
+    {
+      covered.push_back(sorted[i]);
+      next = sorted[i]->index() + sorted[i]->size();
+    }
+  }
+
+  return covered;
+}
+
+template<typename T>
+bool Presolve<T>::Minimize(Prox<T>& prox, vector<T>& x)
+{
+  const T tol = std::sqrt(std::numeric_limits<T>::epsilon());
+  const size_t size = prox.size();
+
+  vector<T> cur(x.begin() + prox.index(), x.begin() + prox.index() + size);
+  vector<T> next(size);
+
+  if(ones_.size() < size)
+    ones_.resize(size, 1);
+
+  T diff_prev = std::numeric_limits<T>::infinity();
+
+  for(int it = 0; it < kPresolveMaxIters; it++)
+  {
+    prox.EvalHostLocal(next.data(), cur.data(), ones_.data(), 
+                       static_cast<T>(kPresolveStep), false);
+
+    T diff = 0, scale = 0;
+    for(size_t i = 0; i < size; i++)
+    {
+      diff = std::max(diff, std::abs(next[i] - cur[i]));
+      scale = std::max(scale, std::abs(next[i]));
+    }
+
+    cur.swap(next);
+
+    if(!std::isfinite(diff) || !std::isfinite(scale))
+      return false;
+
+    // a fixed point of the prox is a minimizer. otherwise, if the steps 
+    // contract by q < 1, the distance to the minimizer is bounded by 
+    // q / (1 - q) times the last step. the rate is measured between the
+    // last two steps, a small step alone (e.g. of a flat function) does
+    // not bound the distance.
+    bool converged = (diff == 0);
+    if(!converged && std::isfinite(diff_prev) && diff < diff_prev)
+    {
+      const T q = diff / diff_prev;
+      converged = (q < kPresolveMaxRate) && (diff * q / (1 - q) <= tol * (1 + scale));
+    }
+
+    if(converged)
+    {
+      std::copy(cur.begin(), cur.end(), x.begin() + prox.index());
+      return true;
+    }
+
+    diff_prev = diff;
+  }
+
+  return false;
+}
+
+template<typename T>
+vector<T> Presolve<T>::Restrict(const vector<T>& v, const vector<int32_t>& map)
+{
+  // empty initial solutions and scalar scalings are kept as they are
+  if(v.size() != map.size())
+    return v;
+
+  vector<T> restricted;
+  for(size_t i = 0; i < v.size(); i++)
+    if(map[i] >= 0)
+      restricted.push_back(v[i]);
+
+  return restricted;
+}
+
+// Explicit template instantiation
+template class Presolve<float>;
+template class Presolve<double>;
+
+} // namespace prost
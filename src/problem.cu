@@ -19,15 +19,27 @@
 */
 
 #include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
 #include <random>
+#include <typeinfo>
+#include <thrust/fill.h>
+#include <thrust/iterator/counting_iterator.h>
+#include <thrust/iterator/transform_iterator.h>
+#include <thrust/iterator/zip_iterator.h>
+#include <thrust/replace.h>
+#include <thrust/scan.h>
 #include <thrust/transform_reduce.h>
 
 #include "prost/problem.hpp"
 #include "prost/linop/linearoperator.hpp"
 #include "prost/linop/dual_linearoperator.hpp"
 #include "prost/prox/prox.hpp"
+#include "prost/prox/prox_workspace.hpp"
 #include "prost/prox/prox_zero.hpp"
 #include "prost/prox/prox_separable_sum.hpp"
+#include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
@@ -35,7 +47,7 @@ namespace prost {
 /// \brief Used for sorting prox operators according to their starting index.
 template<typename T>
 struct ProxCompare {
-  bool operator()(std::shared_ptr<Prox<T> > const& left, std::shared_ptr<Prox<T> > const& right) {
+  bool operator()(std::shared_ptr<Prox<T> > const& left, std::shared_ptr<Prox<T> > const& right) const {
     if(left->index() < right->index())
       return true;
 
@@ -43,122 +55,121 @@ struct ProxCompare {
   }
 };
 
-/// \brief Checks whether the whole domain is covered by prox operators.
+/// \brief Sorts the prox operators by their starting index, fills the gaps
+///        in the domain with zero prox operators and checks that they do 
+///        not overlap, in a single pass. The list is left sorted, so that 
+///        a repeated initialization only has to verify the order.
 template<typename T>
-void CheckDomainProx(const typename Problem<T>::ProxList& proxs, size_t n, const std::string& name)
+void CoverDomainProx(typename Problem<T>::ProxList& proxs, size_t n, const std::string& name)
 {
-  size_t num_proxs = proxs.size();
-
-  if(0 == num_proxs)
+  if(proxs.empty())
     return;
 
-  typename Problem<T>::ProxList sorted_proxs = proxs;
-  std::sort(sorted_proxs.begin(), sorted_proxs.end(), ProxCompare<T>());
+  if(!std::is_sorted(proxs.begin(), proxs.end(), ProxCompare<T>()))
+    std::sort(proxs.begin(), proxs.end(), ProxCompare<T>());
+
+  typename Problem<T>::ProxList covered;
+  covered.reserve(proxs.size());
 
-  for(size_t i = 0; i < num_proxs - 1; i++) {
-    
-    if(sorted_proxs[i]->end() != (sorted_proxs[i + 1]->index() - 1))
+  // first index which is not covered yet
+  size_t next = 0;
+
+  for(auto& prox : proxs)
+  {
+    if(prox->index() < next)
     {
       stringstream ss;
 
-      ss << name << " (CheckDomainProx): Prox operators are overlapping: [";
-      ss << sorted_proxs[i]->index() << ", " << sorted_proxs[i]->end() << "] and [";
-      ss << sorted_proxs[i + 1]->index() << ", " << sorted_proxs[i + 1]->end() << "]." << endl;
+      ss << name << " (CoverDomainProx): Prox operators are overlapping: [";
+      ss << covered.back()->index() << ", " << covered.back()->end() << "] and [";
+      ss << prox->index() << ", " << prox->end() << "]." << endl;
       throw Exception(ss.str());
     }
+
+    if(prox->index() > next)
+      covered.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(next, prox->index() - next)));
+
+    covered.push_back(prox);
+    next = prox->end() + 1;
   }
 
-  if(sorted_proxs[num_proxs - 1]->end() != (n - 1)) {
+  if(next > n)
+  {
     stringstream ss;
 
-    if(sorted_proxs[num_proxs - 1]->end() < (n - 1)) 
-    {
-      ss << name << " (CheckDomainProx): Last prox operator ends too early: [";
-      ss << sorted_proxs[num_proxs - 1]->index() << ", " << sorted_proxs[num_proxs - 1]->end() << "], end = ";
-      ss << n - 1 << "." << endl;
-      throw Exception(ss.str());
-    }
-    else
-    {
-      ss << name << " (CheckDomainProx): Last prox operator ends after the domain: [";
-      ss << sorted_proxs[num_proxs - 1]->index() << ", " << sorted_proxs[num_proxs - 1]->end() << "], end = ";
-      ss << n - 1 << "." << endl;
-      throw Exception(ss.str());
-    }
+    ss << name << " (CoverDomainProx): Last prox operator ends after the domain: [";
+    ss << covered.back()->index() << ", " << covered.back()->end() << "], end = ";
+    ss << n - 1 << "." << endl;
+    throw Exception(ss.str());
   }
+
+  if(next < n)
+    covered.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(next, n - next)));
+
+  if(covered.size() != proxs.size())
+    proxs.swap(covered);
 }
 
-/// \brief Fills up domain with zero prox operators
 template<typename T>
-void AddZeroProx(typename Problem<T>::ProxList& proxs, size_t n, const std::string& name)
+void Problem<T>::BatchProxes(ProxList& proxs)
 {
-  size_t num_proxs = proxs.size();
-  
-  //std::cout << name << "," << num_proxs << std::endl;
+  typename Problem<T>::ProxList batched;
+  typename Problem<T>::ProxList run;
+  shared_ptr<Prox<T>> run_type;
+  size_t run_members = 0;
 
-  if(0 == num_proxs)
-    return;
-  
-  typename Problem<T>::ProxList sorted_proxs = proxs;
-  std::sort(sorted_proxs.begin(), sorted_proxs.end(), ProxCompare<T>());
+  auto flush = [&]() {
+    shared_ptr<Prox<T>> batch;
 
-/*
-  for(size_t i = 0; i < num_proxs; i++) 
-    std::cout << sorted_proxs[i]->index() << ", " << sorted_proxs[i]->end() << std::endl;
-*/
+    if(run_members > 1)
+      batch = shared_ptr<Prox<T>>(run_type->CreateBatch(run));
 
-  if(sorted_proxs[0]->index() > 0)
-  {
-//    std::cout << name << ": added zero prox [" << 0 << ", " << sorted_proxs[0]->index() << "]." << std::endl;
-    proxs.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(0, sorted_proxs[0]->index())));
-  }
+    if(batch)
+      batched.push_back(batch);
+    else
+      batched.insert(batched.end(), run.begin(), run.end());
+
+    run.clear();
+    run_type.reset();
+    run_members = 0;
+  };
 
-  for(size_t i = 0; i < num_proxs - 1; i++) 
+  for(auto& prox : proxs)
   {
-    if(sorted_proxs[i]->end() < (sorted_proxs[i + 1]->index() - 1))
-    {
-      size_t prox_start = sorted_proxs[i]->end() + 1;
-      size_t prox_size = sorted_proxs[i + 1]->index() - sorted_proxs[i]->end() - 1;
+    const bool is_zero = 
+      dynamic_cast<ProxZero<T> *>(prox.get()) != nullptr &&
+      prox->size() <= kProxBatchMaxSize;
 
-      // fill with zero prox
-//      std::cout << name << ": added zero prox [" << prox_start << ", " << prox_start + prox_size << "]." << std::endl;
-      proxs.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(prox_start, prox_size)));
-    }
-    else if(sorted_proxs[i]->end() < (sorted_proxs[i + 1]->index() - 1))
+    if(is_zero)
     {
-      stringstream ss;
+      run.push_back(prox);
+      continue;
+    }
 
-      ss << name << " (AddZeroProx): Prox operators are overlapping: [";
-      ss << sorted_proxs[i]->index() << ", " << sorted_proxs[i]->end() << "] and [";
-      ss << sorted_proxs[i + 1]->index() << ", " << sorted_proxs[i + 1]->end() << "]." << endl;
-      throw Exception(ss.str());
+    if(!prox->batchable())
+    {
+      flush();
+      batched.push_back(prox);
+      continue;
     }
-  }
 
-  if(sorted_proxs[num_proxs - 1]->end() != (n - 1)) {
-    stringstream ss;
+    if(run_type && 
+       (typeid(*prox) != typeid(*run_type) || prox->diagsteps() != run_type->diagsteps()))
+      flush();
 
-    if(sorted_proxs[num_proxs - 1]->end() < (n - 1)) 
-    {
-      size_t prox_start = sorted_proxs[num_proxs - 1]->end() + 1;
-      size_t prox_size = (n - 1) - sorted_proxs[num_proxs - 1]->end();
+    if(!run_type)
+      run_type = prox;
 
-      // fill with zero prox
-//      std::cout << name << ": added zero prox [" << prox_start << ", " << prox_start + prox_size << "]." << std::endl;
-      proxs.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(prox_start, prox_size)));
-    }
-    else
-    {
-      ss << name << " (AddZeroProx): Last prox operator ends after the domain: [";
-      ss << sorted_proxs[num_proxs - 1]->index() << ", " << sorted_proxs[num_proxs - 1]->end() << "], end = ";
-      ss << n - 1 << "." << endl;
-      throw Exception(ss.str());
-    }
+    run.push_back(prox);
+    run_members++;
   }
+  flush();
+
+  proxs.swap(batched);
 }
 
 template<typename T>
-Problem<T>::Problem() : linop_(new LinearOperator<T>()) { }
+Problem<T>::Problem() : linop_(new LinearOperator<T>()), scaling_version_(0), batch_proxes_(true), merge_blocks_(true), dualized_(false), initialized_host_(false) { }
 
 template<typename T>
 void Problem<T>::AddBlock(std::shared_ptr<Block<T> > block)
@@ -195,6 +206,12 @@ void Problem<T>::AddProx_fstar(std::shared_ptr<Prox<T> > prox)
 template<typename T>
 void Problem<T>::Initialize()
 {
+  // the operators are built from the primal formulation
+  if(dualized_)
+    Dualize();
+
+  linop_->set_context(context_);
+  linop_->set_merge_blocks(merge_blocks_);
   linop_->Initialize();
 
   if(linop_->nrows() != nrows_ || linop_->ncols() != ncols_)
@@ -207,6 +224,81 @@ void Problem<T>::Initialize()
     ncols_ = linop_->ncols();
   */
 
+  CheckProxes();
+
+  // merge small neighbouring proxs into single kernel launches
+  if(batch_proxes_)
+  {
+    for(ProxList *list : { &prox_f_, &prox_fstar_, &prox_g_, &prox_gstar_ })
+      BatchProxes(*list);
+  }
+
+  // Init Proxs
+  // the proxs are evaluated one after another, so they can share their
+  // scratch memory
+  size_t scratch = 0;
+  for(const ProxList *list : { &prox_f_, &prox_fstar_, &prox_g_, &prox_gstar_ })
+    for(auto& prox : *list)
+      scratch = std::max(scratch, prox->scratch_size());
+
+  prox_workspace_ = shared_ptr<ProxWorkspace<T>>(new ProxWorkspace<T>());
+  prox_workspace_->Reserve(scratch);
+
+  for(const ProxList *list : { &prox_f_, &prox_fstar_, &prox_g_, &prox_gstar_ })
+    for(auto& prox : *list)
+    {
+      prox->set_workspace(prox_workspace_);
+
+      if(context_)
+        prox->set_context(context_);
+    }
+
+  for(auto& prox : prox_f_) 
+    prox->Initialize();
+
+  for(auto& prox : prox_fstar_) 
+    prox->Initialize();
+
+  for(auto& prox : prox_g_) 
+    prox->Initialize();
+
+  for(auto& prox : prox_gstar_) 
+    prox->Initialize(); 
+
+  InitializeScaling();
+  initialized_host_ = false;
+
+  dual_linop_ = shared_ptr<LinearOperator<T>>(new DualLinearOperator<T>(linop_));
+}
+
+template<typename T>
+void Problem<T>::InitializeHost()
+{
+  if(dualized_)
+    Dualize();
+
+  CheckProxes();
+
+  for(const ProxList *list : { &prox_f_, &prox_fstar_, &prox_g_, &prox_gstar_ })
+    for(auto& prox : *list)
+    {
+      if(!prox->supports_host_eval())
+      {
+        stringstream ss;
+        ss << "Prox " << typeid(*prox).name() << " at index " << prox->index() << " cannot be evaluated on the host.";
+        throw Exception(ss.str());
+      }
+    }
+
+  InitializeScalingHost();
+  initialized_host_ = true;
+
+  dual_linop_ = shared_ptr<LinearOperator<T>>(new DualLinearOperator<T>(linop_));
+}
+
+template<typename T>
+void Problem<T>::CheckProxes()
+{
   if(prox_f_.empty() && prox_fstar_.empty())
   {
     //prox_f_.push_back(shared_ptr<Prox<T>>(new ProxZero<T>(0, nrows_)));
@@ -226,100 +318,202 @@ void Problem<T>::Initialize()
   if(!prox_g_.empty() && !prox_gstar_.empty())
     throw Exception("Proximal operator for g AND gstar specified. Only set one!");
 
-  // Set zero prox where prox operators are not specified.
-  if(!prox_f_.empty()) 
-    AddZeroProx<T>(prox_f_, nrows_, "prox_f");
-
-  if(!prox_g_.empty()) 
-    AddZeroProx<T>(prox_g_, ncols_, "prox_g");
-
-  if(!prox_fstar_.empty()) 
-    AddZeroProx<T>(prox_fstar_, nrows_, "prox_fstar");
-
-  if(!prox_gstar_.empty()) 
-    AddZeroProx<T>(prox_gstar_, ncols_, "prox_gstar");
+  // set zero prox where prox operators are not specified and check that
+  // the whole domain is covered without overlap
+  CoverDomainProx<T>(prox_f_, nrows_, "prox_f");
+  CoverDomainProx<T>(prox_g_, ncols_, "prox_g");
+  CoverDomainProx<T>(prox_fstar_, nrows_, "prox_fstar");
+  CoverDomainProx<T>(prox_gstar_, ncols_, "prox_gstar");
+}
 
-  // check if whole domain is covered by prox operators
-  CheckDomainProx<T>(prox_g_, ncols_, "prox_g");
-  CheckDomainProx<T>(prox_f_, nrows_, "prox_f");
-  CheckDomainProx<T>(prox_gstar_, ncols_, "prox_gstar");
-  CheckDomainProx<T>(prox_fstar_, nrows_, "prox_fstar");
+template<typename T>
+void Problem<T>::Update()
+{
+  linop_->Update();
 
-  // Init Proxs
-  for(auto& prox : prox_f_) 
-    prox->Initialize();
+  for(const ProxList *list : { &prox_f_, &prox_fstar_, &prox_g_, &prox_gstar_ })
+    for(auto& prox : *list)
+      prox->Update();
 
-  for(auto& prox : prox_fstar_) 
-    prox->Initialize();
+  // only the alpha scaling depends on the operator values, host problems
+  // keep their preconditioners in host_scaling_left_/right_
+  if(scaling_type_ == Problem<T>::Scaling::kScalingAlpha)
+  {
+    if(initialized_host_)
+      InitializeScalingHost();
+    else
+      InitializeScaling();
+  }
+}
 
-  for(auto& prox : prox_g_) 
-    prox->Initialize();
+/// \brief Inverts positive sums and marks the others by zero.
+template<typename T>
+struct precond_invert
+{
+  __host__ __device__
+  T operator()(const T& sum) const 
+  { 
+    return (sum > 0) ? (1 / sum) : 0;
+  }
+};
 
-  for(auto& prox : prox_gstar_) 
-    prox->Initialize(); 
+/// \brief Associative scan operator carrying the last valid (nonzero) value
+///        over entries without one.
+template<typename T>
+struct precond_carry
+{
+  __host__ __device__
+  T operator()(const T& a, const T& b) const 
+  { 
+    return (b > 0) ? b : a;
+  }
+};
 
-  // Init Scaling
-  if(scaling_type_ == Problem<T>::Scaling::kScalingAlpha)
-  {
-    scaling_left_host_ = std::vector<T>(nrows_);
-    scaling_right_host_ = std::vector<T>(ncols_);
+template<typename T>
+__global__
+void AveragePreconditionersKernel(
+  T *d_precond,
+  const size_t *d_groups,
+  size_t num_groups)
+{
+  const size_t tx = threadIdx.x + blockIdx.x * blockDim.x;
 
-    T value = 1;
-    for(size_t row = 0; row < nrows(); row++)
-    {
-      T rowsum = linop_->row_sum(row, scaling_alpha_);
+  if(tx >= num_groups)
+    return;
 
-      if(rowsum > 0)
-        value = 1. / rowsum;
+  const size_t idx = d_groups[3 * tx + 0];
+  const size_t cnt = d_groups[3 * tx + 1];
+  const size_t std = d_groups[3 * tx + 2];
 
-      scaling_left_host_[row] = value;
-    }
+  // compute average
+  T avg = 0;
+  for(size_t c = 0; c < cnt; c++)
+    avg += d_precond[idx + c * std];
+  avg /= static_cast<T>(cnt);
 
-    for(size_t col = 0; col < ncols(); col++)
-    {
-      T colsum = linop_->col_sum(col, 2. - scaling_alpha_);
+  // fill values
+  for(size_t c = 0; c < cnt; c++)
+    d_precond[idx + c * std] = avg;
+}
 
-      if(colsum > 0)
-        value = 1. / colsum;
+template<typename T>
+void Problem<T>::InitializeScaling()
+{
+  scaling_left_.resize(nrows());
+  scaling_right_.resize(ncols());
 
-      scaling_right_host_[col] = value;
-    }
+  if(scaling_type_ == Problem<T>::Scaling::kScalingAlpha)
+  {
+    // rows and columns share one buffer, so that entries with zero sum
+    // take the preceding value across the boundary as well
+    device_vector<T> sums(nrows() + ncols());
+    device_vector<T> precond(nrows() + ncols());
+
+    linop_->RowSums(sums.begin(), scaling_alpha_);
+    linop_->ColSums(sums.begin() + nrows(), 2. - scaling_alpha_);
+
+    thrust::inclusive_scan(
+      thrust::make_transform_iterator(sums.begin(), precond_invert<T>()),
+      thrust::make_transform_iterator(sums.end(), precond_invert<T>()),
+      precond.begin(),
+      precond_carry<T>());
+
+    // leading entries without a valid value
+    thrust::replace(precond.begin(), precond.end(), static_cast<T>(0), static_cast<T>(1));
+
+    thrust::copy(
+      precond.begin(),
+      precond.begin() + nrows(),
+      scaling_left_.begin());
+
+    thrust::copy(
+      precond.begin() + nrows(),
+      precond.end(),
+      scaling_right_.begin());
   }
   else if(scaling_type_ == Problem<T>::Scaling::kScalingIdentity)
   {
-    scaling_left_host_ = std::vector<T>(nrows_, 1);
-    scaling_right_host_ = std::vector<T>(ncols_, 1);
+    thrust::fill(scaling_left_.begin(), scaling_left_.end(), static_cast<T>(1));
+    thrust::fill(scaling_right_.begin(), scaling_right_.end(), static_cast<T>(1));
   }
   else if(scaling_type_ == Problem<T>::Scaling::kScalingCustom)
   {
     if((scaling_left_host_.size() != nrows_) || (scaling_right_host_.size() != ncols_))
       throw Exception("Preconditioners/diagonal scaling vectors do not fit the size of linear operator.");
+
+    thrust::copy(
+      scaling_left_host_.begin(), 
+      scaling_left_host_.end(), 
+      scaling_left_.begin());
+
+    thrust::copy(
+      scaling_right_host_.begin(), 
+      scaling_right_host_.end(), 
+      scaling_right_.begin());
   }
 
   // average preconditioners at places where prox doesn't allow diagsteps
   AveragePreconditioners(
-    scaling_right_host_,
+    scaling_right_,
     prox_g_.empty() ? prox_gstar_ : prox_g_);
 
   AveragePreconditioners(
-    scaling_left_host_,
+    scaling_left_,
     prox_f_.empty() ? prox_fstar_ : prox_f_);
 
-  // copy to gpu
-  scaling_left_.resize(nrows());
-  scaling_right_.resize(ncols());
+  scaling_version_ = new_version_id();
+}
+
+template<typename T>
+void Problem<T>::InitializeScalingHost()
+{
+  host_scaling_left_.assign(nrows(), 1);
+  host_scaling_right_.assign(ncols(), 1);
 
-  thrust::copy(
-    scaling_left_host_.begin(), 
-    scaling_left_host_.end(), 
-    scaling_left_.begin());
+  if(scaling_type_ == Problem<T>::Scaling::kScalingAlpha)
+  {
+    vector<int32_t> rows, cols;
+    vector<T> vals;
 
-  thrust::copy(
-    scaling_right_host_.begin(), 
-    scaling_right_host_.end(), 
-    scaling_right_.begin());
+    if(!linop_->GetTriplets(rows, cols, vals))
+      throw Exception("The linear operator contains blocks which do not store their entries.");
 
-  dual_linop_ = shared_ptr<LinearOperator<T>>(new DualLinearOperator<T>(linop_));
+    vector<T> sums(nrows() + ncols(), 0);
+    for(size_t k = 0; k < vals.size(); k++)
+    {
+      sums[rows[k]] += std::pow(std::abs(vals[k]), scaling_alpha_);
+      sums[nrows() + cols[k]] += std::pow(std::abs(vals[k]), 2 - scaling_alpha_);
+    }
+
+    // same as the scan in InitializeScaling()
+    T last = 1;
+    for(size_t i = 0; i < sums.size(); i++)
+    {
+      if(sums[i] > 0)
+        last = 1 / sums[i];
+
+      if(i < nrows())
+        host_scaling_left_[i] = last;
+      else
+        host_scaling_right_[i - nrows()] = last;
+    }
+  }
+  else if(scaling_type_ == Problem<T>::Scaling::kScalingCustom)
+  {
+    if((scaling_left_host_.size() != nrows_) || (scaling_right_host_.size() != ncols_))
+      throw Exception("Preconditioners/diagonal scaling vectors do not fit the size of linear operator.");
+
+    host_scaling_left_ = scaling_left_host_;
+    host_scaling_right_ = scaling_right_host_;
+  }
+
+  AveragePreconditioners(
+    host_scaling_right_,
+    prox_g_.empty() ? prox_gstar_ : prox_g_);
+
+  AveragePreconditioners(
+    host_scaling_left_,
+    prox_f_.empty() ? prox_fstar_ : prox_f_);
 }
 
 template<typename T>
@@ -338,6 +532,9 @@ void Problem<T>::Release()
 
   for(auto& prox : prox_gstar_) 
     prox->Release();
+
+  if(prox_workspace_)
+    prox_workspace_->Release();
 }
 
 template<typename T>
@@ -388,6 +585,9 @@ size_t Problem<T>::gpu_mem_amount() const
   mem += linop_->gpu_mem_amount();
   mem += sizeof(T) * (nrows() + ncols());
 
+  if(prox_workspace_)
+    mem += prox_workspace_->gpu_mem_amount();
+
   return mem;
 }
 
@@ -419,93 +619,248 @@ template<typename T>
 struct normest_multiplies_sqrt : public thrust::binary_function<T, T, T>
 {
   __host__ __device__
-  T operator()(const T& a, const T& b) const
+  T operator()(const T& x, const T& y) const 
+  { 
+    return sqrt(x) * y;
+  }
+};
+
+/// \brief Computes y - a * x.
+template<typename T>
+struct normest_subtract_scaled : public thrust::binary_function<T, T, T>
+{
+  normest_subtract_scaled(T a) : a_(a) { }
+
+  __host__ __device__
+  T operator()(const T& x, const T& y) const 
+  { 
+    return y - a_ * x;
+  }
+
+  T a_;
+};
+
+/// \brief Integer hash, used to generate the start vector on the GPU.
+__host__ __device__
+inline uint32_t normest_hash(uint32_t x)
+{
+  x ^= x >> 16;
+  x *= 0x7feb352d;
+  x ^= x >> 15;
+  x *= 0x846ca68b;
+  x ^= x >> 16;
+  return x;
+}
+
+/// \brief Uniformly distributed value in (0, 1) for index i.
+template<typename T>
+struct normest_random
+{
+  __host__ __device__
+  T operator()(size_t i) const 
+  { 
+    return (static_cast<T>(normest_hash(static_cast<uint32_t>(i))) + 0.5) / 4294967296.;
+  }
+};
+
+/// \brief Largest eigenvalue of the symmetric tridiagonal matrix with 
+///        diagonal alpha and off-diagonal beta[1..k-1], by bisection on
+///        the Sturm sequence.
+static double LanczosLargestEigenvalue(
+  const std::vector<double>& alpha,
+  const std::vector<double>& beta)
+{
+  const size_t k = alpha.size();
+
+  // Gershgorin bounds
+  double lo = 0, hi = 0;
+  for(size_t i = 0; i < k; i++)
   {
-    return sqrt(a)*b;
+    const double r = (i > 0 ? std::abs(beta[i]) : 0) + (i + 1 < k ? std::abs(beta[i + 1]) : 0);
+    lo = std::min(lo, alpha[i] - r);
+    hi = std::max(hi, alpha[i] + r);
+  }
+
+  for(int it = 0; it < 100 && (hi - lo) > 1e-15 * std::abs(hi); it++)
+  {
+    const double x = 0.5 * (lo + hi);
+
+    // number of eigenvalues smaller than x
+    size_t count = 0;
+    double q = 1;
+    for(size_t i = 0; i < k; i++)
+    {
+      q = alpha[i] - x - (i > 0 ? beta[i] * beta[i] / q : 0);
+
+      if(q == 0)
+        q = -1e-300;
+
+      if(q < 0)
+        count++;
+    }
+
+    if(count == k)
+      hi = x;
+    else
+      lo = x;
   }
+
+  return hi;
+}
+
+/// \brief Cached operator norm, identified by the versions of K and of the
+///        preconditioners. Both are unique within the process, so entries
+///        of released problems are never hit again.
+struct NormestCacheEntry
+{
+  uint64_t linop_version;
+  uint64_t scaling_version;
+  double tol;
+  double norm;
 };
 
+static const size_t kNormestCacheSize = 16;
+static std::list<NormestCacheEntry> normest_cache;
+static std::mutex normest_cache_mutex;
+
+template<typename T>
+void Problem<T>::ClearNormestCache()
+{
+  std::lock_guard<std::mutex> lock(normest_cache_mutex);
+  normest_cache.clear();
+}
+
+template<typename T>
+void Problem<T>::ApplyScaledOperator(
+  device_vector<T>& result,
+  const device_vector<T>& rhs,
+  device_vector<T>& temp_rhs,
+  device_vector<T>& temp_result,
+  bool adjoint)
+{
+  const device_vector<T>& scaling_rhs = adjoint ? scaling_left_ : scaling_right_;
+  const device_vector<T>& scaling_res = adjoint ? scaling_right_ : scaling_left_;
+
+  thrust::transform(
+    scaling_rhs.begin(), 
+    scaling_rhs.end(),
+    rhs.begin(), 
+    temp_rhs.begin(), 
+    normest_multiplies_sqrt<T>());
+
+  if(adjoint)
+    linop_->EvalAdjoint(temp_result, temp_rhs);
+  else
+    linop_->Eval(temp_result, temp_rhs);
+
+  thrust::transform(
+    scaling_res.begin(), 
+    scaling_res.end(),
+    temp_result.begin(), 
+    result.begin(), 
+    normest_multiplies_sqrt<T>());
+}
+
 template<typename T>
 T Problem<T>::normest(T tol, int max_iters)
 {
-  thrust::device_vector<T> x(ncols()), Ax(nrows());
-  thrust::device_vector<T> x_temp(ncols()), Ax_temp(nrows());
+  const size_t n = ncols(), m = nrows();
+  const uint64_t linop_version = linop_->version();
+
+  {
+    std::lock_guard<std::mutex> lock(normest_cache_mutex);
+    for(auto it = normest_cache.begin(); it != normest_cache.end(); ++it)
+    {
+      if(it->linop_version == linop_version &&
+         it->scaling_version == scaling_version_ &&
+         it->tol <= tol)
+      {
+        normest_cache.splice(normest_cache.begin(), normest_cache, it);
+        return static_cast<T>(normest_cache.front().norm);
+      }
+    }
+  }
+
+  // Lanczos vectors v_{j-1}, v_j and residual w of A^T A with A = Sigma^{1/2} K Tau^{1/2}
+  device_vector<T> v_prev(n, 0), v(n), w(n), x_temp(n);
+  device_vector<T> u(m), Ax_temp(m);
 
-  std::vector<T> x_host(ncols());
-  std::generate(x_host.begin(), x_host.end(), []{ return (T)std::rand() / (T)RAND_MAX; } );
-  thrust::copy(x_host.begin(), x_host.end(), x.begin());
+  thrust::transform(
+    thrust::counting_iterator<size_t>(0),
+    thrust::counting_iterator<size_t>(n),
+    v.begin(),
+    normest_random<T>());
+
+  const T norm_v = std::sqrt( thrust::transform_reduce(
+      v.begin(), 
+      v.end(), 
+      normest_square<T>(), 
+      static_cast<T>(0), 
+      thrust::plus<T>()) ); 
+
+  thrust::transform(v.begin(), v.end(), v.begin(), normest_divide<T>(norm_v));
+
+  std::vector<double> alpha, beta(1, 0);
+  double norm = 0, norm_prev;
 
-  T norm = 0, norm_prev;
   for(int i = 0; i < max_iters; i++)
   {
     norm_prev = norm;
 
-    thrust::transform(
-      scaling_right_.begin(), 
-      scaling_right_.end(),
-      x.begin(), 
-      x_temp.begin(), 
-      normest_multiplies_sqrt<T>());
+    // u = A v_j, alpha_j = <v_j, A^T A v_j> = |u|^2
+    ApplyScaledOperator(u, v, x_temp, Ax_temp, false);
 
-    linop_->Eval(Ax_temp, x_temp);
-
-    thrust::transform(
-      scaling_left_.begin(), 
-      scaling_left_.end(),
-      Ax_temp.begin(), 
-      Ax.begin(), 
-      normest_multiplies_sqrt<T>());
-
-    T norm_Ax = std::sqrt( thrust::transform_reduce(
-        Ax.begin(), 
-        Ax.end(), 
+    alpha.push_back( thrust::transform_reduce(
+        u.begin(), 
+        u.end(), 
         normest_square<T>(), 
         static_cast<T>(0), 
         thrust::plus<T>()) ); 
 
-    thrust::transform(
-      scaling_left_.begin(), 
-      scaling_left_.end(),
-      Ax.begin(), 
-      Ax_temp.begin(), 
-      normest_multiplies_sqrt<T>());
+    // w = A^T u - alpha_j v_j - beta_j v_{j-1}
+    ApplyScaledOperator(w, u, Ax_temp, x_temp, true);
 
-    linop_->EvalAdjoint(x_temp, Ax_temp);
+    thrust::transform(
+      v.begin(), v.end(), w.begin(), w.begin(),
+      normest_subtract_scaled<T>(static_cast<T>(alpha.back())));
 
     thrust::transform(
-      scaling_right_.begin(), 
-      scaling_right_.end(),
-      x_temp.begin(), 
-      x.begin(), 
-      normest_multiplies_sqrt<T>());
-
-    T norm_x = std::sqrt( thrust::transform_reduce(
-        x.begin(), 
-        x.end(), 
+      v_prev.begin(), v_prev.end(), w.begin(), w.begin(),
+      normest_subtract_scaled<T>(static_cast<T>(beta.back())));
+
+    const double beta_next = std::sqrt( thrust::transform_reduce(
+        w.begin(), 
+        w.end(), 
         normest_square<T>(), 
         static_cast<T>(0), 
         thrust::plus<T>()) ); 
 
-    norm = norm_x / norm_Ax;
+    norm = std::sqrt(LanczosLargestEigenvalue(alpha, beta));
 
-    if(std::abs(norm_prev - norm) < tol * norm)
-    {
+    // converged or the Krylov space is invariant
+    if(std::abs(norm_prev - norm) < tol * norm || beta_next <= 1e-12 * norm * norm)
       break;
-    }
 
-    thrust::transform(x.begin(), x.end(), x.begin(), normest_divide<T>(norm_x));
+    beta.push_back(beta_next);
+    v_prev.swap(v);
+    thrust::transform(w.begin(), w.end(), v.begin(), normest_divide<T>(static_cast<T>(beta_next)));
   }
 
-  return norm;
+  std::lock_guard<std::mutex> lock(normest_cache_mutex);
+  NormestCacheEntry entry = { linop_version, scaling_version_, static_cast<double>(tol), norm };
+  normest_cache.push_front(entry);
+  if(normest_cache.size() > kNormestCacheSize)
+    normest_cache.pop_back();
+
+  return static_cast<T>(norm);
 }
 
 template<typename T>
 void Problem<T>::AveragePreconditioners(
-    std::vector<T>& precond,
+    device_vector<T>& precond,
     const ProxList& prox)
 {
   std::vector<std::tuple<size_t, size_t, size_t> > idx_cnt_std;
-  idx_cnt_std.reserve(precond.size());
 
   // compute places where to average
   for(auto& p : prox)
@@ -516,20 +871,64 @@ void Problem<T>::AveragePreconditioners(
     }
   }
 
-  // perform averaging
+  if(idx_cnt_std.empty())
+    return;
+
+  std::vector<size_t> host_groups;
+  host_groups.reserve(3 * idx_cnt_std.size());
+  for(auto& ics : idx_cnt_std)
+  {
+    host_groups.push_back(std::get<0>(ics));
+    host_groups.push_back(std::get<1>(ics));
+    host_groups.push_back(std::get<2>(ics));
+  }
+  device_vector<size_t> groups(host_groups);
+
+  // perform averaging, one thread per group
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((idx_cnt_std.size() + block.x - 1) / block.x, 1, 1);
+
+  AveragePreconditionersKernel<T>
+    <<<grid, block>>>(
+      thrust::raw_pointer_cast(precond.data()),
+      thrust::raw_pointer_cast(groups.data()),
+      idx_cnt_std.size());
+
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    std::stringstream ss;
+    ss << "AveragePreconditioners: CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void Problem<T>::AveragePreconditioners(
+    vector<T>& precond,
+    const ProxList& prox)
+{
+  std::vector<std::tuple<size_t, size_t, size_t> > idx_cnt_std;
+
+  for(auto& p : prox)
+  {
+    if(!p->diagsteps())
+    {
+      p->get_separable_structure(idx_cnt_std);
+    }
+  }
+
   for(auto& ics : idx_cnt_std)
   {
-    size_t idx = std::get<0>(ics);
-    size_t cnt = std::get<1>(ics);
-    size_t std = std::get<2>(ics);
+    const size_t idx = std::get<0>(ics);
+    const size_t cnt = std::get<1>(ics);
+    const size_t std = std::get<2>(ics);
 
-    // compute average
     T avg = 0;
     for(size_t c = 0; c < cnt; c++)
       avg += precond[idx + c * std];
     avg /= static_cast<T>(cnt);
 
-    // fill values
     for(size_t c = 0; c < cnt; c++)
       precond[idx + c * std] = avg;
   }
@@ -544,6 +943,8 @@ void Problem<T>::Dualize()
   std::swap(linop_, dual_linop_);
   scaling_left_.swap(scaling_right_); // TODO: does this work?
   std::swap(scaling_left_host_, scaling_right_host_);
+  host_scaling_left_.swap(host_scaling_right_);
+  dualized_ = !dualized_;
 }
 
 // Explicit template instantiation
@@ -0,0 +1,1077 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "prost/problem_file.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "prost/linop/block_dense.hpp"
+#include "prost/linop/block_diags.hpp"
+#include "prost/linop/block_gradient2d.hpp"
+#include "prost/linop/block_gradient3d.hpp"
+#include "prost/linop/block_product.hpp"
+#include "prost/linop/block_sparse.hpp"
+#include "prost/linop/block_sum.hpp"
+#include "prost/linop/block_zero.hpp"
+
+#include "prost/prox/prox_elem_operation.hpp"
+#include "prost/prox/elemop/elem_operation_1d.hpp"
+#include "prost/prox/elemop/elem_operation_norm2.hpp"
+#include "prost/prox/elemop/elem_operation_ind_simplex.hpp"
+#include "prost/prox/elemop/elem_operation_ind_sum.hpp"
+#include "prost/prox/elemop/function_1d.hpp"
+#include "prost/prox/prox_moreau.hpp"
+#include "prost/prox/prox_transform.hpp"
+#include "prost/prox/prox_zero.hpp"
+
+#include "prost/backend/backend_admm.hpp"
+#include "prost/backend/backend_host.hpp"
+#include "prost/backend/backend_pdhg.hpp"
+#include "prost/backend/backend_spdhg.hpp"
+
+#include "prost/exception.hpp"
+#include "prost/problem.hpp"
+
+namespace prost {
+
+namespace {
+
+const char kMagic[8] = { 'P', 'R', 'O', 'S', 'T', 'P', 'R', 'B' };
+const uint32_t kVersion = 1;
+
+size_t AlignUp(size_t offset, size_t alignment)
+{
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+/// \brief Reads the nodes of a mapped file, checking every access
+///        against its size.
+class NodeReader {
+public:
+  NodeReader(const char *base, size_t size) : base_(base), size_(size) { }
+
+  void ReadNode(ProblemFileNode& node, size_t& offset) const
+  {
+    offset = AlignUp(offset, 8);
+
+    uint32_t type = Read<uint32_t>(offset);
+    uint64_t a = Read<uint64_t>(offset + 8);
+    uint64_t b = Read<uint64_t>(offset + 16);
+    offset += 24;
+
+    node.type = static_cast<ProblemFileNode::Type>(type);
+    node.rows = 0;
+    node.cols = 0;
+    node.data = nullptr;
+    node.nnz = 0;
+    node.ptr = node.ind = node.ptr_t = node.ind_t = nullptr;
+    node.val = node.val_t = nullptr;
+
+    switch(node.type)
+    {
+      case ProblemFileNode::kEmpty:
+        break;
+
+      case ProblemFileNode::kDouble:
+      case ProblemFileNode::kSingle:
+      {
+        const size_t elem = (node.type == ProblemFileNode::kDouble) ? sizeof(double) : sizeof(float);
+        node.rows = a;
+        node.cols = b;
+        node.data = Array(offset, Bytes(Count(a, b), elem));
+        break;
+      }
+
+      case ProblemFileNode::kSparseDouble:
+      case ProblemFileNode::kSparseSingle:
+      {
+        const size_t elem = (node.type == ProblemFileNode::kSparseDouble) ? sizeof(double) : sizeof(float);
+        const uint64_t kIndexMax = static_cast<uint64_t>(std::numeric_limits<int32_t>::max());
+
+        // the indices and the pointers up to nnz are int32
+        if(a >= kIndexMax || b >= kIndexMax)
+          throw Exception("ProblemFile: sparse matrix is too large.");
+
+        node.rows = a;
+        node.cols = b;
+        node.nnz = Read<uint64_t>(offset);
+        offset += 8;
+
+        if(node.nnz > kIndexMax)
+          throw Exception("ProblemFile: sparse matrix has too many entries.");
+
+        node.ptr = static_cast<const int32_t *>(Array(offset, Bytes(a + 1, sizeof(int32_t))));
+        node.ind = static_cast<const int32_t *>(Array(offset, Bytes(node.nnz, sizeof(int32_t))));
+        node.val = Array(offset, Bytes(node.nnz, elem));
+        node.ptr_t = static_cast<const int32_t *>(Array(offset, Bytes(b + 1, sizeof(int32_t))));
+        node.ind_t = static_cast<const int32_t *>(Array(offset, Bytes(node.nnz, sizeof(int32_t))));
+        node.val_t = Array(offset, Bytes(node.nnz, elem));
+
+        CheckSparse(node, elem);
+        break;
+      }
+
+      case ProblemFileNode::kString:
+        node.rows = 1;
+        node.cols = a;
+        Check(offset, a);
+        node.str.assign(base_ + offset, a);
+        offset += a;
+        break;
+
+      case ProblemFileNode::kCell:
+        node.rows = a;
+        node.cols = b;
+        node.children.resize(Children(Count(a, b), offset));
+        for(auto& child : node.children)
+          ReadNode(child, offset);
+        break;
+
+      case ProblemFileNode::kStruct:
+        node.rows = 1;
+        node.cols = 1;
+        node.children.resize(Children(a, offset));
+        for(auto& child : node.children)
+        {
+          ProblemFileNode name;
+          ReadNode(name, offset);
+
+          if(name.type != ProblemFileNode::kString)
+            throw Exception("ProblemFile: invalid struct field name.");
+
+          node.fields.push_back(name.str);
+          ReadNode(child, offset);
+        }
+        break;
+
+      default:
+        throw Exception("ProblemFile: unknown node type, the file is corrupt.");
+    }
+  }
+
+  template<typename V>
+  V Read(size_t offset) const
+  {
+    Check(offset, sizeof(V));
+
+    V value;
+    memcpy(&value, base_ + offset, sizeof(V));
+    return value;
+  }
+
+private:
+  void Check(size_t offset, size_t bytes) const
+  {
+    if(offset > size_ || bytes > size_ - offset)
+      throw Exception("ProblemFile: unexpected end of file.");
+  }
+
+  /// \brief Returns a * b, throws if it overflows.
+  static size_t Count(uint64_t a, uint64_t b)
+  {
+    if(b != 0 && a > std::numeric_limits<size_t>::max() / b)
+      throw Exception("ProblemFile: array size overflows, the file is corrupt.");
+
+    return static_cast<size_t>(a * b);
+  }
+
+  /// \brief Returns the size in bytes of count elements, throws if it 
+  ///        overflows.
+  static size_t Bytes(uint64_t count, size_t elem)
+  {
+    return Count(count, elem);
+  }
+
+  /// \brief Returns count, throws if the remaining file cannot hold that
+  ///        many nodes of at least a header each.
+  size_t Children(size_t count, size_t offset) const
+  {
+    if(offset > size_ || count > (size_ - offset) / 24)
+      throw Exception("ProblemFile: unexpected end of file.");
+
+    return count;
+  }
+
+  /// \brief Checks that ptr is monotone from 0 to nnz and the indices
+  ///        of each row are strictly increasing and within cols.
+  static void CheckCompressed(
+    const int32_t *ptr, 
+    const int32_t *ind, 
+    size_t rows, 
+    size_t cols, 
+    size_t nnz)
+  {
+    if(ptr[0] != 0 || static_cast<size_t>(ptr[rows]) != nnz)
+      throw Exception("ProblemFile: sparse matrix pointers do not span the entries.");
+
+    for(size_t i = 0; i < rows; i++)
+    {
+      if(ptr[i + 1] < ptr[i])
+        throw Exception("ProblemFile: sparse matrix pointers are not monotone.");
+
+      for(int32_t k = ptr[i]; k < ptr[i + 1]; k++)
+      {
+        if(ind[k] < 0 || static_cast<size_t>(ind[k]) >= cols)
+          throw Exception("ProblemFile: sparse matrix index out of range.");
+
+        if(k > ptr[i] && ind[k] <= ind[k - 1])
+          throw Exception("ProblemFile: sparse matrix indices are not sorted.");
+      }
+    }
+  }
+
+  /// \brief Validates both compressed forms of a sparse matrix and that
+  ///        they store the same entries: transposing the CSR by counting
+  ///        yields sorted columns, which have to equal the CSC.
+  static void CheckSparse(const ProblemFileNode& node, size_t elem)
+  {
+    CheckCompressed(node.ptr, node.ind, node.rows, node.cols, node.nnz);
+    CheckCompressed(node.ptr_t, node.ind_t, node.cols, node.rows, node.nnz);
+
+    const char *val = static_cast<const char *>(node.val);
+    const char *val_t = static_cast<const char *>(node.val_t);
+    vector<int32_t> next(node.ptr_t, node.ptr_t + node.cols);
+
+    for(size_t i = 0; i < node.rows; i++)
+    {
+      for(int32_t k = node.ptr[i]; k < node.ptr[i + 1]; k++)
+      {
+        const int32_t k_t = next[node.ind[k]]++;
+
+        if(k_t >= node.ptr_t[node.ind[k] + 1] ||
+           static_cast<size_t>(node.ind_t[k_t]) != i ||
+           memcmp(val + k * elem, val_t + k_t * elem, elem) != 0)
+          throw Exception("ProblemFile: CSR and CSC of a sparse matrix differ.");
+      }
+    }
+  }
+
+  /// \brief Returns the array of the given size at the next multiple of
+  ///        64 bytes and moves offset behind it.
+  const void *Array(size_t& offset, size_t bytes) const
+  {
+    offset = AlignUp(offset, 64);
+    Check(offset, bytes);
+
+    const void *data = base_ + offset;
+    offset += bytes;
+    return data;
+  }
+
+  const char *base_;
+  size_t size_;
+};
+
+// Values of a sparse matrix converted to another precision, the indices
+// are still read from the mapping.
+template<typename T>
+struct ConvertedValues {
+  shared_ptr<MappedFile> file;
+  vector<T> val;
+  vector<T> val_t;
+};
+
+template<typename T>
+vector<T> ConvertArray(const void *data, size_t count, bool is_double)
+{
+  if(is_double)
+  {
+    const double *values = static_cast<const double *>(data);
+    return vector<T>(values, values + count);
+  }
+
+  const float *values = static_cast<const float *>(data);
+  return vector<T>(values, values + count);
+}
+
+template<typename T>
+bool IsType(ProblemFileNode::Type type);
+
+template<> bool IsType<float>(ProblemFileNode::Type type) { return type == ProblemFileNode::kSparseSingle; }
+template<> bool IsType<double>(ProblemFileNode::Type type) { return type == ProblemFileNode::kSparseDouble; }
+
+// Reads a cell-array of vectors into an std::array of std::vector.
+template<typename T, size_t COEFFS_COUNT>
+void GetCoefficients(
+  std::array<vector<T>, COEFFS_COUNT>& coeffs,
+  const ProblemFileNode& node,
+  size_t count)
+{
+  if(node.type != ProblemFileNode::kCell || node.numel() < COEFFS_COUNT)
+    throw Exception("Cell array of coefficients is too small.");
+
+  for(size_t i = 0; i < COEFFS_COUNT; i++)
+  {
+    coeffs[i] = node[i].template values<T>();
+
+    if(coeffs[i].size() != 1 && coeffs[i].size() != count)
+      throw Exception("Size of coefficients should be either 1 or count.");
+  }
+}
+
+template<typename T>
+shared_ptr<Prox<T>> CreateProx(const ProblemFileNode& node);
+
+template<typename T>
+Prox<T> *CreateProxZero(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  return new ProxZero<T>(idx, size);
+}
+
+template<typename T>
+Prox<T> *CreateProxMoreau(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  return new ProxMoreau<T>(CreateProx<T>(data[0]));
+}
+
+template<typename T>
+Prox<T> *CreateProxTransform(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  std::array<vector<T>, 5> coeffs;
+  GetCoefficients<T, 5>(coeffs, data, size);
+
+  return new ProxTransform<T>(
+    CreateProx<T>(data[5]),
+    coeffs[0], coeffs[1], coeffs[2], coeffs[3], coeffs[4]);
+}
+
+template<typename T, class FUN_1D>
+Prox<T> *CreateProxElemOperation1D(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  size_t count = static_cast<size_t>(data[0].scalar());
+  size_t dim = static_cast<size_t>(data[1].scalar());
+  bool interleaved = data[2].scalar() > 0;
+
+  std::array<vector<T>, 7> coeffs;
+  GetCoefficients<T, 7>(coeffs, data[3], size);
+
+  return new ProxElemOperation<T, ElemOperation1D<T, FUN_1D>>(
+    idx, count, dim, interleaved, diagsteps, coeffs);
+}
+
+template<typename T, class FUN_1D>
+Prox<T> *CreateProxElemOperationNorm2(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  size_t count = static_cast<size_t>(data[0].scalar());
+  size_t dim = static_cast<size_t>(data[1].scalar());
+  bool interleaved = data[2].scalar() > 0;
+
+  std::array<vector<T>, 7> coeffs;
+  GetCoefficients<T, 7>(coeffs, data[3], count);
+
+  return new ProxElemOperation<T, ElemOperationNorm2<T, FUN_1D>>(
+    idx, count, dim, interleaved, diagsteps, coeffs);
+}
+
+template<typename T, class ELEM_OPERATION>
+Prox<T> *CreateProxElemOperation(size_t idx, size_t size, bool diagsteps, const ProblemFileNode& data)
+{
+  size_t count = static_cast<size_t>(data[0].scalar());
+  size_t dim = static_cast<size_t>(data[1].scalar());
+  bool interleaved = data[2].scalar() > 0;
+
+  return new ProxElemOperation<T, ELEM_OPERATION>(idx, count, dim, interleaved, diagsteps);
+}
+
+// Proxs which can be loaded without MATLAB, named as in the problem data.
+template<typename T>
+const map<string, function<Prox<T>*(size_t, size_t, bool, const ProblemFileNode&)>>& ProxRegistry()
+{
+  static const map<string, function<Prox<T>*(size_t, size_t, bool, const ProblemFileNode&)>> reg = {
+    { "elem_operation:ind_simplex",        CreateProxElemOperation<T, ElemOperationIndSimplex<T>>        },
+    { "elem_operation:ind_sum",            CreateProxElemOperation<T, ElemOperationIndSum<T>>            },
+    { "elem_operation:1d:zero",            CreateProxElemOperation1D<T, Function1DZero<T>>               },
+    { "elem_operation:1d:abs",             CreateProxElemOperation1D<T, Function1DAbs<T>>                },
+    { "elem_operation:1d:square",          CreateProxElemOperation1D<T, Function1DSquare<T>>             },
+    { "elem_operation:1d:ind_leq0",        CreateProxElemOperation1D<T, Function1DIndLeq0<T>>            },
+    { "elem_operation:1d:ind_geq0",        CreateProxElemOperation1D<T, Function1DIndGeq0<T>>            },
+    { "elem_operation:1d:ind_eq0",         CreateProxElemOperation1D<T, Function1DIndEq0<T>>             },
+    { "elem_operation:1d:ind_box01",       CreateProxElemOperation1D<T, Function1DIndBox01<T>>           },
+    { "elem_operation:1d:max_pos0",        CreateProxElemOperation1D<T, Function1DMaxPos0<T>>            },
+    { "elem_operation:1d:l0",              CreateProxElemOperation1D<T, Function1DL0<T>>                 },
+    { "elem_operation:1d:huber",           CreateProxElemOperation1D<T, Function1DHuber<T>>              },
+    { "elem_operation:1d:lq",              CreateProxElemOperation1D<T, Function1DLq<T>>                 },
+    { "elem_operation:1d:lq_plus_eps",     CreateProxElemOperation1D<T, Function1DLqPlusEps<T>>          },
+    { "elem_operation:1d:trunclin",        CreateProxElemOperation1D<T, Function1DTruncLinear<T>>        },
+    { "elem_operation:1d:truncquad",       CreateProxElemOperation1D<T, Function1DTruncQuad<T>>          },
+    { "elem_operation:norm2:zero",         CreateProxElemOperationNorm2<T, Function1DZero<T>>            },
+    { "elem_operation:norm2:abs",          CreateProxElemOperationNorm2<T, Function1DAbs<T>>             },
+    { "elem_operation:norm2:square",       CreateProxElemOperationNorm2<T, Function1DSquare<T>>          },
+    { "elem_operation:norm2:ind_leq0",     CreateProxElemOperationNorm2<T, Function1DIndLeq0<T>>         },
+    { "elem_operation:norm2:ind_geq0",     CreateProxElemOperationNorm2<T, Function1DIndGeq0<T>>         },
+    { "elem_operation:norm2:ind_eq0",      CreateProxElemOperationNorm2<T, Function1DIndEq0<T>>          },
+    { "elem_operation:norm2:ind_box01",    CreateProxElemOperationNorm2<T, Function1DIndBox01<T>>        },
+    { "elem_operation:norm2:max_pos0",     CreateProxElemOperationNorm2<T, Function1DMaxPos0<T>>         },
+    { "elem_operation:norm2:l0",           CreateProxElemOperationNorm2<T, Function1DL0<T>>              },
+    { "elem_operation:norm2:huber",        CreateProxElemOperationNorm2<T, Function1DHuber<T>>           },
+    { "elem_operation:norm2:lq",           CreateProxElemOperationNorm2<T, Function1DLq<T>>              },
+    { "elem_operation:norm2:lq_plus_eps",  CreateProxElemOperationNorm2<T, Function1DLqPlusEps<T>>       },
+    { "elem_operation:norm2:trunclin",     CreateProxElemOperationNorm2<T, Function1DTruncLinear<T>>     },
+    { "elem_operation:norm2:truncquad",    CreateProxElemOperationNorm2<T, Function1DTruncQuad<T>>       },
+    { "moreau",                            CreateProxMoreau<T>                                           },
+    { "transform",                         CreateProxTransform<T>                                        },
+    { "zero",                              CreateProxZero<T>                                             },
+  };
+
+  return reg;
+}
+
+template<typename T>
+Block<T> *CreateBlockSparse(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  const ProblemFileNode& mat = data[0];
+
+  if(mat.type != ProblemFileNode::kSparseDouble && mat.type != ProblemFileNode::kSparseSingle)
+    throw Exception("Matrix must be sparse!");
+
+  bool transpose_spmv = false;
+  if(data.numel() > 1)
+    transpose_spmv = data[1].scalar() > 0;
+
+  // stored in the precision of the solver: upload from the mapping
+  if(IsType<T>(mat.type))
+  {
+    return BlockSparse<T>::CreateFromHostCSR(
+      row, col, mat.rows, mat.cols, mat.nnz,
+      static_cast<const T *>(mat.val), mat.ptr, mat.ind,
+      static_cast<const T *>(mat.val_t), mat.ptr_t, mat.ind_t,
+      file, transpose_spmv);
+  }
+
+  const bool is_double = (mat.type == ProblemFileNode::kSparseDouble);
+  shared_ptr<ConvertedValues<T>> converted(new ConvertedValues<T>);
+  converted->file = file;
+  converted->val = ConvertArray<T>(mat.val, mat.nnz, is_double);
+  converted->val_t = ConvertArray<T>(mat.val_t, mat.nnz, is_double);
+
+  return BlockSparse<T>::CreateFromHostCSR(
+    row, col, mat.rows, mat.cols, mat.nnz,
+    converted->val.data(), mat.ptr, mat.ind,
+    converted->val_t.data(), mat.ptr_t, mat.ind_t,
+    converted, transpose_spmv);
+}
+
+template<typename T>
+Block<T> *CreateBlockDense(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  const ProblemFileNode& mat = data[0];
+
+  return BlockDense<T>::CreateFromColFirstData(row, col, mat.rows, mat.cols, mat.template values<T>());
+}
+
+template<typename T>
+Block<T> *CreateBlockDiags(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  size_t nrows = static_cast<size_t>(data[0].scalar());
+  size_t ncols = static_cast<size_t>(data[1].scalar());
+
+  vector<T> factors = data[2].template values<T>();
+  vector<ssize_t> offsets = data[3].template values<ssize_t>();
+
+  if((factors.size() != offsets.size()) && (factors.size() != 1 || offsets.size() != 1))
+    throw Exception("Mismatch of size(factors) and size(offsets).");
+
+  return new BlockDiags<T>(row, col, nrows, ncols, factors.size(), offsets, factors);
+}
+
+template<typename T>
+Block<T> *CreateBlockGradient2D(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  return new BlockGradient2D<T>(row, col,
+    static_cast<size_t>(data[0].scalar()),
+    static_cast<size_t>(data[1].scalar()),
+    static_cast<size_t>(data[2].scalar()),
+    data[3].scalar() > 0);
+}
+
+template<typename T>
+Block<T> *CreateBlockGradient3D(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  return new BlockGradient3D<T>(row, col,
+    static_cast<size_t>(data[0].scalar()),
+    static_cast<size_t>(data[1].scalar()),
+    static_cast<size_t>(data[2].scalar()),
+    data[3].scalar() > 0);
+}
+
+template<typename T>
+Block<T> *CreateBlockZero(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  return new BlockZero<T>(row, col,
+    static_cast<size_t>(data[0].scalar()),
+    static_cast<size_t>(data[1].scalar()));
+}
+
+template<typename T>
+shared_ptr<Block<T>> CreateBlock(const ProblemFileNode& node, const shared_ptr<MappedFile>& file);
+
+template<typename T>
+Block<T> *CreateBlockProduct(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  vector<shared_ptr<Block<T>>> factors;
+  for(auto& f : data.children) factors.push_back(CreateBlock<T>(f, file));
+
+  return new BlockProduct<T>(row, col, factors);
+}
+
+template<typename T>
+Block<T> *CreateBlockSum(size_t row, size_t col, const ProblemFileNode& data, const shared_ptr<MappedFile>& file)
+{
+  vector<shared_ptr<Block<T>>> terms;
+  for(auto& t : data[0].children) terms.push_back(CreateBlock<T>(t, file));
+
+  return new BlockSum<T>(row, col, terms, data[1].template values<T>());
+}
+
+template<typename T>
+const map<string, function<Block<T>*(size_t, size_t, const ProblemFileNode&, const shared_ptr<MappedFile>&)>>& BlockRegistry()
+{
+  static const map<string, function<Block<T>*(size_t, size_t, const ProblemFileNode&, const shared_ptr<MappedFile>&)>> reg = {
+    { "dense",      CreateBlockDense<T>      },
+    { "diags",      CreateBlockDiags<T>      },
+    { "gradient2d", CreateBlockGradient2D<T> },
+    { "gradient3d", CreateBlockGradient3D<T> },
+    { "product",    CreateBlockProduct<T>    },
+    { "sparse",     CreateBlockSparse<T>     },
+    { "sum",        CreateBlockSum<T>        },
+    { "zero",       CreateBlockZero<T>       },
+  };
+
+  return reg;
+}
+
+template<typename T>
+shared_ptr<Prox<T>> CreateProx(const ProblemFileNode& node)
+{
+  if(node.type != ProblemFileNode::kCell || node.numel() != 5)
+    throw Exception("Invalid prox description.");
+
+  const string& name = node[0].str;
+  size_t idx = static_cast<size_t>(node[1].scalar());
+  size_t size = static_cast<size_t>(node[2].scalar());
+  bool diagsteps = node[3].scalar() > 0;
+
+  auto it = ProxRegistry<T>().find(name);
+
+  if(it == ProxRegistry<T>().end())
+  {
+    std::ostringstream ss;
+    ss << "Creating prox with ID '" << name << "' failed. Reason: Not supported in problem files.";
+    ss << " Available prox are: { ";
+    for(auto& p : ProxRegistry<T>())
+      ss << p.first << ", ";
+    ss.seekp(-2, ss.cur); ss << " }.";
+
+    throw Exception(ss.str());
+  }
+
+  try
+  {
+    return shared_ptr<Prox<T>>(it->second(idx, size, diagsteps, node[4]));
+  }
+  catch(Exception& e)
+  {
+    std::ostringstream ss;
+    ss << "Creating prox with ID '" << name << "' failed. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+shared_ptr<Block<T>> CreateBlock(const ProblemFileNode& node, const shared_ptr<MappedFile>& file)
+{
+  if(node.type != ProblemFileNode::kCell || node.numel() != 4)
+    throw Exception("Invalid block description.");
+
+  const string& name = node[0].str;
+  size_t row = static_cast<size_t>(node[1].scalar());
+  size_t col = static_cast<size_t>(node[2].scalar());
+
+  auto it = BlockRegistry<T>().find(name);
+
+  if(it == BlockRegistry<T>().end())
+  {
+    std::ostringstream ss;
+    ss << "Creating block with ID '" << name << "' failed. Reason: Not supported in problem files.";
+    ss << " Available blocks are: { ";
+    for(auto& b : BlockRegistry<T>())
+      ss << b.first << ", ";
+    ss.seekp(-2, ss.cur); ss << " }.";
+
+    throw Exception(ss.str());
+  }
+
+  try
+  {
+    return shared_ptr<Block<T>>(it->second(row, col, node[3], file));
+  }
+  catch(Exception& e)
+  {
+    std::ostringstream ss;
+    ss << "Creating block with ID '" << name << "' failed. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+Backend<T> *CreateBackendPDHG(const ProblemFileNode& data)
+{
+  typename BackendPDHG<T>::Options opts;
+
+  opts.tau0 =                    data.field("tau0").scalar();
+  opts.sigma0 =                  data.field("sigma0").scalar();
+  opts.residual_iter =           static_cast<int>(data.field("residual_iter").scalar());
+  opts.scale_steps_operator =    data.field("scale_steps_operator").scalar() > 0;
+  opts.normest_tol =             data.field("normest_tol").scalar();
+  opts.alg2_gamma =              data.field("alg2_gamma").scalar();
+  opts.arg_alpha0 =              data.field("arg_alpha0").scalar();
+  opts.arg_nu =                  data.field("arg_nu").scalar();
+  opts.arg_delta =               data.field("arg_delta").scalar();
+  opts.arb_delta =               data.field("arb_delta").scalar();
+  opts.arb_tau =                 data.field("arb_tau").scalar();
+  opts.restart_iter =            static_cast<int>(data.field("restart_iter").scalar());
+  opts.restart_beta_sufficient = data.field("restart_beta_sufficient").scalar();
+  opts.restart_beta_necessary =  data.field("restart_beta_necessary").scalar();
+  opts.restart_beta_artificial = data.field("restart_beta_artificial").scalar();
+  opts.primal_weight_smoothing = data.field("primal_weight_smoothing").scalar();
+  opts.fuse_prox_arg =           data.field("fuse_prox_arg").scalar() > 0;
+  opts.fuse_epilogue =           data.field("fuse_epilogue").scalar() > 0;
+  opts.low_memory =              data.field("low_memory").scalar() > 0;
+
+  // files written before the persistent kernel was added lack the field
+  opts.persistent_kernel = data.has_field("persistent_kernel") &&
+    data.field("persistent_kernel").scalar() > 0;
+
+  const string& stepsize_variant = data.field("stepsize").str;
+
+  if(stepsize_variant == "alg1")
+    opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg1;
+  else if(stepsize_variant == "alg2")
+    opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsAlg2;
+  else if(stepsize_variant == "goldstein")
+    opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualGoldstein;
+  else if(stepsize_variant == "boyd")
+    opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsResidualBoyd;
+  else if(stepsize_variant == "restarted")
+    opts.stepsize_variant = BackendPDHG<T>::StepsizeVariant::kPDHGStepsRestarted;
+  else
+    throw Exception("Couldn't recognize step-size variant. Valid options are {alg1,alg2,goldstein,boyd,restarted}.");
+
+  return new BackendPDHG<T>(opts);
+}
+
+template<typename T>
+Backend<T> *CreateBackendADMM(const ProblemFileNode& data)
+{
+  typename BackendADMM<T>::Options opts;
+
+  opts.rho0 =           data.field("rho0").scalar();
+  opts.residual_iter =  static_cast<int>(data.field("residual_iter").scalar());
+  opts.arb_delta =      data.field("arb_delta").scalar();
+  opts.arb_gamma =      data.field("arb_gamma").scalar();
+  opts.arb_tau =        data.field("arb_tau").scalar();
+  opts.alpha =          data.field("alpha").scalar();
+  opts.cg_max_iter =    static_cast<int>(data.field("cg_max_iter").scalar());
+  opts.cg_fused =       data.field("cg_fused").scalar() > 0;
+  opts.cg_jacobi =      data.field("cg_jacobi").scalar() > 0;
+  opts.cg_check_iter =  static_cast<int>(data.field("cg_check_iter").scalar());
+  opts.cg_tol_pow =     data.field("cg_tol_pow").scalar();
+  opts.cg_tol_min =     data.field("cg_tol_min").scalar();
+  opts.cg_tol_max =     data.field("cg_tol_max").scalar();
+  opts.direct_max_nnz = static_cast<int>(data.field("direct_max_nnz").scalar());
+
+  const string& projection = data.field("projection").str;
+
+  if(projection == "cgls")
+    opts.projection = BackendADMM<T>::ProjectionMode::kProjectionCGLS;
+  else if(projection == "cholesky")
+    opts.projection = BackendADMM<T>::ProjectionMode::kProjectionCholesky;
+  else if(projection == "auto")
+    opts.projection = BackendADMM<T>::ProjectionMode::kProjectionAuto;
+  else
+    throw Exception("Couldn't recognize projection mode. Valid options are {cgls,cholesky,auto}.");
+
+  return new BackendADMM<T>(opts);
+}
+
+template<typename T>
+Backend<T> *CreateBackendSPDHG(const ProblemFileNode& data)
+{
+  typename BackendSPDHG<T>::Options opts;
+
+  opts.tau0 =                 data.field("tau0").scalar();
+  opts.sigma0 =               data.field("sigma0").scalar();
+  opts.residual_iter =        static_cast<int>(data.field("residual_iter").scalar());
+  opts.scale_steps_operator = data.field("scale_steps_operator").scalar() > 0;
+  opts.normest_tol =          data.field("normest_tol").scalar();
+  opts.block_fraction =       data.field("block_fraction").scalar();
+  opts.seed =                 static_cast<unsigned int>(data.field("seed").scalar());
+
+  return new BackendSPDHG<T>(opts);
+}
+
+template<typename T>
+Backend<T> *CreateBackendHost(const ProblemFileNode& data)
+{
+  typename BackendHost<T>::Options opts;
+
+  opts.tau0 =                 data.field("tau0").scalar();
+  opts.sigma0 =               data.field("sigma0").scalar();
+  opts.residual_iter =        static_cast<int>(data.field("residual_iter").scalar());
+  opts.scale_steps_operator = data.field("scale_steps_operator").scalar() > 0;
+  opts.normest_tol =          data.field("normest_tol").scalar();
+
+  return new BackendHost<T>(opts);
+}
+
+template<typename T>
+const map<string, function<Backend<T>*(const ProblemFileNode&)>>& BackendRegistry()
+{
+  static const map<string, function<Backend<T>*(const ProblemFileNode&)>> reg = {
+    { "pdhg",  CreateBackendPDHG<T>  },
+    { "admm",  CreateBackendADMM<T>  },
+    { "spdhg", CreateBackendSPDHG<T> },
+    { "host",  CreateBackendHost<T>  },
+  };
+
+  return reg;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const string& path)
+  : data_(nullptr), size_(0), registered_(false)
+{
+#ifdef _WIN32
+  file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+  if(file_ == INVALID_HANDLE_VALUE)
+    throw Exception("ProblemFile: could not open '" + path + "'.");
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(file_, &size);
+  size_ = static_cast<size_t>(size.QuadPart);
+
+  mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if(mapping_ != nullptr)
+    data_ = static_cast<const char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+
+  if(data_ == nullptr)
+  {
+    if(mapping_ != nullptr)
+      CloseHandle(mapping_);
+    CloseHandle(file_);
+    throw Exception("ProblemFile: could not map '" + path + "'.");
+  }
+#else
+  fd_ = open(path.c_str(), O_RDONLY);
+
+  if(fd_ < 0)
+    throw Exception("ProblemFile: could not open '" + path + "'.");
+
+  struct stat st;
+  fstat(fd_, &st);
+  size_ = static_cast<size_t>(st.st_size);
+
+  void *addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+
+  if(addr == MAP_FAILED)
+  {
+    close(fd_);
+    throw Exception("ProblemFile: could not map '" + path + "'.");
+  }
+
+  // the arrays are read front to back by the uploads
+  madvise(addr, size_, MADV_SEQUENTIAL);
+  data_ = static_cast<const char *>(addr);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+  if(registered_)
+    cudaHostUnregister(const_cast<char *>(data_));
+
+#ifdef _WIN32
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+#else
+  munmap(const_cast<char *>(data_), size_);
+  close(fd_);
+#endif
+}
+
+bool MappedFile::RegisterHost()
+{
+  if(registered_)
+    return true;
+
+#if CUDART_VERSION >= 11010
+  // the mapping is read-only, which the driver has to be told
+  const unsigned int flags = cudaHostRegisterPortable | cudaHostRegisterReadOnly;
+
+  if(cudaHostRegister(const_cast<char *>(data_), size_, flags) == cudaSuccess)
+    registered_ = true;
+  else
+    cudaGetLastError(); // reset the error, uploads then go through staging buffers
+#endif
+
+  return registered_;
+}
+
+const ProblemFileNode& ProblemFileNode::operator[](size_t i) const
+{
+  if(type != kCell || i >= children.size())
+    throw Exception("ProblemFile: out-of-bounds access into cell-array.");
+
+  return children[i];
+}
+
+const ProblemFileNode& ProblemFileNode::field(const string& name) const
+{
+  for(size_t i = 0; i < fields.size(); i++)
+    if(fields[i] == name)
+      return children[i];
+
+  throw Exception("Field with name '" + name + "' not found.");
+}
+
+bool ProblemFileNode::has_field(const string& name) const
+{
+  for(auto& f : fields)
+    if(f == name)
+      return true;
+
+  return false;
+}
+
+double ProblemFileNode::scalar() const
+{
+  if((type != kDouble && type != kSingle) || numel() == 0)
+    throw Exception("ProblemFile: scalar expected.");
+
+  if(type == kDouble)
+    return static_cast<const double *>(data)[0];
+
+  return static_cast<const float *>(data)[0];
+}
+
+template<typename T>
+vector<T> ProblemFileNode::values() const
+{
+  if(type != kDouble && type != kSingle)
+    throw Exception("ProblemFile: numeric array expected.");
+
+  return ConvertArray<T>(data, numel(), type == kDouble);
+}
+
+template<typename T>
+ProblemFile<T>::ProblemFile(const string& path, bool register_host)
+  : file_(new MappedFile(path)), host_registered_(false)
+{
+  NodeReader reader(file_->data(), file_->size());
+
+  char magic[8];
+  for(size_t i = 0; i < 8; i++)
+    magic[i] = reader.Read<char>(i);
+
+  if(memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+    throw Exception("ProblemFile: '" + path + "' is not a problem file.");
+
+  if(reader.Read<uint32_t>(8) != kVersion)
+    throw Exception("ProblemFile: unsupported version of '" + path + "'.");
+
+  size_t offset = 16;
+  reader.ReadNode(root_, offset);
+
+  if(root_.type != ProblemFileNode::kStruct)
+    throw Exception("ProblemFile: the root of the file has to be a struct.");
+
+  if(register_host)
+    host_registered_ = file_->RegisterHost();
+}
+
+template<typename T>
+shared_ptr<Problem<T>> ProblemFile<T>::CreateProblem() const
+{
+  const ProblemFileNode& pm = root_.field("prob");
+  shared_ptr<Problem<T>> prob(new Problem<T>);
+
+  for(auto& b : pm.field("linop").children) prob->AddBlock(CreateBlock<T>(b, file_));
+  for(auto& p : pm.field("prox_g").children) prob->AddProx_g(CreateProx<T>(p));
+  for(auto& p : pm.field("prox_f").children) prob->AddProx_f(CreateProx<T>(p));
+  for(auto& p : pm.field("prox_gstar").children) prob->AddProx_gstar(CreateProx<T>(p));
+  for(auto& p : pm.field("prox_fstar").children) prob->AddProx_fstar(CreateProx<T>(p));
+
+  const string& scaling = pm.field("scaling").str;
+
+  if(scaling == "alpha")
+    prob->SetScalingAlpha(pm.field("scaling_alpha").scalar());
+  else if(scaling == "identity")
+    prob->SetScalingIdentity();
+  else if(scaling == "custom")
+  {
+    prob->SetScalingCustom(
+      pm.field("scaling_left").template values<T>(),
+      pm.field("scaling_right").template values<T>());
+  }
+  else
+    throw Exception("Problem scaling variant not recognized. Options are {'alpha', 'identity', 'custom'}.");
+
+  // the operator indexes rows and columns by int
+  const double nrows = root_.field("nrows").scalar();
+  const double ncols = root_.field("ncols").scalar();
+  const double kDimMax = static_cast<double>(std::numeric_limits<int32_t>::max());
+
+  if(!(nrows >= 0 && nrows <= kDimMax && ncols >= 0 && ncols <= kDimMax))
+    throw Exception("ProblemFile: the problem dimensions do not fit into int.");
+
+  prob->SetDimensions(static_cast<size_t>(nrows), static_cast<size_t>(ncols));
+
+  return prob;
+}
+
+template<typename T>
+shared_ptr<Backend<T>> ProblemFile<T>::CreateBackend() const
+{
+  const ProblemFileNode& pm = root_.field("backend");
+
+  string name = pm[0].str;
+  std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+
+  auto it = BackendRegistry<T>().find(name);
+
+  if(it == BackendRegistry<T>().end())
+    throw Exception("Creating backend with ID '" + name + "' failed. Reason: Name not registered.");
+
+  try
+  {
+    return shared_ptr<Backend<T>>(it->second(pm[1]));
+  }
+  catch(Exception& e)
+  {
+    std::ostringstream ss;
+    ss << "Creating backend with ID '" << name << "' failed. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+typename Solver<T>::Options ProblemFile<T>::CreateSolverOptions() const
+{
+  const ProblemFileNode& pm = root_.field("opts");
+  typename Solver<T>::Options opts;
+
+  opts.tol_rel_primal =          pm.field("tol_rel_primal").scalar();
+  opts.tol_rel_dual =            pm.field("tol_rel_dual").scalar();
+  opts.tol_abs_primal =          pm.field("tol_abs_primal").scalar();
+  opts.tol_abs_dual =            pm.field("tol_abs_dual").scalar();
+  opts.max_iters =               static_cast<int>(pm.field("max_iters").scalar());
+  opts.num_cback_calls =         static_cast<int>(pm.field("num_cback_calls").scalar());
+  opts.verbose =                 pm.field("verbose").scalar() > 0;
+  opts.solve_dual_problem =      pm.field("solve_dual").scalar() > 0;
+  opts.use_cuda_graph =          pm.field("use_cuda_graph").scalar() > 0;
+  opts.async_convergence_check = pm.field("async_convergence_check").scalar() > 0;
+  opts.adaptive_residuals =      pm.field("adaptive_residuals").scalar() > 0;
+  opts.max_residual_iter =       static_cast<int>(pm.field("max_residual_iter").scalar());
+  opts.async_snapshots =         pm.field("async_snapshots").scalar() > 0;
+  opts.profile =                 pm.field("profile").scalar() > 0;
+  opts.autotune_launches =       pm.field("autotune_launches").scalar() > 0;
+  opts.presolve =                pm.field("presolve").scalar() > 0;
+  opts.history_size =            static_cast<int>(pm.field("history_size").scalar());
+  opts.history_every_iter =      pm.field("history_every_iter").scalar() > 0;
+
+  // files written before the checkpoints were added lack their fields
+  if(pm.has_field("checkpoint_file"))
+  {
+    opts.checkpoint_file = pm.field("checkpoint_file").str;
+    opts.checkpoint_iter = static_cast<int>(pm.field("checkpoint_iter").scalar());
+    opts.resume =          pm.field("resume").scalar() > 0;
+  }
+  else
+  {
+    opts.checkpoint_iter = 0;
+    opts.resume = false;
+  }
+
+  // and so do the ones written before the gap criterion was added
+  opts.tol_gap = pm.has_field("tol_gap") ? pm.field("tol_gap").scalar() : 0;
+
+  const string& dense_math = pm.field("dense_math").str;
+
+  if(dense_math == "default")
+    opts.dense_math = DenseMath::kDefault;
+  else if(dense_math == "tf32")
+    opts.dense_math = DenseMath::kTF32;
+  else if(dense_math == "fp16")
+    opts.dense_math = DenseMath::kFP16;
+  else
+    throw Exception("Dense math mode not recognized. Options are {'default', 'tf32', 'fp16'}.");
+
+  const string& operator_memory = pm.field("operator_memory").str;
+
+  if(operator_memory == "device")
+    opts.operator_memory = OperatorMemory::kDevice;
+  else if(operator_memory == "managed")
+    opts.operator_memory = OperatorMemory::kManaged;
+  else if(operator_memory == "auto")
+    opts.operator_memory = OperatorMemory::kAuto;
+  else
+    throw Exception("Operator memory not recognized. Options are {'device', 'managed', 'auto'}.");
+
+  opts.x0_device = nullptr;
+  opts.y0_device = nullptr;
+  opts.host_solution = true;
+
+  const ProblemFileNode& x0 = pm.field("x0");
+  const ProblemFileNode& y0 = pm.field("y0");
+
+  if(x0.type != ProblemFileNode::kEmpty && x0.numel() > 0)
+    opts.x0 = x0.template values<T>();
+
+  if(y0.type != ProblemFileNode::kEmpty && y0.numel() > 0)
+    opts.y0 = y0.template values<T>();
+
+  return opts;
+}
+
+// Explicit template instantiation
+template vector<float> ProblemFileNode::values<float>() const;
+template vector<double> ProblemFileNode::values<double>() const;
+template vector<ssize_t> ProblemFileNode::values<ssize_t>() const;
+
+template class ProblemFile<float>;
+template class ProblemFile<double>;
+
+} // namespace prost
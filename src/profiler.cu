@@ -0,0 +1,256 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "prost/profiler.hpp"
+
+#include <algorithm>
+#include <mutex>
+#include <typeindex>
+#include <utility>
+
+#if defined(__GNUG__)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+#if CUDART_VERSION >= 10000
+#include <nvtx3/nvToolsExt.h>
+#define PROST_NVTX_PUSH(name) nvtxRangePushA(name)
+#define PROST_NVTX_POP() nvtxRangePop()
+#else
+#define PROST_NVTX_PUSH(name)
+#define PROST_NVTX_POP()
+#endif
+
+namespace prost {
+
+namespace {
+
+struct Range {
+  int id;
+  int device;
+  cudaEvent_t start;
+  cudaEvent_t stop;
+  double bytes;
+};
+
+// finished ranges are collected once this many are outstanding, so the
+// number of live events stays bounded over long solves.
+const size_t kMaxRecordedRanges = 8192;
+
+vector<Profiler::Entry> entries;
+map<string, int> ids_by_name;
+map<std::pair<std::type_index, string>, int> ids_by_type;
+
+// guards all state below except the open ranges, which belong to the
+// thread that opened them
+std::mutex profiler_mutex;
+
+thread_local vector<Range> open_ranges;
+vector<Range> recorded_ranges;
+
+// events can only be recorded on streams of their device
+map<int, vector<std::pair<cudaEvent_t, cudaEvent_t> > > free_events;
+
+string Demangle(const char *name)
+{
+#if defined(__GNUG__)
+  int status = 0;
+  char *demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+
+  if(status == 0 && demangled != nullptr)
+  {
+    string result(demangled);
+    std::free(demangled);
+    return result;
+  }
+#endif
+
+  return name;
+}
+
+} // namespace
+
+std::atomic<int> Profiler::enabled_(0);
+
+void Profiler::Enable(bool enable)
+{
+  if(enable)
+  {
+    enabled_++;
+    return;
+  }
+
+  int count = enabled_.load();
+  while(count > 0 && !enabled_.compare_exchange_weak(count, count - 1))
+    ;
+}
+
+int Profiler::Register(const string& name)
+{
+  std::lock_guard<std::mutex> lock(profiler_mutex);
+
+  auto it = ids_by_name.find(name);
+  if(it != ids_by_name.end())
+    return it->second;
+
+  const int id = static_cast<int>(entries.size());
+  entries.push_back(Entry{ name, 0, 0, 0 });
+  ids_by_name[name] = id;
+
+  return id;
+}
+
+int Profiler::Register(const std::type_info& type, const char *suffix)
+{
+  const auto key = std::make_pair(std::type_index(type), string(suffix));
+
+  {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    auto it = ids_by_type.find(key);
+    if(it != ids_by_type.end())
+      return it->second;
+  }
+
+  // two threads may register the same type, both get the same id
+  const int id = Register(Demangle(type.name()) + suffix);
+
+  std::lock_guard<std::mutex> lock(profiler_mutex);
+  ids_by_type[key] = id;
+
+  return id;
+}
+
+void Profiler::Begin(int id, cudaStream_t stream)
+{
+  Range range;
+  range.id = id;
+  range.bytes = 0;
+  cudaGetDevice(&range.device);
+
+  string name;
+  {
+    std::lock_guard<std::mutex> lock(profiler_mutex);
+
+    vector<std::pair<cudaEvent_t, cudaEvent_t> >& events = free_events[range.device];
+
+    if(events.empty())
+    {
+      cudaEventCreate(&range.start);
+      cudaEventCreate(&range.stop);
+    }
+    else
+    {
+      range.start = events.back().first;
+      range.stop = events.back().second;
+      events.pop_back();
+    }
+
+    name = entries[id].name;
+  }
+
+  PROST_NVTX_PUSH(name.c_str());
+  cudaEventRecord(range.start, stream);
+
+  open_ranges.push_back(range);
+}
+
+void Profiler::End(double bytes, cudaStream_t stream)
+{
+  if(open_ranges.empty())
+    return;
+
+  Range range = open_ranges.back();
+  open_ranges.pop_back();
+
+  cudaEventRecord(range.stop, stream);
+  PROST_NVTX_POP();
+
+  range.bytes = bytes;
+
+  std::lock_guard<std::mutex> lock(profiler_mutex);
+  recorded_ranges.push_back(range);
+
+  if(open_ranges.empty() && recorded_ranges.size() >= kMaxRecordedRanges)
+    Collect();
+}
+
+void Profiler::Collect()
+{
+  for(Range& range : recorded_ranges)
+  {
+    float ms = 0;
+    cudaEventSynchronize(range.stop);
+    cudaEventElapsedTime(&ms, range.start, range.stop);
+
+    Entry& entry = entries[range.id];
+    entry.calls++;
+    entry.time_ms += ms;
+    entry.bytes += range.bytes;
+
+    free_events[range.device].push_back(std::make_pair(range.start, range.stop));
+  }
+
+  recorded_ranges.clear();
+}
+
+vector<Profiler::Entry> Profiler::Report()
+{
+  std::lock_guard<std::mutex> lock(profiler_mutex);
+  Collect();
+
+  vector<Entry> report;
+  for(const Entry& entry : entries)
+  {
+    if(entry.calls > 0)
+      report.push_back(entry);
+  }
+
+  std::sort(report.begin(), report.end(), 
+            [](const Entry& a, const Entry& b) { return a.time_ms > b.time_ms; });
+
+  return report;
+}
+
+void Profiler::Reset()
+{
+  if(enabled())
+    return;
+
+  std::lock_guard<std::mutex> lock(profiler_mutex);
+  Collect();
+
+  for(auto& device_events : free_events)
+  {
+    for(auto& events : device_events.second)
+    {
+      cudaEventDestroy(events.first);
+      cudaEventDestroy(events.second);
+    }
+  }
+
+  free_events.clear();
+  open_ranges.clear();
+  entries.clear();
+  ids_by_name.clear();
+  ids_by_type.clear();
+}
+
+} // namespace prost
@@ -19,18 +19,35 @@
 */
 
 #include "prost/prox/prox.hpp"
+#include "prost/prox/prox_argument.hpp"
+#include "prost/exception.hpp"
+#include "prost/profiler.hpp"
 #include <ctime>
 
 namespace prost {
 
+// argument (computed on the fly if fused), step sizes and result plus
+// the operator data
+template<typename T>
+static double ProfileBytes(const Prox<T>& prox, bool fused)
+{
+  if(!Profiler::enabled())
+    return 0;
+
+  return prox.gpu_mem_amount() + sizeof(T) * (fused ? 2.0 : 3.0) * prox.size();
+}
+
 template<typename T>
 void Prox<T>::Eval(
   thrust::device_vector<T>& result, 
   const thrust::device_vector<T>& arg, 
   const thrust::device_vector<T>& tau_diag, 
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
+  ProfileRange range(typeid(*this), "", ProfileBytes(*this, false), stream);
+
   EvalLocal(
     result.begin() + index_,
     result.begin() + index_ + size_,
@@ -39,9 +56,134 @@ void Prox<T>::Eval(
     tau_diag.cbegin() + index_,
     tau_diag.cbegin() + index_ + size_,
     tau,
+    invert_tau,
+    stream);
+}
+
+template<typename T>
+void Prox<T>::EvalFused(
+  thrust::device_vector<T>& result, 
+  const ProxArgument<T>& arg, 
+  const thrust::device_vector<T>& tau_diag, 
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  ProfileRange range(typeid(*this), " (fused)", ProfileBytes(*this, true), stream);
+
+  EvalFusedLocal(
+    result.begin() + index_,
+    result.begin() + index_ + size_,
+    arg.Offset(index_),
+    tau_diag.cbegin() + index_,
+    tau_diag.cbegin() + index_ + size_,
+    tau,
+    invert_tau,
+    stream);
+}
+
+template<typename T>
+void Prox<T>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  throw Exception("Prox: fused evaluation is not supported by this operator.");
+}
+
+template<typename T>
+void Prox<T>::EvalMoreauLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  throw Exception("Prox: Moreau evaluation is not supported by this operator.");
+}
+
+template<typename T>
+void Prox<T>::EvalMoreauFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  throw Exception("Prox: Moreau evaluation is not supported by this operator.");
+}
+
+template<typename T>
+void Prox<T>::EvalGap(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const thrust::device_vector<T>& x,
+  const thrust::device_vector<T>& y,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  EvalGapLocal(
+    gap_beg + index_,
+    gap_beg + index_ + size_,
+    x.cbegin() + index_,
+    y.cbegin() + index_,
+    x_scale,
+    y_scale,
+    stream);
+}
+
+template<typename T>
+void Prox<T>::EvalGapLocal(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const typename thrust::device_vector<T>::iterator& gap_end,
+  const typename thrust::device_vector<T>::const_iterator& x_beg,
+  const typename thrust::device_vector<T>::const_iterator& y_beg,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  throw Exception("Prox: the energy is not available for this operator.");
+}
+
+template<typename T>
+void Prox<T>::EvalHost(
+  vector<T>& result, 
+  const vector<T>& arg, 
+  const vector<T>& tau_diag, 
+  T tau,
+  bool invert_tau)
+{
+  EvalHostLocal(
+    result.data() + index_,
+    arg.data() + index_,
+    tau_diag.data() + index_,
+    tau,
     invert_tau);
 }
 
+template<typename T>
+void Prox<T>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau)
+{
+  throw Exception("Prox: host evaluation is not supported by this operator.");
+}
+
 template<typename T>
 double Prox<T>::Eval(
   std::vector<T>& result, 
@@ -70,6 +212,18 @@ double Prox<T>::Eval(
   return (s * 1000 / (double)repeats);
 }
 
+template<typename T>
+void Prox<T>::InitializeWorkspace()
+{
+  // also hands the workspace down to nested proxs
+  if(!workspace_)
+    set_workspace(shared_ptr<ProxWorkspace<T>>(new ProxWorkspace<T>()));
+  else
+    set_workspace(workspace_);
+
+  workspace_->Reserve(scratch_size());
+}
+
 template <typename T>
 void Prox<T>::get_separable_structure(
     vector<std::tuple<size_t, size_t, size_t> >& sep)
@@ -0,0 +1,252 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "prost/prox/prox_elem_operation_jit.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+static const char *kJITElemOperationKernel = "prost_jit_elem_operation";
+static const char *kJITSharedMemKernel = "prost_jit_shared_mem_bytes";
+
+// Literal with the exact bit pattern of the value, also for inf and nan.
+static std::string JITLiteral(float val)
+{
+  uint32_t bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+
+  std::stringstream ss;
+  ss << "__int_as_float(0x" << std::hex << bits << ")";
+  return ss.str();
+}
+
+static std::string JITLiteral(double val)
+{
+  unsigned long long bits;
+  std::memcpy(&bits, &val, sizeof(bits));
+
+  std::stringstream ss;
+  ss << "__longlong_as_double(0x" << std::hex << bits << "ULL)";
+  return ss.str();
+}
+
+static const char *JITTypeName(float) { return "float"; }
+static const char *JITTypeName(double) { return "double"; }
+
+template<typename T>
+ProxElemOperationJIT<T>::ProxElemOperationJIT(
+  size_t index,
+  size_t count,
+  size_t dim,
+  bool interleaved,
+  bool diagsteps,
+  const std::string& operation,
+  const vector<vector<T> >& coeffs)
+  : ProxSeparableSum<T>(index, count, dim, interleaved, diagsteps),
+    operation_(operation), coeffs_(coeffs), kernel_(nullptr), shared_mem_per_thread_(0)
+{
+}
+
+template<typename T>
+std::string ProxElemOperationJIT<T>::GenerateSource() const
+{
+  const size_t num_coeffs = coeffs_.size();
+  std::stringstream ss;
+
+  ss << "#include \"prost/prox/elemop/elem_operation_1d.hpp\"\n"
+     << "#include \"prost/prox/elemop/elem_operation_norm2.hpp\"\n"
+     << "#include \"prost/prox/elemop/elem_operation_ind_simplex.hpp\"\n"
+     << "#include \"prost/prox/elemop/elem_operation_ind_sum.hpp\"\n"
+     << "#include \"prost/prox/elemop/elem_operation_singular_nx2.hpp\"\n"
+     << "#include \"prost/prox/elemop/elem_operation_ind_psd_cone_3x3.hpp\"\n"
+     << "#include \"prost/prox/elemop/function_1d.hpp\"\n"
+     << "#include \"prost/prox/elemop/function_2d.hpp\"\n"
+     << "\n"
+     << "namespace prost {\n"
+     << "\n"
+     << "typedef " << JITTypeName(T()) << " T;\n"
+     << "typedef " << operation_ << " Operation;\n"
+     << "\n"
+     << "static_assert(Operation::kCoeffsCount == " << num_coeffs << ", "
+     << "\"Wrong number of coefficients.\");\n"
+     << "static_assert(Operation::kDim == 0 || Operation::kDim == " << this->dim_ << ", "
+     << "\"Wrong dimension.\");\n"
+     << "\n"
+     << "extern \"C\" __global__\n"
+     << "void " << kJITElemOperationKernel << "(\n"
+     << "  T *d_res, const T *d_arg, const T *d_tau, T tau, bool invert_tau,\n"
+     << "  size_t count, const T * const *d_coeffs)\n"
+     << "{\n"
+     << "  const size_t dim = " << this->dim_ << ";\n"
+     << "  const bool interleaved = " << (this->interleaved_ ? "true" : "false") << ";\n"
+     << "  const size_t tx = threadIdx.x + blockDim.x * blockIdx.x;\n"
+     << "\n"
+     << "  if(tx < count)\n"
+     << "  {\n"
+     << "    Vector<T> res(count, dim, interleaved, tx, d_res);\n"
+     << "    const Vector<const T> arg(count, dim, interleaved, tx, d_arg);\n"
+     << "    const Vector<const T> tau_diag(count, dim, interleaved, tx, d_tau);\n"
+     << "\n"
+     << "    SharedMem<Operation::SharedMemType, Operation::GetSharedMemCount> sh_mem(dim, threadIdx.x);\n";
+
+  if(num_coeffs == 0)
+    ss << "    Operation op(dim, sh_mem);\n";
+  else
+  {
+    ss << "    T coeffs[" << num_coeffs << "];\n";
+
+    for(size_t i = 0; i < num_coeffs; i++)
+    {
+      if(coeffs_[i].size() == 1)
+        ss << "    coeffs[" << i << "] = " << JITLiteral(coeffs_[i][0]) << ";\n";
+      else
+        ss << "    coeffs[" << i << "] = d_coeffs[" << i << "][tx];\n";
+    }
+
+    ss << "    Operation op(coeffs, dim, sh_mem);\n";
+  }
+
+  ss << "    op(res, arg, tau_diag, tau, invert_tau);\n"
+     << "  }\n"
+     << "}\n"
+     << "\n"
+     << "extern \"C\" __global__\n"
+     << "void " << kJITSharedMemKernel << "(size_t *d_bytes)\n"
+     << "{\n"
+     << "  Operation::GetSharedMemCount get_shared_mem_count;\n"
+     << "  *d_bytes = get_shared_mem_count(" << this->dim_ << ") * sizeof(Operation::SharedMemType);\n"
+     << "}\n"
+     << "\n"
+     << "} // namespace prost\n";
+
+  return ss.str();
+}
+
+template<typename T>
+void ProxElemOperationJIT<T>::Initialize()
+{
+  for(size_t i = 0; i < coeffs_.size(); i++)
+  {
+    if(coeffs_[i].size() != 1 && coeffs_[i].size() != this->count_)
+      throw Exception("ProxElemOperationJIT: size of coefficients should be either 1 or count.");
+  }
+
+  try
+  {
+    d_coeffs_.resize(coeffs_.size());
+    vector<const T *> ptr(coeffs_.size(), nullptr);
+
+    for(size_t i = 0; i < coeffs_.size(); i++)
+    {
+      if(coeffs_[i].size() > 1)
+      {
+        d_coeffs_[i] = coeffs_[i];
+        ptr[i] = thrust::raw_pointer_cast(d_coeffs_[i].data());
+      }
+    }
+
+    d_coeffs_ptr_ = ptr;
+  }
+  catch(const std::bad_alloc &e)
+  {
+    std::stringstream ss;
+    ss << "Out of memory: " << e.what();
+
+    throw Exception(ss.str());
+  }
+
+  source_ = GenerateSource();
+  kernel_ = JITKernelCache::Get(source_, kJITElemOperationKernel);
+
+  // the count of the operation is only known to the compiled source
+  device_vector<size_t> d_bytes(1, 0);
+  size_t *d_bytes_ptr = thrust::raw_pointer_cast(d_bytes.data());
+  void *params[] = { &d_bytes_ptr };
+
+  JITKernelCache::Launch(JITKernelCache::Get(source_, kJITSharedMemKernel),
+                         dim3(1, 1, 1), dim3(1, 1, 1), 0, 0, params);
+  shared_mem_per_thread_ = d_bytes[0];
+
+  if(shared_mem_per_thread_ * kWarpSizeCUDA > kMaxStagedSharedMem)
+  {
+    std::stringstream ss;
+    ss << "ProxElemOperationJIT: " << operation_ << " needs " << shared_mem_per_thread_;
+    ss << " bytes of shared memory per element, which do not fit into a block.";
+
+    kernel_ = nullptr;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+size_t ProxElemOperationJIT<T>::gpu_mem_amount() const
+{
+  size_t mem = d_coeffs_ptr_.size() * sizeof(const T *);
+
+  for(const device_vector<T>& c : d_coeffs_)
+    mem += c.size() * sizeof(T);
+
+  return mem;
+}
+
+template<typename T>
+void ProxElemOperationJIT<T>::EvalLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const typename thrust::device_vector<T>::const_iterator& arg_beg,
+  const typename thrust::device_vector<T>::const_iterator& arg_end,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  if(kernel_ == nullptr)
+    throw Exception("ProxElemOperationJIT: Initialize() has to be called first.");
+
+  // as many threads as the shared memory of the operation allows
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  while(block.x > kWarpSizeCUDA && shared_mem_per_thread_ * block.x > kMaxStagedSharedMem)
+    block.x /= 2;
+
+  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
+
+  T *d_res = thrust::raw_pointer_cast(&(*result_beg));
+  const T *d_arg = thrust::raw_pointer_cast(&(*arg_beg));
+  const T *d_tau = thrust::raw_pointer_cast(&(*tau_beg));
+  size_t count = this->count_;
+  const T * const *d_coeffs = thrust::raw_pointer_cast(d_coeffs_ptr_.data());
+
+  void *params[] = { &d_res, &d_arg, &d_tau, &tau, &invert_tau, &count, &d_coeffs };
+
+  JITKernelCache::Launch(kernel_, grid, block, shared_mem_per_thread_ * block.x, stream, params);
+}
+
+// Explicit template instantiation
+template class ProxElemOperationJIT<float>;
+template class ProxElemOperationJIT<double>;
+
+} // namespace prost
@@ -24,6 +24,7 @@
 #include "prost/prox/prox_ind_epi_quad.hpp"
 #include "prost/prox/vector.hpp"
 #include "prost/prox/helper.hpp"
+#include "prost/prox/group_kernel.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
@@ -39,7 +40,7 @@ struct Coefficients {
   T c;
 };
 
-template<typename T>
+template<typename T, class GROUP>
 __global__
 void ProxIndEpiQuadKernel(
   T *d_res,
@@ -48,36 +49,44 @@ void ProxIndEpiQuadKernel(
   size_t dim,
   Coefficients<T> coeffs)
 {
-  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+  const size_t tx = GROUP::group();
+
+  if(tx >= count)
+    return;
+
+  Vector<T> x(count, dim-1, false, tx, d_res);
+  const Vector<const T> x0(count, dim-1, false, tx, d_arg);
+  T& y = d_res[count * (dim-1) + tx];
+  const T y0 = d_arg[count * (dim-1) + tx];
+
+  const T a = coeffs.dev_a == nullptr ? coeffs.a : coeffs.dev_a[tx];
+  const Vector<const T> b(count, dim-1, false, tx, coeffs.dev_b);
+  const T c = coeffs.dev_c == nullptr ? coeffs.c : coeffs.dev_c[tx];
+
+  // shift to the epigraph of a ||x||^2
+  T sq_norm_b = static_cast<T>(0);
+  T sq_norm_x = static_cast<T>(0);
+  for(size_t i = GROUP::lane(); i < dim-1; i += GROUP::stride()) {
+    const T val = b[i];
+    const T xs = x0[i] + (val / (2 * a));
+    sq_norm_b += val * val;
+    sq_norm_x += xs * xs;
+  }
 
-  if(tx < count)
-  {
-    Vector<T> x(count, dim-1, false, tx, d_res);
-    const Vector<const T> x0(count, dim-1, false, tx, d_arg);
-    T& y = d_res[count * (dim-1) + tx];
-    const T y0 = d_arg[count * (dim-1) + tx];
-
-    const T a = coeffs.dev_a == nullptr ? coeffs.a : coeffs.dev_a[tx];
-    const Vector<const T> b(count, dim-1, false, tx, coeffs.dev_b);
-    const T c = coeffs.dev_c == nullptr ? coeffs.c : coeffs.dev_c[tx];
-    
-    T sq_norm_b = static_cast<T>(0);
-    for(size_t i = 0; i < dim-1; i++) {
-      T val = b[i];
-      x[i] = x0[i] + (val / (2 * a));
-      sq_norm_b += val * val;
-    }
-    
-    helper::ProjectEpiQuadNd<T>(x, y0 - c + (sq_norm_b / (4*a)), a, x, y, dim-1);
-      
-    for(size_t i = 0; i < dim-1; i++) {
-      x[i] -=  b[i] / (2 * a);
-    }
+  sq_norm_b = GROUP::Reduce(sq_norm_b);
+  sq_norm_x = GROUP::Reduce(sq_norm_x);
 
-    y = y + c - (sq_norm_b / (4*a));
+  T scale, ys;
+  helper::ProjectEpiQuadNdScale<T>(sq_norm_x, y0 - c + (sq_norm_b / (4*a)), a, scale, ys);
+      
+  for(size_t i = GROUP::lane(); i < dim-1; i += GROUP::stride()) {
+    const T val = b[i];
+    x[i] = scale * (x0[i] + (val / (2 * a))) - val / (2 * a);
   }
-}
 
+  if(GROUP::lane() == 0)
+    y = ys + c - (sq_norm_b / (4*a));
+}
 
 template<typename T>
 void 
@@ -89,10 +98,12 @@ ProxIndEpiQuad<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
+  const GroupKernel kernel = ChooseGroupKernel(this->count_, this->dim_);
+  dim3 grid, block;
+  GroupKernelLaunch(kernel, this->count_, grid, block);
 
   Coefficients<T> coeffs;
   if(a_.size() != 1) {
@@ -112,14 +123,26 @@ ProxIndEpiQuad<T>::EvalLocal(
     coeffs.c = c_[0];
   }
 
-  ProxIndEpiQuadKernel<T>
-    <<<grid, block>>>(
-      thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&(*arg_beg)),
-      this->count_,
-      this->dim_,
-      coeffs);
-  cudaDeviceSynchronize();
+  T *d_res = thrust::raw_pointer_cast(&(*result_beg));
+  const T *d_arg = thrust::raw_pointer_cast(&(*arg_beg));
+
+  switch(kernel)
+  {
+  case kGroupKernelThread:
+    ProxIndEpiQuadKernel<T, GroupThread>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, coeffs);
+    break;
+
+  case kGroupKernelWarp:
+    ProxIndEpiQuadKernel<T, GroupWarp>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, coeffs);
+    break;
+
+  case kGroupKernelBlock:
+    ProxIndEpiQuadKernel<T, GroupBlock>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, coeffs);
+    break;
+  }
 
   // check for error
   cudaError_t error = cudaGetLastError();
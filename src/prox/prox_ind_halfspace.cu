@@ -24,6 +24,7 @@
 #include "prost/prox/prox_ind_halfspace.hpp"
 #include "prost/prox/vector.hpp"
 #include "prost/prox/helper.hpp"
+#include "prost/prox/group_kernel.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
@@ -31,27 +32,30 @@ namespace prost {
 
 // project the vector v onto the halfspace described by the set
 // { x | <n,x> <= t }
-template<typename T>
-inline __host__ __device__
+template<typename T, class GROUP>
+inline __device__
 void ProjectHalfspace(Vector<const T> const& v,
 		      Vector<const T> const& n,
 		      T t,
 		      Vector<T>& result,
-		      int dim)
+		      size_t dim)
 {
   T sq_norm = 0;
   T iprod = 0;
-  for(size_t i = 0; i < dim; i++) {
+  for(size_t i = GROUP::lane(); i < dim; i += GROUP::stride()) {
     sq_norm += n[i] * n[i];
     iprod += n[i] * v[i];
   }
 
-  for(size_t i = 0; i < dim; i++) {
+  sq_norm = GROUP::Reduce(sq_norm);
+  iprod = GROUP::Reduce(iprod);
+
+  for(size_t i = GROUP::lane(); i < dim; i += GROUP::stride()) {
     result[i] = v[i] - (max(static_cast<T>(0), iprod - t) / sq_norm) * n[i];
   }  
 }
   
-template<typename T>
+template<typename T, class GROUP>
 __global__
 void ProxIndHalfspaceKernel(
   T *d_res,
@@ -63,29 +67,29 @@ void ProxIndHalfspaceKernel(
   size_t sz_a,
   size_t sz_b)
 {
-  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+  const size_t tx = GROUP::group();
 
-  if(tx < count)
-  {
-    Vector<T> x(count, dim, false, tx, d_res);
-    const Vector<const T> x0(count, dim, false, tx, d_arg);
+  if(tx >= count)
+    return;
 
-    T b;
-    if(sz_b == count) 
-      b = d_b[tx];
-    else 
-      b = d_b[0];
+  Vector<T> x(count, dim, false, tx, d_res);
+  const Vector<const T> x0(count, dim, false, tx, d_arg);
 
-    if(sz_a == count * dim) {
-      const Vector<const T> a(count, dim, false, tx, d_a);
+  T b;
+  if(sz_b == count) 
+    b = d_b[tx];
+  else 
+    b = d_b[0];
 
-      ProjectHalfspace<T>(x0, a, b, x, dim);
-    }
-    else {
-      const Vector<const T> a(count, dim, true, 0, d_a);
+  if(sz_a == count * dim) {
+    const Vector<const T> a(count, dim, false, tx, d_a);
 
-      ProjectHalfspace<T>(x0, a, b, x, dim);
-    }
+    ProjectHalfspace<T, GROUP>(x0, a, b, x, dim);
+  }
+  else {
+    const Vector<const T> a(count, dim, true, 0, d_a);
+
+    ProjectHalfspace<T, GROUP>(x0, a, b, x, dim);
   }
 }
 
@@ -100,22 +104,35 @@ ProxIndHalfspace<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
-
-  ProxIndHalfspaceKernel<T>
-    <<<grid, block>>>(
-      thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&(*arg_beg)),
-      this->count_,
-      this->dim_,
-      thrust::raw_pointer_cast(&d_a_[0]),
-      thrust::raw_pointer_cast(&d_b_[0]),
-      a_.size(),
-      b_.size());
-  cudaDeviceSynchronize();
+  const GroupKernel kernel = ChooseGroupKernel(this->count_, this->dim_);
+  dim3 grid, block;
+  GroupKernelLaunch(kernel, this->count_, grid, block);
+
+  T *d_res = thrust::raw_pointer_cast(&(*result_beg));
+  const T *d_arg = thrust::raw_pointer_cast(&(*arg_beg));
+  const T *d_a = thrust::raw_pointer_cast(&d_a_[0]);
+  const T *d_b = thrust::raw_pointer_cast(&d_b_[0]);
+
+  switch(kernel)
+  {
+  case kGroupKernelThread:
+    ProxIndHalfspaceKernel<T, GroupThread>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, d_a, d_b, a_.size(), b_.size());
+    break;
+
+  case kGroupKernelWarp:
+    ProxIndHalfspaceKernel<T, GroupWarp>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, d_a, d_b, a_.size(), b_.size());
+    break;
+
+  case kGroupKernelBlock:
+    ProxIndHalfspaceKernel<T, GroupBlock>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, d_a, d_b, a_.size(), b_.size());
+    break;
+  }
 
   // check for error
   cudaError_t error = cudaGetLastError();
@@ -18,23 +18,167 @@
  * along with prost. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <utility>
+#include <thrust/gather.h>
+#include <thrust/scatter.h>
+#include <thrust/system/cuda/execution_policy.h>
+#include <cusolverSp_LOWLEVEL_PREVIEW.h>
+
 #include "prost/prox/prox_ind_range.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
-  
+
+  /// \brief Cholesky factor of A'A, shared by the ProxIndRange with the
+  ///        same A through the factor cache.
+  template<typename T>
+  struct ProxIndRangeFactor
+  {
+    /// \brief Dense lower triangular factor.
+    device_vector<T> dense;
+
+    /// \brief Sparse factor of P A'A P' for the permutation perm.
+    csrcholInfo_t sparse = nullptr;
+    device_vector<int> perm;
+    size_t internal_bytes = 0;
+    size_t solve_buffer_bytes = 0;
+
+    ~ProxIndRangeFactor()
+    {
+      if(sparse != nullptr)
+	cusolverSpDestroyCsrcholInfo(sparse);
+    }
+
+    size_t gpu_mem_amount() const
+    {
+      return dense.size() * sizeof(T) + perm.size() * sizeof(int) + internal_bytes;
+    }
+  };
+
+  namespace {
+
+  /// \brief Identifies a factorization by the matrix it was computed from.
+  struct FactorKey
+  {
+    int device;
+    int factorization;
+    size_t nrows, ncols, nnz;
+    uint64_t hash;
+
+    bool operator==(const FactorKey& other) const
+    {
+      return device == other.device && factorization == other.factorization &&
+	nrows == other.nrows && ncols == other.ncols && nnz == other.nnz &&
+	hash == other.hash;
+    }
+  };
+
+  /// \brief The cache only observes the factors, they are freed with the
+  ///        last prox using them.
+  template<typename T>
+  struct FactorCacheEntry
+  {
+    FactorKey key;
+    std::weak_ptr<ProxIndRangeFactor<T>> factor;
+  };
+
+  std::mutex factor_cache_mutex;
+
+  template<typename T>
+  std::list<FactorCacheEntry<T>>& factor_cache()
+  {
+    static std::list<FactorCacheEntry<T>> cache;
+    return cache;
+  }
+
+  /// \brief FNV-1a hash of the bytes of values.
+  template<typename V>
+  uint64_t HashValues(uint64_t hash, const vector<V>& values)
+  {
+    const unsigned char *bytes = reinterpret_cast<const unsigned char *>(values.data());
+
+    for(size_t i = 0; i < values.size() * sizeof(V); i++)
+    {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+
+    return hash;
+  }
+
+  const uint64_t kHashSeed = 14695981039346656037ull;
+
+  // type dispatch of the cuSOLVER routines
+  inline cusolverStatus_t potrf_buffer_size(cusolverDnHandle_t handle, int n, float *A, int *lwork)
+  { return cusolverDnSpotrf_bufferSize(handle, CUBLAS_FILL_MODE_LOWER, n, A, n, lwork); }
+
+  inline cusolverStatus_t potrf_buffer_size(cusolverDnHandle_t handle, int n, double *A, int *lwork)
+  { return cusolverDnDpotrf_bufferSize(handle, CUBLAS_FILL_MODE_LOWER, n, A, n, lwork); }
+
+  inline cusolverStatus_t potrf(cusolverDnHandle_t handle, int n, float *A, float *work, int lwork, int *info)
+  { return cusolverDnSpotrf(handle, CUBLAS_FILL_MODE_LOWER, n, A, n, work, lwork, info); }
+
+  inline cusolverStatus_t potrf(cusolverDnHandle_t handle, int n, double *A, double *work, int lwork, int *info)
+  { return cusolverDnDpotrf(handle, CUBLAS_FILL_MODE_LOWER, n, A, n, work, lwork, info); }
+
+  inline cusolverStatus_t potrs(cusolverDnHandle_t handle, int n, const float *A, float *x, int *info)
+  { return cusolverDnSpotrs(handle, CUBLAS_FILL_MODE_LOWER, n, 1, A, n, x, n, info); }
+
+  inline cusolverStatus_t potrs(cusolverDnHandle_t handle, int n, const double *A, double *x, int *info)
+  { return cusolverDnDpotrs(handle, CUBLAS_FILL_MODE_LOWER, n, 1, A, n, x, n, info); }
+
+  inline cusolverStatus_t csrchol_buffer_info(cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+					      const float *val, const int *ptr, const int *ind, csrcholInfo_t info,
+					      size_t *internal_bytes, size_t *workspace_bytes)
+  { return cusolverSpScsrcholBufferInfo(handle, n, nnz, descr, val, ptr, ind, info, internal_bytes, workspace_bytes); }
+
+  inline cusolverStatus_t csrchol_buffer_info(cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+					      const double *val, const int *ptr, const int *ind, csrcholInfo_t info,
+					      size_t *internal_bytes, size_t *workspace_bytes)
+  { return cusolverSpDcsrcholBufferInfo(handle, n, nnz, descr, val, ptr, ind, info, internal_bytes, workspace_bytes); }
+
+  inline cusolverStatus_t csrchol_factor(cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+					 const float *val, const int *ptr, const int *ind, csrcholInfo_t info, void *buffer)
+  { return cusolverSpScsrcholFactor(handle, n, nnz, descr, val, ptr, ind, info, buffer); }
+
+  inline cusolverStatus_t csrchol_factor(cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+					 const double *val, const int *ptr, const int *ind, csrcholInfo_t info, void *buffer)
+  { return cusolverSpDcsrcholFactor(handle, n, nnz, descr, val, ptr, ind, info, buffer); }
+
+  inline cusolverStatus_t csrchol_zero_pivot(cusolverSpHandle_t handle, csrcholInfo_t info, float tol, int *position)
+  { return cusolverSpScsrcholZeroPivot(handle, info, tol, position); }
+
+  inline cusolverStatus_t csrchol_zero_pivot(cusolverSpHandle_t handle, csrcholInfo_t info, double tol, int *position)
+  { return cusolverSpDcsrcholZeroPivot(handle, info, tol, position); }
+
+  inline cusolverStatus_t csrchol_solve(cusolverSpHandle_t handle, int n, const float *b, float *x,
+					csrcholInfo_t info, void *buffer)
+  { return cusolverSpScsrcholSolve(handle, n, b, x, info, buffer); }
+
+  inline cusolverStatus_t csrchol_solve(cusolverSpHandle_t handle, int n, const double *b, double *x,
+					csrcholInfo_t info, void *buffer)
+  { return cusolverSpDcsrcholSolve(handle, n, b, x, info, buffer); }
+
+  } // namespace
+
   template<typename T>
   void ProxIndRange<T>::setA(int m,
 			     int n,
 			     int nnz,
 			     const vector<T>& val,
 			     const vector<int32_t>& ptr,
-			     const vector<int32_t>& ind)
+			     const vector<int32_t>& ind,
+			     bool transpose_spmv)
   {
     nrows_ = m;
     ncols_ = n;
     nnz_ = nnz;
+    transpose_spmv_ = transpose_spmv;
     
     // create data on host
     host_ind_t_ = ind; 
@@ -54,6 +198,36 @@ namespace prost {
 	    &host_val_[0],
 	    &host_ind_[0],
 	    &host_ptr_[0]);
+
+    if(transpose_spmv_)
+    {
+      host_ind_t_.clear(); host_ind_t_.shrink_to_fit();
+      host_ptr_t_.clear(); host_ptr_t_.shrink_to_fit();
+      host_val_t_.clear(); host_val_t_.shrink_to_fit();
+    }
+  }
+
+  template<typename T>
+  void ProxIndRange<T>::InitializeA()
+  {
+    A_.Initialize(this->context().cusparse(this->context().stream()),
+		  nrows_,
+		  ncols_,
+		  nnz_,
+		  host_val_,
+		  host_ptr_,
+		  host_ind_,
+		  host_val_t_,
+		  host_ptr_t_,
+		  host_ind_t_,
+		  transpose_spmv_);
+
+    if(transpose_spmv_)
+    {
+      host_ind_.clear(); host_ind_.shrink_to_fit();
+      host_ptr_.clear(); host_ptr_.shrink_to_fit();
+      host_val_.clear(); host_val_.shrink_to_fit();
+    }
   }
 
   template<typename T>
@@ -70,242 +244,351 @@ namespace prost {
     host_AA_val_ = val;
   }
 
-  template<>
-  void ProxIndRange<double>::Initialize()
+  template<typename T>
+  void ProxIndRange<T>::Initialize()
   {
-    cusparseCreate(&cusp_handle_);
-    cusolverDnCreate(&cusolver_handle_);
-    
-    cusparseCreateMatDescr(&descr_);
-    cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
-    cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
-
-    // forward
-    ind_.resize(nnz_);
-    val_.resize(nnz_);
-    ptr_.resize(nrows_ + 1);
-
-    // transpose
-    ind_t_.resize(nnz_);
-    val_t_.resize(nnz_);
-    ptr_t_.resize(ncols_ + 1);
-
-    // copy to GPU
-    thrust::copy(host_ind_t_.begin(), host_ind_t_.end(), ind_t_.begin());
-    thrust::copy(host_ptr_t_.begin(), host_ptr_t_.end(), ptr_t_.begin());
-    thrust::copy(host_val_t_.begin(), host_val_t_.end(), val_t_.begin());
-
-    thrust::copy(host_ind_.begin(), host_ind_.end(), ind_.begin());
-    thrust::copy(host_ptr_.begin(), host_ptr_.end(), ptr_.begin());
-    thrust::copy(host_val_.begin(), host_val_.end(), val_.begin());
-
-    // factorize AA
-    AA_fac_.resize(ncols_ * ncols_);
-    AA_val_.resize(ncols_ * ncols_);
-    thrust::copy(host_AA_val_.begin(), host_AA_val_.end(), AA_fac_.begin());
-    thrust::copy(host_AA_val_.begin(), host_AA_val_.end(), AA_val_.begin());
+    // single copy mode, the matrix and its factor are still on the GPU
+    if(transpose_spmv_ && A_.initialized())
+    {
+      this->InitializeWorkspace();
+      return;
+    }
 
-    int bufferSize = 0;
-    cusolverDnDpotrf_bufferSize(cusolver_handle_,
-				CUBLAS_FILL_MODE_LOWER,
-				ncols_,
-				thrust::raw_pointer_cast(AA_val_.data()),
-				ncols_,
-				&bufferSize);
+    if(factorization_ == kFactorizationDense && host_AA_val_.size() != ncols_ * ncols_)
+      throw Exception("ProxIndRange: Matrix 'AA' is required for the dense factorization!");
+
+    FactorKey key = { this->context().device(), factorization_, nrows_, ncols_, nnz_, kHashSeed };
+
+    if(factorization_ == kFactorizationDense)
+      key.hash = HashValues(key.hash, host_AA_val_);
+    else
+    {
+      key.hash = HashValues(key.hash, host_ptr_);
+      key.hash = HashValues(key.hash, host_ind_);
+      key.hash = HashValues(key.hash, host_val_);
+    }
+
+    factor_.reset();
+    {
+      std::lock_guard<std::mutex> lock(factor_cache_mutex);
+      std::list<FactorCacheEntry<T>>& cache = factor_cache<T>();
+
+      for(auto it = cache.begin(); it != cache.end(); )
+      {
+	if(it->factor.expired())
+	  it = cache.erase(it);
+	else if(it->key == key)
+	{
+	  factor_ = it->factor.lock();
+	  break;
+	}
+	else
+	  ++it;
+      }
+    }
+
+    if(!factor_)
+    {
+      shared_ptr<ProxIndRangeFactor<T>> factor(new ProxIndRangeFactor<T>());
+
+      if(factorization_ == kFactorizationDense)
+	FactorizeDense(*factor);
+      else
+	FactorizeSparse(*factor);
+
+      std::lock_guard<std::mutex> lock(factor_cache_mutex);
+      std::list<FactorCacheEntry<T>>& cache = factor_cache<T>();
+      FactorCacheEntry<T> entry = { key, factor };
+      cache.push_front(entry);
+
+      factor_ = factor;
+    }
+
+    InitializeA();
+
+    if(transpose_spmv_)
+    {
+      host_AA_val_.clear(); 
+      host_AA_val_.shrink_to_fit();
+    }
 
     info_.resize(1);
-    buffer_.resize(bufferSize);
-
-    cusolverDnDpotrf(cusolver_handle_,
-		     CUBLAS_FILL_MODE_LOWER,
-		     ncols_,
-		     thrust::raw_pointer_cast(AA_fac_.data()),
-		     ncols_,
-		     thrust::raw_pointer_cast(buffer_.data()),
-		     bufferSize,
-		     thrust::raw_pointer_cast(info_.data()));
-          
-    temp_.resize(ncols_);
+    solve_buffer_.resize(factor_->solve_buffer_bytes);
+
+    this->InitializeWorkspace();
   }
-  
-  template<>
-  void ProxIndRange<float>::Initialize()
+
+  template<typename T>
+  void ProxIndRange<T>::FactorizeDense(ProxIndRangeFactor<T>& factor)
   {
-    cusparseCreate(&cusp_handle_);
-    cusolverDnCreate(&cusolver_handle_);
-    
-    cusparseCreateMatDescr(&descr_);
-    cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
-    cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
-
-    // forward
-    ind_.resize(nnz_);
-    val_.resize(nnz_);
-    ptr_.resize(nrows_ + 1);
-
-    // transpose
-    ind_t_.resize(nnz_);
-    val_t_.resize(nnz_);
-    ptr_t_.resize(ncols_ + 1);
-
-    // copy to GPU
-    thrust::copy(host_ind_t_.begin(), host_ind_t_.end(), ind_t_.begin());
-    thrust::copy(host_ptr_t_.begin(), host_ptr_t_.end(), ptr_t_.begin());
-    thrust::copy(host_val_t_.begin(), host_val_t_.end(), val_t_.begin());
-
-    thrust::copy(host_ind_.begin(), host_ind_.end(), ind_.begin());
-    thrust::copy(host_ptr_.begin(), host_ptr_.end(), ptr_.begin());
-    thrust::copy(host_val_.begin(), host_val_.end(), val_.begin());
-
-    // factorize AA
-    AA_fac_.resize(ncols_ * ncols_);
-    AA_val_.resize(ncols_ * ncols_);
-    thrust::copy(host_AA_val_.begin(), host_AA_val_.end(), AA_fac_.begin());
-    thrust::copy(host_AA_val_.begin(), host_AA_val_.end(), AA_val_.begin());
+    cusolverDnHandle_t cusolver_handle = this->context().cusolver_dn(this->context().stream());
+
+    // factorize AA in place
+    factor.dense.resize(ncols_ * ncols_);
+    thrust::copy(host_AA_val_.begin(), host_AA_val_.end(), factor.dense.begin());
 
     int bufferSize = 0;
-    cusolverDnSpotrf_bufferSize(cusolver_handle_,
-				CUBLAS_FILL_MODE_LOWER,
-				ncols_,
-				thrust::raw_pointer_cast(AA_val_.data()),
-				ncols_,
-				&bufferSize);
+    potrf_buffer_size(cusolver_handle,
+		      ncols_,
+		      thrust::raw_pointer_cast(factor.dense.data()),
+		      &bufferSize);
 
-    info_.resize(1);
-    buffer_.resize(bufferSize);
-
-    cusolverDnSpotrf(cusolver_handle_,
-		     CUBLAS_FILL_MODE_LOWER,
-		     ncols_,
-		     thrust::raw_pointer_cast(AA_fac_.data()),
-		     ncols_,
-		     thrust::raw_pointer_cast(buffer_.data()),
-		     bufferSize,
-		     thrust::raw_pointer_cast(info_.data()));
-          
-    temp_.resize(ncols_);
+    // the factorization workspace is only needed here
+    device_vector<T> buffer(bufferSize);
+    device_vector<int> info(1);
+
+    potrf(cusolver_handle,
+	  ncols_,
+	  thrust::raw_pointer_cast(factor.dense.data()),
+	  thrust::raw_pointer_cast(buffer.data()),
+	  bufferSize,
+	  thrust::raw_pointer_cast(info.data()));
+
+    if(info[0] != 0)
+      throw Exception("ProxIndRange: Matrix 'AA' is not positive definite, A needs full column rank!");
+  }
+
+  template<typename T>
+  void ProxIndRange<T>::FactorizeSparse(ProxIndRangeFactor<T>& factor)
+  {
+    const int n = ncols_;
+
+    // CSR of A', row i of A'A is the sum of the rows k of A scaled by A_ki.
+    // it is only transposed again if the transpose was not kept.
+    vector<int32_t> ptr_t, ind_t;
+    vector<T> val_t;
+
+    if(host_ptr_t_.empty())
+    {
+      ptr_t.resize(ncols_ + 1);
+      ind_t.resize(nnz_);
+      val_t.resize(nnz_);
+
+      csr2csc(nrows_, 
+	      ncols_, 
+	      nnz_,
+	      &host_val_[0],
+	      &host_ind_[0],
+	      &host_ptr_[0],
+	      &val_t[0],
+	      &ind_t[0],
+	      &ptr_t[0]);
+    }
+
+    const vector<int32_t>& a_ptr_t = host_ptr_t_.empty() ? ptr_t : host_ptr_t_;
+    const vector<int32_t>& a_ind_t = host_ptr_t_.empty() ? ind_t : host_ind_t_;
+    const vector<T>& a_val_t = host_ptr_t_.empty() ? val_t : host_val_t_;
+
+    vector<int32_t> aa_ptr(n + 1, 0), aa_ind;
+    vector<T> aa_val;
+    vector<T> acc(n, 0);
+    vector<int32_t> mark(n, -1), row_cols;
+
+    for(int i = 0; i < n; i++)
+    {
+      row_cols.clear();
+
+      for(int p = a_ptr_t[i]; p < a_ptr_t[i + 1]; p++)
+      {
+	const int k = a_ind_t[p];
+
+	for(int q = host_ptr_[k]; q < host_ptr_[k + 1]; q++)
+	{
+	  const int j = host_ind_[q];
+
+	  if(mark[j] != i)
+	  {
+	    mark[j] = i;
+	    acc[j] = 0;
+	    row_cols.push_back(j);
+	  }
+
+	  acc[j] += a_val_t[p] * host_val_[q];
+	}
+      }
+
+      std::sort(row_cols.begin(), row_cols.end());
+
+      for(int j : row_cols)
+      {
+	aa_ind.push_back(j);
+	aa_val.push_back(acc[j]);
+      }
+
+      aa_ptr[i + 1] = aa_ind.size();
+    }
+
+    const int nnz = aa_ind.size();
+
+    cusolverSpHandle_t cusolver_handle = this->context().cusolver_sp(this->context().stream());
+
+    cusparseMatDescr_t descr;
+    cusparseCreateMatDescr(&descr);
+    cusparseSetMatType(descr, CUSPARSE_MATRIX_TYPE_GENERAL);
+    cusparseSetMatIndexBase(descr, CUSPARSE_INDEX_BASE_ZERO);
+
+    // fill reducing ordering, B = P A'A P' with B_ij = (A'A)_{perm_i, perm_j}
+    vector<int> perm(n), perm_inv(n);
+    cusolverSpXcsrsymamdHost(cusolver_handle, n, nnz, descr, &aa_ptr[0], &aa_ind[0], &perm[0]);
+
+    for(int i = 0; i < n; i++)
+      perm_inv[perm[i]] = i;
+
+    vector<int32_t> b_ptr(n + 1, 0), b_ind;
+    vector<T> b_val;
+    vector<std::pair<int32_t, T>> row;
+    b_ind.reserve(nnz);
+    b_val.reserve(nnz);
+
+    for(int i = 0; i < n; i++)
+    {
+      row.clear();
+      for(int q = aa_ptr[perm[i]]; q < aa_ptr[perm[i] + 1]; q++)
+	row.push_back(std::make_pair(perm_inv[aa_ind[q]], aa_val[q]));
+
+      std::sort(row.begin(), row.end(), 
+		[](const std::pair<int32_t, T>& a, const std::pair<int32_t, T>& b) { return a.first < b.first; });
+
+      for(auto& entry : row)
+      {
+	b_ind.push_back(entry.first);
+	b_val.push_back(entry.second);
+      }
+
+      b_ptr[i + 1] = b_ind.size();
+    }
+
+    // the matrix is only needed for the factorization
+    device_vector<int32_t> d_ptr(b_ptr), d_ind(b_ind);
+    device_vector<T> d_val(b_val);
+    const int *ptr = thrust::raw_pointer_cast(d_ptr.data());
+    const int *ind = thrust::raw_pointer_cast(d_ind.data());
+    const T *val = thrust::raw_pointer_cast(d_val.data());
+
+    cusolverSpCreateCsrcholInfo(&factor.sparse);
+
+    bool success =
+      cusolverSpXcsrcholAnalysis(cusolver_handle, n, nnz, descr, ptr, ind, factor.sparse) == CUSOLVER_STATUS_SUCCESS &&
+      csrchol_buffer_info(cusolver_handle, n, nnz, descr, val, ptr, ind, factor.sparse,
+			  &factor.internal_bytes, &factor.solve_buffer_bytes) == CUSOLVER_STATUS_SUCCESS;
+
+    int singular = -1;
+    if(success)
+    {
+      device_vector<char> buffer(factor.solve_buffer_bytes);
+
+      success = 
+	csrchol_factor(cusolver_handle, n, nnz, descr, val, ptr, ind, factor.sparse,
+		       thrust::raw_pointer_cast(buffer.data())) == CUSOLVER_STATUS_SUCCESS &&
+	csrchol_zero_pivot(cusolver_handle, factor.sparse, static_cast<T>(0), &singular) == CUSOLVER_STATUS_SUCCESS;
+    }
+
+    cusparseDestroyMatDescr(descr);
+
+    if(!success)
+      throw Exception("ProxIndRange: Sparse Cholesky factorization of A'A failed!");
+
+    if(singular >= 0)
+      throw Exception("ProxIndRange: A'A is singular, A needs full column rank!");
+
+    factor.perm = perm;
+  }
+
+  template<typename T>
+  void ProxIndRange<T>::ClearFactorCache()
+  {
+    std::lock_guard<std::mutex> lock(factor_cache_mutex);
+    factor_cache<T>().clear();
   }
 
   template<typename T>
   size_t ProxIndRange<T>::gpu_mem_amount() const
   {
-    return 0; // TODO: implement me
+    size_t mem = A_.gpu_mem_amount() + info_.size() * sizeof(int) + solve_buffer_.size();
+
+    if(factor_)
+      mem += factor_->gpu_mem_amount();
+
+    return mem;
   }
    
-  template<>
-  void ProxIndRange<float>::EvalLocal(
-    const typename thrust::device_vector<float>::iterator& result_beg,
-    const typename thrust::device_vector<float>::iterator& result_end,
-    const typename thrust::device_vector<float>::const_iterator& arg_beg,
-    const typename thrust::device_vector<float>::const_iterator& arg_end,
-    const typename thrust::device_vector<float>::const_iterator& tau_beg,
-    const typename thrust::device_vector<float>::const_iterator& tau_end,
-    float tau,
-    bool invert_tau)
+  template<typename T>
+  void ProxIndRange<T>::EvalLocal(
+    const typename thrust::device_vector<T>::iterator& result_beg,
+    const typename thrust::device_vector<T>::iterator& result_end,
+    const typename thrust::device_vector<T>::const_iterator& arg_beg,
+    const typename thrust::device_vector<T>::const_iterator& arg_end,
+    const typename thrust::device_vector<T>::const_iterator& tau_beg,
+    const typename thrust::device_vector<T>::const_iterator& tau_end,
+    T tau,
+    bool invert_tau,
+    cudaStream_t stream)
   {
-    const float alpha = 1;
-    const float beta = 0;
+    typename ProxWorkspace<T>::Slice slice(*this->workspace_, scratch_size());
+    T *temp = thrust::raw_pointer_cast(&(*slice.begin()));
 
     // apply A'
-    cusparseScsrmv(cusp_handle_,
-		   CUSPARSE_OPERATION_NON_TRANSPOSE,
-		   ncols_,
-		   nrows_,
-		   nnz_,
-		   &alpha,
-		   descr_,
-		   thrust::raw_pointer_cast(val_t_.data()),
-		   thrust::raw_pointer_cast(ptr_t_.data()),
-		   thrust::raw_pointer_cast(ind_t_.data()),
-		   thrust::raw_pointer_cast(&(*arg_beg)),
-		   &beta,
-		   thrust::raw_pointer_cast(temp_.data()));
-    
-  // solve system
-    cusolverDnSpotrs(cusolver_handle_,
-		     CUBLAS_FILL_MODE_LOWER,
-		     temp_.size(),
-		     1,
-		     thrust::raw_pointer_cast(AA_fac_.data()),
-		     temp_.size(),
-		     thrust::raw_pointer_cast(temp_.data()),
-		     temp_.size(),
-		     thrust::raw_pointer_cast(info_.data()));
-      
+    A_.Multiply(this->context().cusparse(stream),
+		true,
+		1,
+		thrust::raw_pointer_cast(&(*arg_beg)),
+		0,
+		temp,
+		stream);
+
+    // solve system
+    SolveAA(temp, temp + ncols_, stream);
+
     // apply A
-    cusparseScsrmv(cusp_handle_,
-		   CUSPARSE_OPERATION_NON_TRANSPOSE,
-		   nrows_,
-		   ncols_,
-		   nnz_,
-		   &alpha,
-		   descr_,
-		   thrust::raw_pointer_cast(val_.data()),
-		   thrust::raw_pointer_cast(ptr_.data()),
-		   thrust::raw_pointer_cast(ind_.data()),
-		   thrust::raw_pointer_cast(temp_.data()),
-		   &beta,
-		   thrust::raw_pointer_cast(&(*result_beg)));
+    A_.Multiply(this->context().cusparse(stream),
+		false,
+		1,
+		temp,
+		0,
+		thrust::raw_pointer_cast(&(*result_beg)),
+		stream);
   }
 
-  template<>
-  void ProxIndRange<double>::EvalLocal(
-    const typename thrust::device_vector<double>::iterator& result_beg,
-    const typename thrust::device_vector<double>::iterator& result_end,
-    const typename thrust::device_vector<double>::const_iterator& arg_beg,
-    const typename thrust::device_vector<double>::const_iterator& arg_end,
-    const typename thrust::device_vector<double>::const_iterator& tau_beg,
-    const typename thrust::device_vector<double>::const_iterator& tau_end,
-    double tau,
-    bool invert_tau)
+  template<typename T>
+  void ProxIndRange<T>::SolveAA(T *x, T *temp, cudaStream_t stream)
   {
-    const double alpha = 1;
-    const double beta = 0;
+    if(factorization_ == kFactorizationDense)
+    {
+      potrs(this->context().cusolver_dn(stream),
+	    ncols_,
+	    thrust::raw_pointer_cast(factor_->dense.data()),
+	    x,
+	    thrust::raw_pointer_cast(info_.data()));
 
-    // apply A'
-    cusparseDcsrmv(cusp_handle_,
-		   CUSPARSE_OPERATION_NON_TRANSPOSE,
-		   ncols_,
-		   nrows_,
-		   nnz_,
-		   &alpha,
-		   descr_,
-		   thrust::raw_pointer_cast(val_t_.data()),
-		   thrust::raw_pointer_cast(ptr_t_.data()),
-		   thrust::raw_pointer_cast(ind_t_.data()),
-		   thrust::raw_pointer_cast(&(*arg_beg)),
-		   &beta,
-		   thrust::raw_pointer_cast(temp_.data()));
-    
-    // solve system
-    cusolverDnDpotrs(cusolver_handle_,
-		     CUBLAS_FILL_MODE_LOWER,
-		     temp_.size(),
-		     1,
-		     thrust::raw_pointer_cast(AA_fac_.data()),
-		     temp_.size(),
-		     thrust::raw_pointer_cast(temp_.data()),
-		     temp_.size(),
-		     thrust::raw_pointer_cast(info_.data()));
-      
-    // apply A
-    cusparseDcsrmv(cusp_handle_,
-		   CUSPARSE_OPERATION_NON_TRANSPOSE,
-		   nrows_,
-		   ncols_,
-		   nnz_,
-		   &alpha,
-		   descr_,
-		   thrust::raw_pointer_cast(val_.data()),
-		   thrust::raw_pointer_cast(ptr_.data()),
-		   thrust::raw_pointer_cast(ind_.data()),
-		   thrust::raw_pointer_cast(temp_.data()),
-		   &beta,
-		   thrust::raw_pointer_cast(&(*result_beg)));
+      return;
+    }
+
+    // B y = P x with B = P A'A P', then x = P' y
+    thrust::device_ptr<T> b = thrust::device_pointer_cast(temp);
+    thrust::device_ptr<T> y = b + ncols_;
+
+    thrust::gather(thrust::cuda::par.on(stream),
+		   factor_->perm.begin(),
+		   factor_->perm.end(),
+		   thrust::device_pointer_cast(x),
+		   b);
+
+    csrchol_solve(this->context().cusolver_sp(stream),
+		  ncols_,
+		  thrust::raw_pointer_cast(b),
+		  thrust::raw_pointer_cast(y),
+		  factor_->sparse,
+		  thrust::raw_pointer_cast(solve_buffer_.data()));
+
+    thrust::scatter(thrust::cuda::par.on(stream),
+		    y,
+		    y + ncols_,
+		    factor_->perm.begin(),
+		    thrust::device_pointer_cast(x));
   }
 
   // Explicit template instantiation
   template class ProxIndRange<float>;
   template class ProxIndRange<double>;
 
-} // namespace prost
\ No newline at end of file
+} // namespace prost
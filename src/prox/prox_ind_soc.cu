@@ -24,12 +24,13 @@
 #include "prost/prox/prox_ind_soc.hpp"
 #include "prost/prox/vector.hpp"
 #include "prost/prox/helper.hpp"
+#include "prost/prox/group_kernel.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
 
-template<typename T>
+template<typename T, class GROUP>
 __global__
 void ProxIndSOCKernel(
   T *d_res,
@@ -38,46 +39,43 @@ void ProxIndSOCKernel(
   size_t dim,
   T alpha)
 {
-  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+  const size_t tx = GROUP::group();
 
-  if(tx < count)
-  {
-    Vector<T> x(count, dim-1, false, tx, d_res);
-    const Vector<const T> x0(count, dim-1, false, tx, d_arg);
-    T& y = d_res[count * (dim-1) + tx];
-    const T y0 = d_arg[count * (dim-1) + tx];
-
-    T norm_x0 = 0;
-    for(size_t i = 0; i < dim-1; i++) {
-      norm_x0 += x0[i] * x0[i];
-    }
-
-    norm_x0 = sqrt(norm_x0);
-    
-    if(norm_x0 <= y0) {
-      for(size_t i = 0; i < dim-1; i++) {
-	x[i] = x0[i];
-      }
-      y = y0;	
-    }
-    else if(norm_x0 <= -y0) {
-      for(size_t i = 0; i < dim-1; i++) {
-	x[i] = 0;
-      }
-      y = 0;
-    }
-    else {
-      T fac = (y0 + norm_x0) / (2 * norm_x0);
-
-      for(size_t i = 0; i < dim-1; i++) {
-	x[i] = fac * x0[i];
-      }
+  if(tx >= count)
+    return;
+
+  Vector<T> x(count, dim-1, false, tx, d_res);
+  const Vector<const T> x0(count, dim-1, false, tx, d_arg);
+  T& y = d_res[count * (dim-1) + tx];
+  const T y0 = d_arg[count * (dim-1) + tx];
+
+  T norm_x0 = 0;
+  for(size_t i = GROUP::lane(); i < dim-1; i += GROUP::stride()) {
+    norm_x0 += x0[i] * x0[i];
+  }
+
+  norm_x0 = sqrt(GROUP::Reduce(norm_x0));
+
+  T fac;
+  if(norm_x0 <= y0) 
+    fac = 1;
+  else if(norm_x0 <= -y0) 
+    fac = 0;
+  else 
+    fac = (y0 + norm_x0) / (2 * norm_x0);
+
+  for(size_t i = GROUP::lane(); i < dim-1; i += GROUP::stride()) {
+    x[i] = fac * x0[i];
+  }
+
+  if(GROUP::lane() == 0) {
+    if(norm_x0 <= y0)
+      y = y0;
+    else
       y = fac * norm_x0;
-    }
   }
 }
 
-
 template<typename T>
 void 
 ProxIndSOC<T>::EvalLocal(
@@ -88,19 +86,33 @@ ProxIndSOC<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((this->count_ + block.x - 1) / block.x, 1, 1);
-
-  ProxIndSOCKernel<T>
-    <<<grid, block>>>(
-      thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&(*arg_beg)),
-      this->count_,
-      this->dim_,
-      this->alpha_);
-  cudaDeviceSynchronize();
+  const GroupKernel kernel = ChooseGroupKernel(this->count_, this->dim_);
+  dim3 grid, block;
+  GroupKernelLaunch(kernel, this->count_, grid, block);
+
+  T *d_res = thrust::raw_pointer_cast(&(*result_beg));
+  const T *d_arg = thrust::raw_pointer_cast(&(*arg_beg));
+
+  switch(kernel)
+  {
+  case kGroupKernelThread:
+    ProxIndSOCKernel<T, GroupThread>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, this->alpha_);
+    break;
+
+  case kGroupKernelWarp:
+    ProxIndSOCKernel<T, GroupWarp>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, this->alpha_);
+    break;
+
+  case kGroupKernelBlock:
+    ProxIndSOCKernel<T, GroupBlock>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, this->count_, this->dim_, this->alpha_);
+    break;
+  }
 
   // check for error
   cudaError_t error = cudaGetLastError();
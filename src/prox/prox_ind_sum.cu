@@ -20,16 +20,18 @@
 
 #include <iostream>
 #include <sstream>
+#include <thrust/system/cuda/execution_policy.h>
 
 #include "prost/prox/prox_ind_sum.hpp"
 #include "prost/prox/vector.hpp"
 #include "prost/prox/helper.hpp"
+#include "prost/prox/group_kernel.hpp"
 #include "prost/config.hpp"
 #include "prost/exception.hpp"
 
 namespace prost {
 
-template<typename T>
+template<typename T, class GROUP>
 __global__
 void ProxIndSumKernel(
   T *d_res,
@@ -42,30 +44,68 @@ void ProxIndSumKernel(
   T tau,
   bool inv_tau)
 {
-  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+  const size_t g = GROUP::group();
+
+  if(g >= count)
+    return;
 
-  if(tx < count) {
+  const size_t *inds = d_inds + g * dim;
 
-    T sum_arg = 0;
-    T sum_tau = 0;
+  T sum_arg = 0;
+  T sum_tau = 0;
     
-    for(int i = 0; i < dim; i++) {
-      T mytau = d_tau[d_inds[tx * dim + i]] * tau;
-      if(inv_tau) mytau = 1. / mytau;
+  for(size_t i = GROUP::lane(); i < dim; i += GROUP::stride()) {
+    T mytau = d_tau[inds[i]] * tau;
+    if(inv_tau) mytau = 1. / mytau;
       
-      sum_arg += d_arg[d_inds[tx * dim + i]];
-      sum_tau += mytau;
-    }
+    sum_arg += d_arg[inds[i]];
+    sum_tau += mytau;
+  }
 
-    for(int i = 0; i < dim; i++) {
-      T mytau = d_tau[d_inds[tx * dim + i]] * tau;
-      if(inv_tau) mytau = 1. / mytau;
+  sum_arg = GROUP::Reduce(sum_arg);
+  sum_tau = GROUP::Reduce(sum_tau);
 
-      d_res[d_inds[tx * dim + i]] =
-        d_arg[d_inds[tx * dim + i]] - mytau * (sum_arg - total_sum) / sum_tau;
-      
-    }
-    
+  for(size_t i = GROUP::lane(); i < dim; i += GROUP::stride()) {
+    T mytau = d_tau[inds[i]] * tau;
+    if(inv_tau) mytau = 1. / mytau;
+
+    d_res[inds[i]] = d_arg[inds[i]] - mytau * (sum_arg - total_sum) / sum_tau;
+  }
+}
+
+template<typename T>
+static void ProxIndSumLaunch(
+  T *d_res,
+  const T *d_arg,
+  const T *d_tau,
+  const size_t *d_inds,
+  size_t count,
+  size_t dim,
+  const T total_sum,
+  T tau,
+  bool inv_tau,
+  cudaStream_t stream)
+{
+  const GroupKernel kernel = ChooseGroupKernel(count, dim);
+  dim3 grid, block;
+  GroupKernelLaunch(kernel, count, grid, block);
+
+  switch(kernel)
+  {
+  case kGroupKernelThread:
+    ProxIndSumKernel<T, GroupThread>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, d_tau, d_inds, count, dim, total_sum, tau, inv_tau);
+    break;
+
+  case kGroupKernelWarp:
+    ProxIndSumKernel<T, GroupWarp>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, d_tau, d_inds, count, dim, total_sum, tau, inv_tau);
+    break;
+
+  case kGroupKernelBlock:
+    ProxIndSumKernel<T, GroupBlock>
+      <<<grid, block, 0, stream>>>(d_res, d_arg, d_tau, d_inds, count, dim, total_sum, tau, inv_tau);
+    break;
   }
 }
 
@@ -105,44 +145,36 @@ void ProxIndSum<T>::EvalLocal(
   const typename device_vector<T>::const_iterator& tau_beg,
   const typename device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
-  dim3 block(kBlockSizeCUDA, 1, 1);
-  dim3 grid((count_ + block.x - 1) / block.x, 1, 1);
-
   // zero prox on other indices
-  thrust::copy(arg_beg, arg_end, result_beg);
-  cudaDeviceSynchronize();
+  thrust::copy(thrust::cuda::par.on(stream), arg_beg, arg_end, result_beg);
   
-  ProxIndSumKernel<T>
-    <<<grid, block>>>(
+  ProxIndSumLaunch<T>(
+    thrust::raw_pointer_cast(&(*result_beg)),
+    thrust::raw_pointer_cast(&(*arg_beg)),
+    thrust::raw_pointer_cast(&(*tau_beg)),
+    thrust::raw_pointer_cast(&d_inds_[0]),
+    count_,
+    dim_,
+    sum_,
+    tau,
+    invert_tau,
+    stream);
+
+  if(two_) {
+    ProxIndSumLaunch<T>(
       thrust::raw_pointer_cast(&(*result_beg)),
       thrust::raw_pointer_cast(&(*arg_beg)),
       thrust::raw_pointer_cast(&(*tau_beg)),
-      thrust::raw_pointer_cast(&d_inds_[0]),
-      count_,
-      dim_,
-      sum_,
+      thrust::raw_pointer_cast(&d_inds_2_[0]),
+      count_2_,
+      dim_2_,
+      sum_2_,
       tau,
-      invert_tau);
-  
-  cudaDeviceSynchronize();
-
-  if(two_) {
-    dim3 grid2((count_ + block.x - 1) / block.x, 1, 1);
-    
-    ProxIndSumKernel<T>
-      <<<grid2, block>>>(thrust::raw_pointer_cast(&(*result_beg)),
-			 thrust::raw_pointer_cast(&(*arg_beg)),
-			 thrust::raw_pointer_cast(&(*tau_beg)),
-			 thrust::raw_pointer_cast(&d_inds_2_[0]),
-			 count_2_,
-			 dim_2_,
-			 sum_2_,
-			 tau,
-			 invert_tau);
-    
-    cudaDeviceSynchronize();    
+      invert_tau,
+      stream);
   }
 }
 
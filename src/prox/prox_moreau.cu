@@ -21,6 +21,7 @@
 #include <iostream>
 #include <thrust/for_each.h>
 #include <thrust/iterator/zip_iterator.h>
+#include <thrust/system/cuda/execution_policy.h>
 #include "prost/prox/prox_moreau.hpp"
 #include "prost/exception.hpp"
 
@@ -74,18 +75,7 @@ ProxMoreau<T>::~ProxMoreau()
 template<typename T>
 void ProxMoreau<T>::Initialize() 
 {
-  try 
-  {
-    scaled_arg_.resize(this->size_);
-  } 
-  catch(const std::bad_alloc &e)
-  {
-	std::stringstream ss;
-	ss << "Out of memory: " << e.what();
-
-    throw Exception(ss.str());
-  }
-
+  this->InitializeWorkspace();
   conjugate_->Initialize();
 }
 
@@ -104,39 +94,164 @@ void ProxMoreau<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
+  if(conjugate_->supports_moreau_eval())
+  {
+    conjugate_->EvalMoreauLocal(
+      result_beg,
+      result_end,
+      arg_beg,
+      arg_end,
+      tau_beg,
+      tau_end,
+      tau,
+      invert_tau,
+      stream);
+
+    return;
+  }
+
+  typename ProxWorkspace<T>::Slice slice(*this->workspace_, this->size_);
+  typename device_vector<T>::iterator scaled_arg = slice.begin();
+
   // prescale argument
   thrust::transform(
+    thrust::cuda::par.on(stream),
     arg_beg, 
     arg_end,
     tau_beg, 
-    scaled_arg_.begin(), 
+    scaled_arg, 
     MoreauPrescale<T>(invert_tau, tau));
 
   // compute prox with scaled argument
   conjugate_->EvalLocal(
     result_beg, 
     result_end,
-    scaled_arg_.begin(),
-    scaled_arg_.end(),
+    scaled_arg,
+    scaled_arg + this->size_,
     tau_beg,
     tau_end,
     tau, 
-    !invert_tau);
+    !invert_tau,
+    stream);
 
   // postscale argument
   // combine back to get result of conjugate prox
   thrust::for_each(
+    thrust::cuda::par.on(stream),
     thrust::make_zip_iterator(thrust::make_tuple(arg_beg, tau_beg, result_beg)),
     thrust::make_zip_iterator(thrust::make_tuple(arg_end, tau_end, result_end)),
     MoreauPostscale<T>(invert_tau, tau));
 }
 
+template<typename T>
+void ProxMoreau<T>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  conjugate_->EvalMoreauFusedLocal(
+    result_beg,
+    result_end,
+    arg,
+    tau_beg,
+    tau_end,
+    tau,
+    invert_tau,
+    stream);
+}
+
+template<typename T>
+void ProxMoreau<T>::EvalGapLocal(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const typename thrust::device_vector<T>::iterator& gap_end,
+  const typename thrust::device_vector<T>::const_iterator& x_beg,
+  const typename thrust::device_vector<T>::const_iterator& y_beg,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  conjugate_->EvalGapLocal(
+    gap_beg,
+    gap_end,
+    y_beg,
+    x_beg,
+    y_scale,
+    x_scale,
+    stream);
+}
+
+template<typename T>
+void ProxMoreau<T>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau)
+{
+  const ptrdiff_t size = static_cast<ptrdiff_t>(this->size_);
+  const MoreauPrescale<T> prescale(invert_tau, tau);
+
+  host_scaled_arg_.resize(this->size_);
+  T *scaled_arg = host_scaled_arg_.data();
+
+#pragma omp parallel for simd
+  for(ptrdiff_t i = 0; i < size; i++)
+    scaled_arg[i] = prescale(arg[i], tau_diag[i]);
+
+  conjugate_->EvalHostLocal(result, scaled_arg, tau_diag, tau, !invert_tau);
+
+#pragma omp parallel for simd
+  for(ptrdiff_t i = 0; i < size; i++)
+  {
+    if(invert_tau)
+      result[i] = arg[i] - result[i] / (tau * tau_diag[i]);
+    else
+      result[i] = arg[i] - tau * tau_diag[i] * result[i];
+  }
+}
+
 template<typename T>
 size_t ProxMoreau<T>::gpu_mem_amount() const 
 {
-  return this->size_ * sizeof(T) + conjugate_->gpu_mem_amount();
+  return conjugate_->gpu_mem_amount();
+}
+
+template<typename T>
+size_t ProxMoreau<T>::scratch_size() const 
+{
+  if(conjugate_->supports_moreau_eval())
+    return conjugate_->scratch_size();
+
+  return this->size_ + conjugate_->scratch_size();
+}
+
+template<typename T>
+void ProxMoreau<T>::set_workspace(shared_ptr<ProxWorkspace<T>> workspace) 
+{
+  Prox<T>::set_workspace(workspace);
+  conjugate_->set_workspace(workspace);
+}
+
+template<typename T>
+void ProxMoreau<T>::set_context(shared_ptr<ExecutionContext> context)
+{
+  Prox<T>::set_context(context);
+  conjugate_->set_context(context);
+}
+
+template<typename T>
+void ProxMoreau<T>::set_index(size_t index)
+{
+  Prox<T>::set_index(index);
+  conjugate_->set_index(index);
 }
 
 template<typename T>
@@ -70,7 +70,6 @@ void ProxPermute<T>::Initialize()
   
   try 
   {
-    permuted_arg_.resize(this->size_);
     perm_ = perm_host_;
   } 
   catch(const std::bad_alloc &e)
@@ -88,7 +87,7 @@ void ProxPermute<T>::Initialize()
     throw Exception(ss.str());
   }
 
-
+  this->InitializeWorkspace();
   base_prox_->Initialize();
 }
 
@@ -107,47 +106,77 @@ void ProxPermute<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
-  bool invert_tau)
+  bool invert_tau,
+  cudaStream_t stream)
 {
   dim3 block(kBlockSizeCUDA, 1, 1);
   dim3 grid((perm_host_.size() + block.x - 1) / block.x, 1, 1);
 
+  typename ProxWorkspace<T>::Slice slice(*this->workspace_, this->size_);
+  typename device_vector<T>::iterator permuted_arg = slice.begin();
+
   // permute argument
   ProxPermuteKernel<T>
-    <<<grid, block>>>(
+    <<<grid, block, 0, stream>>>(
       thrust::raw_pointer_cast(&(*result_beg)),
       thrust::raw_pointer_cast(&(*arg_beg)),
       thrust::raw_pointer_cast(&perm_[0]),
       perm_host_.size(),
       false);
-  cudaDeviceSynchronize();
 
   // compute prox with permuted argument
   base_prox_->EvalLocal(
-    permuted_arg_.begin(), 
-    permuted_arg_.end(),
+    permuted_arg, 
+    permuted_arg + this->size_,
     result_beg,
     result_end,
     tau_beg,
     tau_end,
     tau, 
-    invert_tau);
+    invert_tau,
+    stream);
 
   // permute result back
   ProxPermuteKernel<T>
-    <<<grid, block>>>(
+    <<<grid, block, 0, stream>>>(
       thrust::raw_pointer_cast(&(*result_beg)),
-      thrust::raw_pointer_cast(&permuted_arg_[0]),
+      thrust::raw_pointer_cast(&(*permuted_arg)),
       thrust::raw_pointer_cast(&perm_[0]),
       perm_host_.size(),
       true);
-  cudaDeviceSynchronize();
 }
 
 template<typename T>
 size_t ProxPermute<T>::gpu_mem_amount() const 
 {
-  return this->size_ * sizeof(T) + base_prox_->gpu_mem_amount();
+  return perm_host_.size() * sizeof(int) + base_prox_->gpu_mem_amount();
+}
+
+template<typename T>
+size_t ProxPermute<T>::scratch_size() const 
+{
+  return this->size_ + base_prox_->scratch_size();
+}
+
+template<typename T>
+void ProxPermute<T>::set_workspace(shared_ptr<ProxWorkspace<T>> workspace) 
+{
+  Prox<T>::set_workspace(workspace);
+  base_prox_->set_workspace(workspace);
+}
+
+template<typename T>
+void ProxPermute<T>::set_context(shared_ptr<ExecutionContext> context)
+{
+  Prox<T>::set_context(context);
+  base_prox_->set_context(context);
+}
+
+template<typename T>
+void ProxPermute<T>::set_index(size_t index)
+{
+  Prox<T>::set_index(index);
+  base_prox_->set_index(index);
 }
 
 template<typename T>
@@ -126,9 +126,6 @@ void ProxTransform<T>::Initialize()
     if(host_c_.size() > 1) dev_c_ = host_c_;
     if(host_d_.size() > 1) dev_d_ = host_d_;
     if(host_e_.size() > 1) dev_e_ = host_e_;
-
-    scaled_arg_.resize(this->size_);
-    scaled_tau_.resize(this->size_);
   } 
   catch(const std::bad_alloc &e)
   {
@@ -137,9 +134,50 @@ void ProxTransform<T>::Initialize()
     throw Exception(ss.str());
   }
 
+  this->InitializeWorkspace();
   inner_fn_->Initialize();
 }
 
+template<typename T>
+void ProxTransform<T>::SetCoefficients(
+    const vector<T>& a,
+    const vector<T>& b,
+    const vector<T>& c,
+    const vector<T>& d,
+    const vector<T>& e,
+    cudaStream_t stream)
+{
+  if(a.size() != host_a_.size() || b.size() != host_b_.size() ||
+     c.size() != host_c_.size() || d.size() != host_d_.size() ||
+     e.size() != host_e_.size())
+  {
+    throw Exception("ProxTransform: the size of the coefficients must not change.");
+  }
+
+  for(const T& val : a)
+    if(val == 0)
+      throw Exception("ProxTransform: Vector 'a' isn't allowed to contain zero element. (Division by zero)");
+
+  host_a_ = a;
+  host_b_ = b;
+  host_c_ = c;
+  host_d_ = d;
+  host_e_ = e;
+
+  // scalar coefficients are passed to the kernel by value
+  auto upload = [stream](device_vector<T>& dev, const vector<T>& host) {
+    if(host.size() > 1)
+      cudaMemcpyAsync(thrust::raw_pointer_cast(dev.data()), host.data(), 
+                      sizeof(T) * host.size(), cudaMemcpyHostToDevice, stream);
+  };
+
+  upload(dev_a_, host_a_);
+  upload(dev_b_, host_b_);
+  upload(dev_c_, host_c_);
+  upload(dev_d_, host_d_);
+  upload(dev_e_, host_e_);
+}
+
 template<typename T>
 void ProxTransform<T>::Release() 
 {
@@ -155,8 +193,34 @@ size_t ProxTransform<T>::gpu_mem_amount() const
       (host_c_.size() * (host_c_.size() > 1)) +
       (host_d_.size() * (host_d_.size() > 1)) +
       (host_e_.size() * (host_e_.size() > 1))) * sizeof(T) + 
-      inner_fn_->gpu_mem_amount() +
-      2 * this->size_ * sizeof(T);
+      inner_fn_->gpu_mem_amount();
+}
+
+template<typename T>
+size_t ProxTransform<T>::scratch_size() const
+{
+  return 2 * this->size_ + inner_fn_->scratch_size();
+}
+
+template<typename T>
+void ProxTransform<T>::set_workspace(shared_ptr<ProxWorkspace<T>> workspace)
+{
+  Prox<T>::set_workspace(workspace);
+  inner_fn_->set_workspace(workspace);
+}
+
+template<typename T>
+void ProxTransform<T>::set_context(shared_ptr<ExecutionContext> context)
+{
+  Prox<T>::set_context(context);
+  inner_fn_->set_context(context);
+}
+
+template<typename T>
+void ProxTransform<T>::set_index(size_t index)
+{
+  Prox<T>::set_index(index);
+  inner_fn_->set_index(index);
 }
 
 template<typename T>
@@ -174,15 +238,20 @@ void ProxTransform<T>::EvalLocal(
     const typename device_vector<T>::const_iterator& tau_beg,
     const typename device_vector<T>::const_iterator& tau_end,
     T tau,
-    bool invert_tau)
+    bool invert_tau,
+    cudaStream_t stream)
 {
   dim3 block(kBlockSizeCUDA, 1, 1);
   dim3 grid((this->size_ + block.x - 1) / block.x, 1, 1);
 
+  typename ProxWorkspace<T>::Slice slice(*this->workspace_, 2 * this->size_);
+  typename device_vector<T>::iterator scaled_arg = slice.begin();
+  typename device_vector<T>::iterator scaled_tau = scaled_arg + this->size_;
+
   // scale argument and step size
   ProxTransformPrescaleArgument<T>
-    <<<grid, block>>>(
-      thrust::raw_pointer_cast(scaled_arg_.data()),
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*scaled_arg)),
       thrust::raw_pointer_cast(&(*arg_beg)),
       thrust::raw_pointer_cast(&(*tau_beg)),
       (host_a_.size() > 1) ? thrust::raw_pointer_cast(dev_a_.data()) : nullptr,
@@ -192,8 +261,8 @@ void ProxTransform<T>::EvalLocal(
       host_a_[0], host_b_[0], host_d_[0], host_e_[0], tau, this->size_, invert_tau);
 
   ProxTransformPrescaleStepSize<T>
-    <<<grid, block>>>(
-      thrust::raw_pointer_cast(scaled_tau_.data()),
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*scaled_tau)),
       thrust::raw_pointer_cast(&(*tau_beg)),
       (host_a_.size() > 1) ? thrust::raw_pointer_cast(dev_a_.data()) : nullptr,
       (host_c_.size() > 1) ? thrust::raw_pointer_cast(dev_c_.data()) : nullptr,
@@ -204,22 +273,62 @@ void ProxTransform<T>::EvalLocal(
   inner_fn_->EvalLocal(
     result_beg,
     result_end,
-    scaled_arg_.begin(),
-    scaled_arg_.end(),
-    scaled_tau_.begin(),
-    scaled_tau_.end(),
+    scaled_arg,
+    scaled_arg + this->size_,
+    scaled_tau,
+    scaled_tau + this->size_,
     1,
-    false);
+    false,
+    stream);
 
   // rescale result
   ProxTransformPostscale<T>
-    <<<grid, block>>>(
+    <<<grid, block, 0, stream>>>(
       thrust::raw_pointer_cast(&(*result_beg)),
       (host_a_.size() > 1) ? thrust::raw_pointer_cast(dev_a_.data()) : nullptr,
       (host_b_.size() > 1) ? thrust::raw_pointer_cast(dev_b_.data()) : nullptr,
       host_a_[0], host_b_[0], this->size_);
 }
 
+template<typename T>
+void ProxTransform<T>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
+  bool invert_tau)
+{
+  const ptrdiff_t size = static_cast<ptrdiff_t>(this->size_);
+
+  host_scaled_arg_.resize(this->size_);
+  host_scaled_tau_.resize(this->size_);
+  T *scaled_arg = host_scaled_arg_.data();
+  T *scaled_tau = host_scaled_tau_.data();
+
+  auto coeff = [](const vector<T>& v, ptrdiff_t i) { return v.size() > 1 ? v[i] : v[0]; };
+
+  // same scaling as the kernels above
+#pragma omp parallel for
+  for(ptrdiff_t i = 0; i < size; i++)
+  {
+    T tau2 = tau * tau_diag[i];
+    if(invert_tau)
+      tau2 = 1 / tau2;
+
+    const T a = coeff(host_a_, i);
+    const T e = coeff(host_e_, i);
+
+    scaled_arg[i] = (a * (arg[i] - tau2 * coeff(host_d_, i))) / (1 + tau2 * e) - coeff(host_b_, i);
+    scaled_tau[i] = (a * a * coeff(host_c_, i) * tau2) / (1 + tau2 * e);
+  }
+
+  inner_fn_->EvalHostLocal(result, scaled_arg, scaled_tau, 1, false);
+
+#pragma omp parallel for
+  for(ptrdiff_t i = 0; i < size; i++)
+    result[i] = (result[i] + coeff(host_b_, i)) / coeff(host_a_, i);
+}
+
 template class ProxTransform<float>;
 template class ProxTransform<double>;
 
@@ -0,0 +1,100 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <sstream>
+
+#include "prost/prox/prox_workspace.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+ProxWorkspace<T>::ProxWorkspace()
+  : offset_(0)
+{
+}
+
+template<typename T>
+void ProxWorkspace<T>::Reserve(size_t size)
+{
+  if(size <= data_.size())
+    return;
+
+  if(offset_ != 0)
+    throw Exception("ProxWorkspace: cannot grow while memory is in use.");
+
+  try
+  {
+    // no need to keep the old contents
+    data_.clear();
+    data_.shrink_to_fit();
+    data_.resize(size);
+  }
+  catch(const std::bad_alloc &e)
+  {
+    std::stringstream ss;
+    ss << "Out of memory: " << e.what();
+
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void ProxWorkspace<T>::Release()
+{
+  if(offset_ != 0)
+    throw Exception("ProxWorkspace: cannot release while memory is in use.");
+
+  data_.clear();
+  data_.shrink_to_fit();
+}
+
+template<typename T>
+typename device_vector<T>::iterator ProxWorkspace<T>::Acquire(size_t count)
+{
+  if(offset_ + count > data_.size())
+  {
+    std::stringstream ss;
+    ss << "ProxWorkspace: requested " << count << " elements, but only "
+       << data_.size() - offset_ << " are available.";
+
+    throw Exception(ss.str());
+  }
+
+  typename device_vector<T>::iterator it = data_.begin() + offset_;
+  offset_ += count;
+
+  return it;
+}
+
+template<typename T>
+void ProxWorkspace<T>::Release(size_t count)
+{
+  if(count > offset_)
+    throw Exception("ProxWorkspace: released more memory than acquired.");
+
+  offset_ -= count;
+}
+
+// Explicit template instantiation
+template class ProxWorkspace<float>;
+template class ProxWorkspace<double>;
+
+} // namespace prost
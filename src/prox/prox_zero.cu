@@ -18,10 +18,52 @@
 * along with prost. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <sstream>
+#include <thrust/system/cuda/execution_policy.h>
+
 #include "prost/prox/prox_zero.hpp"
+#include "prost/prox/prox_argument.hpp"
+#include "prost/prox/elemop/function_1d_energy.hpp"
+#include "prost/config.hpp"
+#include "prost/exception.hpp"
 
 namespace prost {
 
+template<typename T>
+__global__
+void ProxZeroFusedKernel(
+  T *d_res,
+  ProxArgument<T> arg,
+  size_t size)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < size)
+    d_res[tx] = arg[tx];
+}
+
+/// \brief The conjugate of zero is the indicator of {0}.
+template<typename T>
+__global__
+void ProxZeroGapKernel(
+  T *d_gap,
+  const T *d_x,
+  const T *d_y,
+  T x_scale,
+  T y_scale,
+  size_t size)
+{
+  size_t tx = threadIdx.x + blockDim.x * blockIdx.x;
+
+  if(tx < size)
+  {
+    const T y = y_scale * d_y[tx];
+
+    d_gap[tx] = EnergyIndicator<T>(abs(y)) - x_scale * d_x[tx] * y;
+  }
+}
+
 template<typename T>
 ProxZero<T>::ProxZero(size_t index, size_t size) :
     Prox<T>(index, size, true)
@@ -42,9 +84,85 @@ void ProxZero<T>::EvalLocal(
   const typename thrust::device_vector<T>::const_iterator& tau_beg,
   const typename thrust::device_vector<T>::const_iterator& tau_end,
   T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  thrust::copy(thrust::cuda::par.on(stream), arg_beg, arg_end, result_beg);
+}
+
+template<typename T>
+void ProxZero<T>::EvalFusedLocal(
+  const typename thrust::device_vector<T>::iterator& result_beg,
+  const typename thrust::device_vector<T>::iterator& result_end,
+  const ProxArgument<T>& arg,
+  const typename thrust::device_vector<T>::const_iterator& tau_beg,
+  const typename thrust::device_vector<T>::const_iterator& tau_end,
+  T tau,
+  bool invert_tau,
+  cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((this->size_ + block.x - 1) / block.x, 1, 1);
+
+  ProxZeroFusedKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*result_beg)),
+      arg,
+      this->size_);
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void ProxZero<T>::EvalGapLocal(
+  const typename thrust::device_vector<T>::iterator& gap_beg,
+  const typename thrust::device_vector<T>::iterator& gap_end,
+  const typename thrust::device_vector<T>::const_iterator& x_beg,
+  const typename thrust::device_vector<T>::const_iterator& y_beg,
+  T x_scale,
+  T y_scale,
+  cudaStream_t stream)
+{
+  dim3 block(kBlockSizeCUDA, 1, 1);
+  dim3 grid((this->size_ + block.x - 1) / block.x, 1, 1);
+
+  ProxZeroGapKernel<T>
+    <<<grid, block, 0, stream>>>(
+      thrust::raw_pointer_cast(&(*gap_beg)),
+      thrust::raw_pointer_cast(&(*x_beg)),
+      thrust::raw_pointer_cast(&(*y_beg)),
+      x_scale,
+      y_scale,
+      this->size_);
+
+  // check for error
+  cudaError_t error = cudaGetLastError();
+  if(error != cudaSuccess)
+  {
+    // print the CUDA error message and throw exception
+    std::stringstream ss;
+    ss << "CUDA error: " << cudaGetErrorString(error) << std::endl;
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void ProxZero<T>::EvalHostLocal(
+  T *result,
+  const T *arg,
+  const T *tau_diag,
+  T tau,
   bool invert_tau)
 {
-  thrust::copy(arg_beg, arg_end, result_beg);
+  std::copy(arg, arg + this->size_, result);
 }
 
 // Explicit template instantiation
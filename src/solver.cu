@@ -25,12 +25,18 @@
 #include <iostream>
 #include <locale>
 #include <list>
+#include <new>
 #include <sstream>
 
+#include <thrust/copy.h>
+
 #include "prost/backend/backend.hpp"
+#include "prost/backend/checkpoint.hpp"
 #include "prost/common.hpp"
 #include "prost/problem.hpp"
 #include "prost/exception.hpp"
+#include "prost/launch_config.hpp"
+#include "prost/presolve.hpp"
 
 namespace prost {
 
@@ -45,7 +51,7 @@ struct Sep : public std::numpunct<CharT>
 
 template<typename T>
 Solver<T>::Solver(std::shared_ptr<Problem<T> > problem, std::shared_ptr<Backend<T> > backend) 
-    : problem_(problem), backend_(backend)
+    : problem_(problem), backend_(backend), profiling_(false), stream_(0), start_iteration_(0)
 {
 }
 
@@ -64,25 +70,145 @@ void Solver<T>::SetIntermCallback(const typename Solver<T>::IntermCallback& cb)
   interm_cb_ = cb;
 }
 
+template<typename T>
+void Solver<T>::SetDeviceIntermCallback(const typename Solver<T>::DeviceIntermCallback& cb) {
+  device_interm_cb_ = cb;
+}
+
+template<typename T>
+void Solver<T>::SetReductionCallback(const typename Solver<T>::DeviceReduction& reduction,
+                                     size_t num_values,
+                                     const typename Solver<T>::ReductionCallback& cb) {
+  device_reduction_ = reduction;
+  reduction_cb_ = cb;
+  host_reduction_values_.resize(num_values);
+}
+
 template<typename T>
 void Solver<T>::Initialize() {
+  if(backend_->host())
+  {
+    InitializeHost();
+    return;
+  }
+
+  // the stream is blocking, so work the backends still issue on the legacy
+  // default stream stays ordered with the iterations.
+  if(stream_ == 0 && cudaStreamCreate(&stream_) != cudaSuccess)
+    throw Exception("Failed to create the CUDA stream.");
+
+  // own handles, so that solvers can run concurrently from several threads
+  context_ = shared_ptr<ExecutionContext>(new ExecutionContext());
+  context_->set_stream(stream_);
+  context_->set_dense_math(opts_.dense_math);
+  LaunchConfig::SetAutotune(opts_.autotune_launches);
+
+  // the presolve restricts the initial iterate on the host
+  if((opts_.x0_device != nullptr || opts_.y0_device != nullptr) &&
+     (opts_.presolve || !backend_->device_solution()))
+  {
+    DownloadInitialIterate();
+  }
+
+  PresolveProblem();
+  backend_->PrepareProblem(*problem_);
+  problem_->set_context(context_);
+
+  // the profiler is shared by all solvers, only this one's share of 
+  // enabling it is toggled
+  Profiler::Reset();
+  if(profiling_ != opts_.profile)
+  {
+    Profiler::Enable(opts_.profile);
+    profiling_ = opts_.profile;
+  }
+  profile_.clear();
+
   try
   {
-    problem_->Initialize();
+    InitializeProblemBackend(opts_.operator_memory == OperatorMemory::kManaged);
+  }
+  catch(OutOfMemoryException& e)
+  {
+    if(opts_.operator_memory != OperatorMemory::kAuto)
+      throw;
+
+    if(opts_.verbose)
+      std::cout << "Out of device memory, moving the linear operator to managed memory." << std::endl;
+
+    if(problem_->dualized())
+    {
+      problem_->Dualize();
+      opts_.x0.swap(opts_.y0);
+      std::swap(opts_.x0_device, opts_.y0_device);
+    }
+
+    backend_->Release();
+    problem_->Release();
+
+    InitializeProblemBackend(true);
+  }
+
+  if(opts_.x0_device != nullptr || opts_.y0_device != nullptr)
+    backend_->SetIterateDevice(opts_.x0_device, opts_.y0_device, stream_);
+
+  InitializeCheckpoint();
+
+  if (opts_.verbose)
+  {
+    size_t mem = problem_->gpu_mem_amount() + backend_->gpu_mem_amount();
+    size_t mem_avail, mem_total;
+    cudaMemGetInfo(&mem_avail, &mem_total);
+    mem_avail /= 1024 * 1024;
+    mem_total /= 1024 * 1024;
+
+    std::locale loc("");
+    std::cout.imbue(std::locale(std::cout.getloc(), new Sep <char>()));
+    std::cout << "# primal variables: " << problem_->ncols() << std::endl;
+    std::cout << "# dual variables: " << problem_->nrows() << std::endl;
+    std::cout.imbue(std::locale());
+    
+    std::cout << "Memory requirements: " << mem / (1024 * 1024) << "MB (" << mem_avail << "/" << mem_total << "MB available)." << std::endl;
+
+    if(context_->out_of_core())
+      std::cout << "Linear operator in managed memory, streamed through the GPU." << std::endl;
+  }
+
+  ResizeSolution();
+}
+
+template<typename T>
+void Solver<T>::InitializeHost() {
+  profile_.clear();
+  start_iteration_ = 0;
+
+  if(!opts_.checkpoint_file.empty())
+    throw Exception("Checkpoints are not supported by backends running on the host.");
+
+  if(opts_.x0_device != nullptr || opts_.y0_device != nullptr)
+    DownloadInitialIterate();
+
+  PresolveProblem();
+  backend_->PrepareProblem(*problem_);
+
+  try
+  {
+    problem_->InitializeHost();
   }
   catch(Exception& e)
   {
     stringstream ss;
-    ss << "Failed to initialize the problem. Reason: " << e.what();
+    ss << "Failed to initialize the problem on the host. Reason: " << e.what();
     throw Exception(ss.str());
   }
-  
+
   if(opts_.solve_dual_problem)
   {
     problem_->Dualize();
     opts_.x0.swap(opts_.y0);
+    std::swap(opts_.x0_device, opts_.y0_device);
   }
-  
+
   try
   {
     backend_->SetProblem(problem_);
@@ -98,25 +224,302 @@ void Solver<T>::Initialize() {
 
   if (opts_.verbose)
   {
-    size_t mem = problem_->gpu_mem_amount() + backend_->gpu_mem_amount();
-    size_t mem_avail, mem_total;
-    cudaMemGetInfo(&mem_avail, &mem_total);
-    mem_avail /= 1024 * 1024;
-    mem_total /= 1024 * 1024;
-
-    std::locale loc("");
     std::cout.imbue(std::locale(std::cout.getloc(), new Sep <char>()));
     std::cout << "# primal variables: " << problem_->ncols() << std::endl;
     std::cout << "# dual variables: " << problem_->nrows() << std::endl;
     std::cout.imbue(std::locale());
-    
-    std::cout << "Memory requirements: " << mem / (1024 * 1024) << "MB (" << mem_avail << "/" << mem_total << "MB available)." << std::endl;
+    std::cout << "Running on the host." << std::endl;
+  }
+
+  ResizeSolution();
+}
+
+template<typename T>
+void Solver<T>::InitializeCheckpoint() {
+  start_iteration_ = 0;
+  checkpoint_.reset();
+
+  if(opts_.checkpoint_file.empty())
+    return;
+
+  if(!backend_->checkpoints())
+    throw Exception("Checkpoints are not supported by the backend.");
+
+  checkpoint_ = shared_ptr<Checkpoint<T>>(new Checkpoint<T>(opts_.checkpoint_file));
+
+  if(opts_.resume)
+  {
+    start_iteration_ = std::max(checkpoint_->Restore(*backend_, stream_), 0);
+
+    if(opts_.verbose && start_iteration_ > 0)
+      std::cout << "Resuming from iteration " << start_iteration_ << " of '" << opts_.checkpoint_file << "'." << std::endl;
+  }
+}
+
+template<typename T>
+void Solver<T>::InitializeProblemBackend(bool out_of_core) {
+  context_->set_out_of_core(out_of_core);
+
+  try
+  {
+    ManagedMemoryScope scope(out_of_core);
+    problem_->Initialize();
+  }
+  catch(std::bad_alloc& e)
+  {
+    stringstream ss;
+    ss << "Failed to initialize the problem. Reason: Out of memory: " << e.what();
+    throw OutOfMemoryException(ss.str());
+  }
+  catch(OutOfMemoryException& e)
+  {
+    stringstream ss;
+    ss << "Failed to initialize the problem. Reason: " << e.what();
+    throw OutOfMemoryException(ss.str());
+  }
+  catch(Exception& e)
+  {
+    stringstream ss;
+    ss << "Failed to initialize the problem. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+  
+  // the problem stays dualized until Release(), so that repeated solves
+  // do not switch between the formulations
+  if(opts_.solve_dual_problem)
+  {
+    problem_->Dualize();
+    opts_.x0.swap(opts_.y0);
+    std::swap(opts_.x0_device, opts_.y0_device);
+  }
+
+  try
+  {
+    backend_->SetProblem(problem_);
+    backend_->SetOptions(opts_);
+    backend_->Initialize();
+  }
+  catch(OutOfMemoryException& e)
+  {
+    stringstream ss;
+    ss << "Failed to initialize the backend. Reason: " << e.what();
+    throw OutOfMemoryException(ss.str());
+  }
+  catch(Exception& e)
+  {
+    stringstream ss;
+    ss << "Failed to initialize the backend. Reason: " << e.what();
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void Solver<T>::PresolveProblem() {
+  if(!opts_.presolve || presolve_)
+    return;
+
+  shared_ptr<Presolve<T>> presolve(new Presolve<T>(problem_));
+
+  if(!presolve->Reduce(opts_.x0, opts_.y0))
+  {
+    if(opts_.verbose)
+      std::cout << "Presolve: nothing to eliminate." << std::endl;
+
+    return;
+  }
+
+  presolve_ = presolve;
+  original_problem_ = problem_;
+  original_x0_ = opts_.x0;
+  original_y0_ = opts_.y0;
+
+  problem_ = presolve_->reduced();
+  opts_.x0 = presolve_->RestrictPrimal(opts_.x0);
+  opts_.y0 = presolve_->RestrictDual(opts_.y0);
+
+  if(opts_.verbose)
+  {
+    std::cout << "Presolve: eliminated " << presolve_->eliminated_cols() << " of " 
+              << original_problem_->ncols() << " primal and " << presolve_->eliminated_rows()
+              << " of " << original_problem_->nrows() << " dual variables." << std::endl;
+  }
+}
+
+template<typename T>
+void Solver<T>::ResizeSolution() {
+  size_t nrows = problem_->nrows();
+  size_t ncols = problem_->ncols();
+
+  if(presolve_)
+  {
+    red_primal_sol_.resize( ncols );
+    red_primal_constr_sol_.resize( nrows );
+    red_dual_sol_.resize( nrows );
+    red_dual_constr_sol_.resize( ncols );
+
+    // problem_ may be dualized, the original problem is not
+    nrows = opts_.solve_dual_problem ? original_problem_->ncols() : original_problem_->nrows();
+    ncols = opts_.solve_dual_problem ? original_problem_->nrows() : original_problem_->ncols();
+  }
+
+  cur_primal_sol_.resize( ncols );
+  cur_primal_constr_sol_.resize( nrows );
+  cur_dual_sol_.resize( nrows );
+  cur_dual_constr_sol_.resize( ncols );
+}
+
+template<typename T>
+void Solver<T>::FetchSolution() {
+  if(!presolve_)
+  {
+    backend_->current_solution(cur_primal_sol_,
+                               cur_primal_constr_sol_,
+                               cur_dual_sol_,
+                               cur_dual_constr_sol_);
+    return;
+  }
+
+  backend_->current_solution(red_primal_sol_,
+                             red_primal_constr_sol_,
+                             red_dual_sol_,
+                             red_dual_constr_sol_);
+  ExpandSolution();
+}
+
+template<typename T>
+int Solver<T>::FetchSnapshot() {
+  if(!presolve_)
+    return backend_->FinishSnapshot(cur_primal_sol_,
+                                    cur_primal_constr_sol_,
+                                    cur_dual_sol_,
+                                    cur_dual_constr_sol_,
+                                    false);
+
+  int iter = backend_->FinishSnapshot(red_primal_sol_,
+                                      red_primal_constr_sol_,
+                                      red_dual_sol_,
+                                      red_dual_constr_sol_,
+                                      false);
+  ExpandSolution();
+  return iter;
+}
+
+template<typename T>
+void Solver<T>::DownloadInitialIterate() {
+  // the problem is neither presolved nor dualized yet
+  if(opts_.x0_device != nullptr)
+  {
+    opts_.x0.resize(problem_->ncols());
+    cudaMemcpy(opts_.x0.data(), opts_.x0_device, opts_.x0.size() * sizeof(T), cudaMemcpyDeviceToHost);
   }
 
-  cur_primal_sol_.resize( problem_->ncols() );
-  cur_primal_constr_sol_.resize( problem_->nrows() );
-  cur_dual_sol_.resize( problem_->nrows() );
-  cur_dual_constr_sol_.resize( problem_->ncols() );
+  if(opts_.y0_device != nullptr)
+  {
+    opts_.y0.resize(problem_->nrows());
+    cudaMemcpy(opts_.y0.data(), opts_.y0_device, opts_.y0.size() * sizeof(T), cudaMemcpyDeviceToHost);
+  }
+
+  opts_.x0_device = nullptr;
+  opts_.y0_device = nullptr;
+}
+
+template<typename T>
+bool Solver<T>::device_solution() const {
+  return !presolve_ && !backend_->host() && backend_->device_solution();
+}
+
+template<typename T>
+void Solver<T>::CopySolutionDevice(T *x, T *z, T *y, T *w) {
+  if(!device_solution())
+    throw Exception("Solver: the solution cannot be copied to device memory, see device_solution().");
+
+  // the dual problem has x = y, z = w, y = x and w = z of the primal one
+  if(opts_.solve_dual_problem)
+    backend_->current_solution_device(y, w, x, z, stream_);
+  else
+    backend_->current_solution_device(x, z, y, w, stream_);
+
+  cudaStreamSynchronize(stream_);
+}
+
+template<typename T>
+bool Solver<T>::InvokeDeviceCallbacks(int iter) {
+  device_sol_x_.resize(cur_primal_sol().size());
+  device_sol_z_.resize(cur_primal_constr_sol().size());
+  device_sol_y_.resize(cur_dual_sol().size());
+  device_sol_w_.resize(cur_dual_constr_sol().size());
+
+  if(device_solution())
+  {
+    if(opts_.solve_dual_problem)
+      backend_->current_solution_device(thrust::raw_pointer_cast(device_sol_y_.data()),
+                                        thrust::raw_pointer_cast(device_sol_w_.data()),
+                                        thrust::raw_pointer_cast(device_sol_x_.data()),
+                                        thrust::raw_pointer_cast(device_sol_z_.data()),
+                                        stream_);
+    else
+      backend_->current_solution_device(thrust::raw_pointer_cast(device_sol_x_.data()),
+                                        thrust::raw_pointer_cast(device_sol_z_.data()),
+                                        thrust::raw_pointer_cast(device_sol_y_.data()),
+                                        thrust::raw_pointer_cast(device_sol_w_.data()),
+                                        stream_);
+  }
+  else
+  {
+    FetchSolution();
+
+    thrust::copy(cur_primal_sol().begin(), cur_primal_sol().end(), device_sol_x_.begin());
+    thrust::copy(cur_primal_constr_sol().begin(), cur_primal_constr_sol().end(), device_sol_z_.begin());
+    thrust::copy(cur_dual_sol().begin(), cur_dual_sol().end(), device_sol_y_.begin());
+    thrust::copy(cur_dual_constr_sol().begin(), cur_dual_constr_sol().end(), device_sol_w_.begin());
+  }
+
+  typename Solver<T>::DeviceSolution sol;
+  sol.x = thrust::raw_pointer_cast(device_sol_x_.data());
+  sol.z = thrust::raw_pointer_cast(device_sol_z_.data());
+  sol.y = thrust::raw_pointer_cast(device_sol_y_.data());
+  sol.w = thrust::raw_pointer_cast(device_sol_w_.data());
+  sol.ncols = device_sol_x_.size();
+  sol.nrows = device_sol_y_.size();
+  sol.stream = stream_;
+
+  bool stop = false;
+
+  if(device_interm_cb_)
+    stop |= device_interm_cb_(iter, sol);
+
+  if(device_reduction_)
+  {
+    reduction_values_.resize(host_reduction_values_.size());
+    device_reduction_(sol, thrust::raw_pointer_cast(reduction_values_.data()));
+
+    cudaMemcpyAsync(host_reduction_values_.data(),
+                    thrust::raw_pointer_cast(reduction_values_.data()),
+                    host_reduction_values_.size() * sizeof(T),
+                    cudaMemcpyDeviceToHost,
+                    stream_);
+    cudaStreamSynchronize(stream_);
+
+    if(reduction_cb_)
+      stop |= reduction_cb_(iter, host_reduction_values_);
+  }
+
+  return stop;
+}
+
+template<typename T>
+void Solver<T>::ExpandSolution() {
+  // the dual problem has x = y, z = w, y = x and w = z of the primal one
+  if(opts_.solve_dual_problem)
+    presolve_->Expand(red_dual_sol_, red_dual_constr_sol_, 
+                      red_primal_sol_, red_primal_constr_sol_,
+                      cur_dual_sol_, cur_dual_constr_sol_, 
+                      cur_primal_sol_, cur_primal_constr_sol_);
+  else
+    presolve_->Expand(red_primal_sol_, red_primal_constr_sol_,
+                      red_dual_sol_, red_dual_constr_sol_,
+                      cur_primal_sol_, cur_primal_constr_sol_,
+                      cur_dual_sol_, cur_dual_constr_sol_);
 }
 
 template<typename T>
@@ -134,8 +537,71 @@ typename Solver<T>::ConvergenceResult Solver<T>::Solve() {
     cb_iters.push_back(1e8);
   }
   
-  for(int i = 0; i < opts_.max_iters; i++) {    
-    backend_->PerformIteration();
+  backend_->history().Clear();
+
+  // a resumed solve continues at the iteration of the checkpoint
+  const int start = start_iteration_;
+  start_iteration_ = 0;
+
+  while(!cb_iters.empty() && cb_iters.front() < start)
+    cb_iters.pop_front();
+
+  if(cb_iters.empty())
+    cb_iters.push_back(1e8);
+
+  int next_checkpoint = start + opts_.checkpoint_iter;
+
+  for(int i = start; i < opts_.max_iters; i++) {    
+    // the state after i iterations is written in the background. if the
+    // previous checkpoint is still written, it is tried again next time.
+    if(checkpoint_ && opts_.checkpoint_iter > 0 && i >= next_checkpoint &&
+       checkpoint_->Begin(*backend_, i, stream_))
+    {
+      next_checkpoint = i + opts_.checkpoint_iter;
+    }
+
+
+    // a persistent backend runs all iterations up to the next callback,
+    // checkpoint or the last iteration in one launch and returns early
+    // once it has converged. it does not record the history.
+    if(backend_->persistent() && !opts_.profile && opts_.history_size <= 0)
+    {
+      int last = std::min(opts_.max_iters - 1, 
+                          static_cast<int>(std::ceil(cb_iters.front())));
+
+      if(checkpoint_ && opts_.checkpoint_iter > 0)
+        last = std::min(last, std::max(i, next_checkpoint - 1));
+
+      const int done = backend_->PerformPersistentIterations(last - i + 1, stream_);
+
+      if(done > 0)
+        i += done - 1;
+      else
+        backend_->PerformIteration(stream_);
+    }
+    else
+    {
+      // replay a captured graph if the following iterations neither evaluate
+      // the residuals nor hit a callback or the last iteration. graphs do
+      // not record the history.
+      int graph_iters = (opts_.use_cuda_graph && !opts_.profile && opts_.history_size <= 0) ? 
+        backend_->graph_iterations() : 0;
+
+      if(graph_iters > 0 && 
+         (i + graph_iters) < opts_.max_iters && 
+         (i + graph_iters - 1) < cb_iters.front() &&
+         backend_->PerformGraphIterations(stream_))
+      {
+        i += graph_iters - 1;
+        continue;
+      }
+
+      // callbacks and the last iteration get fresh residuals
+      if(i >= cb_iters.front() || i == (opts_.max_iters - 1))
+        backend_->RequestResiduals();
+
+      backend_->PerformIteration(stream_);
+    }
 
     // check if solver has converged
     T primal_res = backend_->primal_residual();
@@ -149,15 +615,40 @@ typename Solver<T>::ConvergenceResult Solver<T>::Solve() {
     if((primal_res < eps_pri) && (dual_res < eps_dua))
       is_converged = true;
 
+    const T gap = backend_->primal_dual_gap();
+    const T eps_gap = opts_.tol_gap * problem_->ncols();
+
+    if(opts_.tol_gap > 0 && gap < eps_gap)
+      is_converged = true;
+
     // check if we should run the intermediate solution callback this iteration
     if(i >= cb_iters.front() || is_converged || is_stopped || i == (opts_.max_iters - 1)) {
-      //backend_->current_solution(cur_primal_sol_, cur_dual_sol_);
-      backend_->current_solution(cur_primal_sol_,
-                                 cur_primal_constr_sol_,
-                                 cur_dual_sol_,
-                                 cur_dual_constr_sol_);
+      const bool is_last = is_converged || is_stopped || i == (opts_.max_iters - 1);
+      int cb_iter = i + 1;
+
+      // only the host callback needs the solution on the host
+      const bool call_cb = opts_.num_cback_calls >= 1;
+      const bool host_cb = call_cb && static_cast<bool>(interm_cb_);
+      const bool device_cb = call_cb && (device_interm_cb_ || device_reduction_);
+
+      // hands the recorded history to the host without waiting for it
+      backend_->history().Flush(stream_);
+
+      if(host_cb && opts_.async_snapshots && !is_last)
+      {
+        // the callback only sees (x, y). it gets the latest completed
+        // snapshot, which usually is the one of the previous callback.
+        backend_->BeginSnapshot(Backend<T>::kSnapshotX | Backend<T>::kSnapshotY, 
+                                i + 1, stream_);
+        cb_iter = FetchSnapshot();
+      }
+      else if(host_cb || (is_last && (opts_.host_solution || !device_solution())))
+      {
+        // the final iterate stays on the device if it is read from there
+        FetchSolution();
+      }
  
-      if(opts_.num_cback_calls >= 1)
+      if(call_cb && cb_iter > 0)
       {
         if(opts_.verbose) {
           int digits = std::floor(std::log10( (double) opts_.max_iters )) + 1;
@@ -165,15 +656,35 @@ typename Solver<T>::ConvergenceResult Solver<T>::Solve() {
           cout << "Feas_p=" << std::setprecision(2) << primal_res;
           cout << ", Eps_p=" << std::setprecision(2) << eps_pri;
           cout << ", Feas_d=" << std::setprecision(2) << dual_res;
-          cout << ", Eps_d=" << std::setprecision(2) << eps_dua << "; ";
+          cout << ", Eps_d=" << std::setprecision(2) << eps_dua;
+
+          if(opts_.tol_gap > 0)
+            cout << ", Gap=" << std::setprecision(2) << gap;
+
+          cout << "; ";
         }
 
         // MATLAB callback
-        if(opts_.solve_dual_problem)
-          is_converged |= interm_cb_(i + 1, cur_dual_sol_, cur_primal_sol_);
-        else
-          is_converged |= interm_cb_(i + 1, cur_primal_sol_, cur_dual_sol_);
+        if(host_cb)
+        {
+          if(opts_.solve_dual_problem)
+            is_converged |= interm_cb_(cb_iter, cur_dual_sol_, cur_primal_sol_);
+          else
+            is_converged |= interm_cb_(cb_iter, cur_primal_sol_, cur_dual_sol_);
+        }
+        else if(opts_.verbose)
+          cout << endl;
       }
+
+      if(device_cb)
+        is_converged |= InvokeDeviceCallbacks(i + 1);
+
+      // stopped by the callback, the result has to be the current iterate
+      if(host_cb && opts_.async_snapshots && !is_last && is_converged)
+        FetchSolution();
+      else if(!host_cb && !is_last && is_converged && 
+              (opts_.host_solution || !device_solution()))
+        FetchSolution();
       
       cb_iters.pop_front();
     }
@@ -195,23 +706,121 @@ typename Solver<T>::ConvergenceResult Solver<T>::Solve() {
     }
   }
 
-  // restore original problem
-  if(opts_.solve_dual_problem)
-  {
-    problem_->Dualize();
-    opts_.x0.swap(opts_.y0);
-  }
-  
   if(opts_.verbose && (result == Solver<T>::ConvergenceResult::kStoppedMaxIters))
     std::cout << "Reached maximum of " << opts_.max_iters << " iterations." << std::endl;
 
+  backend_->history().Flush(stream_);
+  backend_->history().Collect();
+
+  if(checkpoint_)
+    checkpoint_->Finish();
+
+  if(opts_.verbose && backend_->history().dropped() > 0)
+    std::cout << "History: " << backend_->history().dropped() << " iterations were dropped, increase history_size." << std::endl;
+
+  if(opts_.profile)
+  {
+    profile_ = Profiler::Report();
+
+    if(opts_.verbose)
+    {
+      std::cout << "Profile (ranges nest, phases include their blocks and proxes):" << std::endl;
+
+      for(const Profiler::Entry& e : profile_)
+      {
+        std::cout << std::fixed << std::setprecision(3) << std::setw(12) << e.time_ms << " ms, "
+                  << std::setw(8) << e.calls << " calls";
+
+        if(e.bytes > 0)
+          std::cout << ", " << std::setprecision(1) << std::setw(7) << e.bandwidth() << " GB/s";
+
+        std::cout << "  " << e.name << std::endl;
+      }
+
+      std::cout.unsetf(std::ios_base::floatfield);
+    }
+  }
+
   return result;
 }
 
+template<typename T>
+typename Solver<T>::ConvergenceResult Solver<T>::Resolve() {
+  // the reduced problem does not see updates of the original one
+  if(presolve_)
+    throw Exception("Solver: Resolve() is not supported for presolved problems.");
+
+  backend_->ProblemChanged(stream_);
+
+  return Solve();
+}
+
 template<typename T>
 void Solver<T>::Release() {
+  // waits for the last checkpoint, which reads the iterates
+  checkpoint_.reset();
+
+  // restore the primal problem
+  if(problem_->dualized())
+  {
+    problem_->Dualize();
+    opts_.x0.swap(opts_.y0);
+    std::swap(opts_.x0_device, opts_.y0_device);
+  }
+
   problem_->Release();
   backend_->Release();
+
+  if(presolve_)
+  {
+    presolve_->Restore();
+    problem_ = original_problem_;
+    opts_.x0 = original_x0_;
+    opts_.y0 = original_y0_;
+
+    original_problem_.reset();
+    presolve_.reset();
+  }
+
+  if(profiling_)
+  {
+    Profiler::Enable(false);
+    profiling_ = false;
+  }
+  Profiler::Reset();
+
+  // free the buffers of the device callbacks
+  thrust::device_vector<T>().swap(device_sol_x_);
+  thrust::device_vector<T>().swap(device_sol_z_);
+  thrust::device_vector<T>().swap(device_sol_y_);
+  thrust::device_vector<T>().swap(device_sol_w_);
+  thrust::device_vector<T>().swap(reduction_values_);
+
+  context_.reset();
+
+  if(stream_ != 0)
+  {
+    cudaStreamDestroy(stream_);
+    stream_ = 0;
+  }
+}
+
+template<typename T>
+const vector<HistoryEntry<T> >& Solver<T>::history() const
+{
+  return backend_->history().entries();
+}
+
+template<typename T>
+size_t Solver<T>::history_dropped() const
+{
+  return backend_->history().dropped();
+}
+
+template<typename T>
+T Solver<T>::primal_dual_gap() const
+{
+  return backend_->primal_dual_gap();
 }
 
 template<typename T>
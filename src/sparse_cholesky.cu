@@ -0,0 +1,299 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+#include <thrust/gather.h>
+#include <thrust/scatter.h>
+#include <thrust/system/cuda/execution_policy.h>
+
+#include "prost/sparse_cholesky.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+namespace {
+
+void CheckCusolver(cusolverStatus_t stat, const char *what)
+{
+  if(stat != CUSOLVER_STATUS_SUCCESS)
+  {
+    std::ostringstream ss;
+    ss << what << " failed. Error code = " << stat << ".";
+
+    throw Exception(ss.str());
+  }
+}
+
+cusolverStatus_t CsrcholBufferInfo(
+  cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+  const float *val, const int32_t *ptr, const int32_t *ind, csrcholInfo_t info,
+  size_t *internal_bytes, size_t *workspace_bytes)
+{
+  return cusolverSpScsrcholBufferInfo(handle, n, nnz, descr, val, ptr, ind, info,
+                                      internal_bytes, workspace_bytes);
+}
+
+cusolverStatus_t CsrcholBufferInfo(
+  cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+  const double *val, const int32_t *ptr, const int32_t *ind, csrcholInfo_t info,
+  size_t *internal_bytes, size_t *workspace_bytes)
+{
+  return cusolverSpDcsrcholBufferInfo(handle, n, nnz, descr, val, ptr, ind, info,
+                                      internal_bytes, workspace_bytes);
+}
+
+cusolverStatus_t CsrcholFactor(
+  cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+  const float *val, const int32_t *ptr, const int32_t *ind, csrcholInfo_t info,
+  void *buffer)
+{
+  return cusolverSpScsrcholFactor(handle, n, nnz, descr, val, ptr, ind, info, buffer);
+}
+
+cusolverStatus_t CsrcholFactor(
+  cusolverSpHandle_t handle, int n, int nnz, cusparseMatDescr_t descr,
+  const double *val, const int32_t *ptr, const int32_t *ind, csrcholInfo_t info,
+  void *buffer)
+{
+  return cusolverSpDcsrcholFactor(handle, n, nnz, descr, val, ptr, ind, info, buffer);
+}
+
+cusolverStatus_t CsrcholZeroPivot(
+  cusolverSpHandle_t handle, csrcholInfo_t info, float tol, int *position)
+{
+  return cusolverSpScsrcholZeroPivot(handle, info, tol, position);
+}
+
+cusolverStatus_t CsrcholZeroPivot(
+  cusolverSpHandle_t handle, csrcholInfo_t info, double tol, int *position)
+{
+  return cusolverSpDcsrcholZeroPivot(handle, info, tol, position);
+}
+
+cusolverStatus_t CsrcholSolve(
+  cusolverSpHandle_t handle, int n, const float *b, float *x,
+  csrcholInfo_t info, void *buffer)
+{
+  return cusolverSpScsrcholSolve(handle, n, b, x, info, buffer);
+}
+
+cusolverStatus_t CsrcholSolve(
+  cusolverSpHandle_t handle, int n, const double *b, double *x,
+  csrcholInfo_t info, void *buffer)
+{
+  return cusolverSpDcsrcholSolve(handle, n, b, x, info, buffer);
+}
+
+} // namespace
+
+template<typename T>
+SparseCholesky<T>::SparseCholesky()
+  : n_(0), nnz_(0), initialized_(false), internal_bytes_(0)
+{
+}
+
+template<typename T>
+SparseCholesky<T>::~SparseCholesky()
+{
+  Release();
+}
+
+template<typename T>
+void SparseCholesky<T>::Initialize(
+  int n,
+  const vector<int32_t>& ptr,
+  const vector<int32_t>& ind,
+  const vector<T>& val)
+{
+  Release();
+
+  n_ = n;
+  nnz_ = ptr[n];
+
+  CheckCusolver(cusolverSpCreate(&handle_), "cusolverSpCreate");
+  cusparseCreateMatDescr(&descr_);
+  cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
+  cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
+  CheckCusolver(cusolverSpCreateCsrcholInfo(&info_), "cusolverSpCreateCsrcholInfo");
+  initialized_ = true;
+
+  // fill-reducing ordering, computed on the host
+  host_perm_.resize(n_);
+  CheckCusolver(cusolverSpXcsrsymamdHost(handle_, n_, nnz_, descr_, 
+                                         &ptr[0], &ind[0], &host_perm_[0]),
+                "cusolverSpXcsrsymamdHost");
+
+  vector<int32_t> perm_inv(n_);
+  for(int i = 0; i < n_; i++)
+    perm_inv[host_perm_[i]] = i;
+
+  // build P A P^T with sorted column indices
+  vector<int32_t> host_ptr(n_ + 1);
+  vector<int32_t> host_ind(nnz_);
+  vector<std::pair<int32_t, int32_t> > row;
+  host_map_.resize(nnz_);
+  host_ptr[0] = 0;
+
+  for(int i = 0; i < n_; i++)
+  {
+    const int32_t r = host_perm_[i];
+
+    row.clear();
+    for(int32_t k = ptr[r]; k < ptr[r + 1]; k++)
+      row.push_back(std::make_pair(perm_inv[ind[k]], k));
+
+    std::sort(row.begin(), row.end());
+
+    for(size_t k = 0; k < row.size(); k++)
+    {
+      host_ind[host_ptr[i] + k] = row[k].first;
+      host_map_[host_ptr[i] + k] = row[k].second;
+    }
+
+    host_ptr[i + 1] = host_ptr[i] + row.size();
+  }
+
+  try
+  {
+    perm_ = host_perm_;
+    ptr_ = host_ptr;
+    ind_ = host_ind;
+    val_.resize(nnz_);
+    b_perm_.resize(n_);
+    x_perm_.resize(n_);
+  }
+  catch(std::bad_alloc& e)
+  {
+    std::stringstream ss;
+    ss << "Out of memory: " << e.what();
+    throw Exception(ss.str());
+  }
+
+  CheckCusolver(cusolverSpXcsrcholAnalysis(handle_, n_, nnz_, descr_,
+                                           thrust::raw_pointer_cast(ptr_.data()),
+                                           thrust::raw_pointer_cast(ind_.data()),
+                                           info_),
+                "cusolverSpXcsrcholAnalysis");
+
+  Factor(val);
+}
+
+template<typename T>
+void SparseCholesky<T>::Factor(const vector<T>& val)
+{
+  vector<T> host_val(nnz_);
+  for(int k = 0; k < nnz_; k++)
+    host_val[k] = val[host_map_[k]];
+
+  thrust::copy(host_val.begin(), host_val.end(), val_.begin());
+
+  size_t workspace_bytes;
+  CheckCusolver(CsrcholBufferInfo(handle_, n_, nnz_, descr_,
+                                  thrust::raw_pointer_cast(val_.data()),
+                                  thrust::raw_pointer_cast(ptr_.data()),
+                                  thrust::raw_pointer_cast(ind_.data()),
+                                  info_, &internal_bytes_, &workspace_bytes),
+                "csrcholBufferInfo");
+
+  if(buffer_.size() < workspace_bytes)
+  {
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+    buffer_.resize(workspace_bytes);
+  }
+
+  CheckCusolver(CsrcholFactor(handle_, n_, nnz_, descr_,
+                              thrust::raw_pointer_cast(val_.data()),
+                              thrust::raw_pointer_cast(ptr_.data()),
+                              thrust::raw_pointer_cast(ind_.data()),
+                              info_, thrust::raw_pointer_cast(buffer_.data())),
+                "csrcholFactor");
+
+  int position;
+  CheckCusolver(CsrcholZeroPivot(handle_, info_, std::numeric_limits<T>::epsilon(), &position),
+                "csrcholZeroPivot");
+
+  if(position >= 0)
+  {
+    std::stringstream ss;
+    ss << "Sparse Cholesky factorization failed, matrix is singular at row " << position << ".";
+    throw Exception(ss.str());
+  }
+}
+
+template<typename T>
+void SparseCholesky<T>::Solve(const T *d_b, T *d_x, cudaStream_t stream)
+{
+  cusolverSpSetStream(handle_, stream);
+
+  thrust::gather(thrust::cuda::par.on(stream),
+                 perm_.begin(), perm_.end(),
+                 thrust::device_pointer_cast(d_b),
+                 b_perm_.begin());
+
+  CheckCusolver(CsrcholSolve(handle_, n_,
+                             thrust::raw_pointer_cast(b_perm_.data()),
+                             thrust::raw_pointer_cast(x_perm_.data()),
+                             info_, thrust::raw_pointer_cast(buffer_.data())),
+                "csrcholSolve");
+
+  thrust::scatter(thrust::cuda::par.on(stream),
+                  x_perm_.begin(), x_perm_.end(),
+                  perm_.begin(),
+                  thrust::device_pointer_cast(d_x));
+}
+
+template<typename T>
+void SparseCholesky<T>::Release()
+{
+  if(!initialized_)
+    return;
+
+  cusolverSpDestroyCsrcholInfo(info_);
+  cusparseDestroyMatDescr(descr_);
+  cusolverSpDestroy(handle_);
+
+  perm_.clear();
+  ptr_.clear();
+  ind_.clear();
+  val_.clear();
+  b_perm_.clear();
+  x_perm_.clear();
+  buffer_.clear();
+  internal_bytes_ = 0;
+  initialized_ = false;
+}
+
+template<typename T>
+size_t SparseCholesky<T>::gpu_mem_amount() const
+{
+  return (2 * n_ + 1 + nnz_) * sizeof(int32_t) +
+    (nnz_ + 2 * n_) * sizeof(T) + buffer_.size() + internal_bytes_;
+}
+
+// Explicit template instantiation
+template class SparseCholesky<float>;
+template class SparseCholesky<double>;
+
+} // namespace prost
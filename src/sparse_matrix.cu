@@ -0,0 +1,552 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <sstream>
+
+#include "prost/sparse_matrix.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+namespace {
+
+void CheckCusparse(cusparseStatus_t stat, const char *what)
+{
+  if(stat != CUSPARSE_STATUS_SUCCESS)
+  {
+    std::ostringstream ss;
+    ss << what << " failed. Error code = " << stat << ".";
+
+    throw Exception(ss.str());
+  }
+}
+
+#if PROST_CUSPARSE_GENERIC
+
+template<typename T> struct CudaDataType;
+template<> struct CudaDataType<float>  { static const cudaDataType value = CUDA_R_32F; };
+template<> struct CudaDataType<double> { static const cudaDataType value = CUDA_R_64F; };
+
+#if CUSPARSE_VERSION >= 11400
+const cusparseSpMVAlg_t kSpMVAlgorithmRegular   = CUSPARSE_SPMV_CSR_ALG1;
+const cusparseSpMVAlg_t kSpMVAlgorithmIrregular = CUSPARSE_SPMV_CSR_ALG2;
+const cusparseSpMVAlg_t kSpMVAlgorithmDefault   = CUSPARSE_SPMV_ALG_DEFAULT;
+#else
+const cusparseSpMVAlg_t kSpMVAlgorithmRegular   = CUSPARSE_CSRMV_ALG1;
+const cusparseSpMVAlg_t kSpMVAlgorithmIrregular = CUSPARSE_CSRMV_ALG2;
+const cusparseSpMVAlg_t kSpMVAlgorithmDefault   = CUSPARSE_MV_ALG_DEFAULT;
+#endif
+
+#if CUSPARSE_VERSION >= 11400
+const cusparseSpMMAlg_t kSpMMAlgorithmDefault  = CUSPARSE_SPMM_ALG_DEFAULT;
+const cusparseSpMMAlg_t kSpMMAlgorithmRowMajor = CUSPARSE_SPMM_CSR_ALG2;
+#else
+const cusparseSpMMAlg_t kSpMMAlgorithmDefault  = CUSPARSE_MM_ALG_DEFAULT;
+const cusparseSpMMAlg_t kSpMMAlgorithmRowMajor = CUSPARSE_MM_ALG_DEFAULT;
+#endif
+
+/// \brief Picks the load-balanced algorithm if a few rows are much longer
+///        than the average, e.g. for coupling constraints, and the row-split
+///        algorithm for stencil-like matrices.
+cusparseSpMVAlg_t ChooseAlgorithm(const int32_t *ptr, size_t rows)
+{
+  if(rows == 0)
+    return kSpMVAlgorithmRegular;
+
+  int32_t max_len = 0;
+  for(size_t i = 0; i < rows; i++)
+    max_len = std::max(max_len, ptr[i + 1] - ptr[i]);
+
+  const double mean_len = static_cast<double>(ptr[rows]) / rows;
+
+  if(max_len > 4 * mean_len + 32)
+    return kSpMVAlgorithmIrregular;
+
+  return kSpMVAlgorithmRegular;
+}
+
+#else
+
+cusparseStatus_t LegacyCsrmv(
+  cusparseHandle_t handle, cusparseOperation_t op, int m, int n, int nnz,
+  const float *alpha, cusparseMatDescr_t descr, const float *val,
+  const int32_t *ptr, const int32_t *ind, const float *x, const float *beta,
+  float *y)
+{
+  return cusparseScsrmv(handle, op, m, n, nnz, alpha, descr, val, ptr, ind, x, beta, y);
+}
+
+cusparseStatus_t LegacyCsrmv(
+  cusparseHandle_t handle, cusparseOperation_t op, int m, int n, int nnz,
+  const double *alpha, cusparseMatDescr_t descr, const double *val,
+  const int32_t *ptr, const int32_t *ind, const double *x, const double *beta,
+  double *y)
+{
+  return cusparseDcsrmv(handle, op, m, n, nnz, alpha, descr, val, ptr, ind, x, beta, y);
+}
+
+#endif
+
+} // namespace
+
+template<typename T>
+SparseMatrix<T>::SparseMatrix()
+  : m_(0), n_(0), nnz_(0), transpose_spmv_(false), initialized_(false),
+    dense_cols_(0), dense_row_major_(false)
+{
+}
+
+template<typename T>
+SparseMatrix<T>::~SparseMatrix()
+{
+  Release();
+}
+
+template<typename T>
+void SparseMatrix<T>::Initialize(
+  cusparseHandle_t handle,
+  int m,
+  int n,
+  int nnz,
+  const vector<T>& val,
+  const vector<int32_t>& ptr,
+  const vector<int32_t>& ind,
+  const vector<T>& val_t,
+  const vector<int32_t>& ptr_t,
+  const vector<int32_t>& ind_t,
+  bool transpose_spmv)
+{
+  Initialize(handle, m, n, nnz, 
+    val.data(), ptr.data(), ind.data(),
+    val_t.data(), ptr_t.data(), ind_t.data(),
+    transpose_spmv);
+}
+
+template<typename T>
+void SparseMatrix<T>::Initialize(
+  cusparseHandle_t handle,
+  int m,
+  int n,
+  int nnz,
+  const T *val,
+  const int32_t *ptr,
+  const int32_t *ind,
+  const T *val_t,
+  const int32_t *ptr_t,
+  const int32_t *ind_t,
+  bool transpose_spmv)
+{
+  Release();
+
+  m_ = m;
+  n_ = n;
+  nnz_ = nnz;
+  transpose_spmv_ = transpose_spmv;
+
+  ind_.resize(nnz_);
+  val_.resize(nnz_);
+  ptr_.resize(m_ + 1);
+  thrust::copy(ind, ind + nnz_, ind_.begin());
+  thrust::copy(val, val + nnz_, val_.begin());
+  thrust::copy(ptr, ptr + m_ + 1, ptr_.begin());
+
+  if(!transpose_spmv_)
+  {
+    ind_t_.resize(nnz_);
+    val_t_.resize(nnz_);
+    ptr_t_.resize(n_ + 1);
+    thrust::copy(ind_t, ind_t + nnz_, ind_t_.begin());
+    thrust::copy(val_t, val_t + nnz_, val_t_.begin());
+    thrust::copy(ptr_t, ptr_t + n_ + 1, ptr_t_.begin());
+  }
+  else
+  {
+    ind_t_.clear(); ind_t_.shrink_to_fit();
+    val_t_.clear(); val_t_.shrink_to_fit();
+    ptr_t_.clear(); ptr_t_.shrink_to_fit();
+  }
+
+#if PROST_CUSPARSE_GENERIC
+  const cudaDataType type = CudaDataType<T>::value;
+
+  CheckCusparse(cusparseCreateCsr(&mat_, m_, n_, nnz_,
+      thrust::raw_pointer_cast(ptr_.data()),
+      thrust::raw_pointer_cast(ind_.data()),
+      thrust::raw_pointer_cast(val_.data()),
+      CUSPARSE_INDEX_32I, CUSPARSE_INDEX_32I, CUSPARSE_INDEX_BASE_ZERO, type),
+    "cusparseCreateCsr");
+
+  alg_ = ChooseAlgorithm(ptr, m_);
+
+  cusparseOperation_t op_t;
+  if(transpose_spmv_)
+  {
+    mat_t_ = mat_;
+    op_t = CUSPARSE_OPERATION_TRANSPOSE;
+    alg_t_ = kSpMVAlgorithmDefault;
+  }
+  else
+  {
+    CheckCusparse(cusparseCreateCsr(&mat_t_, n_, m_, nnz_,
+        thrust::raw_pointer_cast(ptr_t_.data()),
+        thrust::raw_pointer_cast(ind_t_.data()),
+        thrust::raw_pointer_cast(val_t_.data()),
+        CUSPARSE_INDEX_32I, CUSPARSE_INDEX_32I, CUSPARSE_INDEX_BASE_ZERO, type),
+      "cusparseCreateCsr");
+    op_t = CUSPARSE_OPERATION_NON_TRANSPOSE;
+    alg_t_ = ChooseAlgorithm(ptr_t, n_);
+  }
+
+  // dummy vectors, only their sizes matter for the workspace query
+  device_vector<T> u(m_), v(n_);
+  cusparseDnVecDescr_t vec_u, vec_v;
+  CheckCusparse(cusparseCreateDnVec(&vec_u, m_, thrust::raw_pointer_cast(u.data()), type),
+    "cusparseCreateDnVec");
+  CheckCusparse(cusparseCreateDnVec(&vec_v, n_, thrust::raw_pointer_cast(v.data()), type),
+    "cusparseCreateDnVec");
+
+  const T alpha = 1;
+  const T beta = 1;
+  size_t bytes = 0, bytes_t = 0;
+
+  CheckCusparse(cusparseSpMV_bufferSize(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_, vec_v, &beta, vec_u, type, alg_, &bytes),
+    "cusparseSpMV_bufferSize");
+  CheckCusparse(cusparseSpMV_bufferSize(handle, op_t,
+      &alpha, mat_t_, vec_u, &beta, vec_v, type, alg_t_, &bytes_t),
+    "cusparseSpMV_bufferSize");
+
+  buffer_.resize(std::max<size_t>(bytes, 1));
+  buffer_t_.resize(std::max<size_t>(bytes_t, 1));
+
+#if CUDART_VERSION >= 12040
+  // Analysis is tied to the matrix descriptor, so with transpose_spmv only
+  // the forward product can be preprocessed.
+  CheckCusparse(cusparseSpMV_preprocess(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_, vec_v, &beta, vec_u, type, alg_,
+      thrust::raw_pointer_cast(buffer_.data())),
+    "cusparseSpMV_preprocess");
+
+  if(!transpose_spmv_)
+  {
+    CheckCusparse(cusparseSpMV_preprocess(handle, op_t,
+        &alpha, mat_t_, vec_u, &beta, vec_v, type, alg_t_,
+        thrust::raw_pointer_cast(buffer_t_.data())),
+      "cusparseSpMV_preprocess");
+  }
+#endif
+
+  cusparseDestroyDnVec(vec_u);
+  cusparseDestroyDnVec(vec_v);
+#else
+  cusparseCreateMatDescr(&descr_);
+  cusparseSetMatType(descr_, CUSPARSE_MATRIX_TYPE_GENERAL);
+  cusparseSetMatIndexBase(descr_, CUSPARSE_INDEX_BASE_ZERO);
+#endif
+
+  initialized_ = true;
+}
+
+template<typename T>
+void SparseMatrix<T>::Release()
+{
+  if(!initialized_)
+    return;
+
+#if PROST_CUSPARSE_GENERIC
+  cusparseDestroySpMat(mat_);
+  if(!transpose_spmv_)
+    cusparseDestroySpMat(mat_t_);
+#else
+  cusparseDestroyMatDescr(descr_);
+#endif
+
+  ind_.clear(); ind_.shrink_to_fit();
+  val_.clear(); val_.shrink_to_fit();
+  ptr_.clear(); ptr_.shrink_to_fit();
+  ind_t_.clear(); ind_t_.shrink_to_fit();
+  val_t_.clear(); val_t_.shrink_to_fit();
+  ptr_t_.clear(); ptr_t_.shrink_to_fit();
+
+#if PROST_CUSPARSE_GENERIC
+  buffer_.clear(); buffer_.shrink_to_fit();
+  buffer_t_.clear(); buffer_t_.shrink_to_fit();
+  dense_buffer_.clear(); dense_buffer_.shrink_to_fit();
+  dense_buffer_t_.clear(); dense_buffer_t_.shrink_to_fit();
+#endif
+
+  dense_cols_ = 0;
+  initialized_ = false;
+}
+
+template<typename T>
+void SparseMatrix<T>::Download(
+  vector<T>& val,
+  vector<int32_t>& ptr,
+  vector<int32_t>& ind) const
+{
+  val.resize(val_.size());
+  ptr.resize(ptr_.size());
+  ind.resize(ind_.size());
+  thrust::copy(val_.begin(), val_.end(), val.begin());
+  thrust::copy(ptr_.begin(), ptr_.end(), ptr.begin());
+  thrust::copy(ind_.begin(), ind_.end(), ind.begin());
+}
+
+template<typename T>
+void SparseMatrix<T>::Prefetch(int device, bool transpose, cudaStream_t stream) const
+{
+  // the transposed SpMV reads the forward arrays
+  if(transpose && !transpose_spmv_)
+  {
+    PrefetchOperatorVector(ptr_t_, device, stream);
+    PrefetchOperatorVector(ind_t_, device, stream);
+    PrefetchOperatorVector(val_t_, device, stream);
+  }
+  else
+  {
+    PrefetchOperatorVector(ptr_, device, stream);
+    PrefetchOperatorVector(ind_, device, stream);
+    PrefetchOperatorVector(val_, device, stream);
+  }
+}
+
+template<typename T>
+void SparseMatrix<T>::InitializeDense(cusparseHandle_t handle, int k, bool row_major)
+{
+  dense_cols_ = 0;
+
+#if PROST_CUSPARSE_GENERIC
+  const cudaDataType type = CudaDataType<T>::value;
+  const cusparseOrder_t order = row_major ? CUSPARSE_ORDER_ROW : CUSPARSE_ORDER_COL;
+
+  // row-major SpMM is fastest with the row-split algorithm, which does not
+  // support transposing the sparse matrix
+  spmm_alg_ = row_major ? kSpMMAlgorithmRowMajor : kSpMMAlgorithmDefault;
+  spmm_alg_t_ = (row_major && !transpose_spmv_) ? kSpMMAlgorithmRowMajor : kSpMMAlgorithmDefault;
+
+  // dummy matrices, only their sizes matter for the workspace query
+  device_vector<T> dummy(static_cast<size_t>(std::max(m_, n_)) * k);
+  cusparseDnMatDescr_t mat_u, mat_v;
+  CheckCusparse(cusparseCreateDnMat(&mat_u, m_, k, row_major ? k : m_,
+      thrust::raw_pointer_cast(dummy.data()), type, order),
+    "cusparseCreateDnMat");
+  CheckCusparse(cusparseCreateDnMat(&mat_v, n_, k, row_major ? k : n_,
+      thrust::raw_pointer_cast(dummy.data()), type, order),
+    "cusparseCreateDnMat");
+
+  const T alpha = 1;
+  const T beta = 1;
+  size_t bytes = 0, bytes_t = 0;
+
+  CheckCusparse(cusparseSpMM_bufferSize(handle, 
+      CUSPARSE_OPERATION_NON_TRANSPOSE, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_, mat_v, &beta, mat_u, type, spmm_alg_, &bytes),
+    "cusparseSpMM_bufferSize");
+  CheckCusparse(cusparseSpMM_bufferSize(handle, 
+      transpose_spmv_ ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
+      CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_t_, mat_u, &beta, mat_v, type, spmm_alg_t_, &bytes_t),
+    "cusparseSpMM_bufferSize");
+
+  dense_buffer_.resize(std::max<size_t>(bytes, 1));
+  dense_buffer_t_.resize(std::max<size_t>(bytes_t, 1));
+
+  cusparseDestroyDnMat(mat_u);
+  cusparseDestroyDnMat(mat_v);
+
+  dense_cols_ = k;
+  dense_row_major_ = row_major;
+#endif
+}
+
+template<typename T>
+void SparseMatrix<T>::MultiplyDense(
+  cusparseHandle_t handle,
+  bool transpose,
+  T alpha,
+  const T *x,
+  T beta,
+  T *y,
+  cudaStream_t stream)
+{
+  if(!supports_dense())
+    throw Exception("SparseMatrix: MultiplyDense called without InitializeDense.");
+
+#if PROST_CUSPARSE_GENERIC
+  cusparseSetStream(handle, stream);
+
+  const cudaDataType type = CudaDataType<T>::value;
+  const cusparseOrder_t order = dense_row_major_ ? CUSPARSE_ORDER_ROW : CUSPARSE_ORDER_COL;
+  const int k = dense_cols_;
+  const int rows_x = transpose ? m_ : n_;
+  const int rows_y = transpose ? n_ : m_;
+
+  cusparseDnMatDescr_t mat_x, mat_y;
+  CheckCusparse(cusparseCreateDnMat(&mat_x, rows_x, k, dense_row_major_ ? k : rows_x,
+      const_cast<T *>(x), type, order),
+    "cusparseCreateDnMat");
+  CheckCusparse(cusparseCreateDnMat(&mat_y, rows_y, k, dense_row_major_ ? k : rows_y,
+      y, type, order),
+    "cusparseCreateDnMat");
+
+  cusparseStatus_t stat;
+  if(!transpose)
+  {
+    stat = cusparseSpMM(handle, 
+      CUSPARSE_OPERATION_NON_TRANSPOSE, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_, mat_x, &beta, mat_y, type, spmm_alg_,
+      thrust::raw_pointer_cast(dense_buffer_.data()));
+  }
+  else
+  {
+    stat = cusparseSpMM(handle,
+      transpose_spmv_ ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
+      CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_t_, mat_x, &beta, mat_y, type, spmm_alg_t_,
+      thrust::raw_pointer_cast(dense_buffer_t_.data()));
+  }
+
+  cusparseDestroyDnMat(mat_x);
+  cusparseDestroyDnMat(mat_y);
+
+  CheckCusparse(stat, "Sparse Matrix-Matrix multiplication");
+#endif
+}
+
+template<typename T>
+void SparseMatrix<T>::SetValues(
+  const vector<T>& val,
+  const vector<T>& val_t,
+  cudaStream_t stream)
+{
+  if(val.size() != static_cast<size_t>(nnz_) || 
+     (!transpose_spmv_ && val_t.size() != static_cast<size_t>(nnz_)))
+    throw Exception("SparseMatrix: the number of nonzeros must not change.");
+
+  cudaMemcpyAsync(thrust::raw_pointer_cast(val_.data()),
+                  val.data(),
+                  sizeof(T) * nnz_,
+                  cudaMemcpyHostToDevice,
+                  stream);
+
+  if(!transpose_spmv_)
+    cudaMemcpyAsync(thrust::raw_pointer_cast(val_t_.data()),
+                    val_t.data(),
+                    sizeof(T) * nnz_,
+                    cudaMemcpyHostToDevice,
+                    stream);
+}
+
+template<typename T>
+void SparseMatrix<T>::Multiply(
+  cusparseHandle_t handle,
+  bool transpose,
+  T alpha,
+  const T *x,
+  T beta,
+  T *y,
+  cudaStream_t stream)
+{
+  cusparseSetStream(handle, stream);
+
+  const int size_x = transpose ? m_ : n_;
+  const int size_y = transpose ? n_ : m_;
+
+#if PROST_CUSPARSE_GENERIC
+  const cudaDataType type = CudaDataType<T>::value;
+  cusparseDnVecDescr_t vec_x, vec_y;
+
+  CheckCusparse(cusparseCreateDnVec(&vec_x, size_x, const_cast<T *>(x), type),
+    "cusparseCreateDnVec");
+  CheckCusparse(cusparseCreateDnVec(&vec_y, size_y, y, type),
+    "cusparseCreateDnVec");
+
+  cusparseStatus_t stat;
+  if(!transpose)
+  {
+    stat = cusparseSpMV(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_, vec_x, &beta, vec_y, type, alg_,
+      thrust::raw_pointer_cast(buffer_.data()));
+  }
+  else
+  {
+    stat = cusparseSpMV(handle,
+      transpose_spmv_ ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
+      &alpha, mat_t_, vec_x, &beta, vec_y, type, alg_t_,
+      thrust::raw_pointer_cast(buffer_t_.data()));
+  }
+
+  cusparseDestroyDnVec(vec_x);
+  cusparseDestroyDnVec(vec_y);
+#else
+  cusparseStatus_t stat;
+  if(!transpose || transpose_spmv_)
+  {
+    stat = LegacyCsrmv(handle,
+      transpose ? CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
+      m_, n_, nnz_, &alpha, descr_,
+      thrust::raw_pointer_cast(val_.data()),
+      thrust::raw_pointer_cast(ptr_.data()),
+      thrust::raw_pointer_cast(ind_.data()),
+      x, &beta, y);
+  }
+  else
+  {
+    stat = LegacyCsrmv(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+      n_, m_, nnz_, &alpha, descr_,
+      thrust::raw_pointer_cast(val_t_.data()),
+      thrust::raw_pointer_cast(ptr_t_.data()),
+      thrust::raw_pointer_cast(ind_t_.data()),
+      x, &beta, y);
+  }
+#endif
+
+  CheckCusparse(stat, "Sparse Matrix-Vector multiplication");
+}
+
+template<typename T>
+size_t SparseMatrix<T>::gpu_mem_amount() const
+{
+  size_t total_bytes = 0;
+
+  total_bytes += nnz_ * (sizeof(int32_t) + sizeof(T));
+  total_bytes += (m_ + 1) * sizeof(int32_t);
+
+  if(!transpose_spmv_)
+  {
+    total_bytes += nnz_ * (sizeof(int32_t) + sizeof(T));
+    total_bytes += (n_ + 1) * sizeof(int32_t);
+  }
+
+#if PROST_CUSPARSE_GENERIC
+  total_bytes += buffer_.size() + buffer_t_.size();
+  total_bytes += dense_buffer_.size() + dense_buffer_t_.size();
+#endif
+
+  return total_bytes;
+}
+
+// Explicit template instantiation
+template class SparseMatrix<float>;
+template class SparseMatrix<double>;
+
+} // namespace prost
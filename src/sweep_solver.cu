@@ -0,0 +1,176 @@
+/**
+* This file is part of prost.
+*
+* Copyright 2016 Thomas Möllenhoff <thomas dot moellenhoff at in dot tum dot de> 
+* and Emanuel Laude <emanuel dot laude at in dot tum dot de> (Technical University of Munich)
+*
+* prost is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* prost is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with prost. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "prost/sweep_solver.hpp"
+
+#include <thread>
+
+#include "prost/backend/backend.hpp"
+#include "prost/problem.hpp"
+#include "prost/exception.hpp"
+
+namespace prost {
+
+template<typename T>
+SweepSolver<T>::SweepSolver(
+  size_t num_points,
+  const ProblemBuilder& problem_builder,
+  const BackendBuilder& backend_builder,
+  const ParameterSetter& parameter_setter)
+    : num_points_(num_points), problem_builder_(problem_builder),
+      backend_builder_(backend_builder), parameter_setter_(parameter_setter),
+      next_point_(0), stop_(false)
+{
+  int count = 0;
+  if(cudaGetDeviceCount(&count) != cudaSuccess)
+    count = 0;
+
+  for(int i = 0; i < count; i++)
+    devices_.push_back(i);
+}
+
+template<typename T>
+void SweepSolver<T>::SetDevices(const vector<int>& devices)
+{
+  devices_ = devices;
+}
+
+template<typename T> 
+void SweepSolver<T>::SetOptions(const typename Solver<T>::Options& opts) 
+{
+  opts_ = opts;
+}
+
+template<typename T>
+void SweepSolver<T>::Solve()
+{
+  if(devices_.empty())
+    throw Exception("SweepSolver: no CUDA device available.");
+
+  // the points are updated in place, which the reduced problem would not see
+  if(opts_.presolve)
+    throw Exception("SweepSolver: presolve is not supported.");
+
+  // all devices would write the same file
+  if(!opts_.checkpoint_file.empty())
+    throw Exception("SweepSolver: checkpoints are not supported.");
+
+  results_.clear();
+  results_.resize(num_points_);
+  errors_.assign(devices_.size(), nullptr);
+  next_point_ = 0;
+  stop_ = false;
+
+  vector<std::thread> threads;
+  for(size_t i = 0; i < devices_.size(); i++)
+    threads.push_back(std::thread(&SweepSolver<T>::SolveDevice, this, i));
+
+  for(auto& t : threads)
+    t.join();
+
+  for(auto& e : errors_)
+    if(e)
+      std::rethrow_exception(e);
+}
+
+template<typename T>
+shared_ptr<Solver<T>> SweepSolver<T>::CreateSolver(shared_ptr<Problem<T>> problem, size_t point)
+{
+  shared_ptr<Solver<T>> solver(new Solver<T>(problem, backend_builder_(point)));
+
+  typename Solver<T>::Options opts = opts_;
+  opts.host_solution = true;
+  opts.x0_device = nullptr;
+  opts.y0_device = nullptr;
+
+  solver->SetOptions(opts);
+  solver->SetStoppingCallback([this] { return stop_.load(); });
+
+  std::lock_guard<std::mutex> lock(init_mutex_);
+  solver->Initialize();
+
+  return solver;
+}
+
+template<typename T>
+void SweepSolver<T>::SolveDevice(size_t device_index)
+{
+  shared_ptr<Solver<T>> solver;
+
+  try
+  {
+    if(cudaSetDevice(devices_[device_index]) != cudaSuccess)
+      throw Exception("SweepSolver: invalid CUDA device.");
+
+    shared_ptr<Problem<T>> problem;
+    {
+      std::lock_guard<std::mutex> lock(init_mutex_);
+      problem = problem_builder_(device_index);
+    }
+
+    for(size_t point = next_point_++; point < num_points_ && !stop_; point = next_point_++)
+    {
+      typename Solver<T>::ConvergenceResult result;
+
+      if(!solver)
+      {
+        // the parameters are applied to the initialized problem
+        solver = CreateSolver(problem, point);
+        parameter_setter_(point, *problem);
+        problem->Update();
+        result = solver->Resolve();
+      }
+      else if(parameter_setter_(point, *problem))
+      {
+        solver->Release();
+        solver = CreateSolver(problem, point);
+        result = solver->Solve();
+      }
+      else
+      {
+        // warm-started from the previous point
+        problem->Update();
+        result = solver->Resolve();
+      }
+
+      Result& r = results_[point];
+      r.result = result;
+      r.device = devices_[device_index];
+      r.x = solver->cur_primal_sol();
+      r.z = solver->cur_primal_constr_sol();
+      r.y = solver->cur_dual_sol();
+      r.w = solver->cur_dual_constr_sol();
+    }
+  }
+  catch(...)
+  {
+    errors_[device_index] = std::current_exception();
+    stop_ = true;
+  }
+
+  if(solver)
+    solver->Release();
+}
+
+// Explicit template instantiation
+template class SweepSolver<float>;
+template class SweepSolver<double>;
+
+} // namespace prost